@@ -0,0 +1,27 @@
+# Post-build size report: the size of every output section, then the largest symbols.
+#
+# Usage: cmake -DELF=<file> -DSIZE=<size tool> -DNM=<nm tool> [-DSYMBOL_COUNT=<n>] -P size_report.cmake
+cmake_minimum_required(VERSION 3.15)
+
+if(NOT SYMBOL_COUNT)
+    set(SYMBOL_COUNT 20)
+endif()
+
+execute_process(COMMAND ${SIZE} -A -d ${ELF} OUTPUT_VARIABLE SECTIONS)
+message("${SECTIONS}")
+
+execute_process(COMMAND ${NM} --print-size --size-sort --reverse-sort --demangle --radix=d ${ELF} OUTPUT_VARIABLE SYMBOLS)
+string(STRIP "${SYMBOLS}" SYMBOLS)
+string(REPLACE "\n" ";" SYMBOLS "${SYMBOLS}")
+list(LENGTH SYMBOLS TOTAL)
+if(TOTAL LESS SYMBOL_COUNT)
+    set(SYMBOL_COUNT ${TOTAL})
+endif()
+
+message("Top ${SYMBOL_COUNT} symbols (address size type name):")
+if(SYMBOL_COUNT GREATER 0)
+    list(SUBLIST SYMBOLS 0 ${SYMBOL_COUNT} TOP)
+    foreach(SYMBOL IN LISTS TOP)
+        message("  ${SYMBOL}")
+    endforeach()
+endif()
@@ -0,0 +1,130 @@
+"""
+Convert a capture of the kernel trace stream into the Chrome trace event format, which Perfetto
+(ui.perfetto.dev) and chrome://tracing load.
+
+The input is the raw data written to the trace ITM stimulus port (port 1), for example the channel 1 output of
+orbcat or an OpenOCD ITM capture with the other ports filtered out. Each record is 12 bytes, laid out as
+os::trace_record in source/OS/trace/trace_impl.h. Everything before the first start record is skipped.
+"""
+import argparse
+import json
+import struct
+
+RECORD = struct.Struct('<IIBBH')
+START_TAG = 0x5254
+
+EVENTS = ['trace_start', 'clock_change', 'overflow', 'thread_switch_in', 'thread_switch_out', 'thread_ready',
+          'isr_enter', 'isr_exit', 'semaphore_signal', 'semaphore_take', 'semaphore_block', 'queue_send',
+          'queue_receive', 'queue_block', 'marker']
+THREAD_STATUS = ['active', 'suspended', 'sleeping', 'pending', 'exited']
+THREAD_NAMES = {0xFFFF: 'idle', 0xFFFE: 'timer', 0xFFFD: 'log', 0xFFFC: 'deferred work', 0xFFFB: 'trace'}
+
+THREADS_PID = 1
+INTERRUPTS_PID = 2
+EXTERNAL_INTERRUPT_OFFSET = 16
+
+
+def find_start(data):
+    """ get the offset of the first start record, or None if there isn't one """
+    for offset in range(len(data) - RECORD.size + 1):
+        _, _, event, _, tag = RECORD.unpack_from(data, offset)
+        if event == 0 and tag == START_TAG:
+            return offset
+    return None
+
+
+def interrupt_name(number):
+    if number < EXTERNAL_INTERRUPT_OFFSET:
+        return 'exception {}'.format(number)
+    return 'irq {}'.format(number - EXTERNAL_INTERRUPT_OFFSET)
+
+
+def decode(data, thread_names):
+    """ turn the records into a list of trace events with timestamps in microseconds """
+    offset = find_start(data)
+    if offset is None:
+        raise ValueError('no start record in the capture')
+
+    events = []
+    threads = set()
+    interrupts = set()
+    running = None
+    clock_hz = None
+    last_cycles = None
+    time_us = 0.0
+
+    for offset in range(offset, len(data) - RECORD.size + 1, RECORD.size):
+        cycles, argument, event, detail, tag = RECORD.unpack_from(data, offset)
+        name = EVENTS[event] if event < len(EVENTS) else 'unknown'
+
+        # the cycle counter wraps, so only the difference from the last record is meaningful
+        if name == 'trace_start' and tag == START_TAG:
+            clock_hz = argument
+        elif last_cycles is not None:
+            time_us += ((cycles - last_cycles) & 0xFFFFFFFF) * 1e6 / clock_hz
+        last_cycles = cycles
+
+        if name == 'clock_change':
+            clock_hz = argument
+            events.append({'name': 'clock {} MHz'.format(argument // 1000000), 'ph': 'i', 's': 'g', 'ts': time_us,
+                           'pid': THREADS_PID, 'tid': 0})
+        elif name == 'overflow':
+            events.append({'name': '{} records lost'.format(argument), 'ph': 'i', 's': 'g', 'ts': time_us,
+                           'pid': THREADS_PID, 'tid': 0})
+        elif name == 'thread_switch_in':
+            if running is not None:
+                events.append({'name': 'running', 'ph': 'E', 'ts': time_us, 'pid': THREADS_PID, 'tid': running})
+            running = argument
+            threads.add(argument)
+            events.append({'name': 'running', 'ph': 'B', 'ts': time_us, 'pid': THREADS_PID, 'tid': argument})
+        elif name == 'thread_switch_out':
+            status = THREAD_STATUS[detail] if detail < len(THREAD_STATUS) else str(detail)
+            threads.add(argument)
+            events.append({'name': 'switch out', 'ph': 'i', 's': 't', 'ts': time_us, 'pid': THREADS_PID,
+                           'tid': argument, 'args': {'status': status}})
+        elif name == 'thread_ready':
+            threads.add(argument)
+            events.append({'name': 'ready', 'ph': 'i', 's': 't', 'ts': time_us, 'pid': THREADS_PID, 'tid': argument})
+        elif name in ('isr_enter', 'isr_exit'):
+            interrupts.add(argument)
+            events.append({'name': interrupt_name(argument), 'ph': 'B' if name == 'isr_enter' else 'E',
+                           'ts': time_us, 'pid': INTERRUPTS_PID, 'tid': argument})
+        elif name == 'marker':
+            events.append({'name': 'marker {}'.format(detail), 'ph': 'i', 's': 't', 'ts': time_us,
+                           'pid': THREADS_PID, 'tid': running if running is not None else 0,
+                           'args': {'value': argument}})
+        elif name != 'trace_start':
+            events.append({'name': name, 'ph': 'i', 's': 't', 'ts': time_us, 'pid': THREADS_PID,
+                           'tid': running if running is not None else 0,
+                           'args': {'object': '0x{:08x}'.format(argument), 'detail': detail}})
+
+    metadata = [{'name': 'process_name', 'ph': 'M', 'pid': THREADS_PID, 'args': {'name': 'threads'}},
+                {'name': 'process_name', 'ph': 'M', 'pid': INTERRUPTS_PID, 'args': {'name': 'interrupts'}}]
+    for thread in sorted(threads):
+        label = thread_names.get(thread, 'thread {}'.format(thread))
+        metadata.append({'name': 'thread_name', 'ph': 'M', 'pid': THREADS_PID, 'tid': thread, 'args': {'name': label}})
+    for number in sorted(interrupts):
+        metadata.append({'name': 'thread_name', 'ph': 'M', 'pid': INTERRUPTS_PID, 'tid': number,
+                         'args': {'name': interrupt_name(number)}})
+    return metadata + events
+
+
+def parse_names(values):
+    names = dict(THREAD_NAMES)
+    for value in values:
+        thread_id, _, name = value.partition('=')
+        names[int(thread_id, 0)] = name
+    return names
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description='Convert a kernel trace capture to a Chrome trace event file')
+    parser.add_argument('capture', help='raw trace stimulus port data')
+    parser.add_argument('-o', '--output', help='output json file', default='trace.json')
+    parser.add_argument('-n', '--name', help='name a thread, like 10=shell', action='append', default=[])
+    args = parser.parse_args()
+
+    with open(args.capture, 'rb') as capture:
+        trace_events = decode(capture.read(), parse_names(args.name))
+    with open(args.output, 'w') as output:
+        json.dump({'traceEvents': trace_events, 'displayTimeUnit': 'ns'}, output)
@@ -0,0 +1,143 @@
+/*! \file vibration.cpp
+*
+*  \brief vibration analysis of the accelerometer data. A thread takes the raw frames from the LIS3DSH, low-pass
+*         filters each axis as the frames arrive and runs a real FFT over every full block, then publishes the
+*         magnitude spectra for other threads to pick up.
+*
+*
+*  \author Graham Riches
+*/
+
+/********************************** Includes *******************************************/
+#include "vibration.h"
+#include "kv_store.h"
+#include "lis3dsh.h"
+#include "mutex.h"
+#include "power_manager.h"
+#include "scheduler.h"
+#include "thread_impl.h"
+#include <cstring>
+
+/*********************************** Consts ********************************************/
+constexpr uint32_t vibration_thread_id = 11;
+constexpr uint8_t vibration_thread_priority = 2;
+constexpr uint16_t vibration_thread_stack_size = 512;
+
+/* second order butterworth low-pass at 400Hz for 1.6kHz samples, which keeps the band of interest and halves the
+   noise folded into the spectrum. A filter saved in the settings store replaces it. */
+constexpr dsp::biquad_coefficients_q14 low_pass = {
+    dsp::to_q14(0.29289f), dsp::to_q14(0.58579f), dsp::to_q14(0.29289f), dsp::to_q14(0.0f), dsp::to_q14(0.17157f)};
+
+/****************************** Functions Prototype ************************************/
+static void vibration_thread_task(void* arguments);
+static void load_filter_settings(void);
+static void publish(void);
+
+/******************************** Local Variables **************************************/
+CCM_RAM static uint32_t vibration_thread_stack[vibration_thread_stack_size] = {0};
+CCM_RAM static os::thread vibration_thread(vibration_thread_task, nullptr, vibration_thread_id, vibration_thread_stack,
+                                   vibration_thread_stack_size, vibration_thread_priority);
+
+static dsp::biquad_cascade_q15<1> filters[vibration_axes] = {
+    dsp::biquad_cascade_q15<1>({low_pass}), dsp::biquad_cascade_q15<1>({low_pass}), dsp::biquad_cascade_q15<1>({low_pass})};
+static dsp::rfft_q15<vibration_fft_size> fft;
+static dsp::q15_t blocks[vibration_axes][vibration_fft_size];  //!< filtered samples, transformed in place when full
+static size_t block_fill = 0;
+
+static os::mutex spectrum_lock;
+static VibrationSpectrum latest_spectrum;
+
+/****************************** Functions Definition ***********************************/
+/**
+ * \brief register the vibration thread
+ */
+void vibration_initialize(void) {
+    os::scheduler::register_new_thread(&vibration_thread);
+}
+
+/**
+ * \brief copy out the latest spectrum if it is newer than the one the caller already has
+ *
+ * \param spectrum the caller's copy
+ * \retval true if the spectrum was updated
+ */
+bool get_vibration_spectrum(VibrationSpectrum& spectrum) {
+    spectrum_lock.lock();
+    bool newer = (latest_spectrum.sequence != spectrum.sequence);
+    if ( newer ) {
+        std::memcpy(&spectrum, &latest_spectrum, sizeof(spectrum));
+    }
+    spectrum_lock.unlock();
+    return newer;
+}
+
+/**
+ * \brief vibration thread. Woken for each burst of frames the accelerometer reads out of its FIFO.
+ *
+ * \param arguments not used
+ */
+static void vibration_thread_task(void* arguments) {
+    PARAMETER_NOT_USED(arguments);
+    LIS3DSHFrame frames[LIS3DSH::fifo_watermark];
+
+    load_filter_settings();
+    while ( true ) {
+        size_t count = accelerometer.read_frames(frames, LIS3DSH::fifo_watermark, os::scheduler::wait_forever);
+
+        /* the filters and transforms run at full speed, then the clocks drop back until the next burst */
+        request_full_performance();
+        while ( count > 0 ) {
+            /* split the frames into the axis blocks, then filter just the new samples */
+            size_t space = vibration_fft_size - block_fill;
+            size_t taken = (count < space) ? count : space;
+            for ( size_t index = 0; index < taken; index++ ) {
+                blocks[0][block_fill + index] = frames[index].x;
+                blocks[1][block_fill + index] = frames[index].y;
+                blocks[2][block_fill + index] = frames[index].z;
+            }
+            for ( size_t axis = 0; axis < vibration_axes; axis++ ) {
+                filters[axis].process(&blocks[axis][block_fill], taken);
+            }
+
+            block_fill += taken;
+            if ( block_fill == vibration_fft_size ) {
+                publish();
+                block_fill = 0;
+            }
+
+            count -= taken;
+            std::memmove(frames, &frames[taken], count * sizeof(LIS3DSHFrame));
+        }
+        release_full_performance();
+    }
+}
+
+/**
+ * \brief switch the filters over to the coefficients in the settings store, if there are any
+ */
+static void load_filter_settings(void) {
+    dsp::biquad_coefficients_q14 coefficients;
+    size_t size = os::kv_store::read(static_cast<uint16_t>(SettingsKey::vibration_low_pass), &coefficients, sizeof(coefficients));
+    if ( size != sizeof(coefficients) ) {
+        return;
+    }
+    for ( auto& filter : filters ) {
+        filter = dsp::biquad_cascade_q15<1>({coefficients});
+    }
+}
+
+/**
+ * \brief transform the full blocks and publish their spectra
+ */
+static void publish(void) {
+    for ( auto& block : blocks ) {
+        fft.transform(block);
+    }
+
+    spectrum_lock.lock();
+    for ( size_t axis = 0; axis < vibration_axes; axis++ ) {
+        dsp::rfft_q15<vibration_fft_size>::magnitude(blocks[axis], latest_spectrum.magnitudes[axis]);
+    }
+    latest_spectrum.sequence = (latest_spectrum.sequence + 1 == 0) ? 1 : latest_spectrum.sequence + 1;
+    spectrum_lock.unlock();
+}
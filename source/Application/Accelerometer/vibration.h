@@ -0,0 +1,41 @@
+/*! \file vibration.h
+*
+*  \brief vibration analysis of the accelerometer data.
+*
+*
+*  \author Graham Riches
+*/
+
+#pragma once
+
+/********************************** Includes *******************************************/
+#include "common.h"
+#include "dsp_q15.h"
+
+/*********************************** Consts ********************************************/
+constexpr size_t vibration_fft_size = 256;                     //!< samples per spectrum, 160ms at 1.6kHz
+constexpr size_t vibration_bins = vibration_fft_size / 2;      //!< 6.25Hz per bin at 1.6kHz
+constexpr size_t vibration_axes = 3;
+
+/************************************ Types ********************************************/
+/**
+ * \brief magnitude spectrum of each axis, in raw accelerometer counts scaled by 1/vibration_fft_size
+ */
+struct VibrationSpectrum {
+    uint32_t sequence;  //!< counts up with each new spectrum, 0 before the first
+    dsp::q15_t magnitudes[vibration_axes][vibration_bins];
+};
+
+/****************************** Functions Prototype ************************************/
+/**
+ * \brief register the vibration analysis thread with the scheduler. Call this before the kernel is entered.
+ */
+void vibration_initialize(void);
+
+/**
+ * \brief copy out the latest spectrum if it is newer than the one the caller already has
+ *
+ * \param spectrum the caller's copy, which is only written if there is a newer one
+ * \retval true if the spectrum was updated
+ */
+bool get_vibration_spectrum(VibrationSpectrum& spectrum);
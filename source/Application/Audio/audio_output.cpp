@@ -0,0 +1,243 @@
+/*! \file audio_output.cpp
+*
+*  \brief audio output pipeline, streaming blocks from a producer thread through I2S3 to the CS43L22.
+*
+*
+*  \author Graham Riches
+*/
+
+/********************************** Includes *******************************************/
+#include "audio_output.h"
+#include "cm4_port.h"
+#include "hal_interrupt.h"
+#include "hal_rcc.h"
+#include <cstring>
+
+/*********************************** Consts ********************************************/
+/**
+ * \brief I2S PLL factors for a sample rate. The I2S prescalers divide the PLL output down by a whole number, so
+ *        each rate needs its own PLL setting to come out close. Worked out for the 1 MHz PLL input of the 8 MHz
+ *        crystal divided by 8, with MCLK on.
+ */
+struct I2SPLLSetting {
+    uint32_t sample_rate;
+    uint16_t plli2s_n;
+    uint8_t plli2s_r;
+};
+static const I2SPLLSetting i2s_pll_settings[] = {
+    {8000, 256, 5},
+    {16000, 213, 2},
+    {22050, 429, 4},
+    {32000, 213, 2},
+    {44100, 271, 2},
+    {48000, 258, 3},
+    {96000, 344, 2},
+};
+
+/******************************** Local Variables **************************************/
+/* create the pins. The codec control port is on I2C1 and its audio port on I2S3 */
+static HAL::AlternateModePin i2c_1_scl(
+    GPIOB, HAL::Pins::pin_6, HAL::PinMode::alternate, HAL::Speed::high, HAL::PullMode::none, HAL::OutputMode::open_drain, HAL::AlternateMode::af4);
+static HAL::AlternateModePin i2c_1_sda(
+    GPIOB, HAL::Pins::pin_9, HAL::PinMode::alternate, HAL::Speed::high, HAL::PullMode::none, HAL::OutputMode::open_drain, HAL::AlternateMode::af4);
+static HAL::AlternateModePin i2s_3_ws(
+    GPIOA, HAL::Pins::pin_4, HAL::PinMode::alternate, HAL::Speed::very_high, HAL::PullMode::none, HAL::OutputMode::push_pull, HAL::AlternateMode::af6);
+static HAL::AlternateModePin i2s_3_mck(
+    GPIOC, HAL::Pins::pin_7, HAL::PinMode::alternate, HAL::Speed::very_high, HAL::PullMode::none, HAL::OutputMode::push_pull, HAL::AlternateMode::af6);
+static HAL::AlternateModePin i2s_3_sck(
+    GPIOC, HAL::Pins::pin_10, HAL::PinMode::alternate, HAL::Speed::very_high, HAL::PullMode::none, HAL::OutputMode::push_pull, HAL::AlternateMode::af6);
+static HAL::AlternateModePin i2s_3_sd(
+    GPIOC, HAL::Pins::pin_12, HAL::PinMode::alternate, HAL::Speed::very_high, HAL::PullMode::none, HAL::OutputMode::push_pull, HAL::AlternateMode::af6);
+static HAL::OutputPin
+    codec_reset(GPIOD, HAL::Pins::pin_4, HAL::PinMode::output, HAL::Speed::low, HAL::PullMode::pull_down, HAL::OutputMode::push_pull);
+
+static HAL::I2CPolling codec_bus(I2C1, HAL::Clocks::APB1);
+static CS43L22 codec(codec_bus, codec_reset);
+
+/* SPI3_TX is on DMA1 stream 5, channel 0 */
+static HAL::I2STransmitter i2s_3(SPI3, HAL::DMAStream(DMA1, DMA1_Stream5, 5, HAL::DMAChannel::channel_0));
+
+/******************************* Global Variables **************************************/
+AudioOutput audio_output(i2s_3, codec);
+
+/****************************** Functions Definition ***********************************/
+/**
+ * \brief Construct a new AudioOutput object
+ *
+ * \param i2s the I2S transmitter wired to the codec
+ * \param codec the codec
+ */
+AudioOutput::AudioOutput(HAL::I2STransmitter& i2s, CS43L22& codec)
+    : i2s(i2s)
+    , codec(codec)
+    , block_free(0, 1)
+    , free_block(0)
+    , acquired_block(0)
+    , submitted{false, false}
+    , blocks_played(0)
+    , underruns(0)
+    , running(false)
+    , samples{} { }
+
+/**
+ * \brief set up the codec and register the stream interrupt. Playback is started separately with start.
+ *
+ * \retval true if the codec was found and configured
+ */
+bool AudioOutput::initialize(void) {
+    using namespace HAL;
+
+    /* the control port is only clocked while it is in use, so it doesn't hold the core out of STOP mode */
+    reset_control_clock.request_clock(APB1Clocks::i2c_1);
+    codec_bus.initialize(I2CSpeed::standard);
+    bool found = this->codec.initialize();
+    reset_control_clock.release_clock(APB1Clocks::i2c_1);
+
+    this->i2s.set_callback(on_block_played, this);
+    interrupt_manager.register_direct_callback<i2s_3, I2STransmitter::stream_irq_type>(InterruptName::dma_1_stream_5, PreemptionPriority::level_2);
+    return found;
+}
+
+/**
+ * \brief start the I2S clocks and play silence until the producer submits its first block. The I2S clocks keep
+ *        running until stop, and their requests keep the core out of STOP mode for as long.
+ *
+ * \param sample_rate frames per second, one of the rates in the I2S PLL table
+ * \retval true if playback started
+ */
+bool AudioOutput::start(uint32_t sample_rate) {
+    using namespace HAL;
+
+    const I2SPLLSetting* setting = nullptr;
+    for ( const auto& candidate : i2s_pll_settings ) {
+        if ( candidate.sample_rate == sample_rate ) {
+            setting = &candidate;
+        }
+    }
+    if ( setting == nullptr ) {
+        return false;
+    }
+
+    this->stop();
+    reset_control_clock.configure_i2s_pll(setting->plli2s_n, setting->plli2s_r);
+    reset_control_clock.start_i2s_pll();
+    reset_control_clock.request_clock(APB1Clocks::spi_3);
+    reset_control_clock.request_clock(AHB1Clocks::dma_1);
+    this->running = true;
+    if ( !this->i2s.configure(I2SStandard::philips, sample_rate, true) ) {
+        this->stop();
+        return false;
+    }
+
+    /* block 0 plays first, so the producer starts on block 1 */
+    memset(this->samples, 0, sizeof(this->samples));
+    this->submitted[0] = false;
+    this->submitted[1] = false;
+    this->free_block = 1;
+    this->blocks_played = 0;
+    this->underruns = 0;
+    while ( this->block_free.try_wait() ) {
+    }
+    this->block_free.signal();
+
+    if ( !this->i2s.start(&this->samples[0][0], block_count * block_samples, DMAPriority::very_high) ) {
+        this->stop();
+        return false;
+    }
+
+    /* the codec only powers up cleanly once MCLK is running */
+    reset_control_clock.request_clock(APB1Clocks::i2c_1);
+    bool powered = this->codec.power_up();
+    reset_control_clock.release_clock(APB1Clocks::i2c_1);
+    if ( !powered ) {
+        this->stop();
+    }
+    return powered;
+}
+
+/**
+ * \brief power the codec down and stop the I2S clocks. A producer waiting in acquire_block times out.
+ */
+void AudioOutput::stop(void) {
+    using namespace HAL;
+    if ( !this->running ) {
+        return;
+    }
+
+    reset_control_clock.request_clock(APB1Clocks::i2c_1);
+    this->codec.power_down();
+    reset_control_clock.release_clock(APB1Clocks::i2c_1);
+
+    this->i2s.stop();
+    reset_control_clock.release_clock(AHB1Clocks::dma_1);
+    reset_control_clock.release_clock(APB1Clocks::spi_3);
+    reset_control_clock.stop_i2s_pll();
+    this->running = false;
+}
+
+/**
+ * \brief wait for a block that has finished playing and can be refilled. Only one thread should produce.
+ *
+ * \param ticks max ticks to wait
+ * \retval int16_t* the block of block_samples interleaved samples to fill, or nullptr on timeout
+ */
+int16_t* AudioOutput::acquire_block(uint32_t ticks) {
+    if ( !this->block_free.wait_for(ticks) ) {
+        return nullptr;
+    }
+    this->acquired_block = this->free_block;
+    return &this->samples[this->acquired_block][0];
+}
+
+/**
+ * \brief hand the block from acquire_block back to be played
+ */
+void AudioOutput::submit_block(void) {
+    this->submitted[this->acquired_block] = true;
+}
+
+/**
+ * \brief set the master volume
+ *
+ * \param half_db the gain in half dB steps, see CS43L22::set_volume
+ * \retval true if the codec acknowledged
+ */
+bool AudioOutput::set_volume(int16_t half_db) {
+    HAL::reset_control_clock.request_clock(HAL::APB1Clocks::i2c_1);
+    bool success = this->codec.set_volume(half_db);
+    HAL::reset_control_clock.release_clock(HAL::APB1Clocks::i2c_1);
+    return success;
+}
+
+/**
+ * \brief take a consistent copy of the pipeline counters
+ *
+ * \retval AudioStats the counters
+ */
+AudioStats AudioOutput::get_stats(void) {
+    os::critical_section critical;
+    return AudioStats{this->blocks_played, this->underruns, this->running ? this->i2s.get_sample_rate() : 0};
+}
+
+/**
+ * \brief called from the stream interrupt each time a block has been played, just as the other one starts. The
+ *        other block is checked for an underrun, and the played one is silenced and handed to the producer. If the
+ *        producer is more than a block behind it always gets the block that will play last, so it catches up
+ *        rather than writing into the one playing.
+ *
+ * \param context the audio output
+ * \param block the block that has just been played
+ */
+void AudioOutput::on_block_played(void* context, uint8_t block) {
+    auto self = static_cast<AudioOutput*>(context);
+    uint8_t playing = block ^ 0x01;
+    if ( !self->submitted[playing] ) {
+        self->underruns++;
+    }
+
+    self->blocks_played++;
+    self->submitted[block] = false;
+    memset(&self->samples[block][0], 0, sizeof(self->samples[block]));
+    self->free_block = block;
+    self->block_free.signal_from_isr();
+}
@@ -0,0 +1,75 @@
+/*! \file audio_output.h
+*
+*  \brief audio output pipeline functions and variables declarations.
+*
+*
+*  \author Graham Riches
+*/
+
+#pragma once
+
+/********************************** Includes *******************************************/
+#include "common.h"
+#include "cs43l22.h"
+#include "hal_i2s.h"
+#include "os_semaphore.h"
+
+/*********************************** Consts ********************************************/
+
+/************************************ Types ********************************************/
+/**
+ * \brief a consistent snapshot of the pipeline's counters
+ */
+struct AudioStats {
+    uint32_t blocks_played;  //!< blocks the DMA has finished with since start, submitted or not
+    uint32_t underruns;      //!< blocks that started playing before the producer had submitted them
+    uint32_t sample_rate;    //!< actual rate the I2S prescalers divide down to, 0 while stopped
+};
+
+/**
+ * \brief double buffered audio output to the CS43L22 headphone amplifier. The DMA plays one block of the buffer
+ *        while a producer thread fills the other, and the half and complete transfer interrupts hand each block
+ *        back as soon as it has been played. A producer that doesn't submit a block in time is counted as an
+ *        underrun, and the block plays silence rather than repeating the old audio.
+ *
+ *        The producer loop is: acquire_block, write block_samples interleaved left/right samples, submit_block.
+ *        With 256 frame blocks at 48 kHz each block has to be ready within 5.3 ms of the last.
+ */
+class AudioOutput {
+  public:
+    static constexpr size_t block_frames = 256;
+    static constexpr size_t channel_count = 2;
+    static constexpr size_t block_samples = block_frames * channel_count;
+    static constexpr uint8_t block_count = 2;
+
+  private:
+    /* private data */
+    HAL::I2STransmitter& i2s;
+    CS43L22& codec;
+    os::semaphore block_free;        //!< signalled from the DMA interrupt each time a block has been played
+    volatile uint8_t free_block;     //!< the block most recently handed back, which the next acquire gets
+    uint8_t acquired_block;          //!< the block the producer is filling
+    volatile bool submitted[block_count];
+    volatile uint32_t blocks_played;
+    volatile uint32_t underruns;
+    bool running;
+    int16_t samples[block_count][block_samples];
+
+    /* private methods */
+    static void on_block_played(void* context, uint8_t block);
+
+  public:
+    AudioOutput(HAL::I2STransmitter& i2s, CS43L22& codec);
+    bool initialize(void);
+    bool start(uint32_t sample_rate);
+    void stop(void);
+    int16_t* acquire_block(uint32_t ticks);
+    void submit_block(void);
+    bool set_volume(int16_t half_db);
+    AudioStats get_stats(void);
+};
+
+/*********************************** Macros ********************************************/
+
+/******************************* Global Variables **************************************/
+extern AudioOutput audio_output;
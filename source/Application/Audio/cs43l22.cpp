@@ -0,0 +1,153 @@
+/*! \file cs43l22.cpp
+*
+*  \brief CS43L22 audio codec control over I2C.
+*
+*
+*  \author Graham Riches
+*/
+
+/********************************** Includes *******************************************/
+#include "cs43l22.h"
+
+/*********************************** Consts ********************************************/
+constexpr uint8_t device_address = 0x94;       //!< 8-bit write address with the AD0 pin low
+constexpr uint8_t chip_id_mask = 0xf8;
+constexpr uint8_t chip_id_value = 0xe0;
+constexpr uint8_t power_down_value = 0x01;
+constexpr uint8_t power_up_value = 0x9e;
+constexpr uint8_t headphone_on_speaker_off = 0xaf;
+constexpr uint8_t auto_detect_clock = 0x80;    //!< work the internal dividers out from MCLK
+constexpr uint8_t i2s_16_bit_slave = 0x04;     //!< I2S format, 16-bit words, slave to the bit clock
+constexpr uint8_t headphone_mute = 0xc0;
+constexpr uint8_t headphone_volume_0db = 0x00;
+
+/**
+ * \brief the required initialization settings from the data sheet, which have to go to undocumented registers
+ *        each time the codec comes out of reset
+ */
+struct RegisterWrite {
+    uint8_t reg;
+    uint8_t value;
+};
+static const RegisterWrite required_settings[] = {
+    {0x00, 0x99},
+    {0x47, 0x80},
+    {0x32, 0xbb},
+    {0x32, 0x3b},
+    {0x00, 0x00},
+};
+
+/****************************** Function Definitions ***********************************/
+/**
+ * \brief Construct a new CS43L22 object
+ *
+ * \param bus the I2C bus the codec's control port is on
+ * \param reset the codec's active low reset line
+ */
+CS43L22::CS43L22(HAL::I2CPolling& bus, HAL::OutputPin reset)
+    : bus(bus)
+    , reset(reset) { }
+
+/**
+ * \brief bring the codec out of reset and set it up for 16-bit I2S into the headphone output. The reset line
+ *        is low from when its pin is set up at startup, so the codec has long since been held in reset. The codec
+ *        stays powered down until power_up, which should only be called once MCLK and the I2S clocks are running.
+ *
+ * \retval true if the codec answered with the right chip id and took every setting
+ */
+bool CS43L22::initialize(void) {
+    this->reset.set(true);
+
+    uint8_t chip_id = 0;
+    if ( !this->read_register(CS43L22Registers::chip_id, chip_id) || ((chip_id & chip_id_mask) != chip_id_value) ) {
+        return false;
+    }
+
+    bool success = this->write_register(CS43L22Registers::power_control_1, power_down_value);
+    for ( const auto& setting : required_settings ) {
+        success = success && this->write_register(setting.reg, setting.value);
+    }
+    success = success && this->write_register(CS43L22Registers::power_control_2, headphone_on_speaker_off)
+              && this->write_register(CS43L22Registers::clocking_control, auto_detect_clock)
+              && this->write_register(CS43L22Registers::interface_control_1, i2s_16_bit_slave)
+              && this->write_register(CS43L22Registers::headphone_volume_a, headphone_volume_0db)
+              && this->write_register(CS43L22Registers::headphone_volume_b, headphone_volume_0db);
+    return success && this->set_volume(0);
+}
+
+/**
+ * \brief power the codec up to start playing
+ *
+ * \retval true if the codec acknowledged
+ */
+bool CS43L22::power_up(void) {
+    return this->write_register(CS43L22Registers::power_control_1, power_up_value);
+}
+
+/**
+ * \brief power the codec down, which ramps the output to avoid a pop. Stop the I2S clocks only after this.
+ *
+ * \retval true if the codec acknowledged
+ */
+bool CS43L22::power_down(void) {
+    return this->write_register(CS43L22Registers::power_control_1, power_down_value);
+}
+
+/**
+ * \brief set the master volume of both channels
+ *
+ * \param half_db the gain in half dB steps from min_volume to max_volume, clamped to that range
+ * \retval true if the codec acknowledged
+ */
+bool CS43L22::set_volume(int16_t half_db) {
+    half_db = (half_db < min_volume) ? min_volume : ((half_db > max_volume) ? max_volume : half_db);
+
+    /* the register is the gain in half dB as a signed byte, except that +12dB wraps round into the positive range */
+    uint8_t value = static_cast<uint8_t>(half_db);
+    return this->write_register(CS43L22Registers::master_volume_a, value) && this->write_register(CS43L22Registers::master_volume_b, value);
+}
+
+/**
+ * \brief mute or unmute the headphone output
+ *
+ * \param mute true to mute
+ * \retval true if the codec acknowledged
+ */
+bool CS43L22::set_mute(bool mute) {
+    return this->write_register(CS43L22Registers::playback_control_2, mute ? headphone_mute : 0x00);
+}
+
+/**
+ * \brief read a register
+ *
+ * \param reg the register
+ * \param value where to store the value
+ * \retval true if the codec acknowledged
+ */
+bool CS43L22::read_register(CS43L22Registers reg, uint8_t& value) {
+    uint8_t address = static_cast<uint8_t>(reg);
+    return this->bus.write_read(device_address, &address, 1, &value, 1);
+}
+
+/**
+ * \brief write a register by address, for the undocumented ones in the required settings
+ *
+ * \param reg the register address
+ * \param value the value
+ * \retval true if the codec acknowledged
+ */
+bool CS43L22::write_register(uint8_t reg, uint8_t value) {
+    uint8_t data[] = {reg, value};
+    return this->bus.write(device_address, data, sizeof(data));
+}
+
+/**
+ * \brief write a register
+ *
+ * \param reg the register
+ * \param value the value
+ * \retval true if the codec acknowledged
+ */
+bool CS43L22::write_register(CS43L22Registers reg, uint8_t value) {
+    return this->write_register(static_cast<uint8_t>(reg), value);
+}
@@ -0,0 +1,66 @@
+/*! \file cs43l22.h
+*
+*  \brief CS43L22 audio codec control functions and variables declarations.
+*
+*
+*  \author Graham Riches
+*/
+
+#pragma once
+
+/********************************** Includes *******************************************/
+#include "common.h"
+#include "hal_gpio.h"
+#include "hal_i2c.h"
+
+/*********************************** Consts ********************************************/
+
+/************************************ Types ********************************************/
+/**
+ * \brief enumeration of register addresses
+ * \note currently only contains select registers
+ */
+enum class CS43L22Registers : unsigned {
+    chip_id = 0x01,
+    power_control_1 = 0x02,
+    power_control_2 = 0x04,
+    clocking_control = 0x05,
+    interface_control_1 = 0x06,
+    playback_control_2 = 0x0f,
+    master_volume_a = 0x20,
+    master_volume_b = 0x21,
+    headphone_volume_a = 0x22,
+    headphone_volume_b = 0x23,
+};
+
+/**
+ * \brief control side of the CS43L22 stereo DAC, set up as an I2S slave driving the headphone output. The audio
+ *        itself arrives over I2S and the codec works its clocks out from the MCLK it is given.
+ */
+class CS43L22 {
+  public:
+    static constexpr int16_t min_volume = -203;  //!< in half dB steps, -101.5dB
+    static constexpr int16_t max_volume = 24;    //!< in half dB steps, +12dB
+
+  private:
+    /* private data */
+    HAL::I2CPolling& bus;
+    HAL::OutputPin reset;
+
+    /* private methods */
+    bool read_register(CS43L22Registers reg, uint8_t& value);
+    bool write_register(uint8_t reg, uint8_t value);
+    bool write_register(CS43L22Registers reg, uint8_t value);
+
+  public:
+    CS43L22(HAL::I2CPolling& bus, HAL::OutputPin reset);
+    bool initialize(void);
+    bool power_up(void);
+    bool power_down(void);
+    bool set_volume(int16_t half_db);
+    bool set_mute(bool mute);
+};
+
+/*********************************** Macros ********************************************/
+
+/******************************* Global Variables **************************************/
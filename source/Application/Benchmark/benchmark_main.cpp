@@ -0,0 +1,234 @@
+/*! \file benchmark_main.cpp
+*
+*  \brief entry point for the benchmark firmware. Brings the board up the same way as the application, then a
+*         runner thread times the kernel primitives and drivers with the cycle counter and prints the results.
+*
+*
+*  \author Graham Riches
+*/
+
+/********************************** Includes *******************************************/
+#include "benchmark_runner.h"
+#include "common.h"
+#include "debug_port.h"
+#include "hal_interrupt.h"
+#include "lis3dsh.h"
+#include "os.h"
+#include "peripherals.h"
+#include "power_manager.h"
+#include "ring_buffer.h"
+#include "scheduler.h"
+#include "os_semaphore.h"
+#include "thread_impl.h"
+#include "cm4_port.h"
+
+/*********************************** Consts ********************************************/
+constexpr uint32_t runner_thread_id = 20;
+constexpr uint32_t ping_pong_thread_id = 21;
+constexpr uint32_t wake_thread_id = 22;
+constexpr uint8_t runner_thread_priority = 2;
+constexpr uint8_t wake_thread_priority = 3;  //!< above the runner so it is switched to straight from the interrupt
+constexpr uint16_t thread_stack_size = 512;
+constexpr uint32_t startup_delay_ticks = 1000;  //!< time for the bench script to open the port after a reset
+constexpr size_t copy_buffer_size = 1024;
+constexpr size_t copy_block_size = 256;
+
+/****************************** Functions Prototype ************************************/
+static void runner_thread_task(void* arguments);
+static void ping_pong_thread_task(void* arguments);
+static void wake_thread_task(void* arguments);
+static void context_switch_benchmark(os::cycle_stats& stats, uint32_t iterations);
+static void interrupt_wake_benchmark(os::cycle_stats& stats, uint32_t iterations);
+static void semaphore_ping_pong_benchmark(os::cycle_stats& stats, uint32_t iterations);
+static void ring_buffer_copy_benchmark(os::cycle_stats& stats, uint32_t iterations);
+static void accelerometer_read_benchmark(os::cycle_stats& stats, uint32_t iterations);
+
+/************************************ Types ********************************************/
+/**
+ * \brief software triggered interrupt that wakes the wake thread. The hash/rng interrupt is unused on this board,
+ *        so pending it in the NVIC is the only way it fires.
+ */
+class WakeInterrupt : public HAL::InterruptPeripheral {
+  public:
+    void irq_handler(uint8_t type) override;
+};
+
+/******************************** Local Variables **************************************/
+static constexpr BenchmarkCase benchmarks[] = {
+    {"context_switch_round_trip", 1000, context_switch_benchmark},
+    {"isr_to_thread_wake", 1000, interrupt_wake_benchmark},
+    {"semaphore_ping_pong", 1000, semaphore_ping_pong_benchmark},
+    {"ring_buffer_bulk_copy_256", 1000, ring_buffer_copy_benchmark},
+    {"lis3dsh_read_register", 100, accelerometer_read_benchmark},
+};
+
+/* the runner stack stays in SRAM rather than the core coupled memory, as the accelerometer register reads put
+   their DMA buffers on the caller's stack */
+static uint32_t runner_thread_stack[thread_stack_size] = {0};
+static os::thread runner_thread(runner_thread_task, nullptr, runner_thread_id, runner_thread_stack, thread_stack_size,
+                                runner_thread_priority);
+CCM_RAM static uint32_t ping_pong_thread_stack[thread_stack_size] = {0};
+CCM_RAM static os::thread ping_pong_thread(ping_pong_thread_task, nullptr, ping_pong_thread_id, ping_pong_thread_stack,
+                                           thread_stack_size, runner_thread_priority);
+CCM_RAM static uint32_t wake_thread_stack[thread_stack_size] = {0};
+CCM_RAM static os::thread wake_thread(wake_thread_task, nullptr, wake_thread_id, wake_thread_stack, thread_stack_size,
+                                      wake_thread_priority);
+
+static os::semaphore ping(0, 1);
+static os::semaphore pong(0, 1);
+static os::semaphore wake(0, 1);
+static volatile uint32_t wake_start_cycles;
+static volatile uint32_t wake_cycles;
+static WakeInterrupt wake_interrupt;
+
+static RingBuffer<uint8_t, copy_buffer_size> copy_buffer;
+static uint8_t copy_source[copy_block_size];
+static uint8_t copy_destination[copy_block_size];
+
+/****************************** Functions Definition ***********************************/
+/**
+  * \brief  benchmark firmware main
+  * \retval int
+  */
+int main(void) {
+    //!< the runner pends the context switch itself, which needs the system control block
+    runner_thread.set_privileged(true);
+    os::scheduler::register_new_thread(&runner_thread);
+    os::scheduler::register_new_thread(&ping_pong_thread);
+    os::scheduler::register_new_thread(&wake_thread);
+
+    //!< configure the project specific HAL drivers and bootup the chip, clocks etc.
+    initialize_peripherals();
+    HAL::interrupt_manager.register_direct_callback<wake_interrupt, 0>(HAL::InterruptName::hash_random_number,
+                                                                       HAL::PreemptionPriority::level_2);
+
+    //!< jump into the RTOS kernel
+    os::kernel::setup();
+    os::kernel::enter();
+
+    //!< NOTE: should never reach here
+    return 0;
+}
+
+/**
+ * \brief stamp the interrupt and wake the wake thread
+ *
+ * \param type not used
+ */
+void WakeInterrupt::irq_handler(uint8_t type) {
+    PARAMETER_NOT_USED(type);
+    wake_start_cycles = benchmark_cycles();
+    wake.signal_from_isr();
+}
+
+/**
+ * \brief runner thread. Runs the benchmarks once at full speed, then idles until the next reset.
+ *
+ * \param arguments not used
+ */
+static void runner_thread_task(void* arguments) {
+    PARAMETER_NOT_USED(arguments);
+    os::scheduler::sleep(startup_delay_ticks);
+
+    request_full_performance();
+    run_benchmarks(debug_port, benchmarks, sizeof(benchmarks) / sizeof(benchmarks[0]));
+    release_full_performance();
+
+    while ( true ) {
+        os::scheduler::sleep(startup_delay_ticks);
+    }
+}
+
+/**
+ * \brief the other end of the semaphore ping-pong, answers every ping with a pong
+ *
+ * \param arguments not used
+ */
+static void ping_pong_thread_task(void* arguments) {
+    PARAMETER_NOT_USED(arguments);
+    while ( true ) {
+        ping.wait();
+        pong.signal();
+    }
+}
+
+/**
+ * \brief waits for the wake interrupt and records how long after the interrupt it got to run
+ *
+ * \param arguments not used
+ */
+static void wake_thread_task(void* arguments) {
+    PARAMETER_NOT_USED(arguments);
+    while ( true ) {
+        wake.wait();
+        wake_cycles = benchmark_cycles() - wake_start_cycles;
+    }
+}
+
+/**
+ * \brief pend a context switch back into the runner itself, which saves and restores the full thread context
+ *        without a scheduling decision. The scheduler's pending task is already the runner while it is running.
+ */
+static void context_switch_benchmark(os::cycle_stats& stats, uint32_t iterations) {
+    for ( uint32_t iteration = 0; iteration < iterations; iteration++ ) {
+        uint32_t start = benchmark_cycles();
+        os::set_pending_context_switch();
+        __DSB();
+        __ISB();
+        stats.record(benchmark_cycles() - start);
+    }
+}
+
+/**
+ * \brief from the start of the interrupt handler to the higher priority thread it signals starting to run
+ */
+static void interrupt_wake_benchmark(os::cycle_stats& stats, uint32_t iterations) {
+    for ( uint32_t iteration = 0; iteration < iterations; iteration++ ) {
+        NVIC_SetPendingIRQ(HASH_RNG_IRQn);
+        __DSB();
+        __ISB();
+
+        /* the wake thread has run and blocked again by the time the runner gets back here */
+        stats.record(wake_cycles);
+    }
+}
+
+/**
+ * \brief a full round trip between two threads of the same priority, handing a semaphore each way. This is
+ *        two semaphore handoffs and two context switches.
+ */
+static void semaphore_ping_pong_benchmark(os::cycle_stats& stats, uint32_t iterations) {
+    for ( uint32_t iteration = 0; iteration < iterations; iteration++ ) {
+        uint32_t start = benchmark_cycles();
+        ping.signal();
+        pong.wait();
+        stats.record(benchmark_cycles() - start);
+    }
+}
+
+/**
+ * \brief push and pop a block through a byte ring buffer in SRAM. The read and write sides are kept a byte
+ *        apart, so every few blocks the copies split at the wrap.
+ */
+static void ring_buffer_copy_benchmark(os::cycle_stats& stats, uint32_t iterations) {
+    copy_buffer.push(0);
+    for ( uint32_t iteration = 0; iteration < iterations; iteration++ ) {
+        uint32_t start = benchmark_cycles();
+        copy_buffer.push_bulk(copy_source, copy_block_size);
+        copy_buffer.pop_bulk(copy_destination, copy_block_size);
+        stats.record(benchmark_cycles() - start);
+    }
+    copy_buffer.pop();
+}
+
+/**
+ * \brief read the accelerometer's who am I register, which is one full SPI transaction through the bus queue
+ *        and DMA
+ */
+static void accelerometer_read_benchmark(os::cycle_stats& stats, uint32_t iterations) {
+    for ( uint32_t iteration = 0; iteration < iterations; iteration++ ) {
+        uint32_t start = benchmark_cycles();
+        accelerometer.self_test();
+        stats.record(benchmark_cycles() - start);
+    }
+}
@@ -0,0 +1,84 @@
+/*! \file benchmark_runner.cpp
+*
+*  \brief runs a table of on-target micro-benchmarks and streams the results over the debug port.
+*
+*
+*  \author Graham Riches
+*/
+
+/********************************** Includes *******************************************/
+#include "benchmark_runner.h"
+#include "hal_rcc.h"
+#include <cinttypes>
+#include <cstdio>
+
+/*********************************** Consts ********************************************/
+constexpr uint32_t output_timeout_ticks = 100;
+constexpr uint8_t overhead_samples = 16;
+
+/****************************** Functions Prototype ************************************/
+static uint32_t measure_counter_overhead(void);
+static void report_result(DebugPort& port, const BenchmarkCase& benchmark, const os::cycle_stats& stats);
+
+/******************************** Local Variables **************************************/
+static char output[256];
+
+/****************************** Functions Definition ***********************************/
+/**
+ * \brief run every benchmark in turn and print a line for each, between a begin and an end line
+ *
+ * \param port the debug port to print to
+ * \param cases the benchmarks
+ * \param count number of benchmarks
+ */
+void run_benchmarks(DebugPort& port, const BenchmarkCase* cases, size_t count) {
+    snprintf(output, sizeof(output), "{\"type\":\"begin\",\"benchmarks\":%u,\"core_hz\":%" PRIu32 ",\"counter_overhead\":%" PRIu32 "}\n",
+             static_cast<unsigned>(count), HAL::reset_control_clock.get_clock_speed(HAL::Clocks::AHB1), measure_counter_overhead());
+    port.write(output, output_timeout_ticks);
+
+    for ( size_t index = 0; index < count; index++ ) {
+        os::cycle_stats stats;
+        cases[index].run(stats, cases[index].iterations);
+        report_result(port, cases[index], stats);
+    }
+
+    port.write("{\"type\":\"end\"}\n", output_timeout_ticks);
+}
+
+/**
+ * \brief measure the smallest gap between two back to back reads of the cycle counter
+ *
+ * \retval uint32_t overhead in cycles
+ */
+static uint32_t measure_counter_overhead(void) {
+    uint32_t overhead = UINT32_MAX;
+    for ( uint8_t sample = 0; sample < overhead_samples; sample++ ) {
+        uint32_t start = benchmark_cycles();
+        uint32_t cycles = benchmark_cycles() - start;
+        overhead = (cycles < overhead) ? cycles : overhead;
+    }
+    return overhead;
+}
+
+/**
+ * \brief print one benchmark's stats as a json line, with the histogram buckets as an array
+ *
+ * \param port the debug port to print to
+ * \param benchmark the benchmark
+ * \param stats its samples
+ */
+static void report_result(DebugPort& port, const BenchmarkCase& benchmark, const os::cycle_stats& stats) {
+    int length = snprintf(output, sizeof(output),
+                          "{\"type\":\"result\",\"name\":\"%s\",\"samples\":%" PRIu32 ",\"min\":%" PRIu32 ",\"max\":%" PRIu32
+                          ",\"mean\":%" PRIu32 ",\"unit\":\"cycles\",\"histogram\":[",
+                          benchmark.name, stats.get_count(), stats.get_min(), stats.get_max(), stats.get_mean());
+
+    for ( uint8_t bucket = 0; (bucket < os::cycle_stats::histogram_buckets) && (length < static_cast<int>(sizeof(output))); bucket++ ) {
+        length += snprintf(&output[length], sizeof(output) - length, "%s%" PRIu32, (bucket == 0) ? "" : ",",
+                           stats.get_histogram_count(bucket));
+    }
+    if ( length < static_cast<int>(sizeof(output)) ) {
+        snprintf(&output[length], sizeof(output) - length, "]}\n");
+    }
+    port.write(output, output_timeout_ticks);
+}
@@ -0,0 +1,47 @@
+/*! \file benchmark_runner.h
+*
+*  \brief runs a table of on-target micro-benchmarks and streams the results over the debug port. Each result is
+*         one JSON object per line so a bench script can pick them out of the rest of the port traffic.
+*
+*
+*  \author Graham Riches
+*/
+
+#pragma once
+
+/********************************** Includes *******************************************/
+#include "common.h"
+#include "cycle_stats.h"
+#include "debug_port.h"
+#include "stm32f4xx.h"
+
+/************************************ Types ********************************************/
+/**
+ * \brief one registered benchmark. The run function times each iteration with benchmark_cycles() and records it.
+ */
+struct BenchmarkCase {
+    const char* name;
+    uint32_t iterations;
+    void (*run)(os::cycle_stats& stats, uint32_t iterations);
+};
+
+/****************************** Functions Prototype ************************************/
+/**
+ * \brief read the DWT cycle counter, which the kernel enables during setup
+ *
+ * \retval uint32_t cycle count
+ */
+static inline uint32_t benchmark_cycles(void) {
+    return DWT->CYCCNT;
+}
+
+/**
+ * \brief run every benchmark in turn and print a line for each, between a begin and an end line
+ *
+ * \param port the debug port to print to
+ * \param cases the benchmarks
+ * \param count number of benchmarks
+ * \note the samples are raw cycle counts and include the cost of reading the counter, which is reported once
+ *       in the begin line. Ticks and other interrupts landing in a sample show up in the max and the histogram.
+ */
+void run_benchmarks(DebugPort& port, const BenchmarkCase* cases, size_t count);
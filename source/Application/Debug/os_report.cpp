@@ -0,0 +1,145 @@
+/*! \file os_report.cpp
+*
+*  \brief kernel diagnostics reports printed over the debug port.
+*
+*
+*  \author Graham Riches
+*/
+
+/********************************** Includes *******************************************/
+#include "os_report.h"
+#include "profiler.h"
+#include "scheduler.h"
+#include <cinttypes>
+
+/****************************** Functions Prototype ************************************/
+static void report_cycle_stats(DebugPort& port, const char* name, const os::cycle_stats& stats);
+static void report_thread(DebugPort& port, uint32_t id, const os::scheduler::ThreadStats& stats, uint64_t total_cycles);
+
+/****************************** Functions Definition ***********************************/
+/**
+ * \brief print the kernel latency stats
+ * 
+ * \param port the debug port to print to
+ */
+void report_kernel_latency(DebugPort& port) {
+    report_cycle_stats(port, "tick", os::profiler::get_tick_stats());
+    report_cycle_stats(port, "scheduler", os::profiler::get_scheduler_stats());
+    report_cycle_stats(port, "context switch", os::profiler::get_context_switch_stats());
+}
+
+/**
+ * \brief print the thread run-time stats table
+ * 
+ * \param port the debug port to print to
+ */
+void report_thread_stats(DebugPort& port) {
+    /* snapshot every thread first so the percentages are all taken from roughly the same moment */
+    constexpr uint8_t max_report_threads = MAX_THREAD_COUNT + 1;
+    uint32_t ids[max_report_threads];
+    os::scheduler::ThreadStats stats[max_report_threads];
+    uint8_t count = 0;
+    uint64_t total_cycles = 0;
+
+    for ( uint8_t index = 0; (index < os::scheduler::get_thread_count()) && (count < max_report_threads - 1); index++ ) {
+        auto id = os::scheduler::get_thread_id(index);
+        auto thread_stats = id ? os::scheduler::get_thread_stats(id.value()) : std::nullopt;
+        if ( thread_stats ) {
+            ids[count] = id.value();
+            stats[count++] = thread_stats.value();
+        }
+    }
+
+    if ( auto idle_stats = os::scheduler::get_thread_stats(os::scheduler::get_internal_thread_id()); idle_stats ) {
+        ids[count] = os::scheduler::get_internal_thread_id();
+        stats[count++] = idle_stats.value();
+    }
+
+    for ( uint8_t thread = 0; thread < count; thread++ ) {
+        total_cycles += stats[thread].cycles_run;
+    }
+
+    port.info("%8s %6s %10s %10s %10s %10s", "id", "cpu", "switches", "preempted", "yielded", "last run");
+    for ( uint8_t thread = 0; thread < count; thread++ ) {
+        report_thread(port, ids[thread], stats[thread], total_cycles);
+    }
+}
+
+/**
+ * \brief print the stack usage table
+ * 
+ * \param port the debug port to print to
+ */
+void report_stack_usage(DebugPort& port) {
+    port.info("%8s %8s %8s %9s", "id", "used", "size", "overflow");
+    for ( uint8_t index = 0; index < os::scheduler::get_thread_count(); index++ ) {
+        os::thread* thread = os::scheduler::get_thread(index);
+        if ( thread == nullptr ) {
+            continue;
+        }
+        port.info("%8" PRIu32 " %8" PRIu32 " %8" PRIu32 " %9s", thread->get_id(), thread->get_stack_high_water_mark(),
+                  thread->get_stack_size(), thread->is_stack_overflowed() ? "yes" : "no");
+    }
+}
+
+/**
+ * \brief print a single row of the thread stats table
+ * 
+ * \param port the debug port to print to
+ * \param id the thread id
+ * \param stats the thread's stats
+ * \param total_cycles cycles run by all threads
+ */
+static void report_thread(DebugPort& port, uint32_t id, const os::scheduler::ThreadStats& stats, uint64_t total_cycles) {
+    /* usage in tenths of a percent to avoid pulling in floating point printf */
+    uint32_t permille = (total_cycles > 0) ? static_cast<uint32_t>((stats.cycles_run * 1000) / total_cycles) : 0;
+    port.info("%8" PRIu32 " %3" PRIu32 ".%" PRIu32 "%% %10" PRIu32 " %10" PRIu32 " %10" PRIu32 " %10" PRIu32,
+              id, permille / 10, permille % 10, stats.switched_in_count, stats.preempted_count, stats.yielded_count, stats.last_run_tick);
+}
+
+/**
+ * \brief print a summary line and the non-empty histogram buckets for a set of cycle stats
+ * 
+ * \param port the debug port to print to
+ * \param name name of the stats
+ * \param stats the stats to print
+ */
+static void report_cycle_stats(DebugPort& port, const char* name, const os::cycle_stats& stats) {
+    port.info("%s: samples=%" PRIu32 " min=%" PRIu32 " max=%" PRIu32 " mean=%" PRIu32 " cycles",
+              name, stats.get_count(), stats.get_min(), stats.get_max(), stats.get_mean());
+
+    for ( uint8_t bucket = 0; bucket < os::cycle_stats::histogram_buckets; bucket++ ) {
+        uint32_t count = stats.get_histogram_count(bucket);
+        if ( count == 0 ) {
+            continue;
+        }
+
+        /* the last bucket collects every sample past the top of the histogram */
+        if ( bucket == os::cycle_stats::histogram_buckets - 1 ) {
+            port.info("  >= %" PRIu32 " cycles: %" PRIu32, static_cast<uint32_t>(1ul << (bucket - 1)), count);
+        } else {
+            port.info("  < %" PRIu32 " cycles: %" PRIu32, static_cast<uint32_t>(1ul << bucket), count);
+        }
+    }
+}
+
+/**
+ * \brief print the stats of every interrupt that has run since the last reset
+ * 
+ * \param port the debug port to print to
+ */
+void report_irq_stats(DebugPort& port) {
+    port.info("%6s %4s %10s %8s %8s %10s %10s %5s", "vector", "irq", "count", "mean", "max", "min gap", "max gap", "nest");
+    for ( uint8_t vector = 0; vector < os::irq_stats::max_vectors; vector++ ) {
+        auto stats = os::profiler::get_irq_stats(vector);
+        if ( stats.count == 0 ) {
+            continue;
+        }
+        /* the interval is only known after a second entry */
+        uint32_t min_interval = (stats.count > 1) ? stats.min_interval : 0;
+        port.info("%6u %4d %10" PRIu32 " %8" PRIu32 " %8" PRIu32 " %10" PRIu32 " %10" PRIu32 " %5u", vector,
+                  static_cast<int>(vector) - 16, stats.count, stats.total_cycles / stats.count, stats.max_cycles,
+                  min_interval, stats.max_interval, stats.max_nesting);
+    }
+    port.info("max nesting: %u", os::profiler::get_irq_max_nesting());
+}
@@ -0,0 +1,46 @@
+/*! \file os_report.h
+*
+*  \brief kernel diagnostics reports printed over the debug port.
+*
+*
+*  \author Graham Riches
+*/
+
+#pragma once
+
+/********************************** Includes *******************************************/
+#include "common.h"
+#include "debug_port.h"
+
+/****************************** Functions Prototype ************************************/
+/**
+ * \brief print the tick, scheduler and context switch cycle counts collected by the kernel profiler
+ * 
+ * \param port the debug port to print to
+ * \note requires the kernel to be built with OS_PROFILING, otherwise all stats are empty
+ */
+void report_kernel_latency(DebugPort& port);
+
+/**
+ * \brief print a top-like table of the CPU usage and switch counts for every thread, including the
+ *        internal idle thread
+ * 
+ * \param port the debug port to print to
+ */
+void report_thread_stats(DebugPort& port);
+
+/**
+ * \brief print the peak stack usage of every thread, flagging any with a corrupted stack canary
+ * 
+ * \param port the debug port to print to
+ * \note peak usage needs OS_STACK_PAINTING, otherwise every stack is reported as fully used
+ */
+void report_stack_usage(DebugPort& port);
+
+/**
+ * \brief print the count, duration, arrival interval and nesting depth of every interrupt that has run
+ * 
+ * \param port the debug port to print to
+ * \note requires the kernel to be built with OS_IRQ_PROFILING, otherwise the table is empty
+ */
+void report_irq_stats(DebugPort& port);
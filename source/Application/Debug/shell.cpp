@@ -0,0 +1,401 @@
+/*! \file shell.cpp
+*
+*  \brief line based command shell on the debug port. The shell thread blocks on the debug port receive
+*         interrupts, so it costs nothing until a line comes in.
+*
+*
+*  \author Graham Riches
+*/
+
+/********************************** Includes *******************************************/
+#include "shell.h"
+#include "crash_dump.h"
+#include "hal_rcc.h"
+#include "kv_store.h"
+#include "log_sinks.h"
+#include "os_report.h"
+#include "power_manager.h"
+#include "scheduler.h"
+#include "thread_impl.h"
+#include "trace.h"
+#include "vibration.h"
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+/*********************************** Consts ********************************************/
+constexpr uint32_t shell_thread_id = 10;
+constexpr uint8_t shell_thread_priority = 1;  //!< just above the log thread
+constexpr uint16_t shell_thread_stack_size = 512;
+constexpr size_t max_line_length = 64;
+constexpr size_t max_arguments = 8;
+constexpr uint32_t output_timeout_ticks = 100;
+constexpr const char* prompt = "> ";
+
+/****************************** Functions Prototype ************************************/
+static void shell_thread_task(void* arguments);
+static void execute_line(char* line);
+static void shell_print(const char* format, ...) __attribute__((format(printf, 1, 2)));
+static void help_command(DebugPort& port, int argc, char* argv[]);
+static void threads_command(DebugPort& port, int argc, char* argv[]);
+static void stacks_command(DebugPort& port, int argc, char* argv[]);
+static void latency_command(DebugPort& port, int argc, char* argv[]);
+static void irqs_command(DebugPort& port, int argc, char* argv[]);
+static void crashlog_command(DebugPort& port, int argc, char* argv[]);
+static void vibration_command(DebugPort& port, int argc, char* argv[]);
+static void power_command(DebugPort& port, int argc, char* argv[]);
+static void trace_command(DebugPort& port, int argc, char* argv[]);
+static void crash_command(DebugPort& port, int argc, char* argv[]);
+static void settings_command(DebugPort& port, int argc, char* argv[]);
+static void print_trace_records(const os::trace_record* records, size_t count);
+
+/******************************** Local Variables **************************************/
+static constexpr ShellCommand commands[] = {
+    {"help", "list the commands", help_command},
+    {"threads", "print the cpu usage and switch counts of every thread", threads_command},
+    {"stacks", "print the peak stack usage of every thread", stacks_command},
+    {"latency", "print the kernel tick, scheduler and context switch cycle counts", latency_command},
+    {"irqs", "print the count, duration, arrival interval and nesting of every interrupt", irqs_command},
+    {"crashlog", "print the log kept from before the last reset, or 'crashlog clear' to discard it",
+     crashlog_command},
+    {"vibration", "print the strongest frequency on each accelerometer axis", vibration_command},
+    {"power", "print the clock level, STOP mode entries, wakeup times and clocks keeping the core awake", power_command},
+    {"trace", "print the latest kernel trace events, or 'trace start' and 'trace stop' to control the recorder",
+     trace_command},
+    {"crash", "print the latest crash dump, 'crash <n>' for an older one, or 'crash clear' to erase them", crash_command},
+    {"settings", "print the stored settings, or 'settings set <key> <hex bytes>' and 'settings remove <key>' to change them",
+     settings_command},
+};
+
+CCM_RAM static uint32_t shell_thread_stack[shell_thread_stack_size] = {0};
+CCM_RAM static os::thread shell_thread(shell_thread_task, nullptr, shell_thread_id, shell_thread_stack, shell_thread_stack_size,
+                               shell_thread_priority);
+static char line[max_line_length + 1];
+static char output[HAL::USARTInterrupt::buffer_size];
+
+/****************************** Functions Definition ***********************************/
+/**
+ * \brief register the shell thread
+ */
+void shell_initialize(void) {
+    /* the shell drives the debug port hardware directly, like the log thread */
+    shell_thread.set_privileged(true);
+    os::scheduler::register_new_thread(&shell_thread);
+}
+
+/**
+ * \brief shell thread. Echoes characters back as they are typed and runs each line when it ends.
+ *
+ * \param arguments not used
+ */
+static void shell_thread_task(void* arguments) {
+    PARAMETER_NOT_USED(arguments);
+    size_t line_length = 0;
+    uint8_t received[16];
+
+    debug_port.write(prompt, output_timeout_ticks);
+    while ( true ) {
+        size_t count = debug_port.read(received, sizeof(received), os::scheduler::wait_forever);
+        for ( size_t index = 0; index < count; index++ ) {
+            char character = static_cast<char>(received[index]);
+            if ( (character == '\r') || (character == '\n') ) {
+                debug_port.write("\r\n", output_timeout_ticks);
+                line[line_length] = '\0';
+                if ( line_length > 0 ) {
+                    execute_line(line);
+                }
+                line_length = 0;
+                debug_port.write(prompt, output_timeout_ticks);
+            } else if ( (character == '\b') || (character == 0x7F) ) {
+                if ( line_length > 0 ) {
+                    line_length--;
+                    debug_port.write("\b \b", output_timeout_ticks);
+                }
+            } else if ( (character >= ' ') && (line_length < max_line_length) ) {
+                line[line_length++] = character;
+                debug_port.write(reinterpret_cast<const uint8_t*>(&character), 1, output_timeout_ticks);
+            }
+        }
+    }
+}
+
+/**
+ * \brief split a line into arguments and run the command it names
+ *
+ * \param line the line, which is modified in place
+ */
+static void execute_line(char* line) {
+    char* argv[max_arguments];
+    int argc = 0;
+    char* save = nullptr;
+    for ( char* token = strtok_r(line, " \t", &save); (token != nullptr) && (argc < static_cast<int>(max_arguments));
+          token = strtok_r(nullptr, " \t", &save) ) {
+        argv[argc++] = token;
+    }
+
+    if ( argc == 0 ) {
+        return;
+    }
+
+    for ( const auto& command : commands ) {
+        if ( strcmp(command.name, argv[0]) == 0 ) {
+            command.handler(debug_port, argc, argv);
+            return;
+        }
+    }
+    shell_print("unknown command '%s', try 'help'\r\n", argv[0]);
+}
+
+/**
+ * \brief print formatted text straight to the debug port, skipping the deferred logger so replies come back in order
+ *
+ * \param format printf style format
+ * \param ... format arguments
+ */
+static void shell_print(const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(output, sizeof(output), format, args);
+    va_end(args);
+    if ( length > 0 ) {
+        size_t size = (static_cast<size_t>(length) < sizeof(output)) ? static_cast<size_t>(length) : sizeof(output) - 1;
+        debug_port.write(reinterpret_cast<const uint8_t*>(output), size, output_timeout_ticks);
+    }
+}
+
+/**
+ * \brief list the commands
+ */
+static void help_command(DebugPort& port, int argc, char* argv[]) {
+    PARAMETER_NOT_USED(port);
+    PARAMETER_NOT_USED(argc);
+    PARAMETER_NOT_USED(argv);
+    for ( const auto& command : commands ) {
+        shell_print("%-10s %s\r\n", command.name, command.help);
+    }
+}
+
+/**
+ * \brief print the thread stats table
+ */
+static void threads_command(DebugPort& port, int argc, char* argv[]) {
+    PARAMETER_NOT_USED(argc);
+    PARAMETER_NOT_USED(argv);
+    report_thread_stats(port);
+}
+
+/**
+ * \brief print the stack usage table
+ */
+static void stacks_command(DebugPort& port, int argc, char* argv[]) {
+    PARAMETER_NOT_USED(argc);
+    PARAMETER_NOT_USED(argv);
+    report_stack_usage(port);
+}
+
+/**
+ * \brief print the kernel latency stats
+ */
+static void latency_command(DebugPort& port, int argc, char* argv[]) {
+    PARAMETER_NOT_USED(argc);
+    PARAMETER_NOT_USED(argv);
+    report_kernel_latency(port);
+}
+
+/**
+ * \brief print the interrupt stats
+ */
+static void irqs_command(DebugPort& port, int argc, char* argv[]) {
+    PARAMETER_NOT_USED(argc);
+    PARAMETER_NOT_USED(argv);
+    report_irq_stats(port);
+}
+
+/**
+ * \brief print or clear the crash log
+ */
+static void crashlog_command(DebugPort& port, int argc, char* argv[]) {
+    PARAMETER_NOT_USED(port);
+    os::ram_log_sink crash_log;
+    if ( (argc > 1) && (strcmp(argv[1], "clear") == 0) ) {
+        crash_log.clear();
+        return;
+    }
+
+    /* copy the log out first so the output bypasses the shell print buffer, which is much smaller */
+    static char contents[os::ram_log_sink::capacity];
+    size_t size = crash_log.read(contents, sizeof(contents));
+    debug_port.write(reinterpret_cast<const uint8_t*>(contents), size, output_timeout_ticks);
+}
+
+/**
+ * \brief print the peak of the latest vibration spectrum for each axis, leaving out the DC bin
+ */
+static void vibration_command(DebugPort& port, int argc, char* argv[]) {
+    PARAMETER_NOT_USED(port);
+    PARAMETER_NOT_USED(argc);
+    PARAMETER_NOT_USED(argv);
+    static VibrationSpectrum spectrum;
+    get_vibration_spectrum(spectrum);
+    if ( spectrum.sequence == 0 ) {
+        shell_print("no spectrum yet\r\n");
+        return;
+    }
+
+    constexpr char axis_names[vibration_axes] = {'x', 'y', 'z'};
+    for ( size_t axis = 0; axis < vibration_axes; axis++ ) {
+        size_t peak = 1;
+        for ( size_t bin = 2; bin < vibration_bins; bin++ ) {
+            if ( spectrum.magnitudes[axis][bin] > spectrum.magnitudes[axis][peak] ) {
+                peak = bin;
+            }
+        }
+        shell_print("%c: bin %u magnitude %d\r\n", axis_names[axis], static_cast<unsigned>(peak), spectrum.magnitudes[axis][peak]);
+    }
+}
+
+/**
+ * \brief print the STOP mode stats. Wakeup times are in HSI cycles, so 16 per microsecond.
+ */
+static void power_command(DebugPort& port, int argc, char* argv[]) {
+    PARAMETER_NOT_USED(port);
+    PARAMETER_NOT_USED(argc);
+    PARAMETER_NOT_USED(argv);
+    constexpr uint32_t wakeup_cycles_per_us = 16;
+    auto stats = get_power_stats();
+    constexpr const char* level_names[] = {"full", "half", "low"};
+    shell_print("level: %s, stops: %lu, requested clocks: %u\r\n", level_names[static_cast<uint8_t>(stats.level)],
+                static_cast<unsigned long>(stats.stop_count), stats.requested_clock_count);
+    if ( stats.stop_count > 0 ) {
+        shell_print("wakeup us: min %lu mean %lu max %lu\r\n", static_cast<unsigned long>(stats.wakeup_cycles.get_min() / wakeup_cycles_per_us),
+                    static_cast<unsigned long>(stats.wakeup_cycles.get_mean() / wakeup_cycles_per_us),
+                    static_cast<unsigned long>(stats.wakeup_cycles.get_max() / wakeup_cycles_per_us));
+    }
+}
+
+/**
+ * \brief start or stop the trace recorder, or print its latest events with times relative to the first one
+ */
+static void trace_command(DebugPort& port, int argc, char* argv[]) {
+    PARAMETER_NOT_USED(port);
+    if ( (argc > 1) && (strcmp(argv[1], "start") == 0) ) {
+        os::trace::start(HAL::reset_control_clock.get_clock_speed(HAL::Clocks::AHB1));
+        return;
+    }
+    if ( (argc > 1) && (strcmp(argv[1], "stop") == 0) ) {
+        os::trace::stop();
+        return;
+    }
+
+    /* copy the events out first, printing them adds more */
+    constexpr size_t dump_count = 32;
+    static os::trace_record records[dump_count];
+    size_t count = os::trace::copy_latest(records, dump_count);
+    if ( count == 0 ) {
+        shell_print("no trace events, the kernel needs OS_TRACE and 'trace start'\r\n");
+        return;
+    }
+
+    print_trace_records(records, count);
+}
+
+/**
+ * \brief print a crash dump saved by the fault handler before a reset, or erase them all
+ */
+static void crash_command(DebugPort& port, int argc, char* argv[]) {
+    PARAMETER_NOT_USED(port);
+    if ( (argc > 1) && (strcmp(argv[1], "clear") == 0) ) {
+        shell_print(os::crash_dump::clear() ? "erased\r\n" : "erase failed\r\n");
+        return;
+    }
+
+    size_t count = os::crash_dump::get_count();
+    if ( count == 0 ) {
+        shell_print("no crash dumps\r\n");
+        return;
+    }
+
+    /* 0 is the latest, counting back */
+    size_t back = (argc > 1) ? strtoul(argv[1], nullptr, 0) : 0;
+    static os::crash_dump_record dump;
+    if ( (back >= count) || !os::crash_dump::read(count - 1 - back, dump) ) {
+        shell_print("%u crash dumps stored\r\n", static_cast<unsigned>(count));
+        return;
+    }
+
+    shell_print("dump %lu of %u: %s in thread %lu, tcb 0x%08lx\r\n", static_cast<unsigned long>(dump.sequence),
+                static_cast<unsigned>(count), os::get_fault_name(dump.fault), static_cast<unsigned long>(dump.thread_id),
+                static_cast<unsigned long>(dump.task_control_block));
+    shell_print("pc 0x%08lx lr 0x%08lx xpsr 0x%08lx sp 0x%08lx exc_return 0x%08lx\r\n",
+                static_cast<unsigned long>(dump.frame.return_address), static_cast<unsigned long>(dump.frame.lr),
+                static_cast<unsigned long>(dump.frame.xpsr), static_cast<unsigned long>(dump.stack_pointer),
+                static_cast<unsigned long>(dump.exc_return));
+    shell_print("r0 0x%08lx r1 0x%08lx r2 0x%08lx r3 0x%08lx r12 0x%08lx\r\n", static_cast<unsigned long>(dump.frame.r0),
+                static_cast<unsigned long>(dump.frame.r1), static_cast<unsigned long>(dump.frame.r2),
+                static_cast<unsigned long>(dump.frame.r3), static_cast<unsigned long>(dump.frame.r12));
+    shell_print("cfsr 0x%08lx hfsr 0x%08lx mmfar 0x%08lx bfar 0x%08lx\r\n", static_cast<unsigned long>(dump.cfsr),
+                static_cast<unsigned long>(dump.hfsr), static_cast<unsigned long>(dump.mmfar),
+                static_cast<unsigned long>(dump.bfar));
+    if ( dump.trace_count > 0 ) {
+        print_trace_records(dump.trace, (dump.trace_count < OS_CRASH_DUMP_TRACE_COUNT) ? dump.trace_count : OS_CRASH_DUMP_TRACE_COUNT);
+    }
+}
+
+/**
+ * \brief print the settings store contents in hex, or set or remove a setting
+ */
+static void settings_command(DebugPort& port, int argc, char* argv[]) {
+    PARAMETER_NOT_USED(port);
+    constexpr size_t bytes_per_line = 16;
+    static uint8_t value[os::kv_max_value_size];
+
+    if ( (argc > 2) && (strcmp(argv[1], "remove") == 0) ) {
+        bool removed = os::kv_store::remove(static_cast<uint16_t>(strtoul(argv[2], nullptr, 0)));
+        shell_print(removed ? "removed\r\n" : "remove failed\r\n");
+        return;
+    }
+    if ( (argc > 3) && (strcmp(argv[1], "set") == 0) ) {
+        const char* hex = argv[3];
+        size_t size = strlen(hex) / 2;
+        if ( ((strlen(hex) % 2) != 0) || (size > sizeof(value)) ) {
+            shell_print("the value must be whole bytes of hex, at most %u of them\r\n", static_cast<unsigned>(sizeof(value)));
+            return;
+        }
+        for ( size_t index = 0; index < size; index++ ) {
+            char byte[3] = {hex[index * 2], hex[(index * 2) + 1], '\0'};
+            value[index] = static_cast<uint8_t>(strtoul(byte, nullptr, 16));
+        }
+        bool written = os::kv_store::write(static_cast<uint16_t>(strtoul(argv[2], nullptr, 0)), value, size);
+        shell_print(written ? "stored, takes effect at the next reset\r\n" : "store failed\r\n");
+        return;
+    }
+
+    shell_print("generation %lu, %u bytes free\r\n", static_cast<unsigned long>(os::kv_store::get_generation()),
+                static_cast<unsigned>(os::kv_store::get_free_bytes()));
+    uint16_t key;
+    size_t size;
+    for ( size_t position = 0; os::kv_store::get_key(position, key, size); position++ ) {
+        os::kv_store::read(key, value, sizeof(value));
+        shell_print("key %u, %u bytes:", key, static_cast<unsigned>(size));
+        for ( size_t index = 0; index < size; index++ ) {
+            shell_print(((index % bytes_per_line) == 0) ? "\r\n  %02x" : " %02x", value[index]);
+        }
+        shell_print("\r\n");
+    }
+}
+
+/**
+ * \brief print trace records with times relative to the first one
+ *
+ * \param records the records, oldest first
+ * \param count number of records
+ */
+static void print_trace_records(const os::trace_record* records, size_t count) {
+    shell_print("%10s %-18s %6s %10s\r\n", "cycles", "event", "detail", "argument");
+    for ( size_t index = 0; index < count; index++ ) {
+        shell_print("%10lu %-18s %6u 0x%08lx\r\n", static_cast<unsigned long>(records[index].timestamp - records[0].timestamp),
+                    os::get_trace_event_name(records[index].event), records[index].detail,
+                    static_cast<unsigned long>(records[index].argument));
+    }
+}
@@ -0,0 +1,29 @@
+/*! \file shell.h
+*
+*  \brief line based command shell on the debug port.
+*
+*
+*  \author Graham Riches
+*/
+
+#pragma once
+
+/********************************** Includes *******************************************/
+#include "common.h"
+#include "debug_port.h"
+
+/************************************ Types ********************************************/
+/**
+ * \brief a shell command. Handlers get the command name as the first argument, like main.
+ */
+struct ShellCommand {
+    const char* name;
+    const char* help;
+    void (*handler)(DebugPort& port, int argc, char* argv[]);
+};
+
+/****************************** Functions Prototype ************************************/
+/**
+ * \brief register the shell thread with the scheduler. Call this before the kernel is entered.
+ */
+void shell_initialize(void);
@@ -0,0 +1,162 @@
+/*! \file analog_sampler.cpp
+*
+*  \brief continuous analog sampling. TIM2 triggers a scan of the ADC1 channels at a fixed rate, and the DMA fills a
+*         double buffer with the results, so samples are collected without an interrupt for each one. Each half of
+*         the buffer is queued for the consumer thread as it fills.
+*
+*
+*  \author Graham Riches
+*/
+
+/********************************** Includes *******************************************/
+#include "analog_sampler.h"
+#include "hal_adc.h"
+#include "hal_gpio.h"
+#include "hal_interrupt.h"
+#include "hal_rcc.h"
+#include "hal_timer.h"
+#include "queue.h"
+#include "timestamp_timer.h"
+#include <cassert>
+
+/*********************************** Consts ********************************************/
+constexpr size_t block_samples = analog_block_frames * analog_channel_count;
+constexpr uint32_t sample_timer_frequency = HAL::Timer::microsecond_frequency;
+constexpr uint16_t signed_offset = 0x8000;  //!< flips a left aligned sample from offset binary to two's complement
+static const HAL::ADCChannel channels[analog_channel_count] = {HAL::ADCChannel::channel_1, HAL::ADCChannel::channel_2};
+
+/******************************** Local Variables **************************************/
+static HAL::Timer sample_timer(TIM2, HAL::Clocks::APB1);
+
+/* ADC1 is on DMA2 stream 4, channel 0. Stream 0 is the other choice, but SPI1 has it */
+static HAL::ADCDMA adc_1(ADC1, HAL::Clocks::APB2, HAL::DMAStream(DMA2, DMA2_Stream4, 4, HAL::DMAChannel::channel_0));
+
+static uint16_t samples[2 * block_samples];
+static os::queue<AnalogBlock, 1> ready_blocks;  //!< a second queued block would already be being overwritten
+static volatile uint32_t blocks_converted;
+static volatile uint32_t dropped_blocks;
+static bool running;
+
+/****************************** Functions Prototype ************************************/
+static void on_block_converted(void* context, uint8_t half);
+
+/****************************** Functions Definition ***********************************/
+/**
+ * \brief set up the analog pins and register the interrupts
+ */
+void initialize_analog_sampler(void) {
+    using namespace HAL;
+
+    /* PA1 and PA2 are the Discovery board's only analog pins with nothing else on them */
+    configure_pins(GPIOA, static_cast<uint16_t>(Pins::pin_1) | static_cast<uint16_t>(Pins::pin_2), PinMode::analog, Speed::low, PullMode::none,
+                   OutputMode::push_pull);
+    adc_1.set_callback(on_block_converted, nullptr);
+    interrupt_manager.register_direct_callback<adc_1, ADCDMA::stream_irq_type>(InterruptName::dma_2_stream_4, PreemptionPriority::level_2);
+    interrupt_manager.register_direct_callback<adc_1, ADCDMA::adc_irq_type>(InterruptName::adc, PreemptionPriority::level_2);
+}
+
+/**
+ * \brief enable the clocks and start the timer triggering the scans
+ */
+void start_analog_sampler(void) {
+    using namespace HAL;
+    if ( running ) {
+        return;
+    }
+
+    reset_control_clock.request_clock(APB1Clocks::timer_2);
+    reset_control_clock.request_clock(APB2Clocks::adc_1);
+    reset_control_clock.request_clock(AHB1Clocks::dma_2);
+    running = true;
+
+    /* 12 + 15 cycles a channel is about a microsecond at the 21MHz ADC clock, well inside the sample period */
+    blocks_converted = 0;
+    adc_1.configure(channels, analog_channel_count, ADCSampleTime::cycles_15, ADCTrigger::timer_2_trigger_output);
+    adc_1.start(samples, 2 * block_samples, DMAPriority::high);
+
+    /* the timer goes last, so the first trigger finds the ADC ready */
+    sample_timer.start(sample_timer_frequency);
+    sample_timer.set_trigger_output(TimerMasterMode::update);
+    sample_timer.set_period(sample_timer_frequency / analog_sample_rate);
+}
+
+/**
+ * \brief stop the timer and the ADC, then release the clocks
+ */
+void stop_analog_sampler(void) {
+    using namespace HAL;
+    if ( !running ) {
+        return;
+    }
+
+    sample_timer.stop();
+    adc_1.stop();
+    reset_control_clock.release_clock(AHB1Clocks::dma_2);
+    reset_control_clock.release_clock(APB2Clocks::adc_1);
+    reset_control_clock.release_clock(APB1Clocks::timer_2);
+    running = false;
+}
+
+/**
+ * \brief redo the sample timer's prescaler for the new bus clock, if it is running
+ */
+void update_analog_sampler_clocks(void) {
+    if ( running ) {
+        sample_timer.update_tick_frequency();
+    }
+}
+
+/**
+ * \brief wait for the next block of samples
+ *
+ * \param ticks max ticks to wait
+ * \retval std::optional<AnalogBlock> the block, or empty on timeout
+ */
+std::optional<AnalogBlock> receive_analog_block(uint32_t ticks) {
+    return ready_blocks.receive(ticks);
+}
+
+/**
+ * \brief deinterleave one channel of a block into q15 samples
+ *
+ * \param block the block
+ * \param channel index of the channel in the scan sequence
+ * \param output where to store analog_block_frames samples
+ * \retval true if the DMA hadn't started on the block again by the end of the copy
+ */
+bool extract_analog_channel(const AnalogBlock& block, uint8_t channel, dsp::q15_t* output) {
+    assert(channel < analog_channel_count);
+    const uint16_t* sample = block.samples + channel;
+    for ( size_t index = 0; index < analog_block_frames; index++ ) {
+        output[index] = static_cast<dsp::q15_t>(*sample ^ signed_offset);
+        sample += analog_channel_count;
+    }
+
+    /* the DMA starts on the block again as soon as the next one is complete */
+    return blocks_converted == block.sequence;
+}
+
+/**
+ * \brief get the number of blocks dropped with the queue full
+ *
+ * \retval uint32_t dropped blocks
+ */
+uint32_t get_analog_dropped_block_count(void) {
+    return dropped_blocks;
+}
+
+/**
+ * \brief called from the stream interrupt each time half of the buffer has been filled
+ *
+ * \param context not used
+ * \param half the half that has just been filled
+ */
+static void on_block_converted(void* context, uint8_t half) {
+    PARAMETER_NOT_USED(context);
+    uint32_t sequence = blocks_converted + 1;
+    blocks_converted = sequence;
+    AnalogBlock block = {&samples[half * block_samples], sequence, timestamp_timer.get_count()};
+    if ( !ready_blocks.send_from_isr(block) ) {
+        dropped_blocks = dropped_blocks + 1;
+    }
+}
@@ -0,0 +1,77 @@
+/*! \file analog_sampler.h
+*
+*  \brief continuous analog sampling functions and variables declarations.
+*
+*
+*  \author Graham Riches
+*/
+
+#pragma once
+
+/********************************** Includes *******************************************/
+#include "common.h"
+#include "dsp_q15.h"
+#include <optional>
+
+/*********************************** Consts ********************************************/
+constexpr uint8_t analog_channel_count = 2;
+constexpr size_t analog_block_frames = 256;    //!< samples of each channel per block, 10.24ms at 25kHz
+constexpr uint32_t analog_sample_rate = 25000;
+
+/************************************ Types ********************************************/
+/**
+ * \brief a block of samples that has just been converted. The samples stay in the DMA buffer, so the block has to
+ *        be read within one block period of its delivery, before the DMA comes round to it again.
+ */
+struct AnalogBlock {
+    const uint16_t* samples;  //!< analog_block_frames interleaved frames, left aligned 12-bit
+    uint32_t sequence;        //!< counts up with each block from 1, so a gap means blocks were dropped
+    uint32_t timestamp;       //!< microsecond timestamp taken as the last sample was converted
+};
+
+/****************************** Functions Prototype ************************************/
+/**
+ * \brief register the ADC interrupts. Sampling is started separately with start_analog_sampler.
+ */
+void initialize_analog_sampler(void);
+
+/**
+ * \brief start sampling every channel at analog_sample_rate. The clocks are held for as long as it runs, which
+ *        keeps the core out of STOP mode.
+ */
+void start_analog_sampler(void);
+
+/**
+ * \brief stop sampling and release the clocks
+ */
+void stop_analog_sampler(void);
+
+/**
+ * \brief bring the sample timer back in step after a change to its bus clock
+ */
+void update_analog_sampler_clocks(void);
+
+/**
+ * \brief wait for the next block of samples. Only one thread should consume the blocks.
+ *
+ * \param ticks max ticks to wait
+ * \retval std::optional<AnalogBlock> the block, or empty on timeout
+ */
+std::optional<AnalogBlock> receive_analog_block(uint32_t ticks);
+
+/**
+ * \brief copy one channel out of a block as signed q15 samples centered on mid scale, ready for the DSP filters
+ *
+ * \param block the block
+ * \param channel index of the channel in the scan sequence
+ * \param output where to store analog_block_frames samples
+ * \retval true if the copy is good, false if the DMA had started overwriting the block before it was finished
+ */
+bool extract_analog_channel(const AnalogBlock& block, uint8_t channel, dsp::q15_t* output);
+
+/**
+ * \brief get the number of blocks dropped because the consumer hadn't taken the one before
+ *
+ * \retval uint32_t dropped blocks
+ */
+uint32_t get_analog_dropped_block_count(void);
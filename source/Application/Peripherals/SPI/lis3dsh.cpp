@@ -11,27 +11,29 @@
 #include "board.h"
 #include "hal_exti.h"
 #include "hal_interrupt.h"
-#include "hal_rcc.h"
-#include <map>
+#include "deferred_work.h"
+#include "spi_bus.h"
+#include "timestamp_timer.h"
+#include <cstring>
 
 
 /*********************************** Consts ********************************************/
-constexpr uint8_t buffer_size = 128;
-constexpr uint8_t data_fifo_depth = 16;
 constexpr uint8_t register_write_size = 2;
 constexpr uint8_t device_read = 0x80;
 constexpr uint8_t device_write = 0x00;
-constexpr uint8_t interrupt_1_data_ready = 0b11001000;
-constexpr uint8_t enable_multibyte_read = 0b00010000;
-constexpr uint8_t read_register_data_size = 7;
+constexpr uint8_t interrupt_1_active_high = 0b01001000;
+constexpr uint8_t fifo_watermark_on_interrupt_1 = 0b01110100;  //!< FIFO, watermark interrupt and address increment
+constexpr uint8_t fifo_bypass_mode = 0b00000000;
+constexpr uint8_t fifo_stream_mode = 0b01000000;
+constexpr uint8_t register_read_size = 2;
+constexpr uint8_t milli_g_scale_shift = 16;
 
 /************************************ Types ********************************************/
 /**
  * \brief configuration of interrupts for the accelerometer
  */
 enum class InterruptType : unsigned {
-    spi_interrupt = 0,
-    external_interrupt_1,
+    external_interrupt_1 = 1,
 };
 
 /*********************************** Macros ********************************************/
@@ -40,42 +42,72 @@ enum class InterruptType : unsigned {
 /* create the pins */
 static HAL::OutputPin
     accelerometer_chip_select(GPIOE, HAL::Pins::pin_3, HAL::PinMode::output, HAL::Speed::low, HAL::PullMode::pull_up, HAL::OutputMode::push_pull);
-static HAL::AlternateModePin accelerometer_sck(
-    GPIOA, HAL::Pins::pin_5, HAL::PinMode::alternate, HAL::Speed::very_high, HAL::PullMode::pull_up, HAL::OutputMode::push_pull, HAL::AlternateMode::af5);
-static HAL::AlternateModePin accelerometer_miso(
-    GPIOA, HAL::Pins::pin_6, HAL::PinMode::alternate, HAL::Speed::very_high, HAL::PullMode::pull_up, HAL::OutputMode::push_pull, HAL::AlternateMode::af5);
-static HAL::AlternateModePin accelerometer_mosi(
-    GPIOA, HAL::Pins::pin_7, HAL::PinMode::alternate, HAL::Speed::very_high, HAL::PullMode::pull_up, HAL::OutputMode::push_pull, HAL::AlternateMode::af5);
 
-LIS3DSH accelerometer(SPI1, accelerometer_chip_select, buffer_size, buffer_size, data_fifo_depth);
-
-static std::map<LIS3DSHResolution, uint16_t> acceleration_conversion_map = {{LIS3DSHResolution::resolution_2g, 0x4000},
-                                                                            {LIS3DSHResolution::resolution_4g, 0x2000},
-                                                                            {LIS3DSHResolution::resolution_6g, 0x1554},
-                                                                            {LIS3DSHResolution::resolution_8g, 0x1000},
-                                                                            {LIS3DSHResolution::resolution_16g, 0x0800}};
+LIS3DSH accelerometer(spi_1_bus, accelerometer_chip_select);
 
 /******************************** Local Variables **************************************/
 
 /****************************** Functions Prototype ************************************/
 
 /****************************** Functions Definition ***********************************/
+/**
+ * \brief get the raw counts per g for a resolution setting
+ * 
+ * \param resolution the accelerometer resolution
+ * \retval uint16_t counts per g
+ */
+static constexpr uint16_t get_counts_per_g(LIS3DSHResolution resolution) {
+    switch ( resolution ) {
+        case LIS3DSHResolution::resolution_4g:
+            return 0x2000;
+        case LIS3DSHResolution::resolution_6g:
+            return 0x1554;
+        case LIS3DSHResolution::resolution_8g:
+            return 0x1000;
+        case LIS3DSHResolution::resolution_16g:
+            return 0x0800;
+        default:
+            return 0x4000;
+    }
+}
+
+/**
+ * \brief get the milli-g per count for a resolution setting as a q16 multiplier, so a raw reading converts with
+ *        one multiply and shift. The largest reading times the largest scale still fits in 32 bits.
+ *
+ * \param resolution the accelerometer resolution
+ * \retval uint16_t milli-g per count in q16
+ */
+static constexpr uint16_t get_milli_g_scale(LIS3DSHResolution resolution) {
+    uint32_t counts_per_g = get_counts_per_g(resolution);
+    return static_cast<uint16_t>(((1000u << milli_g_scale_shift) + (counts_per_g / 2)) / counts_per_g);
+}
+static_assert(get_milli_g_scale(LIS3DSHResolution::resolution_2g) == 4000, "2g is 1000/16384 milli-g per count");
+static_assert(get_milli_g_scale(LIS3DSHResolution::resolution_16g) == 32000, "16g is 1000/2048 milli-g per count");
+
 /**
  * \brief Construct a new LIS3DSH::LIS3DSH object
  * 
- * \param spi_peripheral_address the memory mapped peripheral address
+ * \param bus the SPI bus the accelerometer is on
  * \param chip_select the chip select pin
- * \param tx_size size of the tx buffer
- * \param rx_size size of the rx_buffer
- * \param data_fifo_depth how many measurements to buffer
  */
-LIS3DSH::LIS3DSH(SPI_TypeDef* spi_peripheral_address, HAL::OutputPin chip_select, size_t tx_size, size_t rx_size, size_t data_fifo_depth)
-    : HAL::SPIInterrupt(spi_peripheral_address, chip_select, tx_size, rx_size)
-    , x_data(data_fifo_depth)
-    , y_data(data_fifo_depth)
-    , z_data(data_fifo_depth) {
+LIS3DSH::LIS3DSH(HAL::SPIBus& bus, HAL::OutputPin chip_select)
+    : bus(bus)
+    , device{chip_select, true, true, 10000000}  //!< mode 3 at up to 10 MHz, 84MHz / 16 = 5.25 MHz at full speed
+    , burst_transaction{&this->device, this->burst_command, this->burst_data, burst_transfer_size, on_burst_complete, this, false, nullptr}
+    , frames()
+    , frames_ready(0, 1)
+    , burst_command{static_cast<uint8_t>(static_cast<uint8_t>(LIS3DSHRegisters::output_x) | device_read)}
+    , burst_data()
+    , burst_succeeded(false)
+    , burst_deferred(false)
+    , burst_timestamp(0)
+    , frame_timestamp(0) {
+    /* pull the chip select high by default */
+    this->device.chip_select.set(true);
+
     /* default initialize the conversion factor to +/- 2g */
-    this->conversion_factor = acceleration_conversion_map[LIS3DSHResolution::resolution_2g];
+    this->milli_g_scale = get_milli_g_scale(LIS3DSHResolution::resolution_2g);
 }
 
 /**
@@ -85,17 +117,12 @@ LIS3DSH::LIS3DSH(SPI_TypeDef* spi_peripheral_address, HAL::OutputPin chip_select
  * \retval uint8_t value of the register
  */
 uint8_t LIS3DSH::read_register(LIS3DSHRegisters reg) {
-    uint16_t read_command = static_cast<uint8_t>(reg) | device_read;
-    this->send(reinterpret_cast<uint8_t*>(&read_command), sizeof(read_command));
-
-    /* block until the register result returns */
-    uint8_t data = 0;
-    while ( !this->rx_buffer.is_empty() ) {
-        auto maybe_data = this->rx_buffer.pop();
-        data = (maybe_data.has_value()) ? maybe_data.value() : 0;
-    }
+    uint8_t read_command[register_read_size] = {static_cast<uint8_t>(static_cast<uint8_t>(reg) | device_read), 0};
+    uint8_t read_data[register_read_size] = {0};
 
-    return data;
+    /* the register comes back after the address byte */
+    this->transfer(read_command, read_data, sizeof(read_command));
+    return read_data[1];
 }
 
 /**
@@ -109,7 +136,25 @@ void LIS3DSH::write_register(LIS3DSHRegisters reg, uint8_t value) {
     write_command[0] = (static_cast<uint8_t>(reg) | device_write);
     write_command[1] = value;
 
-    this->send(write_command, sizeof(write_command));
+    this->transfer(write_command, nullptr, sizeof(write_command));
+}
+
+/**
+ * \brief queue a transfer on the bus and wait for it to finish, for register access during setup. The register
+ *        buffers are on the caller's stack, so this has to run from main, whose stack is in SRAM, rather than from
+ *        a thread with its stack in the core coupled memory the DMA can't reach.
+ *
+ * \param tx_buffer data to send
+ * \param rx_buffer where to store the received data, or nullptr
+ * \param size number of bytes to transfer
+ */
+void LIS3DSH::transfer(const uint8_t* tx_buffer, uint8_t* rx_buffer, uint16_t size) {
+    HAL::SPITransaction transaction{&this->device, tx_buffer, rx_buffer, size, nullptr, nullptr, false, nullptr};
+    this->bus.submit(transaction);
+
+    /* the transaction lives on the stack, so it has to be finished before returning */
+    while ( transaction.pending ) {
+    }
 }
 
 /**
@@ -118,34 +163,20 @@ void LIS3DSH::write_register(LIS3DSHRegisters reg, uint8_t value) {
 void LIS3DSH::initialize(void) {
     using namespace HAL;
 
-    /* enable the peripheral clock */
-    reset_control_clock.set_apb_clock(APB2Clocks::spi_1, true);
-
-    /* setup the SPI control register settings */
-    this->write_control_register(SPIControlRegister1::master_select, 0x01);
-    this->write_control_register(SPIControlRegister1::clock_polarity, 0x01);
-    this->write_control_register(SPIControlRegister1::clock_phase, 0x01);
-    this->write_control_register(SPIControlRegister2::slave_select_output_enable, 0x01);
-    this->set_baudrate(SPIBaudratePrescaler::prescaler_16);  //!< 84MHz / 16 = 5.25 MHz
-
-    /* register the SPI interrupt */
-    interrupt_manager.register_callback(InterruptName::spi_1, this, static_cast<uint8_t>(InterruptType::spi_interrupt), PreemptionPriority::level_2);
-
-    /* enable the interrupt */
-    this->write_control_register(SPIControlRegister2::receive_interrupt_enable, 0x01);
-
-    /* enable the peripheral */
-    this->write_control_register(SPIControlRegister1::spi_enable, 0x01);
+    /* the bus is set up separately with initialize_spi_bus, and switches to this device's mode for each transfer */
 
     /* register the external interrupts */
     register_external_interrupt(EXTIPort::gpio_port_e, Pins::pin_0, EXTITrigger::rising);
-    interrupt_manager.register_callback(InterruptName::exti_0, this, static_cast<uint8_t>(InterruptType::external_interrupt_1), PreemptionPriority::level_2);
+    interrupt_manager.register_direct_callback<accelerometer, static_cast<uint8_t>(InterruptType::external_interrupt_1)>(InterruptName::exti_0, PreemptionPriority::level_2);
 
-    /* setup the accelerometer speed and setup the data ready interrupt */
-    this->set_data_rate(LIS3DSHDataRate::sample_100Hz);
+    /* setup the accelerometer speed, then stream samples into the FIFO and raise interrupt 1 at the watermark.
+       Going through bypass mode first empties the FIFO */
+    this->set_data_rate(LIS3DSHDataRate::sample_1600Hz);
     this->set_resolution(LIS3DSHResolution::resolution_2g);
-    this->write_register(LIS3DSHRegisters::control_register_3, interrupt_1_data_ready);
-    this->write_register(LIS3DSHRegisters::control_register_6, enable_multibyte_read);
+    this->write_register(LIS3DSHRegisters::control_register_3, interrupt_1_active_high);
+    this->write_register(LIS3DSHRegisters::control_register_6, fifo_watermark_on_interrupt_1);
+    this->write_register(LIS3DSHRegisters::fifo_control, fifo_bypass_mode);
+    this->write_register(LIS3DSHRegisters::fifo_control, fifo_stream_mode | fifo_watermark);
 }
 
 /**
@@ -164,7 +195,61 @@ void LIS3DSH::set_data_rate(LIS3DSHDataRate rate) {
  */
 void LIS3DSH::set_resolution(LIS3DSHResolution resolution) {
     this->write_register(LIS3DSHRegisters::control_register_5, static_cast<uint8_t>(resolution));
-    this->conversion_factor = acceleration_conversion_map[resolution];
+    this->milli_g_scale = get_milli_g_scale(resolution);
+}
+
+/**
+ * \brief read raw frames, oldest first, waiting for a burst to arrive if there are none
+ *
+ * \param data where to store the frames
+ * \param count most frames to read
+ * \param ticks how long to wait if there are no frames
+ * \retval size_t number of frames read
+ */
+size_t LIS3DSH::read_frames(LIS3DSHFrame* data, size_t count, uint32_t ticks) {
+    size_t read = this->frames.pop_bulk(data, count);
+    if ( (read == 0) && this->frames_ready.wait_for(ticks) ) {
+        read = this->frames.pop_bulk(data, count);
+    }
+    return read;
+}
+
+/**
+ * \brief get when the newest frame was sampled. The watermark edge is stamped as the interrupt is entered, so the
+ *        time doesn't depend on how long the burst waited for the bus or the deferred work thread. The frames before
+ *        it are one sample period apart.
+ *
+ * \retval uint32_t timestamp_timer count in microseconds
+ */
+uint32_t LIS3DSH::get_frame_timestamp(void) {
+    return this->frame_timestamp;
+}
+
+/**
+ * \brief convert a raw axis reading to milli-g at the current resolution
+ *
+ * \param raw the raw reading
+ * \retval int32_t acceleration in milli-g
+ */
+int32_t LIS3DSH::convert_to_milli_g(int16_t raw) {
+    return (static_cast<int32_t>(raw) * this->milli_g_scale) >> milli_g_scale_shift;
+}
+
+/**
+ * \brief convert a block of raw frames to milli-g at the current resolution. Each axis is a single 16 x 16 bit
+ *        multiply and shift, with no FPU state touched.
+ *
+ * \param frames the raw frames
+ * \param accelerations where to store the converted frames
+ * \param count number of frames
+ */
+void LIS3DSH::convert_to_milli_g(const LIS3DSHFrame* frames, LIS3DSHAcceleration* accelerations, size_t count) {
+    int32_t scale = this->milli_g_scale;
+    for ( size_t index = 0; index < count; index++ ) {
+        accelerations[index].x = (frames[index].x * scale) >> milli_g_scale_shift;
+        accelerations[index].y = (frames[index].y * scale) >> milli_g_scale_shift;
+        accelerations[index].z = (frames[index].z * scale) >> milli_g_scale_shift;
+    }
 }
 
 /**
@@ -185,10 +270,6 @@ void LIS3DSH::irq_handler(uint8_t type) {
     InterruptType interrupt = static_cast<InterruptType>(type);
 
     switch ( interrupt ) {
-        case InterruptType::spi_interrupt:
-            this->spi_irq_handler();
-            break;
-
         case InterruptType::external_interrupt_1:
             this->exti_0_irq_handler();
             break;
@@ -199,73 +280,64 @@ void LIS3DSH::irq_handler(uint8_t type) {
 }
 
 /**
- * \brief interrupt handler for SPI interrupts
- * \note because there are multiple interrupts attached to the LIS3HD object,
- *       this here is a copy of the SPI interrupt
+ * \brief interrupt handler for exti 0 interrupt
+ *        This is configured to be used as the accelerometer FIFO watermark
+ * 
  */
-void LIS3DSH::spi_irq_handler(void) {
-    /* enable the chip select */
-    this->chip_select.set(false);
-
-    while ( !this->tx_buffer.is_empty() ) {
-        /* wait for the transmit buffer to clear */
-        while ( this->read_status_register(HAL::SPIStatusRegister::transmit_data_empty) == false ) {
-        }
-
-        /* put data outgoing into the data register */
-        auto maybe_data = this->tx_buffer.pop();
-        if (maybe_data.has_value()) {
-            this->peripheral->DR = maybe_data.value();
-        }
-
-        /* wait for the receive buffer to clear */
-        while ( this->read_status_register(HAL::SPIStatusRegister::receive_data_available) == false ) {
-        }
-
-        /* receive data into the rx buffer */
-        this->rx_buffer.push(static_cast<uint8_t>(this->peripheral->DR));
+void LIS3DSH::exti_0_irq_handler(void) {
+    uint32_t edge_timestamp = timestamp_timer.get_count();
+
+    /* read a watermark's worth of frames in one burst, the address wraps back to output_x after output_z. If the
+       last burst is still queued behind another device's transfers it picks up these samples too. While the last
+       burst is waiting to be processed the deferred work reads the next one instead. */
+    if ( !this->burst_deferred ) {
+        this->burst_timestamp = edge_timestamp;
+        this->bus.submit(this->burst_transaction);
     }
 
-    /* disable the interrupt */
-    this->write_control_register(HAL::SPIControlRegister2::transmit_interrupt_enable, 0x00);
-
-    /* disable the chip select */
-    this->chip_select.set(true);
+    /* clear the interrupt pending bit */
+    HAL::clear_external_interrupt_pending(HAL::EXTILine::line_0);
 }
 
 /**
- * \brief interrupt handler for exti 0 interrupt
- *        This is configured to be used as accelerometer data ready
- * 
+ * \brief hand a finished burst read off to the deferred work thread, from the bus completion interrupt
+ *
+ * \param transaction the burst transaction
+ * \param success false if the transfer failed
  */
-void LIS3DSH::exti_0_irq_handler(void) {
-    this->rx_buffer.flush();
-
-    /* read XYZ data - Note: the registers are chained so it can be done in a single burst */
-    uint8_t read_data[read_register_data_size] = {0};
-    read_data[0] = static_cast<uint8_t>(LIS3DSHRegisters::output_x) | device_read;
-    this->send(read_data, sizeof(read_data));
-
-    /* flush the first byte, which is read back when the address + read byte is first sent */
-    this->rx_buffer.pop();
-
-    /* update the data values */
-    auto convert_data = [this](uint8_t low, uint8_t high) -> float {
-        return static_cast<float>(static_cast<int16_t>(low | (high << 8))) / this->conversion_factor;
-    };
-
-    //!< TODO: banking on these being successfull reads
-    //!< TODO: this is broken!!
-    #if 0
-    float accel_x = convert_data(this->rx_buffer.pop().value(), this->rx_buffer.pop().value());
-    float accel_y = convert_data(this->rx_buffer.pop().value(), this->rx_buffer.pop().value());
-    float accel_z = convert_data(this->rx_buffer.pop().value(), this->rx_buffer.pop().value());
+void LIS3DSH::on_burst_complete(HAL::SPITransaction& transaction, bool success) {
+    LIS3DSH* self = static_cast<LIS3DSH*>(transaction.context);
+    self->burst_succeeded = success;
+    self->burst_deferred = true;
+    if ( !os::deferred_work::submit_from_isr(process_burst, self) ) {
+        /* the work queue is full, so drop this burst and read the next one over it */
+        self->burst_deferred = false;
+        self->bus.submit(self->burst_transaction);
+    }
+}
 
-    this->x_data.push(accel_x);
-    this->y_data.push(accel_y);
-    this->z_data.push(accel_z);
-    #endif
+/**
+ * \brief move a finished burst read into the frame buffer, from the deferred work thread. Frames that don't
+ *        fit are dropped, the conversion to milli-g is left to the consumer.
+ *
+ * \param context the accelerometer
+ */
+void LIS3DSH::process_burst(void* context) {
+    LIS3DSH* self = static_cast<LIS3DSH*>(context);
+    if ( self->burst_succeeded ) {
+        /* the first byte is read back while the address is sent */
+        LIS3DSHFrame burst[fifo_watermark];
+        std::memcpy(burst, &self->burst_data[1], sizeof(burst));
+        self->frames.push_bulk(burst, fifo_watermark);
+        self->frame_timestamp = self->burst_timestamp;
+        self->frames_ready.signal();
+    }
 
-    /* clear the interrupt pending bit */
-    HAL::clear_external_interrupt_pending(HAL::EXTILine::line_0);
+    /* the watermark interrupt is a level, so if the FIFO refilled past it in the meantime there is no new edge.
+       The flag is cleared first so a new edge after the check starts its own read. */
+    self->burst_deferred = false;
+    if ( static_cast<bool>(GPIOE->IDR & static_cast<uint32_t>(HAL::Pins::pin_0)) ) {
+        self->burst_timestamp = timestamp_timer.get_count();
+        self->bus.submit(self->burst_transaction);
+    }
 }
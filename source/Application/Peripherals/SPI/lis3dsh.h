@@ -11,8 +11,10 @@
 /********************************** Includes *******************************************/
 #include "common.h"
 #include "hal_gpio.h"
+#include "hal_interrupt.h"
 #include "hal_spi.h"
-#include "ring_buffer.h"
+#include "os_semaphore.h"
+#include "spsc_ring_buffer.h"
 #include "stm32f4xx.h"
 
 
@@ -35,6 +37,8 @@ enum class LIS3DSHRegisters : unsigned {
     output_x = 0x28,
     output_y = 0x2a,
     output_z = 0x2c,
+    fifo_control = 0x2e,
+    fifo_source = 0x2f,
 };
 
 /**
@@ -69,29 +73,71 @@ enum class LIS3DSHResolution : unsigned {
 };
 
 /**
- * \brief class for the LIS302DL accelerometer
+ * \brief one raw sample of all three axes, laid out like the output registers so a burst read can be copied
+ *        straight in
  */
-class LIS3DSH : public HAL::SPIInterrupt {
+struct LIS3DSHFrame {
+    int16_t x;
+    int16_t y;
+    int16_t z;
+};
+static_assert(sizeof(LIS3DSHFrame) == 6, "LIS3DSHFrame must match the output register layout");
+
+/**
+ * \brief one sample of all three axes converted to milli-g
+ */
+struct LIS3DSHAcceleration {
+    int32_t x;
+    int32_t y;
+    int32_t z;
+};
+
+/**
+ * \brief class for the LIS302DL accelerometer, which shares its SPI bus with any other devices on it. Samples are
+ *        collected in the accelerometer's own FIFO and read out a watermark's worth at a time, so there is one
+ *        interrupt per burst rather than per sample.
+ */
+class LIS3DSH : public HAL::InterruptPeripheral {
+  public:
+    static constexpr uint8_t fifo_watermark = 16;  //!< samples per burst read, half of the hardware FIFO
+    static constexpr size_t frame_buffer_size = 128;  //!< raw frames buffered for the consumer
+
   private:
+    static constexpr size_t burst_transfer_size = 1 + (fifo_watermark * sizeof(LIS3DSHFrame));  //!< address byte then the frames
+
     /* private data */
-    uint16_t conversion_factor;
-    RingBuffer<float> x_data;
-    RingBuffer<float> y_data;
-    RingBuffer<float> z_data;
+    HAL::SPIBus& bus;
+    HAL::SPIDevice device;
+    HAL::SPITransaction burst_transaction;
+    uint16_t milli_g_scale;  //!< milli-g per count in q16 for the current resolution
+    SPSCRingBuffer<LIS3DSHFrame, frame_buffer_size> frames;  //!< written by the deferred burst work, drained by the consumer
+    os::semaphore frames_ready;
+    uint8_t burst_command[burst_transfer_size];
+    uint8_t burst_data[burst_transfer_size];
+    volatile bool burst_succeeded;
+    volatile bool burst_deferred;  //!< burst_data is waiting to be processed and must not be read into again
+    volatile uint32_t burst_timestamp;  //!< microsecond timestamp of the watermark edge that started the burst in flight
+    volatile uint32_t frame_timestamp;  //!< microsecond timestamp of the watermark edge for the newest buffered frame
 
     /* private methods */
     uint8_t read_register(LIS3DSHRegisters reg);
     void write_register(LIS3DSHRegisters reg, uint8_t value);
-    void spi_irq_handler(void);
+    void transfer(const uint8_t* tx_buffer, uint8_t* rx_buffer, uint16_t size);
     void exti_0_irq_handler(void);
+    static void on_burst_complete(HAL::SPITransaction& transaction, bool success);
+    static void process_burst(void* context);
 
   public:
-    LIS3DSH(SPI_TypeDef* spi_peripheral_address, HAL::OutputPin chip_select, size_t tx_size, size_t rx_size, size_t data_fifo_depth);
+    LIS3DSH(HAL::SPIBus& bus, HAL::OutputPin chip_select);
     void initialize(void);
     uint8_t self_test(void);
     void set_data_rate(LIS3DSHDataRate rate);
     void set_resolution(LIS3DSHResolution resolution);
-    void irq_handler(uint8_t type);
+    size_t read_frames(LIS3DSHFrame* data, size_t count, uint32_t ticks);
+    uint32_t get_frame_timestamp(void);
+    int32_t convert_to_milli_g(int16_t raw);
+    void convert_to_milli_g(const LIS3DSHFrame* frames, LIS3DSHAcceleration* accelerations, size_t count);
+    void irq_handler(uint8_t type) override;
 };
 
 /*********************************** Macros ********************************************/
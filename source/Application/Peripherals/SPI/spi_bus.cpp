@@ -0,0 +1,43 @@
+/*! \file spi_bus.cpp
+*
+*  \brief the shared SPI buses on the board. Devices queue their transfers on a bus rather than owning the
+*         peripheral, so several of them can share the same pins.
+*
+*
+*  \author Graham Riches
+*/
+
+/********************************** Includes *******************************************/
+#include "spi_bus.h"
+#include "hal_interrupt.h"
+#include "hal_rcc.h"
+
+/******************************* Global Variables **************************************/
+/* create the pins */
+static HAL::AlternateModePin spi_1_sck(
+    GPIOA, HAL::Pins::pin_5, HAL::PinMode::alternate, HAL::Speed::very_high, HAL::PullMode::pull_up, HAL::OutputMode::push_pull, HAL::AlternateMode::af5);
+static HAL::AlternateModePin spi_1_miso(
+    GPIOA, HAL::Pins::pin_6, HAL::PinMode::alternate, HAL::Speed::very_high, HAL::PullMode::pull_up, HAL::OutputMode::push_pull, HAL::AlternateMode::af5);
+static HAL::AlternateModePin spi_1_mosi(
+    GPIOA, HAL::Pins::pin_7, HAL::PinMode::alternate, HAL::Speed::very_high, HAL::PullMode::pull_up, HAL::OutputMode::push_pull, HAL::AlternateMode::af5);
+
+/* SPI1_TX is on DMA2 stream 3 and SPI1_RX on stream 0, both on channel 3 */
+HAL::SPIBus spi_1_bus(SPI1,
+                      HAL::Clocks::APB2,
+                      HAL::DMAStream(DMA2, DMA2_Stream3, 3, HAL::DMAChannel::channel_3),
+                      HAL::DMAStream(DMA2, DMA2_Stream0, 0, HAL::DMAChannel::channel_3));
+
+/****************************** Functions Definition ***********************************/
+/**
+ * \brief enable the bus clocks and interrupts. Call this before initializing any of the devices on the bus.
+ */
+void initialize_spi_bus(void) {
+    using namespace HAL;
+
+    reset_control_clock.request_clock(APB2Clocks::spi_1);
+    reset_control_clock.request_clock(AHB1Clocks::dma_2);
+    spi_1_bus.configure(DMAPriority::high);
+
+    interrupt_manager.register_direct_callback<spi_1_bus, SPIBus::stream_irq_type>(InterruptName::dma_2_stream_0, PreemptionPriority::level_2);
+    interrupt_manager.register_direct_callback<spi_1_bus, SPIBus::stream_irq_type>(InterruptName::dma_2_stream_3, PreemptionPriority::level_2);
+}
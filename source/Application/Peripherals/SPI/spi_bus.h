@@ -0,0 +1,19 @@
+/*! \file spi_bus.h
+*
+*  \brief the shared SPI buses on the board.
+*
+*
+*  \author Graham Riches
+*/
+
+#pragma once
+
+/********************************** Includes *******************************************/
+#include "common.h"
+#include "hal_spi.h"
+
+/****************************** Functions Prototype ************************************/
+void initialize_spi_bus(void);
+
+/******************************* Global Variables **************************************/
+extern HAL::SPIBus spi_1_bus;
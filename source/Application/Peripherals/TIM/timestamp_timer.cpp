@@ -0,0 +1,25 @@
+/*! \file timestamp_timer.cpp
+*
+*  \brief free running microsecond timer for timestamping events. TIM5 counts microseconds over its full 32 bits,
+*         so any interrupt can read a timestamp that doesn't depend on the scheduler tick.
+*
+*
+*  \author Graham Riches
+*/
+
+/********************************** Includes *******************************************/
+#include "timestamp_timer.h"
+#include "hal_rcc.h"
+
+/******************************* Global Variables **************************************/
+HAL::Timer timestamp_timer(TIM5, HAL::Clocks::APB1);
+
+/****************************** Functions Definition ***********************************/
+/**
+ * \brief enable the timer clock and start counting microseconds. The clock request keeps the core out of STOP
+ *        mode, which would stop the count.
+ */
+void initialize_timestamp_timer(void) {
+    HAL::reset_control_clock.request_clock(HAL::APB1Clocks::timer_5);
+    timestamp_timer.start(HAL::Timer::microsecond_frequency);
+}
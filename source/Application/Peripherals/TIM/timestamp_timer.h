@@ -0,0 +1,19 @@
+/*! \file timestamp_timer.h
+*
+*  \brief free running microsecond timer for timestamping events.
+*
+*
+*  \author Graham Riches
+*/
+
+#pragma once
+
+/********************************** Includes *******************************************/
+#include "common.h"
+#include "hal_timer.h"
+
+/****************************** Functions Prototype ************************************/
+void initialize_timestamp_timer(void);
+
+/******************************* Global Variables **************************************/
+extern HAL::Timer timestamp_timer;
@@ -11,11 +11,11 @@
 #include "hal_gpio.h"
 #include "hal_interrupt.h"
 #include "hal_rcc.h"
-#include <cstdio>
+#include "cm4_port.h"
 #include <cstring>
 
 /*********************************** Consts ********************************************/
-constexpr uint16_t debug_port_buffer_size = 256;
+constexpr uint32_t debug_port_baudrate = 115200;
 
 /************************************ Types ********************************************/
 
@@ -29,7 +29,7 @@ static HAL::AlternateModePin rx_pin(
     GPIOB, HAL::Pins::pin_11, HAL::PinMode::alternate, HAL::Speed::very_high, HAL::PullMode::pull_up, HAL::OutputMode::push_pull, HAL::AlternateMode::af7);
 
 /******************************* Global Variables **************************************/
-DebugPort debug_port(USART3, debug_port_buffer_size, debug_port_buffer_size);
+DebugPort debug_port(USART3);
 
 /****************************** Functions Prototype ************************************/
 
@@ -38,14 +38,14 @@ DebugPort debug_port(USART3, debug_port_buffer_size, debug_port_buffer_size);
  * \brief Construct a new Debug Port:: Debug Port object
  * 
  * \param usart the uart peripheral address pointer
- * \param tx_size size of the tx ring buffer
- * \param rx_size size of the rx ring buffer
  */
-DebugPort::DebugPort(USART_TypeDef* usart, size_t tx_size, size_t rx_size)
-    : HAL::USARTInterrupt(usart, tx_size, rx_size)
-    , print_buffer(std::make_unique<char[]>(tx_size)) {
-    this->print_buffer_size = tx_size;
-}
+DebugPort::DebugPort(USART_TypeDef* usart)
+    : HAL::USARTDMA(usart,
+                    HAL::DMAStream(DMA1, DMA1_Stream3, 3, HAL::DMAChannel::channel_4),
+                    DMA1_Stream3_IRQn,
+                    HAL::DMAStream(DMA1, DMA1_Stream1, 1, HAL::DMAChannel::channel_4))
+    , data_received(0, 1)
+    , transmit_space(0, 1) { }
 
 /**
  * \brief initialize the debug port with the correct HW settings
@@ -54,91 +54,116 @@ void DebugPort::initialize(void) {
     using namespace HAL;
 
     /* enable the GPIO clocks and the USART clocks */
-    reset_control_clock.set_apb_clock(APB1Clocks::usart_3, true);
+    reset_control_clock.request_clock(APB1Clocks::usart_3);
+    reset_control_clock.request_clock(AHB1Clocks::dma_1);
+
+    /* configure the usart with the application specific settings: 8 data bits, no parity, 1 stop bit and no flow control */
+    this->modify_control_register(field(USARTControlRegister1::parity_selection, 0x00) | field(USARTControlRegister1::word_length, 0x00));
+    this->modify_control_register(field(USARTControlRegister2::stop_bits, 0x00));
+    this->modify_control_register(field(USARTControlRegister3::cts_enable, 0x00) | field(USARTControlRegister3::rts_enable, 0x00));
+    this->set_baudrate(Clocks::APB1, debug_port_baudrate);
 
-    /* configure the usart with the application specific settings */
-    this->write_control_register(USARTControlRegister1::parity_selection, 0x00);
-    this->write_control_register(USARTControlRegister1::word_length, 0x00);
-    this->write_control_register(USARTControlRegister2::stop_bits, 0x00);
-    this->write_control_register(USARTControlRegister3::cts_enable, 0x00);
-    this->write_control_register(USARTControlRegister3::rts_enable, 0x00);
-    this->set_baudrate(Clocks::APB1, 115200);
+    /* USART3_TX is on DMA1 stream 3 and USART3_RX on stream 1, both on channel 4 */
+    this->configure_dma_transmit(DMAPriority::low);
+    this->configure_dma_receive(DMAPriority::high);
 
     /* enable the usart and interrupts */
-    this->write_control_register(USARTControlRegister1::receiver_enable, 0x01);
-    this->write_control_register(USARTControlRegister1::transmitter_enable, 0x01);
-    this->write_control_register(USARTControlRegister1::receive_interrupt_enable, 0x01);
+    this->modify_control_register(field(USARTControlRegister1::receiver_enable, 0x01) | field(USARTControlRegister1::transmitter_enable, 0x01));
 
     /* register the interrupt in the hal interrupts table */
-    interrupt_manager.register_callback(InterruptName::usart_3, this, 0, PreemptionPriority::level_2);
+    interrupt_manager.register_direct_callback<debug_port, usart_irq_type>(InterruptName::usart_3, PreemptionPriority::level_2);
+    interrupt_manager.register_direct_callback<debug_port, tx_stream_irq_type>(InterruptName::dma_1_stream_3, PreemptionPriority::level_2);
+    interrupt_manager.register_direct_callback<debug_port, rx_stream_irq_type>(InterruptName::dma_1_stream_1, PreemptionPriority::level_2);
 
     /* enable the UART */
     this->write_control_register(USARTControlRegister1::usart_enable, 0x01);
 }
 
 /**
- * \brief send a formatted log message out
- * 
- * \param message the formatted message
- * \param tag logging tag
- * \param args variadic args pack
+ * \brief work the baudrate out again from the APB1 clock, after the clock speeds have changed. A character in
+ *        flight when this runs may be garbled.
  */
-void DebugPort::log_message(const char* message, const char* tag, va_list args) {
-    this->send(tag);
-    this->send(": ");
-    vsnprintf(this->print_buffer.get(), this->print_buffer_size, message, args);
-    this->send(this->print_buffer.get());
-    this->send("\r\n");
+void DebugPort::update_baudrate(void) {
+    this->set_baudrate(HAL::Clocks::APB1, debug_port_baudrate);
 }
 
 /**
- * \brief log a debug message
- * 
- * \param message the message to send
- * \param ... variadic args
+ * \brief read received data, waiting for some to arrive if there is none
+ *
+ * \param data the destination
+ * \param size max number of bytes to read
+ * \param ticks max ticks to wait for data
+ * \retval size_t number of bytes read, 0 on timeout
  */
-void DebugPort::debug(const char* message, ...) {
-    va_list args;
-    va_start(args, message);
-    this->log_message(message, "DEBUG", args);
-    va_end(args);
+size_t DebugPort::read(uint8_t* data, size_t size, uint32_t ticks) {
+    size_t count = this->receive(data, size);
+    if ( (count == 0) && this->data_received.wait_for(ticks) ) {
+        count = this->receive(data, size);
+    }
+    return count;
 }
 
 /**
- * \brief log an info message
- * 
- * \param message the message to send
- * \param ... variadic print arguments
+ * \brief write data, waiting for space in the tx buffer when it is full. Writers take turns, so a write is never
+ *        interleaved with another thread's. Outside of a thread, such as before the kernel starts, this can't wait
+ *        and only sends what fits.
+ * \note must not be called from an interrupt, as the tx buffer only takes one producer at a time
+ *
+ * \param data pointer to the data to send
+ * \param size amount of data
+ * \param ticks max ticks to wait each time the tx buffer fills
+ * \retval size_t number of bytes accepted, less than size on timeout
  */
-void DebugPort::info(const char* message, ...) {
-    va_list args;
-    va_start(args, message);
-    this->log_message(message, "INFO", args);
-    va_end(args);
+size_t DebugPort::write(const uint8_t* data, size_t size, uint32_t ticks) {
+    if ( !os::is_thread_context() ) {
+        return this->send(data, size);
+    }
+
+    this->writer_lock.lock();
+    size_t accepted = this->send(data, size);
+    while ( (accepted < size) && this->transmit_space.wait_for(ticks) ) {
+        accepted += this->send(data + accepted, size - accepted);
+    }
+    this->writer_lock.unlock();
+    return accepted;
 }
 
 /**
- * \brief log a warning
- * 
- * \param message the warning message
- * \param ... variadic print arguments
+ * \brief overloaded write for strings
+ *
+ * \param data string data
+ * \param ticks max ticks to wait each time the tx buffer fills
+ * \retval size_t number of characters accepted
  */
-void DebugPort::warning(const char* message, ...) {
-    va_list args;
-    va_start(args, message);
-    this->log_message(message, "WARNING", args);
-    va_end(args);
+size_t DebugPort::write(const char* data, uint32_t ticks) {
+    return this->write(reinterpret_cast<const uint8_t*>(data), strlen(data), ticks);
 }
 
 /**
- * \brief log an error
- * 
- * \param message the error to log
- * \param ... variadic print arguments
+ * \brief wake a reader waiting for data
+ *
+ * \param end_of_frame true if the line went idle
+ */
+void DebugPort::on_receive(bool end_of_frame) {
+    PARAMETER_NOT_USED(end_of_frame);
+    this->data_received.signal_from_isr();
+}
+
+/**
+ * \brief wake a writer waiting for tx buffer space
+ */
+void DebugPort::on_transmit_space(void) {
+    this->transmit_space.signal_from_isr();
+}
+
+/**
+ * \brief write a formatted log line from the os log thread
+ *
+ * \param level the message severity
+ * \param text the line
+ * \param size length of the line
  */
-void DebugPort::error(const char* message, ...) {
-    va_list args;
-    va_start(args, message);
-    this->log_message(message, "ERROR", args);
-    va_end(args);
+void DebugPort::write(os::log_level level, const char* text, size_t size) {
+    PARAMETER_NOT_USED(level);
+    this->write(reinterpret_cast<const uint8_t*>(text), size, log_write_timeout_ticks);
 }
@@ -12,32 +12,84 @@
 #include "common.h"
 #include "hal_gpio.h"
 #include "hal_usart.h"
+#include "log.h"
+#include "mutex.h"
+#include "os_semaphore.h"
 #include "stm32f4xx.h"
-#include <cstdarg>
-#include <memory>
 
 
 /*********************************** Consts ********************************************/
+constexpr uint32_t log_write_timeout_ticks = 100;  //!< longest a log message waits for tx buffer space
 
 /************************************ Types ********************************************/
 /**
- * \brief class definition for a debug port
+ * \brief class definition for a debug port. Log messages are deferred to the os logger, which formats them on
+ *        its own thread and writes them back out through the port.
+ * \note the tx buffer takes a single producer, so every thread writes through write(), which serializes them.
+ *       Calling send() directly is only safe before the kernel starts.
  * 
  */
-class DebugPort : public HAL::USARTInterrupt {
+class DebugPort : public HAL::USARTDMA, public os::log_sink {
   private:
-    std::unique_ptr<char[]> print_buffer;
-    size_t print_buffer_size;
-    void log_message(const char* message, const char* tag, va_list args);
+    os::semaphore data_received;   //!< signalled by the receive interrupts, so readers can block for input
+    os::semaphore transmit_space;  //!< signalled by the transmit interrupts, so writers can block for space
+    os::mutex writer_lock;         //!< held by the thread writing into the tx buffer
+    void on_receive(bool end_of_frame) override;
+    void on_transmit_space(void) override;
 
   public:
     DebugPort();
-    DebugPort(USART_TypeDef* usart, size_t tx_size, size_t rx_size);
+    explicit DebugPort(USART_TypeDef* usart);
     void initialize(void);
-    void debug(const char* message, ...);
-    void info(const char* message, ...);
-    void warning(const char* message, ...);
-    void error(const char* message, ...);
+    void update_baudrate(void);
+    size_t read(uint8_t* data, size_t size, uint32_t ticks);
+    size_t write(const uint8_t* data, size_t size, uint32_t ticks);
+    size_t write(const char* data, uint32_t ticks);
+    void write(os::log_level level, const char* text, size_t size) override;
+
+    /**
+     * \brief log a debug message
+     *
+     * \param message printf style format string literal
+     * \param args format arguments. Strings must be literals too, they are formatted later.
+     */
+    template <typename... Args>
+    void debug(const char* message, Args... args) {
+        OS_LOG(os::log_level::debug, os::log_module_default, message, args...);
+    }
+
+    /**
+     * \brief log an info message
+     *
+     * \param message printf style format string literal
+     * \param args format arguments. Strings must be literals too, they are formatted later.
+     */
+    template <typename... Args>
+    void info(const char* message, Args... args) {
+        OS_LOG(os::log_level::info, os::log_module_default, message, args...);
+    }
+
+    /**
+     * \brief log a warning
+     *
+     * \param message printf style format string literal
+     * \param args format arguments. Strings must be literals too, they are formatted later.
+     */
+    template <typename... Args>
+    void warning(const char* message, Args... args) {
+        OS_LOG(os::log_level::warning, os::log_module_default, message, args...);
+    }
+
+    /**
+     * \brief log an error
+     *
+     * \param message printf style format string literal
+     * \param args format arguments. Strings must be literals too, they are formatted later.
+     */
+    template <typename... Args>
+    void error(const char* message, Args... args) {
+        OS_LOG(os::log_level::error, os::log_module_default, message, args...);
+    }
 };
 
 /*********************************** Macros ********************************************/
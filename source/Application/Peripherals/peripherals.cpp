@@ -8,12 +8,17 @@
 
 /********************************** Includes *******************************************/
 #include "peripherals.h"
+#include "analog_sampler.h"
+#include "audio_output.h"
 #include "debug_port.h"
 #include "hal_flash.h"
 #include "hal_interrupt.h"
 #include "hal_power.h"
 #include "hal_rcc.h"
 #include "lis3dsh.h"
+#include "power_manager.h"
+#include "spi_bus.h"
+#include "timestamp_timer.h"
 #include "os.h"
 
 
@@ -30,10 +35,6 @@ constexpr HAL::PLLSource RCC_PLL_SOURCE = HAL::PLLSource::high_speed_external;
 /*********************************** Macros ********************************************/
 
 /******************************* Global Variables **************************************/
-HAL::OutputPin green_led(GPIOD, HAL::Pins::pin_12, HAL::PinMode::output, HAL::Speed::low, HAL::PullMode::pull_down, HAL::OutputMode::push_pull);
-HAL::OutputPin orange_led(GPIOD, HAL::Pins::pin_13, HAL::PinMode::output, HAL::Speed::low, HAL::PullMode::pull_down, HAL::OutputMode::push_pull);
-HAL::OutputPin red_led(GPIOD, HAL::Pins::pin_14, HAL::PinMode::output, HAL::Speed::low, HAL::PullMode::pull_down, HAL::OutputMode::push_pull);
-HAL::OutputPin blue_led(GPIOD, HAL::Pins::pin_15, HAL::PinMode::output, HAL::Speed::low, HAL::PullMode::pull_down, HAL::OutputMode::push_pull);
 
 /******************************** Local Variables **************************************/
 
@@ -65,14 +66,27 @@ void initialize_peripherals(void) {
     debug_port.send("   Date: November 1, 2020 \n");
     debug_port.send("~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~\n");    
 
-    /* turn on the LEDs for status indication */
-    green_led.set(true);
-    orange_led.set(false);
-    red_led.set(true);
-    blue_led.set(false);
+    /* turn on the green and red LEDs for status indication */
+    StatusLEDs::configure(HAL::PinMode::output, HAL::Speed::low, HAL::PullMode::pull_down, HAL::OutputMode::push_pull);
+    StatusLEDs::write(0b0101);
 
-    /* initialize the accelerometer */
-    //accelerometer.initialize();
+    /* start the microsecond timestamps before anything that stamps its events */
+    initialize_timestamp_timer();
+
+    /* initialize the shared SPI bus, then the accelerometer on it. Its register setup waits on the bus completion
+       interrupt, and a watermark before the kernel starts only leaves its burst queued for the deferred work thread */
+    initialize_spi_bus();
+    accelerometer.initialize();
+
+    /* set up the analog inputs, which aren't sampled until something starts them */
+    initialize_analog_sampler();
+
+    /* set up the audio codec, which stays powered down with its clocks off until playback is started */
+    audio_output.initialize();
+
+    /* let the idle thread stop the core once every peripheral clock has been released, and start at the slower
+       background clock speed */
+    initialize_power_manager();
 }
 
 /**
@@ -117,17 +131,17 @@ void system_boot(void) {
     } while ( pll_ready == false );
 
     /* Configure Flash prefetch, Instruction cache, Data cache and wait state */
-    HAL::flash.set_access_control_register(HAL::FlashAccessControlRegister::prefetch_enable, 0x01);
-    HAL::flash.set_access_control_register(HAL::FlashAccessControlRegister::instruction_cache_enable, 0x01);
-    HAL::flash.set_access_control_register(HAL::FlashAccessControlRegister::data_cache_enable, 0x01);
-    HAL::flash.set_access_control_register(HAL::FlashAccessControlRegister::latency, 0x05);
+    HAL::flash.modify_access_control_register(HAL::field(HAL::FlashAccessControlRegister::prefetch_enable, 0x01)
+                                              | HAL::field(HAL::FlashAccessControlRegister::instruction_cache_enable, 0x01)
+                                              | HAL::field(HAL::FlashAccessControlRegister::data_cache_enable, 0x01)
+                                              | HAL::field(HAL::FlashAccessControlRegister::latency, 0x05));
 
     /* set the system clock source */
     HAL::reset_control_clock.set_system_clock_source(HAL::SystemClockSource::phase_locked_loop);
 
     //!< setup the scheduler clock ticks
     uint32_t sys_clock = HAL::reset_control_clock.get_clock_speed(HAL::Clocks::AHB1);
-    os::kernel::set_systick_frequency(sys_clock / 1000);
+    os::kernel::set_systick_frequency(sys_clock / os::system_clock::tick_frequency_hz);
 }
 
 /**
@@ -15,15 +15,18 @@
 /*********************************** Consts ********************************************/
 
 /************************************ Types ********************************************/
+/* LEDS */
+using GreenLED = HAL::Pin<GPIOD_BASE, 12>;
+using OrangeLED = HAL::Pin<GPIOD_BASE, 13>;
+using RedLED = HAL::Pin<GPIOD_BASE, 14>;
+using BlueLED = HAL::Pin<GPIOD_BASE, 15>;
+using StatusLEDs = HAL::PinGroup<GPIOD_BASE, 12, 13, 14, 15>;  //!< green, orange, red and blue
+using GreenBlueLEDs = HAL::PinGroup<GPIOD_BASE, 12, 15>;
+using RedOrangeLEDs = HAL::PinGroup<GPIOD_BASE, 14, 13>;
 
 /*********************************** Macros ********************************************/
 
 /******************************* Global Variables **************************************/
-/* LEDS */
-extern HAL::OutputPin green_led;
-extern HAL::OutputPin orange_led;
-extern HAL::OutputPin red_led;
-extern HAL::OutputPin blue_led;
 
 /****************************** Functions Prototype ************************************/
 void initialize_peripherals(void);
@@ -0,0 +1,138 @@
+/*! \file power_manager.cpp
+*
+*  \brief low power run mode manager. Drivers request their peripheral clocks through the RCC while they need
+*         them, and once every request has been released the idle thread stops the core rather than just
+*         sleeping it. The PLL is restarted on the way back out.
+*
+*         The clock speed is scaled at run time too. Threads request full speed while they have processing to
+*         get through, and the rest of the time the system runs at a slower background level.
+*
+*
+*  \author Graham Riches
+*/
+
+/********************************** Includes *******************************************/
+#include "power_manager.h"
+#include "analog_sampler.h"
+#include "cm4_port.h"
+#include "debug_port.h"
+#include "hal_power.h"
+#include "mutex.h"
+#include "profiler.h"
+#include "spi_bus.h"
+#include "system_clock.h"
+#include "timestamp_timer.h"
+#include "trace.h"
+
+/******************************** Local Variables **************************************/
+static uint32_t stop_count = 0;
+static os::cycle_stats wakeup_cycles;
+
+static os::mutex performance_lock;
+static uint8_t full_performance_requests = 0;
+static HAL::PerformanceLevel background_level = HAL::PerformanceLevel::half;  //!< keeps the APB speeds of full
+
+/****************************** Functions Prototype ************************************/
+static bool enter_stop_mode(void);
+static void apply_performance_level(HAL::PerformanceLevel level);
+
+/****************************** Functions Definition ***********************************/
+/**
+ * \brief register the STOP mode handler with the idle thread and drop to the background clock level. Call this
+ *        once the clocks and the peripherals that depend on them are set up.
+ */
+void initialize_power_manager(void) {
+    os::set_deep_sleep_handler(enter_stop_mode);
+    apply_performance_level(background_level);
+}
+
+/**
+ * \brief take a consistent copy of the STOP mode stats
+ *
+ * \retval PowerStats the stats
+ */
+PowerStats get_power_stats(void) {
+    os::critical_section critical;
+    return PowerStats{stop_count, wakeup_cycles, HAL::reset_control_clock.get_requested_clock_count(),
+                      HAL::reset_control_clock.get_performance_level()};
+}
+
+/**
+ * \brief set the clock profile used while no thread has requested full speed
+ *
+ * \param level the background clock profile
+ */
+void set_background_performance_level(HAL::PerformanceLevel level) {
+    performance_lock.lock();
+    background_level = level;
+    if ( full_performance_requests == 0 ) {
+        apply_performance_level(level);
+    }
+    performance_lock.unlock();
+}
+
+/**
+ * \brief switch to full speed until every request has been released. Only call this from threads.
+ */
+void request_full_performance(void) {
+    performance_lock.lock();
+    if ( full_performance_requests++ == 0 ) {
+        apply_performance_level(HAL::PerformanceLevel::full);
+    }
+    performance_lock.unlock();
+}
+
+/**
+ * \brief release a full speed request, dropping back to the background level with the last one
+ */
+void release_full_performance(void) {
+    performance_lock.lock();
+    if ( (full_performance_requests > 0) && (--full_performance_requests == 0) ) {
+        apply_performance_level(background_level);
+    }
+    performance_lock.unlock();
+}
+
+/**
+ * \brief switch the clock profile and bring everything that was set up from the old clock speeds back in step
+ *
+ * \param level the new clock profile
+ */
+static void apply_performance_level(HAL::PerformanceLevel level) {
+    if ( level == HAL::reset_control_clock.get_performance_level() ) {
+        return;
+    }
+
+    /* let the SPI transfer in flight finish at the old rate, the bus queues the rest until its prescalers are redone */
+    spi_1_bus.suspend();
+    while ( spi_1_bus.is_busy() ) {
+    }
+
+    HAL::reset_control_clock.set_performance_level(level);
+    OS_TRACE_EVENT(os::trace_event::clock_change, 0, HAL::reset_control_clock.get_clock_speed(HAL::Clocks::AHB1));
+    os::set_tick_period_counts(HAL::reset_control_clock.get_clock_speed(HAL::Clocks::AHB1) / os::system_clock::tick_frequency_hz);
+    debug_port.update_baudrate();
+    timestamp_timer.update_tick_frequency();
+    update_analog_sampler_clocks();
+    spi_1_bus.resume();
+}
+
+/**
+ * \brief stop the core if no peripheral needs its clock. Called from the idle thread with interrupts disabled.
+ *
+ * \retval true if the core was stopped
+ * \note the core wakes on the internal oscillator, so the cycle counter is sampled at 16 MHz until the PLL
+ *       is back. The regulator wakeup before the first instruction runs can't be measured and isn't included.
+ */
+static bool enter_stop_mode(void) {
+    if ( HAL::reset_control_clock.get_requested_clock_count() > 0 ) {
+        return false;
+    }
+
+    HAL::power_management.enter_stop_mode(true);
+    uint32_t wakeup_start = os::profiler::get_cycles();
+    HAL::reset_control_clock.restore_main_pll();
+    wakeup_cycles.record(os::profiler::get_cycles() - wakeup_start);
+    stop_count++;
+    return true;
+}
@@ -0,0 +1,32 @@
+/*! \file power_manager.h
+*
+*  \brief low power run mode manager. The idle thread stops the core whenever no peripheral holds a clock request.
+*
+*
+*  \author Graham Riches
+*/
+
+#pragma once
+
+/********************************** Includes *******************************************/
+#include "common.h"
+#include "cycle_stats.h"
+#include "hal_rcc.h"
+
+/************************************ Types ********************************************/
+/**
+ * \brief snapshot of the STOP mode entries since boot
+ */
+struct PowerStats {
+    uint32_t stop_count;             //!< times the core was stopped
+    os::cycle_stats wakeup_cycles;   //!< HSI cycles spent restarting the PLL after each wakeup
+    uint16_t requested_clock_count;  //!< peripheral clocks that currently keep the core out of STOP
+    HAL::PerformanceLevel level;     //!< the active clock profile
+};
+
+/****************************** Functions Prototype ************************************/
+void initialize_power_manager(void);
+PowerStats get_power_stats(void);
+void set_background_performance_level(HAL::PerformanceLevel level);
+void request_full_performance(void);
+void release_full_performance(void);
@@ -15,10 +15,34 @@
 /*********************************** Consts ********************************************/
 
 /************************************ Types ********************************************/
+/**
+ * \brief keys of the settings kept in the flash key-value store. Don't reuse or renumber a key once it has shipped,
+ *        the old value would be read back as the new setting.
+ */
+enum class SettingsKey : uint16_t {
+    vibration_low_pass = 1,  //!< dsp::biquad_coefficients_q14 of the accelerometer low-pass filter
+};
 
 /*********************************** Macros ********************************************/
 #define PARAMETER_NOT_USED(X) (void)(X)
 
+/* place data in the 64KB core coupled memory, which runs at zero wait states and is only reachable by the core, so
+   it never contends with the DMA streams. Nothing the DMA reads or writes can live there. CCM_RAM data is zeroed
+   at startup like .bss and CCM_RAM_DATA keeps its initializer. */
+#define CCM_RAM __attribute__((section(".ccmram_bss")))
+#define CCM_RAM_DATA __attribute__((section(".ccmram")))
+
+/* run a function from SRAM, out of reach of the flash wait states when it misses the ART cache. The startup code
+   copies it in along with .data. Each function gets its own section, as GCC won't mix inline functions with the
+   rest in one named section. */
+#define RAM_FUNCTION_SECTION_NAME(counter) ".ramfunc." #counter
+#define RAM_FUNCTION_SECTION(counter) RAM_FUNCTION_SECTION_NAME(counter)
+#if defined(HAL_RAM_FUNCTIONS) && defined(__arm__)
+#    define RAM_FUNCTION __attribute__((section(RAM_FUNCTION_SECTION(__COUNTER__)), long_call, noinline))
+#else
+#    define RAM_FUNCTION
+#endif
+
 #ifndef NULL
 #    define NULL ((void*)0)
 #endif
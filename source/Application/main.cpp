@@ -9,27 +9,34 @@
 #include "common.h"
 #include "debug_port.h"
 #include "peripherals.h"
+#include "shell.h"
+#include "vibration.h"
 #include "stm32f4xx.h"
+#include "log.h"
+#include "log_sinks.h"
 #include "os.h"
+#include "timer.h"
+#include "deferred_work.h"
+#include "trace.h"
+#include "kv_store.h"
 #include <stdio.h>
 #include <string.h>
 
 
 /*********************************** Consts ********************************************/
-constexpr uint8_t thread_stack_size = 128;
+constexpr uint32_t blink_period_ticks = 100;
 
 /*********************************** Local Function Declarations ********************************************/
-static void thread_one_task(void *arguments);
-static void thread_two_task(void *arguments);
+static void blink_one_callback(void *arguments);
+static void blink_two_callback(void *arguments);
 
 /*********************************** Local Variables ********************************************/
-/* create the thread stacks */
-static uint32_t thread_one_stack[thread_stack_size] = {0};
-static uint32_t thread_two_stack[thread_stack_size] = {0};
+static os::itm_log_sink trace_log;
+static os::ram_log_sink crash_log;
 
-/* create the threads */
-static os::thread thread_one(thread_one_task, nullptr, 1, thread_one_stack, thread_stack_size);
-static os::thread thread_two(thread_two_task, nullptr, 2, thread_two_stack, thread_stack_size);
+/* the periodic jobs share the timer thread's stack */
+static os::timer blink_one_timer(blink_one_callback, nullptr, blink_period_ticks, os::timer::mode::periodic);
+static os::timer blink_two_timer(blink_two_callback, nullptr, blink_period_ticks, os::timer::mode::periodic);
 
 /*********************************** Function Definitions ********************************************/
 /**
@@ -37,9 +44,22 @@ static os::thread thread_two(thread_two_task, nullptr, 2, thread_two_stack, thre
   * \retval int
   */
 int main(void) {
-    //!< register the threads
-    os::scheduler::register_new_thread(&thread_one);
-    os::scheduler::register_new_thread(&thread_two);
+    //!< mount the settings store, route the logs to the debug port, the debugger's SWO trace and the crash log, then
+    //!< register the log, timer, deferred work and trace threads and start the periodic jobs. Only warnings and errors
+    //!< are kept in the crash log.
+    os::kv_store::initialize();
+    crash_log.initialize();
+    os::logger::add_sink(&debug_port);
+    os::logger::add_sink(&trace_log);
+    os::logger::add_sink(&crash_log, os::log_level::warning);
+    os::logger::initialize();
+    os::timer_service::initialize();
+    os::deferred_work::initialize();
+    os::trace::initialize();
+    shell_initialize();
+    vibration_initialize();
+    blink_one_timer.start();
+    blink_two_timer.start();
 
     //!< configure the project specific HAL drivers and bootup the chip, clocks etc.
     initialize_peripherals();    
@@ -53,27 +73,19 @@ int main(void) {
 }
 
 /**
- * \brief first task to blink two LEDs
+ * \brief first periodic job to blink two LEDs
  */
-static void thread_one_task(void *arguments) {
+static void blink_one_callback(void *arguments) {
     PARAMETER_NOT_USED(arguments);
-    while ( true ) {        
-        debug_port.send("a\n");
-        green_led.toggle();
-        blue_led.toggle();
-        os::scheduler::sleep(100);
-    }
+    debug_port.info("a");
+    GreenBlueLEDs::toggle();
 }
 
 /**
- * \brief second task to blink the other two LEDs
+ * \brief second periodic job to blink the other two LEDs
  */
-static void thread_two_task(void *arguments) {
+static void blink_two_callback(void *arguments) {
     PARAMETER_NOT_USED(arguments);
-    while ( true ) {
-        debug_port.send("b\n");
-        red_led.toggle();
-        orange_led.toggle();
-        os::scheduler::sleep(100);
-    }
+    debug_port.info("b");
+    RedOrangeLEDs::toggle();
 }
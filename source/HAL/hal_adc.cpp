@@ -0,0 +1,206 @@
+/*! \file hal_adc.cpp
+*
+*  \brief HAL++ implementation of the scan mode ADC with circular DMA.
+*
+*
+*  \author Graham Riches
+*/
+
+/********************************** Includes *******************************************/
+#include "hal_adc.h"
+#include <cassert>
+
+
+namespace HAL
+{
+
+/*********************************** Consts ********************************************/
+constexpr uint32_t max_adc_clock = 36000000;       //!< fastest ADC clock at the full supply voltage
+constexpr uint8_t adc_prescaler_offset = 16;       //!< ADCPRE in the common control register
+constexpr uint32_t adc_prescaler_mask = 0x03;
+constexpr uint8_t sample_time_width = 3;
+constexpr uint8_t sample_time_channels = 10;       //!< channels per sample time register, 10 and up are in SMPR1
+constexpr uint8_t sequence_width = 5;
+constexpr uint8_t sequence_slots = 6;              //!< sequence slots per register, from SQR3 up to SQR1
+constexpr uint8_t sequence_length_offset = 20;     //!< L in SQR1, the sequence length less one
+constexpr uint32_t rising_edge_trigger = 0b01;
+constexpr uint32_t resolution_12_bit = 0b00;
+
+/****************************** Function Definitions ***********************************/
+/**
+ * \brief Construct a new ADCDMA object
+ *
+ * \param adc the ADC
+ * \param bus_clock the bus the ADC is clocked from, APB2 for all of them
+ * \param stream the DMA stream wired to the ADC's request
+ * \note the ADC and DMA clock enables are requested separately, as with every other driver
+ */
+ADCDMA::ADCDMA(ADC_TypeDef* adc, Clocks bus_clock, DMAStream stream)
+    : adc(adc)
+    , bus_clock(bus_clock)
+    , stream(stream)
+    , trigger(ADCTrigger::timer_2_trigger_output)
+    , buffer(nullptr)
+    , count(0)
+    , priority(DMAPriority::high)
+    , callback(nullptr)
+    , context(nullptr)
+    , overruns(0) {
+    assert((adc == ADC1) || (adc == ADC2) || (adc == ADC3));
+}
+
+/**
+ * \brief set up the sequence of channels converted on each rising edge of the trigger. The ADC clock prescaler,
+ *        shared by all three ADCs, is set to the fastest rate the bus clock allows.
+ *
+ * \param channels the channels in the order they are converted, which is the order they land in the buffer
+ * \param count number of channels, from 1 to 16
+ * \param sample_time sampling time used for every channel in the sequence
+ * \param trigger the trigger, usually a timer's trigger output to pace the sampling
+ */
+void ADCDMA::configure(const ADCChannel* channels, uint8_t count, ADCSampleTime sample_time, ADCTrigger trigger) {
+    assert((count > 0) && (count <= adc_max_sequence_length));
+    this->stop();
+    this->trigger = trigger;
+
+    uint32_t bus_speed = reset_control_clock.get_clock_speed(this->bus_clock);
+    uint32_t prescaler = 0;
+    while ( (prescaler < adc_prescaler_mask) && ((bus_speed / ((prescaler + 1) * 2)) > max_adc_clock) ) {
+        prescaler++;
+    }
+    ADC->CCR = (ADC->CCR & ~(adc_prescaler_mask << adc_prescaler_offset)) | (prescaler << adc_prescaler_offset);
+
+    /* work the sequence and sample time registers out in full, so channels left from before are cleared */
+    uint32_t sequence[3] = {0, 0, 0};
+    uint32_t sample_times[2] = {0, 0};
+    for ( uint8_t index = 0; index < count; index++ ) {
+        uint8_t channel = static_cast<uint8_t>(channels[index]);
+        sequence[index / sequence_slots] |= static_cast<uint32_t>(channel) << ((index % sequence_slots) * sequence_width);
+        sample_times[channel / sample_time_channels] |= static_cast<uint32_t>(sample_time)
+                                                        << ((channel % sample_time_channels) * sample_time_width);
+    }
+    this->adc->SQR3 = sequence[0];
+    this->adc->SQR2 = sequence[1];
+    this->adc->SQR1 = sequence[2] | (static_cast<uint32_t>(count - 1) << sequence_length_offset);
+    this->adc->SMPR2 = sample_times[0];
+    this->adc->SMPR1 = sample_times[1];
+
+    this->modify_control_register(field(ADCControlRegister1::scan_mode, 0x01) | field(ADCControlRegister1::resolution, resolution_12_bit)
+                                  | field(ADCControlRegister1::overrun_interrupt_enable, 0x01));
+    this->modify_control_register(field(ADCControlRegister2::left_align, 0x01) | field(ADCControlRegister2::continuous, 0x00)
+                                  | field(ADCControlRegister2::end_of_conversion_select, 0x00) | field(ADCControlRegister2::adc_on, 0x01));
+}
+
+/**
+ * \brief start converting into a buffer in a loop on each trigger. The callback is called for each half as the
+ *        stream finishes filling it.
+ *
+ * \param buffer where to store the interleaved samples, which must stay valid until stop
+ * \param count number of samples in the whole buffer, a whole number of sequences in each half
+ * \param priority stream priority
+ * \retval true if started, false if the buffer is somewhere the DMA can't reach
+ */
+bool ADCDMA::start(volatile uint16_t* buffer, uint16_t count, DMAPriority priority) {
+    assert((count % 2) == 0);
+    if ( !is_dma_accessible(buffer) ) {
+        return false;
+    }
+
+    this->buffer = buffer;
+    this->count = count;
+    this->priority = priority;
+    this->start_stream();
+    this->modify_control_register(field(ADCControlRegister2::external_trigger_select, static_cast<uint32_t>(this->trigger))
+                                  | field(ADCControlRegister2::external_trigger_enable, rising_edge_trigger));
+    return true;
+}
+
+/**
+ * \brief stop converting and stop the stream. A sequence part way through is abandoned.
+ */
+void ADCDMA::stop(void) {
+    this->modify_control_register(field(ADCControlRegister2::external_trigger_enable, 0x00) | field(ADCControlRegister2::dma_enable, 0x00)
+                                  | field(ADCControlRegister2::dma_continuous_requests, 0x00));
+    this->stream.stop();
+    this->buffer = nullptr;
+}
+
+/**
+ * \brief register the function called from the stream interrupt as each half of the buffer is filled
+ *
+ * \param callback the callback, or nullptr for none
+ * \param context passed through to the callback
+ */
+void ADCDMA::set_callback(ADCCallback callback, void* context) {
+    this->callback = callback;
+    this->context = context;
+}
+
+/**
+ * \brief stream and ADC interrupt handler. If the stream handler is late enough that both flags are set, the first
+ *        half is reported before the second, which is the order they were filled in.
+ *
+ * \param type stream_irq_type or adc_irq_type
+ */
+void ADCDMA::irq_handler(uint8_t type) {
+    if ( type == adc_irq_type ) {
+        if ( (this->adc->SR & (0x01u << static_cast<uint8_t>(ADCStatusRegister::overrun))) == 0 ) {
+            return;
+        }
+
+        /* the DMA requests stop with an overrun, and only start again with the DMA enable cleared and set */
+        this->overruns++;
+        this->modify_control_register(field(ADCControlRegister2::dma_enable, 0x00));
+        this->stream.stop();
+        this->adc->SR = ~(0x01u << static_cast<uint8_t>(ADCStatusRegister::overrun));
+        if ( this->buffer != nullptr ) {
+            this->start_stream();
+        }
+        return;
+    }
+
+    if ( this->stream.get_flag(DMAInterruptFlag::half_transfer) ) {
+        this->stream.clear_flag(DMAInterruptFlag::half_transfer);
+        if ( this->callback != nullptr ) {
+            this->callback(this->context, 0);
+        }
+    }
+
+    if ( this->stream.get_flag(DMAInterruptFlag::transfer_complete) ) {
+        this->stream.clear_flag(DMAInterruptFlag::transfer_complete);
+        if ( this->callback != nullptr ) {
+            this->callback(this->context, 1);
+        }
+    }
+}
+
+/**
+ * \brief set the stream going from the start of the buffer and switch the ADC's DMA requests on
+ */
+void ADCDMA::start_stream(void) {
+    this->stream.configure(DMADirection::peripheral_to_memory, DMADataSize::half_word, true, true, this->priority);
+    this->stream.enable_interrupt(DMAStreamControlRegister::half_transfer_interrupt_enable, true);
+    this->stream.enable_interrupt(DMAStreamControlRegister::transfer_complete_interrupt_enable, true);
+    this->stream.start(&this->adc->DR, const_cast<uint16_t*>(this->buffer), this->count);
+    this->modify_control_register(field(ADCControlRegister2::dma_enable, 0x01) | field(ADCControlRegister2::dma_continuous_requests, 0x01));
+}
+
+/**
+ * \brief update fields in control register 1
+ *
+ * \param value the fields to write
+ */
+void ADCDMA::modify_control_register(RegisterValue<ADCControlRegister1> value) {
+    value.modify(this->adc->CR1);
+}
+
+/**
+ * \brief update fields in control register 2
+ *
+ * \param value the fields to write
+ */
+void ADCDMA::modify_control_register(RegisterValue<ADCControlRegister2> value) {
+    value.modify(this->adc->CR2);
+}
+
+};  // namespace HAL
@@ -0,0 +1,199 @@
+/*! \file hal_adc.h
+*
+*  \brief hal_adc module functions and variables declarations.
+*
+*
+*  \author Graham Riches
+*/
+
+#pragma once
+
+/********************************** Includes *******************************************/
+#include "common.h"
+#include "hal_dma.h"
+#include "hal_interrupt.h"
+#include "hal_rcc.h"
+#include "hal_register.h"
+#include "stm32f4xx.h"
+
+namespace HAL
+{
+/*********************************** Consts ********************************************/
+constexpr uint8_t adc_max_sequence_length = 16;
+
+/************************************ Types ********************************************/
+/**
+ * \brief bit offsets for the ADC status register
+ */
+enum class ADCStatusRegister : unsigned {
+    analog_watchdog = 0,
+    end_of_conversion = 1,
+    injected_end_of_conversion = 2,
+    injected_start = 3,
+    regular_start = 4,
+    overrun = 5
+};
+
+/**
+ * \brief bit offsets for ADC control register 1
+ */
+enum class ADCControlRegister1 : unsigned {
+    end_of_conversion_interrupt_enable = 5,
+    scan_mode = 8,
+    resolution = 24,
+    overrun_interrupt_enable = 26
+};
+
+/**
+ * \brief the resolution is the only ADC control register 1 field wider than a bit
+ */
+constexpr uint8_t get_field_width(ADCControlRegister1 field) {
+    return (field == ADCControlRegister1::resolution) ? 2 : 1;
+}
+
+/**
+ * \brief bit offsets for ADC control register 2
+ */
+enum class ADCControlRegister2 : unsigned {
+    adc_on = 0,
+    continuous = 1,
+    dma_enable = 8,
+    dma_continuous_requests = 9,
+    end_of_conversion_select = 10,
+    left_align = 11,
+    external_trigger_select = 24,
+    external_trigger_enable = 28,
+    software_start = 30
+};
+
+/**
+ * \brief the external trigger select and enable are the ADC control register 2 fields wider than a bit
+ */
+constexpr uint8_t get_field_width(ADCControlRegister2 field) {
+    return (field == ADCControlRegister2::external_trigger_select) ? 4 : ((field == ADCControlRegister2::external_trigger_enable) ? 2 : 1);
+}
+
+/**
+ * \brief analog input channels. The internal channels are only on ADC1.
+ */
+enum class ADCChannel : unsigned {
+    channel_0 = 0,
+    channel_1,
+    channel_2,
+    channel_3,
+    channel_4,
+    channel_5,
+    channel_6,
+    channel_7,
+    channel_8,
+    channel_9,
+    channel_10,
+    channel_11,
+    channel_12,
+    channel_13,
+    channel_14,
+    channel_15,
+    temperature,
+    reference,
+    battery,
+};
+
+/**
+ * \brief sampling time of each channel in ADC clock cycles, on top of the 12 for the conversion itself
+ */
+enum class ADCSampleTime : unsigned {
+    cycles_3 = 0b000,
+    cycles_15 = 0b001,
+    cycles_28 = 0b010,
+    cycles_56 = 0b011,
+    cycles_84 = 0b100,
+    cycles_112 = 0b101,
+    cycles_144 = 0b110,
+    cycles_480 = 0b111,
+};
+
+/**
+ * \brief regular conversion triggers, as written to the EXTSEL field
+ */
+enum class ADCTrigger : unsigned {
+    timer_1_compare_1 = 0b0000,
+    timer_1_compare_2 = 0b0001,
+    timer_1_compare_3 = 0b0010,
+    timer_2_compare_2 = 0b0011,
+    timer_2_compare_3 = 0b0100,
+    timer_2_compare_4 = 0b0101,
+    timer_2_trigger_output = 0b0110,
+    timer_3_compare_1 = 0b0111,
+    timer_3_trigger_output = 0b1000,
+    timer_4_compare_4 = 0b1001,
+    timer_5_compare_1 = 0b1010,
+    timer_5_compare_2 = 0b1011,
+    timer_5_compare_3 = 0b1100,
+    timer_8_compare_1 = 0b1101,
+    timer_8_trigger_output = 0b1110,
+    exti_11 = 0b1111,
+};
+
+/**
+ * \brief callback from the DMA interrupt each time the stream finishes filling one half of the buffer
+ *
+ * \param context the context registered with the callback
+ * \param half the half of the buffer that has just been filled and can be read, 0 or 1
+ */
+using ADCCallback = void (*)(void* context, uint8_t half);
+
+/**
+ * \brief scan mode ADC converting a sequence of channels on each trigger, with circular DMA into a buffer of
+ *        interleaved 12-bit samples. The stream interrupts halfway through the buffer and again at the end, so one
+ *        half can be read while the other fills and there is no interrupt per sample. Samples are left aligned, so
+ *        flipping the top bit turns them into signed q15 values centered on mid scale.
+ * \note an overrun, where the DMA falls behind the conversions, stops the ADC's DMA requests. The ADC interrupt
+ *       counts it and restarts the stream from the start of the buffer at the next trigger.
+ */
+class ADCDMA : public InterruptPeripheral {
+  public:
+    static constexpr uint8_t stream_irq_type = 0;  //!< irq type to register the stream interrupt with
+    static constexpr uint8_t adc_irq_type = 1;     //!< irq type to register the shared ADC interrupt with
+
+    ADCDMA(ADC_TypeDef* adc, Clocks bus_clock, DMAStream stream);
+
+    void configure(const ADCChannel* channels, uint8_t count, ADCSampleTime sample_time, ADCTrigger trigger);
+    bool start(volatile uint16_t* buffer, uint16_t count, DMAPriority priority);
+    void stop(void);
+    void set_callback(ADCCallback callback, void* context);
+
+    /**
+     * \brief get the number of overruns since the driver was constructed
+     *
+     * \retval uint32_t overruns
+     */
+    uint32_t get_overrun_count(void) const {
+        return this->overruns;
+    }
+
+    RAM_FUNCTION void irq_handler(uint8_t type) override;
+
+  private:
+    void start_stream(void);
+    void modify_control_register(RegisterValue<ADCControlRegister1> value);
+    void modify_control_register(RegisterValue<ADCControlRegister2> value);
+
+    ADC_TypeDef* adc;
+    Clocks bus_clock;
+    DMAStream stream;
+    ADCTrigger trigger;
+    volatile uint16_t* buffer;
+    uint16_t count;
+    DMAPriority priority;
+    ADCCallback callback;
+    void* context;
+    volatile uint32_t overruns;
+};
+
+/*********************************** Macros ********************************************/
+
+/******************************* Global Variables **************************************/
+
+/****************************** Functions Prototype ************************************/
+
+};  // namespace HAL
@@ -0,0 +1,175 @@
+/*! \file hal_dma.cpp
+*
+*  \brief HAL++ implementation of the STM32 DMA streams.
+*
+*
+*  \author Graham Riches
+*/
+
+/********************************** Includes *******************************************/
+#include "hal_dma.h"
+#include <cassert>
+
+
+namespace HAL
+{
+
+/*********************************** Consts ********************************************/
+constexpr uint8_t streams_per_flag_register = 4;
+constexpr uint8_t stream_flag_offsets[streams_per_flag_register] = {0, 6, 16, 22};  //!< first flag bit of each stream
+constexpr uint32_t stream_flag_mask = 0x3D;                                         //!< every flag in a stream's group
+
+/****************************** Function Definitions ***********************************/
+/**
+ * \brief Construct a new DMAStream object
+ *
+ * \param dma the DMA controller
+ * \param stream the stream within the controller
+ * \param stream_number index of the stream, which selects its flags in the status registers
+ * \param channel the request channel the stream is triggered by
+ */
+DMAStream::DMAStream(DMA_TypeDef* dma, DMA_Stream_TypeDef* stream, uint8_t stream_number, DMAChannel channel)
+    : dma(dma)
+    , stream(stream)
+    , stream_number(stream_number)
+    , channel(channel) {
+    assert(dma != nullptr);
+    assert(stream != nullptr);
+    assert(stream_number < 8);
+}
+
+/**
+ * \brief configure the stream for the transfers it will make. This disables the stream.
+ *
+ * \param direction transfer direction
+ * \param size data size, used for both the memory and peripheral sides
+ * \param memory_increment true to step through memory, false to repeat the same memory address
+ * \param circular true to restart the transfer automatically when it completes
+ * \param priority stream priority
+ */
+void DMAStream::configure(DMADirection direction, DMADataSize size, bool memory_increment, bool circular, DMAPriority priority) {
+    this->stop();
+
+    uint32_t size_value = static_cast<uint32_t>(size);
+    this->stream->CR = (static_cast<uint32_t>(this->channel) << static_cast<uint8_t>(DMAStreamControlRegister::channel_select))
+                       | (static_cast<uint32_t>(priority) << static_cast<uint8_t>(DMAStreamControlRegister::priority_level))
+                       | (size_value << static_cast<uint8_t>(DMAStreamControlRegister::memory_size))
+                       | (size_value << static_cast<uint8_t>(DMAStreamControlRegister::peripheral_size))
+                       | (static_cast<uint32_t>(memory_increment) << static_cast<uint8_t>(DMAStreamControlRegister::memory_increment))
+                       | (static_cast<uint32_t>(circular) << static_cast<uint8_t>(DMAStreamControlRegister::circular_mode))
+                       | (static_cast<uint32_t>(direction) << static_cast<uint8_t>(DMAStreamControlRegister::direction));
+
+    /* direct mode, the FIFO is bypassed so each request moves a single item straight through */
+    this->stream->FCR = 0;
+}
+
+/**
+ * \brief enable or disable one of the stream interrupts
+ *
+ * \param interrupt one of the *_interrupt_enable bits
+ * \param enable true to enable
+ */
+void DMAStream::enable_interrupt(DMAStreamControlRegister interrupt, bool enable) {
+    uint32_t mask = 0x01u << static_cast<uint8_t>(interrupt);
+    if ( enable ) {
+        this->stream->CR |= mask;
+    } else {
+        this->stream->CR &= ~mask;
+    }
+}
+
+/**
+ * \brief change whether the stream steps through memory. The stream must be idle.
+ *
+ * \param memory_increment true to step through memory, false to repeat the same memory address
+ */
+void DMAStream::set_memory_increment(bool memory_increment) {
+    uint32_t mask = 0x01u << static_cast<uint8_t>(DMAStreamControlRegister::memory_increment);
+    if ( memory_increment ) {
+        this->stream->CR |= mask;
+    } else {
+        this->stream->CR &= ~mask;
+    }
+}
+
+/**
+ * \brief start a transfer. The stream must be idle, either stopped or finished with its last transfer.
+ *
+ * \param peripheral_address the peripheral data register
+ * \param memory_address the memory to transfer to or from
+ * \param count number of items to transfer
+ */
+void DMAStream::start(volatile void* peripheral_address, const void* memory_address, uint16_t count) {
+    this->clear_all_flags();
+    this->stream->PAR = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(peripheral_address));
+    this->stream->M0AR = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(memory_address));
+    this->stream->NDTR = count;
+    this->stream->CR |= (0x01u << static_cast<uint8_t>(DMAStreamControlRegister::stream_enable));
+}
+
+/**
+ * \brief stop the stream and wait for it to finish any transfer in progress
+ */
+void DMAStream::stop(void) {
+    this->stream->CR &= ~(0x01u << static_cast<uint8_t>(DMAStreamControlRegister::stream_enable));
+    while ( this->is_enabled() ) {
+    }
+}
+
+/**
+ * \brief check if the stream is enabled. The hardware clears this when a non-circular transfer completes.
+ *
+ * \retval true/false
+ */
+bool DMAStream::is_enabled(void) {
+    return static_cast<bool>(this->stream->CR & (0x01u << static_cast<uint8_t>(DMAStreamControlRegister::stream_enable)));
+}
+
+/**
+ * \brief get the number of items left to transfer
+ *
+ * \retval uint16_t item count
+ */
+uint16_t DMAStream::get_remaining_count(void) {
+    return static_cast<uint16_t>(this->stream->NDTR);
+}
+
+/**
+ * \brief read one of the stream's interrupt flags
+ *
+ * \param flag the flag to read
+ * \retval true if set
+ */
+bool DMAStream::get_flag(DMAInterruptFlag flag) {
+    uint8_t bit = stream_flag_offsets[this->stream_number % streams_per_flag_register] + static_cast<uint8_t>(flag);
+    uint32_t status = (this->stream_number < streams_per_flag_register) ? this->dma->LISR : this->dma->HISR;
+    return static_cast<bool>(status & (0x01u << bit));
+}
+
+/**
+ * \brief clear one of the stream's interrupt flags
+ *
+ * \param flag the flag to clear
+ */
+void DMAStream::clear_flag(DMAInterruptFlag flag) {
+    uint8_t bit = stream_flag_offsets[this->stream_number % streams_per_flag_register] + static_cast<uint8_t>(flag);
+    if ( this->stream_number < streams_per_flag_register ) {
+        this->dma->LIFCR = (0x01u << bit);
+    } else {
+        this->dma->HIFCR = (0x01u << bit);
+    }
+}
+
+/**
+ * \brief clear every interrupt flag for the stream
+ */
+void DMAStream::clear_all_flags(void) {
+    uint32_t mask = stream_flag_mask << stream_flag_offsets[this->stream_number % streams_per_flag_register];
+    if ( this->stream_number < streams_per_flag_register ) {
+        this->dma->LIFCR = mask;
+    } else {
+        this->dma->HIFCR = mask;
+    }
+}
+
+};  // namespace HAL
@@ -0,0 +1,140 @@
+/*! \file hal_dma.h
+*
+*  \brief hal_dma module functions and variables declarations.
+*
+*
+*  \author Graham Riches
+*/
+
+#pragma once
+
+/********************************** Includes *******************************************/
+#include "common.h"
+#include "stm32f4xx.h"
+#include <stdint.h>
+
+namespace HAL
+{
+/*********************************** Consts ********************************************/
+
+/************************************ Types ********************************************/
+/**
+ * \brief bit offsets for the DMA stream configuration register
+ */
+enum class DMAStreamControlRegister : unsigned {
+    stream_enable = 0,
+    direct_mode_error_interrupt_enable = 1,
+    transfer_error_interrupt_enable = 2,
+    half_transfer_interrupt_enable = 3,
+    transfer_complete_interrupt_enable = 4,
+    peripheral_flow_control = 5,
+    direction = 6,
+    circular_mode = 8,
+    peripheral_increment = 9,
+    memory_increment = 10,
+    peripheral_size = 11,
+    memory_size = 13,
+    priority_level = 16,
+    channel_select = 25,
+};
+
+/**
+ * \brief stream interrupt flags, as offsets within each stream's group of flags in the status registers
+ */
+enum class DMAInterruptFlag : unsigned {
+    fifo_error = 0,
+    direct_mode_error = 2,
+    transfer_error = 3,
+    half_transfer = 4,
+    transfer_complete = 5,
+};
+
+/**
+ * \brief transfer directions
+ */
+enum class DMADirection : unsigned {
+    peripheral_to_memory = 0b00,
+    memory_to_peripheral = 0b01,
+    memory_to_memory = 0b10,
+};
+
+/**
+ * \brief stream request channels
+ */
+enum class DMAChannel : unsigned {
+    channel_0 = 0,
+    channel_1,
+    channel_2,
+    channel_3,
+    channel_4,
+    channel_5,
+    channel_6,
+    channel_7,
+};
+
+/**
+ * \brief data sizes for the memory and peripheral sides of a transfer
+ */
+enum class DMADataSize : unsigned {
+    byte = 0b00,
+    half_word = 0b01,
+    word = 0b10,
+};
+
+/**
+ * \brief stream priority levels
+ */
+enum class DMAPriority : unsigned {
+    low = 0b00,
+    medium = 0b01,
+    high = 0b10,
+    very_high = 0b11,
+};
+
+/**
+ * \brief one stream of a DMA controller. Streams are owned by a single driver, which configures the stream
+ *        once and then starts a transfer for each block of data.
+ */
+class DMAStream {
+  public:
+    DMAStream(DMA_TypeDef* dma, DMA_Stream_TypeDef* stream, uint8_t stream_number, DMAChannel channel);
+
+    void configure(DMADirection direction, DMADataSize size, bool memory_increment, bool circular, DMAPriority priority);
+    void enable_interrupt(DMAStreamControlRegister interrupt, bool enable);
+    void set_memory_increment(bool memory_increment);
+    void start(volatile void* peripheral_address, const void* memory_address, uint16_t count);
+    void stop(void);
+    bool is_enabled(void);
+    uint16_t get_remaining_count(void);
+    bool get_flag(DMAInterruptFlag flag);
+    void clear_flag(DMAInterruptFlag flag);
+    void clear_all_flags(void);
+
+  private:
+    DMA_TypeDef* dma;
+    DMA_Stream_TypeDef* stream;
+    uint8_t stream_number;
+    DMAChannel channel;
+};
+
+/*********************************** Macros ********************************************/
+
+/******************************* Global Variables **************************************/
+
+/****************************** Functions Prototype ************************************/
+
+/**
+ * \brief check that memory can be reached by the DMA controllers. The core coupled memory is only on the
+ *        core's data bus, so buffers placed there with CCM_RAM, including thread stacks, can't be transferred.
+ *
+ * \param address the buffer
+ * \retval true if the DMA can reach it
+ */
+inline bool is_dma_accessible(const volatile void* address) {
+    constexpr uintptr_t ccm_ram_start = 0x10000000;
+    constexpr uintptr_t ccm_ram_end = 0x10010000;
+    uintptr_t location = reinterpret_cast<uintptr_t>(address);
+    return (location < ccm_ram_start) || (location >= ccm_ram_end);
+}
+
+};  // namespace HAL
@@ -12,6 +12,10 @@
 namespace HAL
 {
 /*********************************** Consts ********************************************/
+constexpr uint32_t flash_unlock_key_1 = 0x45670123;
+constexpr uint32_t flash_unlock_key_2 = 0xCDEF89AB;
+constexpr uint32_t flash_sector_number_offset = 3;
+constexpr uint32_t flash_error_flags = FLASH_SR_PGSERR | FLASH_SR_PGPERR | FLASH_SR_PGAERR | FLASH_SR_WRPERR | FLASH_SR_SOP;
 
 /************************************ Types ********************************************/
 
@@ -28,33 +32,119 @@ Flash flash(FLASH);
 /**
  * \brief configure a register in the flash access control register
  * 
+ * \param reg the register
  * \param value the value of the register
  */
 void Flash::set_access_control_register(FlashAccessControlRegister reg, uint8_t value) {
-    switch ( reg ) {
-        /* handle the single bit registers in one case */
-        case FlashAccessControlRegister::data_cache_enable:
-        case FlashAccessControlRegister::prefetch_enable:
-        case FlashAccessControlRegister::instruction_cache_enable:
-        case FlashAccessControlRegister::data_cache_reset:
-        case FlashAccessControlRegister::instruction_cache_reset:
-            /* clear the register */
-            this->peripheral->ACR &= ~static_cast<uint8_t>(0x01u << static_cast<uint8_t>(reg));
-            /* set it */
-            this->peripheral->ACR |= static_cast<uint8_t>((value & 0x01u) << static_cast<uint8_t>(reg));
-            break;
-
-        /* handle the latency (4-bits) separately */
-        case FlashAccessControlRegister::latency:
-            /* clear the register */
-            this->peripheral->ACR &= ~static_cast<uint8_t>(0x0Fu << static_cast<uint8_t>(reg));
-            /* set it */
-            this->peripheral->ACR |= static_cast<uint8_t>((value & 0x0Fu) << static_cast<uint8_t>(reg));
-            break;
-
-        default:
-            break;
+    this->modify_access_control_register(field(reg, value));
+}
+
+/**
+ * \brief write one or more fields of the access control register with a single read-modify-write
+ * 
+ * \param value the merged field values
+ */
+void Flash::modify_access_control_register(RegisterValue<FlashAccessControlRegister> value) {
+    value.modify(this->peripheral->ACR);
+}
+
+/**
+ * \brief set the number of flash wait states, waiting until the new value has taken effect. Raise it before
+ *        speeding up the AHB clock and lower it after slowing it down.
+ * 
+ * \param wait_states number of wait states
+ */
+void Flash::set_latency(uint8_t wait_states) {
+    this->modify_access_control_register(field(FlashAccessControlRegister::latency, wait_states));
+    while ( this->get_latency() != wait_states ) {
+    }
+}
+
+/**
+ * \brief get the number of flash wait states
+ * 
+ * \retval uint8_t wait states
+ */
+uint8_t Flash::get_latency(void) {
+    return static_cast<uint8_t>(this->peripheral->ACR & FLASH_ACR_LATENCY);
+}
+
+/**
+ * \brief unlock the control register so the flash can be erased and programmed
+ */
+void Flash::unlock(void) {
+    if ( this->peripheral->CR & FLASH_CR_LOCK ) {
+        this->peripheral->KEYR = flash_unlock_key_1;
+        this->peripheral->KEYR = flash_unlock_key_2;
+    }
+}
+
+/**
+ * \brief lock the control register again
+ */
+void Flash::lock(void) {
+    this->peripheral->CR |= FLASH_CR_LOCK;
+}
+
+/**
+ * \brief erase a sector, waiting until it's done. The flash must be unlocked, and the supply must be 2.7V or
+ *        more since the erase uses 32 bit parallelism. Anything fetching from flash stalls until the erase
+ *        finishes, which takes up to a couple of seconds for the 128K sectors.
+ *
+ * \param sector sector number, 0 to 11
+ * \retval true if the sector was erased
+ */
+bool Flash::erase_sector(uint8_t sector) {
+    if ( sector >= flash_sector_count ) {
+        return false;
+    }
+    this->peripheral->SR = flash_error_flags;
+    this->peripheral->CR = FLASH_CR_PSIZE_1 | FLASH_CR_SER | (static_cast<uint32_t>(sector) << flash_sector_number_offset);
+    this->peripheral->CR |= FLASH_CR_STRT;
+    bool erased = this->wait_until_done();
+    this->peripheral->CR &= ~(FLASH_CR_SER | FLASH_CR_SNB);
+    this->reset_data_cache();
+    return erased;
+}
+
+/**
+ * \brief program one word, waiting until it's done. The flash must be unlocked, and bits can only be programmed
+ *        from 1 to 0, so the word must be erased first to write an arbitrary value.
+ *
+ * \param address word aligned flash address
+ * \param value the value
+ * \retval true if the word was programmed
+ */
+bool Flash::program_word(uint32_t address, uint32_t value) {
+    this->peripheral->SR = flash_error_flags;
+    this->peripheral->CR = FLASH_CR_PSIZE_1 | FLASH_CR_PG;
+    *reinterpret_cast<volatile uint32_t*>(address) = value;
+    bool programmed = this->wait_until_done();
+    this->peripheral->CR &= ~FLASH_CR_PG;
+    return programmed && (*reinterpret_cast<volatile uint32_t*>(address) == value);
+}
+
+/**
+ * \brief flush the data cache, which can hold stale copies of flash that has been erased or programmed. The cache
+ *        has to be off while it's reset.
+ */
+void Flash::reset_data_cache(void) {
+    uint32_t enabled = this->peripheral->ACR & FLASH_ACR_DCEN;
+    this->peripheral->ACR &= ~FLASH_ACR_DCEN;
+    this->peripheral->ACR |= FLASH_ACR_DCRST;
+    this->peripheral->ACR &= ~FLASH_ACR_DCRST;
+    this->peripheral->ACR |= enabled;
+}
+
+/**
+ * \brief wait for the current erase or program operation to finish
+ *
+ * \retval true if it finished without an error
+ */
+bool Flash::wait_until_done(void) {
+    while ( this->peripheral->SR & FLASH_SR_BSY ) {
     }
+    return (this->peripheral->SR & flash_error_flags) == 0;
 }
 
 };  // namespace HAL
@@ -10,12 +10,14 @@
 
 /********************************** Includes *******************************************/
 #include "hal_bitwise_operators.h"
+#include "hal_register.h"
 #include "stm32f4xx.h"
 #include <stdint.h>
 
 namespace HAL
 {
 /*********************************** Consts ********************************************/
+constexpr uint8_t flash_sector_count = 12;
 
 /************************************ Types ********************************************/
 
@@ -32,6 +34,13 @@ enum class FlashAccessControlRegister : unsigned {
     data_cache_reset = 12
 };
 
+/**
+ * \brief the wait state latency is the only access control field wider than a bit
+ */
+constexpr uint8_t get_field_width(FlashAccessControlRegister field) {
+    return (field == FlashAccessControlRegister::latency) ? 4 : 1;
+}
+
 /**
  * \brief flash memory peripheral class
  * 
@@ -46,6 +55,18 @@ class Flash {
     }
 
     void set_access_control_register(FlashAccessControlRegister reg, uint8_t value);
+    void modify_access_control_register(RegisterValue<FlashAccessControlRegister> value);
+    void set_latency(uint8_t wait_states);
+    uint8_t get_latency(void);
+
+    void unlock(void);
+    void lock(void);
+    bool erase_sector(uint8_t sector);
+    bool program_word(uint32_t address, uint32_t value);
+    void reset_data_cache(void);
+
+  private:
+    bool wait_until_done(void);
 };
 
 /*********************************** Macros ********************************************/
@@ -9,7 +9,6 @@
 /********************************** Includes *******************************************/
 #include "hal_gpio.h"
 #include "hal_rcc.h"
-#include <map>
 
 namespace HAL
 {
@@ -24,19 +23,61 @@ constexpr uint8_t total_pins = 16;  //!< total pin count per GPIO bank
 #define CLEAR_PULLUP_REGISTER_MASK    0x03  //!< bitmask to clear the pullup/pulldown config register for a pin
 
 /****************************** Local Variables ***********************************/
-static const std::map<GPIO_TypeDef*, AHB1Clocks> gpio_port_map{
-    {GPIOA, AHB1Clocks::gpio_a},
-    {GPIOB, AHB1Clocks::gpio_b},
-    {GPIOC, AHB1Clocks::gpio_c},
-    {GPIOD, AHB1Clocks::gpio_d},
-    {GPIOE, AHB1Clocks::gpio_e},
-    {GPIOF, AHB1Clocks::gpio_f},
-    {GPIOG, AHB1Clocks::gpio_g},
-    {GPIOH, AHB1Clocks::gpio_h},
-    {GPIOI, AHB1Clocks::gpio_i},
-};
+
+/****************************** Local Function Definitions ***********************************/
+/**
+ * \brief get the ahb1 clock that gates a GPIO bank. The banks are laid out 0x400 apart starting
+ *        at GPIOA, in the same order as their clock enable bits, so no lookup table is needed.
+ *        This also keeps the pin constructors safe to run from other translation units during static init.
+ * 
+ * \param bank the GPIO bank
+ * \retval AHB1Clocks the clock enable for the bank
+ */
+static AHB1Clocks get_gpio_clock(GPIO_TypeDef* bank) {
+    uintptr_t offset = reinterpret_cast<uintptr_t>(bank) - GPIOA_BASE;
+    return static_cast<AHB1Clocks>(offset / (GPIOB_BASE - GPIOA_BASE));
+}
 
 /****************************** Functions Definitions ***********************************/
+/**
+ * \brief enable a GPIO bank's clock and configure one or more of its pins
+ *
+ * \param bank the GPIO bank
+ * \param pins mask of the pins to configure
+ * \param mode the pin mode
+ * \param speed pin speed, only applied to outputs and alternate function pins
+ * \param pull_mode pull up/down configuration, only applied to outputs and alternate function pins
+ * \param output_mode output mode type
+ */
+void configure_pins(GPIO_TypeDef* bank, uint16_t pins, PinMode mode, Speed speed, PullMode pull_mode, OutputMode output_mode) {
+    /* enable the peripheral clock. Note: this must be done before writing to the registers */
+    reset_control_clock.set_ahb_clock(get_gpio_clock(bank), true);
+
+    for ( uint8_t i = 0; i < total_pins; i++ ) {
+        if ( !static_cast<bool>(pins & (0x01 << i)) ) {
+            continue;
+        }
+
+        /* set the pin mode */
+        bank->MODER &= ~(CLEAR_MODE_REGISTER_MASK << (2 * i));
+        bank->MODER |= (static_cast<uint32_t>(mode) << (2 * i));
+
+        /* set the pin port type (push_pull/open_drain) */
+        bank->OTYPER &= ~(CLEAR_PORT_TYPE_REGISTER_MASK << i);
+        bank->OTYPER |= (static_cast<uint32_t>(output_mode) << i);
+
+        /* set the speed and push pull config only for outputs and alternate function pins */
+        if ( (mode == PinMode::output) || (mode == PinMode::alternate) ) {
+            /* set the pin speed */
+            bank->OSPEEDR &= ~(CLEAR_SPEED_REGISTER_MASK << (2 * i));
+            bank->OSPEEDR |= (static_cast<uint32_t>(speed) << (2 * i));
+
+            /* set the pin push_pull configuration */
+            bank->PUPDR &= ~(CLEAR_PULLUP_REGISTER_MASK << (2 * i));
+            bank->PUPDR |= (static_cast<uint32_t>(pull_mode) << (2 * i));
+        }
+    }
+}
 
 /**
  * \brief Construct a new Pin:: Pin object
@@ -56,35 +97,7 @@ PinBase::PinBase(GPIO_TypeDef* bank, Pins pin, PinMode mode, Speed speed, PullMo
     , pull_mode(pull_mode)
     , output_mode(output_mode) {
 
-    /* enable the peripheral clock. Note: this must be done before writing to the registers */
-    reset_control_clock.set_ahb_clock(gpio_port_map.at(bank), true);
-
-    /* find the appropriate bits and set them */
-    for ( uint8_t i = 0; i < total_pins; i++ ) {
-        uint32_t test_pin = 0x01 << i;
-
-        if ( static_cast<bool>(test_pin & static_cast<uint32_t>(this->pin)) ) {
-            /* set the pin mode */
-            this->bank->MODER &= ~(CLEAR_MODE_REGISTER_MASK << (2 * i));
-            this->bank->MODER |= (static_cast<uint32_t>(this->mode) << (2 * i));
-
-            /* set the pin port type (push_pull/open_drain) */
-            this->bank->OTYPER &= ~(CLEAR_PORT_TYPE_REGISTER_MASK << i);
-            this->bank->OTYPER |= (static_cast<uint32_t>(this->output_mode) << i);
-
-            /* set the speed and push pull config only for outputs and alternate function pins */
-            if ( (this->mode == PinMode::output) || (this->mode == PinMode::alternate) ) {
-                /* set the pin speed */
-                this->bank->OSPEEDR &= ~(CLEAR_SPEED_REGISTER_MASK << (2 * i));
-                this->bank->OSPEEDR |= (static_cast<uint32_t>(this->speed) << (2 * i));
-
-                /* set the pin push_pull configuration */
-                this->bank->PUPDR &= ~(CLEAR_PULLUP_REGISTER_MASK << (2 * i));
-                this->bank->PUPDR |= (static_cast<uint32_t>(this->pull_mode) << (2 * i));
-            }
-            break;
-        }
-    }
+    configure_pins(bank, static_cast<uint16_t>(pin), mode, speed, pull_mode, output_mode);
 }
 
 /**
@@ -101,27 +114,12 @@ OutputPin::OutputPin(GPIO_TypeDef* bank, Pins pin, PinMode mode, Speed speed, Pu
     : PinBase(bank, pin, mode, speed, pull_mode, output_mode) { }
 
 /**
- * \brief set an output pins state
- * 
- * \param high true to set the pin high
- */
-void OutputPin::set(bool high) {
-    uint16_t pin_mask = static_cast<uint16_t>(this->pin);
-
-    if ( high ) {
-        this->bank->BSRRL |= pin_mask;
-    } else {
-        this->bank->BSRRH |= pin_mask;
-    }
-}
-
-/**
- * \brief toggle an output pin
+ * \brief toggle an output pin through the bit set/reset register, so other pins on the bank are never rewritten
  * 
  */
 void OutputPin::toggle(void) {
-    uint16_t pin_mask = static_cast<uint16_t>(this->pin);
-    this->bank->ODR ^= pin_mask;
+    uint32_t pin_mask = static_cast<uint32_t>(this->pin);
+    get_bit_set_reset_register(this->bank) = (this->bank->ODR & pin_mask) ? (pin_mask << 16) : pin_mask;
 }
 
 /**
@@ -93,6 +93,30 @@ enum class Pins : unsigned {
     all = 0xFFFF
 };
 
+/****************************** Function Declarations ************************************/
+/**
+ * \brief enable a GPIO bank's clock and configure one or more of its pins
+ *
+ * \param bank the GPIO bank
+ * \param pins mask of the pins to configure
+ * \param mode the pin mode
+ * \param speed pin speed, only applied to outputs and alternate function pins
+ * \param pull_mode pull up/down configuration, only applied to outputs and alternate function pins
+ * \param output_mode output mode type
+ */
+void configure_pins(GPIO_TypeDef* bank, uint16_t pins, PinMode mode, Speed speed, PullMode pull_mode, OutputMode output_mode);
+
+/**
+ * \brief get the 32-bit bit set/reset register of a GPIO bank. The low half sets pins and the high half resets
+ *        them, so a single store changes any number of pins without a read-modify-write.
+ *
+ * \param bank the GPIO bank
+ * \retval volatile uint32_t& the register
+ */
+inline volatile uint32_t& get_bit_set_reset_register(GPIO_TypeDef* bank) {
+    return *reinterpret_cast<volatile uint32_t*>(&bank->BSRRL);
+}
+
 /**
  * \brief base GPIO pin class
  */
@@ -116,10 +140,138 @@ class OutputPin : protected PinBase {
     OutputPin(){};
     OutputPin(GPIO_TypeDef* bank, Pins pin, PinMode mode, Speed speed, PullMode pull_mode, OutputMode output_mode);
 
-    void set(bool high);
+    /**
+     * \brief set an output pin's state with a single store to the bit set/reset register
+     *
+     * \param high true to set the pin high
+     */
+    void set(bool high) {
+        uint32_t pin_mask = static_cast<uint32_t>(this->pin);
+        get_bit_set_reset_register(this->bank) = high ? pin_mask : (pin_mask << 16);
+    }
+
     void toggle(void);
 };
 
+/**
+ * \brief a GPIO output pin fixed at compile time. There is no object to store or pass around, and writes are a
+ *        single store to the bit set/reset register, so they are atomic against interrupts that change other
+ *        pins on the same bank. Toggling reads the output register first, so it is not atomic against another
+ *        writer of the same pin.
+ *
+ * \tparam Bank base address of the GPIO bank, eg. GPIOD_BASE
+ * \tparam Number pin number, 0 to 15
+ */
+template <uint32_t Bank, uint8_t Number>
+class Pin {
+    static_assert(Number < 16, "GPIO pins are numbered 0 to 15");
+
+  public:
+    static constexpr uint16_t mask = static_cast<uint16_t>(0x01u << Number);
+
+    /**
+     * \brief configure the pin. This is a read-modify-write of the configuration registers, so do it at startup.
+     */
+    static void configure(PinMode mode, Speed speed, PullMode pull_mode, OutputMode output_mode) {
+        configure_pins(get_bank(), mask, mode, speed, pull_mode, output_mode);
+    }
+
+    /**
+     * \brief drive the pin
+     *
+     * \param high true to set the pin high
+     */
+    static void set(bool high) {
+        get_bit_set_reset_register(get_bank()) = high ? mask : (static_cast<uint32_t>(mask) << 16);
+    }
+
+    /**
+     * \brief invert the pin's output
+     */
+    static void toggle(void) {
+        get_bit_set_reset_register(get_bank()) = (get_bank()->ODR & mask) ? (static_cast<uint32_t>(mask) << 16) : mask;
+    }
+
+    /**
+     * \brief read the pin's input level
+     *
+     * \retval true if high
+     */
+    static bool read(void) {
+        return static_cast<bool>(get_bank()->IDR & mask);
+    }
+
+  private:
+    static GPIO_TypeDef* get_bank(void) {
+        return reinterpret_cast<GPIO_TypeDef*>(Bank);
+    }
+};
+
+/**
+ * \brief several output pins on one GPIO bank, fixed at compile time and written together with a single store to
+ *        the bit set/reset register, so the pins always change at the same instant
+ *
+ * \tparam Bank base address of the GPIO bank, eg. GPIOD_BASE
+ * \tparam Numbers pin numbers, 0 to 15. Bit k of a value written to the group drives the k-th pin listed.
+ */
+template <uint32_t Bank, uint8_t... Numbers>
+class PinGroup {
+    static_assert(sizeof...(Numbers) > 0, "a pin group needs at least one pin");
+    static_assert(((Numbers < 16) && ...), "GPIO pins are numbered 0 to 15");
+
+  public:
+    static constexpr uint16_t mask = static_cast<uint16_t>(((0x01u << Numbers) | ...));
+
+    /**
+     * \brief configure every pin in the group, see Pin::configure
+     */
+    static void configure(PinMode mode, Speed speed, PullMode pull_mode, OutputMode output_mode) {
+        configure_pins(get_bank(), mask, mode, speed, pull_mode, output_mode);
+    }
+
+    /**
+     * \brief drive every pin in the group
+     *
+     * \param values bit k is the level for the k-th pin listed
+     */
+    static void write(uint32_t values) {
+        uint32_t high = spread(values);
+        get_bit_set_reset_register(get_bank()) = high | ((mask & ~high) << 16);
+    }
+
+    /**
+     * \brief drive every pin in the group to the same level
+     *
+     * \param high true to set the pins high
+     */
+    static void set(bool high) {
+        get_bit_set_reset_register(get_bank()) = high ? mask : (static_cast<uint32_t>(mask) << 16);
+    }
+
+    /**
+     * \brief invert every pin in the group
+     */
+    static void toggle(void) {
+        uint32_t high = get_bank()->ODR & mask;
+        get_bit_set_reset_register(get_bank()) = (mask & ~high) | (high << 16);
+    }
+
+  private:
+    static GPIO_TypeDef* get_bank(void) {
+        return reinterpret_cast<GPIO_TypeDef*>(Bank);
+    }
+
+    /**
+     * \brief move bit k of a group value to the k-th pin's position in the bank
+     */
+    static constexpr uint32_t spread(uint32_t values) {
+        uint32_t result = 0;
+        uint8_t index = 0;
+        ((result |= ((values >> index++) & 0x01u) << Numbers), ...);
+        return result;
+    }
+};
+
 /**
  * \brief class type for an alternate mode pin
  */
@@ -134,6 +286,4 @@ class AlternateModePin : protected PinBase {
 
 /*********************************** Macros ********************************************/
 
-/****************************** Function Declarations ************************************/
-
 };  // namespace HAL
@@ -0,0 +1,260 @@
+/*! \file hal_i2c.cpp
+*
+*  \brief HAL++ implementation of a polling I2C master.
+*
+*
+*  \author Graham Riches
+*/
+
+/********************************** Includes *******************************************/
+#include "hal_i2c.h"
+#include <cassert>
+
+
+namespace HAL
+{
+
+/*********************************** Consts ********************************************/
+constexpr uint32_t flag_timeout_polls = 100000;  //!< polls of a status flag before giving up, a few ms at full speed
+constexpr uint32_t hertz_per_megahertz = 1000000;
+constexpr uint32_t standard_mode_rise_time_ns = 1000;
+constexpr uint32_t fast_mode_rise_time_ns = 300;
+constexpr uint32_t nanoseconds_per_megahertz = 1000;
+constexpr uint16_t fast_mode_select = I2C_CCR_FS;
+constexpr uint16_t min_standard_clock_control = 4;
+constexpr uint16_t min_fast_clock_control = 1;
+constexpr uint8_t read_bit = 0x01;  //!< set in the address byte to read from the device
+
+/****************************** Function Definitions ***********************************/
+/**
+ * \brief Construct a new I2CPolling object
+ *
+ * \param i2c the I2C peripheral
+ * \param bus_clock the APB bus the peripheral is clocked from
+ * \note the peripheral's clock enable is requested separately, as with every other driver
+ */
+I2CPolling::I2CPolling(I2C_TypeDef* i2c, Clocks bus_clock)
+    : i2c(i2c)
+    , bus_clock(bus_clock)
+    , speed(I2CSpeed::standard)
+    , configured_bus_speed(0) {
+    assert((i2c == I2C1) || (i2c == I2C2) || (i2c == I2C3));
+}
+
+/**
+ * \brief reset the peripheral and enable it as a master at a bus speed
+ *
+ * \param speed the bus speed
+ */
+void I2CPolling::initialize(I2CSpeed speed) {
+    /* a software reset clears a bus left busy by a transfer cut off part way */
+    this->set_control_register(I2CControlRegister1::software_reset, true);
+    this->set_control_register(I2CControlRegister1::software_reset, false);
+    this->set_speed(speed);
+    this->set_control_register(I2CControlRegister1::peripheral_enable, true);
+}
+
+/**
+ * \brief work the clock control and rise time registers out from the current bus clock. Fast mode uses the 2:1
+ *        duty cycle. The peripheral is disabled while the timing changes.
+ *
+ * \param speed the bus speed
+ */
+void I2CPolling::set_speed(I2CSpeed speed) {
+    uint32_t bus_speed = reset_control_clock.get_clock_speed(this->bus_clock);
+    uint32_t bus_megahertz = bus_speed / hertz_per_megahertz;
+    assert((bus_megahertz >= 2) && (bus_megahertz <= 50));
+    this->speed = speed;
+    this->configured_bus_speed = bus_speed;
+
+    bool enabled = (this->i2c->CR1 & I2C_CR1_PE) != 0;
+    this->set_control_register(I2CControlRegister1::peripheral_enable, false);
+    this->i2c->CR2 = static_cast<uint16_t>((this->i2c->CR2 & ~I2C_CR2_FREQ) | bus_megahertz);
+
+    uint32_t frequency = static_cast<uint32_t>(speed);
+    if ( speed == I2CSpeed::fast ) {
+        uint32_t clock_control = bus_speed / (frequency * 3);
+        clock_control = (clock_control < min_fast_clock_control) ? min_fast_clock_control : clock_control;
+        this->i2c->CCR = static_cast<uint16_t>(fast_mode_select | clock_control);
+        this->i2c->TRISE = static_cast<uint16_t>(((bus_megahertz * fast_mode_rise_time_ns) / nanoseconds_per_megahertz) + 1);
+    } else {
+        uint32_t clock_control = bus_speed / (frequency * 2);
+        clock_control = (clock_control < min_standard_clock_control) ? min_standard_clock_control : clock_control;
+        this->i2c->CCR = static_cast<uint16_t>(clock_control);
+        this->i2c->TRISE = static_cast<uint16_t>(((bus_megahertz * standard_mode_rise_time_ns) / nanoseconds_per_megahertz) + 1);
+    }
+
+    this->set_control_register(I2CControlRegister1::peripheral_enable, enabled);
+}
+
+/**
+ * \brief write a block of bytes to a device
+ *
+ * \param address the device's 8-bit write address
+ * \param data the bytes to write
+ * \param size number of bytes
+ * \retval true if the device acknowledged every byte
+ */
+bool I2CPolling::write(uint8_t address, const uint8_t* data, uint16_t size) {
+    bool success = this->start(address) && this->send(data, size);
+    this->stop();
+    return success;
+}
+
+/**
+ * \brief write some bytes to a device, usually a register address, then read back from it after a repeated start
+ *
+ * \param address the device's 8-bit write address
+ * \param tx_data the bytes to write
+ * \param tx_size number of bytes to write
+ * \param rx_data where to store the bytes read
+ * \param rx_size number of bytes to read
+ * \retval true if the device acknowledged the write and the read completed
+ */
+bool I2CPolling::write_read(uint8_t address, const uint8_t* tx_data, uint16_t tx_size, uint8_t* rx_data, uint16_t rx_size) {
+    assert(rx_size > 0);
+    if ( !this->start(address) || !this->send(tx_data, tx_size) || !this->start(address | read_bit) ) {
+        this->stop();
+        return false;
+    }
+
+    /* the receive sends the stop itself, as it has to go out with the last byte */
+    return this->receive(rx_data, rx_size);
+}
+
+/**
+ * \brief send a start or repeated start and the address byte. Reading the status registers clears the address
+ *        flag, which for a single byte read is left until the acknowledge is off so the byte is not acknowledged.
+ *
+ * \param address the 8-bit address, with the read bit set to read
+ * \retval true if the device acknowledged its address
+ */
+bool I2CPolling::start(uint8_t address) {
+    bool read = (address & read_bit) != 0;
+    if ( !read ) {
+        uint32_t polls = flag_timeout_polls;
+        while ( (this->i2c->SR2 & (0x01u << static_cast<uint8_t>(I2CStatusRegister2::busy))) != 0 ) {
+            if ( --polls == 0 ) {
+                return false;
+            }
+        }
+
+        /* the bus is idle, so this is the one safe point to catch up with a clock change */
+        if ( reset_control_clock.get_clock_speed(this->bus_clock) != this->configured_bus_speed ) {
+            this->set_speed(this->speed);
+        }
+    }
+
+    this->set_control_register(I2CControlRegister1::acknowledge_enable, true);
+    this->set_control_register(I2CControlRegister1::start, true);
+    if ( !this->wait_for_flag(I2CStatusRegister1::start_sent) ) {
+        return false;
+    }
+
+    this->i2c->DR = address;
+    if ( !this->wait_for_flag(I2CStatusRegister1::address_sent) ) {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * \brief clear the address flag and send bytes, waiting for the last to finish
+ *
+ * \param data the bytes
+ * \param size number of bytes
+ * \retval true if every byte was acknowledged
+ */
+bool I2CPolling::send(const uint8_t* data, uint16_t size) {
+    static_cast<void>(this->i2c->SR1);
+    static_cast<void>(this->i2c->SR2);
+    for ( uint16_t index = 0; index < size; index++ ) {
+        if ( !this->wait_for_flag(I2CStatusRegister1::transmit_data_empty) ) {
+            return false;
+        }
+        this->i2c->DR = data[index];
+    }
+    return this->wait_for_flag(I2CStatusRegister1::byte_transfer_finished);
+}
+
+/**
+ * \brief clear the address flag and read bytes, not acknowledging the last and sending the stop with it
+ *
+ * \param data where to store the bytes
+ * \param size number of bytes
+ * \retval true if every byte arrived
+ */
+bool I2CPolling::receive(uint8_t* data, uint16_t size) {
+    if ( size == 1 ) {
+        this->set_control_register(I2CControlRegister1::acknowledge_enable, false);
+    }
+    static_cast<void>(this->i2c->SR1);
+    static_cast<void>(this->i2c->SR2);
+
+    for ( uint16_t index = 0; index < size; index++ ) {
+        /* the acknowledge and stop apply to the byte being received, so they are set up before waiting for the last */
+        if ( index == size - 1 ) {
+            this->set_control_register(I2CControlRegister1::acknowledge_enable, false);
+            this->set_control_register(I2CControlRegister1::stop, true);
+        }
+        if ( !this->wait_for_flag(I2CStatusRegister1::receive_data_not_empty) ) {
+            this->stop();
+            return false;
+        }
+        data[index] = static_cast<uint8_t>(this->i2c->DR);
+    }
+    return true;
+}
+
+/**
+ * \brief send a stop and release the bus
+ */
+void I2CPolling::stop(void) {
+    this->set_control_register(I2CControlRegister1::stop, true);
+}
+
+/**
+ * \brief poll for a status flag, giving up on a timeout or a NACK
+ *
+ * \param flag the flag
+ * \retval true if the flag was set, false on a timeout or acknowledge failure
+ */
+bool I2CPolling::wait_for_flag(I2CStatusRegister1 flag) {
+    for ( uint32_t polls = 0; polls < flag_timeout_polls; polls++ ) {
+        if ( this->get_flag(flag) ) {
+            return true;
+        }
+        if ( this->get_flag(I2CStatusRegister1::acknowledge_failure) ) {
+            this->i2c->SR1 = static_cast<uint16_t>(~(0x01u << static_cast<uint8_t>(I2CStatusRegister1::acknowledge_failure)));
+            return false;
+        }
+    }
+    return false;
+}
+
+/**
+ * \brief read a status register 1 flag
+ *
+ * \param flag the flag
+ * \retval true if set
+ */
+bool I2CPolling::get_flag(I2CStatusRegister1 flag) {
+    return (this->i2c->SR1 & (0x01u << static_cast<uint8_t>(flag))) != 0;
+}
+
+/**
+ * \brief set or clear a bit in control register 1
+ *
+ * \param bit the bit
+ * \param set true to set it
+ */
+void I2CPolling::set_control_register(I2CControlRegister1 bit, bool set) {
+    uint16_t mask = static_cast<uint16_t>(0x01u << static_cast<uint8_t>(bit));
+    if ( set ) {
+        this->i2c->CR1 |= mask;
+    } else {
+        this->i2c->CR1 &= static_cast<uint16_t>(~mask);
+    }
+}
+
+};  // namespace HAL
@@ -0,0 +1,99 @@
+/*! \file hal_i2c.h
+*
+*  \brief hal_i2c module functions and variables declarations.
+*
+*
+*  \author Graham Riches
+*/
+
+#pragma once
+
+/********************************** Includes *******************************************/
+#include "common.h"
+#include "hal_rcc.h"
+#include "stm32f4xx.h"
+
+namespace HAL
+{
+/*********************************** Consts ********************************************/
+
+/************************************ Types ********************************************/
+/**
+ * \brief bit offsets for I2C control register 1
+ */
+enum class I2CControlRegister1 : unsigned {
+    peripheral_enable = 0,
+    start = 8,
+    stop = 9,
+    acknowledge_enable = 10,
+    software_reset = 15
+};
+
+/**
+ * \brief bit offsets for I2C status register 1
+ */
+enum class I2CStatusRegister1 : unsigned {
+    start_sent = 0,
+    address_sent = 1,
+    byte_transfer_finished = 2,
+    receive_data_not_empty = 6,
+    transmit_data_empty = 7,
+    bus_error = 8,
+    arbitration_lost = 9,
+    acknowledge_failure = 10
+};
+
+/**
+ * \brief bit offsets for I2C status register 2
+ */
+enum class I2CStatusRegister2 : unsigned {
+    master = 0,
+    busy = 1
+};
+
+/**
+ * \brief bus speeds in Hz
+ */
+enum class I2CSpeed : unsigned {
+    standard = 100000,
+    fast = 400000
+};
+
+/**
+ * \brief blocking I2C master for control buses, such as codec or sensor configuration, where the transfers are
+ *        a few bytes long and happen outside of anything time critical. Every wait on the peripheral gives up
+ *        after a fixed number of polls, so a missing or stuck device fails the transfer rather than hanging.
+ * \note the bus timing is worked out again at the start of any transfer after the APB clock has changed, so
+ *       nothing needs updating from the clock change itself
+ */
+class I2CPolling {
+  public:
+    I2CPolling(I2C_TypeDef* i2c, Clocks bus_clock);
+
+    void initialize(I2CSpeed speed);
+    void set_speed(I2CSpeed speed);
+    bool write(uint8_t address, const uint8_t* data, uint16_t size);
+    bool write_read(uint8_t address, const uint8_t* tx_data, uint16_t tx_size, uint8_t* rx_data, uint16_t rx_size);
+
+  private:
+    bool start(uint8_t address);
+    bool send(const uint8_t* data, uint16_t size);
+    bool receive(uint8_t* data, uint16_t size);
+    void stop(void);
+    bool wait_for_flag(I2CStatusRegister1 flag);
+    bool get_flag(I2CStatusRegister1 flag);
+    void set_control_register(I2CControlRegister1 bit, bool set);
+
+    I2C_TypeDef* i2c;
+    Clocks bus_clock;
+    I2CSpeed speed;
+    uint32_t configured_bus_speed;  //!< APB clock the timing was last worked out for
+};
+
+/*********************************** Macros ********************************************/
+
+/******************************* Global Variables **************************************/
+
+/****************************** Functions Prototype ************************************/
+
+};  // namespace HAL
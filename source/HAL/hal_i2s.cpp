@@ -0,0 +1,164 @@
+/*! \file hal_i2s.cpp
+*
+*  \brief HAL++ implementation of the I2S transmitter.
+*
+*
+*  \author Graham Riches
+*/
+
+/********************************** Includes *******************************************/
+#include "hal_i2s.h"
+#include <cassert>
+
+
+namespace HAL
+{
+
+/*********************************** Consts ********************************************/
+constexpr uint32_t master_clock_ratio = 256;    //!< MCLK is always 256 times the sample rate
+constexpr uint32_t bit_clock_ratio = 32;        //!< two 16-bit channels per frame
+constexpr uint32_t min_linear_prescaler = 2;
+constexpr uint32_t max_linear_prescaler = 0xFF;
+constexpr uint32_t master_transmit_mode = 0b10;
+constexpr uint32_t data_length_16_bit = 0b00;
+
+/****************************** Function Definitions ***********************************/
+/**
+ * \brief Construct a new I2STransmitter object
+ *
+ * \param spi SPI2 or SPI3, the SPI peripherals with an I2S mode
+ * \param tx_stream the DMA stream wired to the peripheral's transmit request
+ * \note the peripheral and DMA clock enables are requested separately, as with every other driver
+ */
+I2STransmitter::I2STransmitter(SPI_TypeDef* spi, DMAStream tx_stream)
+    : spi(spi)
+    , tx_stream(tx_stream)
+    , sample_rate(0)
+    , callback(nullptr)
+    , context(nullptr) {
+    assert((spi == SPI2) || (spi == SPI3));
+}
+
+/**
+ * \brief set up the peripheral as a 16-bit master transmitter and work the prescalers out from the I2S clock.
+ *        The peripheral is left disabled until start.
+ *
+ * \param standard the audio interface standard
+ * \param sample_rate frames per second
+ * \param master_clock_output true to drive MCLK at 256 times the sample rate, which most codecs need
+ * \retval true if the I2S clock can be divided down to within one step of the sample rate
+ */
+bool I2STransmitter::configure(I2SStandard standard, uint32_t sample_rate, bool master_clock_output) {
+    assert(sample_rate > 0);
+    this->stop();
+
+    /* the prescaler divides by (2 * I2SDIV) + ODD, rounded to the nearest divider */
+    uint32_t i2s_clock = reset_control_clock.get_i2s_clock_speed();
+    uint32_t frame_ratio = master_clock_output ? master_clock_ratio : bit_clock_ratio;
+    uint32_t divider = ((i2s_clock / frame_ratio) + (sample_rate / 2)) / sample_rate;
+    uint32_t linear_prescaler = divider / 2;
+    if ( (linear_prescaler < min_linear_prescaler) || (linear_prescaler > max_linear_prescaler) ) {
+        return false;
+    }
+
+    auto prescaler = field(I2SPrescalerRegister::linear_prescaler, linear_prescaler) | field(I2SPrescalerRegister::odd_factor, divider & 0x01)
+                     | field(I2SPrescalerRegister::master_clock_output_enable, master_clock_output ? 0x01 : 0x00);
+    prescaler.modify(this->spi->I2SPR);
+    this->spi->I2SCFGR = 0;
+    this->modify_configuration_register(field(I2SConfigurationRegister::i2s_mode, 0x01)
+                                        | field(I2SConfigurationRegister::configuration_mode, master_transmit_mode)
+                                        | field(I2SConfigurationRegister::standard, static_cast<uint32_t>(standard))
+                                        | field(I2SConfigurationRegister::data_length, data_length_16_bit)
+                                        | field(I2SConfigurationRegister::channel_length, 0x00));
+    this->sample_rate = i2s_clock / (frame_ratio * divider);
+    return true;
+}
+
+/**
+ * \brief start playing a buffer in a loop. The callback is called for each half as the stream finishes with it.
+ *
+ * \param buffer the interleaved samples, which must stay valid until stop
+ * \param sample_count number of 16-bit samples in the whole buffer, an even number of stereo frames
+ * \param priority stream priority, which should be high as the peripheral has no FIFO to cover a late transfer
+ * \retval true if started, false if the buffer is somewhere the DMA can't reach
+ */
+bool I2STransmitter::start(const int16_t* buffer, uint16_t sample_count, DMAPriority priority) {
+    assert((sample_count % 4) == 0);
+    if ( !is_dma_accessible(buffer) ) {
+        return false;
+    }
+
+    this->tx_stream.configure(DMADirection::memory_to_peripheral, DMADataSize::half_word, true, true, priority);
+    this->tx_stream.enable_interrupt(DMAStreamControlRegister::half_transfer_interrupt_enable, true);
+    this->tx_stream.enable_interrupt(DMAStreamControlRegister::transfer_complete_interrupt_enable, true);
+    this->tx_stream.start(&this->spi->DR, buffer, sample_count);
+    this->spi->CR2 |= SPI_CR2_TXDMAEN;
+    this->modify_configuration_register(field(I2SConfigurationRegister::i2s_enable, 0x01));
+    return true;
+}
+
+/**
+ * \brief stop the stream and disable the peripheral. The last frame may be cut short.
+ */
+void I2STransmitter::stop(void) {
+    this->modify_configuration_register(field(I2SConfigurationRegister::i2s_enable, 0x00));
+    this->spi->CR2 &= static_cast<uint16_t>(~SPI_CR2_TXDMAEN);
+    this->tx_stream.stop();
+}
+
+/**
+ * \brief register the function called from the stream interrupt as each half of the buffer is finished with
+ *
+ * \param callback the callback, or nullptr for none
+ * \param context passed through to the callback
+ */
+void I2STransmitter::set_callback(I2SCallback callback, void* context) {
+    this->callback = callback;
+    this->context = context;
+}
+
+/**
+ * \brief get the sample rate the prescalers divide down to
+ *
+ * \retval uint32_t frames per second, 0 before configure
+ */
+uint32_t I2STransmitter::get_sample_rate(void) const {
+    return this->sample_rate;
+}
+
+/**
+ * \brief stream interrupt handler. If the handler is late enough that both flags are set, the first half is
+ *        reported before the second, which is the order they were played in.
+ *
+ * \param type the interrupt type, only stream_irq_type is used
+ */
+void I2STransmitter::irq_handler(uint8_t type) {
+    PARAMETER_NOT_USED(type);
+    if ( this->tx_stream.get_flag(DMAInterruptFlag::half_transfer) ) {
+        this->tx_stream.clear_flag(DMAInterruptFlag::half_transfer);
+        if ( this->callback != nullptr ) {
+            this->callback(this->context, 0);
+        }
+    }
+
+    if ( this->tx_stream.get_flag(DMAInterruptFlag::transfer_complete) ) {
+        this->tx_stream.clear_flag(DMAInterruptFlag::transfer_complete);
+        if ( this->callback != nullptr ) {
+            this->callback(this->context, 1);
+        }
+    }
+
+    /* the stream carries on after a FIFO error, which only means a sample was repeated */
+    this->tx_stream.clear_flag(DMAInterruptFlag::fifo_error);
+}
+
+/**
+ * \brief update fields in the I2S configuration register
+ *
+ * \param value the fields to write
+ */
+void I2STransmitter::modify_configuration_register(RegisterValue<I2SConfigurationRegister> value) {
+    value.modify(this->spi->I2SCFGR);
+}
+
+};  // namespace HAL
@@ -0,0 +1,118 @@
+/*! \file hal_i2s.h
+*
+*  \brief hal_i2s module functions and variables declarations.
+*
+*
+*  \author Graham Riches
+*/
+
+#pragma once
+
+/********************************** Includes *******************************************/
+#include "common.h"
+#include "hal_dma.h"
+#include "hal_interrupt.h"
+#include "hal_rcc.h"
+#include "hal_register.h"
+#include "stm32f4xx.h"
+
+namespace HAL
+{
+/*********************************** Consts ********************************************/
+
+/************************************ Types ********************************************/
+/**
+ * \brief bit offsets for the I2S configuration register
+ */
+enum class I2SConfigurationRegister : unsigned {
+    channel_length = 0,
+    data_length = 1,
+    clock_polarity = 3,
+    standard = 4,
+    pcm_frame_sync = 7,
+    configuration_mode = 8,
+    i2s_enable = 10,
+    i2s_mode = 11
+};
+
+/**
+ * \brief the data length, standard and configuration mode are the I2S configuration register's two bit fields
+ */
+constexpr uint8_t get_field_width(I2SConfigurationRegister field) {
+    return ((field == I2SConfigurationRegister::data_length) || (field == I2SConfigurationRegister::standard)
+            || (field == I2SConfigurationRegister::configuration_mode))
+               ? 2
+               : 1;
+}
+
+/**
+ * \brief bit offsets for the I2S prescaler register
+ */
+enum class I2SPrescalerRegister : unsigned {
+    linear_prescaler = 0,
+    odd_factor = 8,
+    master_clock_output_enable = 9
+};
+
+/**
+ * \brief the linear prescaler is the only I2S prescaler register field wider than a bit
+ */
+constexpr uint8_t get_field_width(I2SPrescalerRegister field) {
+    return (field == I2SPrescalerRegister::linear_prescaler) ? 8 : 1;
+}
+
+/**
+ * \brief audio interface standards
+ */
+enum class I2SStandard : unsigned {
+    philips = 0b00,
+    msb_justified = 0b01,
+    lsb_justified = 0b10,
+    pcm = 0b11
+};
+
+/**
+ * \brief callback from the DMA interrupt each time the stream finishes reading one half of the buffer
+ *
+ * \param context the context registered with the callback
+ * \param half the half of the buffer that has just been played and can be refilled, 0 or 1
+ */
+using I2SCallback = void (*)(void* context, uint8_t half);
+
+/**
+ * \brief I2S master transmitter streaming 16-bit stereo samples from a circular DMA buffer. The stream plays the
+ *        buffer over and over, interrupting once it is halfway through and again at the end, so one half is
+ *        refilled while the other plays. Samples are interleaved left then right.
+ * \note the I2S kernel clock comes from the I2S PLL, which has to be running at a rate that divides down to the
+ *       sample rate before calling configure
+ */
+class I2STransmitter : public InterruptPeripheral {
+  public:
+    static constexpr uint8_t stream_irq_type = 0;  //!< irq type to register the stream interrupt with
+
+    I2STransmitter(SPI_TypeDef* spi, DMAStream tx_stream);
+
+    bool configure(I2SStandard standard, uint32_t sample_rate, bool master_clock_output);
+    bool start(const int16_t* buffer, uint16_t sample_count, DMAPriority priority);
+    void stop(void);
+    void set_callback(I2SCallback callback, void* context);
+    uint32_t get_sample_rate(void) const;
+    RAM_FUNCTION void irq_handler(uint8_t type) override;
+
+  private:
+    void modify_configuration_register(RegisterValue<I2SConfigurationRegister> value);
+
+    SPI_TypeDef* spi;
+    DMAStream tx_stream;
+    uint32_t sample_rate;  //!< actual rate the prescalers divide down to, which can be a little off the one asked for
+    I2SCallback callback;
+    void* context;
+};
+
+/*********************************** Macros ********************************************/
+
+/******************************* Global Variables **************************************/
+
+/****************************** Functions Prototype ************************************/
+
+};  // namespace HAL
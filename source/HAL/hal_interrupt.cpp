@@ -10,9 +10,58 @@
 #include "hal_interrupt.h"
 #include "stm32f4xx.h"
 
+#ifdef HAL_RAM_VECTOR_TABLE
+extern "C" const HAL::InterruptVector g_pfnVectors[];  //!< the flash vector table from the startup file
+#endif
+
 namespace HAL
 {
+/*********************************** Consts ********************************************/
+#ifdef HAL_RAM_VECTOR_TABLE
+/**
+ * \brief VTOR needs the table aligned to its size rounded up to a power of two, and to at least 128 bytes
+ */
+static constexpr size_t get_vector_table_alignment(void) {
+    size_t alignment = 128;
+    while ( alignment < (vector_table_size * sizeof(InterruptVector)) ) {
+        alignment <<= 1;
+    }
+    return alignment;
+}
+constexpr size_t vector_table_alignment = get_vector_table_alignment();
+#endif
+
 /******************************* Global Variables **************************************/
-InterruptManager interrupt_manager;
+CCM_RAM InterruptManager interrupt_manager;
+
+/******************************** Local Variables **************************************/
+#ifdef HAL_RAM_VECTOR_TABLE
+alignas(vector_table_alignment) static volatile InterruptVector ram_vector_table[vector_table_size];
+
+/****************************** Function Definitions ***********************************/
+/**
+ * \brief copy the vector table into SRAM and point the core at it. Every interrupt keeps its startup file
+ *        handler until a direct callback replaces it.
+ */
+void InterruptManager::relocate_vector_table(void) {
+    for ( size_t vector = 0; vector < vector_table_size; vector++ ) {
+        ram_vector_table[vector] = g_pfnVectors[vector];
+    }
+    SCB->VTOR = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(ram_vector_table));
+    __DSB();
+    __ISB();
+}
+
+/**
+ * \brief replace the handler for an interrupt. The interrupt should be disabled or not yet enabled.
+ *
+ * \param interrupt the interrupt
+ * \param vector the new handler
+ */
+void InterruptManager::set_vector(InterruptName interrupt, InterruptVector vector) {
+    ram_vector_table[static_cast<uint8_t>(interrupt)] = vector;
+    __DSB();
+}
+#endif
 
 }
\ No newline at end of file
@@ -5,6 +5,8 @@
 *           in a interrupts vector stored in SRAM. Each low-level interrupt function is
 *           manually defined, which maintains the ability of the NVIC to handle priority
 *           but each function just calls a registered ISR out of the same array.
+*           With HAL_RAM_VECTOR_TABLE the vector table itself is copied to SRAM, and
+*           direct callbacks are written into it so the hardware vectors straight to them.
 *
 *
 *  \author Graham Riches
@@ -15,6 +17,30 @@
 /********************************** Includes *******************************************/
 #include "common.h"
 #include "stm32f4xx.h"
+#include <stddef.h>
+#include <type_traits>
+
+#ifdef OS_IRQ_PROFILING
+namespace os
+{
+extern "C" {
+/* profiling hooks from the os, declared here so the HAL does not depend on the os headers */
+uint32_t os_irq_profile_enter(void);
+void os_irq_profile_exit(uint32_t entry_cycles);
+}
+};  // namespace os
+#endif
+
+#ifdef OS_TRACE
+namespace os
+{
+extern "C" {
+/* trace hooks from the os, declared here so the HAL does not depend on the os headers */
+void os_trace_isr_enter(void);
+void os_trace_isr_exit(void);
+}
+};  // namespace os
+#endif
 
 namespace HAL
 {
@@ -163,6 +189,39 @@ class InterruptPeripheral {
     virtual void irq_handler(uint8_t irq_type) = 0;
 };
 
+/**
+ * \brief raw handler as it sits in the vector table
+ */
+using InterruptVector = void (*)(void);
+
+constexpr size_t vector_table_size = static_cast<size_t>(InterruptName::floating_point_unit) + 1;  //!< including the stack pointer
+
+/**
+ * \brief static trampoline for one peripheral interrupt, for placing straight in the vector table. The call is
+ *        qualified so it is not virtual, which lets the compiler inline the handler and fold away any switch
+ *        on the interrupt type.
+ *
+ * \tparam Peripheral the peripheral instance, which must have static storage
+ * \tparam Type interrupt type passed to the handler
+ */
+template <auto& Peripheral, uint8_t Type>
+void direct_irq_handler(void) {
+    using peripheral_type = std::remove_reference_t<decltype(Peripheral)>;
+#ifdef OS_TRACE
+    os::os_trace_isr_enter();
+#endif
+#ifdef OS_IRQ_PROFILING
+    uint32_t entry_cycles = os::os_irq_profile_enter();
+    Peripheral.peripheral_type::irq_handler(Type);
+    os::os_irq_profile_exit(entry_cycles);
+#else
+    Peripheral.peripheral_type::irq_handler(Type);
+#endif
+#ifdef OS_TRACE
+    os::os_trace_isr_exit();
+#endif
+}
+
 /**
  * \brief structure to register a peripherals interrupt handler in the interrupt table
  * 
@@ -184,6 +243,9 @@ class InterruptManager {
      */
     InterruptManager() {
         NVIC_SetPriorityGrouping(nvic_priority_group_level);
+#ifdef HAL_RAM_VECTOR_TABLE
+        this->relocate_vector_table();
+#endif
     }
 
     /**
@@ -196,7 +258,11 @@ class InterruptManager {
         uint32_t priority = NVIC_EncodePriority(nvic_priority_group_level, static_cast<uint32_t>(preemption_priority), 1UL);
         IRQn external_interrupt_number = static_cast<IRQn>(static_cast<uint8_t>(interrupt) - external_interrupt_offset);
         NVIC_SetPriority(external_interrupt_number, priority);
-        NVIC_EnableIRQ(external_interrupt_number);
+
+        /* core exceptions have negative numbers and are always enabled, only external interrupts go through the NVIC */
+        if ( external_interrupt_number >= 0 ) {
+            NVIC_EnableIRQ(external_interrupt_number);
+        }
     }
 
     /**
@@ -225,6 +291,30 @@ class InterruptManager {
         set_priority(interrupt, preemption_priority);
     }
     
+    /**
+     * \brief bind an interrupt straight to a peripheral's handler. With the vector table in RAM the hardware
+     *        vectors to a trampoline for this peripheral and type, otherwise this is the same as register_callback.
+     *
+     * \tparam Peripheral the peripheral instance, which must have static storage
+     * \tparam Type type of the interrupt (for peripherals with multiple interrupts)
+     * \param interrupt the interrupt to register
+     * \param preemption_priority The NVIC preemption priority
+     */
+    template <auto& Peripheral, uint8_t Type>
+    void register_direct_callback(InterruptName interrupt, PreemptionPriority preemption_priority) {
+#ifdef HAL_RAM_VECTOR_TABLE
+        this->set_vector(interrupt, direct_irq_handler<Peripheral, Type>);
+        set_priority(interrupt, preemption_priority);
+#else
+        this->register_callback(interrupt, &Peripheral, Type, preemption_priority);
+#endif
+    }
+
+#ifdef HAL_RAM_VECTOR_TABLE
+    void relocate_vector_table(void);
+    void set_vector(InterruptName interrupt, InterruptVector vector);
+#endif
+
     /**
      * \brief default ISR handler to map specific function pointers from the startup file into 
      *        the registered interrupts table
@@ -84,4 +84,27 @@ void PowerManagement::set_control_register(PowerManagementControlRegister reg, u
     }
 }
 
+/**
+ * \brief stop every clock below the core until an EXTI line or wakeup event fires. SRAM and registers are kept.
+ *        Call this with interrupts masked by PRIMASK so the waking interrupt only runs once the caller has restored
+ *        the system clock with ResetControlClock::restore_main_pll.
+ *
+ * \param low_power_regulator true to run the regulator in low power mode, which saves more but wakes slower
+ */
+void PowerManagement::enter_stop_mode(bool low_power_regulator) {
+    /* stop rather than standby, which would lose the SRAM */
+    this->peripheral->CR &= ~PWR_CR_PDDS;
+    if ( low_power_regulator ) {
+        this->peripheral->CR |= PWR_CR_LPDS;
+    } else {
+        this->peripheral->CR &= ~PWR_CR_LPDS;
+    }
+
+    SCB->SCR |= SCB_SCR_SLEEPDEEP_Msk;
+    __DSB();
+    __WFI();
+    __ISB();
+    SCB->SCR &= ~SCB_SCR_SLEEPDEEP_Msk;
+}
+
 };  // namespace HAL
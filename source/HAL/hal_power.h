@@ -52,6 +52,7 @@ class PowerManagement {
   public:
     PowerManagement(PWR_TypeDef* pwr_peripheral_address);
     void set_control_register(PowerManagementControlRegister reg, uint8_t value);
+    void enter_stop_mode(bool low_power_regulator);
 };
 
 /*********************************** Macros ********************************************/
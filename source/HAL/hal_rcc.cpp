@@ -8,38 +8,94 @@
 
 /********************************** Includes *******************************************/
 #include "hal_rcc.h"
-#include <map>
+#include "hal_flash.h"
 
 namespace HAL
 {
 
+/************************************ Consts ********************************************/
+constexpr uint32_t hsi_frequency = 16000000;
+constexpr uint32_t flash_wait_state_frequency = 30000000;  //!< HCLK each flash wait state covers at 2.7-3.6V
+constexpr uint32_t ahb_prescaler_mask = 0x0F;
+constexpr uint32_t apb_prescaler_mask = 0x07;
+constexpr uint16_t plli2s_n_min = 192;
+constexpr uint16_t plli2s_n_max = 432;
+constexpr uint8_t plli2s_r_min = 2;
+constexpr uint8_t plli2s_r_max = 7;
+
+/************************************ Types ********************************************/
+/**
+ * \brief clock sources and bus prescalers of a performance level
+ */
+struct PerformanceProfile {
+    SystemClockSource source;
+    AHBPrescaler ahb;
+    APBPrescaler apb1;
+    APBPrescaler apb2;
+};
+
+//!< indexed by PerformanceLevel
+constexpr PerformanceProfile performance_profiles[] = {
+    {SystemClockSource::phase_locked_loop, AHBPrescaler::prescaler_none, APBPrescaler::prescaler_4, APBPrescaler::prescaler_2},
+    {SystemClockSource::phase_locked_loop, AHBPrescaler::prescaler_2, APBPrescaler::prescaler_2, APBPrescaler::prescaler_none},
+    {SystemClockSource::high_speed_internal, AHBPrescaler::prescaler_none, APBPrescaler::prescaler_none, APBPrescaler::prescaler_none},
+};
+
 /************************************ Local Function Definitions ********************************************/
+/**
+ * \brief map an ahb prescaler value to its integer divider
+ * 
+ * \param prescaler the prescaler setting
+ * \retval uint32_t the clock divider
+ */
+static constexpr uint32_t get_ahb_divider(AHBPrescaler prescaler) {
+    switch ( prescaler ) {
+        case AHBPrescaler::prescaler_2:
+            return 2;
+        case AHBPrescaler::prescaler_4:
+            return 4;
+        case AHBPrescaler::prescaler_8:
+            return 8;
+        case AHBPrescaler::prescaler_16:
+            return 16;
+        case AHBPrescaler::prescaler_64:
+            return 64;
+        case AHBPrescaler::prescaler_128:
+            return 128;
+        case AHBPrescaler::prescaler_256:
+            return 256;
+        case AHBPrescaler::prescaler_512:
+            return 512;
+        default:
+            return 1;
+    }
+}
+
+/**
+ * \brief map an apb prescaler value to its integer divider
+ * 
+ * \param prescaler the prescaler setting
+ * \retval uint32_t the clock divider
+ */
+static constexpr uint32_t get_apb_divider(APBPrescaler prescaler) {
+    switch ( prescaler ) {
+        case APBPrescaler::prescaler_2:
+            return 2;
+        case APBPrescaler::prescaler_4:
+            return 4;
+        case APBPrescaler::prescaler_8:
+            return 8;
+        case APBPrescaler::prescaler_16:
+            return 16;
+        default:
+            return 1;
+    }
+}
 
 /************************************ Global Variables ********************************************/
 ResetControlClock reset_control_clock(RCC);  //!< single instance of the RCC peripheral object created with a pointer to the RCC address
 
 /************************************ Local Variables ********************************************/
-/* map ahb prescaler values to integers */
-static std::map<AHBPrescaler, uint32_t> ahb_scaler_map{
-    {AHBPrescaler::prescaler_none, 1},
-    {AHBPrescaler::prescaler_2, 2},
-    {AHBPrescaler::prescaler_4, 4},
-    {AHBPrescaler::prescaler_8, 8},
-    {AHBPrescaler::prescaler_16, 16},
-    {AHBPrescaler::prescaler_64, 64},
-    {AHBPrescaler::prescaler_128, 128},
-    {AHBPrescaler::prescaler_256, 256},
-    {AHBPrescaler::prescaler_512, 512},
-};
-
-/* map apb prescalers to integers */
-static std::map<APBPrescaler, uint32_t> apb_scaler_map{
-    {APBPrescaler::prescaler_none, 1},
-    {APBPrescaler::prescaler_2, 2},
-    {APBPrescaler::prescaler_4, 4},
-    {APBPrescaler::prescaler_8, 8},
-    {APBPrescaler::prescaler_16, 16},
-};
 
 /************************************ Function Definitions ********************************************/
 /**
@@ -51,6 +107,7 @@ static std::map<APBPrescaler, uint32_t> apb_scaler_map{
  */
 ResetControlClock::ResetControlClock(RCC_TypeDef* rcc_peripheral_address) {
     this->rcc = rcc_peripheral_address;
+    this->performance_level = PerformanceLevel::full;
 }
 
 /**
@@ -134,9 +191,11 @@ void ResetControlClock::configure_main_pll(
     /* set the output for the 48 MHz clock source: PLL_Q */
     this->rcc->PLLCFGR |= (pll_q << static_cast<uint8_t>(PLLRegister::pll_q));
 
-    /* set the system clock speed */
+    /* set the system clock speed. The I2S PLL shares the input divider, so it is saved for that too */
     uint8_t pll_p_scaler = (static_cast<uint8_t>(pll_p) + 1) * 2;
-    this->clock_configuration.system_clock = (oscillator_speed * pll_n) / (pll_m * pll_p_scaler);
+    this->pll_input_speed = oscillator_speed / pll_m;
+    this->pll_clock_speed = (oscillator_speed * pll_n) / (pll_m * pll_p_scaler);
+    this->clock_configuration.system_clock = this->pll_clock_speed;
     this->save_clock_configuration();
 }
 
@@ -163,10 +222,11 @@ void ResetControlClock::set_system_clock_source(SystemClockSource source) {
  * \param prescaler 
  */
 void ResetControlClock::configure_ahb_clock(AHBPrescaler prescaler) {
+    this->rcc->CFGR &= ~(ahb_prescaler_mask << static_cast<uint8_t>(ConfigurationRegister::ahb_prescaler));
     this->rcc->CFGR |= (static_cast<uint8_t>(prescaler) << static_cast<uint8_t>(ConfigurationRegister::ahb_prescaler));
 
     /* store the clock configuration for the AHB clock */
-    this->clock_configuration.ahb_scaler = ahb_scaler_map[prescaler];
+    this->clock_configuration.ahb_scaler = get_ahb_divider(prescaler);
     this->save_clock_configuration();
 }
 
@@ -176,10 +236,11 @@ void ResetControlClock::configure_ahb_clock(AHBPrescaler prescaler) {
  * \param prescaler 
  */
 void ResetControlClock::configure_apb2_clock(APBPrescaler prescaler) {
+    this->rcc->CFGR &= ~(apb_prescaler_mask << static_cast<uint8_t>(ConfigurationRegister::apb2_prescaler));
     this->rcc->CFGR |= (static_cast<uint8_t>(prescaler) << static_cast<uint8_t>(ConfigurationRegister::apb2_prescaler));
 
     /* store the clock configuration for the APB1 clock */
-    this->clock_configuration.apb2_scaler = apb_scaler_map[prescaler];
+    this->clock_configuration.apb2_scaler = get_apb_divider(prescaler);
     this->save_clock_configuration();
 }
 
@@ -189,10 +250,11 @@ void ResetControlClock::configure_apb2_clock(APBPrescaler prescaler) {
  * \param prescaler 
  */
 void ResetControlClock::configure_apb1_clock(APBPrescaler prescaler) {
+    this->rcc->CFGR &= ~(apb_prescaler_mask << static_cast<uint8_t>(ConfigurationRegister::apb1_prescaler));
     this->rcc->CFGR |= (static_cast<uint8_t>(prescaler) << static_cast<uint8_t>(ConfigurationRegister::apb1_prescaler));
 
     /* store the clock configuration for the APB1 clock */
-    this->clock_configuration.apb1_scaler = apb_scaler_map[prescaler];
+    this->clock_configuration.apb1_scaler = get_apb_divider(prescaler);
     this->save_clock_configuration();
 }
 
@@ -305,4 +367,153 @@ void ResetControlClock::save_clock_configuration(void) {
     this->clock_configuration.apb2 = this->clock_configuration.system_clock / this->clock_configuration.apb2_scaler;
 }
 
-};  // namespace HAL
\ No newline at end of file
+/**
+ * \brief restart the main PLL and switch the system clock back to it. Waking from STOP mode leaves the system
+ *        on the internal oscillator with the PLL and external oscillator off, but the PLL factors, bus prescalers and
+ *        flash wait states are all kept, so only the oscillators have to be restarted. The low performance level
+ *        already runs from the internal oscillator, so there is nothing to restore.
+ */
+void ResetControlClock::restore_main_pll(void) {
+    if ( this->performance_level == PerformanceLevel::low ) {
+        return;
+    }
+    this->start_main_pll();
+    this->set_system_clock_source(SystemClockSource::phase_locked_loop);
+}
+
+/**
+ * \brief setup the I2S PLL, which runs from the same input divider as the main PLL so configure_main_pll must be
+ *        called first. The I2S peripherals are switched over to it as their clock source. The PLL has to be
+ *        stopped to change its factors.
+ *
+ * \param plli2s_n VCO multiplication factor, from 192 to 432
+ * \param plli2s_r I2S clock division factor, from 2 to 7
+ */
+void ResetControlClock::configure_i2s_pll(uint16_t plli2s_n, uint8_t plli2s_r) {
+    assert((plli2s_n >= plli2s_n_min) && (plli2s_n <= plli2s_n_max));
+    assert((plli2s_r >= plli2s_r_min) && (plli2s_r <= plli2s_r_max));
+    assert(this->pll_input_speed != 0);
+    assert(this->get_control_register(RCCRegister::i2s_pll_on) == 0);
+
+    this->rcc->PLLI2SCFGR = (static_cast<uint32_t>(plli2s_r) << static_cast<uint8_t>(PLLI2SRegister::plli2s_r))
+                            | (static_cast<uint32_t>(plli2s_n) << static_cast<uint8_t>(PLLI2SRegister::plli2s_n));
+    this->rcc->CFGR &= ~(0x01u << static_cast<uint8_t>(ConfigurationRegister::i2s_clock_source));
+    this->i2s_pll_clock_speed = (this->pll_input_speed * plli2s_n) / plli2s_r;
+}
+
+/**
+ * \brief start the I2S PLL and wait for it to lock
+ * \note the PLL stops along with the others in STOP mode, so a driver using it keeps its peripheral clock
+ *       requested for as long as it runs
+ */
+void ResetControlClock::start_i2s_pll(void) {
+    this->set_control_register(RCCRegister::i2s_pll_on, 0x01);
+    while ( this->get_control_register(RCCRegister::i2s_pll_ready) == 0 ) {
+    }
+}
+
+/**
+ * \brief stop the I2S PLL
+ */
+void ResetControlClock::stop_i2s_pll(void) {
+    this->rcc->CR &= ~(0x01u << static_cast<uint8_t>(RCCRegister::i2s_pll_on));
+    while ( this->get_control_register(RCCRegister::i2s_pll_ready) != 0 ) {
+    }
+}
+
+/**
+ * \brief switch to one of the predefined clock profiles. The flash wait states follow the new AHB clock, and the
+ *        bus prescalers are stepped in an order that never takes a bus past its limit on the way. Peripherals
+ *        derive their rates from get_clock_speed, so anything set up with the old speeds must be reconfigured
+ *        once this returns.
+ *
+ * \param level the clock profile
+ * \note must be called from privileged code. The PLL lock wait when leaving the low level is done with
+ *       interrupts enabled, the switch itself with them masked.
+ */
+void ResetControlClock::set_performance_level(PerformanceLevel level) {
+    const PerformanceProfile& profile = performance_profiles[static_cast<uint8_t>(level)];
+    const bool use_pll = (profile.source == SystemClockSource::phase_locked_loop);
+    const uint32_t system_clock = use_pll ? this->pll_clock_speed : hsi_frequency;
+    const uint32_t ahb_clock = system_clock / get_ahb_divider(profile.ahb);
+    const uint8_t wait_states = static_cast<uint8_t>((ahb_clock - 1) / flash_wait_state_frequency);
+    const bool speeding_up = (ahb_clock > this->clock_configuration.ahb);
+
+    if ( use_pll ) {
+        this->start_main_pll();
+    } else {
+        this->set_control_register(RCCRegister::hsi_on, 0x01);
+        while ( this->get_control_register(RCCRegister::hsi_ready) == 0 ) {
+        }
+    }
+
+    uint32_t interrupt_mask = __get_PRIMASK();
+    __disable_irq();
+    if ( speeding_up ) {
+        /* slow the buses down first, so the AHB and source changes only ever bring them up to their targets */
+        flash.set_latency(wait_states);
+        this->configure_apb1_clock(profile.apb1);
+        this->configure_apb2_clock(profile.apb2);
+        this->configure_ahb_clock(profile.ahb);
+        this->set_system_clock_source(profile.source);
+    } else {
+        /* the reverse, cutting the clock at the source before opening up the prescalers */
+        this->set_system_clock_source(profile.source);
+        this->configure_ahb_clock(profile.ahb);
+        this->configure_apb1_clock(profile.apb1);
+        this->configure_apb2_clock(profile.apb2);
+        flash.set_latency(wait_states);
+    }
+    this->clock_configuration.system_clock = system_clock;
+    this->save_clock_configuration();
+    this->performance_level = level;
+    __set_PRIMASK(interrupt_mask);
+
+    /* nothing else runs from the PLL, the external oscillator is left running so the PLL relocks quickly */
+    if ( !use_pll ) {
+        this->rcc->CR &= ~(0x01u << static_cast<uint8_t>(RCCRegister::main_pll_on));
+    }
+}
+
+/**
+ * \brief start the main PLL and its oscillator if they aren't already running, and wait for the PLL to lock
+ */
+void ResetControlClock::start_main_pll(void) {
+    if ( this->rcc->PLLCFGR & (0x01u << static_cast<uint8_t>(PLLRegister::pll_source)) ) {
+        this->set_control_register(RCCRegister::hse_on, 0x01);
+        while ( this->get_control_register(RCCRegister::hse_ready) == 0 ) {
+        }
+    }
+
+    this->set_control_register(RCCRegister::main_pll_on, 0x01);
+    while ( this->get_control_register(RCCRegister::main_pll_ready) == 0 ) {
+    }
+}
+
+/**
+ * \brief count a request for a clock on or off, switching the clock when the count moves to or from zero
+ *
+ * \param bus index of the clock's bus
+ * \param enable_register the bus clock enable register
+ * \param bit the clock's enable bit
+ * \param request true to request the clock, false to release it
+ */
+void ResetControlClock::update_clock_request(uint8_t bus, volatile uint32_t& enable_register, uint8_t bit, bool request) {
+    uint32_t interrupt_mask = __get_PRIMASK();
+    __disable_irq();
+    uint8_t& requests = this->clock_requests[bus][bit];
+    if ( request ) {
+        if ( requests++ == 0 ) {
+            enable_register |= (0x01u << bit);
+            this->requested_clock_count++;
+        }
+    } else if ( requests > 0 ) {
+        if ( --requests == 0 ) {
+            enable_register &= ~(0x01u << bit);
+            this->requested_clock_count--;
+        }
+    }
+    __set_PRIMASK(interrupt_mask);
+}
+
+};  // namespace HAL
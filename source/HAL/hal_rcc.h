@@ -71,6 +71,14 @@ enum class PLLRegister : unsigned {
     pll_q = 24        //!< bit locations of the PLL_Q factor register
 };
 
+/**
+ * \brief enumeration of register bit offsets for the PLLI2SCFGR register
+ */
+enum class PLLI2SRegister : unsigned {
+    plli2s_n = 6,   //!< bit locations of the PLLI2S_N multiplication factor
+    plli2s_r = 28   //!< bit locations of the PLLI2S_R division factor for the I2S clock
+};
+
 /**
  * \brief clock source selector for the main PLL
  */
@@ -133,6 +141,16 @@ enum class APBPrescaler : unsigned {
     prescaler_16 = 0b111,
 };
 
+/**
+ * \brief predefined clock profiles for ResetControlClock::set_performance_level. The PLL profiles are relative to
+ *        the PLL output set up by configure_main_pll, which is 168 MHz on this board.
+ */
+enum class PerformanceLevel : unsigned {
+    full = 0,  //!< PLL at 168 MHz with the APB1 bus at 42 MHz and APB2 at 84 MHz
+    half,      //!< PLL divided down to 84 MHz, keeping both APB buses at the same speeds as full
+    low,       //!< internal oscillator at 16 MHz with the PLL stopped, and both APB buses at 16 MHz
+};
+
 /**
  * \brief enumeration of bit offsets for ahb1 clocks
  */
@@ -231,12 +249,36 @@ enum class APB2Clocks : unsigned {
  */
 class ResetControlClock {
   private:
+    static constexpr uint8_t clock_bus_count = 5;  //!< AHB1, AHB2, AHB3, APB1 and APB2 each have an enable register
+
     /* private data */
     RCC_TypeDef* rcc;
     ClockSpeed clock_configuration;
 
+    /* requests for each clock enable bit. These are left out of the constructor so the zero initialization of
+       the global instance stands, even for drivers constructed in other translation units before it */
+    uint8_t clock_requests[clock_bus_count][32];
+    uint16_t requested_clock_count;
+    uint32_t pll_clock_speed;
+    uint32_t pll_input_speed;      //!< VCO input shared by the main and I2S PLLs, the oscillator divided by PLL_M
+    uint32_t i2s_pll_clock_speed;  //!< I2S kernel clock from PLLI2S_R
+    PerformanceLevel performance_level;
+
     /* private methods */
     void save_clock_configuration(void);
+    void update_clock_request(uint8_t bus, volatile uint32_t& enable_register, uint8_t bit, bool request);
+    void start_main_pll(void);
+
+    static constexpr uint8_t get_clock_bus(AHB1Clocks) { return 0; }
+    static constexpr uint8_t get_clock_bus(AHB2Clocks) { return 1; }
+    static constexpr uint8_t get_clock_bus(AHB3Clocks) { return 2; }
+    static constexpr uint8_t get_clock_bus(APB1Clocks) { return 3; }
+    static constexpr uint8_t get_clock_bus(APB2Clocks) { return 4; }
+    volatile uint32_t& get_enable_register(AHB1Clocks) { return this->rcc->AHB1ENR; }
+    volatile uint32_t& get_enable_register(AHB2Clocks) { return this->rcc->AHB2ENR; }
+    volatile uint32_t& get_enable_register(AHB3Clocks) { return this->rcc->AHB3ENR; }
+    volatile uint32_t& get_enable_register(APB1Clocks) { return this->rcc->APB1ENR; }
+    volatile uint32_t& get_enable_register(APB2Clocks) { return this->rcc->APB2ENR; }
 
   public:
     /* public methods */
@@ -254,6 +296,59 @@ class ResetControlClock {
     void set_apb_clock(APB1Clocks clock, bool enable);
     void set_apb_clock(APB2Clocks clock, bool enable);
     uint32_t get_clock_speed(Clocks clock);
+    void restore_main_pll(void);
+    void configure_i2s_pll(uint16_t plli2s_n, uint8_t plli2s_r);
+    void start_i2s_pll(void);
+    void stop_i2s_pll(void);
+
+    /**
+     * \brief get the I2S kernel clock, which the I2S prescalers divide down to the sample rate
+     *
+     * \retval uint32_t clock speed in Hz
+     */
+    uint32_t get_i2s_clock_speed(void) const {
+        return this->i2s_pll_clock_speed;
+    }
+    void set_performance_level(PerformanceLevel level);
+
+    /**
+     * \brief get the active clock profile
+     *
+     * \retval PerformanceLevel the profile
+     */
+    PerformanceLevel get_performance_level(void) const {
+        return this->performance_level;
+    }
+
+    /**
+     * \brief request a peripheral clock, enabling it for the first request. Safe to call from interrupts.
+     *
+     * \param clock one of the AHB or APB clock enables
+     */
+    template <typename Clock>
+    void request_clock(Clock clock) {
+        this->update_clock_request(get_clock_bus(clock), this->get_enable_register(clock), static_cast<uint8_t>(clock), true);
+    }
+
+    /**
+     * \brief release a peripheral clock, disabling it once every request has been released
+     *
+     * \param clock one of the AHB or APB clock enables
+     */
+    template <typename Clock>
+    void release_clock(Clock clock) {
+        this->update_clock_request(get_clock_bus(clock), this->get_enable_register(clock), static_cast<uint8_t>(clock), false);
+    }
+
+    /**
+     * \brief get the number of peripheral clocks held on by a request. The core can only enter STOP mode when this
+     *        is zero, as every clock below the core stops with it.
+     *
+     * \retval uint16_t clocks with at least one request
+     */
+    uint16_t get_requested_clock_count(void) const {
+        return this->requested_clock_count;
+    }
 };
 
 /*********************************** Macros ********************************************/
@@ -0,0 +1,90 @@
+/*! \file hal_register.h
+*
+*  \brief typed register field values that merge at compile time into a single masked write
+*
+*
+*  \author Graham Riches
+*/
+
+#pragma once
+
+/********************************** Includes *******************************************/
+#include <stdint.h>
+
+namespace HAL
+{
+
+/********************************** Templates *******************************************/
+/**
+ * \brief get the width in bits of a register field. Fields are single bits unless the register's enum provides
+ *        its own overload, which is found by argument dependent lookup.
+ *
+ * \tparam Register scoped enum of the field offsets within one register
+ * \param field the field
+ * \retval uint8_t width in bits
+ */
+template <typename Register>
+constexpr uint8_t get_field_width(Register field) {
+    static_cast<void>(field);
+    return 1;
+}
+
+/**
+ * \brief values for one or more fields of a single register. Values for the same register combine with |, so
+ *        a whole set of fields is written with one read-modify-write, and mixing up registers fails to compile.
+ *        With constant values the mask and bits are worked out entirely at compile time.
+ *
+ * \tparam Register scoped enum of the field offsets within the register
+ */
+template <typename Register>
+class RegisterValue {
+  public:
+    constexpr RegisterValue(uint32_t mask, uint32_t bits)
+        : mask(mask)
+        , bits(bits & mask) { }
+
+    /**
+     * \brief merge the fields of two values. Where both set a field the right hand value wins.
+     */
+    constexpr RegisterValue operator|(RegisterValue other) const {
+        return RegisterValue(this->mask | other.mask, (this->bits & ~other.mask) | other.bits);
+    }
+
+    constexpr uint32_t get_mask(void) const {
+        return this->mask;
+    }
+
+    constexpr uint32_t get_bits(void) const {
+        return this->bits;
+    }
+
+    /**
+     * \brief update just these fields of a register, leaving the rest alone
+     *
+     * \param reg the register
+     */
+    template <typename T>
+    void modify(volatile T& reg) const {
+        reg = static_cast<T>((reg & ~this->mask) | this->bits);
+    }
+
+  private:
+    uint32_t mask;
+    uint32_t bits;
+};
+
+/**
+ * \brief make a value for one field of a register
+ *
+ * \param position the field
+ * \param value the field value, truncated to the field's width
+ * \retval RegisterValue<Register> the field value, ready to combine with others from the same register
+ */
+template <typename Register>
+constexpr RegisterValue<Register> field(Register position, uint32_t value) {
+    const uint8_t offset = static_cast<uint8_t>(position);
+    const uint32_t mask = ((0x01u << get_field_width(position)) - 1u) << offset;
+    return RegisterValue<Register>(mask, value << offset);
+}
+
+};  // namespace HAL
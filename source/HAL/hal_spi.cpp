@@ -8,12 +8,14 @@
 
 /********************************** Includes *******************************************/
 #include "hal_spi.h"
+#include "cm4_port.h"
 #include <cassert>
 
 namespace HAL
 {
 
 /*********************************** Consts ********************************************/
+static const uint8_t dummy_transmit = 0x00;  //!< clocked out by read only DMA transfers
 
 /************************************ Types ********************************************/
 
@@ -42,6 +44,17 @@ SPIBase::SPIBase(SPI_TypeDef* spi_peripheral_address, OutputPin chip_select) {
     this->chip_select.set(true);
 }
 
+/**
+ * \brief Construct a new SPIBase::SPIBase object for a peripheral that is shared between devices, which each
+ *        drive their own chip select
+ *
+ * \param spi_peripheral_address the address of the memory mapped peripheral
+ */
+SPIBase::SPIBase(SPI_TypeDef* spi_peripheral_address) {
+    assert(spi_peripheral_address != nullptr);
+    this->peripheral = spi_peripheral_address;
+}
+
 /**
  * \brief read a status register flag from the peripheral
  * 
@@ -59,14 +72,7 @@ uint8_t SPIBase::read_status_register(SPIStatusRegister reg) {
  * \param value value to write
  */
 void SPIBase::write_control_register(SPIControlRegister1 reg, uint8_t value) {
-    /* clear a single bit unless the register is the baudrate (3 bits ) */
-    uint8_t register_mask = (reg != SPIControlRegister1::baudrate) ? 0b1 : 0b111;
-
-    /* clear the register */
-    this->peripheral->CR1 &= ~static_cast<uint16_t>((register_mask << static_cast<uint8_t>(reg)));
-
-    /* write the value */
-    this->peripheral->CR1 |= static_cast<uint16_t>(((value & register_mask) << static_cast<uint8_t>(reg)));
+    this->modify_control_register(field(reg, value));
 }
 
 /**
@@ -76,11 +82,25 @@ void SPIBase::write_control_register(SPIControlRegister1 reg, uint8_t value) {
  * \param value the value to write
  */
 void SPIBase::write_control_register(SPIControlRegister2 reg, uint8_t value) {
-    /* clear the register */
-    this->peripheral->CR2 &= ~static_cast<uint16_t>((static_cast<uint8_t>(0x01) << static_cast<uint8_t>(reg)));
+    this->modify_control_register(field(reg, value));
+}
 
-    /* write the value */
-    this->peripheral->CR2 |= static_cast<uint16_t>(((value & 0x01) << static_cast<uint8_t>(reg)));
+/**
+ * \brief write one or more fields of CR1 with a single read-modify-write
+ * 
+ * \param value the merged field values
+ */
+void SPIBase::modify_control_register(RegisterValue<SPIControlRegister1> value) {
+    value.modify(this->peripheral->CR1);
+}
+
+/**
+ * \brief write one or more fields of CR2 with a single read-modify-write
+ * 
+ * \param value the merged field values
+ */
+void SPIBase::modify_control_register(RegisterValue<SPIControlRegister2> value) {
+    value.modify(this->peripheral->CR2);
 }
 
 /**
@@ -90,7 +110,7 @@ void SPIBase::write_control_register(SPIControlRegister2 reg, uint8_t value) {
  * \retval uint8_t register value
  */
 uint8_t SPIBase::read_control_register(SPIControlRegister1 reg) {
-    uint8_t register_mask = (reg != SPIControlRegister1::baudrate) ? 0b1 : 0b111;
+    uint8_t register_mask = (0x01u << get_field_width(reg)) - 1u;
     uint8_t register_value = static_cast<uint8_t>(this->peripheral->CR1 & (register_mask << static_cast<uint8_t>(reg)));
     return register_value;
 }
@@ -186,23 +206,28 @@ void SPIInterrupt::irq_handler(uint8_t type) {
     /* enable the chip select */
     this->chip_select.set(false);
 
-    while ( !this->tx_buffer.is_empty() ) {
-        /* wait for the transmit buffer to clear */
-        while ( this->read_status_register(SPIStatusRegister::transmit_data_empty) == false ) {
-        }
+    /* clock out the pending data one linear block at a time */
+    auto span = this->tx_buffer.peek_contiguous();
+    while ( span.size > 0 ) {
+        for ( size_t i = 0; i < span.size; i++ ) {
+            /* wait for the transmit buffer to clear */
+            while ( this->read_status_register(SPIStatusRegister::transmit_data_empty) == false ) {
+            }
 
-        /* put data outgoing into the data register */
-        auto maybe_data = this->tx_buffer.pop();
-        if (maybe_data.has_value()) {
-            this->peripheral->DR = maybe_data.value();
-        }
+            /* put data outgoing into the data register */
+            this->peripheral->DR = span.data[i];
 
-        /* wait for the receive buffer to clear */
-        while ( this->read_status_register(SPIStatusRegister::receive_data_available) == false ) {
+            /* wait for the receive buffer to clear */
+            while ( this->read_status_register(SPIStatusRegister::receive_data_available) == false ) {
+            }
+
+            /* receive data into the rx buffer */
+            this->rx_buffer.push(static_cast<uint8_t>(this->peripheral->DR));
         }
 
-        /* receive data into the rx buffer */
-        this->rx_buffer.push(static_cast<uint8_t>(this->peripheral->DR));
+        /* hand the whole block back to the producer at once */
+        this->tx_buffer.commit(span.size);
+        span = this->tx_buffer.peek_contiguous();
     }
 
     /* disable the interrupt */
@@ -217,16 +242,227 @@ void SPIInterrupt::irq_handler(uint8_t type) {
  * 
  */
 void SPIInterrupt::send(uint8_t* data, uint16_t size) {
-    /* put the data on the buffer */
-    while ( size-- ) {
-        this->tx_buffer.push(*data++);
-        if ( this->tx_buffer.is_full() ) {
-            break;
-        }
-    }
+    /* put as much of the data on the buffer as will fit */
+    this->tx_buffer.push_bulk(data, size);
 
     /* enable the tx interrupt */
     this->write_control_register(SPIControlRegister2::transmit_interrupt_enable, 0x01);
 }
 
+/****************************** SPIDMA Definitions ***********************************/
+/**
+ * \brief configure both streams for the peripheral and switch it over to DMA requests. The streams' clock must
+ *        already be enabled.
+ *
+ * \param priority stream priority, shared by both streams
+ */
+void SPIDMA::configure_dma(DMAPriority priority) {
+    this->tx_stream.configure(DMADirection::memory_to_peripheral, DMADataSize::byte, true, false, priority);
+    this->rx_stream.configure(DMADirection::peripheral_to_memory, DMADataSize::byte, true, false, priority);
+    this->tx_stream.enable_interrupt(DMAStreamControlRegister::transfer_error_interrupt_enable, true);
+    this->rx_stream.enable_interrupt(DMAStreamControlRegister::transfer_error_interrupt_enable, true);
+    this->rx_stream.enable_interrupt(DMAStreamControlRegister::transfer_complete_interrupt_enable, true);
+
+    /* the requests wait in the peripheral until a stream is started to serve them */
+    this->modify_control_register(field(SPIControlRegister2::receive_dma_enable, 0x01)
+                                  | field(SPIControlRegister2::transmit_dma_enable, 0x01));
+}
+
+/**
+ * \brief start a full duplex transfer. Either buffer can be null, in which case zeros are clocked out or the
+ *        received data is thrown away. Both buffers must stay valid until the transfer completes.
+ *
+ * \param tx_buffer data to send, or nullptr
+ * \param rx_buffer where to store the received data, or nullptr
+ * \param size number of bytes to transfer
+ * \retval true if the transfer was started, false if another one is still running
+ */
+bool SPIDMA::read_write(const uint8_t* tx_buffer, uint8_t* rx_buffer, uint16_t size) {
+    return this->start_transfer(&this->chip_select, tx_buffer, rx_buffer, size);
+}
+
+/**
+ * \brief start a transfer with a chip select of the caller's choosing
+ *
+ * \param chip_select the pin to hold low for the transfer
+ * \param tx_buffer data to send, or nullptr
+ * \param rx_buffer where to store the received data, or nullptr
+ * \param size number of bytes to transfer
+ * \retval true if the transfer was started, false if another one is still running
+ */
+bool SPIDMA::start_transfer(OutputPin* chip_select, const uint8_t* tx_buffer, uint8_t* rx_buffer, uint16_t size) {
+    if ( this->transfer_in_progress || (size == 0) ) {
+        return false;
+    }
+    this->transfer_in_progress = true;
+
+    this->tx_stream.set_memory_increment(tx_buffer != nullptr);
+    this->rx_stream.set_memory_increment(rx_buffer != nullptr);
+    this->active_chip_select = chip_select;
+    this->active_chip_select->set(false);
+
+    /* start the receiver first so it is ready for the first byte */
+    this->rx_stream.start(&this->peripheral->DR, (rx_buffer != nullptr) ? rx_buffer : &this->discard, size);
+    this->tx_stream.start(&this->peripheral->DR, (tx_buffer != nullptr) ? tx_buffer : &dummy_transmit, size);
+    return true;
+}
+
+/**
+ * \brief check if a transfer is still running
+ *
+ * \retval true/false
+ */
+bool SPIDMA::is_busy(void) {
+    return this->transfer_in_progress;
+}
+
+/**
+ * \brief handle the stream interrupts, which finish the transfer
+ *
+ * \param type stream_irq_type
+ */
+void SPIDMA::irq_handler(uint8_t type) {
+    PARAMETER_NOT_USED(type);
+    bool success = !this->rx_stream.get_flag(DMAInterruptFlag::transfer_error) && !this->tx_stream.get_flag(DMAInterruptFlag::transfer_error);
+    this->rx_stream.clear_all_flags();
+    this->tx_stream.clear_all_flags();
+
+    /* the streams disable themselves when the count runs out, anything still running here hit an error */
+    if ( this->rx_stream.is_enabled() || this->tx_stream.is_enabled() ) {
+        if ( success ) {
+            return;
+        }
+        this->rx_stream.stop();
+        this->tx_stream.stop();
+    }
+
+    /* in full duplex every byte sent is also received, so once the rx stream has taken the last byte the clock
+       has stopped and the device can be released without waiting on BSY here */
+    this->active_chip_select->set(true);
+    this->transfer_in_progress = false;
+    this->on_transfer_complete(success);
+}
+
+/****************************** SPIBus Definitions ***********************************/
+/**
+ * \brief set the peripheral up as the bus master and enable it. The peripheral and stream clocks must already
+ *        be enabled.
+ *
+ * \param priority stream priority
+ */
+void SPIBus::configure(DMAPriority priority) {
+    this->write_control_register(SPIControlRegister1::master_select, 0x01);
+    this->write_control_register(SPIControlRegister2::slave_select_output_enable, 0x01);
+    this->configure_dma(priority);
+    this->write_control_register(SPIControlRegister1::spi_enable, 0x01);
+}
+
+/**
+ * \brief queue a transaction, starting it straight away if the bus is idle
+ *
+ * \param transaction the transaction, which must not already be queued
+ * \retval false if the transaction is already pending or empty
+ */
+bool SPIBus::submit(SPITransaction& transaction) {
+    /* the same transaction can be submitted from a thread and an interrupt, so claiming it has to be masked too */
+    os::critical_section critical;
+    if ( transaction.pending || (transaction.size == 0) || (transaction.device == nullptr) ) {
+        return false;
+    }
+    assert(is_dma_accessible(transaction.tx_buffer) && is_dma_accessible(transaction.rx_buffer));
+    transaction.pending = true;
+    transaction.next = nullptr;
+
+    bool idle = (this->head == nullptr);
+    if ( idle ) {
+        this->head = &transaction;
+    } else {
+        this->tail->next = &transaction;
+    }
+    this->tail = &transaction;
+    if ( idle && !this->suspended ) {
+        this->start_next();
+    }
+    return true;
+}
+
+/**
+ * \brief retire the finished transaction and start the next one before handing the result back
+ *
+ * \param success false if the transfer failed
+ */
+void SPIBus::on_transfer_complete(bool success) {
+    SPITransaction* finished;
+    {
+        os::critical_section critical;
+        finished = this->head;
+        this->head = finished->next;
+        if ( this->head == nullptr ) {
+            this->tail = nullptr;
+        } else if ( !this->suspended ) {
+            this->start_next();
+        }
+    }
+
+    /* the transaction belongs to the submitter again from here, so it can be queued again from the callback */
+    finished->pending = false;
+    if ( finished->callback != nullptr ) {
+        finished->callback(*finished, success);
+    }
+}
+
+/**
+ * \brief start the transaction at the head of the queue. Must be called in a critical section.
+ */
+void SPIBus::start_next(void) {
+    SPITransaction* transaction = this->head;
+    const SPIDevice* device = transaction->device;
+
+    /* the mode and rate can only change while the peripheral is disabled, which is fine between transfers */
+    if ( device != this->configured_device ) {
+        this->write_control_register(SPIControlRegister1::spi_enable, 0x00);
+        this->modify_control_register(field(SPIControlRegister1::clock_polarity, device->clock_polarity)
+                                      | field(SPIControlRegister1::clock_phase, device->clock_phase)
+                                      | field(SPIControlRegister1::baudrate, static_cast<uint32_t>(this->get_prescaler(device->max_clock_speed)))
+                                      | field(SPIControlRegister1::spi_enable, 0x01));
+        this->configured_device = device;
+    }
+    this->start_transfer(&transaction->device->chip_select, transaction->tx_buffer, transaction->rx_buffer, transaction->size);
+}
+
+/**
+ * \brief hold new transactions in the queue, letting the one in progress finish. Used to change the bus clock,
+ *        once is_busy shows the last transfer is done.
+ */
+void SPIBus::suspend(void) {
+    this->suspended = true;
+}
+
+/**
+ * \brief start the queued transactions again, working out each device's prescaler again from the bus clock
+ */
+void SPIBus::resume(void) {
+    os::critical_section critical;
+    this->suspended = false;
+    this->configured_device = nullptr;
+    if ( (this->head != nullptr) && !this->is_busy() ) {
+        this->start_next();
+    }
+}
+
+/**
+ * \brief get the smallest prescaler that keeps the serial clock within a device's limit
+ *
+ * \param max_clock_speed fastest serial clock the device supports in Hz
+ * \retval SPIBaudratePrescaler the prescaler, or the largest one if none are slow enough
+ */
+SPIBaudratePrescaler SPIBus::get_prescaler(uint32_t max_clock_speed) {
+    const uint32_t bus_clock = reset_control_clock.get_clock_speed(this->peripheral_clock);
+    uint8_t prescaler = static_cast<uint8_t>(SPIBaudratePrescaler::prescaler_2);
+    while ( ((bus_clock >> (prescaler + 1)) > max_clock_speed) && (prescaler < static_cast<uint8_t>(SPIBaudratePrescaler::prescaler_256)) ) {
+        prescaler++;
+    }
+    return static_cast<SPIBaudratePrescaler>(prescaler);
+}
+
 };  // namespace HAL
@@ -9,9 +9,12 @@
 #pragma once
 
 /********************************** Includes *******************************************/
+#include "hal_dma.h"
 #include "hal_gpio.h"
 #include "hal_interrupt.h"
-#include "ring_buffer.h"
+#include "hal_rcc.h"
+#include "hal_register.h"
+#include "spsc_ring_buffer.h"
 #include "stm32f4xx.h"
 
 namespace HAL
@@ -39,6 +42,13 @@ enum class SPIControlRegister1 : unsigned {
     bidirectional_mode_enable = 15
 };
 
+/**
+ * \brief the baudrate is the only SPI control register 1 field wider than a bit
+ */
+constexpr uint8_t get_field_width(SPIControlRegister1 field) {
+    return (field == SPIControlRegister1::baudrate) ? 3 : 1;
+}
+
 /**
  * \brief bit offsets for SPI control register 2 
  */
@@ -91,6 +101,7 @@ class SPIBase {
 
   public:
     SPIBase(SPI_TypeDef* spi_peripheral_address, OutputPin chip_select);
+    explicit SPIBase(SPI_TypeDef* spi_peripheral_address);
 
     /* interface setup function */
     virtual void initialize(){};
@@ -98,6 +109,8 @@ class SPIBase {
     uint8_t read_status_register(SPIStatusRegister reg);
     void write_control_register(SPIControlRegister1 reg, uint8_t value);
     void write_control_register(SPIControlRegister2 reg, uint8_t value);
+    void modify_control_register(RegisterValue<SPIControlRegister1> value);
+    void modify_control_register(RegisterValue<SPIControlRegister2> value);
     uint8_t read_control_register(SPIControlRegister1 reg);
     uint8_t read_control_register(SPIControlRegister2 reg);
     void set_baudrate(SPIBaudratePrescaler prescaler);
@@ -120,20 +133,144 @@ class SPIPolling : protected SPIBase {
  * \brief class to manage interrupt driven SPI peripherals
  */
 class SPIInterrupt : protected SPIBase, public HAL::InterruptPeripheral {
+  public:
+    static constexpr size_t buffer_size = 128;  //!< capacity of each of the tx and rx buffers
+
   protected:
-    RingBuffer<uint8_t> tx_buffer;
-    RingBuffer<uint8_t> rx_buffer;
+    SPSCRingBuffer<uint8_t, buffer_size> tx_buffer;  //!< written by the application, drained by the ISR
+    SPSCRingBuffer<uint8_t, buffer_size> rx_buffer;  //!< written by the ISR, drained by the application
 
   public:
-    SPIInterrupt(SPI_TypeDef* spi_peripheral_address, OutputPin chip_select, size_t tx_size, size_t rx_size)
+    SPIInterrupt(SPI_TypeDef* spi_peripheral_address, OutputPin chip_select)
         : SPIBase(spi_peripheral_address, chip_select)
-        , tx_buffer(tx_size)
-        , rx_buffer(rx_size) { }
+        , tx_buffer()
+        , rx_buffer() { }
 
     void irq_handler(uint8_t type);
     void send(uint8_t* data, uint16_t size);
 };
 
+/**
+ * \brief class to manage full duplex SPI transfers on a pair of DMA streams. The chip select is held low for the
+ *        whole transfer and released from the rx stream interrupt, which fires once the last byte is back. The tx
+ *        stream interrupt only reports errors.
+ */
+class SPIDMA : protected SPIBase, public HAL::InterruptPeripheral {
+  public:
+    static constexpr uint8_t stream_irq_type = 0;  //!< irq type to register both stream interrupts with
+
+    SPIDMA(SPI_TypeDef* spi_peripheral_address, OutputPin chip_select, DMAStream tx_stream, DMAStream rx_stream)
+        : SPIBase(spi_peripheral_address, chip_select)
+        , tx_stream(tx_stream)
+        , rx_stream(rx_stream)
+        , active_chip_select(nullptr)
+        , transfer_in_progress(false)
+        , discard(0) { }
+
+    RAM_FUNCTION void irq_handler(uint8_t type) override;
+    bool read_write(const uint8_t* tx_buffer, uint8_t* rx_buffer, uint16_t size);
+    bool is_busy(void);
+
+  protected:
+    /**
+     * \brief construct a peripheral without its own chip select, for buses where each transfer brings one
+     */
+    SPIDMA(SPI_TypeDef* spi_peripheral_address, DMAStream tx_stream, DMAStream rx_stream)
+        : SPIBase(spi_peripheral_address)
+        , tx_stream(tx_stream)
+        , rx_stream(rx_stream)
+        , active_chip_select(nullptr)
+        , transfer_in_progress(false)
+        , discard(0) { }
+
+    void configure_dma(DMAPriority priority);
+    bool start_transfer(OutputPin* chip_select, const uint8_t* tx_buffer, uint8_t* rx_buffer, uint16_t size);
+
+    /**
+     * \brief called from the rx stream interrupt when a transfer has finished and the chip select is released
+     *
+     * \param success false if either stream hit a transfer error, in which case the rx data is not valid
+     */
+    virtual void on_transfer_complete(bool success) {
+        PARAMETER_NOT_USED(success);
+    }
+
+  private:
+    DMAStream tx_stream;
+    DMAStream rx_stream;
+    OutputPin* active_chip_select;  //!< released when the transfer in progress completes
+    volatile bool transfer_in_progress;
+    uint8_t discard;  //!< rx destination for write only transfers
+};
+
+/**
+ * \brief a device on a shared SPI bus and the bus settings it needs
+ */
+struct SPIDevice {
+    OutputPin chip_select;
+    bool clock_polarity;  //!< true for a clock that idles high
+    bool clock_phase;     //!< true to sample on the second clock edge
+    uint32_t max_clock_speed;  //!< fastest serial clock the device supports in Hz. The bus picks the prescaler.
+};
+
+struct SPITransaction;
+using SPITransactionCallback = void (*)(SPITransaction& transaction, bool success);
+
+/**
+ * \brief a single transfer queued on a shared bus. The submitter owns the storage, which along with the buffers
+ *        must stay valid until the transaction completes. The buffers go through the DMA, so they can't be on a
+ *        thread stack or anywhere else in the core coupled memory.
+ */
+struct SPITransaction {
+    SPIDevice* device;
+    const uint8_t* tx_buffer;  //!< data to send, or nullptr to clock out zeros
+    uint8_t* rx_buffer;        //!< where to store the received data, or nullptr to throw it away
+    uint16_t size;
+    SPITransactionCallback callback;  //!< called from the completion interrupt, or nullptr
+    void* context;                    //!< passed through for the callback's use
+    volatile bool pending;            //!< set while the transaction is queued or running
+    SPITransaction* next;             //!< owned by the bus while the transaction is queued
+};
+
+/**
+ * \brief a shared SPI bus that runs queued transactions from several devices back to back. Each transaction is
+ *        started from the completion interrupt of the one before it, switching the clock mode and rate for its
+ *        device as needed.
+ * \note submit can be called from any thread or interrupt at or below the kernel interrupt ceiling, since the queue
+ *       is only touched in a critical section, but like the other drivers it needs privileged access to the peripheral
+ */
+class SPIBus : public SPIDMA {
+  public:
+    SPIBus(SPI_TypeDef* spi_peripheral_address, Clocks peripheral_clock, DMAStream tx_stream, DMAStream rx_stream)
+        : SPIDMA(spi_peripheral_address, tx_stream, rx_stream)
+        , head(nullptr)
+        , tail(nullptr)
+        , configured_device(nullptr)
+        , peripheral_clock(peripheral_clock)
+        , suspended(false) { }
+
+    void configure(DMAPriority priority);
+    bool submit(SPITransaction& transaction);
+    void suspend(void);
+    void resume(void);
+
+    /* transfers go through the queue, since a single transfer has no device to select */
+    bool read_write(const uint8_t* tx_buffer, uint8_t* rx_buffer, uint16_t size) = delete;
+
+  protected:
+    RAM_FUNCTION void on_transfer_complete(bool success) override;
+
+  private:
+    RAM_FUNCTION void start_next(void);
+    SPIBaudratePrescaler get_prescaler(uint32_t max_clock_speed);
+
+    SPITransaction* head;  //!< the transaction in progress, followed by the rest of the queue
+    SPITransaction* tail;
+    const SPIDevice* configured_device;  //!< the device the bus settings were last set up for
+    Clocks peripheral_clock;             //!< the bus clock the prescalers divide down
+    volatile bool suspended;             //!< holds queued transactions while the bus clock changes
+};
+
 /*********************************** Macros ********************************************/
 
 /******************************* Global Variables **************************************/
@@ -0,0 +1,319 @@
+/*! \file hal_timer.cpp
+*
+*  \brief HAL++ implementation of the 32-bit general purpose timers.
+*
+*
+*  \author Graham Riches
+*/
+
+/********************************** Includes *******************************************/
+#include "hal_timer.h"
+#include <cassert>
+
+
+namespace HAL
+{
+
+/*********************************** Consts ********************************************/
+constexpr uint8_t channel_mode_width = 8;           //!< bits per channel in the capture/compare mode registers
+constexpr uint8_t channel_enable_width = 4;         //!< bits per channel in the capture/compare enable register
+constexpr uint32_t channel_mode_mask = 0xFF;
+constexpr uint32_t channel_enable_mask = 0x0B;      //!< enable, polarity and complementary polarity bits
+constexpr uint32_t capture_select_input = 0b01;     //!< CCxS, capture from the channel's own input
+constexpr uint8_t output_compare_mode = 4;          //!< OCxM offset within a channel's mode bits
+constexpr uint8_t input_capture_filter = 4;         //!< ICxF offset within a channel's mode bits
+constexpr uint32_t input_capture_filter_mask = 0x0F;
+constexpr uint32_t channel_enable = 0x01;           //!< CCxE
+constexpr uint32_t channel_polarity = 0x02;         //!< CCxP, falling edge for a capture or active low for a compare
+constexpr uint32_t channel_complementary_polarity = 0x08;  //!< CCxNP, set along with CCxP to capture both edges
+constexpr uint32_t max_prescaler = 0xFFFF;
+
+/****************************** Function Definitions ***********************************/
+/**
+ * \brief Construct a new Timer object
+ *
+ * \param timer TIM2 or TIM5, the only timers with 32-bit counters
+ * \param bus_clock the bus the timer is clocked from, APB1 for both
+ * \note the timer's clock enable is requested separately, as with every other driver
+ */
+Timer::Timer(TIM_TypeDef* timer, Clocks bus_clock)
+    : timer(timer)
+    , bus_clock(bus_clock)
+    , tick_frequency(0)
+    , callback(nullptr)
+    , context(nullptr) {
+    assert((timer == TIM2) || (timer == TIM5));
+}
+
+/**
+ * \brief start the counter running up from zero over the full 32 bits
+ *
+ * \param tick_frequency counter rate in Hz, which must divide the timer clock down by no more than 65536
+ */
+void Timer::start(uint32_t tick_frequency) {
+    assert(tick_frequency > 0);
+    this->stop();
+    this->tick_frequency = tick_frequency;
+    this->timer->CR1 = 0;
+    this->timer->ARR = UINT32_MAX;
+    this->timer->CNT = 0;
+    this->update_tick_frequency();
+    this->modify_control_register(field(TimerControlRegister1::counter_enable, 0x01));
+}
+
+/**
+ * \brief stop the counter, leaving the count where it is
+ */
+void Timer::stop(void) {
+    this->modify_control_register(field(TimerControlRegister1::counter_enable, 0x00));
+}
+
+/**
+ * \brief work the prescaler out again from the current bus clock, so the counter keeps its rate across a clock
+ *        change. The prescaler only loads on an update event, which also clears the counter, so the count is put
+ *        back straight afterwards and only the few cycles in between are lost.
+ */
+void Timer::update_tick_frequency(void) {
+    uint32_t prescaler = (this->get_timer_clock() / this->tick_frequency) - 1;
+    assert(prescaler <= max_prescaler);
+
+    /* the update event would raise the update interrupt, but only the capture/compare interrupts get enabled */
+    uint32_t count = this->timer->CNT;
+    this->timer->PSC = static_cast<uint16_t>(prescaler);
+    this->timer->EGR = TIM_EGR_UG;
+    this->timer->CNT = count;
+    this->timer->SR = static_cast<uint16_t>(~(0x01u << static_cast<uint8_t>(TimerStatusRegister::update)));
+}
+
+/**
+ * \brief wrap the counter after a number of ticks rather than over the full 32 bits. The count restarts from zero,
+ *        as a counter already past the new period would otherwise run all the way round first.
+ *
+ * \param ticks ticks per period, or 0 to go back to free running
+ */
+void Timer::set_period(uint32_t ticks) {
+    this->timer->ARR = (ticks == 0) ? UINT32_MAX : ticks - 1;
+    this->timer->CNT = 0;
+}
+
+/**
+ * \brief select the event driven out on the trigger output, which the ADCs and other timers can start from
+ *
+ * \param mode the event
+ */
+void Timer::set_trigger_output(TimerMasterMode mode) {
+    field(TimerControlRegister2::master_mode, static_cast<uint32_t>(mode)).modify(this->timer->CR2);
+}
+
+/**
+ * \brief set up a channel as an output compare. With the frozen mode the channel only raises its interrupt or DMA
+ *        request, which with the free running counter is a one shot alarm at an absolute count.
+ *
+ * \param channel the channel
+ * \param mode what to do with the channel's pin on a match
+ * \param compare count to match
+ * \param interrupt true to call the callback on each match
+ */
+void Timer::configure_output_compare(TimerChannel channel, TimerOutputCompareMode mode, uint32_t compare, bool interrupt) {
+    /* the compare register is loaded straight away rather than preloaded, so an alarm can be moved at any time */
+    this->set_channel_mode(channel, static_cast<uint32_t>(mode) << output_compare_mode);
+    this->get_compare_register(channel) = compare;
+    this->set_channel_interrupt(channel, interrupt);
+
+    uint8_t enable_offset = static_cast<uint8_t>(channel) * channel_enable_width;
+    this->timer->CCER = static_cast<uint16_t>((this->timer->CCER & ~(channel_enable_mask << enable_offset)) | (channel_enable << enable_offset));
+}
+
+/**
+ * \brief move the match count of an output compare channel
+ *
+ * \param channel the channel
+ * \param compare count to match
+ */
+void Timer::set_compare(TimerChannel channel, uint32_t compare) {
+    this->get_compare_register(channel) = compare;
+}
+
+/**
+ * \brief set up a channel to latch the count on an edge of its input pin. The pin's alternate function is set up
+ *        separately.
+ *
+ * \param channel the channel
+ * \param edge the edge or edges to capture on
+ * \param filter ICxF input filter setting, 0 for none
+ * \param interrupt true to call the callback with each capture
+ */
+void Timer::configure_input_capture(TimerChannel channel, TimerCaptureEdge edge, uint8_t filter, bool interrupt) {
+    this->set_channel_mode(channel, capture_select_input | ((filter & input_capture_filter_mask) << input_capture_filter));
+    this->set_channel_interrupt(channel, interrupt);
+
+    uint32_t enable_bits = channel_enable;
+    if ( edge == TimerCaptureEdge::falling ) {
+        enable_bits |= channel_polarity;
+    } else if ( edge == TimerCaptureEdge::both ) {
+        enable_bits |= channel_polarity | channel_complementary_polarity;
+    }
+
+    uint8_t enable_offset = static_cast<uint8_t>(channel) * channel_enable_width;
+    this->timer->CCER = static_cast<uint16_t>((this->timer->CCER & ~(channel_enable_mask << enable_offset)) | (enable_bits << enable_offset));
+}
+
+/**
+ * \brief read the last count captured on a channel
+ *
+ * \param channel the channel
+ * \retval uint32_t the captured count
+ */
+uint32_t Timer::get_capture(TimerChannel channel) {
+    return this->get_compare_register(channel);
+}
+
+/**
+ * \brief copy every capture on a channel into a buffer with DMA, so a burst of edges is timestamped without an
+ *        interrupt for each one. The stream must be the one the channel's request is wired to, and its interrupts
+ *        are left to the caller.
+ *
+ * \param channel an input capture channel
+ * \param stream the DMA stream for the channel's request
+ * \param buffer where to store the captured counts
+ * \param count number of captures to store
+ * \param circular true to keep overwriting the buffer from the start
+ * \param priority stream priority
+ * \retval true if started, false if the buffer is somewhere the DMA can't reach
+ */
+bool Timer::start_capture_dma(TimerChannel channel, DMAStream& stream, volatile uint32_t* buffer, uint16_t count, bool circular,
+                              DMAPriority priority) {
+    if ( !is_dma_accessible(buffer) ) {
+        return false;
+    }
+
+    stream.configure(DMADirection::peripheral_to_memory, DMADataSize::word, true, circular, priority);
+    stream.start(&this->get_compare_register(channel), const_cast<uint32_t*>(buffer), count);
+    this->timer->DIER |= static_cast<uint16_t>(0x01u << (static_cast<uint8_t>(TimerInterruptEnableRegister::capture_compare_1_dma_request_enable)
+                                                          + static_cast<uint8_t>(channel)));
+    return true;
+}
+
+/**
+ * \brief stop copying a channel's captures with DMA
+ *
+ * \param channel the channel
+ * \param stream the DMA stream the captures were going to
+ */
+void Timer::stop_capture_dma(TimerChannel channel, DMAStream& stream) {
+    this->timer->DIER &= static_cast<uint16_t>(~(0x01u << (static_cast<uint8_t>(TimerInterruptEnableRegister::capture_compare_1_dma_request_enable)
+                                                            + static_cast<uint8_t>(channel))));
+    stream.stop();
+}
+
+/**
+ * \brief register the function called from the timer interrupt for each channel that captured or matched
+ *
+ * \param callback the callback, or nullptr for none
+ * \param context passed through to the callback
+ */
+void Timer::set_callback(TimerCallback callback, void* context) {
+    this->callback = callback;
+    this->context = context;
+}
+
+/**
+ * \brief timer interrupt handler, which hands each flagged channel's count to the callback
+ *
+ * \param type the interrupt type, only capture_irq_type is used
+ */
+void Timer::irq_handler(uint8_t type) {
+    PARAMETER_NOT_USED(type);
+    uint32_t flags = this->timer->SR & this->timer->DIER;
+    for ( uint8_t index = 0; index < timer_channel_count; index++ ) {
+        uint32_t flag = 0x01u << (static_cast<uint8_t>(TimerStatusRegister::capture_compare_1) + index);
+        if ( (flags & flag) == 0 ) {
+            continue;
+        }
+
+        /* the flags are cleared by writing zero, so the other flags are written as one to leave them alone. An
+           overcapture means counts were lost, but the latest one is still good */
+        uint32_t overcapture = 0x01u << (static_cast<uint8_t>(TimerStatusRegister::capture_compare_1_overcapture) + index);
+        this->timer->SR = static_cast<uint16_t>(~(flag | overcapture));
+        TimerChannel channel = static_cast<TimerChannel>(index);
+        uint32_t count = this->get_compare_register(channel);
+        if ( this->callback != nullptr ) {
+            this->callback(this->context, channel, count);
+        }
+    }
+}
+
+/**
+ * \brief get the rate the counter is clocked at before the prescaler. The APB timers run at twice the bus clock
+ *        whenever the bus is divided down from the AHB clock.
+ *
+ * \retval uint32_t timer clock in Hz
+ */
+uint32_t Timer::get_timer_clock(void) {
+    uint32_t bus_speed = reset_control_clock.get_clock_speed(this->bus_clock);
+    return (bus_speed == reset_control_clock.get_clock_speed(Clocks::AHB1)) ? bus_speed : bus_speed * 2;
+}
+
+/**
+ * \brief get the capture/compare register of a channel
+ *
+ * \param channel the channel
+ * \retval volatile uint32_t& the register
+ */
+volatile uint32_t& Timer::get_compare_register(TimerChannel channel) {
+    switch ( channel ) {
+        case TimerChannel::channel_2:
+            return this->timer->CCR2;
+
+        case TimerChannel::channel_3:
+            return this->timer->CCR3;
+
+        case TimerChannel::channel_4:
+            return this->timer->CCR4;
+
+        default:
+            return this->timer->CCR1;
+    }
+}
+
+/**
+ * \brief write a channel's bits in the capture/compare mode registers. The channel is disabled first, as the
+ *        direction can only change while it is off.
+ *
+ * \param channel the channel
+ * \param mode_bits the channel's eight mode bits
+ */
+void Timer::set_channel_mode(TimerChannel channel, uint32_t mode_bits) {
+    uint8_t index = static_cast<uint8_t>(channel);
+    this->timer->CCER &= static_cast<uint16_t>(~(channel_enable << (index * channel_enable_width)));
+
+    volatile uint16_t& mode_register = (index < 2) ? this->timer->CCMR1 : this->timer->CCMR2;
+    uint8_t mode_offset = (index % 2) * channel_mode_width;
+    mode_register = static_cast<uint16_t>((mode_register & ~(channel_mode_mask << mode_offset)) | (mode_bits << mode_offset));
+}
+
+/**
+ * \brief enable or disable a channel's capture/compare interrupt
+ *
+ * \param channel the channel
+ * \param enable true to enable
+ */
+void Timer::set_channel_interrupt(TimerChannel channel, bool enable) {
+    uint32_t mask = 0x01u << (static_cast<uint8_t>(TimerInterruptEnableRegister::capture_compare_1_interrupt_enable) + static_cast<uint8_t>(channel));
+    if ( enable ) {
+        this->timer->DIER |= static_cast<uint16_t>(mask);
+    } else {
+        this->timer->DIER &= static_cast<uint16_t>(~mask);
+    }
+}
+
+/**
+ * \brief update fields in control register 1
+ *
+ * \param value the fields to write
+ */
+void Timer::modify_control_register(RegisterValue<TimerControlRegister1> value) {
+    value.modify(this->timer->CR1);
+}
+
+};  // namespace HAL
@@ -0,0 +1,221 @@
+/*! \file hal_timer.h
+*
+*  \brief hal_timer module functions and variables declarations.
+*
+*
+*  \author Graham Riches
+*/
+
+#pragma once
+
+/********************************** Includes *******************************************/
+#include "common.h"
+#include "hal_dma.h"
+#include "hal_interrupt.h"
+#include "hal_rcc.h"
+#include "hal_register.h"
+#include "stm32f4xx.h"
+
+namespace HAL
+{
+/*********************************** Consts ********************************************/
+constexpr uint8_t timer_channel_count = 4;
+
+/************************************ Types ********************************************/
+/**
+ * \brief bit offsets for timer control register 1
+ */
+enum class TimerControlRegister1 : unsigned {
+    counter_enable = 0,
+    update_disable = 1,
+    update_request_source = 2,
+    one_pulse_mode = 3,
+    direction = 4,
+    center_aligned_mode = 5,
+    auto_reload_preload = 7,
+    clock_division = 8
+};
+
+/**
+ * \brief the center aligned mode and clock division are the only control register 1 fields wider than a bit
+ */
+constexpr uint8_t get_field_width(TimerControlRegister1 field) {
+    return ((field == TimerControlRegister1::center_aligned_mode) || (field == TimerControlRegister1::clock_division)) ? 2 : 1;
+}
+
+/**
+ * \brief bit offsets for timer control register 2
+ */
+enum class TimerControlRegister2 : unsigned {
+    capture_compare_dma_select = 3,
+    master_mode = 4,
+    ti1_selection = 7
+};
+
+/**
+ * \brief the master mode is the only control register 2 field wider than a bit
+ */
+constexpr uint8_t get_field_width(TimerControlRegister2 field) {
+    return (field == TimerControlRegister2::master_mode) ? 3 : 1;
+}
+
+/**
+ * \brief trigger outputs to other timers and the ADCs, as written to the MMS field
+ */
+enum class TimerMasterMode : unsigned {
+    reset = 0b000,
+    enable = 0b001,
+    update = 0b010,          //!< one trigger per period
+    compare_pulse = 0b011,
+    compare_1 = 0b100,
+    compare_2 = 0b101,
+    compare_3 = 0b110,
+    compare_4 = 0b111,
+};
+
+/**
+ * \brief bit offsets for the timer DMA and interrupt enable register
+ */
+enum class TimerInterruptEnableRegister : unsigned {
+    update_interrupt_enable = 0,
+    capture_compare_1_interrupt_enable = 1,
+    capture_compare_2_interrupt_enable = 2,
+    capture_compare_3_interrupt_enable = 3,
+    capture_compare_4_interrupt_enable = 4,
+    trigger_interrupt_enable = 6,
+    update_dma_request_enable = 8,
+    capture_compare_1_dma_request_enable = 9,
+    capture_compare_2_dma_request_enable = 10,
+    capture_compare_3_dma_request_enable = 11,
+    capture_compare_4_dma_request_enable = 12,
+    trigger_dma_request_enable = 14
+};
+
+/**
+ * \brief bit offsets for the timer status register
+ */
+enum class TimerStatusRegister : unsigned {
+    update = 0,
+    capture_compare_1 = 1,
+    capture_compare_2 = 2,
+    capture_compare_3 = 3,
+    capture_compare_4 = 4,
+    trigger = 6,
+    capture_compare_1_overcapture = 9,
+    capture_compare_2_overcapture = 10,
+    capture_compare_3_overcapture = 11,
+    capture_compare_4_overcapture = 12
+};
+
+/**
+ * \brief capture/compare channels
+ */
+enum class TimerChannel : unsigned {
+    channel_1 = 0,
+    channel_2,
+    channel_3,
+    channel_4,
+};
+
+/**
+ * \brief output compare modes, as written to the OCxM field
+ */
+enum class TimerOutputCompareMode : unsigned {
+    frozen = 0b000,             //!< the compare only raises the interrupt or DMA request, the pin is left alone
+    active_on_match = 0b001,
+    inactive_on_match = 0b010,
+    toggle = 0b011,
+    force_inactive = 0b100,
+    force_active = 0b101,
+    pwm_1 = 0b110,
+    pwm_2 = 0b111,
+};
+
+/**
+ * \brief input capture edges
+ */
+enum class TimerCaptureEdge : unsigned {
+    rising = 0,
+    falling,
+    both,
+};
+
+/**
+ * \brief callback for a capture/compare interrupt
+ *
+ * \param context the context registered with the callback
+ * \param channel the channel that captured or matched
+ * \param count the captured count, or the compare value for an output compare channel
+ */
+using TimerCallback = void (*)(void* context, TimerChannel channel, uint32_t count);
+
+/**
+ * \brief driver for the 32-bit general purpose timers, TIM2 and TIM5. The counter always runs up over the full 32
+ *        bits from a prescaled bus clock, so one timer serves as a free running timestamp for everything else it
+ *        does. A 1 MHz tick wraps every 71 minutes, and differences between counts stay correct across the wrap.
+ *        Each channel is either an output compare or an input capture. Alternatively the counter can wrap at a
+ *        shorter period, with the update driving the trigger output to pace the ADCs or DMA.
+ * \note the prescaler is worked out from the current bus clock, so call update_tick_frequency after changing it
+ */
+class Timer : public InterruptPeripheral {
+  public:
+    static constexpr uint8_t capture_irq_type = 0;  //!< irq type to register the timer interrupt with
+    static constexpr uint32_t microsecond_frequency = 1000000;
+
+    Timer(TIM_TypeDef* timer, Clocks bus_clock);
+
+    void start(uint32_t tick_frequency = microsecond_frequency);
+    void stop(void);
+    void update_tick_frequency(void);
+    void set_period(uint32_t ticks);
+    void set_trigger_output(TimerMasterMode mode);
+
+    /**
+     * \brief read the counter
+     *
+     * \retval uint32_t count in ticks
+     */
+    RAM_FUNCTION uint32_t get_count(void) const {
+        return this->timer->CNT;
+    }
+
+    /**
+     * \brief get the rate the counter runs at
+     *
+     * \retval uint32_t ticks per second
+     */
+    uint32_t get_tick_frequency(void) const {
+        return this->tick_frequency;
+    }
+
+    void configure_output_compare(TimerChannel channel, TimerOutputCompareMode mode, uint32_t compare, bool interrupt);
+    void set_compare(TimerChannel channel, uint32_t compare);
+    void configure_input_capture(TimerChannel channel, TimerCaptureEdge edge, uint8_t filter, bool interrupt);
+    uint32_t get_capture(TimerChannel channel);
+    bool start_capture_dma(TimerChannel channel, DMAStream& stream, volatile uint32_t* buffer, uint16_t count, bool circular,
+                           DMAPriority priority);
+    void stop_capture_dma(TimerChannel channel, DMAStream& stream);
+    void set_callback(TimerCallback callback, void* context);
+    RAM_FUNCTION void irq_handler(uint8_t type) override;
+
+  private:
+    uint32_t get_timer_clock(void);
+    volatile uint32_t& get_compare_register(TimerChannel channel);
+    void set_channel_mode(TimerChannel channel, uint32_t mode_bits);
+    void set_channel_interrupt(TimerChannel channel, bool enable);
+    void modify_control_register(RegisterValue<TimerControlRegister1> value);
+
+    TIM_TypeDef* timer;
+    Clocks bus_clock;
+    uint32_t tick_frequency;
+    TimerCallback callback;
+    void* context;
+};
+
+/*********************************** Macros ********************************************/
+
+/******************************* Global Variables **************************************/
+
+/****************************** Functions Prototype ************************************/
+
+};  // namespace HAL
@@ -55,11 +55,16 @@ uint8_t USARTBase::read_status_register(USARTStatusRegister reg) {
  * \param value value register value to set
  */
 void USARTBase::write_control_register(USARTControlRegister1 reg, uint8_t value) {
-    /* clear the register */
-    this->peripheral->CR1 &= ~static_cast<uint16_t>((static_cast<uint8_t>(0x01) << static_cast<uint8_t>(reg)));
+    this->modify_control_register(field(reg, value));
+}
 
-    /* write the value */
-    this->peripheral->CR1 |= static_cast<uint16_t>(((value & 0x01) << static_cast<uint8_t>(reg)));
+/**
+ * \brief write one or more fields of CR1 with a single read-modify-write
+ * 
+ * \param value the merged field values
+ */
+void USARTBase::modify_control_register(RegisterValue<USARTControlRegister1> value) {
+    value.modify(this->peripheral->CR1);
 }
 
 /**
@@ -69,11 +74,16 @@ void USARTBase::write_control_register(USARTControlRegister1 reg, uint8_t value)
  * \param value value
  */
 void USARTBase::write_control_register(USARTControlRegister2 reg, uint8_t value) {
-    /* clear the register */
-    this->peripheral->CR2 &= ~static_cast<uint16_t>((static_cast<uint8_t>(0x01) << static_cast<uint8_t>(reg)));
+    this->modify_control_register(field(reg, value));
+}
 
-    /* write the value */
-    this->peripheral->CR2 |= static_cast<uint16_t>(((value & 0x01) << static_cast<uint8_t>(reg)));
+/**
+ * \brief write one or more fields of CR2 with a single read-modify-write
+ * 
+ * \param value the merged field values
+ */
+void USARTBase::modify_control_register(RegisterValue<USARTControlRegister2> value) {
+    value.modify(this->peripheral->CR2);
 }
 
 /**
@@ -83,11 +93,16 @@ void USARTBase::write_control_register(USARTControlRegister2 reg, uint8_t value)
  * \param value value
  */
 void USARTBase::write_control_register(USARTControlRegister3 reg, uint8_t value) {
-    /* clear the register */
-    this->peripheral->CR3 &= ~static_cast<uint16_t>((static_cast<uint8_t>(0x01) << static_cast<uint8_t>(reg)));
+    this->modify_control_register(field(reg, value));
+}
 
-    /* write the value */
-    this->peripheral->CR3 |= static_cast<uint16_t>(((value & 0x01) << static_cast<uint8_t>(reg)));
+/**
+ * \brief write one or more fields of CR3 with a single read-modify-write
+ * 
+ * \param value the merged field values
+ */
+void USARTBase::modify_control_register(RegisterValue<USARTControlRegister3> value) {
+    value.modify(this->peripheral->CR3);
 }
 
 /**
@@ -182,63 +197,209 @@ void USARTInterrupt::irq_handler(uint8_t type) {
         }
 
         /* if there is no more data to send, disable the interrupt */
-        if ( this->tx_buffer.is_empty() ) {
+        size_t remaining = this->tx_buffer.size();
+        if ( remaining == 0 ) {
             this->write_control_register(USARTControlRegister1::transmit_interrupt_enable, 0x00);
         }
+
+        /* waking a blocked writer on every byte would cost more than the send, so only wake it at half and empty */
+        if ( (remaining == 0) || (remaining == (buffer_size / 2)) ) {
+            this->on_transmit_space();
+        }
     }
 }
 
 /**
- * \brief send data over a interrupt based usart
+ * \brief send data over a interrupt based usart without blocking
  * 
  * \param data pointer to the data to send
  * \param size amount of data
+ * \retval size_t number of bytes accepted, anything past what fits in the tx buffer is not sent
  */
-void USARTInterrupt::send(uint8_t* data, uint16_t size) {
-    /* put the data on the buffer */
-    while ( size-- ) {
-        this->tx_buffer.push(*data++);
-        if ( this->tx_buffer.is_full() ) {
-            break;
-        }
-    }
+size_t USARTInterrupt::send(const uint8_t* data, size_t size) {
+    /* put as much of the data on the buffer as will fit */
+    size_t accepted = this->tx_buffer.push_bulk(data, size);
 
-    /* enable the tx interrupt */
-    this->write_control_register(USARTControlRegister1::transmit_interrupt_enable, 0x01);
+    /* start sending the data */
+    this->start_transmit();
+    return accepted;
 }
 
 /**
  * \brief overloaded send for string based messages
  * 
  * \param data string data
+ * \retval size_t number of characters accepted
  */
-void USARTInterrupt::send(const char* data) {
+size_t USARTInterrupt::send(const char* data) {
     //!< TODO: possible unsafe strlen here?
-    uint16_t size = strlen(data);
+    return this->send(reinterpret_cast<const uint8_t*>(data), strlen(data));
+}
+
+/**
+ * \brief overloaded send for a single character
+ * 
+ * \param data the character to send
+ * \retval size_t 1 if the character was accepted, 0 if the tx buffer is full
+ */
+size_t USARTInterrupt::send(const char data) {
+    size_t accepted = this->tx_buffer.push(static_cast<uint8_t>(data)) ? 1 : 0;
+
+    /* start sending the data */
+    this->start_transmit();
+    return accepted;
+}
 
-    for ( uint16_t i = 0; i < size; i++ ) {
-        uint8_t dataByte = (uint8_t)data[i];
-        this->tx_buffer.push(dataByte);
+/**
+ * \brief get received data out of the rx buffer without blocking
+ *
+ * \param data the destination
+ * \param size max number of bytes to get
+ * \retval size_t number of bytes actually got
+ */
+size_t USARTInterrupt::receive(uint8_t* data, size_t size) {
+    return this->rx_buffer.pop_bulk(data, size);
+}
 
-        if ( this->tx_buffer.is_full() ) {
+/**
+ * \brief start draining the tx buffer by enabling the tx interrupt
+ */
+void USARTInterrupt::start_transmit(void) {
+    this->write_control_register(USARTControlRegister1::transmit_interrupt_enable, 0x01);
+}
+
+/**
+ * \brief configure the tx stream for the usart and switch the usart transmitter over to DMA requests. The
+ *        stream's clock must already be enabled.
+ *
+ * \param priority stream priority
+ */
+void USARTDMA::configure_dma_transmit(DMAPriority priority) {
+    this->tx_stream.configure(DMADirection::memory_to_peripheral, DMADataSize::byte, true, false, priority);
+    this->tx_stream.enable_interrupt(DMAStreamControlRegister::half_transfer_interrupt_enable, true);
+    this->tx_stream.enable_interrupt(DMAStreamControlRegister::transfer_complete_interrupt_enable, true);
+    this->tx_stream.enable_interrupt(DMAStreamControlRegister::transfer_error_interrupt_enable, true);
+    this->write_control_register(USARTControlRegister3::dma_transmit_enable, 0x01);
+}
+
+/**
+ * \brief start the rx stream writing into its circular buffer and switch the usart receiver over to DMA
+ *        requests and idle-line interrupts. The stream's clock must already be enabled.
+ *
+ * \param priority stream priority
+ */
+void USARTDMA::configure_dma_receive(DMAPriority priority) {
+    this->rx_stream.configure(DMADirection::peripheral_to_memory, DMADataSize::byte, true, true, priority);
+    this->rx_stream.enable_interrupt(DMAStreamControlRegister::half_transfer_interrupt_enable, true);
+    this->rx_stream.enable_interrupt(DMAStreamControlRegister::transfer_complete_interrupt_enable, true);
+    this->receive_position = 0;
+    this->rx_stream.start(&this->peripheral->DR, this->dma_receive_buffer, dma_receive_buffer_size);
+
+    this->modify_control_register(field(USARTControlRegister1::receive_interrupt_enable, 0x00)
+                                  | field(USARTControlRegister1::idle_interrupt_enable, 0x01));
+    this->write_control_register(USARTControlRegister3::dma_receive_enable, 0x01);
+}
+
+/**
+ * \brief handle the usart and stream interrupts
+ *
+ * \param type usart_irq_type, tx_stream_irq_type or rx_stream_irq_type
+ */
+void USARTDMA::irq_handler(uint8_t type) {
+    switch ( type ) {
+        case tx_stream_irq_type: {
+            /* clear the events, the stream's state is read back directly from the hardware */
+            this->tx_stream.clear_flag(DMAInterruptFlag::half_transfer);
+            this->tx_stream.clear_flag(DMAInterruptFlag::transfer_complete);
+            this->tx_stream.clear_flag(DMAInterruptFlag::transfer_error);
+
+            this->release_transmitted();
+            if ( !this->tx_stream.is_enabled() ) {
+                this->start_next_transfer();
+            }
+            break;
+        }
+
+        case rx_stream_irq_type: {
+            this->rx_stream.clear_flag(DMAInterruptFlag::half_transfer);
+            this->rx_stream.clear_flag(DMAInterruptFlag::transfer_complete);
+            if ( this->drain_received() > 0 ) {
+                this->on_receive(false);
+            }
+            break;
+        }
+
+        default: {
+            bool idle_detected = this->read_status_register(USARTStatusRegister::idle_detected);
+            bool idle_interrupt_enabled = this->read_control_register(USARTControlRegister1::idle_interrupt_enable);
+            if ( idle_detected && idle_interrupt_enabled ) {
+                /* the idle flag is cleared by reading the status register followed by the data register */
+                static_cast<void>(this->peripheral->DR);
+                this->drain_received();
+                this->on_receive(true);
+            }
+            USARTInterrupt::irq_handler(type);
             break;
         }
     }
+}
 
-    /* enable the tx interrupt */
-    this->write_control_register(USARTControlRegister1::transmit_interrupt_enable, 0x01);
+/**
+ * \brief pend the tx stream interrupt, which starts a transfer if the stream is idle
+ */
+void USARTDMA::start_transmit(void) {
+    NVIC_SetPendingIRQ(this->tx_stream_irq);
 }
 
 /**
- * \brief overloaded send for a single character
- * 
- * \param data the character to send
+ * \brief hand the bytes the stream has already read back to the tx buffer. Doing this at the half way point
+ *        lets the application refill the buffer while the rest of a long transfer is still going out.
+ * \note a transfer error disables the stream, so any bytes it had not read yet are sent again by the next transfer
  */
-void USARTInterrupt::send(const char data) {
-    this->tx_buffer.push(static_cast<uint8_t>(data));
+void USARTDMA::release_transmitted(void) {
+    uint16_t transmitted = this->transfer_size - this->tx_stream.get_remaining_count();
+    if ( transmitted != this->released_count ) {
+        this->tx_buffer.commit(transmitted - this->released_count);
+        this->released_count = transmitted;
+        this->on_transmit_space();
+    }
+}
 
-    /* enable the tx interrupt */
-    this->write_control_register(USARTControlRegister1::transmit_interrupt_enable, 0x01);
+/**
+ * \brief move everything the rx stream has written since the last call into the rx buffer. Anything that won't
+ *        fit in the rx buffer is dropped.
+ *
+ * \retval size_t number of bytes the stream had written
+ */
+size_t USARTDMA::drain_received(void) {
+    /* the count reloads as soon as the stream wraps, so the write position is always inside the buffer */
+    uint16_t write_position = dma_receive_buffer_size - this->rx_stream.get_remaining_count();
+    if ( write_position == dma_receive_buffer_size ) {
+        write_position = 0;
+    }
+
+    size_t count = 0;
+    if ( write_position < this->receive_position ) {
+        count = dma_receive_buffer_size - this->receive_position;
+        this->rx_buffer.push_bulk(&this->dma_receive_buffer[this->receive_position], count);
+        this->receive_position = 0;
+    }
+    this->rx_buffer.push_bulk(&this->dma_receive_buffer[this->receive_position], write_position - this->receive_position);
+    count += write_position - this->receive_position;
+    this->receive_position = write_position;
+    return count;
+}
+
+/**
+ * \brief start a transfer of the next contiguous block of the tx buffer, if there is one
+ */
+void USARTDMA::start_next_transfer(void) {
+    auto block = this->tx_buffer.peek_contiguous();
+    this->transfer_size = static_cast<uint16_t>(block.size);
+    this->released_count = 0;
+    if ( this->transfer_size > 0 ) {
+        this->tx_stream.start(&this->peripheral->DR, block.data, this->transfer_size);
+    }
 }
 
 };  // namespace HAL
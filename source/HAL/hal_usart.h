@@ -10,10 +10,12 @@
 
 /********************************** Includes *******************************************/
 #include "hal_bitwise_operators.h"
+#include "hal_dma.h"
 #include "hal_gpio.h"
 #include "hal_interrupt.h"
 #include "hal_rcc.h"
-#include "ring_buffer.h"
+#include "hal_register.h"
+#include "spsc_ring_buffer.h"
 #include "stm32f4xx.h"
 #include <stdint.h>
 
@@ -93,6 +95,13 @@ enum class USARTControlRegister3 : unsigned {
     onebit_mode_enable = 11,
 };
 
+/**
+ * \brief USART control register 2 fields wider than a bit
+ */
+constexpr uint8_t get_field_width(USARTControlRegister2 field) {
+    return (field == USARTControlRegister2::address) ? 4 : (field == USARTControlRegister2::stop_bits) ? 2 : 1;
+}
+
 /**
  * \brief base class for uart peripherals
  */
@@ -111,6 +120,9 @@ class USARTBase {
     void write_control_register(USARTControlRegister1 reg, uint8_t value);
     void write_control_register(USARTControlRegister2 reg, uint8_t value);
     void write_control_register(USARTControlRegister3 reg, uint8_t value);
+    void modify_control_register(RegisterValue<USARTControlRegister1> value);
+    void modify_control_register(RegisterValue<USARTControlRegister2> value);
+    void modify_control_register(RegisterValue<USARTControlRegister3> value);
     uint8_t read_control_register(USARTControlRegister1 reg);
     uint8_t read_control_register(USARTControlRegister2 reg);
     uint8_t read_control_register(USARTControlRegister3 reg);
@@ -122,20 +134,89 @@ class USARTBase {
  *        to create an interrupt driven object
  */
 class USARTInterrupt : protected USARTBase, public HAL::InterruptPeripheral {
+  public:
+    static constexpr size_t buffer_size = 256;  //!< capacity of each of the tx and rx buffers
+
   protected:
-    RingBuffer<uint8_t> tx_buffer;
-    RingBuffer<uint8_t> rx_buffer;
+    SPSCRingBuffer<uint8_t, buffer_size> tx_buffer;  //!< written by the application, drained by the ISR
+    SPSCRingBuffer<uint8_t, buffer_size> rx_buffer;  //!< written by the ISR, drained by the application
 
   public:
-    USARTInterrupt(USART_TypeDef* usart, size_t tx_size, size_t rx_size)
+    explicit USARTInterrupt(USART_TypeDef* usart)
         : USARTBase(usart)
-        , tx_buffer(tx_size)
-        , rx_buffer(rx_size) { }
+        , tx_buffer()
+        , rx_buffer() { }
 
     void irq_handler(uint8_t type);
-    void send(uint8_t* data, uint16_t size);
-    void send(const char* data);
-    void send(const char data);
+    size_t send(const uint8_t* data, size_t size);
+    size_t send(const char* data);
+    size_t send(const char data);
+    size_t receive(uint8_t* data, size_t size);
+
+  protected:
+    virtual void start_transmit(void);
+
+    /**
+     * \brief called from the tx interrupts after sent data has been released from the tx buffer, so a writer
+     *        waiting for space can retry
+     */
+    virtual void on_transmit_space(void) { }
+};
+
+/**
+ * \brief usart that transmits and receives with DMA. Each transfer hands the tx stream the largest contiguous
+ *        block of the tx buffer, so a whole message costs one interrupt at the half way point and one when it
+ *        completes instead of one per byte. The rx stream runs continuously in circular mode, and its half and
+ *        full interrupts plus the usart idle-line interrupt move whatever has arrived into the rx buffer.
+ * \note transfers are only ever started from the tx stream interrupt, which keeps that interrupt the sole
+ *       consumer of the tx buffer. Sending just pends the interrupt. The usart and rx stream interrupts both
+ *       produce into the rx buffer, so they must be registered at the same priority.
+ */
+class USARTDMA : public USARTInterrupt {
+  public:
+    static constexpr uint8_t usart_irq_type = 0;      //!< irq type to register the usart interrupt with
+    static constexpr uint8_t tx_stream_irq_type = 1;  //!< irq type to register the tx stream interrupt with
+    static constexpr uint8_t rx_stream_irq_type = 2;  //!< irq type to register the rx stream interrupt with
+    static constexpr uint16_t dma_receive_buffer_size = 128;  //!< the rx stream's circular buffer
+
+    USARTDMA(USART_TypeDef* usart, DMAStream tx_stream, IRQn tx_stream_irq, DMAStream rx_stream)
+        : USARTInterrupt(usart)
+        , tx_stream(tx_stream)
+        , tx_stream_irq(tx_stream_irq)
+        , transfer_size(0)
+        , released_count(0)
+        , rx_stream(rx_stream)
+        , dma_receive_buffer()
+        , receive_position(0) { }
+
+    RAM_FUNCTION void irq_handler(uint8_t type) override;
+
+  protected:
+    void configure_dma_transmit(DMAPriority priority);
+    void configure_dma_receive(DMAPriority priority);
+    void start_transmit(void) override;
+
+    /**
+     * \brief called from the receive interrupts after new data has been moved into the rx buffer
+     *
+     * \param end_of_frame true if the line went idle, which marks the end of a burst of data
+     */
+    virtual void on_receive(bool end_of_frame) {
+        PARAMETER_NOT_USED(end_of_frame);
+    }
+
+  private:
+    void release_transmitted(void);
+    void start_next_transfer(void);
+    size_t drain_received(void);
+
+    DMAStream tx_stream;
+    IRQn tx_stream_irq;
+    uint16_t transfer_size;   //!< size of the transfer in progress
+    uint16_t released_count;  //!< bytes of the transfer in progress already handed back to the tx buffer
+    DMAStream rx_stream;
+    uint8_t dma_receive_buffer[dma_receive_buffer_size];
+    uint16_t receive_position;  //!< next byte of the circular buffer to move into the rx buffer
 };
 
 /*********************************** Macros ********************************************/
@@ -0,0 +1,25 @@
+/*! \file buffer_span.h
+*
+*  \brief view of a linear region inside a ring buffer
+*
+*
+*  \author Graham Riches
+*/
+
+#pragma once
+
+/********************************** Includes *******************************************/
+#include <cstddef>
+
+/************************************ Types ********************************************/
+/**
+ * \brief pointer and length of a contiguous block of ring buffer storage. This is what gets handed to
+ *        memcpy or a DMA stream so a whole chunk can move without per-element calls or wraparound checks.
+ *
+ * \tparam T element type
+ */
+template <typename T>
+struct BufferSpan {
+    T* data;
+    size_t size;
+};
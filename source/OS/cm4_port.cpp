@@ -10,13 +10,46 @@
  */
 
 /********************************** Includes *******************************************/
+#include "cm4_port.h"
 #include "hal_interrupt.h"
 #include "stm32f4xx.h"
 #include "os.h"
+#include <cstdint>
 
 namespace os
 {
 
+/********************************** Constants *******************************************/
+//!< don't bother reprogramming the systick for sleeps shorter than this
+constexpr uint32_t tickless_idle_minimum_ticks = 2;
+
+//!< MPU region used for the stack guard. The highest numbered region takes priority where regions overlap
+constexpr uint32_t stack_guard_region = 7;
+
+//!< MPU regions that give unprivileged threads access to memory and peripherals when the MPU is enabled
+constexpr uint32_t unprivileged_memory_region = 0;
+constexpr uint32_t unprivileged_peripheral_region = 1;
+
+//!< CONTROL register bit that selects the process stack in thread mode
+constexpr uint32_t control_process_stack = 0x02;
+
+//!< flag or'ed into the saved interrupt mask when a critical section had to raise the thread's privilege
+constexpr uint32_t critical_raised_privilege = 0x80000000;
+
+//!< offset of the stacked program counter in an exception frame
+constexpr uint32_t exception_frame_pc = 6;
+
+static_assert((OS_KERNEL_INTERRUPT_CEILING > 0) && (OS_KERNEL_INTERRUPT_CEILING < (1 << __NVIC_PRIO_BITS)),
+              "a ceiling of 0 would leave BASEPRI disabled, and the kernel itself runs at the lowest priority");
+static_assert(__NVIC_PRIO_BITS == 4, "OS_KERNEL_BASEPRI assumes four implemented priority bits");
+
+/********************************** Local Variables *******************************************/
+static deep_sleep_function deep_sleep_handler = nullptr;
+
+/********************************** Local Function Declarations *******************************************/
+static bool is_unprivileged_thread(void);
+static void drop_privilege(void);
+
 /********************************** Function Definitions *******************************************/
 /**
  * \brief Set the PendSV interrupt flag in the NVIC to trigger a context switch
@@ -35,4 +68,287 @@ bool is_context_switch_pending(void) {
     return static_cast<bool>(SCB->ICSR & SCB_ICSR_PENDSVSET_Msk);
 }
 
+/**
+ * \brief check if the caller is a thread running under the kernel. Threads run on the process stack, so this
+ *        is false for interrupt handlers and for the startup code that runs before the kernel is entered.
+ *
+ * \retval true/false
+ */
+bool is_thread_context(void) {
+    return (__get_IPSR() == 0) && (__get_CONTROL() & control_process_stack);
+}
+
+/**
+ * \brief save BASEPRI and raise it to the kernel ceiling. BASEPRI_MAX never lowers the mask, so the
+ *        critical section nests safely inside interrupt handlers and other critical sections.
+ * 
+ * \retval uint32_t the previous BASEPRI value
+ */
+uint32_t enter_critical_from_isr(void) {
+    uint32_t raised = 0;
+    if ( is_unprivileged_thread() ) {
+        os_svc_raise_privilege();
+        raised = critical_raised_privilege;
+    }
+
+    uint32_t interrupt_mask = __get_BASEPRI();
+    __set_BASEPRI_MAX(OS_KERNEL_BASEPRI);
+    __ISB();
+    return interrupt_mask | raised;
+}
+
+/**
+ * \brief restore the BASEPRI saved on entry to the critical section, then drop a thread back to unprivileged if
+ *        entering raised its privilege. The drop has to come after the BASEPRI write, which does nothing once
+ *        unprivileged. If the thread is switched out in between, the PendSV handler saves it as privileged and it
+ *        drops back when it next runs.
+ * 
+ * \param interrupt_mask the saved BASEPRI value
+ */
+void exit_critical_from_isr(uint32_t interrupt_mask) {
+    __set_BASEPRI(interrupt_mask & ~critical_raised_privilege);
+    if ( interrupt_mask & critical_raised_privilege ) {
+        drop_privilege();
+    }
+}
+
+/**
+ * \brief check if the caller is a thread running unprivileged
+ * 
+ * \retval true/false
+ */
+static bool is_unprivileged_thread(void) {
+#ifdef OS_UNPRIVILEGED_THREADS
+    return (__get_IPSR() == 0) && (__get_CONTROL() & thread::control_unprivileged);
+#else
+    return false;
+#endif
+}
+
+/**
+ * \brief drop thread mode back to unprivileged
+ */
+static void drop_privilege(void) {
+    __set_CONTROL(__get_CONTROL() | thread::control_unprivileged);
+    __ISB();
+}
+
+/**
+ * \brief run an SVC call. Raising privilege is handled here, the scheduler calls run in the scheduler.
+ *        SVC shares the kernel interrupt priority with the SysTick and PendSV, so none of them can preempt
+ *        each other.
+ * 
+ * \param frame the caller's exception frame
+ */
+__attribute__((used)) void os_svc_handler(uint32_t* frame) {
+    /* the SVC number is the low byte of the 16-bit SVC instruction just before the return address */
+    const uint8_t number = reinterpret_cast<const uint8_t*>(frame[exception_frame_pc])[-2];
+    if ( number == OS_SVC_RAISE_PRIVILEGE ) {
+        __set_CONTROL(__get_CONTROL() & ~thread::control_unprivileged);
+        __ISB();
+        return;
+    }
+    frame[0] = scheduler::handle_syscall(number, frame[0], frame[1]);
+}
+
+// clang-format off
+__attribute__((naked)) void os_svc_raise_privilege(void) {
+    __asm("SVC        #" OS_STRINGIFY(OS_SVC_RAISE_PRIVILEGE) " \n"
+          "BX         LR                       \n");
+}
+
+__attribute__((naked)) void os_svc_sleep(uint32_t) {
+    __asm("SVC        #" OS_STRINGIFY(OS_SVC_SLEEP) " \n"
+          "BX         LR                       \n");
+}
+
+__attribute__((naked)) uint32_t os_svc_lock(uint32_t) {
+    __asm("SVC        #" OS_STRINGIFY(OS_SVC_LOCK) " \n"
+          "BX         LR                       \n");
+}
+
+__attribute__((naked)) void os_svc_unlock(uint32_t) {
+    __asm("SVC        #" OS_STRINGIFY(OS_SVC_UNLOCK) " \n"
+          "BX         LR                       \n");
+}
+
+__attribute__((naked)) void os_svc_set_time_slice(uint32_t, uint32_t) {
+    __asm("SVC        #" OS_STRINGIFY(OS_SVC_SET_TIME_SLICE) " \n"
+          "BX         LR                       \n");
+}
+
+__attribute__((naked)) void os_svc_exit(void) {
+    __asm("SVC        #" OS_STRINGIFY(OS_SVC_EXIT) " \n"
+          "BX         LR                       \n");
+}
+// clang-format on
+
+/**
+ * \brief SysTick counts down from LOAD, so the counts since the last reload are LOAD - VAL. If the counter
+ *        has reloaded but the tick hasn't been handled yet (the caller is in a critical section or a 
+ *        higher priority interrupt) the pending tick is added on, so time never appears to go backwards.
+ * 
+ * \retval uint32_t elapsed counts
+ */
+uint32_t get_tick_counts(void) {
+    const uint32_t reload = SysTick->LOAD;
+    uint32_t elapsed = reload - SysTick->VAL;
+    if ( SCB->ICSR & SCB_ICSR_PENDSTSET_Msk ) {
+        /* read the counter again in case the reload happened just after the first read */
+        elapsed = (reload - SysTick->VAL) + reload + 1;
+    }
+    return elapsed;
+}
+
+/**
+ * \brief get the SysTick reload period
+ * 
+ * \retval uint32_t counts per tick
+ */
+uint32_t get_tick_period_counts(void) {
+    return SysTick->LOAD + 1;
+}
+
+/**
+ * \brief set the SysTick reload period, scaling the count left in the current tick to match
+ * 
+ * \param counts counts per tick
+ */
+void set_tick_period_counts(uint32_t counts) {
+    critical_section critical;
+    const uint32_t tick_period = SysTick->LOAD + 1;
+
+    /* the same reload trick as the tickless idle: finish this tick out on a shortened reload, then switch to the
+       new period at the next reload */
+    SysTick->CTRL &= ~SysTick_CTRL_ENABLE_Msk;
+    uint32_t remaining = static_cast<uint32_t>((static_cast<uint64_t>(SysTick->VAL) * counts) / tick_period);
+    SysTick->LOAD = (remaining > 0) ? remaining : 1;
+    SysTick->VAL = 0;
+    SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+    SysTick->LOAD = counts - 1;
+}
+
+/**
+ * \brief stretch the systick reload to cover the whole idle period, then sleep until either it expires
+ *        or another interrupt wakes the core. The number of whole tick periods that elapsed is 
+ *        added to the system clock and the systick is restored to its normal period.
+ * 
+ * \param idle_ticks number of ticks until the next thread needs to run
+ */
+void suppress_ticks_and_sleep(uint32_t idle_ticks) {
+    const uint32_t tick_period = SysTick->LOAD + 1;
+    const uint32_t max_idle_ticks = SysTick_LOAD_RELOAD_Msk / tick_period;
+
+    if ( idle_ticks > max_idle_ticks ) {
+        idle_ticks = max_idle_ticks;
+    }
+
+    /* a pending tick or context switch means there is work to do, and short sleeps aren't worth the drift */
+    if ( (idle_ticks < tickless_idle_minimum_ticks) || (SCB->ICSR & (SCB_ICSR_PENDSTSET_Msk | SCB_ICSR_PENDSVSET_Msk)) ) {
+        return;
+    }
+
+    /* stop the tick and load a reload value covering the rest of this tick plus the idle period */
+    SysTick->CTRL &= ~SysTick_CTRL_ENABLE_Msk;
+    const uint32_t reload = SysTick->VAL + (tick_period * (idle_ticks - 1));
+    SysTick->LOAD = reload;
+    SysTick->VAL = 0;
+    SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+
+    /* a pending interrupt wakes the core from WFI even with PRIMASK set, it is serviced once unmasked */
+    __DSB();
+    __WFI();
+    __ISB();
+
+    /* stop the tick again and work out how long we actually slept. Note: reading CTRL clears COUNTFLAG */
+    SysTick->CTRL &= ~SysTick_CTRL_ENABLE_Msk;
+    const bool tick_expired = static_cast<bool>(SysTick->CTRL & SysTick_CTRL_COUNTFLAG_Msk);
+    uint32_t elapsed_ticks;
+
+    if ( tick_expired ) {
+        /* the full period elapsed and the tick interrupt is pending, which will account for the final tick.
+           Count out whatever is left of the current tick after the counter reloaded */
+        uint32_t remaining = (tick_period - 1) - (reload - SysTick->VAL);
+        SysTick->LOAD = (remaining > tick_period) ? (tick_period - 1) : remaining;
+        elapsed_ticks = idle_ticks - 1;
+    } else {
+        /* woken early by another interrupt: count the whole ticks and finish out the partial one */
+        uint32_t elapsed_cycles = (idle_ticks * tick_period) - SysTick->VAL;
+        elapsed_ticks = elapsed_cycles / tick_period;
+        SysTick->LOAD = ((elapsed_ticks + 1) * tick_period) - elapsed_cycles;
+    }
+
+    /* restart the tick, then restore the regular period which takes effect on the next reload */
+    SysTick->VAL = 0;
+    SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+    SysTick->LOAD = tick_period - 1;
+
+    system_clock::update_sytem_ticks(elapsed_ticks);
+}
+
+/**
+ * \brief register the deep sleep handler
+ * 
+ * \param handler the deep sleep handler
+ */
+void set_deep_sleep_handler(deep_sleep_function handler) {
+    deep_sleep_handler = handler;
+}
+
+/**
+ * \brief hand the core to the deep sleep handler unless a tick or context switch is already pending
+ * 
+ * \retval true if the core slept
+ */
+bool deep_sleep(void) {
+    if ( (deep_sleep_handler == nullptr) || (SCB->ICSR & (SCB_ICSR_PENDSTSET_Msk | SCB_ICSR_PENDSVSET_Msk)) ) {
+        return false;
+    }
+    return deep_sleep_handler();
+}
+
+/**
+ * \brief configure the stack guard region as a no-access, non-executable region the size of the guard. The
+ *        default memory map stays enabled for privileged code so only the guard region is restricted.
+ *        The default map doesn't apply to unprivileged threads, so they get full access regions over the
+ *        code and RAM, and over the peripherals. The system control space stays privileged only.
+ */
+void initialize_stack_guard(void) {
+    constexpr uint32_t region_size_field = __builtin_ctz(thread::stack_guard_size) - 1;
+
+#ifdef OS_UNPRIVILEGED_THREADS
+    constexpr uint32_t full_access = 0x03;
+    constexpr uint32_t size_1gb = 29;
+    constexpr uint32_t size_512mb = 28;
+
+    /* flash, CCM and SRAM as normal write-through memory */
+    MPU->RNR = unprivileged_memory_region;
+    MPU->RBAR = 0x00000000;
+    MPU->RASR = (full_access << MPU_RASR_AP_Pos) | MPU_RASR_C_Msk | (size_1gb << MPU_RASR_SIZE_Pos) | MPU_RASR_ENABLE_Msk;
+
+    /* peripherals as shared device memory */
+    MPU->RNR = unprivileged_peripheral_region;
+    MPU->RBAR = 0x40000000;
+    MPU->RASR = MPU_RASR_XN_Msk | (full_access << MPU_RASR_AP_Pos) | MPU_RASR_B_Msk | MPU_RASR_S_Msk | (size_512mb << MPU_RASR_SIZE_Pos) |
+                MPU_RASR_ENABLE_Msk;
+#endif
+
+    MPU->RNR = stack_guard_region;
+    MPU->RBAR = static_cast<uint32_t>(reinterpret_cast<std::uintptr_t>(system_active_task->thread_ptr->get_stack_guard()));
+    MPU->RASR = MPU_RASR_XN_Msk | (region_size_field << MPU_RASR_SIZE_Pos) | MPU_RASR_ENABLE_Msk;
+    MPU->CTRL = MPU_CTRL_PRIVDEFENA_Msk | MPU_CTRL_ENABLE_Msk;
+    SCB->SHCSR |= SCB_SHCSR_MEMFAULTENA_Msk;
+    __DSB();
+    __ISB();
+}
+
+/**
+ * \brief move the guard region to the incoming thread. Only the base address changes between threads so
+ *        a single RBAR write (with the region number encoded) is enough.
+ */
+__attribute__((used)) void os_configure_stack_guard(void) {
+    MPU->RBAR = static_cast<uint32_t>(reinterpret_cast<std::uintptr_t>(system_active_task->thread_ptr->get_stack_guard())) | MPU_RBAR_VALID_Msk | stack_guard_region;
+    __DSB();
+}
+
 };  // namespace os
\ No newline at end of file
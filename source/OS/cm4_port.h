@@ -17,8 +17,32 @@
 namespace os
 {
 
-#define DISABLE_INTERRUPTS() __asm("CPSID I\n");
-#define ENABLE_INTERRUPTS()  __asm("CPSIE I\n");
+/********************************** Constants *******************************************/
+/* Kernel interrupt ceiling, as an NVIC preemption priority. The kernel masks interrupts by raising BASEPRI to
+   the ceiling, so interrupts at a more urgent (numerically lower) priority are never held off by the OS.
+   Those interrupts must not call into the OS. The default leaves PreemptionPriority::level_1 free. */
+#ifndef OS_KERNEL_INTERRUPT_CEILING
+#define OS_KERNEL_INTERRUPT_CEILING 1
+#endif
+
+//!< BASEPRI value for the ceiling. The STM32F4 implements the top four priority bits.
+#define OS_KERNEL_BASEPRI (OS_KERNEL_INTERRUPT_CEILING << 4)
+
+#define OS_STRINGIFY(value)       OS_STRINGIFY_VALUE(value)
+#define OS_STRINGIFY_VALUE(value) #value
+
+/* mask every interrupt, including the ones above the kernel ceiling. Only for sleeping the core, where WFI
+   has to wake for any pending interrupt, and for halting. */
+#define DISABLE_ALL_INTERRUPTS() __asm("CPSID I\n");
+#define ENABLE_ALL_INTERRUPTS()  __asm("CPSIE I\n");
+
+/* SVC numbers for the kernel entry points. These are macros so they can be pasted into the SVC instructions. */
+#define OS_SVC_RAISE_PRIVILEGE 0  //!< run the calling thread privileged until it drops back to unprivileged
+#define OS_SVC_SLEEP           1  //!< sleep the calling thread, r0 = ticks
+#define OS_SVC_LOCK            2  //!< raise the calling thread's preemption threshold, r0 = priority, returns the old threshold
+#define OS_SVC_UNLOCK          3  //!< restore the calling thread's preemption threshold, r0 = old threshold
+#define OS_SVC_SET_TIME_SLICE  4  //!< set a priority level's time slice, r0 = priority, r1 = ticks
+#define OS_SVC_EXIT            5  //!< end the calling thread
 
 /********************************** Function Declarations *******************************************/
 /**
@@ -34,4 +58,131 @@ void set_pending_context_switch(void);
  */
 bool is_context_switch_pending(void);
 
+/**
+ * \brief check if the caller is a thread running under the kernel, which is the only context that can block
+ *
+ * \retval true/false
+ */
+bool is_thread_context(void);
+
+/**
+ * \brief enter a critical section from code that may already be running with interrupts disabled,
+ *        such as an interrupt handler. BASEPRI is only ever raised, so these nest.
+ * 
+ * \retval uint32_t the previous interrupt mask to pass to exit_critical_from_isr
+ */
+uint32_t enter_critical_from_isr(void);
+
+/**
+ * \brief leave a critical section entered with enter_critical_from_isr
+ * 
+ * \param interrupt_mask the interrupt mask returned when the critical section was entered
+ */
+void exit_critical_from_isr(uint32_t interrupt_mask);
+
+/**
+ * \brief masks the kernel interrupts for its lifetime, restoring the previous mask when it goes out of scope,
+ *        so critical sections nest and can be entered from threads and interrupt handlers alike
+ */
+class critical_section {
+  public:
+    critical_section(void)
+        : interrupt_mask(enter_critical_from_isr()) { }
+
+    ~critical_section(void) {
+        exit_critical_from_isr(this->interrupt_mask);
+    }
+
+    critical_section(const critical_section&) = delete;
+    critical_section& operator=(const critical_section&) = delete;
+
+  private:
+    uint32_t interrupt_mask;
+};
+
+/**
+ * \brief get the SysTick counts elapsed since the last tick interrupt was handled, including a whole
+ *        period if the tick interrupt is pending
+ * 
+ * \retval uint32_t elapsed counts
+ */
+uint32_t get_tick_counts(void);
+
+/**
+ * \brief get the number of SysTick counts in one tick period
+ * 
+ * \retval uint32_t counts per tick
+ */
+uint32_t get_tick_period_counts(void);
+
+/**
+ * \brief change the number of SysTick counts in one tick period, carrying the part of the current tick that has
+ *        already elapsed over at the new rate. Used when the core clock changes, so time keeps tracking.
+ * 
+ * \param counts counts per tick
+ * \note must be called from privileged code
+ */
+void set_tick_period_counts(uint32_t counts);
+
+/**
+ * \brief stop the periodic system tick and put the core to sleep for up to idle_ticks
+ * 
+ * \param idle_ticks number of ticks until the next thread needs to run
+ * \note must be called with interrupts disabled. The system clock is advanced by the number of 
+ *       whole ticks spent asleep before returning.
+ */
+void suppress_ticks_and_sleep(uint32_t idle_ticks);
+
+//!< enters a deep sleep mode and returns once awake again, or returns false if it couldn't sleep
+using deep_sleep_function = bool (*)(void);
+
+/**
+ * \brief register the handler the idle loop uses to enter a deep sleep mode. Pass nullptr to disable deep sleep.
+ * 
+ * \param handler the deep sleep handler
+ */
+void set_deep_sleep_handler(deep_sleep_function handler);
+
+/**
+ * \brief enter the registered deep sleep mode if there is no kernel work pending
+ * 
+ * \retval true if the core slept, false if there is no handler or it declined
+ * \note must be called with interrupts disabled. The SysTick stops along with the rest of the clocks, so
+ *       system time does not advance while in deep sleep. Only use it when no thread is waiting on a timeout.
+ */
+bool deep_sleep(void);
+
+/**
+ * \brief enable the MPU with a no-access stack guard region and enable the MemManage fault
+ * \note only used when built with OS_MPU_STACK_GUARD
+ */
+void initialize_stack_guard(void);
+
+extern "C" {
+/**
+ * \brief decode and run an SVC call. Called from the SVC handler with the caller's exception frame.
+ * 
+ * \param frame stacked r0-r3, r12, lr, pc and xpsr of the caller. r0 is overwritten with the return value.
+ */
+void os_svc_handler(uint32_t* frame);
+
+/**
+ * \brief SVC entry points. Each one is a bare SVC instruction, so the arguments pass straight through in
+ *        r0 and r1. These must be called from thread mode with interrupts enabled, otherwise the SVC
+ *        escalates to a hard fault.
+ */
+void os_svc_raise_privilege(void);
+void os_svc_sleep(uint32_t ticks);
+uint32_t os_svc_lock(uint32_t priority);
+void os_svc_unlock(uint32_t previous);
+void os_svc_set_time_slice(uint32_t priority, uint32_t ticks);
+void os_svc_exit(void);
+
+/**
+ * \brief move the stack guard region to the bottom of the active thread's stack. Called from the
+ *        PendSV handler during each context switch when built with OS_MPU_STACK_GUARD.
+ */
+void os_configure_stack_guard(void);
+}
+
 };  // namespace os
@@ -0,0 +1,108 @@
+/**
+ * \file coroutine.cpp
+ * \author Graham Riches (graham.riches@live.com)
+ * \brief coroutine executor thread and the frame pool the coroutine tasks are allocated from
+ * \version 0.1
+ * \date 2021-06-12
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+/********************************** Includes *******************************************/
+#include "coroutine.h"
+#include "block_pool.h"
+#include "cm4_port.h"
+#include "scheduler.h"
+#include "system_clock.h"
+#include "thread_impl.h"
+
+namespace os
+{
+/********************************** Constants *******************************************/
+constexpr uint16_t coroutine_thread_stack_size = 256;
+constexpr uint32_t coroutine_thread_id = 0xFFFA;
+constexpr uint8_t coroutine_thread_priority = 1;
+
+/********************************** Function Declarations *******************************************/
+static void coroutine_thread_task(void* arguments);
+
+/********************************** Local Variables *******************************************/
+/* the frames hold the tasks' locals, so they stay in SRAM where DMA can reach buffers declared in a task */
+static block_pool<OS_COROUTINE_FRAME_SIZE, OS_COROUTINE_FRAME_COUNT, alignof(std::max_align_t)> frame_pool;
+
+CCM_RAM static uint32_t coroutine_thread_stack[coroutine_thread_stack_size] = {0};
+CCM_RAM static os::thread coroutine_thread(coroutine_thread_task, nullptr, coroutine_thread_id, coroutine_thread_stack,
+                                           coroutine_thread_stack_size, coroutine_thread_priority);
+
+/********************************** Function Definitions *******************************************/
+//!< frames come from the fixed pool, a frame too big for a block fails like an empty pool
+void* allocate_coroutine_frame(size_t size) noexcept {
+    return (size <= OS_COROUTINE_FRAME_SIZE) ? frame_pool.allocate() : nullptr;
+}
+
+//!< return a frame to the pool
+void free_coroutine_frame(void* frame) noexcept {
+    frame_pool.free(frame);
+}
+
+//!< create the executor singleton
+coroutine_executor::coroutine_executor()
+    : coroutine_executor_impl()
+    , wake(0, 1) { }
+
+//!< get a reference to the executor singleton
+coroutine_executor& coroutine_executor::get() {
+    CCM_RAM static coroutine_executor executor;
+    return executor;
+}
+
+//!< register the executor thread
+void coroutine_executor::initialize(void) {
+    scheduler::register_new_thread(&coroutine_thread);
+}
+
+//!< queue a task on the singleton
+bool coroutine_executor::spawn(co_task&& task) {
+    return get().coroutine_executor_impl::spawn(std::move(task));
+}
+
+//!< resume the ready tasks, then sleep until the next one is due or something readies one
+void coroutine_executor::run(void) {
+    while ( true ) {
+        this->run_ready(system_clock::get_elapsed_ticks());
+        uint32_t ticks = this->get_ticks_until_wake(system_clock::get_elapsed_ticks());
+        if ( ticks == wait_forever ) {
+            this->wake.wait();
+        } else if ( ticks > 0 ) {
+            this->wake.wait_for(ticks);
+        }
+    }
+}
+
+//!< the task lists are shared with interrupt handlers
+uint32_t coroutine_executor::enter_critical(void) {
+    return enter_critical_from_isr();
+}
+
+//!< leave the critical section
+void coroutine_executor::exit_critical(uint32_t state) {
+    exit_critical_from_isr(state);
+}
+
+//!< wake the executor thread, which may be waiting on the kernel
+void coroutine_executor::notify(void) {
+    if ( is_thread_context() ) {
+        this->wake.signal();
+    } else {
+        this->wake.signal_from_isr();
+    }
+}
+
+//!< entry point for the executor thread
+static void coroutine_thread_task(void* arguments) {
+    PARAMETER_NOT_USED(arguments);
+    coroutine_executor::get().run();
+}
+
+};  // namespace os
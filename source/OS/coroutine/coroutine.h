@@ -0,0 +1,77 @@
+/**
+ * \file coroutine.h
+ * \author Graham Riches (graham.riches@live.com)
+ * \brief stackless coroutine tasks, run cooperatively on a single kernel thread
+ * \version 0.1
+ * \date 2021-06-12
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#pragma once
+
+/********************************** Includes *******************************************/
+#include "coroutine_impl.h"
+#include "os_semaphore.h"
+
+namespace os
+{
+/**
+ * \brief singleton executor thread for coroutine tasks. Dozens of I/O bound state machines can share its one stack,
+ *        each needing only a frame from the coroutine frame pool. The thread sleeps on the kernel until a task is due
+ *        or an event or semaphore readies one, and co_event and co_semaphore can be set and signalled from
+ *        interrupt handlers, so a driver's completion interrupt can hand a result straight to a task.
+ *
+ *        For example:
+ *            os::co_task poll_sensor(os::co_event& ready) {
+ *                while ( true ) {
+ *                    start_transfer();
+ *                    co_await ready.wait();
+ *                    co_await os::co_sleep(100);
+ *                }
+ *            }
+ *            os::coroutine_executor::spawn(poll_sensor(sensor_ready));
+ */
+class coroutine_executor : public coroutine_executor_impl {
+  public:
+    /**
+     * \brief register the executor thread with the scheduler. Call this before the kernel is entered.
+     */
+    static void initialize(void);
+
+    /**
+     * \brief start a task on the executor thread, from a thread
+     *
+     * \param task the task
+     * \retval true if it was queued, false if it has no frame
+     */
+    static bool spawn(co_task&& task);
+
+    /**
+     * \brief singleton accessor for the executor, to construct events and semaphores on
+     *
+     * \retval coroutine_executor& reference to the executor
+     */
+    static coroutine_executor& get();
+
+    /**
+     * \brief run the executor thread loop
+     */
+    [[noreturn]] void run(void);
+
+  protected:
+    uint32_t enter_critical(void) override;
+    void exit_critical(uint32_t state) override;
+    void notify(void) override;
+
+  private:
+    /**
+     * \brief Construct the executor as a singleton instance
+     */
+    coroutine_executor();
+
+    semaphore wake;  //!< signalled whenever a task is readied
+};
+
+};  // namespace os
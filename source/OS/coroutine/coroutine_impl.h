@@ -0,0 +1,551 @@
+/**
+ * \file coroutine_impl.h
+ * \author Graham Riches (graham.riches@live.com)
+ * \brief internal OS implementation of stackless coroutine tasks, the executor that runs them on one thread and
+ *        the awaitables they suspend on
+ * \version 0.1
+ * \date 2021-06-12
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#pragma once
+
+/********************************** Includes *******************************************/
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <utility>
+
+/********************************** Constants *******************************************/
+/**
+ * \brief bytes in each coroutine frame. A frame holds the promise, the arguments and every local that lives across
+ *        a co_await, and a coroutine whose frame doesn't fit fails to start.
+ */
+#ifndef OS_COROUTINE_FRAME_SIZE
+#    define OS_COROUTINE_FRAME_SIZE 256
+#endif
+
+/**
+ * \brief number of coroutine frames, which is the most coroutine tasks that can exist at once
+ */
+#ifndef OS_COROUTINE_FRAME_COUNT
+#    define OS_COROUTINE_FRAME_COUNT 16
+#endif
+
+namespace os
+{
+/****************************** Function Declarations ***********************************/
+/**
+ * \brief take a frame from the coroutine frame pool. The firmware defines this over a fixed pool, and the unit
+ *        tests define their own.
+ *
+ * \param size bytes the frame needs
+ * \retval void* the frame, or nullptr if the pool is empty or the frame is too big
+ */
+void* allocate_coroutine_frame(size_t size) noexcept;
+
+/**
+ * \brief return a frame to the coroutine frame pool
+ *
+ * \param frame the frame
+ */
+void free_coroutine_frame(void* frame) noexcept;
+
+/********************************** Types *******************************************/
+class coroutine_executor_impl;
+class co_task;
+
+/**
+ * \brief promise of a coroutine task. It doubles as the task's link in whichever executor or wait list it is on.
+ */
+struct co_task_promise {
+    co_task get_return_object(void) noexcept;
+    static co_task get_return_object_on_allocation_failure(void) noexcept;
+
+    //!< tasks only start once they are spawned on an executor, which also destroys them once they finish
+    std::suspend_always initial_suspend(void) noexcept {
+        return {};
+    }
+    std::suspend_always final_suspend(void) noexcept {
+        return {};
+    }
+
+    void return_void(void) noexcept { }
+    void unhandled_exception(void) noexcept {
+        std::terminate();
+    }
+
+    static void* operator new(size_t size) noexcept {
+        return allocate_coroutine_frame(size);
+    }
+    static void operator delete(void* frame) noexcept {
+        free_coroutine_frame(frame);
+    }
+
+    coroutine_executor_impl* executor = nullptr;
+    co_task_promise* next = nullptr;  //!< next task in the list this one is on
+    uint32_t wake_tick = 0;           //!< tick to wake at while sleeping
+};
+
+/**
+ * \brief a coroutine that runs as a lightweight cooperative task. Write one as a function returning co_task that
+ *        uses co_await, then hand it to an executor to run. Tasks only give up the executor thread at a co_await,
+ *        so they must never block the thread, and a task that never awaits starves every other one.
+ */
+class co_task {
+  public:
+    using promise_type = co_task_promise;
+
+    co_task(void)
+        : handle(nullptr) { }
+
+    explicit co_task(std::coroutine_handle<promise_type> handle)
+        : handle(handle) { }
+
+    co_task(co_task&& other) noexcept
+        : handle(std::exchange(other.handle, nullptr)) { }
+
+    co_task& operator = (co_task&& other) noexcept {
+        if ( this != &other ) {
+            this->reset();
+            this->handle = std::exchange(other.handle, nullptr);
+        }
+        return *this;
+    }
+
+    //!< delete copies, a frame has one owner
+    co_task(const co_task& other) = delete;
+    co_task& operator = (const co_task& other) = delete;
+
+    //!< a task that was never spawned is destroyed with its owner
+    ~co_task() {
+        this->reset();
+    }
+
+    /**
+     * \brief check if the task got a frame
+     *
+     * \retval true if the task can be spawned, false if the frame pool was out of frames
+     */
+    bool is_valid(void) const {
+        return static_cast<bool>(this->handle);
+    }
+
+  private:
+    friend class coroutine_executor_impl;
+
+    void reset(void) {
+        if ( this->handle ) {
+            this->handle.destroy();
+            this->handle = nullptr;
+        }
+    }
+
+    std::coroutine_handle<promise_type> release(void) {
+        return std::exchange(this->handle, nullptr);
+    }
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+inline co_task co_task_promise::get_return_object(void) noexcept {
+    return co_task(std::coroutine_handle<co_task_promise>::from_promise(*this));
+}
+
+inline co_task co_task_promise::get_return_object_on_allocation_failure(void) noexcept {
+    return co_task();
+}
+
+/**
+ * \brief first in, first out list of tasks, linked through their promises
+ */
+class co_task_list {
+  public:
+    void push(co_task_promise* task) {
+        task->next = nullptr;
+        if ( this->tail == nullptr ) {
+            this->head = task;
+        } else {
+            this->tail->next = task;
+        }
+        this->tail = task;
+        this->count++;
+    }
+
+    co_task_promise* pop(void) {
+        co_task_promise* task = this->head;
+        if ( task != nullptr ) {
+            this->head = task->next;
+            this->tail = (this->head == nullptr) ? nullptr : this->tail;
+            task->next = nullptr;
+            this->count--;
+        }
+        return task;
+    }
+
+    co_task_promise* front(void) const {
+        return this->head;
+    }
+
+    size_t size(void) const {
+        return this->count;
+    }
+
+  private:
+    co_task_promise* head = nullptr;
+    co_task_promise* tail = nullptr;
+    size_t count = 0;
+};
+
+/**
+ * \brief runs coroutine tasks cooperatively on a single thread. The owner calls run_ready() from its loop, then
+ *        waits for get_ticks_until_wake() ticks or until notify() is called. Tasks can be readied from interrupt
+ *        handlers through the awaitables, and a subclass makes that safe by overriding the critical section hooks.
+ */
+class coroutine_executor_impl {
+  public:
+    static constexpr uint32_t wait_forever = UINT32_MAX;
+
+    coroutine_executor_impl(void)
+        : ready()
+        , sleeping(nullptr)
+        , current_tick(0)
+        , task_count(0) { }
+
+    virtual ~coroutine_executor_impl() = default;
+
+    //!< delete copies and moves, the tasks point back at their executor
+    coroutine_executor_impl(const coroutine_executor_impl& other) = delete;
+    coroutine_executor_impl(coroutine_executor_impl&& other) = delete;
+    coroutine_executor_impl& operator = (const coroutine_executor_impl& other) = delete;
+    coroutine_executor_impl& operator = (coroutine_executor_impl&& other) = delete;
+
+    /**
+     * \brief take over a task and queue it to start
+     *
+     * \param task the task
+     * \retval true if it was queued, false if it has no frame
+     */
+    bool spawn(co_task&& task) {
+        if ( !task.is_valid() ) {
+            return false;
+        }
+        auto handle = task.release();
+        handle.promise().executor = this;
+        uint32_t interrupt_mask = this->lock();
+        this->task_count++;
+        this->ready.push(&handle.promise());
+        this->unlock(interrupt_mask);
+        this->notify();
+        return true;
+    }
+
+    /**
+     * \brief wake the tasks due by now, then resume each task that is ready. Tasks readied while this runs,
+     *        including ones that yield, wait for the next call.
+     *
+     * \param now current tick count
+     * \retval size_t number of tasks resumed
+     */
+    size_t run_ready(uint32_t now) {
+        uint32_t interrupt_mask = this->lock();
+        this->current_tick = now;
+        while ( (this->sleeping != nullptr) && (static_cast<int32_t>(this->sleeping->wake_tick - now) <= 0) ) {
+            co_task_promise* task = this->sleeping;
+            this->sleeping = task->next;
+            this->ready.push(task);
+        }
+        size_t count = this->ready.size();
+        this->unlock(interrupt_mask);
+
+        for ( size_t resumed = 0; resumed < count; resumed++ ) {
+            interrupt_mask = this->lock();
+            co_task_promise* task = this->ready.pop();
+            this->unlock(interrupt_mask);
+
+            auto handle = std::coroutine_handle<co_task_promise>::from_promise(*task);
+            handle.resume();
+            if ( handle.done() ) {
+                handle.destroy();
+                interrupt_mask = this->lock();
+                this->task_count--;
+                this->unlock(interrupt_mask);
+            }
+        }
+        return count;
+    }
+
+    /**
+     * \brief get how long the owner can wait before it next needs to call run_ready()
+     *
+     * \param now current tick count
+     * \retval uint32_t ticks to wait, 0 if a task is ready, or wait_forever if nothing is sleeping
+     */
+    uint32_t get_ticks_until_wake(uint32_t now) {
+        uint32_t interrupt_mask = this->lock();
+        uint32_t ticks = wait_forever;
+        if ( this->ready.size() > 0 ) {
+            ticks = 0;
+        } else if ( this->sleeping != nullptr ) {
+            int32_t remaining = static_cast<int32_t>(this->sleeping->wake_tick - now);
+            ticks = (remaining > 0) ? static_cast<uint32_t>(remaining) : 0;
+        }
+        this->unlock(interrupt_mask);
+        return ticks;
+    }
+
+    /**
+     * \brief get the number of tasks that have been spawned and haven't finished
+     *
+     * \retval size_t task count
+     */
+    size_t get_task_count(void) const {
+        return this->task_count;
+    }
+
+    /**
+     * \brief queue a suspended task to resume, and wake the owner
+     *
+     * \param task the task
+     */
+    void schedule(co_task_promise& task) {
+        uint32_t interrupt_mask = this->lock();
+        this->ready.push(&task);
+        this->unlock(interrupt_mask);
+        this->notify();
+    }
+
+    /**
+     * \brief put a suspended task to sleep. It wakes on the first run_ready() at least ticks after the one that
+     *        resumed it, and sleeping for 0 ticks just moves it to the back of the ready list.
+     *
+     * \param task the task
+     * \param ticks ticks to sleep for
+     */
+    void sleep(co_task_promise& task, uint32_t ticks) {
+        if ( ticks == 0 ) {
+            this->schedule(task);
+            return;
+        }
+
+        uint32_t interrupt_mask = this->lock();
+        task.wake_tick = this->current_tick + ticks;
+        co_task_promise** link = &this->sleeping;
+        while ( (*link != nullptr) && (static_cast<int32_t>((*link)->wake_tick - task.wake_tick) <= 0) ) {
+            link = &(*link)->next;
+        }
+        task.next = *link;
+        *link = &task;
+        this->unlock(interrupt_mask);
+    }
+
+    /**
+     * \brief enter the executor's critical section, which guards its lists and those of its awaitables
+     *
+     * \retval uint32_t state to pass to unlock
+     */
+    uint32_t lock(void) {
+        return this->enter_critical();
+    }
+
+    /**
+     * \brief leave the executor's critical section
+     *
+     * \param state the value lock returned
+     */
+    void unlock(uint32_t state) {
+        this->exit_critical(state);
+    }
+
+  protected:
+    //!< hooks for running the executor against interrupts, which by default assume there aren't any
+    virtual uint32_t enter_critical(void) {
+        return 0;
+    }
+    virtual void exit_critical(uint32_t state) {
+        static_cast<void>(state);
+    }
+    virtual void notify(void) { }
+
+  private:
+    co_task_list ready;
+    co_task_promise* sleeping;  //!< sleeping tasks, soonest to wake first
+    uint32_t current_tick;      //!< tick count of the latest run_ready()
+    size_t task_count;
+};
+
+/**
+ * \brief awaitable that suspends a task for a number of ticks
+ */
+struct co_sleep {
+    explicit co_sleep(uint32_t ticks)
+        : ticks(ticks) { }
+
+    bool await_ready(void) const noexcept {
+        return false;
+    }
+    void await_suspend(std::coroutine_handle<co_task_promise> handle) const {
+        handle.promise().executor->sleep(handle.promise(), this->ticks);
+    }
+    void await_resume(void) const noexcept { }
+
+    uint32_t ticks;
+};
+
+/**
+ * \brief auto-reset event for waking a task from another task, a thread or an interrupt, such as a driver
+ *        signalling a transfer is done. Each set() releases one waiting task, or lets the next wait() through
+ *        if nothing is waiting.
+ */
+class co_event {
+  public:
+    /**
+     * \brief Construct a new event, cleared
+     *
+     * \param executor the executor of the tasks that wait on it
+     */
+    explicit co_event(coroutine_executor_impl& executor)
+        : executor(executor)
+        , waiters()
+        , signalled(false) { }
+
+    struct awaiter {
+        bool await_ready(void) const noexcept {
+            return false;
+        }
+
+        //!< checking and joining the wait list happen together, so a set() in between can't be missed
+        bool await_suspend(std::coroutine_handle<co_task_promise> handle) {
+            uint32_t interrupt_mask = this->event.executor.lock();
+            bool suspend = !this->event.signalled;
+            if ( suspend ) {
+                this->event.waiters.push(&handle.promise());
+            }
+            this->event.signalled = false;
+            this->event.executor.unlock(interrupt_mask);
+            return suspend;
+        }
+
+        void await_resume(void) const noexcept { }
+
+        co_event& event;
+    };
+
+    /**
+     * \brief wait for the event to be set
+     */
+    awaiter wait(void) {
+        return awaiter{*this};
+    }
+
+    /**
+     * \brief set the event, releasing one waiting task
+     */
+    void set(void) {
+        uint32_t interrupt_mask = this->executor.lock();
+        co_task_promise* task = this->waiters.pop();
+        this->signalled = (task == nullptr);
+        this->executor.unlock(interrupt_mask);
+        if ( task != nullptr ) {
+            this->executor.schedule(*task);
+        }
+    }
+
+    /**
+     * \brief check if the event is set with nothing having waited on it yet
+     *
+     * \retval true/false
+     */
+    bool is_set(void) const {
+        return this->signalled;
+    }
+
+  private:
+    coroutine_executor_impl& executor;
+    co_task_list waiters;
+    bool signalled;
+};
+
+/**
+ * \brief counting semaphore for tasks. It can be signalled from other tasks, threads or interrupts, but only tasks
+ *        can take it.
+ */
+class co_semaphore {
+  public:
+    /**
+     * \brief Construct a new semaphore
+     *
+     * \param executor the executor of the tasks that take it
+     * \param initial_count initial count
+     * \param max_count the count saturates here when signalled with no tasks waiting
+     */
+    co_semaphore(coroutine_executor_impl& executor, uint32_t initial_count, uint32_t max_count = UINT32_MAX)
+        : executor(executor)
+        , waiters()
+        , count(initial_count)
+        , max_count(max_count) { }
+
+    struct awaiter {
+        bool await_ready(void) const noexcept {
+            return false;
+        }
+
+        bool await_suspend(std::coroutine_handle<co_task_promise> handle) {
+            uint32_t interrupt_mask = this->semaphore.executor.lock();
+            bool suspend = (this->semaphore.count == 0);
+            if ( suspend ) {
+                this->semaphore.waiters.push(&handle.promise());
+            } else {
+                this->semaphore.count--;
+            }
+            this->semaphore.executor.unlock(interrupt_mask);
+            return suspend;
+        }
+
+        void await_resume(void) const noexcept { }
+
+        co_semaphore& semaphore;
+    };
+
+    /**
+     * \brief take the semaphore, suspending the task until it's available
+     */
+    awaiter take(void) {
+        return awaiter{*this};
+    }
+
+    /**
+     * \brief signal the semaphore, handing it straight to the longest waiting task if there is one
+     */
+    void signal(void) {
+        uint32_t interrupt_mask = this->executor.lock();
+        co_task_promise* task = this->waiters.pop();
+        if ( (task == nullptr) && (this->count < this->max_count) ) {
+            this->count++;
+        }
+        this->executor.unlock(interrupt_mask);
+        if ( task != nullptr ) {
+            this->executor.schedule(*task);
+        }
+    }
+
+    /**
+     * \brief get the count
+     *
+     * \retval uint32_t count
+     */
+    uint32_t get_count(void) const {
+        return this->count;
+    }
+
+  private:
+    coroutine_executor_impl& executor;
+    co_task_list waiters;
+    uint32_t count;
+    uint32_t max_count;
+};
+
+};  // namespace os
@@ -0,0 +1,138 @@
+/**
+ * \file crash_dump.cpp
+ * \author Graham Riches (graham.riches@live.com)
+ * \brief crash dump capture and the flash sector it is kept in
+ * \version 0.1
+ * \date 2021-06-06
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+/********************************** Includes *******************************************/
+#include "crash_dump.h"
+#include "cm4_port.h"
+#include "hal_flash.h"
+#include "os.h"
+#include "thread_impl.h"
+#include "trace.h"
+#include "stm32f4xx.h"
+#include <cstdint>
+
+/********************************** Linker Symbols *******************************************/
+extern "C" {
+extern uint32_t _crash_dump_start[];  //!< start of the sector the linker script reserves for the dumps
+extern uint32_t _crash_dump_end[];
+}
+
+namespace os
+{
+/********************************** Constants *******************************************/
+constexpr uint8_t crash_dump_sector = 11;  //!< must match the CRASH_DUMP region in the linker script
+
+constexpr uint32_t sram_start = 0x20000000;
+constexpr uint32_t sram_end = 0x20020000;
+constexpr uint32_t ccm_start = 0x10000000;
+constexpr uint32_t ccm_end = 0x10010000;
+
+/********************************** Types *******************************************/
+/**
+ * \brief the reserved flash sector, as seen by the crash dump store
+ */
+class crash_dump_sector_device {
+  public:
+    const uint32_t* get_words(void) const {
+        return _crash_dump_start;
+    }
+
+    size_t get_word_count(void) const {
+        return static_cast<size_t>(_crash_dump_end - _crash_dump_start);
+    }
+
+    bool erase(void) {
+        HAL::flash.unlock();
+        bool erased = HAL::flash.erase_sector(crash_dump_sector);
+        HAL::flash.lock();
+        return erased;
+    }
+
+    bool program(size_t index, uint32_t value) {
+        uint32_t address = static_cast<uint32_t>(reinterpret_cast<std::uintptr_t>(&_crash_dump_start[index]));
+        HAL::flash.unlock();
+        bool programmed = HAL::flash.program_word(address, value);
+        HAL::flash.lock();
+        return programmed;
+    }
+};
+
+/********************************** Local Variables *******************************************/
+static crash_dump_sector_device sector_device;
+static crash_dump_store_impl<crash_dump_sector_device> store(sector_device);
+
+/* the dump is too big for the little main stack the fault handlers run on */
+CCM_RAM static crash_dump_record pending_dump;
+
+/********************************** Function Definitions *******************************************/
+/**
+ * \brief check that a block is all in RAM, so reading it can't fault again from inside the fault handler
+ *
+ * \param address start of the block
+ * \param size size of the block in bytes
+ * \retval true if it is in SRAM or CCM RAM
+ */
+static bool is_in_ram(uint32_t address, uint32_t size) {
+    return ((address >= sram_start) && (address <= (sram_end - size))) || ((address >= ccm_start) && (address <= (ccm_end - size)));
+}
+
+//!< fill in the dump from the fault registers, the active task and the trace buffer, then save it and reset
+void crash_dump::save_and_reset(fault_type fault, uint32_t stack_pointer, uint32_t exc_return) {
+    __disable_irq();
+
+    crash_dump_record& dump = pending_dump;
+    std::memset(&dump, 0, sizeof(dump));
+    dump.fault = fault;
+    dump.exc_return = exc_return;
+    dump.stack_pointer = stack_pointer;
+    if ( is_in_ram(stack_pointer, sizeof(exception_frame)) ) {
+        std::memcpy(&dump.frame, reinterpret_cast<const void*>(stack_pointer), sizeof(exception_frame));
+    }
+    dump.cfsr = SCB->CFSR;
+    dump.hfsr = SCB->HFSR;
+    dump.mmfar = SCB->MMFAR;
+    dump.bfar = SCB->BFAR;
+
+    /* the task control block might be what got corrupted, so check each pointer before following it */
+    dump.thread_id = 0xFFFFFFFF;
+    uint32_t task_address = static_cast<uint32_t>(reinterpret_cast<std::uintptr_t>(system_active_task));
+    if ( is_in_ram(task_address, sizeof(scheduler::TaskControlBlock)) ) {
+        dump.task_control_block = task_address;
+        uint32_t thread_address = static_cast<uint32_t>(reinterpret_cast<std::uintptr_t>(system_active_task->thread_ptr));
+        if ( is_in_ram(thread_address, sizeof(thread)) ) {
+            dump.thread_id = system_active_task->thread_ptr->get_id();
+        }
+    }
+
+    dump.trace_count = static_cast<uint32_t>(trace::copy_latest(dump.trace, OS_CRASH_DUMP_TRACE_COUNT));
+
+    store.save(dump);
+    NVIC_SystemReset();
+    while ( true ) {
+    }
+}
+
+//!< count the stored dumps
+size_t crash_dump::get_count(void) {
+    return store.get_count();
+}
+
+//!< read a stored dump
+bool crash_dump::read(size_t index, crash_dump_record& record) {
+    return store.read(index, record);
+}
+
+//!< erase the stored dumps
+bool crash_dump::clear(void) {
+    return store.clear();
+}
+
+};  // namespace os
@@ -0,0 +1,59 @@
+/**
+ * \file crash_dump.h
+ * \author Graham Riches (graham.riches@live.com)
+ * \brief post-mortem crash dumps. The fault handlers save the fault state into a reserved flash sector and reset,
+ *        and the dumps can be read back after the next boot.
+ * \version 0.1
+ * \date 2021-06-06
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#pragma once
+
+/********************************** Includes *******************************************/
+#include "crash_dump_impl.h"
+
+namespace os
+{
+/**
+ * \brief crash dumps kept in the last flash sector, which the linker script reserves
+ */
+class crash_dump {
+  public:
+    /**
+     * \brief save a dump of the fault in progress and reset. Only call this from a fault handler.
+     *
+     * \param fault the fault
+     * \param stack_pointer the stack the exception frame was pushed to
+     * \param exc_return the fault handler's link register
+     */
+    [[noreturn]] static void save_and_reset(fault_type fault, uint32_t stack_pointer, uint32_t exc_return);
+
+    /**
+     * \brief get the number of dumps stored
+     *
+     * \retval size_t dump count
+     */
+    static size_t get_count(void);
+
+    /**
+     * \brief read a dump
+     *
+     * \param index which dump, 0 is the oldest
+     * \param record where to copy it
+     * \retval true if there is a dump at that index
+     */
+    static bool read(size_t index, crash_dump_record& record);
+
+    /**
+     * \brief erase every dump. This stalls everything running from flash while the sector erases, which takes
+     *        a second or two.
+     *
+     * \retval true if they were erased
+     */
+    static bool clear(void);
+};
+
+};  // namespace os
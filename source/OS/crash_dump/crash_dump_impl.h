@@ -0,0 +1,248 @@
+/**
+ * \file crash_dump_impl.h
+ * \author Graham Riches (graham.riches@live.com)
+ * \brief internal OS implementation of the post-mortem crash dump records and the flash store that keeps them
+ * \version 0.1
+ * \date 2021-06-06
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#pragma once
+
+/********************************** Includes *******************************************/
+#include "crc32.h"
+#include "trace_impl.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/********************************** Constants *******************************************/
+/**
+ * \brief number of trace events kept with each crash dump
+ */
+#ifndef OS_CRASH_DUMP_TRACE_COUNT
+#    define OS_CRASH_DUMP_TRACE_COUNT 16
+#endif
+
+namespace os
+{
+
+/********************************** Types *******************************************/
+/**
+ * \brief the fault that caused a dump. The values are the exception numbers of the fault handlers.
+ */
+enum class fault_type : uint32_t {
+    hard_fault = 3,
+    memory_fault = 4,
+    bus_fault = 5,
+    usage_fault = 6,
+};
+
+/**
+ * \brief registers the core pushes to the active stack on exception entry
+ */
+struct exception_frame {
+    uint32_t r0;
+    uint32_t r1;
+    uint32_t r2;
+    uint32_t r3;
+    uint32_t r12;
+    uint32_t lr;
+    uint32_t return_address;
+    uint32_t xpsr;
+};
+
+/**
+ * \brief everything the fault handler saves about a crash. The record is written to flash as is, so only add
+ *        fields at the end and keep it a whole number of words.
+ */
+struct crash_dump_record {
+    uint32_t marker;    //!< crash_dump_marker, the first word written to a slot
+    uint32_t sequence;  //!< counts up with each dump saved, so the order survives the store wrapping
+    uint32_t crc;       //!< CRC-32 of everything after this field
+    fault_type fault;
+    exception_frame frame;     //!< zero if the stack pointer was outside RAM
+    uint32_t exc_return;       //!< the fault handler's link register, which says which stack the frame is on
+    uint32_t stack_pointer;    //!< where the frame was stacked
+    uint32_t cfsr;             //!< configurable fault status
+    uint32_t hfsr;             //!< hard fault status
+    uint32_t mmfar;            //!< memory management fault address
+    uint32_t bfar;             //!< bus fault address
+    uint32_t task_control_block;  //!< address of the active task control block, or 0 if there wasn't one
+    uint32_t thread_id;           //!< id of the active thread, or 0xFFFFFFFF if there wasn't one
+    uint32_t trace_count;         //!< number of valid trace records
+    trace_record trace[OS_CRASH_DUMP_TRACE_COUNT];  //!< the latest kernel trace events, oldest first
+};
+
+static_assert((sizeof(crash_dump_record) % sizeof(uint32_t)) == 0, "crash dumps are programmed a word at a time");
+
+/**
+ * \brief marker at the start of every written slot
+ */
+constexpr uint32_t crash_dump_marker = 0x43525348;
+
+/**
+ * \brief value of an erased flash word
+ */
+constexpr uint32_t crash_dump_erased_word = 0xFFFFFFFF;
+
+/**
+ * \brief get the printable name of a fault
+ *
+ * \param fault the fault
+ * \retval const char* the name, or "unknown" for a value outside the enum
+ */
+inline const char* get_fault_name(fault_type fault) {
+    switch ( fault ) {
+        case fault_type::hard_fault:
+            return "hard fault";
+        case fault_type::memory_fault:
+            return "memory management fault";
+        case fault_type::bus_fault:
+            return "bus fault";
+        case fault_type::usage_fault:
+            return "usage fault";
+        default:
+            return "unknown";
+    }
+}
+
+/**
+ * \brief append only store of crash dumps in an erasable block of flash. Dumps go in the first blank slot, and once
+ *        every slot is used the block is erased and filling starts over, so it never needs erasing until then. A
+ *        dump that was cut off part way through fails its CRC and is skipped.
+ *
+ * \tparam Device the flash block. It needs:
+ *         - const uint32_t* get_words() const, the block contents
+ *         - size_t get_word_count() const, the block size in words
+ *         - bool erase(), to set every word to crash_dump_erased_word
+ *         - bool program(size_t index, uint32_t value), to program the word at an index
+ */
+template <typename Device>
+class crash_dump_store_impl {
+  public:
+    static constexpr size_t record_words = sizeof(crash_dump_record) / sizeof(uint32_t);
+
+    /**
+     * \brief Construct a new crash dump store
+     *
+     * \param device the flash block to keep the dumps in
+     */
+    explicit crash_dump_store_impl(Device& device)
+        : device(device) { }
+
+    /**
+     * \brief compute the CRC stored with a dump
+     *
+     * \param record the dump
+     * \retval uint32_t the CRC
+     */
+    static uint32_t compute_crc(const crash_dump_record& record) {
+        constexpr size_t checked_offset = offsetof(crash_dump_record, fault);
+        return crc32(reinterpret_cast<const uint8_t*>(&record) + checked_offset, sizeof(record) - checked_offset);
+    }
+
+    /**
+     * \brief get the number of dumps the block has room for
+     *
+     * \retval size_t slot count
+     */
+    size_t get_slot_count(void) const {
+        return this->device.get_word_count() / record_words;
+    }
+
+    /**
+     * \brief get the number of valid dumps stored
+     *
+     * \retval size_t dump count
+     */
+    size_t get_count(void) const {
+        size_t count = 0;
+        crash_dump_record record;
+        for ( size_t slot = 0; (slot < this->get_slot_count()) && !this->is_blank(slot); slot++ ) {
+            count += this->read_slot(slot, record) ? 1 : 0;
+        }
+        return count;
+    }
+
+    /**
+     * \brief read a dump
+     *
+     * \param index which dump, 0 is the oldest
+     * \param record where to copy it
+     * \retval true if there is a dump at that index
+     */
+    bool read(size_t index, crash_dump_record& record) const {
+        for ( size_t slot = 0; (slot < this->get_slot_count()) && !this->is_blank(slot); slot++ ) {
+            if ( this->read_slot(slot, record) ) {
+                if ( index == 0 ) {
+                    return true;
+                }
+                index--;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * \brief save a dump, filling in its marker, sequence number and CRC
+     *
+     * \param record the dump
+     * \retval true if it was written and reads back intact
+     */
+    bool save(crash_dump_record& record) {
+        uint32_t last_sequence = 0;
+        size_t slot = 0;
+        crash_dump_record stored;
+        for ( ; (slot < this->get_slot_count()) && !this->is_blank(slot); slot++ ) {
+            if ( this->read_slot(slot, stored) && (stored.sequence > last_sequence) ) {
+                last_sequence = stored.sequence;
+            }
+        }
+
+        if ( slot == this->get_slot_count() ) {
+            if ( (slot == 0) || !this->device.erase() ) {
+                return false;
+            }
+            slot = 0;
+        }
+
+        record.marker = crash_dump_marker;
+        record.sequence = last_sequence + 1;
+        record.crc = compute_crc(record);
+
+        uint32_t words[record_words];
+        std::memcpy(words, &record, sizeof(words));
+        for ( size_t index = 0; index < record_words; index++ ) {
+            if ( !this->device.program((slot * record_words) + index, words[index]) ) {
+                return false;
+            }
+        }
+        return this->read_slot(slot, stored);
+    }
+
+    /**
+     * \brief erase every dump
+     *
+     * \retval true if the block was erased
+     */
+    bool clear(void) {
+        return this->device.erase();
+    }
+
+  private:
+    bool is_blank(size_t slot) const {
+        return this->device.get_words()[slot * record_words] == crash_dump_erased_word;
+    }
+
+    bool read_slot(size_t slot, crash_dump_record& record) const {
+        std::memcpy(&record, this->device.get_words() + (slot * record_words), sizeof(record));
+        return (record.marker == crash_dump_marker) && (record.crc == compute_crc(record));
+    }
+
+    Device& device;
+};
+
+};  // namespace os
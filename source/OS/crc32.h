@@ -0,0 +1,40 @@
+/*! \file crc32.h
+*
+*  \brief CRC-32 (the zlib/ethernet polynomial) for checking records kept in flash
+*
+*
+*  \author Graham Riches
+*/
+
+#pragma once
+
+/********************************** Includes *******************************************/
+#include <cstddef>
+#include <cstdint>
+
+namespace os
+{
+/****************************** Functions Definition ***********************************/
+/**
+ * \brief compute the CRC-32 of a block, bit at a time. It's slow but needs no table, which suits the few hundred
+ *        byte records it checks, and it can carry on from an earlier block to cover data in pieces.
+ *
+ * \param data the data
+ * \param size size of the data in bytes
+ * \param crc the result for the data before this block, or 0 to start
+ * \retval uint32_t the CRC
+ */
+inline uint32_t crc32(const void* data, size_t size, uint32_t crc = 0) {
+    constexpr uint32_t reflected_polynomial = 0xEDB88320;
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    crc = ~crc;
+    for ( size_t index = 0; index < size; index++ ) {
+        crc ^= bytes[index];
+        for ( int bit = 0; bit < 8; bit++ ) {
+            crc = (crc >> 1) ^ ((crc & 0x01) ? reflected_polynomial : 0);
+        }
+    }
+    return ~crc;
+}
+
+};  // namespace os
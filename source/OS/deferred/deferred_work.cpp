@@ -0,0 +1,91 @@
+/**
+ * \file deferred_work.cpp
+ * \author Graham Riches (graham.riches@live.com)
+ * \brief deferred interrupt processing, run from a high priority os thread
+ * \version 0.1
+ * \date 2021-05-22
+ * 
+ * @copyright Copyright (c) 2021
+ * 
+ */
+
+/********************************** Includes *******************************************/
+#include "deferred_work.h"
+#include "scheduler.h"
+#include "thread_impl.h"
+
+namespace os
+{
+
+/********************************** Constants *******************************************/
+constexpr uint16_t deferred_work_thread_stack_size = 256;
+constexpr uint32_t deferred_work_thread_id = 0xFFFC;
+
+//!< shares the top priority with the timer thread so interrupt work is never held up by the application
+constexpr uint8_t deferred_work_thread_priority = thread::priority_levels - 1;
+
+/********************************** Function Declarations *******************************************/
+static void deferred_work_thread_task(void* arguments);
+
+/********************************** Local Variables *******************************************/
+CCM_RAM static uint32_t deferred_work_thread_stack[deferred_work_thread_stack_size] = {0};
+CCM_RAM static os::thread deferred_work_thread(deferred_work_thread_task, nullptr, deferred_work_thread_id, deferred_work_thread_stack,
+                                       deferred_work_thread_stack_size, deferred_work_thread_priority);
+
+/********************************** Function Definitions *******************************************/
+//!< create the deferred work singleton
+deferred_work::deferred_work()
+    : deferred_work_impl()
+    , work_pending(0, 1) { }
+
+//!< get a reference to the deferred work singleton
+deferred_work& deferred_work::get() {
+    static deferred_work service;
+    return service;
+}
+
+//!< register the deferred work thread
+void deferred_work::initialize() {
+    scheduler::register_new_thread(&deferred_work_thread);
+}
+
+//!< queue work from a thread
+bool deferred_work::submit(callback_pointer callback, void* context) {
+    auto& self = get();
+    if ( !self.deferred_work_impl::submit(callback, context) ) {
+        return false;
+    }
+    self.work_pending.signal();
+    return true;
+}
+
+//!< queue work from an interrupt
+bool deferred_work::submit_from_isr(callback_pointer callback, void* context) {
+    auto& self = get();
+    if ( !self.deferred_work_impl::submit(callback, context) ) {
+        return false;
+    }
+    self.work_pending.signal_from_isr();
+    return true;
+}
+
+//!< drain the queue, then sleep until something else is submitted. Work submitted after the queue is found
+//!< empty but before the wait leaves the semaphore set, so the next wait returns straight away.
+void deferred_work::run() {
+    while ( true ) {
+        run_pending();
+        work_pending.wait();
+    }
+}
+
+/**
+ * \brief deferred work thread entry point
+ * 
+ * \param arguments unused
+ */
+static void deferred_work_thread_task(void* arguments) {
+    PARAMETER_NOT_USED(arguments);
+    deferred_work::get().run();
+}
+
+};  // namespace os
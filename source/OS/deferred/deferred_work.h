@@ -0,0 +1,78 @@
+/**
+ * \file deferred_work.h
+ * \author Graham Riches (graham.riches@live.com)
+ * \brief deferred interrupt processing, run from a high priority os thread
+ * \version 0.1
+ * \date 2021-05-22
+ * 
+ * @copyright Copyright (c) 2021
+ * 
+ */
+
+#pragma once
+
+/********************************** Includes *******************************************/
+#include "deferred_work_impl.h"
+#include "os_semaphore.h"
+
+/********************************** Constants *******************************************/
+#ifndef OS_DEFERRED_WORK_QUEUE_SIZE
+#    define OS_DEFERRED_WORK_QUEUE_SIZE 16
+#endif
+
+namespace os
+{
+
+/**
+ * \brief singleton deferred work service. Interrupt handlers queue the slow half of their work here and a
+ *        daemon thread, which runs ahead of every application thread, works through it in order. The work
+ *        runs on the daemon's stack and can block, but that holds up everything queued behind it.
+ */
+class deferred_work : public deferred_work_impl<OS_DEFERRED_WORK_QUEUE_SIZE> {
+  public:
+    /**
+     * \brief singleton accessor for the deferred work service
+     * 
+     * \retval deferred_work& reference to the service
+     */
+    static deferred_work& get();
+
+    /**
+     * \brief register the deferred work thread with the scheduler. Call this before the kernel is entered.
+     */
+    static void initialize();
+
+    /**
+     * \brief queue work from a thread
+     * 
+     * \param callback the function to run
+     * \param context passed to the function
+     * \retval true if queued, false if the queue was full
+     */
+    static bool submit(callback_pointer callback, void* context);
+
+    /**
+     * \brief queue work from an interrupt handler
+     * 
+     * \param callback the function to run
+     * \param context passed to the function
+     * \retval true if queued, false if the queue was full
+     */
+    static bool submit_from_isr(callback_pointer callback, void* context);
+
+    /**
+     * \brief run the deferred work thread loop
+     */
+    [[noreturn]] void run();
+
+  private:
+    /**
+     * \brief Construct the deferred work service as a singleton instance
+     */
+    deferred_work();
+
+    //!< signalled on every submission. A binary count is enough as the thread drains the whole queue each pass.
+    semaphore work_pending;
+};
+
+};  // namespace os
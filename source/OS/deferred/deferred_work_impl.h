@@ -0,0 +1,81 @@
+/**
+ * \file deferred_work_impl.h
+ * \author Graham Riches (graham.riches@live.com)
+ * \brief internal OS implementation of the deferred interrupt work queue
+ * \version 0.1
+ * \date 2021-05-22
+ * 
+ * @copyright Copyright (c) 2021
+ * 
+ */
+
+#pragma once
+
+/********************************** Includes *******************************************/
+#include "common.h"
+#include "mpsc_queue.h"
+
+namespace os
+{
+
+/********************************** Types *******************************************/
+/**
+ * \brief queue of functions handed off by interrupt handlers to run later in thread context. Handlers only
+ *        push a function and its context, so they stay short and the work itself can be preempted.
+ * \note any number of threads and interrupts can submit at once, but only one thread may run the work
+ *
+ * \tparam N capacity of the queue, a power of two
+ */
+template <size_t N>
+class deferred_work_impl {
+  public:
+    using callback_pointer = void (*)(void* context);
+
+    /**
+     * \brief queue a function to run later. Safe to call from any thread or interrupt.
+     * 
+     * \param callback the function
+     * \param context passed to the function
+     * \retval true if queued, false if the queue was full and the work was dropped
+     */
+    bool submit(callback_pointer callback, void* context) {
+        if ( callback == nullptr ) {
+            return false;
+        }
+        return this->queue.push(work_item{callback, context});
+    }
+
+    /**
+     * \brief run every queued function, oldest first, including any queued while they run
+     * 
+     * \retval size_t number of functions run
+     */
+    size_t run_pending(void) {
+        size_t count = 0;
+        work_item item;
+        while ( this->queue.pop(item) ) {
+            item.callback(item.context);
+            count++;
+        }
+        return count;
+    }
+
+    /**
+     * \brief get the number of submissions dropped because the queue was full, and reset it
+     * 
+     * \retval uint32_t dropped submissions since the last call
+     */
+    uint32_t take_dropped_count(void) {
+        return this->queue.take_dropped_count();
+    }
+
+  private:
+    struct work_item {
+        callback_pointer callback;
+        void* context;
+    };
+
+    MPSCQueue<work_item, N> queue;
+};
+
+};  // namespace os
@@ -0,0 +1,72 @@
+/**
+ * \file events.cpp
+ * \author Graham Riches (graham.riches@live.com)
+ * \brief event flags group for application threads and interrupts
+ * \version 0.1
+ * \date 2021-05-12
+ * 
+ * @copyright Copyright (c) 2021
+ * 
+ */
+
+/********************************** Includes *******************************************/
+#include "events.h"
+#include "cm4_port.h"
+#include "scheduler.h"
+
+namespace os
+{
+
+/********************************** Function Definitions *******************************************/
+//!< construct an event group on the os scheduler
+event_flags::event_flags()
+    : event_flags_impl(&scheduler::get()) { }
+
+//!< wait for flags with no timeout
+uint32_t event_flags::wait(uint32_t mask, uint8_t options) {
+    return wait_for(mask, options, scheduler::wait_forever).value_or(0);
+}
+
+//!< wait for flags with a timeout
+std::optional<uint32_t> event_flags::wait_for(uint32_t mask, uint8_t options, uint32_t ticks) {
+    scheduler::TaskControlBlock* tcb;
+    {
+        critical_section critical;
+        auto current = try_wait(mask, options);
+        if ( current || (ticks == 0) ) {
+            return current;
+        }
+
+        tcb = scheduler::get_active_task_control_block();
+        block(mask, options, ticks);
+    }
+
+    /* the PendSV handler switches away as soon as the critical section ends, and this thread only runs again once
+       the flags are set or the wait has timed out */
+    if ( tcb->wait_timed_out ) {
+        return {};
+    }
+    return tcb->details->wait_flags;
+}
+
+//!< set flags from a thread
+uint32_t event_flags::set(uint32_t set_flags) {
+    critical_section critical;
+    return event_flags_impl::set(set_flags);
+}
+
+//!< set flags from an interrupt
+uint32_t event_flags::set_from_isr(uint32_t set_flags) {
+    uint32_t interrupt_mask = enter_critical_from_isr();
+    uint32_t current = event_flags_impl::set(set_flags);
+    exit_critical_from_isr(interrupt_mask);
+    return current;
+}
+
+//!< clear flags
+uint32_t event_flags::clear(uint32_t clear_flags) {
+    critical_section critical;
+    return event_flags_impl::clear(clear_flags);
+}
+
+};  // namespace os
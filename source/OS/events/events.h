@@ -0,0 +1,75 @@
+/**
+ * \file events.h
+ * \author Graham Riches (graham.riches@live.com)
+ * \brief event flags group for application threads and interrupts
+ * \version 0.1
+ * \date 2021-05-12
+ * 
+ * @copyright Copyright (c) 2021
+ * 
+ */
+
+#pragma once
+
+/********************************** Includes *******************************************/
+#include "events_impl.h"
+
+namespace os
+{
+
+/**
+ * \brief event flags group that blocks on the os scheduler. Every call runs in a critical section.
+ */
+class event_flags : public event_flags_impl {
+  public:
+    /**
+     * \brief Construct a new event flags group with every flag cleared
+     */
+    event_flags();
+
+    /**
+     * \brief wait for flags, suspending the calling thread until the wait is satisfied
+     * 
+     * \param mask the flags to wait for
+     * \param options event_options to match the flags with
+     * \retval uint32_t the flags when the wait was satisfied
+     */
+    uint32_t wait(uint32_t mask, uint8_t options = wait_any);
+
+    /**
+     * \brief wait for flags for up to a number of ticks
+     * 
+     * \param mask the flags to wait for
+     * \param options event_options to match the flags with
+     * \param ticks max ticks to wait (0 just checks the flags)
+     * \retval std::optional<uint32_t> the flags when the wait was satisfied, or empty on timeout
+     */
+    std::optional<uint32_t> wait_for(uint32_t mask, uint8_t options, uint32_t ticks);
+
+    /**
+     * \brief set flags from a thread, waking every thread whose wait is satisfied
+     * 
+     * \param set_flags the flags to set
+     * \retval uint32_t the flags after the set
+     */
+    uint32_t set(uint32_t set_flags);
+
+    /**
+     * \brief set flags from an interrupt handler. Any context switch this causes is deferred to the PendSV
+     *        handler, which runs once every active interrupt has returned.
+     * 
+     * \param set_flags the flags to set
+     * \retval uint32_t the flags after the set
+     */
+    uint32_t set_from_isr(uint32_t set_flags);
+
+    /**
+     * \brief clear flags
+     * 
+     * \param clear_flags the flags to clear
+     * \retval uint32_t the flags before they were cleared
+     */
+    uint32_t clear(uint32_t clear_flags);
+};
+
+};  // namespace os
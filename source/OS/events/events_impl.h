@@ -0,0 +1,192 @@
+/**
+ * \file events_impl.h
+ * \author Graham Riches (graham.riches@live.com)
+ * \brief internal OS implementation of a 32-bit event flags group
+ * \version 0.1
+ * \date 2021-05-12
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#pragma once
+
+/********************************** Includes *******************************************/
+#include "scheduler_impl.h"
+#include "wait_any_impl.h"
+#include <optional>
+
+
+namespace os
+{
+
+/********************************** Types *******************************************/
+/**
+ * \brief options for waiting on event flags, which can be or'ed together
+ */
+enum event_options : uint8_t {
+    wait_any = 0x00,       //!< wake when any of the requested flags is set
+    wait_all = 0x01,       //!< wake only when every requested flag is set
+    clear_on_exit = 0x02,  //!< clear the requested flags when the wait is satisfied
+};
+
+/**
+ * \brief group of 32 event flags that threads can wait on. Waiting threads are linked into an intrusive wait list
+ *        and keep their requested mask in their task control block, so a single set() can check and wake every
+ *        waiting thread at once.
+ * \note this is not interrupt safe by itself, callers must wrap each call in a critical section
+ */
+class event_flags_impl {
+  public:
+    /**
+     * \brief Construct a new event flags group with every flag cleared
+     *
+     * \param scheduler_ptr pointer to the scheduler to block on
+     */
+    explicit event_flags_impl(scheduler_impl* scheduler_ptr)
+        : flags(0)
+        , waiting_threads()
+        , watchers()
+        , scheduler_ptr(scheduler_ptr) { }
+
+    //!< disable moves and copies
+    event_flags_impl(const event_flags_impl& other) = delete;
+    event_flags_impl(event_flags_impl&& other) = delete;
+    event_flags_impl& operator = (const event_flags_impl& other) = delete;
+    event_flags_impl& operator = (event_flags_impl&& other) = delete;
+
+    /**
+     * \brief set flags and wake every waiting thread whose wait is now satisfied. Flags that a woken thread asked
+     *        to clear on exit are cleared once all the waiters have been checked, so every thread sees the same set.
+     *        Threads waiting on the group in wait_for_any() are woken if the flags left over satisfy them.
+     *
+     * \param set_flags the flags to set
+     * \retval uint32_t the flags after the set and any clears
+     */
+    uint32_t set(uint32_t set_flags) {
+        flags |= set_flags;
+
+        uint32_t clear_flags = 0;
+        bool woken = false;
+        auto tcb = waiting_threads.head;
+        while ( tcb != nullptr ) {
+            auto next = tcb->list_next;
+            if ( is_satisfied(tcb->details->wait_flags, tcb->details->wait_options) ) {
+                if ( tcb->details->wait_options & clear_on_exit ) {
+                    clear_flags |= tcb->details->wait_flags;
+                }
+                tcb->details->wait_flags = flags;
+                scheduler_ptr->wake_task(tcb);
+                woken = true;
+            }
+            tcb = next;
+        }
+
+        flags &= ~clear_flags;
+        watchers.notify(scheduler_ptr, [this](const wait_any_link& link) { return is_ready(link.mask, link.options); });
+        if ( woken ) {
+            scheduler_ptr->reschedule();
+        }
+        return flags;
+    }
+
+    /**
+     * \brief clear flags
+     *
+     * \param clear_flags the flags to clear
+     * \retval uint32_t the flags before they were cleared
+     */
+    uint32_t clear(uint32_t clear_flags) {
+        uint32_t previous = flags;
+        flags &= ~clear_flags;
+        return previous;
+    }
+
+    /**
+     * \brief get the current flags
+     *
+     * \retval uint32_t the flags
+     */
+    uint32_t get(void) const {
+        return flags;
+    }
+
+    /**
+     * \brief check the flags without blocking
+     *
+     * \param mask the flags to wait for
+     * \param options event_options to match the flags with
+     * \retval std::optional<uint32_t> the flags when the wait was satisfied, or empty if it wasn't
+     */
+    std::optional<uint32_t> try_wait(uint32_t mask, uint8_t options) {
+        if ( !is_satisfied(mask, options) ) {
+            return {};
+        }
+
+        uint32_t current = flags;
+        if ( options & clear_on_exit ) {
+            flags &= ~mask;
+        }
+        return current;
+    }
+
+    /**
+     * \brief suspend the active thread until the flags are set. Call this after try_wait() has failed.
+     * \note the context switch happens once the caller leaves its critical section. When the thread runs
+     *       again either its task control block has wait_timed_out set, or wait_flags holds the flags that woke it.
+     *
+     * \param mask the flags to wait for
+     * \param options event_options to match the flags with
+     * \param timeout_ticks ticks to wait before giving up, or scheduler_impl::wait_forever
+     */
+    void block(uint32_t mask, uint8_t options, uint32_t timeout_ticks = scheduler_impl::wait_forever) {
+        auto tcb = scheduler_ptr->get_active_tcb_ptr();
+        tcb->details->wait_flags = mask;
+        tcb->details->wait_options = options;
+        scheduler_ptr->block_active_task(&waiting_threads, timeout_ticks);
+    }
+
+    /**
+     * \brief check if any threads are blocked on the group
+     *
+     * \retval true/false
+     */
+    bool has_waiting_threads(void) const {
+        return (waiting_threads.head != nullptr);
+    }
+
+    /**
+     * \brief check if the current flags satisfy a wait, without clearing any. Used by wait_for_any().
+     *
+     * \param mask the flags to wait for
+     * \param options event_options to match the flags with
+     * \retval true/false
+     */
+    bool is_ready(uint32_t mask, uint8_t options) const {
+        return is_satisfied(mask, options);
+    }
+
+    /**
+     * \brief get the threads waiting on the group in wait_for_any()
+     *
+     * \retval wait_any_list& the waiters
+     */
+    wait_any_list& get_watchers(void) {
+        return watchers;
+    }
+
+  private:
+    /**
+     * \brief check if the current flags satisfy a wait
+     */
+    bool is_satisfied(uint32_t mask, uint8_t options) const {
+        return (options & wait_all) ? ((flags & mask) == mask) : ((flags & mask) != 0);
+    }
+
+    uint32_t flags;
+    scheduler_impl::TaskList waiting_threads;
+    wait_any_list watchers;
+    scheduler_impl* scheduler_ptr;
+};
+
+};  // namespace os
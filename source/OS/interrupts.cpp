@@ -14,25 +14,13 @@
 #include "os.h"
 #include "hal_interrupt.h"
 #include "cm4_port.h"
-
-/************************************ Types ********************************************/
-/**
- * \brief struct for storing stack context during a crash
- */
-#pragma pack(0)
-typedef struct {
-    uint32_t r0;
-    uint32_t r1;
-    uint32_t r2;
-    uint32_t r3;
-    uint32_t r12;
-    uint32_t lr;
-    uint32_t return_address;
-    uint32_t xpsr;
-} StackContext_t;
-#pragma pack(1)
+#include "crash_dump.h"
+#include "profiler.h"
+#include "trace.h"
 
 /*********************************** Macros ********************************************/
+#define CFSR_MMARVALID (1ul << 7)  //!< MemManage fault address register holds a valid address
+
 #define HALT_IF_DEBUGGING()                                   \
     do {                                                      \
         if ( (*(volatile uint32_t*)0xE000EDF0) & (1 << 0) ) { \
@@ -40,13 +28,30 @@ typedef struct {
         }                                                     \
     } while ( 0 )
 
+/**
+ * \brief common entry for the fault handlers. Passes the stack the exception frame was pushed to and the
+ *        exception return value on to a handler.
+ */
+#define FAULT_ENTRY(handler)                                                        \
+    __asm volatile("TST        LR, #4                   \n" /* check which stack */ \
+                   "ITE        EQ                       \n"                        \
+                   "MRSEQ      R0, MSP                  \n"                        \
+                   "MRSNE      R0, PSP                  \n"                        \
+                   "MOV        R1, LR                   \n"                        \
+                   "B          " #handler "\n")
+
 
 /****************************** Function Declarations ************************************/
 extern "C"
 {
-    void fault_handler(StackContext_t* context);
+    void fault_handler(uint32_t stack_pointer, uint32_t exc_return);
+    void memory_fault_handler(uint32_t stack_pointer, uint32_t exc_return);
 }
 
+/******************************** Global Variables **************************************/
+volatile uint32_t stack_overflow_thread_id;       //!< id of the thread that hit its MPU stack guard
+volatile uint32_t stack_overflow_fault_address;  //!< faulting data address if the MPU captured it
+
 /****************************** Functions Definitions - Includes Cortex M4 Interrupts ************************************/
 /**
  * \brief This function handles Non maskable interrupt
@@ -56,44 +61,54 @@ void NMI_Handler(void) { }
 /**
  * \brief This function handles Hard fault interrupt.
  */
-void HardFault_Handler(void) {
-    while ( 1 ) {
-        __asm volatile("tst lr, #4      \n"
-                       "ite eq          \n"
-                       "mrseq r0, msp   \n"
-                       "mrsne r0, psp   \n"
-                       "b fault_handler \n");
-    }
+__attribute__((naked)) void HardFault_Handler(void) {
+    FAULT_ENTRY(fault_handler);
 }
 
 /**
  * \brief This function handles Memory management fault.
  */
-void MemManage_Handler(void) {
-    while ( 1 ) {
-    }
+#ifdef OS_MPU_STACK_GUARD
+__attribute__((naked)) void MemManage_Handler(void) {
+    /* turn off the guard before anything else can fault on it, the handler itself runs on the main stack */
+    __asm volatile("LDR        R0, =0xE000ED94          \n" /* load the address of the MPU control register */
+                   "MOV        R1, #0                   \n"
+                   "STR        R1, [R0]                 \n" /* disable the MPU */
+                   "DSB                                 \n"
+                   "ISB                                 \n");
+    FAULT_ENTRY(memory_fault_handler);
+}
+#else
+__attribute__((naked)) void MemManage_Handler(void) {
+    FAULT_ENTRY(fault_handler);
 }
+#endif
 
 /**
  * \brief This function handles Pre-fetch fault, memory access fault.
  */
-void BusFault_Handler(void) {
-    while ( 1 ) {
-    }
+__attribute__((naked)) void BusFault_Handler(void) {
+    FAULT_ENTRY(fault_handler);
 }
 
 /**
  * \brief This function handles Undefined instruction or illegal state.
  */
-void UsageFault_Handler(void) {
-    while ( 1 ) {
-    }
+__attribute__((naked)) void UsageFault_Handler(void) {
+    FAULT_ENTRY(fault_handler);
 }
 
 /**
- * \brief This function handles System service call via SWI instruction.
+ * \brief kernel entry for SVC calls. Passes the caller's exception frame, from whichever stack it was
+ *        pushed to, on to the OS dispatcher.
  */
-void SVC_Handler(void) { }
+__attribute__((naked)) void SVC_Handler(void) {
+    __asm volatile("TST        LR, #4                   \n" /* check which stack the caller was using */
+                   "ITE        EQ                       \n"
+                   "MRSEQ      R0, MSP                  \n"
+                   "MRSNE      R0, PSP                  \n"
+                   "B          os_svc_handler           \n");
+}
 
 /**
  * \brief This function handles Debug monitor.
@@ -104,24 +119,66 @@ void DebugMon_Handler(void) { }
  * \brief Handling threading context switches which are triggered by the scheduler as pending
  *        system calls. This allows the SysTick interrupt to run at a high priority while the 
  *        context switching can be handled at a lower level.
+ * \note  EXC_RETURN bit 4 is clear when the outgoing thread has an active FPU context. Only those threads
+ *        save and restore S16-S31, lazy stacking (FPCCR.LSPEN) takes care of S0-S15 and the FPSCR, so
+ *        integer only threads keep the cheaper switch path.
+ * \note  threads run on the process stack, so their context is saved there while the handler itself runs on
+ *        the main stack. Each thread's privilege level (CONTROL.nPRIV) is saved along with its registers.
  */
-__attribute__((naked)) void PendSV_Handler(void) {   
+__attribute__((naked)) RAM_FUNCTION void PendSV_Handler(void) {   
     using namespace os;
 
     __asm(
-        "CPSID      I                        \n" /* disable interrupts */
-        "PUSH       {R4-R11}                 \n" /* push the remaining core registers */
-        "LDR        R0, =system_active_task  \n" /* load the active task pointer into */
-        "LDR        R1, [R0]                 \n" /* dereference the pointer */
-        "MOV        R4, SP                   \n" /* stash the current stack pointer */
-        "STR        R4, [R1]                 \n" /* update the pointer to the current thread task with the current stack pointer */
-        "LDR        R1, =system_pending_task \n" /* get the next task pointer */
+        "MOV        R0, #" OS_STRINGIFY(OS_KERNEL_BASEPRI) " \n"
+        "MSR        BASEPRI, R0              \n" /* mask the kernel interrupts */
+        "ISB                                 \n"
+#ifdef OS_PROFILING
+        "LDR        R0, =0xE0001004          \n" /* load the address of the DWT cycle counter */
+        "LDR        R0, [R0]                 \n" /* read the cycle count */
+        "LDR        R1, =os_context_switch_start_cycles \n"
+        "STR        R0, [R1]                 \n" /* stamp the start of the context switch */
+#endif
+        "MRS        R0, PSP                  \n" /* get the outgoing thread's stack pointer */
+        "TST        LR, #0x10                \n" /* check if the thread was using the FPU */
+        "IT         EQ                       \n"
+        "VSTMDBEQ   R0!, {S16-S31}           \n" /* push the callee saved FPU registers */
+        "MRS        R3, CONTROL              \n" /* get the thread's privilege level */
+        "AND        R3, R3, #1               \n"
+        "STMDB      R0!, {R3-R11, LR}        \n" /* push it with the remaining core registers and the exception return value */
+        "LDR        R1, =system_active_task  \n" /* load the active task pointer */
         "LDR        R2, [R1]                 \n" /* dereference the pointer */
-        "STR        R2, [R0]                 \n" /* update the active thread to be the pending thread */        
-        "LDR        R4, [R2]                 \n" /* get the new stack pointer by dereferencing the original pointer */
-        "MOV        SP, R4                   \n" /* push it to the CPU stack pointer register */
-        "POP        {R4-R11}                 \n" /* pop the stored registers */
-        "CPSIE      I                        \n" /* re-enable interrupts */
+        "STR        R0, [R2]                 \n" /* update the pointer to the current thread task with its stack pointer */
+        "LDR        R3, =system_pending_task \n" /* get the next task pointer */
+        "LDR        R2, [R3]                 \n" /* dereference the pointer */
+        "STR        R2, [R1]                 \n" /* update the active thread to be the pending thread */        
+#ifdef OS_MPU_STACK_GUARD
+        "PUSH       {R2, R3}                 \n" /* save the new task pointer, keeping the stack 8-byte aligned */
+        "BL         os_configure_stack_guard \n" /* move the MPU guard region to the new thread's stack */
+        "POP        {R2, R3}                 \n"
+#endif
+        "LDR        R0, [R2]                 \n" /* get the new stack pointer by dereferencing the original pointer */
+        "LDMIA      R0!, {R3-R11, LR}        \n" /* pop the privilege level, core registers and exception return value */
+        "TST        LR, #0x10                \n" /* check if the thread was using the FPU */
+        "IT         EQ                       \n"
+        "VLDMIAEQ   R0!, {S16-S31}           \n" /* pop the callee saved FPU registers */
+        "MSR        PSP, R0                  \n" /* the exception return unstacks the rest from the process stack */
+        "MRS        R1, CONTROL              \n"
+        "BIC        R1, R1, #1               \n"
+        "ORR        R1, R1, R3               \n"
+        "MSR        CONTROL, R1              \n" /* restore the thread's privilege level */
+        "ISB                                 \n"
+#ifdef OS_PROFILING
+        "PUSH       {R0, LR}                 \n" /* keep the stack 8-byte aligned around the call */
+        "BL         os_profile_context_switch \n" /* record the switch length */
+        "POP        {R0, LR}                 \n"
+#endif
+#ifdef OS_TRACE
+        "PUSH       {R0, LR}                 \n"
+        "BL         os_trace_context_switch  \n" /* trace the thread being switched in */
+        "POP        {R0, LR}                 \n"
+#endif
+        "MOV        R2, #0                   \n"
+        "MSR        BASEPRI, R2              \n" /* unmask, PendSV only runs when nothing was masked */
         "BX         LR                       \n" /* return */
     );
 }
@@ -131,11 +188,28 @@ __attribute__((naked)) void PendSV_Handler(void) {
  *        The scheduler will raise a PendSV interrupt flag if any thread context switches are 
  *        required.
  */
-void SysTick_Handler(void) {
-    DISABLE_INTERRUPTS();
+RAM_FUNCTION void SysTick_Handler(void) {
+    os::critical_section critical;
+#ifdef OS_TRACE
+    os::os_trace_isr_enter();
+#endif
+#ifdef OS_IRQ_PROFILING
+    uint32_t entry_cycles = os::os_irq_profile_enter();
+#endif
+#ifdef OS_PROFILING
+    uint32_t start_cycles = os::profiler::get_cycles();
+#endif
     os::system_clock::update_sytem_ticks(1);
     os::scheduler::update();
-    ENABLE_INTERRUPTS();  
+#ifdef OS_PROFILING
+    os::profiler::record_tick(start_cycles);
+#endif
+#ifdef OS_IRQ_PROFILING
+    os::os_irq_profile_exit(entry_cycles);
+#endif
+#ifdef OS_TRACE
+    os::os_trace_isr_exit();
+#endif
 }
 
 /**
@@ -143,16 +217,48 @@ void SysTick_Handler(void) {
 *        which calls the appropriate IRQ which is generally registered to a specific object.
 */
 void IRQHandler(void) {
+#ifdef OS_TRACE
+    os::os_trace_isr_enter();
+#endif
+#ifdef OS_IRQ_PROFILING
+    uint32_t entry_cycles = os::os_irq_profile_enter();
+    HAL::interrupt_manager.default_isr_handler();
+    os::os_irq_profile_exit(entry_cycles);
+#else
     HAL::interrupt_manager.default_isr_handler();
+#endif
+#ifdef OS_TRACE
+    os::os_trace_isr_exit();
+#endif
 }
 
 /**
- * \brief custom hardfault handler to save the register state
+ * \brief custom fault handler. Halts for the debugger if one is attached, then saves a crash dump to flash and
+ *        resets. The fault is told apart by the active exception number.
  * 
- * \param context register context
+ * \param stack_pointer stack holding the exception frame
+ * \param exc_return exception return value from the fault handler's link register
  * \note this should not be optimized ***
  */
-__attribute__((optimize("O0"))) void fault_handler(StackContext_t* context) {
-    PARAMETER_NOT_USED(context);
+__attribute__((optimize("O0"), used)) void fault_handler(uint32_t stack_pointer, uint32_t exc_return) {
+    HALT_IF_DEBUGGING();
+    auto fault = static_cast<os::fault_type>(SCB->ICSR & SCB_ICSR_VECTACTIVE_Msk);
+    os::crash_dump::save_and_reset(fault, stack_pointer, exc_return);
+}
+
+/**
+ * \brief memory management fault handler for MPU stack guard hits. Records the active thread id and
+ *        the faulting address for the debugger, halts, and then saves a crash dump and resets.
+ * 
+ * \param stack_pointer stack holding the exception frame
+ * \param exc_return exception return value from the fault handler's link register
+ * \note this should not be optimized ***
+ */
+__attribute__((optimize("O0"), used)) void memory_fault_handler(uint32_t stack_pointer, uint32_t exc_return) {
+    stack_overflow_thread_id = os::system_active_task->thread_ptr->get_id();
+    if ( SCB->CFSR & CFSR_MMARVALID ) {
+        stack_overflow_fault_address = SCB->MMFAR;
+    }
     HALT_IF_DEBUGGING();
+    os::crash_dump::save_and_reset(os::fault_type::memory_fault, stack_pointer, exc_return);
 }
@@ -0,0 +1,126 @@
+/**
+ * \file kv_store.cpp
+ * \author Graham Riches (graham.riches@live.com)
+ * \brief settings store over the two flash sectors the linker script reserves for it
+ * \version 0.1
+ * \date 2021-06-09
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+/********************************** Includes *******************************************/
+#include "kv_store.h"
+#include "hal_flash.h"
+#include "mutex.h"
+#include <cstdint>
+
+/********************************** Linker Symbols *******************************************/
+extern "C" {
+extern uint32_t _kv_store_start[];  //!< start of the two sectors the linker script reserves for the store
+extern uint32_t _kv_store_end[];
+}
+
+namespace os
+{
+/********************************** Constants *******************************************/
+constexpr uint8_t kv_store_first_sector = 9;  //!< must match the KV_STORE region in the linker script
+
+/********************************** Types *******************************************/
+/**
+ * \brief the reserved flash sectors, as seen by the store
+ */
+class kv_store_sector_device {
+  public:
+    size_t get_sector_words(void) const {
+        return static_cast<size_t>(_kv_store_end - _kv_store_start) / 2;
+    }
+
+    const uint32_t* get_words(size_t sector) const {
+        return _kv_store_start + (sector * this->get_sector_words());
+    }
+
+    bool erase(size_t sector) {
+        HAL::flash.unlock();
+        bool erased = HAL::flash.erase_sector(static_cast<uint8_t>(kv_store_first_sector + sector));
+        HAL::flash.lock();
+        return erased;
+    }
+
+    bool program(size_t sector, size_t index, uint32_t value) {
+        uint32_t address = static_cast<uint32_t>(reinterpret_cast<std::uintptr_t>(this->get_words(sector) + index));
+        HAL::flash.unlock();
+        bool programmed = HAL::flash.program_word(address, value);
+        HAL::flash.lock();
+        return programmed;
+    }
+};
+
+/********************************** Local Variables *******************************************/
+static kv_store_sector_device sector_device;
+static kv_store_impl<kv_store_sector_device, OS_KV_STORE_MAX_KEYS> store(sector_device);
+static mutex store_lock;
+
+/********************************** Function Definitions *******************************************/
+//!< mount the store, the kernel isn't running yet so there's nothing to lock out
+bool kv_store::initialize(void) {
+    return store.mount();
+}
+
+//!< read a value
+size_t kv_store::read(uint16_t key, void* buffer, size_t size) {
+    store_lock.lock();
+    size_t stored = store.read(key, buffer, size);
+    store_lock.unlock();
+    return stored;
+}
+
+//!< write a value
+bool kv_store::write(uint16_t key, const void* data, size_t size) {
+    store_lock.lock();
+    bool written = store.write(key, data, size);
+    store_lock.unlock();
+    return written;
+}
+
+//!< remove a key
+bool kv_store::remove(uint16_t key) {
+    store_lock.lock();
+    bool removed = store.remove(key);
+    store_lock.unlock();
+    return removed;
+}
+
+//!< count the keys
+size_t kv_store::get_key_count(void) {
+    store_lock.lock();
+    size_t count = store.get_key_count();
+    store_lock.unlock();
+    return count;
+}
+
+//!< get a key and its value size
+bool kv_store::get_key(size_t position, uint16_t& key, size_t& size) {
+    store_lock.lock();
+    bool found = store.get_key(position, key, size);
+    store_lock.unlock();
+    return found;
+}
+
+//!< get the room left in the active sector
+size_t kv_store::get_free_bytes(void) {
+    store_lock.lock();
+    size_t free_bytes = store.get_free_bytes();
+    store_lock.unlock();
+    return free_bytes;
+}
+
+//!< get the compaction count
+uint32_t kv_store::get_generation(void) {
+    store_lock.lock();
+    uint32_t generation = store.get_generation();
+    store_lock.unlock();
+    return generation;
+}
+
+};  // namespace os
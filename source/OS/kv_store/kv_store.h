@@ -0,0 +1,102 @@
+/**
+ * \file kv_store.h
+ * \author Graham Riches (graham.riches@live.com)
+ * \brief persistent key-value store for settings, kept in two reserved flash sectors
+ * \version 0.1
+ * \date 2021-06-09
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#pragma once
+
+/********************************** Includes *******************************************/
+#include "kv_store_impl.h"
+
+/********************************** Constants *******************************************/
+/**
+ * \brief most keys the store holds, each costs 8 bytes of RAM for its index entry
+ */
+#ifndef OS_KV_STORE_MAX_KEYS
+#    define OS_KV_STORE_MAX_KEYS 32
+#endif
+
+namespace os
+{
+/**
+ * \brief settings store in flash sectors 9 and 10, which the linker script reserves. Reads come straight from
+ *        flash and are cheap. Writes program a few words, but once a sector fills, the next write erases the other
+ *        one, and everything running from flash stalls for a second or two while it does. The calls are thread
+ *        safe, but only call them from threads.
+ */
+class kv_store {
+  public:
+    /**
+     * \brief mount the store, formatting it on the first boot. Call this before the kernel is entered.
+     *
+     * \retval true if the store is ready
+     */
+    static bool initialize(void);
+
+    /**
+     * \brief read the value of a key
+     *
+     * \param key the key
+     * \param buffer where to copy the value
+     * \param size size of the buffer, a longer value is cut short
+     * \retval size_t size of the stored value, or 0 if the key isn't set
+     */
+    static size_t read(uint16_t key, void* buffer, size_t size);
+
+    /**
+     * \brief set the value of a key
+     *
+     * \param key the key
+     * \param data the value
+     * \param size size of the value, 1 to kv_max_value_size bytes
+     * \retval true if the value was stored
+     */
+    static bool write(uint16_t key, const void* data, size_t size);
+
+    /**
+     * \brief remove a key
+     *
+     * \param key the key
+     * \retval true if the key is no longer set
+     */
+    static bool remove(uint16_t key);
+
+    /**
+     * \brief get the number of keys set
+     *
+     * \retval size_t key count
+     */
+    static size_t get_key_count(void);
+
+    /**
+     * \brief get one of the keys that are set
+     *
+     * \param position which key, 0 to get_key_count() - 1
+     * \param key the key
+     * \param size size of its value
+     * \retval true if there is a key at that position
+     */
+    static bool get_key(size_t position, uint16_t& key, size_t& size);
+
+    /**
+     * \brief get the number of bytes that can be appended before the next compaction
+     *
+     * \retval size_t free bytes
+     */
+    static size_t get_free_bytes(void);
+
+    /**
+     * \brief get the number of times the store has been compacted
+     *
+     * \retval uint32_t generation
+     */
+    static uint32_t get_generation(void);
+};
+
+};  // namespace os
@@ -0,0 +1,437 @@
+/**
+ * \file kv_store_impl.h
+ * \author Graham Riches (graham.riches@live.com)
+ * \brief internal OS implementation of the log structured key-value store kept in flash
+ * \version 0.1
+ * \date 2021-06-09
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#pragma once
+
+/********************************** Includes *******************************************/
+#include "crc32.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace os
+{
+/********************************** Constants *******************************************/
+constexpr size_t kv_max_value_size = 256;        //!< largest value the store takes, in bytes
+constexpr uint16_t kv_erased_key = 0xFFFF;       //!< not a valid key, it's what an erased header reads as
+constexpr uint32_t kv_erased_word = 0xFFFFFFFF;  //!< value of an erased flash word
+constexpr uint32_t kv_sector_marker = 0x4B565331;  //!< first word of a sector holding the live log
+
+/**
+ * \brief log structured key-value store over two flash sectors. Writes append a new entry to the active sector
+ *        and the latest entry for a key wins, so changing a value costs a few programmed words rather than an
+ *        erase. When the active sector fills, the live entries are copied to the other sector and that sector
+ *        becomes active, so the two take turns being erased and wear evenly.
+ *
+ *        Each sector starts with a marker and a generation count, and the sector with the newest generation is the
+ *        active one. A compaction copies the live entries along with the value being written, and writes the new
+ *        sector's header last, so a compaction cut off by a reset leaves the old sector in charge. Each entry is a
+ *        header word holding the key and value size, a CRC-32 of the header and value, then the value padded out
+ *        to whole words. An entry cut off by a reset fails its CRC and is skipped. A value size of 0 marks a removed key, so empty values can't be stored.
+ *
+ *        The latest location of each key is kept in RAM, so reads never scan the flash.
+ * \note this is not thread safe by itself
+ *
+ * \tparam Device the pair of flash sectors. It needs:
+ *         - size_t get_sector_words() const, the size of each sector in words
+ *         - const uint32_t* get_words(size_t sector) const, the contents of sector 0 or 1
+ *         - bool erase(size_t sector), to set every word of a sector to kv_erased_word
+ *         - bool program(size_t sector, size_t index, uint32_t value), to program the word at an index
+ * \tparam MaxKeys most keys the store can hold
+ */
+template <typename Device, size_t MaxKeys>
+class kv_store_impl {
+  public:
+    /**
+     * \brief Construct a new key-value store. Mount it before using it.
+     *
+     * \param device the flash sectors to keep the log in
+     */
+    explicit kv_store_impl(Device& device)
+        : device(device)
+        , index()
+        , key_count(0)
+        , active(0)
+        , write_position(0)
+        , generation(0)
+        , mounted(false) { }
+
+    //!< delete copies and moves
+    kv_store_impl(const kv_store_impl& other) = delete;
+    kv_store_impl(kv_store_impl&& other) = delete;
+    kv_store_impl& operator = (const kv_store_impl& other) = delete;
+    kv_store_impl& operator = (kv_store_impl&& other) = delete;
+
+    /**
+     * \brief find the active sector and index its entries, formatting the first sector if neither holds a log
+     *
+     * \retval true if the store is ready
+     */
+    bool mount(void) {
+        this->mounted = false;
+        bool valid[2] = {this->is_sector_valid(0), this->is_sector_valid(1)};
+        if ( !valid[0] && !valid[1] ) {
+            if ( !this->format(0, 1) ) {
+                return false;
+            }
+            this->active = 0;
+            this->generation = 1;
+        } else if ( valid[0] && valid[1] ) {
+            this->active = (this->get_sector_generation(1) > this->get_sector_generation(0)) ? 1 : 0;
+            this->generation = this->get_sector_generation(this->active);
+        } else {
+            this->active = valid[0] ? 0 : 1;
+            this->generation = this->get_sector_generation(this->active);
+        }
+
+        this->scan();
+        this->mounted = true;
+        return true;
+    }
+
+    /**
+     * \brief read the value of a key
+     *
+     * \param key the key
+     * \param buffer where to copy the value
+     * \param size size of the buffer, a longer value is cut short
+     * \retval size_t size of the stored value, or 0 if the key isn't set
+     */
+    size_t read(uint16_t key, void* buffer, size_t size) const {
+        const index_entry* entry = this->find(key);
+        if ( entry == nullptr ) {
+            return 0;
+        }
+        const uint32_t* words = this->device.get_words(this->active) + entry->offset + entry_header_words;
+        std::memcpy(buffer, words, (size < entry->size) ? size : entry->size);
+        return entry->size;
+    }
+
+    /**
+     * \brief set the value of a key. Writing the value a key already holds doesn't touch the flash.
+     *
+     * \param key the key, anything but kv_erased_key
+     * \param data the value
+     * \param size size of the value, 1 to kv_max_value_size bytes
+     * \retval true if the value was stored
+     */
+    bool write(uint16_t key, const void* data, size_t size) {
+        if ( !this->mounted || (key == kv_erased_key) || (size == 0) || (size > kv_max_value_size) ) {
+            return false;
+        }
+
+        const index_entry* existing = this->find(key);
+        if ( existing != nullptr ) {
+            const uint32_t* words = this->device.get_words(this->active) + existing->offset + entry_header_words;
+            if ( (existing->size == size) && (std::memcmp(words, data, size) == 0) ) {
+                return true;
+            }
+        } else if ( this->key_count == MaxKeys ) {
+            return false;
+        }
+
+        size_t entry_words = get_entry_words(size);
+        if ( (this->write_position + entry_words) > this->device.get_sector_words() ) {
+            /* the new value goes into the compacted sector with the rest, so the key is never left out of both */
+            return this->compact(key, data, size);
+        }
+
+        size_t offset = this->write_position;
+        this->write_position += entry_words;
+        if ( !this->append(this->active, offset, key, data, size) ) {
+            return false;
+        }
+        this->update_index(key, offset, size);
+        return true;
+    }
+
+    /**
+     * \brief remove a key
+     *
+     * \param key the key
+     * \retval true if the key is no longer set
+     */
+    bool remove(uint16_t key) {
+        if ( !this->mounted ) {
+            return false;
+        }
+        if ( this->find(key) == nullptr ) {
+            return true;
+        }
+
+        if ( (this->write_position + entry_header_words) > this->device.get_sector_words() ) {
+            /* compacting without the key drops it, there's nothing left to mark */
+            return this->compact(key, nullptr, 0);
+        }
+
+        size_t offset = this->write_position;
+        this->write_position += entry_header_words;
+        if ( !this->append(this->active, offset, key, nullptr, 0) ) {
+            return false;
+        }
+        this->update_index(key, offset, 0);
+        return true;
+    }
+
+    /**
+     * \brief get the number of keys set
+     *
+     * \retval size_t key count
+     */
+    size_t get_key_count(void) const {
+        return this->key_count;
+    }
+
+    /**
+     * \brief get one of the keys that are set
+     *
+     * \param position which key, 0 to get_key_count() - 1
+     * \param key the key
+     * \param size size of its value
+     * \retval true if there is a key at that position
+     */
+    bool get_key(size_t position, uint16_t& key, size_t& size) const {
+        if ( position >= this->key_count ) {
+            return false;
+        }
+        key = this->index[position].key;
+        size = this->index[position].size;
+        return true;
+    }
+
+    /**
+     * \brief get the number of bytes that can be appended before the next compaction
+     *
+     * \retval size_t free bytes, including the entry headers
+     */
+    size_t get_free_bytes(void) const {
+        return (this->device.get_sector_words() - this->write_position) * sizeof(uint32_t);
+    }
+
+    /**
+     * \brief get the generation of the active sector, which counts the compactions
+     *
+     * \retval uint32_t generation
+     */
+    uint32_t get_generation(void) const {
+        return this->generation;
+    }
+
+    /**
+     * \brief check if the store mounted
+     *
+     * \retval true/false
+     */
+    bool is_mounted(void) const {
+        return this->mounted;
+    }
+
+  private:
+    static constexpr size_t sector_header_words = 2;
+    static constexpr size_t entry_header_words = 2;
+
+    struct index_entry {
+        uint16_t key;
+        uint16_t size;
+        uint32_t offset;  //!< word offset of the entry header in the active sector
+    };
+
+    static size_t get_entry_words(size_t size) {
+        return entry_header_words + ((size + sizeof(uint32_t) - 1) / sizeof(uint32_t));
+    }
+
+    static uint32_t get_entry_crc(uint32_t header, const void* data, size_t size) {
+        return crc32(data, size, crc32(&header, sizeof(header)));
+    }
+
+    bool is_sector_valid(size_t sector) const {
+        const uint32_t* words = this->device.get_words(sector);
+        return (words[0] == kv_sector_marker) && (words[1] != kv_erased_word);
+    }
+
+    uint32_t get_sector_generation(size_t sector) const {
+        return this->device.get_words(sector)[1];
+    }
+
+    /**
+     * \brief erase a sector and write its header, the marker last so it only counts once it's complete
+     */
+    bool format(size_t sector, uint32_t sector_generation) {
+        return this->device.erase(sector) && this->device.program(sector, 1, sector_generation) &&
+               this->device.program(sector, 0, kv_sector_marker);
+    }
+
+    /**
+     * \brief walk the active sector's log to build the index and find the end of it. A header that can't be
+     *        right means the rest of the sector can't be trusted, so it counts as full and the next write compacts.
+     */
+    void scan(void) {
+        const uint32_t* words = this->device.get_words(this->active);
+        size_t sector_words = this->device.get_sector_words();
+        this->key_count = 0;
+        this->write_position = sector_header_words;
+
+        while ( this->write_position < sector_words ) {
+            uint32_t header = words[this->write_position];
+            if ( header == kv_erased_word ) {
+                return;
+            }
+
+            uint16_t key = static_cast<uint16_t>(header & 0xFFFF);
+            size_t size = header >> 16;
+            size_t entry_words = get_entry_words(size);
+            if ( (key == kv_erased_key) || (size > kv_max_value_size) || ((this->write_position + entry_words) > sector_words) ) {
+                this->write_position = sector_words;
+                return;
+            }
+
+            const uint32_t* value = &words[this->write_position + entry_header_words];
+            if ( words[this->write_position + 1] == get_entry_crc(header, value, size) ) {
+                this->update_index(key, this->write_position, size);
+            }
+            this->write_position += entry_words;
+        }
+    }
+
+    /**
+     * \brief program an entry
+     */
+    bool append(size_t sector, size_t offset, uint16_t key, const void* data, size_t size) {
+        uint32_t header = (static_cast<uint32_t>(size) << 16) | key;
+        if ( !this->device.program(sector, offset, header) ||
+             !this->device.program(sector, offset + 1, get_entry_crc(header, data, size)) ) {
+            return false;
+        }
+
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        for ( size_t position = 0; position < size; position += sizeof(uint32_t) ) {
+            uint32_t word = kv_erased_word;
+            size_t count = ((size - position) < sizeof(uint32_t)) ? (size - position) : sizeof(uint32_t);
+            std::memcpy(&word, &bytes[position], count);
+            if ( !this->device.program(sector, offset + entry_header_words + (position / sizeof(uint32_t)), word) ) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * \brief copy the live entries to the other sector with a new value for one key, and switch to it
+     *
+     * \param key the key being rewritten or removed, its old entry is left behind
+     * \param data the key's new value
+     * \param size size of the new value, 0 removes the key
+     * \retval true if the entries were moved and the new value stored
+     */
+    bool compact(uint16_t key, const void* data, size_t size) {
+        size_t live_words = sector_header_words;
+        for ( size_t position = 0; position < this->key_count; position++ ) {
+            if ( this->index[position].key != key ) {
+                live_words += get_entry_words(this->index[position].size);
+            }
+        }
+        if ( size > 0 ) {
+            live_words += get_entry_words(size);
+        }
+        if ( live_words > this->device.get_sector_words() ) {
+            return false;
+        }
+
+        size_t target = 1 - this->active;
+        if ( !this->device.erase(target) ) {
+            return false;
+        }
+
+        const uint32_t* source = this->device.get_words(this->active);
+        uint32_t new_offsets[MaxKeys];
+        size_t offset = sector_header_words;
+        for ( size_t position = 0; position < this->key_count; position++ ) {
+            const index_entry& entry = this->index[position];
+            if ( entry.key == key ) {
+                continue;
+            }
+            new_offsets[position] = static_cast<uint32_t>(offset);
+            for ( size_t word = 0; word < get_entry_words(entry.size); word++ ) {
+                if ( !this->device.program(target, offset++, source[entry.offset + word]) ) {
+                    return false;
+                }
+            }
+        }
+
+        size_t entry_offset = offset;
+        if ( size > 0 ) {
+            if ( !this->append(target, entry_offset, key, data, size) ) {
+                return false;
+            }
+            offset += get_entry_words(size);
+        }
+
+        /* the new sector takes over once its header is complete, by which point it holds everything */
+        if ( !this->device.program(target, 1, this->generation + 1) || !this->device.program(target, 0, kv_sector_marker) ) {
+            return false;
+        }
+
+        this->active = target;
+        this->generation++;
+        this->write_position = offset;
+        size_t kept = 0;
+        for ( size_t position = 0; position < this->key_count; position++ ) {
+            if ( this->index[position].key != key ) {
+                this->index[kept] = this->index[position];
+                this->index[kept].offset = new_offsets[position];
+                kept++;
+            }
+        }
+        this->key_count = kept;
+        if ( size > 0 ) {
+            this->update_index(key, entry_offset, size);
+        }
+        return true;
+    }
+
+    const index_entry* find(uint16_t key) const {
+        for ( size_t position = 0; position < this->key_count; position++ ) {
+            if ( this->index[position].key == key ) {
+                return &this->index[position];
+            }
+        }
+        return nullptr;
+    }
+
+    /**
+     * \brief point a key at its latest entry, a size of zero removes it
+     */
+    void update_index(uint16_t key, size_t offset, size_t size) {
+        for ( size_t position = 0; position < this->key_count; position++ ) {
+            if ( this->index[position].key == key ) {
+                if ( size == 0 ) {
+                    this->index[position] = this->index[--this->key_count];
+                } else {
+                    this->index[position] = {key, static_cast<uint16_t>(size), static_cast<uint32_t>(offset)};
+                }
+                return;
+            }
+        }
+        if ( (size > 0) && (this->key_count < MaxKeys) ) {
+            this->index[this->key_count++] = {key, static_cast<uint16_t>(size), static_cast<uint32_t>(offset)};
+        }
+    }
+
+    Device& device;
+    index_entry index[MaxKeys];
+    size_t key_count;
+    size_t active;          //!< sector holding the live log
+    size_t write_position;  //!< word offset of the next entry in the active sector
+    uint32_t generation;
+    bool mounted;
+};
+
+};  // namespace os
@@ -0,0 +1,131 @@
+/**
+ * \file log.cpp
+ * \author Graham Riches (graham.riches@live.com)
+ * \brief deferred logging. Call sites queue binary records and the os log thread formats them.
+ * \version 0.1
+ * \date 2021-05-18
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+/********************************** Includes *******************************************/
+#include "log.h"
+#include "scheduler.h"
+#include "thread_impl.h"
+#include <cinttypes>
+
+namespace os
+{
+
+/********************************** Constants *******************************************/
+constexpr uint16_t log_thread_stack_size = 512;  //!< snprintf needs a deep stack
+constexpr uint32_t log_thread_id = 0xFFFD;
+constexpr uint32_t microseconds_per_second = 1000000;
+
+//!< formatting is the least urgent work in the system
+constexpr uint8_t log_thread_priority = 0;
+
+//!< printed tag for each log level
+static constexpr const char* level_tags[] = {"DEBUG", "INFO", "WARNING", "ERROR"};
+
+/********************************** Function Declarations *******************************************/
+static void log_thread_task(void* arguments);
+
+/********************************** Local Variables *******************************************/
+CCM_RAM static uint32_t log_thread_stack[log_thread_stack_size] = {0};
+CCM_RAM static os::thread log_thread(log_thread_task, nullptr, log_thread_id, log_thread_stack, log_thread_stack_size,
+                             log_thread_priority);
+
+/********************************** Function Definitions *******************************************/
+//!< create the logger singleton
+logger::logger()
+    : queue()
+    , filter()
+    , routes()
+    , route_count(0)
+    , line() { }
+
+//!< get a reference to the logger singleton
+logger& logger::get() {
+    static logger instance;
+    return instance;
+}
+
+//!< register the log thread. It runs privileged since sinks like the ITM write to core peripherals.
+void logger::initialize() {
+    log_thread.set_privileged(true);
+    scheduler::register_new_thread(&log_thread);
+}
+
+//!< add a sink to the routing table
+bool logger::add_sink(log_sink* sink, log_level minimum_level) {
+    auto& self = get();
+    if ( self.route_count >= max_sinks ) {
+        return false;
+    }
+    self.routes[self.route_count++] = {sink, minimum_level};
+    return true;
+}
+
+//!< format and write every queued message, then sleep until the next flush
+void logger::run() {
+    log_record record;
+    while ( true ) {
+        while ( queue.pop(record) ) {
+            write_line(record);
+        }
+
+        if ( uint32_t dropped = queue.take_dropped_count(); dropped > 0 ) {
+            int length = snprintf(line, sizeof(line), "WARNING: %" PRIu32 " log messages dropped\r\n", dropped);
+            route(log_level::warning, line, static_cast<size_t>(length));
+        }
+
+        scheduler::sleep(flush_period_ticks);
+    }
+}
+
+//!< format a record as a timestamped, tagged line and write it to the sink
+void logger::write_line(const log_record& record) {
+    /* skip the formatting altogether if no sink takes the message */
+    bool routed = false;
+    for ( size_t index = 0; index < route_count; index++ ) {
+        routed = routed || (record.level >= routes[index].minimum_level);
+    }
+    if ( !routed ) {
+        return;
+    }
+
+    uint32_t seconds = static_cast<uint32_t>(record.timestamp / microseconds_per_second);
+    uint32_t microseconds = static_cast<uint32_t>(record.timestamp % microseconds_per_second);
+    int prefix = snprintf(line, sizeof(line), "%5" PRIu32 ".%06" PRIu32 " %s: ", seconds, microseconds,
+                          level_tags[static_cast<uint8_t>(record.level)]);
+
+    /* leave room for the line ending after the message */
+    size_t length = static_cast<size_t>(prefix);
+    length += record.format_message(&line[length], sizeof(line) - length - 2);
+    line[length++] = '\r';
+    line[length++] = '\n';
+    route(record.level, line, length);
+}
+
+//!< write a line to every sink that takes its level
+void logger::route(log_level level, const char* text, size_t size) {
+    for ( size_t index = 0; index < route_count; index++ ) {
+        if ( level >= routes[index].minimum_level ) {
+            routes[index].sink->write(level, text, size);
+        }
+    }
+}
+
+/**
+ * \brief log daemon thread
+ *
+ * \param arguments
+ */
+static void log_thread_task(void* arguments) {
+    PARAMETER_NOT_USED(arguments);
+    logger::get().run();
+}
+
+};  // namespace os
@@ -0,0 +1,162 @@
+/**
+ * \file log.h
+ * \author Graham Riches (graham.riches@live.com)
+ * \brief deferred logging. Call sites queue binary records and the os log thread formats them.
+ * \version 0.1
+ * \date 2021-05-18
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#pragma once
+
+/********************************** Includes *******************************************/
+#include "log_impl.h"
+#include "system_clock.h"
+
+namespace os
+{
+
+/**
+ * \brief destination for formatted log messages. Sinks are only ever called from the log thread, so they may block.
+ */
+class log_sink {
+  public:
+    /**
+     * \brief write a formatted log line
+     *
+     * \param level the message severity
+     * \param text the line, including the line ending
+     * \param size length of the line
+     */
+    virtual void write(log_level level, const char* text, size_t size) = 0;
+};
+
+/**
+ * \brief singleton deferred logger. Logging a message only copies its format string pointer, a timestamp and the
+ *        raw arguments onto a lock-free queue, so it is cheap enough for time critical threads and safe from
+ *        interrupts. A low priority thread formats the queued messages and routes each one to every sink whose
+ *        minimum level it meets, so the number of sinks never changes the cost of logging a message.
+ */
+class logger {
+  public:
+    static constexpr size_t queue_size = 32;         //!< messages that can be waiting to be formatted
+    static constexpr size_t line_size = 256;         //!< longest formatted line, longer lines are truncated
+    static constexpr uint32_t flush_period_ticks = 10;  //!< how often the log thread checks for new messages
+    static constexpr size_t max_sinks = 4;
+
+    /**
+     * \brief singleton accessor for the logger
+     *
+     * \retval logger& reference to the logger
+     */
+    static logger& get();
+
+    /**
+     * \brief register the log thread with the scheduler. Call this before the kernel is entered.
+     */
+    static void initialize();
+
+    /**
+     * \brief add a destination for the formatted messages. Call this before the kernel is entered.
+     *
+     * \param sink the sink
+     * \param minimum_level lowest level of message to send to the sink
+     * \retval true if added, false if there are already max_sinks sinks
+     */
+    static bool add_sink(log_sink* sink, log_level minimum_level = log_level::debug);
+
+    /**
+     * \brief queue a log message. Safe to call from any thread or interrupt.
+     *
+     * \param level message severity
+     * \param format printf style format string. Must be a string literal, and so must any %s arguments.
+     * \param args the format arguments
+     * \retval true if queued, false if the queue was full and the message was dropped
+     */
+    template <typename... Args>
+    static bool write(log_level level, const char* format, Args... args) {
+        auto record = log_record::make(level, system_clock::get_elapsed_microseconds(), format, args...);
+        return get().queue.push(record);
+    }
+
+    /**
+     * \brief check if a module is allowed to log
+     *
+     * \param module the module
+     * \retval true/false
+     */
+    static bool is_enabled(log_module module) {
+        return get().filter.is_enabled(module);
+    }
+
+    /**
+     * \brief enable or disable logging from a module at run time
+     *
+     * \param module the module
+     * \param enabled true to enable
+     */
+    static void set_module_enabled(log_module module, bool enabled) {
+        get().filter.set_enabled(module, enabled);
+    }
+
+    /**
+     * \brief set every module's enable at once
+     *
+     * \param module_mask bit n enables module n
+     */
+    static void set_module_mask(uint32_t module_mask) {
+        get().filter.set_mask(module_mask);
+    }
+
+    /**
+     * \brief run the log thread loop
+     */
+    [[noreturn]] void run();
+
+  private:
+    /**
+     * \brief Construct the logger as a singleton instance
+     */
+    logger();
+
+    void write_line(const log_record& record);
+    void route(log_level level, const char* text, size_t size);
+
+    /**
+     * \brief a sink and the lowest level of message it takes
+     */
+    struct route_entry {
+        log_sink* sink;
+        log_level minimum_level;
+    };
+
+    log_queue_impl<queue_size> queue;
+    log_filter filter;
+    route_entry routes[max_sinks];
+    size_t route_count;
+    char line[line_size];
+};
+
+};  // namespace os
+
+/********************************** Macros *******************************************/
+/**
+ * \brief log a message if its level is compiled in and its module is enabled. Both checks come before the
+ *        arguments, so a filtered message never evaluates them, and a message below OS_LOG_LEVEL generates no
+ *        code at all.
+ */
+#define OS_LOG(level, module, ...)                                   \
+    do {                                                             \
+        if constexpr ( os::is_log_level_compiled_in(level) ) {       \
+            if ( os::logger::is_enabled(module) ) {                  \
+                os::logger::write((level), __VA_ARGS__);             \
+            }                                                        \
+        }                                                            \
+    } while ( 0 )
+
+#define LOG_DEBUG(module, ...) OS_LOG(os::log_level::debug, (module), __VA_ARGS__)
+#define LOG_INFO(module, ...) OS_LOG(os::log_level::info, (module), __VA_ARGS__)
+#define LOG_WARNING(module, ...) OS_LOG(os::log_level::warning, (module), __VA_ARGS__)
+#define LOG_ERROR(module, ...) OS_LOG(os::log_level::error, (module), __VA_ARGS__)
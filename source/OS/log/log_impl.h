@@ -0,0 +1,542 @@
+/**
+ * \file log_impl.h
+ * \author Graham Riches (graham.riches@live.com)
+ * \brief internal OS implementation of deferred, binary encoded log records
+ * \version 0.1
+ * \date 2021-05-18
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#pragma once
+
+/********************************** Includes *******************************************/
+#include "common.h"
+#include "mpsc_queue.h"
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <type_traits>
+
+
+/********************************** Constants *******************************************/
+/**
+ * \brief lowest log level compiled in, as a log_level value. Messages below it are removed from the build
+ *        entirely, so 0 keeps every message and 4 removes them all.
+ */
+#ifndef OS_LOG_LEVEL
+#    define OS_LOG_LEVEL 0
+#endif
+
+namespace os
+{
+
+/********************************** Types *******************************************/
+/**
+ * \brief log message severities
+ */
+enum class log_level : uint8_t {
+    debug = 0,
+    info,
+    warning,
+    error,
+};
+
+/**
+ * \brief identifies the module a message comes from, from 0 to log_filter::max_modules - 1. Each application
+ *        assigns its own module ids.
+ */
+using log_module = uint8_t;
+constexpr log_module log_module_default = 0;
+constexpr uint8_t log_level_minimum = OS_LOG_LEVEL;
+
+/**
+ * \brief check if messages at a level are compiled in
+ *
+ * \param level the message level
+ * \retval true/false
+ */
+constexpr bool is_log_level_compiled_in(log_level level) {
+    return static_cast<uint8_t>(level) >= log_level_minimum;
+}
+
+/**
+ * \brief runtime mask of the modules that are allowed to log. Checking it is a single load, and it is safe to
+ *        change from any thread or interrupt while messages are being logged.
+ */
+class log_filter {
+  public:
+    static constexpr log_module max_modules = 32;
+
+    /**
+     * \brief Construct a filter with every module enabled
+     */
+    log_filter(void)
+        : mask(UINT32_MAX) { }
+
+    /**
+     * \brief check if a module is allowed to log
+     *
+     * \param module the module
+     * \retval true/false
+     */
+    bool is_enabled(log_module module) const {
+        return (module < max_modules) && ((mask.load(std::memory_order_relaxed) & (0x01u << module)) != 0);
+    }
+
+    /**
+     * \brief enable or disable logging from a module
+     *
+     * \param module the module
+     * \param enabled true to enable
+     */
+    void set_enabled(log_module module, bool enabled) {
+        if ( module >= max_modules ) {
+            return;
+        }
+
+        if ( enabled ) {
+            mask.fetch_or(0x01u << module, std::memory_order_relaxed);
+        } else {
+            mask.fetch_and(~(0x01u << module), std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * \brief set the enabled modules all at once
+     *
+     * \param module_mask bit n enables module n
+     */
+    void set_mask(uint32_t module_mask) {
+        mask.store(module_mask, std::memory_order_relaxed);
+    }
+
+    /**
+     * \brief get the enabled modules
+     *
+     * \retval uint32_t bit n is set if module n is enabled
+     */
+    uint32_t get_mask(void) const {
+        return mask.load(std::memory_order_relaxed);
+    }
+
+  private:
+    std::atomic<uint32_t> mask;
+};
+
+/**
+ * \brief how a log argument was stored in a record
+ */
+enum class log_argument_type : uint8_t {
+    signed_32 = 0,
+    unsigned_32,
+    signed_64,
+    unsigned_64,
+    float_32,
+    float_64,
+    string,
+    pointer,
+};
+
+/**
+ * \brief a log message as it was at the call site: the format string pointer, a timestamp and the raw argument
+ *        values. Nothing is formatted until the record is taken off the log queue, so making one costs a few
+ *        copies no matter how complex the format is.
+ * \note string arguments are stored as pointers, so they must outlive the record. Pass string literals or other
+ *       static strings only, never a buffer on the stack.
+ */
+class log_record {
+  public:
+    static constexpr size_t max_arguments = 8;   //!< most arguments a record can hold
+    //!< 32-bit words of argument storage, enough for max_arguments pointers. 64-bit values take two words.
+    static constexpr size_t argument_words = (max_arguments * sizeof(void*)) / sizeof(uint32_t);
+
+    /**
+     * \brief default construct an empty record
+     */
+    log_record(void)
+        : format(nullptr)
+        , timestamp(0)
+        , level(log_level::debug)
+        , argument_count(0)
+        , types()
+        , words() { }
+
+    /**
+     * \brief make a record for a log message
+     *
+     * \tparam Args argument types, which must be arithmetic, enums, strings or pointers
+     * \param level message severity
+     * \param timestamp time the message was logged
+     * \param format printf style format string. Must be a string literal, it is only stored as a pointer.
+     * \param args the format arguments
+     * \retval log_record the record
+     */
+    template <typename... Args>
+    static log_record make(log_level level, uint64_t timestamp, const char* format, Args... args) {
+        static_assert(sizeof...(Args) <= max_arguments, "too many log arguments");
+        static_assert((words_for<Args>() + ... + 0) <= argument_words, "log arguments don't fit in a record");
+
+        log_record record;
+        record.format = format;
+        record.timestamp = timestamp;
+        record.level = level;
+        [[maybe_unused]] size_t word = 0;
+        (record.append(word, args), ...);
+        return record;
+    }
+
+    /**
+     * \brief format the message into a buffer. The format string is walked one conversion at a time, and each
+     *        conversion is passed to snprintf with its stored argument, so flags, widths and precisions all
+     *        work. Conversions with no matching argument, or an argument of the wrong kind, are printed as <?>.
+     *
+     * \param buffer destination buffer
+     * \param size size of the buffer. The message is truncated to fit and always terminated.
+     * \retval size_t length of the formatted message
+     */
+    size_t format_message(char* buffer, size_t size) const {
+        if ( size == 0 ) {
+            return 0;
+        }
+
+        size_t length = 0;
+        size_t argument = 0;
+        size_t word = 0;
+        const char* cursor = (format != nullptr) ? format : "";
+        buffer[0] = '\0';
+
+        while ( (*cursor != '\0') && (length < size - 1) ) {
+            if ( *cursor != '%' ) {
+                buffer[length++] = *cursor++;
+                continue;
+            }
+
+            if ( cursor[1] == '%' ) {
+                buffer[length++] = '%';
+                cursor += 2;
+                continue;
+            }
+
+            /* copy the flags, width and precision, and skip the length modifiers since the stored type is known */
+            char specification[max_specification_length + 4] = {'%'};
+            size_t specification_length = 1;
+            cursor++;
+            while ( (*cursor != '\0') && (std::strchr("-+ #0123456789.", *cursor) != nullptr) ) {
+                if ( specification_length < max_specification_length ) {
+                    specification[specification_length++] = *cursor;
+                }
+                cursor++;
+            }
+            while ( (*cursor != '\0') && (std::strchr("hlLqjzt", *cursor) != nullptr) ) {
+                cursor++;
+            }
+            if ( *cursor == '\0' ) {
+                break;
+            }
+
+            char conversion = *cursor++;
+            bool has_argument = (argument < argument_count);
+            log_argument_type type = has_argument ? types[argument] : log_argument_type::signed_32;
+            if ( has_argument ) {
+                argument++;
+            }
+            length += print_conversion(&buffer[length], size - length, specification, specification_length, conversion,
+                                       has_argument, type, word);
+        }
+
+        length = (length < size) ? length : size - 1;
+        buffer[length] = '\0';
+        return length;
+    }
+
+    const char* format;        //!< printf style format string
+    uint64_t timestamp;        //!< time the message was logged
+    log_level level;           //!< message severity
+    uint8_t argument_count;    //!< number of stored arguments
+    log_argument_type types[max_arguments];  //!< how each argument was stored
+    uint32_t words[argument_words];          //!< the packed argument values
+
+  private:
+    static constexpr size_t max_specification_length = 12;
+
+    /**
+     * \brief get the type an argument is stored as
+     */
+    template <typename T>
+    static constexpr log_argument_type type_of(void) {
+        using value_type = std::decay_t<T>;
+        if constexpr ( std::is_same_v<value_type, char*> || std::is_same_v<value_type, const char*> ) {
+            return log_argument_type::string;
+        } else if constexpr ( std::is_pointer_v<value_type> || std::is_null_pointer_v<value_type> ) {
+            return log_argument_type::pointer;
+        } else if constexpr ( std::is_same_v<value_type, float> ) {
+            return log_argument_type::float_32;
+        } else if constexpr ( std::is_floating_point_v<value_type> ) {
+            return log_argument_type::float_64;
+        } else if constexpr ( std::is_enum_v<value_type> ) {
+            return type_of<std::underlying_type_t<value_type>>();
+        } else {
+            static_assert(std::is_integral_v<value_type>, "log arguments must be arithmetic, enums, strings or pointers");
+            if constexpr ( sizeof(value_type) > sizeof(uint32_t) ) {
+                return std::is_signed_v<value_type> ? log_argument_type::signed_64 : log_argument_type::unsigned_64;
+            } else {
+                return std::is_signed_v<value_type> ? log_argument_type::signed_32 : log_argument_type::unsigned_32;
+            }
+        }
+    }
+
+    /**
+     * \brief get the number of words a stored argument takes
+     */
+    static constexpr size_t words_for(log_argument_type type) {
+        switch ( type ) {
+            case log_argument_type::signed_64:
+            case log_argument_type::unsigned_64:
+            case log_argument_type::float_64:
+                return sizeof(uint64_t) / sizeof(uint32_t);
+            case log_argument_type::string:
+            case log_argument_type::pointer:
+                return (sizeof(void*) + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+            default:
+                return 1;
+        }
+    }
+
+    template <typename T>
+    static constexpr size_t words_for(void) {
+        return words_for(type_of<T>());
+    }
+
+    /**
+     * \brief store an argument after the ones already stored
+     */
+    template <typename T>
+    void append(size_t& word, T value) {
+        constexpr log_argument_type type = type_of<T>();
+        types[argument_count++] = type;
+        if constexpr ( (type == log_argument_type::string) || (type == log_argument_type::pointer) ) {
+            store(word, static_cast<const void*>(value));
+        } else if constexpr ( type == log_argument_type::float_32 ) {
+            store(word, value);
+        } else if constexpr ( type == log_argument_type::float_64 ) {
+            store(word, static_cast<double>(value));
+        } else if constexpr ( type == log_argument_type::signed_32 ) {
+            store(word, static_cast<int32_t>(value));
+        } else if constexpr ( type == log_argument_type::unsigned_32 ) {
+            store(word, static_cast<uint32_t>(value));
+        } else if constexpr ( type == log_argument_type::signed_64 ) {
+            store(word, static_cast<int64_t>(value));
+        } else {
+            store(word, static_cast<uint64_t>(value));
+        }
+        word += words_for(type);
+    }
+
+    template <typename T>
+    void store(size_t word, T value) {
+        std::memcpy(&words[word], &value, sizeof(value));
+    }
+
+    template <typename T>
+    T load(size_t word) const {
+        T value;
+        std::memcpy(&value, &words[word], sizeof(value));
+        return value;
+    }
+
+    /**
+     * \brief print a single conversion with the next stored argument
+     *
+     * \retval size_t characters written, clamped to the space left in the buffer
+     */
+    size_t print_conversion(char* buffer, size_t size, char* specification, size_t specification_length, char conversion,
+                            bool has_argument, log_argument_type type, size_t& word) const {
+        bool is_integer = (type == log_argument_type::signed_32) || (type == log_argument_type::unsigned_32)
+                          || (type == log_argument_type::signed_64) || (type == log_argument_type::unsigned_64);
+        bool is_float = (type == log_argument_type::float_32) || (type == log_argument_type::float_64);
+        bool is_signed = (type == log_argument_type::signed_32) || (type == log_argument_type::signed_64);
+
+        /* read the argument as the widest value of its kind, every conversion below prints one of these */
+        int64_t integer_value = 0;
+        double float_value = 0;
+        const void* pointer_value = nullptr;
+        if ( has_argument ) {
+            switch ( type ) {
+                case log_argument_type::signed_32: integer_value = load<int32_t>(word); break;
+                case log_argument_type::unsigned_32: integer_value = load<uint32_t>(word); break;
+                case log_argument_type::signed_64: integer_value = load<int64_t>(word); break;
+                case log_argument_type::unsigned_64: integer_value = static_cast<int64_t>(load<uint64_t>(word)); break;
+                case log_argument_type::float_32: float_value = load<float>(word); break;
+                case log_argument_type::float_64: float_value = load<double>(word); break;
+                default: pointer_value = load<const void*>(word); break;
+            }
+            word += words_for(type);
+        }
+
+        int written = -1;
+        if ( has_argument ) {
+            switch ( conversion ) {
+                case 'd':
+                case 'i':
+                case 'u':
+                case 'o':
+                case 'x':
+                case 'X':
+                    if ( is_integer ) {
+                        specification[specification_length++] = 'l';
+                        specification[specification_length++] = 'l';
+                        specification[specification_length++] = conversion;
+                        specification[specification_length] = '\0';
+                        if ( is_signed && ((conversion == 'd') || (conversion == 'i')) ) {
+                            written = std::snprintf(buffer, size, specification, static_cast<long long>(integer_value));
+                        } else {
+                            written = std::snprintf(buffer, size, specification, static_cast<unsigned long long>(integer_value));
+                        }
+                    }
+                    break;
+
+                case 'c':
+                    if ( is_integer ) {
+                        specification[specification_length++] = conversion;
+                        specification[specification_length] = '\0';
+                        written = std::snprintf(buffer, size, specification, static_cast<int>(integer_value));
+                    }
+                    break;
+
+                case 'f':
+                case 'F':
+                case 'e':
+                case 'E':
+                case 'g':
+                case 'G':
+                case 'a':
+                case 'A':
+                    if ( is_float ) {
+                        specification[specification_length++] = conversion;
+                        specification[specification_length] = '\0';
+                        written = std::snprintf(buffer, size, specification, float_value);
+                    }
+                    break;
+
+                case 's':
+                    if ( type == log_argument_type::string ) {
+                        specification[specification_length++] = conversion;
+                        specification[specification_length] = '\0';
+                        const char* text = (pointer_value != nullptr) ? static_cast<const char*>(pointer_value) : "(null)";
+                        written = std::snprintf(buffer, size, specification, text);
+                    }
+                    break;
+
+                case 'p':
+                    if ( (type == log_argument_type::string) || (type == log_argument_type::pointer) ) {
+                        specification[specification_length++] = conversion;
+                        specification[specification_length] = '\0';
+                        written = std::snprintf(buffer, size, specification, pointer_value);
+                    }
+                    break;
+
+                default:
+                    break;
+            }
+        }
+
+        if ( written < 0 ) {
+            written = std::snprintf(buffer, size, "<?>");
+        }
+        return (static_cast<size_t>(written) < size) ? static_cast<size_t>(written) : size - 1;
+    }
+};
+
+/**
+ * \brief lock-free queue of log records that any number of threads and interrupts can push onto at once
+ * \note there must only be one consumer
+ *
+ * \tparam N capacity of the queue, a power of two
+ */
+template <size_t N>
+using log_queue_impl = MPSCQueue<log_record, N>;
+
+/**
+ * \brief byte ring that keeps the newest log output. When it is placed in memory the startup code doesn't clear,
+ *        the output from before a reset is still there afterwards, so the lead up to a crash can be read back.
+ *        The type is trivial on purpose, a constructor would wipe the retained contents.
+ *
+ * \tparam N capacity in bytes, a power of two
+ */
+template <size_t N>
+class ram_log_impl {
+    static_assert((N > 0) && ((N & (N - 1)) == 0), "ram log capacity must be a power of two");
+
+  public:
+    static constexpr uint32_t valid_marker = 0x4C4F4721;
+
+    /**
+     * \brief check the ring is valid, and reset it if it isn't (ie. after a power cycle). Call this before using it.
+     *
+     * \retval true if the contents were kept from before the reset
+     */
+    bool attach(void) {
+        if ( marker == valid_marker ) {
+            return true;
+        }
+        clear();
+        return false;
+    }
+
+    /**
+     * \brief append text, overwriting the oldest text once the ring is full
+     *
+     * \param text the text to add
+     * \param size length of the text
+     */
+    void write(const char* text, size_t size) {
+        for ( size_t index = 0; index < size; index++ ) {
+            data[head & mask] = text[index];
+            head = head + 1;
+        }
+    }
+
+    /**
+     * \brief copy out the stored text, oldest first
+     *
+     * \param buffer destination
+     * \param size size of the destination
+     * \retval size_t number of characters copied, the newest text is kept if it doesn't all fit
+     */
+    size_t read(char* buffer, size_t size) const {
+        size_t count = (size < get_size()) ? size : get_size();
+        size_t start = head - count;
+        for ( size_t index = 0; index < count; index++ ) {
+            buffer[index] = data[(start + index) & mask];
+        }
+        return count;
+    }
+
+    /**
+     * \brief get the number of stored characters
+     *
+     * \retval size_t character count
+     */
+    size_t get_size(void) const {
+        return (head < N) ? head : N;
+    }
+
+    /**
+     * \brief discard the stored text
+     */
+    void clear(void) {
+        head = 0;
+        marker = valid_marker;
+    }
+
+  private:
+    static constexpr size_t mask = N - 1;
+
+    uint32_t marker;
+    size_t head;  //!< free running count of characters written. Only the masked value indexes the ring.
+    char data[N];
+};
+
+};  // namespace os
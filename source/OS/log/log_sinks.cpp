@@ -0,0 +1,74 @@
+/**
+ * \file log_sinks.cpp
+ * \author Graham Riches (graham.riches@live.com)
+ * \brief log sinks for the ITM stimulus ports and a RAM crash log that survives reset
+ * \version 0.1
+ * \date 2021-05-18
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+/********************************** Includes *******************************************/
+#include "log_sinks.h"
+#include "stm32f4xx.h"
+#include <cstring>
+
+namespace os
+{
+
+/********************************** Local Variables *******************************************/
+//!< placed outside of .bss so the startup code leaves the contents alone
+__attribute__((section(".noinit"))) static ram_log_impl<ram_log_sink::capacity> crash_log;
+
+/********************************** Function Definitions *******************************************/
+//!< construct an ITM sink on a stimulus port
+itm_log_sink::itm_log_sink(uint8_t port)
+    : port(port) { }
+
+//!< write a line to the stimulus port a word at a time, waiting on the port FIFO between writes
+void itm_log_sink::write(log_level level, const char* text, size_t size) {
+    PARAMETER_NOT_USED(level);
+    const uint32_t port_mask = 0x01ul << port;
+    if ( ((ITM->TCR & ITM_TCR_ITMENA_Msk) == 0) || ((ITM->TER & port_mask) == 0) ) {
+        return;
+    }
+
+    volatile ITM_Type& itm = *ITM;
+    size_t index = 0;
+    for ( ; (index + sizeof(uint32_t)) <= size; index += sizeof(uint32_t) ) {
+        uint32_t word;
+        std::memcpy(&word, &text[index], sizeof(word));
+        while ( itm.PORT[port].u32 == 0 ) {
+        }
+        itm.PORT[port].u32 = word;
+    }
+    for ( ; index < size; index++ ) {
+        while ( itm.PORT[port].u32 == 0 ) {
+        }
+        itm.PORT[port].u8 = static_cast<uint8_t>(text[index]);
+    }
+}
+
+//!< check the crash log
+bool ram_log_sink::initialize() {
+    return crash_log.attach();
+}
+
+//!< append a line to the crash log
+void ram_log_sink::write(log_level level, const char* text, size_t size) {
+    PARAMETER_NOT_USED(level);
+    crash_log.write(text, size);
+}
+
+//!< read back the crash log
+size_t ram_log_sink::read(char* buffer, size_t size) {
+    return crash_log.read(buffer, size);
+}
+
+//!< clear the crash log
+void ram_log_sink::clear() {
+    crash_log.clear();
+}
+
+};  // namespace os
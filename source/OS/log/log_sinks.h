@@ -0,0 +1,72 @@
+/**
+ * \file log_sinks.h
+ * \author Graham Riches (graham.riches@live.com)
+ * \brief log sinks for the ITM stimulus ports and a RAM crash log that survives reset
+ * \version 0.1
+ * \date 2021-05-18
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#pragma once
+
+/********************************** Includes *******************************************/
+#include "log.h"
+
+namespace os
+{
+
+/**
+ * \brief writes log lines to an ITM stimulus port, which the debugger reads back over SWO. It needs no pins beyond
+ *        SWD and sends four characters per write. The debugger sets up the trace clock and enables the ports, and
+ *        the sink drops everything while the port is disabled, so it costs nothing with no debugger attached.
+ */
+class itm_log_sink : public log_sink {
+  public:
+    /**
+     * \brief Construct a new ITM sink
+     *
+     * \param port the stimulus port to write to, 0 to 31
+     */
+    explicit itm_log_sink(uint8_t port = 0);
+
+    void write(log_level level, const char* text, size_t size) override;
+
+  private:
+    uint8_t port;
+};
+
+/**
+ * \brief keeps the newest log output in a RAM ring that the startup code doesn't clear, so after a reset the
+ *        messages leading up to it can be read back and reported
+ */
+class ram_log_sink : public log_sink {
+  public:
+    static constexpr size_t capacity = 2048;
+
+    /**
+     * \brief check the ring and keep its contents if they are valid. Call this before adding the sink.
+     *
+     * \retval true if there is output from before the last reset
+     */
+    bool initialize();
+
+    void write(log_level level, const char* text, size_t size) override;
+
+    /**
+     * \brief copy out the stored output, oldest first
+     *
+     * \param buffer destination
+     * \param size size of the destination
+     * \retval size_t number of characters copied
+     */
+    size_t read(char* buffer, size_t size);
+
+    /**
+     * \brief discard the stored output
+     */
+    void clear();
+};
+
+};  // namespace os
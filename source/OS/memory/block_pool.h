@@ -0,0 +1,91 @@
+/**
+ * \file block_pool.h
+ * \author Graham Riches (graham.riches@live.com)
+ * \brief fixed-block memory pool for application threads, drivers and interrupts
+ * \version 0.1
+ * \date 2021-05-14
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#pragma once
+
+/********************************** Includes *******************************************/
+#include "block_pool_impl.h"
+#include "cm4_port.h"
+
+namespace os
+{
+
+/**
+ * \brief fixed-block memory pool with constant time allocation. Every call saves and restores the interrupt mask,
+ *        so the pool is safe to use from both threads and interrupt handlers.
+ *
+ * \tparam BlockSize usable bytes per block
+ * \tparam Count number of blocks
+ * \tparam Alignment alignment of every block
+ */
+template <size_t BlockSize, size_t Count, size_t Alignment = alignof(std::max_align_t)>
+class block_pool : public block_pool_impl<BlockSize, Count, Alignment> {
+    using base = block_pool_impl<BlockSize, Count, Alignment>;
+
+  public:
+    /**
+     * \brief take a free block
+     *
+     * \retval void* the block, or nullptr if every block is in use
+     */
+    void* allocate(void) {
+        uint32_t interrupt_mask = enter_critical_from_isr();
+        void* block = base::allocate();
+        exit_critical_from_isr(interrupt_mask);
+        return block;
+    }
+
+    /**
+     * \brief return a block to the pool
+     *
+     * \param pointer the block to free
+     * \retval true if freed, false if the pointer is not a block allocated from this pool, or was already freed
+     */
+    bool free(void* pointer) {
+        uint32_t interrupt_mask = enter_critical_from_isr();
+        bool freed = base::free(pointer);
+        exit_critical_from_isr(interrupt_mask);
+        return freed;
+    }
+
+    /**
+     * \brief allocate a block and construct an object in it. The constructor runs outside the critical section.
+     *
+     * \tparam T object type, which must fit in a block
+     * \param arguments constructor arguments
+     * \retval T* the object, or nullptr if every block is in use
+     */
+    template <typename T, typename... Args>
+    T* create(Args&&... arguments) {
+        static_assert(sizeof(T) <= BlockSize, "object does not fit in a block");
+        static_assert(alignof(T) <= Alignment, "object needs a stricter alignment than the pool");
+
+        void* storage = allocate();
+        return (storage != nullptr) ? new (storage) T(std::forward<Args>(arguments)...) : nullptr;
+    }
+
+    /**
+     * \brief destroy an object made with create() and free its block
+     *
+     * \param object the object to destroy
+     * \retval true if freed, false if the object is not from this pool or was already destroyed
+     */
+    template <typename T>
+    bool destroy(T* object) {
+        if ( !this->is_allocated(object) ) {
+            return false;
+        }
+        object->~T();
+        return free(object);
+    }
+};
+
+};  // namespace os
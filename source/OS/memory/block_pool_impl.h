@@ -0,0 +1,244 @@
+/**
+ * \file block_pool_impl.h
+ * \author Graham Riches (graham.riches@live.com)
+ * \brief internal OS implementation of a fixed-block memory pool
+ * \version 0.1
+ * \date 2021-05-14
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#pragma once
+
+/********************************** Includes *******************************************/
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+
+
+namespace os
+{
+
+/********************************** Types *******************************************/
+/**
+ * \brief statically allocated pool of Count blocks of BlockSize bytes. Free blocks are linked through their own
+ *        storage, so allocating and freeing are a single list push or pop and never depend on the pool state. A bit
+ *        per block records which blocks are handed out, so freeing a block twice, or one that was never allocated,
+ *        is refused rather than corrupting the free list.
+ * \note this is not interrupt safe by itself, callers must wrap each call in a critical section
+ *
+ * \tparam BlockSize usable bytes per block
+ * \tparam Count number of blocks
+ * \tparam Alignment alignment of every block
+ */
+template <size_t BlockSize, size_t Count, size_t Alignment = alignof(std::max_align_t)>
+class block_pool_impl {
+    static_assert(BlockSize > 0, "blocks must hold at least one byte");
+    static_assert(Count > 0, "the pool must hold at least one block");
+
+  public:
+    /**
+     * \brief Construct a new pool with every block free
+     */
+    block_pool_impl(void)
+        : blocks()
+        , free_list(nullptr)
+        , allocated_bits()
+        , used_count(0)
+        , high_water_mark(0)
+        , failed_count(0) {
+        for ( size_t index = Count; index > 0; index-- ) {
+            blocks[index - 1].next = free_list;
+            free_list = &blocks[index - 1];
+        }
+    }
+
+    //!< disable moves and copies, blocks on the free list point into the pool
+    block_pool_impl(const block_pool_impl& other) = delete;
+    block_pool_impl(block_pool_impl&& other) = delete;
+    block_pool_impl& operator = (const block_pool_impl& other) = delete;
+    block_pool_impl& operator = (block_pool_impl&& other) = delete;
+
+    /**
+     * \brief take a free block
+     *
+     * \retval void* the block, or nullptr if every block is in use
+     */
+    void* allocate(void) {
+        block* allocated = free_list;
+        if ( allocated == nullptr ) {
+            failed_count++;
+            return nullptr;
+        }
+
+        free_list = allocated->next;
+        set_allocated(get_index(allocated), true);
+        used_count++;
+        high_water_mark = (used_count > high_water_mark) ? used_count : high_water_mark;
+        return allocated->data;
+    }
+
+    /**
+     * \brief return a block to the pool
+     *
+     * \param pointer the block to free
+     * \retval true if freed, false if the pointer is not a block allocated from this pool, or was already freed
+     */
+    bool free(void* pointer) {
+        if ( !is_allocated(pointer) ) {
+            return false;
+        }
+
+        block* freed = reinterpret_cast<block*>(pointer);
+        set_allocated(get_index(freed), false);
+        freed->next = free_list;
+        free_list = freed;
+        used_count--;
+        return true;
+    }
+
+    /**
+     * \brief allocate a block and construct an object in it
+     *
+     * \tparam T object type, which must fit in a block
+     * \param arguments constructor arguments
+     * \retval T* the object, or nullptr if every block is in use
+     */
+    template <typename T, typename... Args>
+    T* create(Args&&... arguments) {
+        static_assert(sizeof(T) <= BlockSize, "object does not fit in a block");
+        static_assert(alignof(T) <= Alignment, "object needs a stricter alignment than the pool");
+
+        void* storage = allocate();
+        return (storage != nullptr) ? new (storage) T(std::forward<Args>(arguments)...) : nullptr;
+    }
+
+    /**
+     * \brief destroy an object made with create() and free its block
+     *
+     * \param object the object to destroy
+     * \retval true if freed, false if the object is not from this pool or was already destroyed
+     */
+    template <typename T>
+    bool destroy(T* object) {
+        if ( !is_allocated(object) ) {
+            return false;
+        }
+        object->~T();
+        return free(object);
+    }
+
+    /**
+     * \brief check if a pointer is the start of a block in this pool
+     *
+     * \param pointer the pointer to check
+     * \retval true/false
+     */
+    bool contains(const void* pointer) const {
+        auto address = reinterpret_cast<uintptr_t>(pointer);
+        auto first = reinterpret_cast<uintptr_t>(&blocks[0]);
+        return (address >= first) && (address < first + sizeof(blocks)) && (((address - first) % sizeof(block)) == 0);
+    }
+
+    /**
+     * \brief check if a pointer is a block in this pool that is currently allocated
+     *
+     * \param pointer the pointer to check
+     * \retval true/false
+     */
+    bool is_allocated(const void* pointer) const {
+        if ( !contains(pointer) ) {
+            return false;
+        }
+        size_t index = get_index(pointer);
+        return (allocated_bits[index / bits_per_word] & (1ul << (index % bits_per_word))) != 0;
+    }
+
+    /**
+     * \brief get the number of blocks in use
+     *
+     * \retval size_t used block count
+     */
+    size_t get_used_count(void) const {
+        return used_count;
+    }
+
+    /**
+     * \brief get the number of free blocks
+     *
+     * \retval size_t free block count
+     */
+    size_t get_free_count(void) const {
+        return Count - used_count;
+    }
+
+    /**
+     * \brief get the most blocks that have been in use at once
+     *
+     * \retval size_t high water mark
+     */
+    size_t get_high_water_mark(void) const {
+        return high_water_mark;
+    }
+
+    /**
+     * \brief get the number of allocations that failed because the pool was empty
+     *
+     * \retval size_t failed allocation count
+     */
+    size_t get_failed_count(void) const {
+        return failed_count;
+    }
+
+    /**
+     * \brief get the number of usable bytes in each block
+     */
+    static constexpr size_t block_size(void) {
+        return BlockSize;
+    }
+
+    /**
+     * \brief get the number of blocks in the pool
+     */
+    static constexpr size_t capacity(void) {
+        return Count;
+    }
+
+  private:
+    static constexpr size_t bits_per_word = 32;
+
+    /**
+     * \brief a block is either user data or, while free, a link in the free list
+     */
+    union block {
+        block* next;
+        alignas(Alignment) uint8_t data[BlockSize];
+    };
+
+    /**
+     * \brief get the position of a block in the pool, the pointer must be the start of a block
+     */
+    size_t get_index(const void* pointer) const {
+        return (reinterpret_cast<uintptr_t>(pointer) - reinterpret_cast<uintptr_t>(&blocks[0])) / sizeof(block);
+    }
+
+    void set_allocated(size_t index, bool allocated) {
+        uint32_t mask = 1ul << (index % bits_per_word);
+        if ( allocated ) {
+            allocated_bits[index / bits_per_word] |= mask;
+        } else {
+            allocated_bits[index / bits_per_word] &= ~mask;
+        }
+    }
+
+    block blocks[Count];
+    block* free_list;
+    uint32_t allocated_bits[(Count + bits_per_word - 1) / bits_per_word];  //!< a set bit for each block in use
+    size_t used_count;
+    size_t high_water_mark;
+    size_t failed_count;
+};
+
+};  // namespace os
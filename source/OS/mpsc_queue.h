@@ -0,0 +1,132 @@
+/*! \file mpsc_queue.h
+*
+*  \brief lock-free multiple producer single consumer queue.
+*
+*
+*  \author Graham Riches
+*/
+
+#pragma once
+
+/********************************** Includes *******************************************/
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+/*********************************** Consts ********************************************/
+
+/************************************ Types ********************************************/
+/**
+ * \brief bounded lock-free queue that any number of threads and interrupts can push onto at once.
+ *        Each slot carries a sequence number, so a producer claims a slot with a single compare and swap and the
+ *        consumer only takes a slot once its producer has finished writing it. A producer interrupted part way
+ *        through a push only holds up the consumer, never another producer.
+ * \note there must only be one consumer
+ *
+ * \tparam T item type
+ * \tparam N capacity of the queue, a power of two
+ */
+template <typename T, size_t N>
+class MPSCQueue {
+    static_assert((N > 0) && ((N & (N - 1)) == 0), "MPSC queue capacity must be a power of two");
+
+  public:
+    /**
+     * \brief Construct a new empty queue
+     */
+    MPSCQueue(void)
+        : slots()
+        , push_position(0)
+        , pop_position(0)
+        , dropped_count(0) {
+        for ( size_t slot = 0; slot < N; slot++ ) {
+            slots[slot].sequence.store(slot, std::memory_order_relaxed);
+        }
+    }
+
+    //!< disable moves and copies
+    MPSCQueue(const MPSCQueue& other) = delete;
+    MPSCQueue(MPSCQueue&& other) = delete;
+    MPSCQueue& operator = (const MPSCQueue& other) = delete;
+    MPSCQueue& operator = (MPSCQueue&& other) = delete;
+
+    /**
+     * \brief push an item. Safe to call from any thread or interrupt.
+     *
+     * \param item the item to push
+     * \retval true if pushed, false if the queue was full and the item was dropped
+     */
+    bool push(const T& item) {
+        size_t position = push_position.load(std::memory_order_relaxed);
+        slot* claimed;
+        while ( true ) {
+            claimed = &slots[position & mask];
+            size_t sequence = claimed->sequence.load(std::memory_order_acquire);
+            auto difference = static_cast<std::make_signed_t<size_t>>(sequence - position);
+            if ( difference == 0 ) {
+                if ( push_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed) ) {
+                    break;
+                }
+            } else if ( difference < 0 ) {
+                dropped_count.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            } else {
+                position = push_position.load(std::memory_order_relaxed);
+            }
+        }
+
+        claimed->item = item;
+        claimed->sequence.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * \brief pop the oldest item (consumer only)
+     *
+     * \param item where to put the item
+     * \retval true if an item was popped, false if the queue is empty
+     */
+    bool pop(T& item) {
+        slot& next = slots[pop_position & mask];
+        if ( next.sequence.load(std::memory_order_acquire) != (pop_position + 1) ) {
+            return false;
+        }
+
+        item = next.item;
+        next.sequence.store(pop_position + N, std::memory_order_release);
+        pop_position++;
+        return true;
+    }
+
+    /**
+     * \brief get the number of items dropped because the queue was full, and reset it
+     *
+     * \retval uint32_t dropped items since the last call
+     */
+    uint32_t take_dropped_count(void) {
+        return dropped_count.exchange(0, std::memory_order_relaxed);
+    }
+
+    /**
+     * \brief get the capacity of the queue
+     *
+     * \retval size_t max item count
+     */
+    static constexpr size_t capacity(void) {
+        return N;
+    }
+
+  private:
+    static constexpr size_t mask = N - 1;
+
+    struct slot {
+        std::atomic<size_t> sequence;
+        T item;
+    };
+
+    slot slots[N];
+    std::atomic<size_t> push_position;
+    size_t pop_position;
+    std::atomic<uint32_t> dropped_count;
+};
@@ -0,0 +1,47 @@
+/**
+ * \file mutex.cpp
+ * \author Graham Riches (graham.riches@live.com)
+ * \brief priority inheritance mutex for application threads
+ * \version 0.1
+ * \date 2021-05-09
+ * 
+ * @copyright Copyright (c) 2021
+ * 
+ */
+
+/********************************** Includes *******************************************/
+#include "mutex.h"
+#include "cm4_port.h"
+#include "scheduler.h"
+
+namespace os
+{
+
+/********************************** Function Definitions *******************************************/
+//!< construct a mutex on the os scheduler
+mutex::mutex()
+    : mutex_impl(&scheduler::get()) { }
+
+//!< take the mutex
+void mutex::lock() {
+    if ( try_lock() ) {
+        return;
+    }
+
+    /* if this blocks, the PendSV handler switches away as soon as the critical section ends and this thread
+       only runs again once the mutex has been handed to it */
+    critical_section critical;
+    mutex_impl::lock();
+}
+
+//!< release the mutex
+bool mutex::unlock() {
+    if ( try_unlock() ) {
+        return true;
+    }
+
+    critical_section critical;
+    return mutex_impl::unlock();
+}
+
+};  // namespace os
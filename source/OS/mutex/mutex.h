@@ -0,0 +1,44 @@
+/**
+ * \file mutex.h
+ * \author Graham Riches (graham.riches@live.com)
+ * \brief priority inheritance mutex for application threads
+ * \version 0.1
+ * \date 2021-05-09
+ * 
+ * @copyright Copyright (c) 2021
+ * 
+ */
+
+#pragma once
+
+/********************************** Includes *******************************************/
+#include "mutex_impl.h"
+
+namespace os
+{
+
+/**
+ * \brief mutex that blocks on the os scheduler. Uncontended calls never disable interrupts, contended calls run
+ *        the slow path in a critical section. Must not be used from interrupts.
+ */
+class mutex : public mutex_impl {
+  public:
+    /**
+     * \brief Construct a new mutex
+     */
+    mutex();
+
+    /**
+     * \brief take the mutex, suspending the calling thread until it is available
+     */
+    void lock();
+
+    /**
+     * \brief release the mutex
+     * 
+     * \retval true if released, false if the calling thread did not own it
+     */
+    bool unlock();
+};
+
+};  // namespace os
@@ -4,46 +4,189 @@
  * \brief internal OS implementation of a mutex
  * \version 0.1
  * \date 2021-05-09
- * 
+ *
  * @copyright Copyright (c) 2021
- * 
+ *
  */
 
 #pragma once
 
-#include "ring_buffer.h"
+/********************************** Includes *******************************************/
 #include "scheduler_impl.h"
+#include <atomic>
+#include <cstdint>
 
 
 namespace os
 {
 
-
+/********************************** Types *******************************************/
+/**
+ * \brief mutex with priority inheritance. The lock word holds the owning task control block, with bit 0 set
+ *        while other tasks are waiting. Locking and unlocking with nobody waiting is a single compare and swap
+ *        (LDREX/STREX on the Cortex-M4) with no critical section. Contended calls fall back to the slow path,
+ *        which suspends the caller on an intrusive wait list and lends its priority to the owner so a low
+ *        priority owner can't be starved by medium priority threads while a high priority thread waits. If the owner
+ *        is itself blocked on another mutex, the priority is passed along to that mutex's owner, and so on down the
+ *        chain.
+ * \note  the slow path is not interrupt safe by itself, callers must wrap lock() and unlock() in a critical
+ *        section once the fast path has failed. The mutex is not recursive, and inherited priority is only
+ *        returned once the owner has released every mutex it holds.
+ */
 class mutex_impl {
-    public:
-    Mutex(Scheduler& scheduler)
-    : locked(false)
-    , waiting_on_lock(scheduler.g)
-    {}
+  public:
+    using TaskControlBlock = scheduler_impl::TaskControlBlock;
 
+    /**
+     * \brief Construct a new mutex
+     *
+     * \param scheduler_ptr pointer to the scheduler to block on
+     */
+    explicit mutex_impl(scheduler_impl* scheduler_ptr)
+        : state(0)
+        , waiting_threads()
+        , scheduler_ptr(scheduler_ptr) { }
 
-    void lock();
+    //!< disable moves and copies
+    mutex_impl(const mutex_impl& other) = delete;
+    mutex_impl(mutex_impl&& other) = delete;
+    mutex_impl& operator = (const mutex_impl& other) = delete;
+    mutex_impl& operator = (mutex_impl&& other) = delete;
 
-    void try_lock()
+    /**
+     * \brief take the mutex if it is free, without blocking
+     *
+     * \retval true if the active thread now owns the mutex
+     */
+    bool try_lock(void) {
+        auto tcb = scheduler_ptr->get_active_tcb_ptr();
+        uintptr_t expected = 0;
+        if ( !state.compare_exchange_strong(expected, to_state(tcb), std::memory_order_acquire, std::memory_order_relaxed) ) {
+            return false;
+        }
+        tcb->details->held_mutex_count++;
+        return true;
+    }
 
-    void unlock();
+    /**
+     * \brief take the mutex, suspending the active thread if another thread owns it
+     * \note when this suspends, the context switch happens once the caller leaves its critical section and the
+     *       thread runs again already owning the mutex
+     */
+    void lock(void) {
+        if ( try_lock() ) {
+            return;
+        }
 
-    //!< disable moves and copies
-    Mutex(const Mutex& other) = delete;
-    Mutex(Mutex&& other) = delete;
-    Mutex& operator = (const Mutex& other) = delete;
-    Mutex& operator = (Mutex&& other) = delete;
-    
-    private:
-
-    bool locked;
-    RingBuffer<Scheduler::TaskControlBlock> waiting_on_lock;
-};
+        auto tcb = scheduler_ptr->get_active_tcb_ptr();
+        auto owner = get_owner();
+        if ( owner == tcb ) {
+            return;
+        }
+
+        /* flag the contention so the owner's unlock takes the slow path */
+        state.fetch_or(waiters_flag, std::memory_order_relaxed);
+
+        /* lend our priority to the owner, and to whoever each owner in turn is blocked behind, so the whole chain can
+           finish with its mutexes. The walk stops at the first task already at our priority, which also ends it if
+           the chain loops back around on a deadlock. */
+        for ( auto holder = owner; (holder != nullptr) && (holder->priority < tcb->priority); ) {
+            scheduler_ptr->set_task_priority(holder, tcb->priority);
+            auto next_mutex = holder->details->blocked_on;
+            holder = (next_mutex != nullptr) ? next_mutex->get_owner() : nullptr;
+        }
+        tcb->details->blocked_on = this;
+        scheduler_ptr->block_active_task(&waiting_threads);
+    }
+
+    /**
+     * \brief release the mutex if nobody is waiting on it, without a critical section
+     *
+     * \retval true if released, false if the slow path is needed (or the active thread is not the owner)
+     */
+    bool try_unlock(void) {
+        auto tcb = scheduler_ptr->get_active_tcb_ptr();
+
+        /* dropping an inherited priority has to go through the scheduler */
+        if ( (tcb->details->held_mutex_count == 1) && (tcb->priority != tcb->details->base_priority) ) {
+            return false;
+        }
 
+        uintptr_t expected = to_state(tcb);
+        if ( !state.compare_exchange_strong(expected, 0, std::memory_order_release, std::memory_order_relaxed) ) {
+            return false;
+        }
+        tcb->details->held_mutex_count--;
+        return true;
+    }
 
+    /**
+     * \brief release the mutex, handing it straight to the highest priority waiting thread if there is one
+     *
+     * \retval true if released, false if the active thread is not the owner
+     */
+    bool unlock(void) {
+        if ( try_unlock() ) {
+            return true;
+        }
+
+        auto tcb = scheduler_ptr->get_active_tcb_ptr();
+        if ( get_owner() != tcb ) {
+            return false;
+        }
+
+        /* give back any inherited priority once the last held mutex is released */
+        tcb->details->held_mutex_count--;
+        if ( (tcb->details->held_mutex_count == 0) && (tcb->priority != tcb->details->base_priority) ) {
+            scheduler_ptr->set_task_priority(tcb, tcb->details->base_priority);
+        }
+
+        auto next_owner = waiting_threads.head;
+        if ( next_owner == nullptr ) {
+            state.store(0, std::memory_order_release);
+            scheduler_ptr->reschedule();
+            return true;
+        }
+
+        uintptr_t next_state = to_state(next_owner) | ((next_owner->list_next != nullptr) ? waiters_flag : 0);
+        next_owner->details->held_mutex_count++;
+        next_owner->details->blocked_on = nullptr;
+        state.store(next_state, std::memory_order_release);
+        scheduler_ptr->wake_waiting_task(&waiting_threads);
+        return true;
+    }
+
+    /**
+     * \brief get the task that owns the mutex
+     *
+     * \retval TaskControlBlock* the owner, or nullptr if the mutex is free
+     */
+    TaskControlBlock* get_owner(void) const {
+        return reinterpret_cast<TaskControlBlock*>(state.load(std::memory_order_relaxed) & ~waiters_flag);
+    }
+
+    /**
+     * \brief check if any threads are blocked on the mutex
+     *
+     * \retval true/false
+     */
+    bool has_waiting_threads(void) const {
+        return (waiting_threads.head != nullptr);
+    }
+
+  private:
+    static constexpr uintptr_t waiters_flag = 0x01;
+
+    /**
+     * \brief convert a task control block to a lock word. The blocks are word aligned so bit 0 is free.
+     */
+    static uintptr_t to_state(TaskControlBlock* tcb) {
+        return reinterpret_cast<uintptr_t>(tcb);
+    }
+
+    std::atomic<uintptr_t> state;
+    scheduler_impl::TaskList waiting_threads;
+    scheduler_impl* scheduler_ptr;
 };
+
+};  // namespace os
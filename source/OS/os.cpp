@@ -11,13 +11,15 @@
 #include "hal_interrupt.h"
 #include "stm32f4xx.h"
 #include "cm4_port.h"
+#include "profiler.h"
+#include <cstddef>
 
 
 namespace os
 {
 /********************************** Global Objects and Variables *******************************************/
-scheduler::TaskControlBlock* system_active_task;
-scheduler::TaskControlBlock* system_pending_task;
+CCM_RAM __attribute__((used)) scheduler::TaskControlBlock* system_active_task;
+CCM_RAM __attribute__((used)) scheduler::TaskControlBlock* system_pending_task;
 
 /********************************** Local Objects and Variables *******************************************/
 
@@ -29,47 +31,75 @@ namespace kernel
  * \brief initialize the kernel
  */
 void setup(void) {
-    DISABLE_INTERRUPTS();
+    critical_section critical;
+
+    //!< start the cycle counter used for the thread run-time and kernel latency stats
+    profiler::initialize();
+
+    //!< select the highest priority thread to run first
+    scheduler::start();
 
     //!< initialize the task pointers to initialize the kernel
     system_active_task = scheduler::get_active_task_control_block();
     system_pending_task = scheduler::get_pending_task_control_block();
 
-    //!< activate the first task
-    system_active_task->thread_ptr->set_status(thread::status::active);
-
     //!< start the system clock
     system_clock::initialize();
 
+#ifdef OS_MPU_STACK_GUARD
+    //!< guard the bottom of the first thread's stack, the PendSV handler moves it on every switch
+    initialize_stack_guard();
+#endif
+
+#if (__FPU_PRESENT == 1)
+    //!< automatically reserve FPU state on exception entry, but only stack it if the handler uses the FPU
+    FPU->FPCCR |= (FPU_FPCCR_ASPEN_Msk | FPU_FPCCR_LSPEN_Msk);
+#endif
+
     //!< setup core interrupt priorities
     HAL::interrupt_manager.set_priority(HAL::InterruptName::systick_handler, HAL::PreemptionPriority::level_16);
     HAL::interrupt_manager.set_priority(HAL::InterruptName::pendsv_handler, HAL::PreemptionPriority::level_16);
-
-    ENABLE_INTERRUPTS();
+    HAL::interrupt_manager.set_priority(HAL::InterruptName::svc_handler, HAL::PreemptionPriority::level_16);
 }
 
 /**
- * \brief pick up the first task control block pointer
+ * \brief start the first thread on the process stack. The main stack is reset to the top of RAM and left to
+ *        the kernel and interrupt handlers. The first thread's initial context is discarded as it has never
+ *        run, apart from its entry point, return address, r0 and privilege level. Loading the return address
+ *        means a first thread whose task returns lands in the exit trampoline, like every other thread.
+ * \note  interrupts have to be enabled before dropping to unprivileged, as CPSIE is ignored after that
  */
+static_assert(offsetof(thread::register_context, r0) == 40, "enter loads r0 from the initial context");
+static_assert(offsetof(thread::register_context, lr) == 60, "enter loads lr from the initial context");
+static_assert(offsetof(thread::register_context, pc) == 64, "enter loads the entry point from the initial context");
+static_assert(sizeof(thread::register_context) == 72, "enter discards the whole initial context");
+
 // clang-format off
 __attribute__((naked))  void enter(void) {
     using namespace os;
 
     __asm("CPSID      I                        \n" /* disable interrupts */
+        "LDR        R0, =0xE000ED08          \n" /* load the address of the vector table offset register */
+        "LDR        R0, [R0]                 \n" /* get the vector table */
+        "LDR        R0, [R0]                 \n" /* the first entry is the initial main stack pointer */
+        "MSR        MSP, R0                  \n" /* reclaim the startup stack for the interrupt handlers */
         "LDR        R0, =system_active_task  \n" /* load the active task pointer into r0*/
         "LDR        R1, [R0]                 \n" /* load the stack pointer from the contents of task into R1 */
-        "LDR        R4, [R1]                 \n" /* copy the saved stack pointer into R4 */
-        "MOV        SP, R4                   \n" /* update the stack pointer */
-        "POP        {R4-R11}                 \n" /* pop R4-R11 off the stack */
-        "POP        {R0-R3}                  \n" /* pop R0-R3 off the stack */
-        "POP        {R4}                     \n" /* pop the last Cortex-saved register */
-        "MOV        R12, R4                  \n" /* restore R12 */
-        "ADD        SP,SP,#4                 \n" /* skip over the saved LR as it is invalid on startup */
-        "POP        {R4}                     \n" /* grab the task function pointer */
-        "MOV        LR, R4                   \n" /* restore the LR state */
-        "ADD        SP,SP,#4                 \n" /* increment the stack pointer */
+        "LDR        R2, [R1]                 \n" /* get the saved stack pointer */
+        "LDR        R3, [R2]                 \n" /* get the saved privilege level */
+        "LDR        R4, [R2, #64]            \n" /* get the task function pointer */
+        "LDR        R0, [R2, #40]            \n" /* get the saved R0 */
+        "LDR        LR, [R2, #60]            \n" /* return into the exit trampoline if the task function returns */
+        "ADD        R2, R2, #72              \n" /* discard the rest of the initial context */
+        "MSR        PSP, R2                  \n" /* point the process stack at the top of the thread stack */
+        "MOV        R1, #2                   \n"
+        "MSR        CONTROL, R1              \n" /* switch thread mode to the process stack */
+        "ISB                                 \n"
+        "ORR        R3, R3, #2               \n" /* keep the process stack when the privilege level is set */
         "CPSIE      I                        \n" /* re-enable interrupts */
-        "BX         LR                       \n" /* branch to the link register */
+        "MSR        CONTROL, R3              \n" /* drop to the thread's privilege level */
+        "ISB                                 \n"
+        "BX         R4                       \n" /* branch to the thread */
     );
 }
 // clang-format on
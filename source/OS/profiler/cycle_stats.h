@@ -0,0 +1,134 @@
+/*! \file cycle_stats.h
+*
+*  \brief running min/max/mean and power of two histogram of cycle count samples
+*
+*
+*  \author Graham Riches
+*/
+
+#pragma once
+
+/********************************** Includes *******************************************/
+#include "common.h"
+
+namespace os
+{
+/********************************** Types *******************************************/
+/**
+ * \brief accumulates cycle count samples for profiling the kernel. Recording a sample is constant time
+ *        so it is safe to call from inside the tick and context switch handlers.
+ */
+class cycle_stats {
+  public:
+    /**
+     * \brief number of histogram buckets. Bucket n counts samples in the range [2^(n-1), 2^n), with bucket 0
+     *        holding zero length samples and the last bucket collecting everything larger.
+     */
+    static constexpr uint8_t histogram_buckets = 16;
+
+    /**
+     * \brief default construct an empty set of stats
+     */
+    cycle_stats(void)
+        : count(0)
+        , total(0)
+        , min(UINT32_MAX)
+        , max(0)
+        , histogram() { }
+
+    /**
+     * \brief record a new sample
+     *
+     * \param cycles sample length in cycles
+     */
+    void record(uint32_t cycles) {
+        count++;
+        total += cycles;
+        min = (cycles < min) ? cycles : min;
+        max = (cycles > max) ? cycles : max;
+        histogram[get_bucket(cycles)]++;
+    }
+
+    /**
+     * \brief clear all recorded samples
+     */
+    void reset(void) {
+        count = 0;
+        total = 0;
+        min = UINT32_MAX;
+        max = 0;
+        for ( auto& bucket : histogram ) {
+            bucket = 0;
+        }
+    }
+
+    /**
+     * \brief get the number of recorded samples
+     *
+     * \retval uint32_t sample count
+     */
+    uint32_t get_count(void) const {
+        return count;
+    }
+
+    /**
+     * \brief get the shortest recorded sample
+     *
+     * \retval uint32_t min cycles, or zero if nothing has been recorded
+     */
+    uint32_t get_min(void) const {
+        return (count > 0) ? min : 0;
+    }
+
+    /**
+     * \brief get the longest recorded sample
+     *
+     * \retval uint32_t max cycles
+     */
+    uint32_t get_max(void) const {
+        return max;
+    }
+
+    /**
+     * \brief get the mean of all recorded samples
+     *
+     * \retval uint32_t mean cycles, or zero if nothing has been recorded
+     */
+    uint32_t get_mean(void) const {
+        return (count > 0) ? static_cast<uint32_t>(total / count) : 0;
+    }
+
+    /**
+     * \brief get the number of samples in a histogram bucket
+     *
+     * \param bucket the bucket index
+     * \retval uint32_t samples in the bucket
+     */
+    uint32_t get_histogram_count(uint8_t bucket) const {
+        return (bucket < histogram_buckets) ? histogram[bucket] : 0;
+    }
+
+    /**
+     * \brief get the histogram bucket that a sample falls into
+     *
+     * \param cycles the sample
+     * \retval uint8_t the bucket index
+     */
+    static uint8_t get_bucket(uint32_t cycles) {
+        if ( cycles == 0 ) {
+            return 0;
+        }
+
+        uint8_t bucket = static_cast<uint8_t>(32 - __builtin_clz(cycles));
+        return (bucket < histogram_buckets) ? bucket : (histogram_buckets - 1);
+    }
+
+  private:
+    uint32_t count;
+    uint64_t total;
+    uint32_t min;
+    uint32_t max;
+    uint32_t histogram[histogram_buckets];
+};
+
+};  // namespace os
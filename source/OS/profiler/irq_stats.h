@@ -0,0 +1,136 @@
+/*! \file irq_stats.h
+*
+*  \brief per interrupt counts, durations, arrival jitter and nesting depth
+*
+*
+*  \author Graham Riches
+*/
+
+#pragma once
+
+/********************************** Includes *******************************************/
+#include "common.h"
+
+namespace os
+{
+/********************************** Types *******************************************/
+/**
+ * \brief accumulates entry and exit timestamps for every interrupt vector. Handlers nest strictly, so a plain
+ *        depth counter is enough, and a vector never preempts itself so each record has a single writer.
+ *        Durations include the time spent in any handlers that preempted the one being measured.
+ */
+class irq_stats {
+  public:
+    static constexpr uint8_t max_vectors = 98;  //!< 16 core exceptions and the 82 STM32F407 interrupts
+
+    /**
+     * \brief stats for one vector
+     */
+    struct record {
+        uint32_t count;
+        uint32_t total_cycles;  //!< wraps after about 25 seconds of handler time at 168MHz
+        uint32_t max_cycles;
+        uint32_t last_entry;    //!< cycle count on the last entry
+        uint32_t min_interval;  //!< shortest time between two entries
+        uint32_t max_interval;  //!< longest time between two entries
+        uint8_t max_nesting;    //!< deepest nesting seen on entry, 1 if it never preempted another handler
+    };
+
+    /**
+     * \brief default construct an empty set of stats
+     */
+    irq_stats(void)
+        : records()
+        , nesting(0)
+        , max_nesting(0) {
+        this->reset();
+    }
+
+    /**
+     * \brief record entry to a handler
+     *
+     * \param vector the active vector number
+     * \param cycles cycle count on entry
+     */
+    void enter(uint8_t vector, uint32_t cycles) {
+        uint8_t depth = ++this->nesting;
+        this->max_nesting = (depth > this->max_nesting) ? depth : this->max_nesting;
+        if ( vector >= max_vectors ) {
+            return;
+        }
+
+        record& stats = this->records[vector];
+        if ( stats.count > 0 ) {
+            uint32_t interval = cycles - stats.last_entry;
+            stats.min_interval = (interval < stats.min_interval) ? interval : stats.min_interval;
+            stats.max_interval = (interval > stats.max_interval) ? interval : stats.max_interval;
+        }
+        stats.last_entry = cycles;
+        stats.max_nesting = (depth > stats.max_nesting) ? depth : stats.max_nesting;
+    }
+
+    /**
+     * \brief record exit from a handler
+     *
+     * \param vector the active vector number
+     * \param entry_cycles the cycle count passed to enter
+     * \param cycles cycle count on exit
+     */
+    void exit(uint8_t vector, uint32_t entry_cycles, uint32_t cycles) {
+        this->nesting--;
+        if ( vector >= max_vectors ) {
+            return;
+        }
+
+        record& stats = this->records[vector];
+        uint32_t duration = cycles - entry_cycles;
+        stats.count++;
+        stats.total_cycles += duration;
+        stats.max_cycles = (duration > stats.max_cycles) ? duration : stats.max_cycles;
+    }
+
+    /**
+     * \brief get the stats for a vector
+     *
+     * \param vector the vector number
+     * \retval record copy of the stats, empty for vectors out of range
+     */
+    record get_record(uint8_t vector) const {
+        return (vector < max_vectors) ? this->records[vector] : record{0, 0, 0, 0, 0, 0, 0};
+    }
+
+    /**
+     * \brief get the deepest nesting seen across all vectors
+     *
+     * \retval uint8_t depth
+     */
+    uint8_t get_max_nesting(void) const {
+        return this->max_nesting;
+    }
+
+    /**
+     * \brief get the current nesting depth
+     *
+     * \retval uint8_t depth
+     */
+    uint8_t get_nesting(void) const {
+        return this->nesting;
+    }
+
+    /**
+     * \brief clear the stats. The current depth is kept since handlers may be running.
+     */
+    void reset(void) {
+        for ( auto& stats : this->records ) {
+            stats = record{0, 0, 0, 0, UINT32_MAX, 0, 0};
+        }
+        this->max_nesting = this->nesting;
+    }
+
+  private:
+    record records[max_vectors];
+    uint8_t nesting;
+    uint8_t max_nesting;
+};
+
+};  // namespace os
@@ -0,0 +1,153 @@
+/**
+ * \file profiler.cpp
+ * \author Graham Riches (graham.riches@live.com)
+ * \brief contains the singleton implementation of the kernel latency profiler
+ * \version 0.1
+ * \date 2021-05-09
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+/********************************** Includes *******************************************/
+#include "profiler.h"
+#include "cm4_port.h"
+#include "stm32f4xx.h"
+
+namespace os
+{
+/********************************** Global Objects and Variables *******************************************/
+__attribute__((used)) uint32_t os_context_switch_start_cycles;  //!< written by the PendSV assembly
+
+#ifdef OS_IRQ_PROFILING
+static irq_stats interrupt_stats;  //!< kept out of the profiler object so it costs nothing unless enabled
+#endif
+
+/********************************** Function Definitions *******************************************/
+//!< default construct the profiler
+profiler::profiler()
+    : tick_stats()
+    , scheduler_stats()
+    , context_switch_stats() { }
+
+//!< get a reference to the profiler
+profiler& profiler::get() {
+    static profiler kernel_profiler;
+    return kernel_profiler;
+}
+
+//!< enable the cycle counter
+void profiler::initialize(void) {
+    auto& self = get();
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    /* called during kernel setup with interrupts already disabled, so no critical section here */
+    self.tick_stats.reset();
+    self.scheduler_stats.reset();
+    self.context_switch_stats.reset();
+}
+
+//!< read the cycle counter
+uint32_t profiler::get_cycles(void) {
+    return DWT->CYCCNT;
+}
+
+//!< record a tick sample
+void profiler::record_tick(uint32_t start_cycles) {
+    auto& self = get();
+    self.tick_stats.record(get_cycles() - start_cycles);
+}
+
+//!< record a scheduler sample
+void profiler::record_scheduler_decision(uint32_t start_cycles) {
+    auto& self = get();
+    self.scheduler_stats.record(get_cycles() - start_cycles);
+}
+
+//!< record a context switch sample
+void profiler::record_context_switch(uint32_t start_cycles) {
+    auto& self = get();
+    self.context_switch_stats.record(get_cycles() - start_cycles);
+}
+
+//!< snapshot the tick stats
+cycle_stats profiler::get_tick_stats(void) {
+    auto& self = get();
+    critical_section critical;
+    return self.tick_stats;
+}
+
+//!< snapshot the scheduler stats
+cycle_stats profiler::get_scheduler_stats(void) {
+    auto& self = get();
+    critical_section critical;
+    return self.scheduler_stats;
+}
+
+//!< snapshot the context switch stats
+cycle_stats profiler::get_context_switch_stats(void) {
+    auto& self = get();
+    critical_section critical;
+    return self.context_switch_stats;
+}
+
+//!< snapshot one interrupt's stats
+irq_stats::record profiler::get_irq_stats(uint8_t vector) {
+#ifdef OS_IRQ_PROFILING
+    critical_section critical;
+    return interrupt_stats.get_record(vector);
+#else
+    PARAMETER_NOT_USED(vector);
+    return irq_stats::record{0, 0, 0, 0, 0, 0, 0};
+#endif
+}
+
+//!< get the deepest interrupt nesting
+uint8_t profiler::get_irq_max_nesting(void) {
+#ifdef OS_IRQ_PROFILING
+    return interrupt_stats.get_max_nesting();
+#else
+    return 0;
+#endif
+}
+
+//!< clear the recorded stats
+void profiler::reset(void) {
+    auto& self = get();
+    critical_section critical;
+    self.tick_stats.reset();
+    self.scheduler_stats.reset();
+    self.context_switch_stats.reset();
+#ifdef OS_IRQ_PROFILING
+    interrupt_stats.reset();
+#endif
+}
+
+/**
+ * \brief context switch hook called with interrupts disabled from the end of the PendSV handler
+ */
+__attribute__((used)) void os_profile_context_switch(void) {
+    profiler::record_context_switch(os_context_switch_start_cycles);
+}
+
+#ifdef OS_IRQ_PROFILING
+/**
+ * \brief interrupt entry hook, the active vector is read back from the interrupt control register
+ */
+uint32_t os_irq_profile_enter(void) {
+    uint32_t cycles = profiler::get_cycles();
+    interrupt_stats.enter(static_cast<uint8_t>(SCB->ICSR & SCB_ICSR_VECTACTIVE_Msk), cycles);
+    return cycles;
+}
+
+/**
+ * \brief interrupt exit hook
+ */
+void os_irq_profile_exit(uint32_t entry_cycles) {
+    interrupt_stats.exit(static_cast<uint8_t>(SCB->ICSR & SCB_ICSR_VECTACTIVE_Msk), entry_cycles, profiler::get_cycles());
+}
+#endif
+
+};  // namespace os
@@ -0,0 +1,143 @@
+/**
+ * \file profiler.h
+ * \author Graham Riches (graham.riches@live.com)
+ * \brief cycle accurate kernel latency profiling using the DWT cycle counter
+ * \version 0.1
+ * \date 2021-05-09
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#pragma once
+
+/********************************** Includes *******************************************/
+#include "cycle_stats.h"
+#include "irq_stats.h"
+
+namespace os
+{
+extern "C" {
+/********************************** Global Objects and Variables *******************************************/
+extern uint32_t os_context_switch_start_cycles;  //!< cycle count stamped on entry to the PendSV handler
+
+/**
+ * \brief record the length of the context switch that is just completing. Called from the end of
+ *        the PendSV handler when OS_PROFILING is enabled.
+ */
+void os_profile_context_switch(void);
+
+/**
+ * \brief stamp entry to an interrupt handler. Called first thing in the handler when OS_IRQ_PROFILING is enabled.
+ *
+ * \retval uint32_t the entry cycle count, to hand back to os_irq_profile_exit
+ */
+uint32_t os_irq_profile_enter(void);
+
+/**
+ * \brief record the length of the interrupt handler that is just finishing
+ *
+ * \param entry_cycles the cycle count returned by os_irq_profile_enter
+ */
+void os_irq_profile_exit(uint32_t entry_cycles);
+}
+
+/**
+ * \brief singleton that collects cycle counts for the kernel tick, scheduler and context switch paths.
+ *        The hooks are only compiled into the kernel when OS_PROFILING is defined.
+ */
+class profiler {
+  public:
+    /**
+     * \brief enable the DWT cycle counter and clear any recorded stats
+     */
+    static void initialize(void);
+
+    /**
+     * \brief get the current value of the cycle counter
+     *
+     * \retval uint32_t cycle count
+     */
+    static uint32_t get_cycles(void);
+
+    /**
+     * \brief record the cycles spent handling a system tick
+     *
+     * \param start_cycles cycle count at the start of the tick handler
+     */
+    static void record_tick(uint32_t start_cycles);
+
+    /**
+     * \brief record the cycles spent making a scheduling decision
+     *
+     * \param start_cycles cycle count before the scheduler ran
+     */
+    static void record_scheduler_decision(uint32_t start_cycles);
+
+    /**
+     * \brief record the cycles spent performing a context switch
+     *
+     * \param start_cycles cycle count on entry to the context switch handler
+     */
+    static void record_context_switch(uint32_t start_cycles);
+
+    /**
+     * \brief get a snapshot of the tick handler stats
+     *
+     * \retval cycle_stats copy of the stats
+     */
+    static cycle_stats get_tick_stats(void);
+
+    /**
+     * \brief get a snapshot of the scheduler decision stats
+     *
+     * \retval cycle_stats copy of the stats
+     */
+    static cycle_stats get_scheduler_stats(void);
+
+    /**
+     * \brief get a snapshot of the context switch stats
+     *
+     * \retval cycle_stats copy of the stats
+     */
+    static cycle_stats get_context_switch_stats(void);
+
+    /**
+     * \brief get a snapshot of the stats for one interrupt vector
+     *
+     * \param vector the vector number, which is the IRQ number plus 16
+     * \retval irq_stats::record copy of the stats, empty unless built with OS_IRQ_PROFILING
+     */
+    static irq_stats::record get_irq_stats(uint8_t vector);
+
+    /**
+     * \brief get the deepest interrupt nesting seen
+     *
+     * \retval uint8_t depth, 0 unless built with OS_IRQ_PROFILING
+     */
+    static uint8_t get_irq_max_nesting(void);
+
+    /**
+     * \brief clear all recorded stats
+     */
+    static void reset(void);
+
+  private:
+    /**
+     * \brief Construct the profiler as a singleton instance
+     */
+    profiler();
+
+    /**
+     * \brief singleton accessor for the profiler
+     *
+     * \retval profiler& reference to the profiler
+     */
+    static profiler& get();
+
+    cycle_stats tick_stats;
+    cycle_stats scheduler_stats;
+    cycle_stats context_switch_stats;
+};
+
+};  // namespace os
@@ -0,0 +1,218 @@
+/**
+ * \file queue.h
+ * \author Graham Riches (graham.riches@live.com)
+ * \brief blocking message queues for application threads and interrupts
+ * \version 0.1
+ * \date 2021-05-12
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#pragma once
+
+/********************************** Includes *******************************************/
+#include "cm4_port.h"
+#include "queue_impl.h"
+#include "scheduler.h"
+#include "trace.h"
+
+namespace os
+{
+
+/**
+ * \brief message queue that blocks on the os scheduler. Every call runs in a critical section.
+ *
+ * \tparam T item type
+ * \tparam N max number of queued items
+ */
+template <typename T, size_t N>
+class queue : public queue_impl<T, N> {
+  public:
+    /**
+     * \brief Construct a new empty queue
+     */
+    queue()
+        : queue_impl<T, N>(&scheduler::get()) { }
+
+    /**
+     * \brief send an item, waiting for room if the queue is full
+     *
+     * \param item the item to send
+     * \param ticks max ticks to wait (0 to return straight away)
+     * \retval true if sent, false on timeout
+     */
+    bool send(const T& item, uint32_t ticks = scheduler::wait_forever) {
+        scheduler::TaskControlBlock* tcb;
+        {
+            critical_section critical;
+            if ( this->try_send(item) ) {
+                OS_TRACE_EVENT(trace_event::queue_send, 0, reinterpret_cast<uintptr_t>(this));
+                return true;
+            }
+
+            if ( ticks == 0 ) {
+                return false;
+            }
+
+            tcb = scheduler::get_active_task_control_block();
+            OS_TRACE_EVENT(trace_event::queue_block, 1, reinterpret_cast<uintptr_t>(this));
+            this->block_send(&item, ticks);
+        }
+
+        /* the PendSV handler switches away as soon as the critical section ends, and this thread only runs again
+           once a receiver has taken the item or the wait has timed out */
+        return !tcb->wait_timed_out;
+    }
+
+    /**
+     * \brief send an item from an interrupt handler without blocking
+     *
+     * \param item the item to send
+     * \retval true if sent, false if the queue is full
+     */
+    bool send_from_isr(const T& item) {
+        uint32_t interrupt_mask = enter_critical_from_isr();
+        bool sent = this->try_send(item);
+        if ( sent ) {
+            OS_TRACE_EVENT(trace_event::queue_send, 0, reinterpret_cast<uintptr_t>(this));
+        }
+        exit_critical_from_isr(interrupt_mask);
+        return sent;
+    }
+
+    /**
+     * \brief receive an item, waiting for one if the queue is empty
+     *
+     * \param ticks max ticks to wait (0 to return straight away)
+     * \retval std::optional<T> the item, or empty on timeout
+     */
+    std::optional<T> receive(uint32_t ticks = scheduler::wait_forever) {
+        T received;
+        scheduler::TaskControlBlock* tcb;
+        {
+            critical_section critical;
+            auto item = this->try_receive();
+            if ( item.has_value() ) {
+                OS_TRACE_EVENT(trace_event::queue_receive, 0, reinterpret_cast<uintptr_t>(this));
+            }
+            if ( item.has_value() || (ticks == 0) ) {
+                return item;
+            }
+
+            tcb = scheduler::get_active_task_control_block();
+            OS_TRACE_EVENT(trace_event::queue_block, 0, reinterpret_cast<uintptr_t>(this));
+            this->block_receive(&received, ticks);
+        }
+
+        /* resumes once the critical section ends and a sender has written the item or the wait has timed out */
+        if ( tcb->wait_timed_out ) {
+            return {};
+        }
+        return received;
+    }
+
+    /**
+     * \brief receive an item from an interrupt handler without blocking
+     *
+     * \retval std::optional<T> the item, or empty if the queue is empty
+     */
+    std::optional<T> receive_from_isr(void) {
+        uint32_t interrupt_mask = enter_critical_from_isr();
+        auto item = this->try_receive();
+        if ( item.has_value() ) {
+            OS_TRACE_EVENT(trace_event::queue_receive, 0, reinterpret_cast<uintptr_t>(this));
+        }
+        exit_critical_from_isr(interrupt_mask);
+        return item;
+    }
+};
+
+/**
+ * \brief zero-copy mail queue that blocks on the os scheduler. Records are allocated from the queue, filled in
+ *        place and passed by pointer. Every call is interrupt safe except a receive that may block.
+ *
+ * \tparam T record type
+ * \tparam N number of records
+ */
+template <typename T, size_t N>
+class mail_queue : public mail_queue_impl<T, N> {
+  public:
+    /**
+     * \brief Construct a new mail queue with every record free
+     */
+    mail_queue()
+        : mail_queue_impl<T, N>(&scheduler::get()) { }
+
+    /**
+     * \brief take a free record to fill in
+     *
+     * \retval T* the record, or nullptr if every record is in use
+     */
+    T* allocate(void) {
+        uint32_t interrupt_mask = enter_critical_from_isr();
+        T* record = mail_queue_impl<T, N>::allocate();
+        exit_critical_from_isr(interrupt_mask);
+        return record;
+    }
+
+    /**
+     * \brief return a record to the pool
+     *
+     * \param record the record to free
+     */
+    void free(T* record) {
+        uint32_t interrupt_mask = enter_critical_from_isr();
+        mail_queue_impl<T, N>::free(record);
+        exit_critical_from_isr(interrupt_mask);
+    }
+
+    /**
+     * \brief send an allocated record, waking a waiting receiver
+     *
+     * \param record the record to send
+     */
+    void send(T* record) {
+        uint32_t interrupt_mask = enter_critical_from_isr();
+        mail_queue_impl<T, N>::send(record);
+        exit_critical_from_isr(interrupt_mask);
+    }
+
+    /**
+     * \brief receive a record, waiting for one if none are queued
+     *
+     * \param ticks max ticks to wait (0 to return straight away)
+     * \retval T* the record, or nullptr on timeout. Free it once done.
+     */
+    T* receive(uint32_t ticks = scheduler::wait_forever) {
+        T* record;
+        scheduler::TaskControlBlock* tcb;
+        {
+            critical_section critical;
+            record = this->try_receive();
+            if ( (record != nullptr) || (ticks == 0) ) {
+                return record;
+            }
+
+            tcb = scheduler::get_active_task_control_block();
+            this->block_receive(&record, ticks);
+        }
+
+        /* resumes once the critical section ends and a record has been sent or the wait has timed out */
+        return tcb->wait_timed_out ? nullptr : record;
+    }
+
+    /**
+     * \brief receive a record from an interrupt handler without blocking
+     *
+     * \retval T* the record, or nullptr if none are queued
+     */
+    T* receive_from_isr(void) {
+        uint32_t interrupt_mask = enter_critical_from_isr();
+        T* record = this->try_receive();
+        exit_critical_from_isr(interrupt_mask);
+        return record;
+    }
+};
+
+};  // namespace os
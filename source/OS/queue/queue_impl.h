@@ -0,0 +1,308 @@
+/**
+ * \file queue_impl.h
+ * \author Graham Riches (graham.riches@live.com)
+ * \brief internal OS implementation of blocking message queues
+ * \version 0.1
+ * \date 2021-05-12
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#pragma once
+
+/********************************** Includes *******************************************/
+#include "block_pool_impl.h"
+#include "ring_buffer.h"
+#include "scheduler_impl.h"
+#include "wait_any_impl.h"
+#include <optional>
+
+
+namespace os
+{
+
+/********************************** Types *******************************************/
+/**
+ * \brief bounded queue of N items of type T that threads can block on when it is empty or full. Items are copied
+ *        in and out, so keep T small (or use a mail_queue_impl for large records). Blocked threads are linked into
+ *        intrusive wait lists and publish a pointer to their item in their task control block, so an item is
+ *        copied straight into a waiting receiver (or out of a waiting sender) and the woken thread never has to
+ *        retry.
+ * \note this is not interrupt safe by itself, callers must wrap each call in a critical section
+ *
+ * \tparam T item type
+ * \tparam N max number of queued items
+ */
+template <typename T, size_t N>
+class queue_impl {
+  public:
+    /**
+     * \brief Construct a new empty queue
+     *
+     * \param scheduler_ptr pointer to the scheduler to block on
+     */
+    explicit queue_impl(scheduler_impl* scheduler_ptr)
+        : items()
+        , waiting_senders()
+        , waiting_receivers()
+        , watchers()
+        , scheduler_ptr(scheduler_ptr) { }
+
+    //!< disable moves and copies
+    queue_impl(const queue_impl& other) = delete;
+    queue_impl(queue_impl&& other) = delete;
+    queue_impl& operator = (const queue_impl& other) = delete;
+    queue_impl& operator = (queue_impl&& other) = delete;
+
+    /**
+     * \brief send an item without blocking. If a thread is waiting to receive, the item goes straight to it.
+     *        Otherwise it is queued and any threads waiting on the queue in wait_for_any() are woken to take it.
+     *
+     * \param item the item to send
+     * \retval true if sent, false if the queue is full
+     */
+    bool try_send(const T& item) {
+        auto receiver = waiting_receivers.head;
+        if ( receiver != nullptr ) {
+            *static_cast<T*>(receiver->details->wait_data) = item;
+            scheduler_ptr->wake_waiting_task(&waiting_receivers);
+            return true;
+        }
+
+        if ( !items.push(item) ) {
+            return false;
+        }
+        watchers.notify(scheduler_ptr);
+        return true;
+    }
+
+    /**
+     * \brief suspend the active thread until there is room for its item. Call this after try_send() has failed.
+     * \note the context switch happens once the caller leaves its critical section, so the item must stay valid
+     *       until the thread runs again. The item has been sent unless wait_timed_out is set in its task control block.
+     *
+     * \param item the item to send
+     * \param timeout_ticks ticks to wait before giving up, or scheduler_impl::wait_forever
+     */
+    void block_send(const T* item, uint32_t timeout_ticks = scheduler_impl::wait_forever) {
+        scheduler_ptr->get_active_tcb_ptr()->details->wait_data = const_cast<T*>(item);
+        scheduler_ptr->block_active_task(&waiting_senders, timeout_ticks);
+    }
+
+    /**
+     * \brief receive an item without blocking. Taking an item makes room for the highest priority waiting sender.
+     *
+     * \retval std::optional<T> the item, or empty if the queue is empty
+     */
+    std::optional<T> try_receive(void) {
+        auto item = items.pop();
+        if ( !item.has_value() ) {
+            return {};
+        }
+
+        auto sender = waiting_senders.head;
+        if ( sender != nullptr ) {
+            items.push(*static_cast<T*>(sender->details->wait_data));
+            scheduler_ptr->wake_waiting_task(&waiting_senders);
+        }
+        return item;
+    }
+
+    /**
+     * \brief suspend the active thread until an item arrives. Call this after try_receive() has failed.
+     * \note the context switch happens once the caller leaves its critical section. The item has been written to
+     *       the destination unless wait_timed_out is set in the thread's task control block.
+     *
+     * \param destination where to put the received item
+     * \param timeout_ticks ticks to wait before giving up, or scheduler_impl::wait_forever
+     */
+    void block_receive(T* destination, uint32_t timeout_ticks = scheduler_impl::wait_forever) {
+        scheduler_ptr->get_active_tcb_ptr()->details->wait_data = destination;
+        scheduler_ptr->block_active_task(&waiting_receivers, timeout_ticks);
+    }
+
+    /**
+     * \brief get the number of queued items
+     *
+     * \retval size_t item count
+     */
+    size_t size(void) {
+        return items.size();
+    }
+
+    /**
+     * \brief get the capacity of the queue
+     *
+     * \retval size_t max item count
+     */
+    static constexpr size_t capacity(void) {
+        return N;
+    }
+
+    /**
+     * \brief check if any threads are blocked sending to the queue
+     *
+     * \retval true/false
+     */
+    bool has_waiting_senders(void) const {
+        return (waiting_senders.head != nullptr);
+    }
+
+    /**
+     * \brief check if any threads are blocked receiving from the queue
+     *
+     * \retval true/false
+     */
+    bool has_waiting_receivers(void) const {
+        return (waiting_receivers.head != nullptr);
+    }
+
+    /**
+     * \brief check if there is an item to receive, for wait_for_any()
+     *
+     * \param mask unused
+     * \param options unused
+     * \retval true if the queue isn't empty
+     */
+    bool is_ready(uint32_t mask = 0, uint8_t options = 0) {
+        static_cast<void>(mask);
+        static_cast<void>(options);
+        return (items.size() > 0);
+    }
+
+    /**
+     * \brief get the threads waiting on the queue in wait_for_any()
+     *
+     * \retval wait_any_list& the waiters
+     */
+    wait_any_list& get_watchers(void) {
+        return watchers;
+    }
+
+  private:
+    RingBuffer<T, N> items;
+    scheduler_impl::TaskList waiting_senders;
+    scheduler_impl::TaskList waiting_receivers;
+    wait_any_list watchers;
+    scheduler_impl* scheduler_ptr;
+};
+
+/**
+ * \brief zero-copy queue of N records of type T. The queue owns a block pool of N records that senders fill in place
+ *        and pass by pointer, so large records (sensor frames, log records) move between threads without being
+ *        copied. The pool has exactly one record per queue slot, so sending an allocated record never blocks.
+ * \note this is not interrupt safe by itself, callers must wrap each call in a critical section
+ *
+ * \tparam T record type
+ * \tparam N number of records
+ */
+template <typename T, size_t N>
+class mail_queue_impl {
+  public:
+    /**
+     * \brief Construct a new mail queue with every record free
+     *
+     * \param scheduler_ptr pointer to the scheduler to block on
+     */
+    explicit mail_queue_impl(scheduler_impl* scheduler_ptr)
+        : records()
+        , mail(scheduler_ptr) { }
+
+    //!< disable moves and copies
+    mail_queue_impl(const mail_queue_impl& other) = delete;
+    mail_queue_impl(mail_queue_impl&& other) = delete;
+    mail_queue_impl& operator = (const mail_queue_impl& other) = delete;
+    mail_queue_impl& operator = (mail_queue_impl&& other) = delete;
+
+    /**
+     * \brief take a free, default constructed record to fill in
+     *
+     * \retval T* the record, or nullptr if every record is in use
+     */
+    T* allocate(void) {
+        return records.template create<T>();
+    }
+
+    /**
+     * \brief return a received (or unsent) record to the pool
+     *
+     * \param record the record to free
+     */
+    void free(T* record) {
+        records.destroy(record);
+    }
+
+    /**
+     * \brief send an allocated record
+     *
+     * \param record the record to send
+     */
+    void send(T* record) {
+        mail.try_send(record);
+    }
+
+    /**
+     * \brief receive a record without blocking. The receiver must free() the record once it is done with it.
+     *
+     * \retval T* the record, or nullptr if nothing is queued
+     */
+    T* try_receive(void) {
+        return mail.try_receive().value_or(nullptr);
+    }
+
+    /**
+     * \brief suspend the active thread until a record arrives. Call this after try_receive() has failed.
+     * \note see queue_impl::block_receive
+     *
+     * \param destination where to put the received record pointer
+     * \param timeout_ticks ticks to wait before giving up, or scheduler_impl::wait_forever
+     */
+    void block_receive(T** destination, uint32_t timeout_ticks = scheduler_impl::wait_forever) {
+        mail.block_receive(destination, timeout_ticks);
+    }
+
+    /**
+     * \brief get the number of queued records
+     *
+     * \retval size_t record count
+     */
+    size_t size(void) {
+        return mail.size();
+    }
+
+    /**
+     * \brief get the number of free records
+     *
+     * \retval size_t free record count
+     */
+    size_t get_free_count(void) {
+        return records.get_free_count();
+    }
+
+    /**
+     * \brief check if there is a record to receive, for wait_for_any()
+     *
+     * \param mask unused
+     * \param options unused
+     * \retval true if a record is queued
+     */
+    bool is_ready(uint32_t mask = 0, uint8_t options = 0) {
+        return mail.is_ready(mask, options);
+    }
+
+    /**
+     * \brief get the threads waiting on the queue in wait_for_any()
+     *
+     * \retval wait_any_list& the waiters
+     */
+    wait_any_list& get_watchers(void) {
+        return mail.get_watchers();
+    }
+
+  private:
+    block_pool_impl<sizeof(T), N, alignof(T)> records;
+    queue_impl<T*, N> mail;
+};
+
+};  // namespace os
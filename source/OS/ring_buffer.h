@@ -9,33 +9,36 @@
 #pragma once
 
 /********************************** Includes *******************************************/
-#include <memory>
+#include "buffer_span.h"
+#include <algorithm>
+#include <cstddef>
 #include <optional>
 
 /*********************************** Consts ********************************************/
 
 /************************************ Types ********************************************/
 /**
- * \brief template class for a re-usable ring buffer
+ * \brief template class for a re-usable ring buffer. The storage is a member array so the buffer
+ *        lives wherever its owner does (ie. .bss for a static driver) and never touches the heap.
  * 
  * \tparam T parameter type
+ * \tparam N capacity of the buffer
  */
-template <typename T>
+template <typename T, size_t N>
 class RingBuffer {
+    static_assert(N > 0, "ring buffer capacity must be non-zero");
+
   private:
-    std::unique_ptr<T[]> buffer;
-    const size_t max_size;
+    T buffer[N];
     size_t head = 0;
     size_t tail = 0;
     bool full = false;
 
   public:
-    explicit RingBuffer(size_t size)
-        : buffer(std::make_unique<T[]>(size))
-        , max_size(size) { }
+    RingBuffer()
+        : buffer() { }
 
-    //!< delete copies and moves and default construction
-    RingBuffer() = delete;
+    //!< delete copies and moves
     RingBuffer(const RingBuffer& other) = delete;
     RingBuffer(RingBuffer&& other) = delete;
     RingBuffer& operator = (const RingBuffer& other) = delete;
@@ -53,7 +56,7 @@ class RingBuffer {
             return false;
         }
         this->buffer[this->head] = data;
-        this->head = (this->head + 1) % this->max_size;
+        this->head = (this->head + 1) % N;
         this->full = (this->head == this->tail);
         return true;
     }
@@ -69,11 +72,119 @@ class RingBuffer {
         }
 
         auto value = this->buffer[tail];
-        this->tail = (this->tail + 1) % this->max_size;
+        this->tail = (this->tail + 1) % N;
         this->full = false;
         return value;
     }
 
+    /**
+     * \brief put a block of data onto the ring buffer. Copies as much as fits, in at most two runs.
+     * 
+     * \param data pointer to the data to put into the ring buffer
+     * \param count number of elements to put
+     * \retval size_t number of elements actually put
+     */
+    size_t push_bulk(const T* data, size_t count) {
+        size_t pushed = 0;
+        while ( pushed < count ) {
+            auto span = this->reserve_contiguous();
+            if ( span.size == 0 ) {
+                break;
+            }
+            size_t run = std::min(span.size, count - pushed);
+            std::copy_n(data + pushed, run, span.data);
+            this->publish(run);
+            pushed += run;
+        }
+        return pushed;
+    }
+
+    /**
+     * \brief get a block of data off the ring buffer. Copies as much as is available, in at most two runs.
+     * 
+     * \param data pointer to the destination
+     * \param count max number of elements to get
+     * \retval size_t number of elements actually got
+     */
+    size_t pop_bulk(T* data, size_t count) {
+        size_t popped = 0;
+        while ( popped < count ) {
+            auto span = this->peek_contiguous();
+            if ( span.size == 0 ) {
+                break;
+            }
+            size_t run = std::min(span.size, count - popped);
+            std::copy_n(span.data, run, data + popped);
+            this->commit(run);
+            popped += run;
+        }
+        return popped;
+    }
+
+    /**
+     * \brief get the largest linear block of stored data starting at the tail, without removing it
+     * 
+     * \retval BufferSpan<T> the readable block (zero size when empty)
+     */
+    BufferSpan<T> peek_contiguous(void) {
+        if ( this->is_empty() ) {
+            return {&this->buffer[this->tail], 0};
+        }
+        size_t end = (this->head > this->tail) ? this->head : N;
+        return {&this->buffer[this->tail], end - this->tail};
+    }
+
+    /**
+     * \brief release elements that were read through peek_contiguous
+     * 
+     * \param count number of elements to release. Must not exceed the size of the last peeked span.
+     */
+    void commit(size_t count) {
+        if ( count == 0 ) {
+            return;
+        }
+        this->tail = (this->tail + count) % N;
+        this->full = false;
+    }
+
+    /**
+     * \brief get the largest linear block of free space starting at the head
+     * 
+     * \retval BufferSpan<T> the writable block (zero size when full)
+     */
+    BufferSpan<T> reserve_contiguous(void) {
+        if ( this->full ) {
+            return {&this->buffer[this->head], 0};
+        }
+        size_t end = (this->tail > this->head) ? this->tail : N;
+        return {&this->buffer[this->head], end - this->head};
+    }
+
+    /**
+     * \brief add elements that were written through reserve_contiguous to the buffer
+     * 
+     * \param count number of elements written. Must not exceed the size of the last reserved span.
+     */
+    void publish(size_t count) {
+        if ( count == 0 ) {
+            return;
+        }
+        this->head = (this->head + count) % N;
+        this->full = (this->head == this->tail);
+    }
+
+    /**
+     * \brief get the number of elements in the buffer
+     * 
+     * \retval size_t element count
+     */
+    size_t size(void) {
+        if ( this->full ) {
+            return N;
+        }
+        return (this->head >= this->tail) ? (this->head - this->tail) : (N + this->head - this->tail);
+    }
+
     /**
      * \brief check if the buffer is empty 
      * 
@@ -92,6 +203,15 @@ class RingBuffer {
         return this->full;
     }
 
+    /**
+     * \brief get the capacity of the buffer
+     * 
+     * \retval size_t max element count
+     */
+    static constexpr size_t capacity(void) {
+        return N;
+    }
+
     /**
      * \brief flush data out of the ring buffer       
      */
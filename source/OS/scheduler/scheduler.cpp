@@ -12,6 +12,7 @@
 /********************************** Includes *******************************************/
 #include "scheduler.h"
 #include "cm4_port.h"
+#include "profiler.h"
 #include "system_clock.h"
 #include "thread_impl.h"
 
@@ -20,48 +21,100 @@ namespace os
 
 /********************************** Constants *******************************************/
 constexpr uint8_t internal_thread_stack_size = 128;
+constexpr uint32_t internal_thread_id = 0xFFFF;
 
 /********************************** Function Declarations *******************************************/
 static void internal_thread_task(void* arguments);
+static void halt_on_stack_overflow(thread* thread);
 
 /********************************** Local Variables *******************************************/
-static uint32_t internal_thread_stack[internal_thread_stack_size] = {0};
-static os::thread internal_thread(internal_thread_task, nullptr, 0xFFFF, internal_thread_stack, internal_thread_stack_size);
+CCM_RAM static uint32_t internal_thread_stack[internal_thread_stack_size] = {0};
+CCM_RAM static os::thread internal_thread(internal_thread_task, nullptr, internal_thread_id, internal_thread_stack, internal_thread_stack_size);
 
 /********************************** Function Definitions *******************************************/
 //!> default construct the scheduler
 scheduler::scheduler()
-    : scheduler_impl(system_clock::get(), MAX_THREAD_COUNT, set_pending_context_switch, is_context_switch_pending)
-    , locked(false) {
+    : scheduler_impl(&system_clock::get(), MAX_THREAD_COUNT, set_pending_context_switch, is_context_switch_pending, profiler::get_cycles) {
+    /* the idle loop reprograms the SysTick, which only privileged code can reach */
+    internal_thread.set_privileged(true);
     set_internal_task(&internal_thread);
+    set_stack_overflow_handler(halt_on_stack_overflow);
+    thread::set_exit_handler(scheduler::exit);
 }
 
 //!< get a reference to the scheduler
 scheduler& scheduler::get() {
-    static scheduler os_scheduler;
+    CCM_RAM static scheduler os_scheduler;
     return os_scheduler;
 }
 
 //!< run the scheduler algorithm
-void scheduler::update() {
+RAM_FUNCTION void scheduler::update() {
     auto& self = get();
-    if ( !self.locked ) {        
-        self.run();
-    }
+#ifdef OS_PROFILING
+    uint32_t start_cycles = profiler::get_cycles();
+    self.run();
+    profiler::record_scheduler_decision(start_cycles);
+#else
+    self.run();
+#endif
 }
 
 //!< register a new thread
-void scheduler::register_new_thread(thread* thread) {
+bool scheduler::register_new_thread(thread* thread) {
+    auto& self = get();
+    critical_section critical;
+    bool registered = self.register_thread(thread);
+    if ( registered && is_thread_context() ) {
+        self.reschedule();
+    }
+    return registered;
+}
+
+//!< end the calling thread
+void scheduler::exit() {
+    os_svc_exit();
+
+    /* the SVC switches away from the thread for good */
+    while ( true ) {
+    }
+}
+
+//!< wait for a thread to exit
+bool scheduler::join(thread* thread, uint32_t ticks) {
     auto& self = get();
-    self.register_thread(thread);
+    TaskControlBlock* tcb;
+    {
+        critical_section critical;
+        if ( thread->get_status() == thread::status::exited ) {
+            return true;
+        }
+
+        tcb = self.get_active_tcb_ptr();
+        if ( (ticks == 0) || !self.join_thread(thread, ticks) ) {
+            return false;
+        }
+    }
+
+    /* the PendSV handler switches away as soon as the critical section ends, and this thread only runs again once
+       the thread has exited or the wait has timed out */
+    return !tcb->wait_timed_out;
+}
+
+//!< select the first task to run
+void scheduler::start() {
+    auto& self = get();
+    self.scheduler_impl::start();
 }
 
 //!< sleep the calling thread
 void scheduler::sleep(uint32_t ticks) {
-    auto& self = get();
-    DISABLE_INTERRUPTS();
-    self.sleep_thread(ticks);
-    ENABLE_INTERRUPTS();
+    os_svc_sleep(ticks);
+}
+
+//!< set the time slice for a priority level
+void scheduler::set_time_slice(uint8_t priority, uint32_t ticks) {
+    os_svc_set_time_slice(priority, ticks);
 }
 
 //!< get the active task control block
@@ -76,29 +129,116 @@ scheduler::TaskControlBlock* scheduler::get_pending_task_control_block() {
     return self.get_pending_tcb_ptr();
 }
 
-//!< lock the scheduler
-void scheduler::lock() {    
-    DISABLE_INTERRUPTS();
+//!< snapshot a thread's run-time statistics
+std::optional<scheduler::ThreadStats> scheduler::get_thread_stats(uint32_t id) {
     auto& self = get();
-    self.locked = true;
-    ENABLE_INTERRUPTS();
+    critical_section critical;
+    return self.scheduler_impl::get_thread_stats(id);
 }
 
-//!< unlock the scheduler
-void scheduler::unlock() {
-    DISABLE_INTERRUPTS();
+//!< get the number of registered threads
+uint8_t scheduler::get_thread_count() {
     auto& self = get();
-    self.locked = false;
-    ENABLE_INTERRUPTS();
+    return self.get_registered_thread_count();
+}
+
+//!< get a thread id by registration index
+std::optional<uint32_t> scheduler::get_thread_id(uint8_t index) {
+    auto& self = get();
+    return self.scheduler_impl::get_thread_id(index);
+}
+
+//!< get a thread by registration index
+thread* scheduler::get_thread(uint8_t index) {
+    auto& self = get();
+    return self.scheduler_impl::get_thread(index);
+}
+
+//!< get the internal thread id
+uint32_t scheduler::get_internal_thread_id() {
+    return internal_thread_id;
+}
+
+//!< raise the calling thread's preemption threshold
+uint8_t scheduler::lock(uint8_t priority) {
+    return static_cast<uint8_t>(os_svc_lock(priority));
+}
+
+//!< restore the calling thread's preemption threshold
+void scheduler::unlock(uint8_t previous) {
+    os_svc_unlock(previous);
+}
+
+//!< run a scheduler call from the SVC handler. The SysTick and PendSV can't preempt the SVC handler, but
+//!< interrupts that signal threads can, so the scheduler is still masked for the call.
+uint32_t scheduler::handle_syscall(uint8_t number, uint32_t argument_one, uint32_t argument_two) {
+    auto& self = get();
+    critical_section critical;
+    uint32_t result = 0;
+    switch ( number ) {
+        case OS_SVC_SLEEP:
+            self.sleep_thread(argument_one);
+            break;
+
+        case OS_SVC_LOCK:
+            result = self.lock_preemption(static_cast<uint8_t>(argument_one));
+            break;
+
+        case OS_SVC_UNLOCK:
+            self.unlock_preemption(static_cast<uint8_t>(argument_one));
+            break;
+
+        case OS_SVC_SET_TIME_SLICE:
+            self.set_priority_time_slice(static_cast<uint8_t>(argument_one), argument_two);
+            break;
+
+        case OS_SVC_EXIT:
+            self.exit_thread();
+            break;
+
+        default:
+            break;
+    }
+    return result;
+}
+
+//!< run one pass of the idle loop
+void scheduler::idle() {
+#ifdef OS_TICKLESS_IDLE
+    auto& self = get();
+    /* PRIMASK rather than BASEPRI, as WFI only wakes for interrupts that are not masked by BASEPRI */
+    DISABLE_ALL_INTERRUPTS();
+    /* nothing sleeping means only an interrupt can make a thread ready, so sleep as long as possible. With no
+       timeouts to keep, deep sleep is allowed too as the missing system time won't be noticed */
+    auto ticks_until_wakeup = self.get_ticks_until_next_wakeup();
+    if ( ticks_until_wakeup || !deep_sleep() ) {
+        suppress_ticks_and_sleep(ticks_until_wakeup.value_or(UINT32_MAX));
+    }
+    ENABLE_ALL_INTERRUPTS();
+#endif
 }
 
 /**
- * \brief empty internal thread task to run when all other threads are sleeping
+ * \brief internal thread task to run when all other threads are sleeping
  * 
  * \param arguments 
  */
 static void internal_thread_task(void* arguments) {
     PARAMETER_NOT_USED(arguments);
+    while ( true ) {
+        scheduler::idle();
+    }
+}
+
+/**
+ * \brief called from the scheduler when a thread's stack canary or saved stack pointer is corrupt.
+ *        The thread's state can't be trusted anymore, so halt here for the debugger.
+ * 
+ * \param thread the thread that overflowed its stack
+ */
+static void halt_on_stack_overflow(thread* thread) {
+    PARAMETER_NOT_USED(thread);
+    DISABLE_ALL_INTERRUPTS();
     while ( true ) {
     }
 }
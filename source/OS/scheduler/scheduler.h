@@ -37,9 +37,32 @@ class scheduler : public scheduler_impl {
     static void update();
 
     /**
-     * \brief register a new thread with the scheduler     
+     * \brief register a new thread with the scheduler. Threads can be registered from other threads once the
+     *        kernel is running, and a new thread that outranks the caller runs straight away.
+     * 
+     * \param thread the thread to register
+     * \retval true if it was registered, false if every task control block is in use
+     */
+    static bool register_new_thread(thread* thread);
+
+    /**
+     * \brief end the calling thread. Threads whose task function returns end here too.
+     */
+    [[noreturn]] static void exit();
+
+    /**
+     * \brief block the calling thread until another thread exits
+     * 
+     * \param thread the thread to wait for
+     * \param ticks ticks to wait before giving up, or wait_forever
+     * \retval true if the thread has exited, false on a timeout or if the thread was never registered
+     */
+    static bool join(thread* thread, uint32_t ticks = wait_forever);
+
+    /**
+     * \brief select the first task to run before the kernel is entered
      */
-    static void register_new_thread(thread* thread);
+    static void start();
 
     /**
      * \brief sleep the calling thead for a number of ticks
@@ -48,6 +71,14 @@ class scheduler : public scheduler_impl {
      */
     static void sleep(uint32_t ticks);
 
+    /**
+     * \brief set the round-robin time slice for threads at a priority level
+     * 
+     * \param priority the priority level
+     * \param ticks quantum in ticks
+     */
+    static void set_time_slice(uint8_t priority, uint32_t ticks);
+
     /**
      * \brief Get the active task control block
      * 
@@ -63,14 +94,80 @@ class scheduler : public scheduler_impl {
     static TaskControlBlock* get_pending_task_control_block();
 
     /**
-     * \brief lock the scheduler to perform atomic operations without interrupting
+     * \brief get a snapshot of the run-time statistics for a thread
+     * 
+     * \param id the thread id
+     * \retval std::optional<ThreadStats> the statistics, or empty if no thread has the id
      */
-    static void lock();
+    static std::optional<ThreadStats> get_thread_stats(uint32_t id);
 
     /**
-     * \brief unlock the scheduler
+     * \brief get the number of registered threads
+     * 
+     * \retval uint8_t thread count
      */
-    static void unlock();
+    static uint8_t get_thread_count();
+
+    /**
+     * \brief get the id of a registered thread by registration index
+     * 
+     * \param index registration index
+     * \retval std::optional<uint32_t> thread id, or empty if the index is out of range
+     */
+    static std::optional<uint32_t> get_thread_id(uint8_t index);
+
+    /**
+     * \brief get a registered thread by its registration index, for reporting
+     * 
+     * \param index registration index
+     * \retval thread* the thread, or nullptr if the index is out of range
+     */
+    static thread* get_thread(uint8_t index);
+
+    /**
+     * \brief get the id of the internal OS thread that runs when every other thread is blocked
+     * 
+     * \retval uint32_t thread id
+     */
+    static uint32_t get_internal_thread_id();
+
+    /**
+     * \brief stop threads at or below a priority from preempting the calling thread, without stopping the tick.
+     *        Threads that wake in the meantime wait their turn, and higher priority threads still run straight
+     *        away. Locks nest by handing back the previous threshold:
+     *
+     *            auto previous = os::scheduler::lock(4);
+     *            ...
+     *            os::scheduler::unlock(previous);
+     *
+     * \param priority highest priority that can't preempt, everything by default
+     * \retval uint8_t the previous threshold, to pass to unlock()
+     */
+    static uint8_t lock(uint8_t priority = thread::priority_levels - 1);
+
+    /**
+     * \brief restore the calling thread's preemption threshold from before the matching lock(), running any thread
+     *        that was held off and should now preempt
+     *
+     * \param previous the value returned by lock(), fully unlocked by default
+     */
+    static void unlock(uint8_t previous = 0);
+
+    /**
+     * \brief run one pass of the idle loop from the internal thread. When built with OS_TICKLESS_IDLE
+     *        this suppresses the systick and sleeps until the next thread is due to wake.
+     */
+    static void idle();
+
+    /**
+     * \brief run a scheduler SVC call in the kernel
+     * 
+     * \param number the OS_SVC_* call number
+     * \param argument_one first argument (the caller's r0)
+     * \param argument_two second argument (the caller's r1)
+     * \retval uint32_t value returned to the caller in r0
+     */
+    static uint32_t handle_syscall(uint8_t number, uint32_t argument_one, uint32_t argument_two);
 
 
   private:
@@ -78,8 +175,6 @@ class scheduler : public scheduler_impl {
      * \brief Construct the os scheduler as a singleton instance
      */
     scheduler();
-
-    bool locked;
 };
 
 };  // namespace os
\ No newline at end of file
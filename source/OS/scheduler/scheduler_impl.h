@@ -12,12 +12,16 @@
 #include "common.h"
 #include "system_clock.h"
 #include "thread_impl.h"
+#include "trace.h"
 
-#include <memory>
+#include <array>
+#include <cstddef>
 #include <optional>
 
 namespace os
 {
+class mutex_impl;
+
 /**
  * \brief class for managing application threads and scheduling context switches
  * \note  there is nothing preventing the user from creating multiple instances of this class, which has pros and cons.
@@ -27,15 +31,70 @@ namespace os
  */
 class scheduler_impl {
   public:
+    struct TaskControlBlock;
+
     /**
-     * \brief task control block for thread management 
+     * \brief intrusive doubly linked list of task control blocks. The links live inside each task control
+     *        block so no memory is allocated when tasks move between lists.
+     */
+    struct TaskList {
+        TaskControlBlock* head;
+        TaskControlBlock* tail;
+    };
+
+    /**
+     * \brief run-time statistics for a thread, updated every time the scheduler switches threads
+     */
+    struct ThreadStats {
+        uint64_t cycles_run;          //!< total cycles spent running the thread
+        uint32_t switched_in_count;   //!< number of times the thread has been switched in
+        uint32_t preempted_count;     //!< number of times the thread was switched out while still ready to run
+        uint32_t yielded_count;       //!< number of times the thread gave up the CPU by sleeping or suspending
+        uint32_t last_run_tick;       //!< system tick the thread was last switched in
+        uint32_t switched_in_cycles;  //!< cycle count when the thread was last switched in
+    };
+
+    /**
+     * \brief the parts of a task that scheduling decisions never look at. These live in their own table so the
+     *        task control blocks the scheduler walks on every tick stay small.
+     */
+    struct TaskDetails {
+        uint8_t base_priority;     //!< priority the task was registered with
+        uint8_t held_mutex_count;  //!< number of mutexes the task currently owns
+        uint8_t wait_options;      //!< how a task waiting on event flags wants them matched
+        uint32_t wait_flags;       //!< event flags a waiting task wants, replaced by the flags that woke it
+        void* wait_data;           //!< item a task blocked on a queue is sending, or the buffer it is receiving into
+        mutex_impl* blocked_on;    //!< mutex the task is blocked locking, so a lent priority can follow its owner
+        TaskList joiners;          //!< tasks blocked joining the task, woken when it exits
+        ThreadStats stats;         //!< run-time statistics for the thread
+    };
+
+    /**
+     * \brief task control block for thread management. This only holds the state the scheduler reads while picking
+     *        the next task, including copies of the thread's status and id so picking never calls into the thread.
+     * \note the PendSV handler saves and loads the stack pointer at the start of the block, so it must stay first
      */
     struct TaskControlBlock {
         uint32_t* active_stack_pointer;
+        TaskControlBlock* list_next;        //!< next task in the list the task is linked into
+        TaskControlBlock* list_prev;        //!< previous task in the list the task is linked into
+        TaskList* list;                     //!< list the task is currently linked into (nullptr if none)
+        TaskControlBlock* delay_next;       //!< next task in the delay list
+        TaskControlBlock* delay_prev;       //!< previous task in the delay list
+        int32_t suspended_ticks_remaining;  //!< ticks remaining relative to the previous task in the delay list
+        uint32_t slice_ticks_remaining;     //!< ticks left in the current time slice (0 when expired)
+        uint32_t time_slice;                //!< per thread quantum override (thread::priority_time_slice if none)
+        uint32_t id;                        //!< id of the thread
+        thread::status status;              //!< status of the thread, kept in step with the thread's own copy
+        uint8_t priority;                   //!< scheduling priority of the task, including any inherited priority
+        uint8_t preemption_threshold;       //!< lowest priority a ready task needs to preempt the task (0 when unlocked)
+        bool delayed;                       //!< true if the task is linked into the delay list
+        bool wait_timed_out;                //!< set when a timed wait on a wait list expired before the task was woken
         TaskControlBlock* next;
         thread* thread_ptr;
-        int32_t suspended_ticks_remaining;
+        TaskDetails* details;               //!< the task's entry in the details table
     };
+    static_assert(offsetof(TaskControlBlock, active_stack_pointer) == 0, "the PendSV handler expects the stack pointer first");
 
     /**
     * \brief function pointer for setting a pending interrupt with the scheduler. This injects
@@ -49,55 +108,86 @@ class scheduler_impl {
     */
     typedef bool (*IsInterruptPending)(void);
 
+    /**
+    * \brief function pointer to read a free running cycle counter for the thread run-time statistics
+    */
+    typedef uint32_t (*GetCycleCount)(void);
+
+    /**
+    * \brief function pointer called when a context switch finds a thread whose stack has overflowed
+    */
+    typedef void (*StackOverflowHandler)(thread* thread);
+
+    /**
+     * \brief default round-robin quantum in ticks for every priority level
+     */
+    static constexpr uint32_t default_time_slice = 10;
+
+    /**
+     * \brief timeout value for blocking on a wait list with no timeout
+     */
+    static constexpr uint32_t wait_forever = UINT32_MAX;
+
     /**
      * \brief Construct a new scheduler
-     * 
+     *
      * \param clock_source system clock source for running the scheduler
-     * \param max_thread_count max number of threads to allow
+     * \param max_thread_count max number of threads to allow. This is capped at MAX_THREAD_COUNT, which sizes the
+     *        statically allocated task control block table.
      * \param set_pending function pointer to the function to set a pending context switch interrupt
      * \param check_pending function pointer to check if an interrupt is already pending
+     * \param get_cycles function pointer to read the cycle counter (nullptr to skip cycle accounting)
      */
-    scheduler_impl(system_clock_impl* clock_source, uint8_t max_thread_count, SetPendingInterrupt set_pending, IsInterruptPending check_pending)
+    scheduler_impl(system_clock_impl* clock_source, uint8_t max_thread_count, SetPendingInterrupt set_pending, IsInterruptPending check_pending,
+                   GetCycleCount get_cycles = nullptr)
         : clock_ptr(clock_source)
-        , max_thread_count(max_thread_count)
+        , max_thread_count((max_thread_count < MAX_THREAD_COUNT) ? max_thread_count : MAX_THREAD_COUNT)
         , set_pending(set_pending)
         , check_pending(check_pending)
+        , get_cycles(get_cycles)
+        , stack_overflow_handler(nullptr)
         , last_tick(0)
         , thread_count(0)
-        , task_control_blocks(std::make_unique<TaskControlBlock[]>(max_thread_count))
+        , task_control_blocks()
+        , task_details()
         , active_task(&task_control_blocks[0])
         , pending_task(nullptr)
-        , internal_task() { }
+        , internal_task()
+        , internal_task_details()
+        , ready_priority_bitmap(0)
+        , ready_lists()
+        , delayed_tasks() {
+        for ( auto& time_slice : priority_time_slices ) {
+            time_slice = default_time_slice;
+        }
+        for ( size_t index = 0; index < task_control_blocks.size(); index++ ) {
+            task_control_blocks[index].details = &task_details[index];
+        }
+        internal_task.details = &internal_task_details;
+    }
+
+    /* the task control blocks point into the scheduler's own details table */
+    scheduler_impl(const scheduler_impl&) = delete;
+    scheduler_impl& operator=(const scheduler_impl&) = delete;
 
     /**
      * \brief run the scheduling algorithm and signal any context switches to the PendSV handler if required.
      */
-    void run(void) {
+    RAM_FUNCTION void run(void) {
         uint32_t current_tick{clock_ptr->get_ticks()};
         uint32_t ticks{current_tick - last_tick};
 
-        for ( uint8_t thread = 0; thread < thread_count; thread++ ) {
-            auto tcb = &task_control_blocks[thread];
+        //!< pick up any threads that are waking up from sleep
+        wake_delayed_tasks(ticks);
 
-            //!< pick up any threads that are waking up from sleep
-            if ( tcb->thread_ptr->get_status() == thread::status::sleeping ) {
-                tcb->suspended_ticks_remaining -= ticks;
-                if ( (tcb->suspended_ticks_remaining) <= 0 ) {
-                    tcb->thread_ptr->set_status(thread::status::pending);
-                }
-            }
+        //!< charge the elapsed ticks to the active task's time slice
+        if ( active_task != &internal_task ) {
+            active_task->slice_ticks_remaining = (active_task->slice_ticks_remaining > ticks) ? active_task->slice_ticks_remaining - ticks : 0;
         }
 
-        //!< pick up any pending tasks and context switch if required
+        //!< preempt the active task if a ready task should run instead, unless a context switch is already pending
         if ( !check_pending() ) {
-            for ( uint8_t thread = 0; thread < thread_count; thread++ ) {
-                auto tcb = &task_control_blocks[thread];
-                if ( tcb->thread_ptr->get_status() == thread::status::pending ) {
-                    active_task->thread_ptr->set_status(thread::status::pending);
-                    context_switch_to(tcb);
-                    break;
-                }
-            }
+            preempt_active_task();
         }
 
         last_tick = current_tick;
@@ -106,12 +196,15 @@ class scheduler_impl {
     /**
      * \brief sleep the active thread for a set number of ticks. This will trigger a context switch to the
      *        next active thread as the current thread will be put to sleep!
-     * 
+     *
      * \param ticks how many ticks to sleep the active thread for
      */
     void sleep_thread(uint32_t ticks) {
-        active_task->suspended_ticks_remaining = ticks;
-        active_task->thread_ptr->set_status(os::thread::status::sleeping);
+        unlink_task(active_task);
+        insert_delayed_task(active_task, ticks);
+        active_task->slice_ticks_remaining = 0;
+        active_task->details->stats.yielded_count++;
+        set_task_status(active_task, thread::status::sleeping);
         jump_to_next_pending_task();
     }
 
@@ -119,35 +212,214 @@ class scheduler_impl {
      * \brief suspends the calling thread and triggers a context switch to the next available thread
      */
     void suspend_thread() {
-        active_task->thread_ptr->set_status(os::thread::status::suspended);
+        unlink_task(active_task);
+        active_task->slice_ticks_remaining = 0;
+        active_task->details->stats.yielded_count++;
+        set_task_status(active_task, thread::status::suspended);
+        jump_to_next_pending_task();
+    }
+
+    /**
+     * \brief suspend the active thread on a wait list owned by a synchronization object and trigger a context switch
+     *        to the next available thread. The wait list is kept in priority order (FIFO within a priority) using the
+     *        same intrusive links as the ready lists, so blocking never allocates.
+     *
+     * \param wait_list the wait list to block on
+     * \param timeout_ticks ticks to wait before giving up, or wait_forever
+     */
+    void block_active_task(TaskList* wait_list, uint32_t timeout_ticks = wait_forever) {
+        unlink_task(active_task);
+        insert_by_priority(wait_list, active_task);
+        active_task->wait_timed_out = false;
+        if ( timeout_ticks != wait_forever ) {
+            insert_delayed_task(active_task, timeout_ticks);
+        }
+        active_task->slice_ticks_remaining = 0;
+        active_task->details->stats.yielded_count++;
+        set_task_status(active_task, thread::status::suspended);
         jump_to_next_pending_task();
     }
 
     /**
-     * \brief register a thread with the scheduler
-     * 
+     * \brief wake the highest priority task blocked on a wait list and preempt the active task if the woken task
+     *        should run instead. Any pending timeout for the woken task is cancelled.
+     * \note when called from an interrupt the switch is only requested here, and happens in the PendSV handler
+     *       once the interrupt returns
+     *
+     * \param wait_list the wait list to wake a task from
+     * \retval TaskControlBlock* the woken task, or nullptr if the list was empty
+     */
+    TaskControlBlock* wake_waiting_task(TaskList* wait_list) {
+        auto tcb = wait_list->head;
+        if ( tcb == nullptr ) {
+            return nullptr;
+        }
+
+        wake_task(tcb);
+        preempt_active_task();
+        return tcb;
+    }
+
+    /**
+     * \brief wake a specific task blocked on a wait list and cancel any pending timeout. This never switches tasks
+     *        so several tasks can be woken at once, call reschedule() afterwards.
+     *
+     * \param tcb the task to wake
+     */
+    void wake_task(TaskControlBlock* tcb) {
+        unlink_task(tcb);
+        remove_delayed_task(tcb);
+        tcb->suspended_ticks_remaining = 0;
+        make_ready(tcb);
+        OS_TRACE_EVENT(trace_event::thread_ready, 0, tcb->id);
+    }
+
+    /**
+     * \brief change the effective priority of a task, moving it to the matching position in whichever ready or
+     *        wait list it is linked into. Used by the mutex to lend a task the priority of a thread it is blocking.
+     * \note this never switches tasks, call reschedule() afterwards if the active task may no longer be the best choice
+     *
+     * \param tcb the task
+     * \param priority the new priority
+     */
+    void set_task_priority(TaskControlBlock* tcb, uint8_t priority) {
+        if ( (tcb->priority == priority) || (priority >= thread::priority_levels) ) {
+            return;
+        }
+
+        auto list = tcb->list;
+        bool ready = (list == &ready_lists[tcb->priority]);
+        unlink_task(tcb);
+        tcb->priority = priority;
+        if ( ready ) {
+            make_ready(tcb);
+        } else if ( list != nullptr ) {
+            insert_by_priority(list, tcb);
+        }
+    }
+
+    /**
+     * \brief raise the active task's preemption threshold, so that only tasks above a priority can preempt it and
+     *        round-robin at its own priority stops. Ticks, sleeps and timeouts keep running, and a woken task that
+     *        is held off runs as soon as the threshold comes back down. Locks nest, an inner lock never lowers the
+     *        threshold of an outer one.
+     * \note the threshold belongs to the task, so other tasks run normally if it blocks while locked
+     *
+     * \param priority tasks at or below this priority can't preempt the active task
+     * \retval uint8_t the previous threshold, to pass to unlock_preemption()
+     */
+    uint8_t lock_preemption(uint8_t priority = thread::priority_levels - 1) {
+        uint8_t previous = active_task->preemption_threshold;
+        uint8_t threshold = (priority < thread::priority_levels) ? priority + 1 : thread::priority_levels;
+        if ( (active_task != &internal_task) && (threshold > previous) ) {
+            active_task->preemption_threshold = threshold;
+        }
+        return previous;
+    }
+
+    /**
+     * \brief restore the active task's preemption threshold from before a lock_preemption() call, and switch to a
+     *        task that was held off if it should now run
+     *
+     * \param previous the threshold returned by the matching lock_preemption() call
+     */
+    void unlock_preemption(uint8_t previous = 0) {
+        if ( active_task != &internal_task ) {
+            active_task->preemption_threshold = previous;
+        }
+        preempt_active_task();
+    }
+
+    /**
+     * \brief switch away from the active task if a ready task now has a higher priority
+     */
+    void reschedule(void) {
+        preempt_active_task();
+    }
+
+    /**
+     * \brief register a thread with the scheduler, in the first free task control block. Blocks are freed when
+     *        their thread exits, so threads can be registered while the kernel is running.
+     * \note the first thread registered before the kernel starts becomes the active task until start() is called,
+     *       every other thread is placed on the ready list for its priority. This never switches tasks, call
+     *       reschedule() afterwards if the new thread may need to run straight away.
+     *
      * \param thread the thread to register
      * \retval returns true if the thread registration was successful
      */
     bool register_thread(thread* thread) {
-        bool retval{false};
-        if ( thread_count < max_thread_count ) {
-            /* add the the thread object and it's stack pointer to the next empty task control block */
-            task_control_blocks[thread_count].thread_ptr = thread;
-            task_control_blocks[thread_count].active_stack_pointer = thread->get_stack_ptr();
-
-            /* setup the next pointers */
-            task_control_blocks[thread_count].next = (thread_count == 0) ? nullptr : &task_control_blocks[0];
-
-            /* move the last task blocks next pointer to the current block */
-            if ( thread_count > 0 ) {
-                task_control_blocks[thread_count - 1].next = &task_control_blocks[thread_count];
-            }
+        auto tcb = get_free_task_control_block();
+        if ( tcb == nullptr ) {
+            return false;
+        }
 
-            thread_count++;
-            retval = true;
+        /* a recycled block starts from scratch, just like the ones that have never been used */
+        auto details = tcb->details;
+        *tcb = TaskControlBlock{};
+        *details = TaskDetails{};
+        tcb->details = details;
+        tcb->thread_ptr = thread;
+        tcb->id = thread->get_id();
+        tcb->active_stack_pointer = thread->get_stack_ptr();
+        tcb->priority = thread->get_priority();
+        tcb->time_slice = thread->get_time_slice();
+        details->base_priority = tcb->priority;
+
+        /* only the very first thread can be active before the kernel starts, once it has started the internal
+           thread stands in whenever there are no other threads */
+        if ( (thread_count == 0) && (active_task != &internal_task) ) {
+            active_task = tcb;
+            tcb->slice_ticks_remaining = get_time_slice(tcb);
+            set_task_status(tcb, thread::status::active);
+        } else {
+            make_ready(tcb);
         }
-        return retval;
+
+        thread_count++;
+        link_task_control_blocks();
+        return true;
+    }
+
+    /**
+     * \brief end the active thread and switch to the next available thread. Every task joined on the thread is
+     *        woken, and the thread's task control block is free for a new thread as soon as this returns. The
+     *        thread's stack stays in use until the context switch has saved the last of its registers.
+     * \note mutexes the thread still holds are not released
+     */
+    void exit_thread(void) {
+        auto tcb = active_task;
+        if ( tcb == &internal_task ) {
+            return;
+        }
+
+        while ( tcb->details->joiners.head != nullptr ) {
+            wake_task(tcb->details->joiners.head);
+        }
+
+        tcb->slice_ticks_remaining = 0;
+        set_task_status(tcb, thread::status::exited);
+        jump_to_next_pending_task();
+
+        tcb->thread_ptr = nullptr;
+        thread_count--;
+        link_task_control_blocks();
+    }
+
+    /**
+     * \brief block the active task until another thread exits
+     *
+     * \param thread the thread to wait for
+     * \param timeout_ticks ticks to wait before giving up, or wait_forever
+     * \retval true if the active task blocked, false if the thread isn't registered or is the active thread
+     */
+    bool join_thread(thread* thread, uint32_t timeout_ticks = wait_forever) {
+        auto tcb = get_task_by_thread(thread);
+        if ( (tcb == nullptr) || (tcb == active_task) ) {
+            return false;
+        }
+
+        block_active_task(&tcb->details->joiners, timeout_ticks);
+        return true;
     }
 
     /**
@@ -157,13 +429,79 @@ class scheduler_impl {
      */
     void set_internal_task(thread* thread) {
         internal_task.thread_ptr = thread;
+        internal_task.id = thread->get_id();
         internal_task.active_stack_pointer = thread->get_stack_ptr();
         internal_task.suspended_ticks_remaining = 0;
+        internal_task.priority = 0;
+    }
+
+    /**
+     * \brief register a handler to call when a context switch detects a stack overflow
+     *
+     * \param handler the overflow handler (nullptr to disable the check)
+     */
+    void set_stack_overflow_handler(StackOverflowHandler handler) {
+        stack_overflow_handler = handler;
+    }
+
+    /**
+     * \brief set the round-robin quantum for threads at a priority level that don't specify their own.
+     *        The new quantum takes effect the next time a thread's slice is reloaded.
+     *
+     * \param priority the priority level
+     * \param ticks time slice in ticks (must be at least one)
+     */
+    void set_priority_time_slice(uint8_t priority, uint32_t ticks) {
+        if ( (priority < thread::priority_levels) && (ticks > 0) ) {
+            priority_time_slices[priority] = ticks;
+        }
+    }
+
+    /**
+     * \brief get the round-robin quantum for a task
+     *
+     * \param tcb the task
+     * \retval uint32_t time slice in ticks
+     */
+    uint32_t get_time_slice(TaskControlBlock* tcb) {
+        return (tcb->time_slice != thread::priority_time_slice) ? tcb->time_slice : priority_time_slices[tcb->priority];
+    }
+
+    /**
+     * \brief select the first task to run when the kernel starts. This does not request a context switch as the
+     *        kernel loads the active task context directly when it is entered.
+     */
+    void start(void) {
+        if ( thread_count == 0 ) {
+            active_task = &internal_task;
+        } else if ( (ready_priority_bitmap != 0) && (get_highest_ready_priority() > active_task->priority) ) {
+            auto tcb = pop_highest_ready_task();
+            make_ready(active_task);
+            active_task = tcb;
+        }
+        active_task->slice_ticks_remaining = get_time_slice(active_task);
+        account_switch(active_task, active_task);
+        set_task_status(active_task, thread::status::active);
+    }
+
+    /**
+     * \brief get the number of ticks until the next sleeping thread wakes up. This accounts for ticks that have
+     *        elapsed on the clock since the scheduler last ran.
+     *
+     * \retval std::optional<uint32_t> ticks until the next wakeup, or empty if no threads are sleeping
+     */
+    std::optional<uint32_t> get_ticks_until_next_wakeup(void) {
+        if ( delayed_tasks.head == nullptr ) {
+            return {};
+        }
+
+        int32_t remaining = delayed_tasks.head->suspended_ticks_remaining - static_cast<int32_t>(clock_ptr->get_ticks() - last_tick);
+        return static_cast<uint32_t>((remaining > 0) ? remaining : 0);
     }
 
     /**
      * \brief get the number of registered threads in the system
-     * 
+     *
      * \retval uint8_t number of threads
      */
     uint8_t get_registered_thread_count(void) {
@@ -172,7 +510,7 @@ class scheduler_impl {
 
     /**
      * \brief Get the max thread count that the scheduler can support
-     * 
+     *
      * \retval uint8_t mas supported threads
      */
     uint8_t get_max_thread_count(void) {
@@ -181,7 +519,7 @@ class scheduler_impl {
 
     /**
      * \brief get the active task control block
-     * 
+     *
      * \retval TaskControlBlock
      */
     TaskControlBlock* get_active_tcb_ptr(void) {
@@ -190,72 +528,505 @@ class scheduler_impl {
 
     /**
      * \brief Get the pending task pointer
-     * 
-     * \retval TaskControlBlock* 
+     *
+     * \retval TaskControlBlock*
      */
     TaskControlBlock* get_pending_tcb_ptr(void) {
         return pending_task;
     }
 
+    /**
+     * \brief get the id of a registered thread by its index. Threads are indexed in task control block order,
+     *        so the indices of later threads shift down when a thread exits.
+     *
+     * \param index index from 0 to get_registered_thread_count() - 1
+     * \retval std::optional<uint32_t> thread id, or empty if the index is out of range
+     */
+    std::optional<uint32_t> get_thread_id(uint8_t index) {
+        auto thread = get_thread(index);
+        if ( thread == nullptr ) {
+            return {};
+        }
+        return thread->get_id();
+    }
+
+    /**
+     * \brief get a registered thread by its index
+     *
+     * \param index index from 0 to get_registered_thread_count() - 1
+     * \retval thread* the thread, or nullptr if the index is out of range
+     */
+    thread* get_thread(uint8_t index) {
+        for ( auto& tcb : task_control_blocks ) {
+            if ( tcb.thread_ptr == nullptr ) {
+                continue;
+            }
+            if ( index == 0 ) {
+                return tcb.thread_ptr;
+            }
+            index--;
+        }
+        return nullptr;
+    }
+
+    /**
+     * \brief get the run-time statistics for a thread, including the internal OS thread. Cycles for the
+     *        active thread include the time since it was last switched in.
+     *
+     * \param id the thread id
+     * \retval std::optional<ThreadStats> copy of the statistics, or empty if no thread has the id
+     */
+    std::optional<ThreadStats> get_thread_stats(uint32_t id) {
+        TaskControlBlock* tcb = nullptr;
+        if ( (internal_task.thread_ptr != nullptr) && (internal_task.id == id) ) {
+            tcb = &internal_task;
+        } else if ( auto maybe_tcb = get_task_by_id(id); maybe_tcb ) {
+            tcb = maybe_tcb.value();
+        } else {
+            return {};
+        }
+
+        ThreadStats stats = tcb->details->stats;
+        if ( (tcb == active_task) && (get_cycles != nullptr) ) {
+            stats.cycles_run += get_cycles() - stats.switched_in_cycles;
+        }
+        return stats;
+    }
+
     /**
      * \brief get a task control block by thread id
-     * 
+     *
      * \param id the thread id
-     * \retval TaskControlBlock* pointer to the task control block     
+     * \retval TaskControlBlock* pointer to the task control block
      */
     std::optional<TaskControlBlock*> get_task_by_id(uint32_t id) {
-        for ( uint8_t thread = 0; thread < thread_count; thread++ ) {
-            auto tcb = &task_control_blocks[thread];
-            auto thread_ptr = tcb->thread_ptr;
-            if ( thread_ptr->get_id() == id ) {
-                return tcb;
+        for ( auto& tcb : task_control_blocks ) {
+            if ( (tcb.thread_ptr != nullptr) && (tcb.id == id) ) {
+                return &tcb;
             }
         }
         return {};
     }
 
+    /**
+     * \brief get the task control block of a registered thread
+     *
+     * \param thread the thread
+     * \retval TaskControlBlock* the task control block, or nullptr if the thread isn't registered
+     */
+    TaskControlBlock* get_task_by_thread(const thread* thread) {
+        for ( auto& tcb : task_control_blocks ) {
+            if ( tcb.thread_ptr == thread ) {
+                return (thread != nullptr) ? &tcb : nullptr;
+            }
+        }
+        return nullptr;
+    }
+
   private:
+    /**
+     * \brief get the first task control block without a thread
+     *
+     * \retval TaskControlBlock* the free block, or nullptr if every block up to the max thread count is in use
+     */
+    TaskControlBlock* get_free_task_control_block(void) {
+        for ( uint8_t index = 0; index < max_thread_count; index++ ) {
+            if ( task_control_blocks[index].thread_ptr == nullptr ) {
+                return &task_control_blocks[index];
+            }
+        }
+        return nullptr;
+    }
+
+    /**
+     * \brief link the next pointers of the registered task control blocks into a ring in table order. A single
+     *        registered task has no next task.
+     */
+    void link_task_control_blocks(void) {
+        TaskControlBlock* first = nullptr;
+        TaskControlBlock* last = nullptr;
+        for ( auto& tcb : task_control_blocks ) {
+            if ( tcb.thread_ptr == nullptr ) {
+                continue;
+            }
+            if ( last != nullptr ) {
+                last->next = &tcb;
+            } else {
+                first = &tcb;
+            }
+            last = &tcb;
+        }
+
+        if ( last != nullptr ) {
+            last->next = (last != first) ? first : nullptr;
+        }
+    }
+
     /**
      * \brief trigger a context switch to the thread pointer to by the task control block
-     * 
+     *
      * \param tcb pointer to the task control block
      */
     void context_switch_to(TaskControlBlock* tcb) {
+        OS_TRACE_EVENT(trace_event::thread_switch_out, static_cast<uint8_t>(active_task->status), active_task->id);
+        check_stack(active_task, false);
+        check_stack(tcb, true);
+        account_switch(active_task, tcb);
         pending_task = tcb;
-        tcb->thread_ptr->set_status(thread::status::active);
+        if ( tcb->slice_ticks_remaining == 0 ) {
+            tcb->slice_ticks_remaining = get_time_slice(tcb);
+        }
+        set_task_status(tcb, thread::status::active);
         active_task = pending_task;
         set_pending();
     }
 
+    /**
+     * \brief check a task's stack canary, and optionally its saved stack pointer, calling the overflow
+     *        handler if either is bad
+     *
+     * \param tcb the task to check
+     * \param check_saved_stack_pointer true to check the stack pointer saved at the last switch out
+     */
+    void check_stack(TaskControlBlock* tcb, bool check_saved_stack_pointer) {
+        if ( (stack_overflow_handler == nullptr) || (tcb->thread_ptr == nullptr) ) {
+            return;
+        }
+
+        auto thread = tcb->thread_ptr;
+        if ( thread->is_stack_overflowed() || (check_saved_stack_pointer && !thread->is_stack_pointer_valid(tcb->active_stack_pointer)) ) {
+            stack_overflow_handler(thread);
+        }
+    }
+
+    /**
+     * \brief update the run-time statistics for the outgoing and incoming tasks of a context switch
+     *
+     * \param outgoing the task being switched out
+     * \param incoming the task being switched in
+     */
+    void account_switch(TaskControlBlock* outgoing, TaskControlBlock* incoming) {
+        uint32_t cycles = (get_cycles != nullptr) ? get_cycles() : 0;
+        if ( outgoing != incoming ) {
+            outgoing->details->stats.cycles_run += cycles - outgoing->details->stats.switched_in_cycles;
+        }
+        auto& stats = incoming->details->stats;
+        stats.switched_in_count++;
+        stats.switched_in_cycles = cycles;
+        stats.last_run_tick = clock_ptr->get_ticks();
+    }
+
     /**
      * \brief jump to the next available task
+     * \note the active task has already been removed from the ready lists, so this always switches away from it
+     *       even if a context switch is already pending as the PendSV handler loads the latest pending task
      */
     void jump_to_next_pending_task() {
-        /* find the next active thread if a context switch is not already pending */
-        if ( !check_pending() ) {
-            for ( uint8_t thread = 0; thread < thread_count; thread++ ) {
-                auto tcb = &task_control_blocks[thread];
-                if ( (tcb->thread_ptr->get_status() == thread::status::pending) && (tcb != active_task) ) {
-                    context_switch_to(tcb);
-                    return;
-                }
-            }
+        if ( ready_priority_bitmap != 0 ) {
+            context_switch_to(pop_highest_ready_task());
+            return;
         }
 
         /* all threads are sleeping so context switch to the internal OS thread */
         context_switch_to(&internal_task);
     }
 
+    /**
+     * \brief switch from the active task to the highest priority ready task if it has a higher priority, or
+     *        round-robin to a ready task of the same priority once the active task's time slice has expired.
+     *        A preempted task goes back to the front of its ready list and keeps the rest of its slice, while
+     *        an expired task goes to the back. A task below the active task's preemption threshold can do neither.
+     *        The internal OS thread is always preempted.
+     */
+    void preempt_active_task(void) {
+        if ( active_task == &internal_task ) {
+            if ( ready_priority_bitmap != 0 ) {
+                context_switch_to(pop_highest_ready_task());
+            }
+            return;
+        }
+
+        bool slice_expired = (active_task->slice_ticks_remaining == 0);
+        if ( ready_priority_bitmap != 0 ) {
+            uint8_t highest_priority = get_highest_ready_priority();
+            bool above_threshold = (highest_priority >= active_task->preemption_threshold);
+            if ( above_threshold && ((highest_priority > active_task->priority) || ((highest_priority == active_task->priority) && slice_expired)) ) {
+                auto tcb = pop_highest_ready_task();
+                make_ready(active_task, !slice_expired);
+                active_task->details->stats.preempted_count++;
+                context_switch_to(tcb);
+                return;
+            }
+        }
+
+        /* nothing else to run at this priority, so start a fresh slice */
+        if ( slice_expired ) {
+            active_task->slice_ticks_remaining = get_time_slice(active_task);
+        }
+    }
+
+    /**
+     * \brief set the status of a task and its thread
+     *
+     * \param tcb the task
+     * \param status the new status
+     */
+    void set_task_status(TaskControlBlock* tcb, thread::status status) {
+        tcb->status = status;
+        tcb->thread_ptr->set_status(status);
+    }
+
+    /**
+     * \brief mark a task as ready to run and add it to the ready list for its priority
+     *
+     * \param tcb the task to make ready
+     * \param at_front insert at the front of the ready list instead of the back
+     */
+    void make_ready(TaskControlBlock* tcb, bool at_front = false) {
+        set_task_status(tcb, thread::status::pending);
+        if ( tcb->list == nullptr ) {
+            if ( at_front ) {
+                prepend_task(&ready_lists[tcb->priority], tcb);
+            } else {
+                append_task(&ready_lists[tcb->priority], tcb);
+            }
+            ready_priority_bitmap |= (1ul << tcb->priority);
+        }
+    }
+
+    /**
+     * \brief get the highest priority with a ready task. Requires at least one ready task.
+     *
+     * \retval uint8_t the priority level
+     */
+    uint8_t get_highest_ready_priority(void) {
+        return static_cast<uint8_t>((thread::priority_levels - 1) - __builtin_clz(ready_priority_bitmap));
+    }
+
+    /**
+     * \brief remove the first task from the highest priority ready list. Requires at least one ready task.
+     *
+     * \retval TaskControlBlock* the task
+     */
+    TaskControlBlock* pop_highest_ready_task(void) {
+        auto tcb = ready_lists[get_highest_ready_priority()].head;
+        unlink_task(tcb);
+        return tcb;
+    }
+
+    /**
+     * \brief insert a task into the delay list. The list is sorted by wakeup time and each entry stores its ticks
+     *        relative to the entry before it, so a tick only ever has to update the head of the list.
+     *
+     * \param tcb the task to delay
+     * \param ticks how many ticks to delay the task for
+     */
+    void insert_delayed_task(TaskControlBlock* tcb, uint32_t ticks) {
+        int32_t remaining = static_cast<int32_t>(ticks);
+        TaskControlBlock* previous = nullptr;
+        TaskControlBlock* current = delayed_tasks.head;
+
+        /* walk past every task that wakes up at or before this one */
+        while ( (current != nullptr) && (current->suspended_ticks_remaining <= remaining) ) {
+            remaining -= current->suspended_ticks_remaining;
+            previous = current;
+            current = current->delay_next;
+        }
+
+        tcb->suspended_ticks_remaining = remaining;
+        tcb->delay_prev = previous;
+        tcb->delay_next = current;
+        tcb->delayed = true;
+
+        if ( previous != nullptr ) {
+            previous->delay_next = tcb;
+        } else {
+            delayed_tasks.head = tcb;
+        }
+
+        if ( current != nullptr ) {
+            current->delay_prev = tcb;
+            current->suspended_ticks_remaining -= remaining;
+        } else {
+            delayed_tasks.tail = tcb;
+        }
+    }
+
+    /**
+     * \brief remove a task from the delay list, handing its remaining ticks on to the next task
+     *
+     * \param tcb the task to remove
+     */
+    void remove_delayed_task(TaskControlBlock* tcb) {
+        if ( !tcb->delayed ) {
+            return;
+        }
+
+        if ( tcb->delay_prev != nullptr ) {
+            tcb->delay_prev->delay_next = tcb->delay_next;
+        } else {
+            delayed_tasks.head = tcb->delay_next;
+        }
+
+        if ( tcb->delay_next != nullptr ) {
+            tcb->delay_next->delay_prev = tcb->delay_prev;
+            tcb->delay_next->suspended_ticks_remaining += tcb->suspended_ticks_remaining;
+        } else {
+            delayed_tasks.tail = tcb->delay_prev;
+        }
+
+        tcb->delay_next = nullptr;
+        tcb->delay_prev = nullptr;
+        tcb->delayed = false;
+    }
+
+    /**
+     * \brief advance the delay list by a number of elapsed ticks and make every expired task ready
+     *
+     * \param ticks the number of elapsed ticks
+     */
+    void wake_delayed_tasks(uint32_t ticks) {
+        if ( delayed_tasks.head == nullptr ) {
+            return;
+        }
+
+        delayed_tasks.head->suspended_ticks_remaining -= static_cast<int32_t>(ticks);
+        while ( (delayed_tasks.head != nullptr) && (delayed_tasks.head->suspended_ticks_remaining <= 0) ) {
+            auto tcb = delayed_tasks.head;
+            int32_t overshoot = tcb->suspended_ticks_remaining;
+            tcb->suspended_ticks_remaining = 0;
+            remove_delayed_task(tcb);
+
+            /* carry any extra elapsed ticks over to the next task in the list */
+            if ( delayed_tasks.head != nullptr ) {
+                delayed_tasks.head->suspended_ticks_remaining += overshoot;
+            }
+
+            /* a task that is still on a wait list has timed out waiting on a synchronization object */
+            if ( tcb->list != nullptr ) {
+                unlink_task(tcb);
+                tcb->wait_timed_out = true;
+            }
+            make_ready(tcb);
+            OS_TRACE_EVENT(trace_event::thread_ready, 0, tcb->id);
+        }
+    }
+
+    /**
+     * \brief append a task to the tail of a task list
+     *
+     * \param list the list
+     * \param tcb the task to append
+     */
+    void append_task(TaskList* list, TaskControlBlock* tcb) {
+        tcb->list = list;
+        tcb->list_next = nullptr;
+        tcb->list_prev = list->tail;
+        if ( list->tail != nullptr ) {
+            list->tail->list_next = tcb;
+        } else {
+            list->head = tcb;
+        }
+        list->tail = tcb;
+    }
+
+    /**
+     * \brief insert a task at the head of a task list
+     *
+     * \param list the list
+     * \param tcb the task to insert
+     */
+    void prepend_task(TaskList* list, TaskControlBlock* tcb) {
+        tcb->list = list;
+        tcb->list_prev = nullptr;
+        tcb->list_next = list->head;
+        if ( list->head != nullptr ) {
+            list->head->list_prev = tcb;
+        } else {
+            list->tail = tcb;
+        }
+        list->head = tcb;
+    }
+
+    /**
+     * \brief insert a task into a task list behind every task of the same or higher priority
+     *
+     * \param list the list
+     * \param tcb the task to insert
+     */
+    void insert_by_priority(TaskList* list, TaskControlBlock* tcb) {
+        auto current = list->head;
+        while ( (current != nullptr) && (current->priority >= tcb->priority) ) {
+            current = current->list_next;
+        }
+
+        if ( current == nullptr ) {
+            append_task(list, tcb);
+            return;
+        }
+
+        tcb->list = list;
+        tcb->list_next = current;
+        tcb->list_prev = current->list_prev;
+        if ( current->list_prev != nullptr ) {
+            current->list_prev->list_next = tcb;
+        } else {
+            list->head = tcb;
+        }
+        current->list_prev = tcb;
+    }
+
+    /**
+     * \brief remove a task from whichever list it is linked into (if any)
+     *
+     * \param tcb the task to unlink
+     */
+    void unlink_task(TaskControlBlock* tcb) {
+        auto list = tcb->list;
+        if ( list == nullptr ) {
+            return;
+        }
+
+        if ( tcb->list_prev != nullptr ) {
+            tcb->list_prev->list_next = tcb->list_next;
+        } else {
+            list->head = tcb->list_next;
+        }
+
+        if ( tcb->list_next != nullptr ) {
+            tcb->list_next->list_prev = tcb->list_prev;
+        } else {
+            list->tail = tcb->list_prev;
+        }
+
+        tcb->list = nullptr;
+        tcb->list_next = nullptr;
+        tcb->list_prev = nullptr;
+
+        /* clear the ready bit if this emptied the ready list for the task's priority */
+        if ( (list == &ready_lists[tcb->priority]) && (list->head == nullptr) ) {
+            ready_priority_bitmap &= ~(1ul << tcb->priority);
+        }
+    }
+
     system_clock_impl* clock_ptr;
     uint8_t max_thread_count;
     SetPendingInterrupt set_pending;
     IsInterruptPending check_pending;
+    GetCycleCount get_cycles;
+    StackOverflowHandler stack_overflow_handler;
     uint32_t last_tick;
     uint8_t thread_count;
-    std::unique_ptr<TaskControlBlock[]> task_control_blocks;
+    std::array<TaskControlBlock, MAX_THREAD_COUNT> task_control_blocks;
+    std::array<TaskDetails, MAX_THREAD_COUNT> task_details;
     TaskControlBlock* active_task;
     TaskControlBlock* pending_task;
     TaskControlBlock internal_task;
+    TaskDetails internal_task_details;
+    uint32_t ready_priority_bitmap;
+    TaskList ready_lists[thread::priority_levels];
+    TaskList delayed_tasks;
+    uint32_t priority_time_slices[thread::priority_levels];
 };
 
 };  // namespace os
@@ -0,0 +1,65 @@
+/**
+ * \file os_semaphore.h
+ * \author Graham Riches (graham.riches@live.com)
+ * \brief counting semaphore for application threads and interrupts
+ * \version 0.1
+ * \date 2021-05-10
+ * 
+ * @copyright Copyright (c) 2021
+ * 
+ */
+
+#pragma once
+
+/********************************** Includes *******************************************/
+#include "semaphore_impl.h"
+
+namespace os
+{
+
+/**
+ * \brief counting semaphore that blocks on the os scheduler. Every call runs in a critical section.
+ */
+class semaphore : public counting_semaphore<int32_t> {
+  public:
+    /**
+     * \brief Construct a new semaphore
+     * 
+     * \param initial_count initial count for the resource
+     * \param max_count the count saturates here when signalled with no threads waiting
+     */
+    explicit semaphore(int32_t initial_count, int32_t max_count = INT32_MAX);
+
+    /**
+     * \brief wait on the semaphore, suspending the calling thread until it is available
+     */
+    void wait();
+
+    /**
+     * \brief take the semaphore if it is available without blocking
+     * 
+     * \retval true if the semaphore was taken
+     */
+    bool try_wait();
+
+    /**
+     * \brief wait on the semaphore for up to a number of ticks
+     * 
+     * \param ticks max ticks to wait (0 behaves like try_wait)
+     * \retval true if the semaphore was taken, false on timeout
+     */
+    bool wait_for(uint32_t ticks);
+
+    /**
+     * \brief signal the semaphore from a thread, switching straight to a woken thread if it has a higher priority
+     */
+    void signal();
+
+    /**
+     * \brief signal the semaphore from an interrupt handler. Any context switch this causes is deferred to the
+     *        PendSV handler, which runs once every active interrupt has returned.
+     */
+    void signal_from_isr();
+};
+
+};  // namespace os
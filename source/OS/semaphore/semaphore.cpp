@@ -0,0 +1,80 @@
+/**
+ * \file semaphore.cpp
+ * \author Graham Riches (graham.riches@live.com)
+ * \brief counting semaphore for application threads and interrupts
+ * \version 0.1
+ * \date 2021-05-10
+ * 
+ * @copyright Copyright (c) 2021
+ * 
+ */
+
+/********************************** Includes *******************************************/
+#include "os_semaphore.h"
+#include "cm4_port.h"
+#include "scheduler.h"
+#include "trace.h"
+
+namespace os
+{
+
+/********************************** Function Definitions *******************************************/
+//!< construct a semaphore on the os scheduler
+semaphore::semaphore(int32_t initial_count, int32_t max_count)
+    : counting_semaphore<int32_t>(&scheduler::get(), initial_count, max_count) { }
+
+//!< wait on the semaphore with no timeout
+void semaphore::wait() {
+    wait_for(scheduler::wait_forever);
+}
+
+//!< take the semaphore if it is available
+bool semaphore::try_wait() {
+    critical_section critical;
+    bool taken = counting_semaphore::try_wait();
+    if ( taken ) {
+        OS_TRACE_EVENT(trace_event::semaphore_take, 0, reinterpret_cast<uintptr_t>(this));
+    }
+    return taken;
+}
+
+//!< wait on the semaphore with a timeout
+bool semaphore::wait_for(uint32_t ticks) {
+    scheduler::TaskControlBlock* tcb;
+    {
+        critical_section critical;
+        if ( counting_semaphore::try_wait() ) {
+            OS_TRACE_EVENT(trace_event::semaphore_take, 0, reinterpret_cast<uintptr_t>(this));
+            return true;
+        }
+
+        if ( ticks == 0 ) {
+            return false;
+        }
+
+        tcb = scheduler::get_active_task_control_block();
+        OS_TRACE_EVENT(trace_event::semaphore_block, 0, reinterpret_cast<uintptr_t>(this));
+        block(ticks);
+    }
+
+    /* the PendSV handler switches away as soon as the critical section ends, and this thread only runs again once
+       it has been handed the semaphore or the wait has timed out */
+    return !tcb->wait_timed_out;
+}
+
+//!< signal the semaphore from a thread
+void semaphore::signal() {
+    critical_section critical;
+    OS_TRACE_EVENT(trace_event::semaphore_signal, 0, reinterpret_cast<uintptr_t>(this));
+    counting_semaphore::signal();
+}
+
+//!< signal the semaphore from an interrupt
+void semaphore::signal_from_isr() {
+    uint32_t interrupt_mask = enter_critical_from_isr();
+    OS_TRACE_EVENT(trace_event::semaphore_signal, 0, reinterpret_cast<uintptr_t>(this));
+    counting_semaphore::signal();
+    exit_critical_from_isr(interrupt_mask);
+}
+
+};  // namespace os
@@ -2,20 +2,21 @@
  * \file semaphore_impl.h
  * \author Graham Riches (graham.riches@live.com)
  * \brief contains a basic templated semaphore primative that is used to build OS
- *        synchronization primatives. 
+ *        synchronization primatives.
  * \version 0.1
  * \date 2021-05-01
- * 
+ *
  * @copyright Copyright (c) 2021
- * 
+ *
  */
 
 #pragma once
 
 /********************************** Includes *******************************************/
+#include <limits>
 #include <type_traits>
-#include "ring_buffer.h"
 #include "scheduler_impl.h"
+#include "wait_any_impl.h"
 
 
 namespace os {
@@ -23,57 +24,116 @@ namespace os {
 /********************************** Types *******************************************/
 
 /**
- * \brief semaphore type that is implemented with an arbitrary integral type T
- * 
+ * \brief semaphore type that is implemented with an arbitrary integral type T. Waiting threads are linked into
+ *        an intrusive wait list through their task control blocks, so the semaphore allocates nothing and can
+ *        hold any number of waiters. A signal with threads waiting hands the count straight to the highest
+ *        priority waiter instead of incrementing it, so a woken thread never has to re-check the count.
+ * \note this is not interrupt safe by itself, callers must wrap each call in a critical section
+ *
  * \tparam T integral semaphore type
  */
 template <typename T>
 class counting_semaphore {
     public:
-        static_assert(std::is_integral<T>::type, "Semaphore must be created with an integral type");
-        
+        static_assert(std::is_integral<T>::value, "Semaphore must be created with an integral type");
+
         /**
          * \brief Construct a new counting semaphore object
-         * 
+         *
          * \param scheduler_ptr pointer to a scheduler
          * \param initial_count initial count for the resource
-         * \param max_pending_thread_count max pending thread depth (for sizing the suspended threads queue)
-         * \todo the size of this can be optimized to be less than the max thread count because the thread cannot
-         *       suspend on itself so this can save a bit of memory in the future
+         * \param max_count the count saturates here when signalled with no threads waiting
          */
-        counting_semaphore(scheduler_impl* scheduler_ptr, T initial_count, uint8_t max_pending_thread_count)
+        counting_semaphore(scheduler_impl* scheduler_ptr, T initial_count, T max_count = std::numeric_limits<T>::max())
         : count(initial_count)
-        , max_pending_threads(max_pending_thread_count)
-        , pending_threads(max_pending_thread_count)
+        , max_count(max_count)
+        , waiting_threads()
+        , watchers()
         , scheduler_ptr(scheduler_ptr) {}
 
+        //!< disable moves and copies as waiting threads point back into the wait list
+        counting_semaphore(const counting_semaphore& other) = delete;
+        counting_semaphore(counting_semaphore&& other) = delete;
+        counting_semaphore& operator = (const counting_semaphore& other) = delete;
+        counting_semaphore& operator = (counting_semaphore&& other) = delete;
+
         /**
-         * \brief try to wait on the semaphore. This will suspend the calling thread if the resource is not available
+         * \brief take the semaphore if the resource is available, without blocking
+         *
+         * \retval true if the semaphore was taken
          */
-        void wait() {
-            auto tcb = scheduler::get_active_task_control_block();            
-            if ( count <= 0 ){                
-                pending_threads.push(tcb);
-                scheduler_ptr->suspend_thread();
+        bool try_wait() {
+            if ( count > 0 ) {
+                count--;
+                return true;
             }
-            count--;
+            return false;
         }
 
         /**
-         * \brief signal the semaphore and wake up the next thread that is pending
+         * \brief suspend the active thread on the semaphore. Call this after try_wait() has failed.
+         * \note the context switch happens once the caller leaves its critical section. When the thread runs
+         *       again it either holds the semaphore, or its task control block has wait_timed_out set.
+         *
+         * \param timeout_ticks ticks to wait before giving up, or scheduler_impl::wait_forever
          */
-        void signal() {             
-            //!< wake up the first pending thread
-            if (!pending_threads.is_empty()) {
-                auto maybe_task = pending_threads.pop();
-                if (maybe_task.has_value()) {
-                    auto tcb = maybe_task.value();
-                    tcb->thread_ptr->set_status(thread::status::pending);
-                }
+        void block(uint32_t timeout_ticks = scheduler_impl::wait_forever) {
+            scheduler_ptr->block_active_task(&waiting_threads, timeout_ticks);
+        }
+
+        /**
+         * \brief signal the semaphore, waking the highest priority waiting thread if there is one. Otherwise the
+         *        count goes up and any threads waiting on the semaphore in wait_for_any() are woken to take it.
+         */
+        void signal() {
+            if ( scheduler_ptr->wake_waiting_task(&waiting_threads) != nullptr ) {
+                return;
             }
-            
-            //!< increment the semaphore
-            count++;
+
+            if ( count < max_count ) {
+                count++;
+            }
+            watchers.notify(scheduler_ptr);
+        }
+
+        /**
+         * \brief check if the semaphore can be taken, for wait_for_any()
+         *
+         * \param mask unused
+         * \param options unused
+         * \retval true if the count is above zero
+         */
+        bool is_ready(uint32_t mask = 0, uint8_t options = 0) const {
+            static_cast<void>(mask);
+            static_cast<void>(options);
+            return (count > 0);
+        }
+
+        /**
+         * \brief get the threads waiting on the semaphore in wait_for_any()
+         *
+         * \retval wait_any_list& the waiters
+         */
+        wait_any_list& get_watchers() {
+            return watchers;
+        }
+
+        /**
+         * \brief get the current count
+         *
+         * \retval T the count
+         */
+        T get_count() const {
+            return count;
+        }
+
+        /**
+         * \brief check if any threads are blocked on the semaphore
+         *
+         * \retval true/false
+         */
+        bool has_waiting_threads() const {
+            return (waiting_threads.head != nullptr);
         }
 
         ~counting_semaphore(){}
@@ -81,9 +141,10 @@ class counting_semaphore {
 
     protected:
     T count;
-    const uint8_t max_pending_threads;
-    RingBuffer<scheduler::TaskControlBlock> pending_threads;
+    const T max_count;
+    scheduler_impl::TaskList waiting_threads;
+    wait_any_list watchers;
     scheduler_impl* scheduler_ptr;
 };
 
-};
\ No newline at end of file
+};
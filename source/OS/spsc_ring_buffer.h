@@ -0,0 +1,218 @@
+/*! \file spsc_ring_buffer.h
+*
+*  \brief lock-free single producer single consumer ring buffer.
+*
+*
+*  \author Graham Riches
+*/
+
+#pragma once
+
+/********************************** Includes *******************************************/
+#include "buffer_span.h"
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <optional>
+
+/*********************************** Consts ********************************************/
+
+/************************************ Types ********************************************/
+/**
+ * \brief ring buffer that is safe to share between exactly one producer and one consumer (ie. a thread
+ *        and an ISR) without disabling interrupts. The head is only written by the producer and the tail
+ *        only by the consumer, and both run freely so the buffer can use every slot without a full flag.
+ *        The capacity must be a power of two so indexing is a mask instead of a divide.
+ *
+ * \tparam T parameter type
+ * \tparam N capacity of the buffer
+ */
+template <typename T, size_t N>
+class SPSCRingBuffer {
+    static_assert((N > 0) && ((N & (N - 1)) == 0), "SPSC ring buffer capacity must be a power of two");
+
+  private:
+    static constexpr size_t mask = N - 1;
+    T buffer[N];
+    std::atomic<size_t> head{0};  //!< next slot to write, only modified by the producer
+    std::atomic<size_t> tail{0};  //!< next slot to read, only modified by the consumer
+
+  public:
+    SPSCRingBuffer()
+        : buffer() { }
+
+    //!< delete copies and moves
+    SPSCRingBuffer(const SPSCRingBuffer& other) = delete;
+    SPSCRingBuffer(SPSCRingBuffer&& other) = delete;
+    SPSCRingBuffer& operator = (const SPSCRingBuffer& other) = delete;
+    SPSCRingBuffer& operator = (SPSCRingBuffer&& other) = delete;
+
+    /**
+     * \brief put data onto the ring buffer (producer only)
+     *
+     * \param data to put into the ring buffer
+     * \return True if the put was successful
+     */
+    bool push(T data) {
+        size_t current_head = this->head.load(std::memory_order_relaxed);
+
+        /* acquire pairs with the consumer releasing the slot it just read */
+        if ( (current_head - this->tail.load(std::memory_order_acquire)) == N ) {
+            return false;
+        }
+
+        this->buffer[current_head & mask] = data;
+
+        /* release publishes the data before the consumer can see the new head */
+        this->head.store(current_head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * \brief get data off the ring buffer (consumer only)
+     *
+     * \retval T
+     */
+    std::optional<T> pop(void) {
+        size_t current_tail = this->tail.load(std::memory_order_relaxed);
+
+        /* acquire pairs with the producer publishing the data */
+        if ( current_tail == this->head.load(std::memory_order_acquire) ) {
+            return std::optional<T>();
+        }
+
+        auto value = this->buffer[current_tail & mask];
+
+        /* release hands the slot back to the producer only after the data has been read */
+        this->tail.store(current_tail + 1, std::memory_order_release);
+        return value;
+    }
+
+    /**
+     * \brief put a block of data onto the ring buffer (producer only). Copies as much as fits and then
+     *        publishes it all with a single release, so the consumer sees the whole block at once.
+     *
+     * \param data pointer to the data to put into the ring buffer
+     * \param count number of elements to put
+     * \retval size_t number of elements actually put
+     */
+    size_t push_bulk(const T* data, size_t count) {
+        size_t current_head = this->head.load(std::memory_order_relaxed);
+        size_t free_space = N - (current_head - this->tail.load(std::memory_order_acquire));
+        size_t total = std::min(count, free_space);
+        size_t start = current_head & mask;
+        size_t first_run = std::min(total, N - start);
+
+        std::copy_n(data, first_run, &this->buffer[start]);
+        std::copy_n(data + first_run, total - first_run, &this->buffer[0]);
+
+        this->head.store(current_head + total, std::memory_order_release);
+        return total;
+    }
+
+    /**
+     * \brief get a block of data off the ring buffer (consumer only)
+     *
+     * \param data pointer to the destination
+     * \param count max number of elements to get
+     * \retval size_t number of elements actually got
+     */
+    size_t pop_bulk(T* data, size_t count) {
+        size_t current_tail = this->tail.load(std::memory_order_relaxed);
+        size_t available = this->head.load(std::memory_order_acquire) - current_tail;
+        size_t total = std::min(count, available);
+        size_t start = current_tail & mask;
+        size_t first_run = std::min(total, N - start);
+
+        std::copy_n(&this->buffer[start], first_run, data);
+        std::copy_n(&this->buffer[0], total - first_run, data + first_run);
+
+        this->tail.store(current_tail + total, std::memory_order_release);
+        return total;
+    }
+
+    /**
+     * \brief get the largest linear block of stored data starting at the tail without removing it (consumer only)
+     *
+     * \retval BufferSpan<T> the readable block (zero size when empty)
+     */
+    BufferSpan<T> peek_contiguous(void) {
+        size_t current_tail = this->tail.load(std::memory_order_relaxed);
+        size_t available = this->head.load(std::memory_order_acquire) - current_tail;
+        size_t start = current_tail & mask;
+        return {&this->buffer[start], std::min(available, N - start)};
+    }
+
+    /**
+     * \brief release elements that were read through peek_contiguous back to the producer (consumer only)
+     *
+     * \param count number of elements to release. Must not exceed the size of the last peeked span.
+     */
+    void commit(size_t count) {
+        this->tail.store(this->tail.load(std::memory_order_relaxed) + count, std::memory_order_release);
+    }
+
+    /**
+     * \brief get the largest linear block of free space starting at the head (producer only)
+     *
+     * \retval BufferSpan<T> the writable block (zero size when full)
+     */
+    BufferSpan<T> reserve_contiguous(void) {
+        size_t current_head = this->head.load(std::memory_order_relaxed);
+        size_t free_space = N - (current_head - this->tail.load(std::memory_order_acquire));
+        size_t start = current_head & mask;
+        return {&this->buffer[start], std::min(free_space, N - start)};
+    }
+
+    /**
+     * \brief publish elements that were written through reserve_contiguous to the consumer (producer only)
+     *
+     * \param count number of elements written. Must not exceed the size of the last reserved span.
+     */
+    void publish(size_t count) {
+        this->head.store(this->head.load(std::memory_order_relaxed) + count, std::memory_order_release);
+    }
+
+    /**
+     * \brief check if the buffer is empty
+     *
+     * \retval true/false
+     */
+    bool is_empty(void) {
+        return (this->head.load(std::memory_order_acquire) == this->tail.load(std::memory_order_acquire));
+    }
+
+    /**
+     * \brief check if the buffer is full
+     *
+     * \retval true/false
+     */
+    bool is_full(void) {
+        return ((this->head.load(std::memory_order_acquire) - this->tail.load(std::memory_order_acquire)) == N);
+    }
+
+    /**
+     * \brief get the number of elements in the buffer
+     *
+     * \retval size_t element count
+     */
+    size_t size(void) {
+        return (this->head.load(std::memory_order_acquire) - this->tail.load(std::memory_order_acquire));
+    }
+
+    /**
+     * \brief get the capacity of the buffer
+     *
+     * \retval size_t max element count
+     */
+    static constexpr size_t capacity(void) {
+        return N;
+    }
+
+    /**
+     * \brief flush data out of the ring buffer (consumer only)
+     */
+    void flush(void) {
+        this->tail.store(this->head.load(std::memory_order_acquire), std::memory_order_release);
+    }
+};
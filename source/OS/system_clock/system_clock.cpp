@@ -11,6 +11,7 @@
 
 /********************************** Includes *******************************************/
 #include "system_clock.h"
+#include "cm4_port.h"
 
 namespace os
 {
@@ -31,6 +32,18 @@ uint32_t system_clock::get_elapsed_ticks(void) {
     return self.get_ticks();
 }
 
+//!< get elapsed clock ticks without wrapping
+uint64_t system_clock::get_elapsed_ticks_64(void) {
+    auto& self = get();
+    return self.get_ticks_64();
+}
+
+//!< get elapsed time in microseconds
+uint64_t system_clock::get_elapsed_microseconds(void) {
+    auto& self = get();
+    return self.get_microseconds();
+}
+
 //!< update the clock with elapsed ticks
 void system_clock::update_sytem_ticks(uint32_t ticks) {
     auto& self = get();
@@ -40,6 +53,7 @@ void system_clock::update_sytem_ticks(uint32_t ticks) {
 //!< start the system clock
 void system_clock::initialize() {
     auto& self = get();
+    self.set_sub_tick_counter(get_tick_counts, get_tick_period_counts());
     self.start();
 }
 
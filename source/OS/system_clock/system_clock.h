@@ -37,6 +37,20 @@ class system_clock : public system_clock_impl {
      */
     static uint32_t get_elapsed_ticks(void);
 
+    /**
+     * \brief get the elapsed system tick time as a 64-bit count
+     * 
+     * \retval uint64_t elapsed ticks
+     */
+    static uint64_t get_elapsed_ticks_64(void);
+
+    /**
+     * \brief get the elapsed time in microseconds, interpolated between ticks with the SysTick counter
+     * 
+     * \retval uint64_t elapsed microseconds
+     */
+    static uint64_t get_elapsed_microseconds(void);
+
     /**
      * \brief update the system clock
      * 
@@ -45,7 +59,8 @@ class system_clock : public system_clock_impl {
     static void update_sytem_ticks(uint32_t ticks);
 
     /**
-     * \brief initialize the system clock
+     * \brief initialize the system clock. The SysTick must already be configured, as its reload value
+     *        sets the sub-tick resolution.
      */
     static void initialize();
 
@@ -19,30 +19,95 @@ namespace os
  */
 class system_clock_impl {
   public:
+    //!< rate of the periodic system tick
+    static constexpr uint32_t tick_frequency_hz = 1000;
+    static constexpr uint32_t microseconds_per_tick = 1000000 / tick_frequency_hz;
+
+    /**
+     * \brief function that returns the hardware counts elapsed since the last tick the clock was updated with.
+     *        If a tick has happened but not been counted yet the result must include it, so it can be larger
+     *        than a tick period.
+     */
+    using sub_tick_counter = uint32_t (*)(void);
+
     /**
      * \brief default constructor for the system clock
      */
     system_clock_impl(void)
         : elapsed_ticks(0)
-        , running(false) { }
+        , tick_epoch(0)
+        , running(false)
+        , read_sub_tick_counts(nullptr)
+        , counts_per_tick(1) { }
 
     /**
      * \brief get the elapsed system tick time
-     * 
+     *
      * \retval uint32_t elapsed ticks
      */
     uint32_t get_ticks(void) {
         return elapsed_ticks;
     }
 
+    /**
+     * \brief get the elapsed system tick time as a 64-bit count that never wraps in practice
+     *
+     * \retval uint64_t elapsed ticks
+     */
+    uint64_t get_ticks_64(void) {
+        uint32_t epoch;
+        uint32_t ticks;
+        do {
+            epoch = tick_epoch;
+            ticks = elapsed_ticks;
+        } while ( (epoch != tick_epoch) || (ticks != elapsed_ticks) );
+        return (static_cast<uint64_t>(epoch) << 32) | ticks;
+    }
+
+    /**
+     * \brief get the elapsed time in microseconds, using the sub-tick counter between ticks if one is set
+     * \note this is safe to call from any context without a critical section. The read is retried if a tick
+     *       lands part way through it.
+     *
+     * \retval uint64_t elapsed microseconds
+     */
+    uint64_t get_microseconds(void) {
+        uint32_t epoch;
+        uint32_t ticks;
+        uint32_t counts;
+        do {
+            epoch = tick_epoch;
+            ticks = elapsed_ticks;
+            counts = (read_sub_tick_counts != nullptr) ? read_sub_tick_counts() : 0;
+        } while ( (epoch != tick_epoch) || (ticks != elapsed_ticks) );
+
+        uint64_t whole_ticks = (static_cast<uint64_t>(epoch) << 32) | ticks;
+        return (whole_ticks * microseconds_per_tick) + ((counts * microseconds_per_tick) / counts_per_tick);
+    }
+
+    /**
+     * \brief set the hardware counter used to interpolate between ticks
+     *
+     * \param counter function returning the counts since the last tick, or nullptr for tick resolution only
+     * \param counts counter counts per tick period. counts * microseconds_per_tick * 2 must fit in 32 bits.
+     */
+    void set_sub_tick_counter(sub_tick_counter counter, uint32_t counts) {
+        read_sub_tick_counts = counter;
+        counts_per_tick = (counts > 0) ? counts : 1;
+    }
+
     /**
      * \brief update the system clock
-     * 
+     *
      * \param ticks number of elapsed ticks since last update
      */
     void update(uint32_t ticks) {
         if ( running ) {
-            elapsed_ticks += ticks;
+            uint32_t previous = elapsed_ticks;
+            elapsed_ticks = previous + ticks;
+            if ( elapsed_ticks < previous ) {
+                tick_epoch = tick_epoch + 1;
+            }
         }
     }
 
@@ -55,7 +120,10 @@ class system_clock_impl {
 
   private:
     volatile uint32_t elapsed_ticks;
+    volatile uint32_t tick_epoch;  //!< number of times elapsed_ticks has wrapped, the upper half of the 64-bit count
     bool running;
+    sub_tick_counter read_sub_tick_counts;
+    uint32_t counts_per_tick;
 };
 
 };  // namespace os
@@ -15,26 +15,48 @@ namespace os
 {
 
 /*********************************** Consts ********************************************/
-#define CONTEXT_STACK_SIZE (16ul)        //!< number of default saved stack registers
+#define CONTEXT_STACK_SIZE (18ul)        //!< number of default saved stack registers
 #define PSR_THUMB_MODE     (0x01000000)  //!< set PSR register to THUMB
+#define EXC_RETURN_THREAD  (0xFFFFFFFD)  //!< return to thread mode on the process stack with a basic (non-FPU) frame
 #define SYSTEM_MAX_THREADS (16ul)        //!< number of allowed threads
 
 /************************************ Types ********************************************/
 
+/******************************** Static Members ***************************************/
+thread::exit_handler_pointer thread::exit_handler = nullptr;
+
 /****************************** Method Definitions ***********************************/
 
-thread::thread(task_pointer task_ptr, void *arguments, uint32_t id, uint32_t* stack_ptr, uint32_t stack_size) 
+thread::thread(task_pointer task_ptr, void *arguments, uint32_t id, uint32_t* stack_ptr, uint32_t stack_size, uint8_t priority, uint32_t time_slice) 
 : task_ptr(task_ptr)
 , task_arguments_ptr(arguments)
 , id(id)
 , stack_top_ptr(stack_ptr)
 , stack_ptr(stack_ptr)
 , stack_size(stack_size)
-, task_status(status::pending) {
+, priority(priority)
+, time_slice(time_slice)
+, task_status(status::pending)
+#ifdef OS_UNPRIVILEGED_THREADS
+, privileged(false) {
+#else
+, privileged(true) {
+#endif
     
     assert(task_ptr != nullptr);
     assert(stack_ptr != nullptr);
     assert(stack_size > 0);
+    assert(priority < priority_levels);
+
+#ifdef OS_STACK_PAINTING
+    /* paint the stack so the high water mark can be found later */
+    for ( uint32_t word = 0; word < stack_size; word++ ) {
+        stack_ptr[word] = stack_paint_pattern;
+    }
+#endif
+
+    /* the stack grows down, so the lowest word is the last one to be written before an overflow */
+    stack_ptr[0] = stack_canary;
 
     /* initialize the threads stack with some setup values */
     register_context* task_context = reinterpret_cast<register_context*>(&stack_ptr[stack_size - CONTEXT_STACK_SIZE]);
@@ -42,12 +64,23 @@ thread::thread(task_pointer task_ptr, void *arguments, uint32_t id, uint32_t* st
     /* set the task to run in thumb mode */
     task_context->psr = PSR_THUMB_MODE;
 
+    /* threads start without an FPU context, so the first switch back in takes the integer only path */
+    task_context->exc_return = EXC_RETURN_THREAD;
+
+    /* the PendSV handler restores the thread's privilege level along with its registers */
+    task_context->control = privileged ? 0 : control_unprivileged;
+
     /* set the program counter to the function pointer for the thread */
     //task_context->pc = reinterpret_cast<uint32_t>(task_ptr);
     task_context->pc = static_cast<uint32_t>(reinterpret_cast<std::uintptr_t>(task_ptr));
 
+    /* a task function that returns goes to the exit trampoline */
+    task_context->lr = static_cast<uint32_t>(reinterpret_cast<std::uintptr_t>(&thread::exit_trampoline));
+
+    /* the task function takes its arguments in r0 */
+    task_context->r0 = static_cast<uint32_t>(reinterpret_cast<std::uintptr_t>(this->task_arguments_ptr));
+
     /* set some garbo values to watch the registers during debugging */
-    task_context->r0 = 0;
     task_context->r1 = 1;
     task_context->r2 = 2;
     task_context->r3 = 3;
@@ -68,25 +101,91 @@ thread::thread(task_pointer task_ptr, void *arguments, uint32_t id, uint32_t* st
 }
 
 
-void thread::set_status(thread::status status) {
-    this->task_status = status;
+uint32_t thread::get_id(void) {
+    return id;
+}
+
+
+uint32_t* thread::get_stack_ptr(void){
+    return stack_ptr;
 }
 
 
-thread::status thread::get_status(void) {
-    return task_status;
+uint8_t thread::get_priority(void) {
+    return priority;
 }
 
 
-uint32_t thread::get_id(void) {
-    return id;
+uint32_t thread::get_time_slice(void) {
+    return time_slice;
 }
 
 
-uint32_t* thread::get_stack_ptr(void){
-    return stack_ptr;
+uint32_t thread::get_stack_size(void) {
+    return stack_size;
+}
+
+
+uint32_t thread::get_stack_high_water_mark(void) {
+    uint32_t unused = 0;
+    uint32_t word = 1;
+
+#ifdef OS_MPU_STACK_GUARD
+    /* reading the guard region of the running thread would fault, and it can never be written anyway */
+    word = static_cast<uint32_t>(get_stack_guard() - stack_top_ptr) + (stack_guard_size / sizeof(uint32_t));
+    unused = word - 1;
+#endif
+
+    /* skip the canary and count up until the first word the thread has written */
+    for ( ; (word < stack_size) && (stack_top_ptr[word] == stack_paint_pattern); word++ ) {
+        unused++;
+    }
+    return (stack_size - 1) - unused;
+}
+
+
+bool thread::is_stack_overflowed(void) {
+    return (stack_top_ptr[0] != stack_canary);
+}
+
+
+bool thread::is_stack_pointer_valid(const uint32_t* sp) {
+    return (sp > stack_top_ptr) && (sp <= (stack_top_ptr + stack_size));
+}
+
+
+uint32_t* thread::get_stack_guard(void) {
+    std::uintptr_t above_canary = reinterpret_cast<std::uintptr_t>(stack_top_ptr + 1);
+    return reinterpret_cast<uint32_t*>((above_canary + (stack_guard_size - 1)) & ~static_cast<std::uintptr_t>(stack_guard_size - 1));
+}
+
+
+void thread::set_privileged(bool run_privileged) {
+    privileged = run_privileged;
+    register_context* task_context = reinterpret_cast<register_context*>(&stack_top_ptr[stack_size - CONTEXT_STACK_SIZE]);
+    task_context->control = privileged ? 0 : control_unprivileged;
+}
+
+
+bool thread::is_privileged(void) {
+    return privileged;
 }
 
 
+void thread::set_exit_handler(exit_handler_pointer handler) {
+    exit_handler = handler;
+}
+
+
+void thread::exit_trampoline(void) {
+    if ( exit_handler != nullptr ) {
+        exit_handler();
+    }
+
+    /* the exit handler switches away for good, so this is only reached without one */
+    while ( true ) {
+    }
+}
+
 
 };  // namespace os
@@ -25,6 +25,7 @@ class thread {
      *        default register state.
      */
     struct register_context {
+        uint32_t control;     //!< saved CONTROL.nPRIV, set if the thread runs unprivileged
         uint32_t r4;
         uint32_t r5;
         uint32_t r6;
@@ -33,6 +34,7 @@ class thread {
         uint32_t r9;
         uint32_t r10;
         uint32_t r11;
+        uint32_t exc_return;  //!< saved EXC_RETURN value, bit 4 clear if S16-S31 were stacked above this context
         uint32_t r0;
         uint32_t r1;
         uint32_t r2;
@@ -51,6 +53,7 @@ class thread {
         suspended,
         sleeping,
         pending,
+        exited,
     };    
 
     /**
@@ -58,6 +61,48 @@ class thread {
      */
     using task_pointer = void (*)(void *arguments);
 
+    /**
+     * \brief function pointer to the handler that ends a thread whose task function has returned
+     */
+    using exit_handler_pointer = void (*)(void);
+
+    /**
+     * \brief number of supported thread priority levels. Higher values are higher priority, which lets the
+     *        scheduler pick the highest ready priority with a single count leading zeros instruction.
+     */
+    static constexpr uint8_t priority_levels = 32;
+
+    /**
+     * \brief default priority for threads that do not specify one (lowest priority)
+     */
+    static constexpr uint8_t default_priority = 0;
+
+    /**
+     * \brief time slice value that selects the quantum configured for the thread's priority level
+     */
+    static constexpr uint32_t priority_time_slice = 0;
+
+    /**
+     * \brief value written to every stack word at construction when built with OS_STACK_PAINTING
+     */
+    static constexpr uint32_t stack_paint_pattern = 0xA5A5A5A5;
+
+    /**
+     * \brief value kept in the lowest word of every thread stack. If it changes, the stack has overflowed.
+     */
+    static constexpr uint32_t stack_canary = 0xDEADBEEF;
+
+    /**
+     * \brief size in bytes of the no-access MPU guard region kept just above the canary when built with
+     *        OS_MPU_STACK_GUARD. This is the smallest region size the Cortex-M4 MPU supports.
+     */
+    static constexpr uint32_t stack_guard_size = 32;
+
+    /**
+     * \brief CONTROL register bit that drops thread mode to unprivileged
+     */
+    static constexpr uint32_t control_unprivileged = 0x01;
+
     /**
      * \brief Construct a new Thread object
      * \todo I would like to make this more generic so that any invokable can be passed in like a lambda, etc.
@@ -67,22 +112,31 @@ class thread {
      * \param id thread id
      * \param stack_ptr pointer to the thread stack
      * \param stack_size size of the threads stack
+     * \param priority thread priority from 0 (lowest) to priority_levels - 1 (highest)
+     * \param time_slice ticks the thread may run before yielding to a thread of equal priority
+     *        (priority_time_slice uses the quantum for the priority level)
      */
-    thread(task_pointer task_ptr, void *arguments, uint32_t id, uint32_t* stack_ptr, uint32_t stack_size);
+    thread(task_pointer task_ptr, void *arguments, uint32_t id, uint32_t* stack_ptr, uint32_t stack_size, uint8_t priority = default_priority,
+           uint32_t time_slice = priority_time_slice);
 
     /**
      * \brief Set the thread's status
+     * \note inline as the scheduler calls this on every context switch
      * 
      * \param task_status new status to set
      */
-    void set_status(status task_status);
+    void set_status(status task_status) {
+        this->task_status = task_status;
+    }
 
     /**
      * \brief Get the thread's status
      * 
      * \retval Status of the thread
      */
-    status get_status(void);
+    status get_status(void) {
+        return task_status;
+    }
 
     /**
      * \brief Get the stack pointer for the thread
@@ -97,15 +151,103 @@ class thread {
      * \retval uint32_t thread id
      */
     uint32_t get_id(void);
+
+    /**
+     * \brief Get the thread priority
+     * 
+     * \retval uint8_t priority level
+     */
+    uint8_t get_priority(void);
+
+    /**
+     * \brief Get the thread's time slice
+     * 
+     * \retval uint32_t time slice in ticks, or priority_time_slice to use the priority level quantum
+     */
+    uint32_t get_time_slice(void);
+
+    /**
+     * \brief Get the size of the thread's stack
+     * 
+     * \retval uint32_t stack size in words
+     */
+    uint32_t get_stack_size(void);
+
+    /**
+     * \brief Get the most stack the thread has ever used by scanning up from the bottom of the stack for
+     *        the first word that no longer holds the paint pattern
+     * \note  requires OS_STACK_PAINTING, otherwise the whole stack is reported as used
+     * 
+     * \retval uint32_t peak stack usage in words
+     */
+    uint32_t get_stack_high_water_mark(void);
+
+    /**
+     * \brief check if the stack canary at the bottom of the thread's stack is still intact
+     * 
+     * \retval true if the canary has been overwritten
+     */
+    bool is_stack_overflowed(void);
+
+    /**
+     * \brief check if a stack pointer lies within the thread's stack
+     * 
+     * \param sp the stack pointer to check
+     * \retval true if the stack pointer is inside the stack, above the canary
+     */
+    bool is_stack_pointer_valid(const uint32_t* sp);
+
+    /**
+     * \brief Get the base address of the stack guard region. This is the first stack_guard_size aligned
+     *        address above the canary, as MPU regions must be aligned to their size.
+     * 
+     * \retval uint32_t* lowest address of the guard region
+     */
+    uint32_t* get_stack_guard(void);
+
+    /**
+     * \brief choose whether the thread runs privileged. Threads run unprivileged when built with
+     *        OS_UNPRIVILEGED_THREADS, and privileged otherwise.
+     * \note  this rewrites the thread's initial context, so it only takes effect before the thread first runs
+     * 
+     * \param run_privileged true to run the thread privileged
+     */
+    void set_privileged(bool run_privileged);
+
+    /**
+     * \brief check if the thread runs privileged
+     * 
+     * \retval true/false
+     */
+    bool is_privileged(void);
+
+    /**
+     * \brief set the handler a thread calls when its task function returns. The kernel installs one that ends the
+     *        thread, and without a handler the thread spins where it is.
+     * 
+     * \param handler the exit handler, which must not return
+     */
+    static void set_exit_handler(exit_handler_pointer handler);
+
+    /**
+     * \brief every thread starts with this as its return address, so a task function that returns lands here
+     *        rather than wherever the initial LR happened to point
+     */
+    [[noreturn]] static void exit_trampoline(void);
   
   private:
+    static exit_handler_pointer exit_handler;
+
     const task_pointer task_ptr;
     void* task_arguments_ptr;
     const uint32_t id;
     uint32_t* const stack_top_ptr;
     uint32_t* stack_ptr;
     const uint32_t stack_size;
+    const uint8_t priority;
+    const uint32_t time_slice;
     status task_status;
+    bool privileged;
 };
 
 };  // namespace os
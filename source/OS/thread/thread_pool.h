@@ -0,0 +1,84 @@
+/**
+ * \file thread_pool.h
+ * \author Graham Riches (graham.riches@live.com)
+ * \brief pool of thread objects and stacks for starting worker threads while the kernel runs
+ * \version 0.1
+ * \date 2021-06-13
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#pragma once
+
+/********************************** Includes *******************************************/
+#include "cm4_port.h"
+#include "scheduler.h"
+#include "thread_pool_impl.h"
+
+namespace os
+{
+
+/**
+ * \brief pool of worker threads that can be started from other threads. A worker ends when its task function
+ *        returns or it calls scheduler::exit(), which frees its task control block and its pool slot for the
+ *        next worker.
+ *
+ *        For example:
+ *            static os::thread_pool<256, 2> workers;
+ *            os::thread* worker = workers.spawn(flash_erase_task, nullptr, 20, 2);
+ *            ...
+ *            os::scheduler::join(worker);
+ *
+ * \tparam StackSize stack size of every thread in words
+ * \tparam Count number of threads
+ */
+template <uint32_t StackSize, size_t Count>
+class thread_pool : public thread_pool_impl<StackSize, Count> {
+    using base = thread_pool_impl<StackSize, Count>;
+
+  public:
+    /**
+     * \brief start a worker thread in a free slot. The thread is constructed outside the critical section, as
+     *        painting its stack takes a while.
+     *
+     * \param task_ptr function pointer to the main task function
+     * \param arguments arguments to bind to the task function
+     * \param id thread id
+     * \param priority thread priority
+     * \param time_slice thread time slice
+     * \retval thread* the running thread, or nullptr if the pool or the scheduler is full
+     */
+    thread* spawn(thread::task_pointer task_ptr, void* arguments, uint32_t id, uint8_t priority = thread::default_priority,
+                  uint32_t time_slice = thread::priority_time_slice) {
+        uint32_t interrupt_mask = enter_critical_from_isr();
+        auto slot = base::claim();
+        exit_critical_from_isr(interrupt_mask);
+        if ( !slot ) {
+            return nullptr;
+        }
+
+        thread* created = base::construct(slot.value(), task_ptr, arguments, id, priority, time_slice);
+        if ( !scheduler::register_new_thread(created) ) {
+            interrupt_mask = enter_critical_from_isr();
+            base::release(created);
+            exit_critical_from_isr(interrupt_mask);
+            return nullptr;
+        }
+        return created;
+    }
+
+    /**
+     * \brief get the number of slots free for a new thread
+     *
+     * \retval size_t free slot count
+     */
+    size_t get_free_count(void) const {
+        uint32_t interrupt_mask = enter_critical_from_isr();
+        size_t count = base::get_free_count();
+        exit_critical_from_isr(interrupt_mask);
+        return count;
+    }
+};
+
+};  // namespace os
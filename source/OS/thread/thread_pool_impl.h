@@ -0,0 +1,176 @@
+/**
+ * \file thread_pool_impl.h
+ * \author Graham Riches (graham.riches@live.com)
+ * \brief internal OS implementation of a pool of thread objects and stacks for short-lived worker threads
+ * \version 0.1
+ * \date 2021-06-13
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#pragma once
+
+/********************************** Includes *******************************************/
+#include "thread_impl.h"
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <optional>
+
+
+namespace os
+{
+
+/********************************** Types *******************************************/
+/**
+ * \brief statically allocated storage for Count threads with StackSize word stacks. A slot is free until a thread
+ *        is created in it, and becomes free again once that thread has exited, so worker threads can be started
+ *        on demand without keeping idle threads resident.
+ * \note this is not interrupt safe by itself, callers must wrap each call in a critical section. A pointer to a
+ *       pooled thread is only good until the thread exits and its slot is reused, so join a worker before starting
+ *       the next one if the pool may be full.
+ *
+ * \tparam StackSize stack size of every thread in words
+ * \tparam Count number of threads
+ */
+template <uint32_t StackSize, size_t Count>
+class thread_pool_impl {
+    static_assert(StackSize > 0, "threads need a stack");
+    static_assert(Count > 0, "the pool must hold at least one thread");
+
+  public:
+    /**
+     * \brief Construct a new pool with every slot free
+     */
+    thread_pool_impl(void)
+        : storage()
+        , threads()
+        , claimed()
+        , stacks() { }
+
+    //!< disable moves and copies, the scheduler points at the threads in the pool
+    thread_pool_impl(const thread_pool_impl& other) = delete;
+    thread_pool_impl(thread_pool_impl&& other) = delete;
+    thread_pool_impl& operator = (const thread_pool_impl& other) = delete;
+    thread_pool_impl& operator = (thread_pool_impl&& other) = delete;
+
+    /**
+     * \brief construct a thread in a free slot. The thread still has to be registered with the scheduler.
+     *
+     * \param task_ptr function pointer to the main task function
+     * \param arguments arguments to bind to the task function
+     * \param id thread id
+     * \param priority thread priority
+     * \param time_slice thread time slice
+     * \retval thread* the thread, or nullptr if every slot is in use
+     */
+    thread* create(thread::task_pointer task_ptr, void* arguments, uint32_t id, uint8_t priority = thread::default_priority,
+                   uint32_t time_slice = thread::priority_time_slice) {
+        auto slot = claim();
+        return slot ? construct(slot.value(), task_ptr, arguments, id, priority, time_slice) : nullptr;
+    }
+
+    /**
+     * \brief give back a thread that was created but is never going to run, such as one the scheduler had no
+     *        room for
+     *
+     * \param thread the thread
+     * \retval true if released, false if the thread is not from this pool
+     */
+    bool release(thread* thread) {
+        for ( size_t slot = 0; slot < Count; slot++ ) {
+            if ( (thread != nullptr) && (threads[slot] == thread) ) {
+                claimed[slot] = false;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * \brief get the number of slots free for a new thread
+     *
+     * \retval size_t free slot count
+     */
+    size_t get_free_count(void) const {
+        size_t count = 0;
+        for ( size_t slot = 0; slot < Count; slot++ ) {
+            count += is_free(slot) ? 1 : 0;
+        }
+        return count;
+    }
+
+    /**
+     * \brief get the stack size of every thread in words
+     */
+    static constexpr uint32_t stack_size(void) {
+        return StackSize;
+    }
+
+    /**
+     * \brief get the number of threads in the pool
+     */
+    static constexpr size_t capacity(void) {
+        return Count;
+    }
+
+  protected:
+    /**
+     * \brief take a free slot, so it can be constructed in outside a critical section
+     *
+     * \retval std::optional<size_t> the slot, or empty if every slot is in use
+     */
+    std::optional<size_t> claim(void) {
+        for ( size_t slot = 0; slot < Count; slot++ ) {
+            if ( is_free(slot) ) {
+                claimed[slot] = true;
+                threads[slot] = nullptr;
+                return slot;
+            }
+        }
+        return {};
+    }
+
+    /**
+     * \brief construct a thread in a claimed slot, which repaints and reinitializes its stack
+     *
+     * \param slot the slot
+     * \param task_ptr function pointer to the main task function
+     * \param arguments arguments to bind to the task function
+     * \param id thread id
+     * \param priority thread priority
+     * \param time_slice thread time slice
+     * \retval thread* the thread
+     */
+    thread* construct(size_t slot, thread::task_pointer task_ptr, void* arguments, uint32_t id, uint8_t priority, uint32_t time_slice) {
+        thread* created = new (&storage[slot]) thread(task_ptr, arguments, id, stacks[slot], StackSize, priority, time_slice);
+        threads[slot] = created;
+        return created;
+    }
+
+  private:
+    /**
+     * \brief check if a slot can take a new thread
+     *
+     * \param slot the slot
+     * \retval true if it has never been used, was released or its thread has exited
+     */
+    bool is_free(size_t slot) const {
+        return !claimed[slot] || ((threads[slot] != nullptr) && (threads[slot]->get_status() == thread::status::exited));
+    }
+
+    /**
+     * \brief raw storage for a thread, which has no default constructor
+     */
+    struct thread_storage {
+        alignas(thread) uint8_t data[sizeof(thread)];
+    };
+
+    thread_storage storage[Count];
+    thread* threads[Count];  //!< thread constructed in each slot, nullptr until the first one is
+    bool claimed[Count];     //!< set while a slot is in use, until its thread exits
+    uint32_t stacks[Count][StackSize];
+};
+
+};  // namespace os
@@ -0,0 +1,126 @@
+/**
+ * \file timer.cpp
+ * \author Graham Riches (graham.riches@live.com)
+ * \brief software timers with callbacks run from the os timer thread
+ * \version 0.1
+ * \date 2021-05-15
+ * 
+ * @copyright Copyright (c) 2021
+ * 
+ */
+
+/********************************** Includes *******************************************/
+#include "timer.h"
+#include "cm4_port.h"
+#include "scheduler.h"
+#include "os_semaphore.h"
+#include "system_clock.h"
+#include "thread_impl.h"
+
+namespace os
+{
+
+/********************************** Constants *******************************************/
+constexpr uint16_t timer_thread_stack_size = 256;
+constexpr uint32_t timer_thread_id = 0xFFFE;
+
+//!< callbacks run ahead of every application thread so timers fire on time
+constexpr uint8_t timer_thread_priority = thread::priority_levels - 1;
+
+/********************************** Function Declarations *******************************************/
+static void timer_thread_task(void* arguments);
+
+/********************************** Local Variables *******************************************/
+CCM_RAM static uint32_t timer_thread_stack[timer_thread_stack_size] = {0};
+CCM_RAM static os::thread timer_thread(timer_thread_task, nullptr, timer_thread_id, timer_thread_stack, timer_thread_stack_size,
+                               timer_thread_priority);
+
+/********************************** Function Definitions *******************************************/
+//!< construct a timer
+timer::timer(callback_pointer callback, void* arguments, uint32_t period_ticks, mode timer_mode)
+    : timer_impl(callback, arguments, period_ticks, timer_mode) { }
+
+//!< start the timer from a thread
+void timer::start() {
+    uint32_t interrupt_mask = enter_critical_from_isr();
+    timer_service::get().timer_service_impl::start(this);
+    exit_critical_from_isr(interrupt_mask);
+    timer_service::notify(false);
+}
+
+//!< start the timer from an interrupt
+void timer::start_from_isr() {
+    uint32_t interrupt_mask = enter_critical_from_isr();
+    timer_service::get().timer_service_impl::start(this);
+    exit_critical_from_isr(interrupt_mask);
+    timer_service::notify(true);
+}
+
+//!< stop the timer
+void timer::stop() {
+    uint32_t interrupt_mask = enter_critical_from_isr();
+    timer_service::get().timer_service_impl::stop(this);
+    exit_critical_from_isr(interrupt_mask);
+}
+
+//!< create the timer service singleton
+timer_service::timer_service()
+    : timer_service_impl(&system_clock::get())
+    , list_changed(0, 1) { }
+
+//!< get a reference to the timer service singleton
+timer_service& timer_service::get() {
+    static timer_service service;
+    return service;
+}
+
+//!< register the timer thread
+void timer_service::initialize() {
+    scheduler::register_new_thread(&timer_thread);
+}
+
+//!< wake the timer thread
+void timer_service::notify(bool from_isr) {
+    auto& self = get();
+    if ( from_isr ) {
+        self.list_changed.signal_from_isr();
+    } else {
+        self.list_changed.signal();
+    }
+}
+
+//!< fire every expired timer, then sleep until the next expiry or until the timer list changes. Stopping a
+//!< timer never needs a wakeup, at worst the thread wakes early and finds nothing to do.
+void timer_service::run() {
+    while ( true ) {
+        timer_impl* expired;
+        do {
+            {
+                critical_section critical;
+                expired = take_expired();
+            }
+            if ( expired != nullptr ) {
+                expired->fire();
+            }
+        } while ( expired != nullptr );
+
+        std::optional<uint32_t> ticks_until_expiry;
+        {
+            critical_section critical;
+            ticks_until_expiry = get_ticks_until_next_expiry();
+        }
+        list_changed.wait_for(ticks_until_expiry.value_or(scheduler::wait_forever));
+    }
+}
+
+/**
+ * \brief timer daemon thread
+ * 
+ * \param arguments 
+ */
+static void timer_thread_task(void* arguments) {
+    PARAMETER_NOT_USED(arguments);
+    timer_service::get().run();
+}
+
+};  // namespace os
@@ -0,0 +1,92 @@
+/**
+ * \file timer.h
+ * \author Graham Riches (graham.riches@live.com)
+ * \brief software timers with callbacks run from the os timer thread
+ * \version 0.1
+ * \date 2021-05-15
+ * 
+ * @copyright Copyright (c) 2021
+ * 
+ */
+
+#pragma once
+
+/********************************** Includes *******************************************/
+#include "os_semaphore.h"
+#include "timer_impl.h"
+
+namespace os
+{
+
+/**
+ * \brief one-shot or periodic software timer. Callbacks run one after another on the os timer thread, so they
+ *        share its stack and must not block.
+ */
+class timer : public timer_impl {
+  public:
+    /**
+     * \brief Construct a new stopped timer
+     * 
+     * \param callback function to call on expiry
+     * \param arguments arguments to pass to the callback
+     * \param period_ticks ticks between the timer starting and expiring, and between periodic expiries
+     * \param timer_mode one_shot or periodic
+     */
+    timer(callback_pointer callback, void* arguments, uint32_t period_ticks, mode timer_mode = mode::one_shot);
+
+    /**
+     * \brief start the timer from a thread, or restart it if it is already running
+     */
+    void start();
+
+    /**
+     * \brief start the timer from an interrupt handler, or restart it if it is already running
+     */
+    void start_from_isr();
+
+    /**
+     * \brief stop the timer from a thread or an interrupt handler
+     */
+    void stop();
+};
+
+/**
+ * \brief singleton timer service. A daemon thread sleeps until the next timer expires and runs its callback.
+ */
+class timer_service : public timer_service_impl {
+  public:
+    /**
+     * \brief singleton accessor for the timer service
+     * 
+     * \retval timer_service& reference to the timer service
+     */
+    static timer_service& get();
+
+    /**
+     * \brief register the timer thread with the scheduler. Call this before the kernel is entered.
+     */
+    static void initialize();
+
+    /**
+     * \brief wake the timer thread so it picks up a change to the timer list
+     * 
+     * \param from_isr true if called from an interrupt handler
+     */
+    static void notify(bool from_isr);
+
+    /**
+     * \brief run the timer thread loop
+     */
+    [[noreturn]] void run();
+
+  private:
+    /**
+     * \brief Construct the timer service as a singleton instance
+     */
+    timer_service();
+
+    //!< signalled when the timer list changes. A binary count means any number of changes cost one extra pass.
+    semaphore list_changed;
+};
+
+};  // namespace os
@@ -0,0 +1,250 @@
+/**
+ * \file timer_impl.h
+ * \author Graham Riches (graham.riches@live.com)
+ * \brief internal OS implementation of one-shot and periodic software timers
+ * \version 0.1
+ * \date 2021-05-15
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#pragma once
+
+/********************************** Includes *******************************************/
+#include "system_clock_impl.h"
+#include <optional>
+
+
+namespace os
+{
+
+/********************************** Types *******************************************/
+/**
+ * \brief a software timer. Timers are intrusive list nodes owned by the caller, so starting one never allocates.
+ */
+class timer_impl {
+  public:
+    /**
+     * \brief function called when the timer expires
+     */
+    using callback_pointer = void (*)(void* arguments);
+
+    /**
+     * \brief timer modes
+     */
+    enum class mode : unsigned {
+        one_shot = 0,
+        periodic,
+    };
+
+    /**
+     * \brief Construct a new stopped timer
+     *
+     * \param callback function to call on expiry
+     * \param arguments arguments to pass to the callback
+     * \param period_ticks ticks between the timer starting and expiring, and between periodic expiries
+     * \param timer_mode one_shot or periodic
+     */
+    timer_impl(callback_pointer callback, void* arguments, uint32_t period_ticks, mode timer_mode = mode::one_shot)
+        : callback(callback)
+        , arguments(arguments)
+        , period_ticks(period_ticks)
+        , timer_mode(timer_mode)
+        , expiry_tick(0)
+        , active(false)
+        , next(nullptr) { }
+
+    //!< disable moves and copies, active timers are linked into the service
+    timer_impl(const timer_impl& other) = delete;
+    timer_impl(timer_impl&& other) = delete;
+    timer_impl& operator = (const timer_impl& other) = delete;
+    timer_impl& operator = (timer_impl&& other) = delete;
+
+    /**
+     * \brief run the timer callback
+     */
+    void fire(void) {
+        callback(arguments);
+    }
+
+    /**
+     * \brief check if the timer is running
+     *
+     * \retval true/false
+     */
+    bool is_active(void) const {
+        return active;
+    }
+
+    /**
+     * \brief get the timer period
+     *
+     * \retval uint32_t period in ticks
+     */
+    uint32_t get_period(void) const {
+        return period_ticks;
+    }
+
+    /**
+     * \brief change the timer period. This takes effect the next time the timer is started or reloaded.
+     *
+     * \param ticks period in ticks
+     */
+    void set_period(uint32_t ticks) {
+        period_ticks = ticks;
+    }
+
+    /**
+     * \brief get the tick the timer expires on
+     *
+     * \retval uint32_t expiry tick
+     */
+    uint32_t get_expiry_tick(void) const {
+        return expiry_tick;
+    }
+
+  private:
+    friend class timer_service_impl;
+
+    callback_pointer callback;
+    void* arguments;
+    uint32_t period_ticks;
+    mode timer_mode;
+    uint32_t expiry_tick;
+    bool active;
+    timer_impl* next;
+};
+
+/**
+ * \brief keeps the active timers in a list sorted by expiry so the next timer to expire is always at the head.
+ *        Starting a timer is linear in the number of active timers, and checking for expired timers is constant
+ *        time. Expired timers are handed back one at a time so the caller can run each callback outside of its
+ *        critical section. Expiry ticks are compared with wrap-safe deltas, so no timer can be longer than
+ *        half the tick range.
+ * \note this is not interrupt safe by itself, callers must wrap each call in a critical section
+ */
+class timer_service_impl {
+  public:
+    /**
+     * \brief Construct a new timer service with no active timers
+     *
+     * \param clock_ptr pointer to the system clock that times the timers
+     */
+    explicit timer_service_impl(system_clock_impl* clock_ptr)
+        : clock_ptr(clock_ptr)
+        , head(nullptr) { }
+
+    //!< disable moves and copies
+    timer_service_impl(const timer_service_impl& other) = delete;
+    timer_service_impl(timer_service_impl&& other) = delete;
+    timer_service_impl& operator = (const timer_service_impl& other) = delete;
+    timer_service_impl& operator = (timer_service_impl&& other) = delete;
+
+    /**
+     * \brief start a timer, or restart it if it is already running, so that it expires one period from now
+     *
+     * \param timer the timer to start
+     */
+    void start(timer_impl* timer) {
+        stop(timer);
+        timer->expiry_tick = clock_ptr->get_ticks() + timer->period_ticks;
+        insert(timer);
+    }
+
+    /**
+     * \brief stop a timer. Stopping a timer that isn't running does nothing.
+     *
+     * \param timer the timer to stop
+     */
+    void stop(timer_impl* timer) {
+        if ( !timer->active ) {
+            return;
+        }
+
+        timer_impl** link = &head;
+        while ( *link != timer ) {
+            link = &(*link)->next;
+        }
+        *link = timer->next;
+        timer->next = nullptr;
+        timer->active = false;
+    }
+
+    /**
+     * \brief take the next expired timer. Periodic timers are reloaded from their previous expiry so they don't
+     *        drift, unless they have fallen a whole period behind, in which case the missed expiries are dropped.
+     *
+     * \retval timer_impl* the expired timer to fire, or nullptr if no timers have expired
+     */
+    timer_impl* take_expired(void) {
+        uint32_t now = clock_ptr->get_ticks();
+        timer_impl* expired = head;
+        if ( (expired == nullptr) || !has_expired(expired, now) ) {
+            return nullptr;
+        }
+
+        head = expired->next;
+        expired->next = nullptr;
+        expired->active = false;
+        if ( (expired->timer_mode == timer_impl::mode::periodic) && (expired->period_ticks > 0) ) {
+            expired->expiry_tick += expired->period_ticks;
+            if ( has_expired(expired, now) ) {
+                expired->expiry_tick = now + expired->period_ticks;
+            }
+            insert(expired);
+        }
+        return expired;
+    }
+
+    /**
+     * \brief get the ticks until the next timer expires
+     *
+     * \retval std::optional<uint32_t> ticks until the head timer expires (0 if it already has), or empty if no
+     *         timers are running
+     */
+    std::optional<uint32_t> get_ticks_until_next_expiry(void) const {
+        if ( head == nullptr ) {
+            return {};
+        }
+        int32_t remaining = static_cast<int32_t>(head->expiry_tick - clock_ptr->get_ticks());
+        return (remaining > 0) ? static_cast<uint32_t>(remaining) : 0;
+    }
+
+    /**
+     * \brief check if any timers are running
+     *
+     * \retval true/false
+     */
+    bool has_active_timers(void) const {
+        return (head != nullptr);
+    }
+
+  private:
+    /**
+     * \brief check if a timer's expiry tick has been reached
+     */
+    static bool has_expired(const timer_impl* timer, uint32_t now) {
+        return static_cast<int32_t>(timer->expiry_tick - now) <= 0;
+    }
+
+    /**
+     * \brief link a timer into the list by expiry tick, after any timers that expire on the same tick
+     */
+    void insert(timer_impl* timer) {
+        uint32_t now = clock_ptr->get_ticks();
+        int32_t remaining = static_cast<int32_t>(timer->expiry_tick - now);
+        timer_impl** link = &head;
+        while ( (*link != nullptr) && (static_cast<int32_t>((*link)->expiry_tick - now) <= remaining) ) {
+            link = &(*link)->next;
+        }
+        timer->next = *link;
+        *link = timer;
+        timer->active = true;
+    }
+
+    system_clock_impl* clock_ptr;
+    timer_impl* head;
+};
+
+};  // namespace os
@@ -0,0 +1,198 @@
+/**
+ * \file trace.cpp
+ * \author Graham Riches (graham.riches@live.com)
+ * \brief singleton kernel trace recorder and the thread that streams it over SWO
+ * \version 0.1
+ * \date 2021-06-02
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+/********************************** Includes *******************************************/
+#include "trace.h"
+#include "cm4_port.h"
+#include "os.h"
+#include "scheduler.h"
+#include "thread_impl.h"
+#include "stm32f4xx.h"
+#include <cstring>
+
+namespace os
+{
+
+#ifdef OS_TRACE
+/********************************** Constants *******************************************/
+constexpr uint16_t trace_thread_stack_size = 256;
+constexpr uint32_t trace_thread_id = 0xFFFB;
+constexpr uint8_t trace_thread_priority = 0;
+
+/********************************** Function Declarations *******************************************/
+static void trace_thread_task(void* arguments);
+
+/********************************** Local Variables *******************************************/
+CCM_RAM static uint32_t trace_thread_stack[trace_thread_stack_size] = {0};
+CCM_RAM static os::thread trace_thread(trace_thread_task, nullptr, trace_thread_id, trace_thread_stack,
+                                       trace_thread_stack_size, trace_thread_priority);
+
+/**
+ * \brief read the active exception number
+ *
+ * \retval uint32_t exception number
+ */
+static inline uint32_t active_exception(void) {
+    return SCB->ICSR & SCB_ICSR_VECTACTIVE_Msk;
+}
+#endif
+
+/********************************** Function Definitions *******************************************/
+#ifdef OS_TRACE
+//!< create the trace recorder singleton
+trace::trace()
+    : buffer() { }
+
+//!< get a reference to the trace recorder singleton
+trace& trace::get() {
+    CCM_RAM static trace recorder;
+    return recorder;
+}
+
+//!< stream the records whenever the debugger has the port enabled, leaving them in the buffer otherwise
+void trace::run() {
+    const uint32_t port_mask = 0x01ul << itm_port;
+    while ( true ) {
+        if ( (ITM->TCR & ITM_TCR_ITMENA_Msk) && (ITM->TER & port_mask) ) {
+            trace_record record;
+            bool popped = true;
+            while ( popped ) {
+                uint32_t interrupt_mask = enter_critical_from_isr();
+                uint32_t overwritten = buffer.take_overwritten_count();
+                popped = buffer.pop(record);
+                exit_critical_from_isr(interrupt_mask);
+
+                /* let the reader know where the stream has a gap */
+                if ( overwritten > 0 ) {
+                    this->write({record.timestamp, overwritten, trace_event::overflow, 0, 0});
+                }
+                if ( popped ) {
+                    this->write(record);
+                }
+            }
+        }
+        scheduler::sleep(stream_period_ticks);
+    }
+}
+
+//!< write a record a word at a time, waiting on the port FIFO between writes
+void trace::write(const trace_record& record) {
+    uint32_t words[sizeof(trace_record) / sizeof(uint32_t)];
+    std::memcpy(words, &record, sizeof(words));
+
+    volatile ITM_Type& itm = *ITM;
+    for ( auto word : words ) {
+        while ( itm.PORT[itm_port].u32 == 0 ) {
+        }
+        itm.PORT[itm_port].u32 = word;
+    }
+}
+
+//!< entry point for the trace thread
+static void trace_thread_task(void* arguments) {
+    PARAMETER_NOT_USED(arguments);
+    trace::get().run();
+}
+#endif
+
+//!< register the trace thread. It runs privileged since it writes to the ITM.
+void trace::initialize(void) {
+#ifdef OS_TRACE
+    trace_thread.set_privileged(true);
+    scheduler::register_new_thread(&trace_thread);
+#endif
+}
+
+//!< start recording with a fresh buffer
+void trace::start(uint32_t core_clock_hz) {
+#ifdef OS_TRACE
+    uint32_t interrupt_mask = enter_critical_from_isr();
+    get().buffer.start(core_clock_hz, DWT->CYCCNT);
+    exit_critical_from_isr(interrupt_mask);
+#else
+    PARAMETER_NOT_USED(core_clock_hz);
+#endif
+}
+
+//!< stop recording
+void trace::stop(void) {
+#ifdef OS_TRACE
+    uint32_t interrupt_mask = enter_critical_from_isr();
+    get().buffer.stop();
+    exit_critical_from_isr(interrupt_mask);
+#endif
+}
+
+//!< check if the recorder is running
+bool trace::is_enabled(void) {
+#ifdef OS_TRACE
+    return get().buffer.is_enabled();
+#else
+    return false;
+#endif
+}
+
+//!< record an event with the current cycle count
+void trace::record(trace_event event, uint8_t detail, uint32_t argument) {
+#ifdef OS_TRACE
+    uint32_t interrupt_mask = enter_critical_from_isr();
+    get().buffer.record(event, detail, argument, DWT->CYCCNT);
+    exit_critical_from_isr(interrupt_mask);
+#else
+    PARAMETER_NOT_USED(event);
+    PARAMETER_NOT_USED(detail);
+    PARAMETER_NOT_USED(argument);
+#endif
+}
+
+//!< record a user marker
+void trace::marker(uint8_t id, uint32_t value) {
+    record(trace_event::marker, id, value);
+}
+
+//!< copy out the newest records
+size_t trace::copy_latest(trace_record* destination, size_t count) {
+#ifdef OS_TRACE
+    uint32_t interrupt_mask = enter_critical_from_isr();
+    size_t copied = get().buffer.copy_latest(destination, count);
+    exit_critical_from_isr(interrupt_mask);
+    return copied;
+#else
+    PARAMETER_NOT_USED(destination);
+    PARAMETER_NOT_USED(count);
+    return 0;
+#endif
+}
+
+#ifdef OS_TRACE
+/**
+ * \brief context switch hook called with the kernel interrupts masked from the end of the PendSV handler
+ */
+__attribute__((used)) void os_trace_context_switch(void) {
+    trace::record(trace_event::thread_switch_in, 0, system_active_task->thread_ptr->get_id());
+}
+
+/**
+ * \brief interrupt entry hook, the active vector is read back from the interrupt control register
+ */
+void os_trace_isr_enter(void) {
+    trace::record(trace_event::isr_enter, 0, active_exception());
+}
+
+/**
+ * \brief interrupt exit hook
+ */
+void os_trace_isr_exit(void) {
+    trace::record(trace_event::isr_exit, 0, active_exception());
+}
+#endif
+
+};  // namespace os
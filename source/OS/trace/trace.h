@@ -0,0 +1,138 @@
+/**
+ * \file trace.h
+ * \author Graham Riches (graham.riches@live.com)
+ * \brief kernel event trace recorder. Thread switches, interrupts, semaphore and queue operations and user markers
+ *        are stamped with the DWT cycle counter into a RAM flight recorder, and streamed out over SWO.
+ * \version 0.1
+ * \date 2021-06-02
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#pragma once
+
+/********************************** Includes *******************************************/
+#include "trace_impl.h"
+
+/********************************** Macros *******************************************/
+/**
+ * \brief record a kernel trace event. Compiled out entirely unless the kernel is built with OS_TRACE.
+ */
+#ifdef OS_TRACE
+#    define OS_TRACE_EVENT(event, detail, argument) os::trace::record((event), (detail), (argument))
+#else
+#    define OS_TRACE_EVENT(event, detail, argument)
+#endif
+
+namespace os
+{
+extern "C" {
+/**
+ * \brief record the thread that is just being switched in. Called from the end of the PendSV handler when
+ *        OS_TRACE is enabled.
+ */
+void os_trace_context_switch(void);
+
+/**
+ * \brief record entry to the active interrupt handler
+ */
+void os_trace_isr_enter(void);
+
+/**
+ * \brief record exit from the active interrupt handler
+ */
+void os_trace_isr_exit(void);
+}
+
+/**
+ * \brief singleton kernel trace recorder. Recording is off until started, and each record costs a short critical
+ *        section. A low priority thread streams the records to an ITM stimulus port whenever a debugger has the
+ *        port enabled, otherwise the buffer just keeps the latest events for dumping.
+ * \note the stream is the raw 12 byte records, Tools/trace_decode.py converts a capture to the Chrome trace event
+ *       format that Perfetto and chrome://tracing load
+ */
+class trace {
+  public:
+    static constexpr uint8_t itm_port = 1;                //!< stimulus port, the log sink uses port 0
+    static constexpr uint32_t stream_period_ticks = 10;  //!< how often the trace thread streams new records
+
+    /**
+     * \brief register the trace thread with the scheduler. Call this before the kernel is entered.
+     */
+    static void initialize(void);
+
+    /**
+     * \brief discard any old records and start recording
+     *
+     * \param core_clock_hz the current core clock, which the timestamps count
+     */
+    static void start(uint32_t core_clock_hz);
+
+    /**
+     * \brief stop recording, keeping the records
+     */
+    static void stop(void);
+
+    /**
+     * \brief check if the recorder is running
+     *
+     * \retval true/false
+     */
+    static bool is_enabled(void);
+
+    /**
+     * \brief record an event, safe from threads and interrupts
+     *
+     * \param event the event
+     * \param detail event specific detail
+     * \param argument event specific argument
+     */
+    static void record(trace_event event, uint8_t detail, uint32_t argument);
+
+    /**
+     * \brief record a user marker
+     *
+     * \param id marker id, to tell markers apart
+     * \param value value to record with it
+     */
+    static void marker(uint8_t id, uint32_t value);
+
+    /**
+     * \brief copy out the newest records, oldest first
+     *
+     * \param destination where to copy them
+     * \param count max records to copy
+     * \retval size_t number of records copied
+     */
+    static size_t copy_latest(trace_record* destination, size_t count);
+
+    /**
+     * \brief singleton accessor for the trace recorder
+     *
+     * \retval trace& reference to the trace recorder
+     */
+    static trace& get();
+
+    /**
+     * \brief run the trace thread loop, streaming the records to the ITM while the port is enabled
+     */
+    [[noreturn]] void run(void);
+
+  private:
+    /**
+     * \brief Construct the trace recorder as a singleton instance
+     */
+    trace();
+
+    /**
+     * \brief write a record to the stimulus port as three words
+     *
+     * \param record the record
+     */
+    void write(const trace_record& record);
+
+    trace_buffer_impl<OS_TRACE_BUFFER_SIZE> buffer;
+};
+
+};  // namespace os
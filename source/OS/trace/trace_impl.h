@@ -0,0 +1,229 @@
+/**
+ * \file trace_impl.h
+ * \author Graham Riches (graham.riches@live.com)
+ * \brief internal OS implementation of the kernel event trace buffer
+ * \version 0.1
+ * \date 2021-06-02
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#pragma once
+
+/********************************** Includes *******************************************/
+#include "common.h"
+#include <cstddef>
+
+/********************************** Constants *******************************************/
+/**
+ * \brief number of records kept by the kernel trace buffer, must be a power of two
+ */
+#ifndef OS_TRACE_BUFFER_SIZE
+#    define OS_TRACE_BUFFER_SIZE 512
+#endif
+
+namespace os
+{
+
+/********************************** Types *******************************************/
+/**
+ * \brief kernel trace events. The values are part of the stream format read by Tools/trace_decode.py.
+ */
+enum class trace_event : uint8_t {
+    trace_start = 0,    //!< argument is the core clock in Hz, starts a capture
+    clock_change,       //!< argument is the new core clock in Hz
+    overflow,           //!< argument is the number of records overwritten before they were streamed
+    thread_switch_in,   //!< argument is the thread id
+    thread_switch_out,  //!< argument is the thread id, detail is the status it is leaving in
+    thread_ready,       //!< argument is the thread id of a task woken from a wait list or sleep
+    isr_enter,          //!< argument is the exception number
+    isr_exit,           //!< argument is the exception number
+    semaphore_signal,   //!< argument is the semaphore address
+    semaphore_take,     //!< argument is the semaphore address, taken without blocking
+    semaphore_block,    //!< argument is the semaphore address
+    queue_send,         //!< argument is the queue address
+    queue_receive,      //!< argument is the queue address
+    queue_block,        //!< argument is the queue address, detail is 1 when blocked sending and 0 when receiving
+    marker,             //!< user marker, detail is the marker id and argument its value
+};
+
+/**
+ * \brief one trace event. Timestamps are raw cycle counts, which wrap every few tens of seconds, so readers work
+ *        with the differences between consecutive records.
+ */
+struct trace_record {
+    uint32_t timestamp;
+    uint32_t argument;
+    trace_event event;
+    uint8_t detail;
+    uint16_t tag;  //!< trace_start_tag on the start record so a reader can find the record boundaries, otherwise 0
+};
+
+static_assert(sizeof(trace_record) == 12, "trace_record is streamed as is and must stay 12 bytes");
+
+/**
+ * \brief tag carried by the start record
+ */
+constexpr uint16_t trace_start_tag = 0x5254;
+
+/**
+ * \brief get the printable name of a trace event
+ *
+ * \param event the event
+ * \retval const char* the name, or "unknown" for a value outside the enum
+ */
+inline const char* get_trace_event_name(trace_event event) {
+    static constexpr const char* names[] = {"trace_start", "clock_change", "overflow", "thread_switch_in", "thread_switch_out",
+                                            "thread_ready", "isr_enter", "isr_exit", "semaphore_signal", "semaphore_take",
+                                            "semaphore_block", "queue_send", "queue_receive", "queue_block", "marker"};
+    size_t index = static_cast<size_t>(event);
+    return (index < (sizeof(names) / sizeof(names[0]))) ? names[index] : "unknown";
+}
+
+/**
+ * \brief flight recorder for kernel trace events. New records always go in, overwriting the oldest, so the latest
+ *        events are there to dump after a problem. A reader streaming the records out pops them oldest first and
+ *        is told how many it missed when it falls behind.
+ * \note this is not interrupt safe by itself, callers must wrap each call in a critical section
+ *
+ * \tparam N record capacity, a power of two
+ */
+template <size_t N>
+class trace_buffer_impl {
+    static_assert((N > 0) && ((N & (N - 1)) == 0), "trace buffer capacity must be a power of two");
+
+  public:
+    trace_buffer_impl()
+        : records()
+        , head(0)
+        , tail(0)
+        , overwritten(0)
+        , enabled(false) { }
+
+    //!< delete copies and moves
+    trace_buffer_impl(const trace_buffer_impl& other) = delete;
+    trace_buffer_impl(trace_buffer_impl&& other) = delete;
+    trace_buffer_impl& operator = (const trace_buffer_impl& other) = delete;
+    trace_buffer_impl& operator = (trace_buffer_impl&& other) = delete;
+
+    /**
+     * \brief add a record if tracing is enabled, overwriting the oldest if the buffer is full
+     *
+     * \param event the event
+     * \param detail event specific detail
+     * \param argument event specific argument
+     * \param timestamp cycle count
+     */
+    void record(trace_event event, uint8_t detail, uint32_t argument, uint32_t timestamp) {
+        if ( !this->enabled ) {
+            return;
+        }
+
+        this->records[this->head & (N - 1)] = {timestamp, argument, event, detail, 0};
+        this->head++;
+        if ( (this->head - this->tail) > N ) {
+            this->tail = this->head - N;
+            this->overwritten++;
+        }
+    }
+
+    /**
+     * \brief clear the buffer and start recording with a start record
+     *
+     * \param core_clock_hz core clock, which the timestamps count
+     * \param timestamp cycle count
+     */
+    void start(uint32_t core_clock_hz, uint32_t timestamp) {
+        this->clear();
+        this->enabled = true;
+        this->records[0] = {timestamp, core_clock_hz, trace_event::trace_start, 0, trace_start_tag};
+        this->head = 1;
+    }
+
+    /**
+     * \brief stop recording, keeping the records
+     */
+    void stop(void) {
+        this->enabled = false;
+    }
+
+    /**
+     * \brief discard every record
+     */
+    void clear(void) {
+        this->head = 0;
+        this->tail = 0;
+        this->overwritten = 0;
+    }
+
+    /**
+     * \brief get the oldest record that hasn't been popped
+     *
+     * \param record where to copy it
+     * \retval true if there was a record
+     */
+    bool pop(trace_record& record) {
+        if ( this->head == this->tail ) {
+            return false;
+        }
+        record = this->records[this->tail & (N - 1)];
+        this->tail++;
+        return true;
+    }
+
+    /**
+     * \brief copy out the newest records, oldest first, whether or not they have been popped
+     *
+     * \param destination where to copy them
+     * \param count max records to copy
+     * \retval size_t number of records copied
+     */
+    size_t copy_latest(trace_record* destination, size_t count) const {
+        size_t available = (this->head < N) ? this->head : N;
+        size_t copied = (count < available) ? count : available;
+        uint32_t first = this->head - static_cast<uint32_t>(copied);
+        for ( size_t index = 0; index < copied; index++ ) {
+            destination[index] = this->records[(first + index) & (N - 1)];
+        }
+        return copied;
+    }
+
+    /**
+     * \brief get the number of records overwritten before they were popped since the last call, and reset it
+     *
+     * \retval uint32_t overwritten record count
+     */
+    uint32_t take_overwritten_count(void) {
+        uint32_t count = this->overwritten;
+        this->overwritten = 0;
+        return count;
+    }
+
+    /**
+     * \brief get the number of records waiting to be popped
+     *
+     * \retval size_t record count
+     */
+    size_t get_count(void) const {
+        return static_cast<size_t>(this->head - this->tail);
+    }
+
+    /**
+     * \brief check if tracing is enabled
+     *
+     * \retval true/false
+     */
+    bool is_enabled(void) const {
+        return this->enabled;
+    }
+
+  private:
+    trace_record records[N];
+    uint32_t head;         //!< total records written, the next slot is head % N
+    uint32_t tail;         //!< total records popped or overwritten
+    uint32_t overwritten;  //!< unread records lost since the last take_overwritten_count()
+    bool enabled;
+};
+
+};  // namespace os
@@ -0,0 +1,40 @@
+/**
+ * \file wait_any.cpp
+ * \author Graham Riches (graham.riches@live.com)
+ * \brief block a thread on several semaphores, queues and event flag groups at once
+ * \version 0.1
+ * \date 2021-06-14
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+/********************************** Includes *******************************************/
+#include "wait_any.h"
+#include "cm4_port.h"
+#include "scheduler.h"
+
+namespace os
+{
+
+/********************************** Function Definitions *******************************************/
+//!< wait for any of the targets with a timeout
+std::optional<size_t> wait_for_any(wait_any_target* targets, size_t count, uint32_t ticks) {
+    wait_any_impl wait(&scheduler::get(), targets, count);
+    {
+        critical_section critical;
+        auto ready = wait.poll();
+        if ( ready || (ticks == 0) ) {
+            return ready;
+        }
+
+        wait.block(ticks);
+    }
+
+    /* the PendSV handler switches away as soon as the critical section ends, and this thread only runs again once
+       a target is ready or the wait has timed out */
+    critical_section critical;
+    return wait.finish();
+}
+
+};  // namespace os
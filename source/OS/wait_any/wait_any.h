@@ -0,0 +1,58 @@
+/**
+ * \file wait_any.h
+ * \author Graham Riches (graham.riches@live.com)
+ * \brief block a thread on several semaphores, queues and event flag groups at once
+ * \version 0.1
+ * \date 2021-06-14
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#pragma once
+
+/********************************** Includes *******************************************/
+#include "scheduler.h"
+#include "wait_any_impl.h"
+#include <utility>
+
+namespace os
+{
+
+/**
+ * \brief wait for up to a number of ticks until any of a set of targets is ready
+ *
+ * \param targets the objects to wait on
+ * \param count number of targets
+ * \param ticks max ticks to wait (0 just checks the targets)
+ * \retval std::optional<size_t> index of the ready target, or empty on timeout
+ */
+std::optional<size_t> wait_for_any(wait_any_target* targets, size_t count, uint32_t ticks);
+
+/**
+ * \brief suspend the calling thread until any of several semaphores, queues or event flag groups is ready, so one
+ *        thread can service them all without polling. Nothing is taken from the ready object, so follow up with its
+ *        non-blocking take. Another thread can get there first, in which case the take fails and the thread can wait
+ *        again. Event flag groups are passed as a target with the flags to wait for.
+ *
+ *        For example:
+ *            auto ready = os::wait_for_any(100, rx_queue, frames_ready, os::wait_any_target(control, stop_flag));
+ *            if ( ready == 0 ) {
+ *                auto item = rx_queue.try_receive();
+ *                ...
+ *            } else if ( !ready ) {
+ *                // timed out, run the periodic work
+ *            }
+ *
+ * \param ticks max ticks to wait, or scheduler::wait_forever
+ * \param targets the objects to wait on
+ * \retval std::optional<size_t> index of the ready object in the argument list, or empty on timeout
+ */
+template <typename... Targets>
+std::optional<size_t> wait_for_any(uint32_t ticks, Targets&&... targets) {
+    static_assert(sizeof...(Targets) > 0, "wait on at least one object");
+    wait_any_target list[] = {wait_any_target(std::forward<Targets>(targets))...};
+    return wait_for_any(list, sizeof...(Targets), ticks);
+}
+
+};  // namespace os
@@ -0,0 +1,277 @@
+/**
+ * \file wait_any_impl.h
+ * \author Graham Riches (graham.riches@live.com)
+ * \brief internal OS implementation of blocking on several synchronization objects at once
+ * \version 0.1
+ * \date 2021-06-14
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#pragma once
+
+/********************************** Includes *******************************************/
+#include "scheduler_impl.h"
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <type_traits>
+
+
+namespace os
+{
+
+/********************************** Types *******************************************/
+class wait_any_impl;
+
+/**
+ * \brief link between an object and a thread waiting on it in wait_for_any(). A task control block can only sit in
+ *        one wait list, so a thread waiting on several objects hangs one of these off each object instead. The links
+ *        live in the waiting thread's targets, so nothing is allocated.
+ */
+struct wait_any_link {
+    wait_any_link* next;
+    wait_any_link* prev;
+    wait_any_impl* waiter;  //!< the wait the link belongs to
+    size_t index;           //!< position of the object in the wait's targets
+    uint32_t mask;          //!< flags the waiter wants, for event flag groups
+    uint8_t options;        //!< how the waiter wants the flags matched, for event flag groups
+};
+
+/**
+ * \brief list of the wait_for_any() links attached to a synchronization object. The object notifies the list whenever
+ *        it becomes ready without a blocked thread to hand it to, which wakes the waiting threads to come and take it.
+ * \note this is not interrupt safe by itself, callers must wrap each call in a critical section
+ */
+class wait_any_list {
+  public:
+    wait_any_list(void)
+        : head(nullptr) { }
+
+    //!< disable moves and copies, the links point back into the list
+    wait_any_list(const wait_any_list& other) = delete;
+    wait_any_list(wait_any_list&& other) = delete;
+    wait_any_list& operator = (const wait_any_list& other) = delete;
+    wait_any_list& operator = (wait_any_list&& other) = delete;
+
+    /**
+     * \brief link a waiter to the object
+     *
+     * \param link the link
+     */
+    void attach(wait_any_link* link) {
+        link->prev = nullptr;
+        link->next = head;
+        if ( head != nullptr ) {
+            head->prev = link;
+        }
+        head = link;
+    }
+
+    /**
+     * \brief unlink a waiter from the object
+     *
+     * \param link the link
+     */
+    void detach(wait_any_link* link) {
+        if ( link->prev != nullptr ) {
+            link->prev->next = link->next;
+        } else {
+            head = link->next;
+        }
+        if ( link->next != nullptr ) {
+            link->next->prev = link->prev;
+        }
+        link->next = nullptr;
+        link->prev = nullptr;
+    }
+
+    /**
+     * \brief check if any threads are waiting on the object through wait_for_any()
+     *
+     * \retval true/false
+     */
+    bool has_waiters(void) const {
+        return (head != nullptr);
+    }
+
+    /**
+     * \brief wake every waiting thread whose wait the object now satisfies, and switch to one of them if it has a
+     *        higher priority than the active task
+     *
+     * \param scheduler_ptr the scheduler the waiters are blocked on
+     * \param is_ready called with each link, returns true if the object satisfies it
+     */
+    template <typename Predicate>
+    void notify(scheduler_impl* scheduler_ptr, Predicate is_ready);
+
+    /**
+     * \brief wake every waiting thread
+     *
+     * \param scheduler_ptr the scheduler the waiters are blocked on
+     */
+    void notify(scheduler_impl* scheduler_ptr) {
+        notify(scheduler_ptr, [](const wait_any_link&) { return true; });
+    }
+
+  private:
+    wait_any_link* head;
+};
+
+/**
+ * \brief an object that wait_for_any() can wait on. Any object with a get_watchers() method returning its
+ *        wait_any_list, and an is_ready(mask, options) method, converts to a target. The mask and options are only used
+ *        by event flag groups.
+ */
+struct wait_any_target {
+    using ready_check = bool (*)(const wait_any_target& target);
+
+    /**
+     * \brief Construct a target for an object
+     *
+     * \param object the semaphore, queue or event flag group
+     * \param mask flags to wait for when the object is an event flag group
+     * \param options event_options to match the flags with
+     */
+    template <typename Object, typename = std::enable_if_t<!std::is_same_v<std::decay_t<Object>, wait_any_target>>>
+    wait_any_target(Object& object, uint32_t mask = 0, uint8_t options = 0)
+        : object(&object)
+        , watchers(&object.get_watchers())
+        , ready(&is_object_ready<Object>)
+        , link{nullptr, nullptr, nullptr, 0, mask, options} { }
+
+    /**
+     * \brief check if the object would satisfy the wait right now
+     *
+     * \retval true/false
+     */
+    bool is_ready(void) const {
+        return ready(*this);
+    }
+
+    void* object;
+    wait_any_list* watchers;
+    ready_check ready;
+    wait_any_link link;
+
+  private:
+    template <typename Object>
+    static bool is_object_ready(const wait_any_target& target) {
+        return static_cast<Object*>(target.object)->is_ready(target.link.mask, target.link.options);
+    }
+};
+
+/**
+ * \brief a single wait on a set of targets. The caller checks poll() first, then block()s if nothing is ready and
+ *        calls finish() once the thread runs again, all inside critical sections. A woken thread is told which object
+ *        became ready, but nothing is taken from it, so the thread follows up with the object's own non-blocking take.
+ *        Another thread may get there first, in which case the take fails and the thread can wait again.
+ * \note this is not interrupt safe by itself, callers must wrap each call in a critical section
+ */
+class wait_any_impl {
+  public:
+    /**
+     * \brief Construct a wait on a set of targets
+     *
+     * \param scheduler_ptr the scheduler to block on
+     * \param targets the objects to wait on, which must stay valid until finish()
+     * \param count number of targets
+     */
+    wait_any_impl(scheduler_impl* scheduler_ptr, wait_any_target* targets, size_t count)
+        : scheduler_ptr(scheduler_ptr)
+        , targets(targets)
+        , count(count)
+        , wait_list()
+        , tcb(nullptr)
+        , fired() { }
+
+    //!< disable moves and copies, the links point back at the wait
+    wait_any_impl(const wait_any_impl& other) = delete;
+    wait_any_impl(wait_any_impl&& other) = delete;
+    wait_any_impl& operator = (const wait_any_impl& other) = delete;
+    wait_any_impl& operator = (wait_any_impl&& other) = delete;
+
+    /**
+     * \brief check the targets without blocking
+     *
+     * \retval std::optional<size_t> index of the first ready target, or empty if none are
+     */
+    std::optional<size_t> poll(void) const {
+        for ( size_t index = 0; index < count; index++ ) {
+            if ( targets[index].is_ready() ) {
+                return index;
+            }
+        }
+        return {};
+    }
+
+    /**
+     * \brief suspend the active thread until one of the targets is ready. Call this after poll() has failed.
+     * \note the context switch happens once the caller leaves its critical section
+     *
+     * \param timeout_ticks ticks to wait before giving up, or scheduler_impl::wait_forever
+     */
+    void block(uint32_t timeout_ticks = scheduler_impl::wait_forever) {
+        tcb = scheduler_ptr->get_active_tcb_ptr();
+        fired.reset();
+        for ( size_t index = 0; index < count; index++ ) {
+            targets[index].link.waiter = this;
+            targets[index].link.index = index;
+            targets[index].watchers->attach(&targets[index].link);
+        }
+        scheduler_ptr->block_active_task(&wait_list, timeout_ticks);
+    }
+
+    /**
+     * \brief detach from every target once the blocked thread runs again
+     *
+     * \retval std::optional<size_t> index of the target that woke the thread, or empty if the wait timed out
+     */
+    std::optional<size_t> finish(void) {
+        for ( size_t index = 0; index < count; index++ ) {
+            targets[index].watchers->detach(&targets[index].link);
+        }
+        return fired;
+    }
+
+    /**
+     * \brief wake the blocked thread for a target, unless it has already been woken or has timed out
+     *
+     * \param index the ready target
+     * \retval true if the thread was woken
+     */
+    bool wake(size_t index) {
+        if ( fired.has_value() || (tcb == nullptr) || (tcb->list != &wait_list) ) {
+            return false;
+        }
+        fired = index;
+        scheduler_ptr->wake_task(tcb);
+        return true;
+    }
+
+  private:
+    scheduler_impl* scheduler_ptr;
+    wait_any_target* targets;
+    size_t count;
+    scheduler_impl::TaskList wait_list;  //!< holds just the blocked thread, so the scheduler's timeouts apply
+    scheduler_impl::TaskControlBlock* tcb;
+    std::optional<size_t> fired;
+};
+
+/****************************** Method Definitions ***********************************/
+template <typename Predicate>
+void wait_any_list::notify(scheduler_impl* scheduler_ptr, Predicate is_ready) {
+    bool woken = false;
+    for ( auto link = head; link != nullptr; link = link->next ) {
+        if ( is_ready(*link) ) {
+            woken |= link->waiter->wake(link->index);
+        }
+    }
+
+    if ( woken ) {
+        scheduler_ptr->reschedule();
+    }
+}
+
+};  // namespace os
@@ -0,0 +1,482 @@
+/*! \file dsp_q15.h
+*
+*  \brief fixed point (q15) filters and a real FFT. On the Cortex-M4 the inner loops use the DSP extension's
+*         dual 16-bit multiply-accumulate instructions, elsewhere they fall back to portable code that gives the
+*         same results, which is what the unit tests run against.
+*
+*
+*  \author Graham Riches
+*/
+
+#pragma once
+
+/********************************** Includes *******************************************/
+#include <array>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__ARM_FEATURE_DSP)
+#    include "stm32f4xx.h"
+#endif
+
+namespace dsp
+{
+/************************************ Types ********************************************/
+using q15_t = int16_t;
+
+/*********************************** Consts ********************************************/
+constexpr q15_t q15_max = INT16_MAX;
+constexpr q15_t q15_min = INT16_MIN;
+
+/****************************** Functions Definition ***********************************/
+namespace simd
+{
+/**
+ * \brief saturate a value to 16 bits
+ */
+inline int32_t saturate_16(int32_t value) {
+#if defined(__ARM_FEATURE_DSP)
+    return __SSAT(value, 16);
+#else
+    return (value > q15_max) ? q15_max : ((value < q15_min) ? q15_min : value);
+#endif
+}
+
+/**
+ * \brief pack two q15 values into a word, low half first, the way they sit in memory
+ */
+inline uint32_t pack(q15_t low, q15_t high) {
+    return (static_cast<uint32_t>(static_cast<uint16_t>(high)) << 16) | static_cast<uint16_t>(low);
+}
+
+inline q15_t low_half(uint32_t word) {
+    return static_cast<q15_t>(word & 0xFFFF);
+}
+
+inline q15_t high_half(uint32_t word) {
+    return static_cast<q15_t>(word >> 16);
+}
+
+/**
+ * \brief read two neighbouring q15 values as one word. The M4 handles the unaligned load in a single access.
+ */
+inline uint32_t load_pair(const q15_t* data) {
+    uint32_t word;
+    memcpy(&word, data, sizeof(word));
+    return word;
+}
+
+inline void store_pair(q15_t* data, uint32_t word) {
+    memcpy(data, &word, sizeof(word));
+}
+
+/**
+ * \brief accumulator + x.low * y.low + x.high * y.high
+ */
+inline int32_t dual_multiply_accumulate(uint32_t x, uint32_t y, int32_t accumulator) {
+#if defined(__ARM_FEATURE_DSP)
+    return static_cast<int32_t>(__SMLAD(x, y, static_cast<uint32_t>(accumulator)));
+#else
+    return accumulator + (low_half(x) * low_half(y)) + (high_half(x) * high_half(y));
+#endif
+}
+
+/**
+ * \brief x.low * y.low + x.high * y.high
+ */
+inline int32_t dual_multiply_add(uint32_t x, uint32_t y) {
+#if defined(__ARM_FEATURE_DSP)
+    return static_cast<int32_t>(__SMUAD(x, y));
+#else
+    return (low_half(x) * low_half(y)) + (high_half(x) * high_half(y));
+#endif
+}
+
+/**
+ * \brief x.low * y.high - x.high * y.low
+ */
+inline int32_t dual_multiply_subtract_exchanged(uint32_t x, uint32_t y) {
+#if defined(__ARM_FEATURE_DSP)
+    return static_cast<int32_t>(__SMUSDX(x, y));
+#else
+    return (low_half(x) * high_half(y)) - (high_half(x) * low_half(y));
+#endif
+}
+
+/**
+ * \brief (x + y) / 2 for both halves
+ */
+inline uint32_t halving_add(uint32_t x, uint32_t y) {
+#if defined(__ARM_FEATURE_DSP)
+    return __SHADD16(x, y);
+#else
+    return pack(static_cast<q15_t>((low_half(x) + low_half(y)) >> 1), static_cast<q15_t>((high_half(x) + high_half(y)) >> 1));
+#endif
+}
+
+/**
+ * \brief (x - y) / 2 for both halves
+ */
+inline uint32_t halving_subtract(uint32_t x, uint32_t y) {
+#if defined(__ARM_FEATURE_DSP)
+    return __SHSUB16(x, y);
+#else
+    return pack(static_cast<q15_t>((low_half(x) - low_half(y)) >> 1), static_cast<q15_t>((high_half(x) - high_half(y)) >> 1));
+#endif
+}
+};  // namespace simd
+
+/**
+ * \brief sin(2 * pi * numerator / denominator) in q15, for building tables at compile time
+ */
+constexpr q15_t sine_q15(size_t numerator, size_t denominator) {
+    /* fold the angle into the first quarter turn, where the series converges quickly */
+    numerator %= denominator;
+    bool negative = false;
+    if ( (2 * numerator) >= denominator ) {
+        numerator -= denominator / 2;
+        negative = true;
+    }
+    if ( (4 * numerator) > denominator ) {
+        numerator = (denominator / 2) - numerator;
+    }
+
+    constexpr double pi = 3.14159265358979323846;
+    double x = (2.0 * pi * static_cast<double>(numerator)) / static_cast<double>(denominator);
+    double term = x;
+    double sum = x;
+    for ( int n = 1; n < 10; n++ ) {
+        term *= -(x * x) / static_cast<double>((2 * n) * (2 * n + 1));
+        sum += term;
+    }
+
+    double scaled = sum * 32768.0 + 0.5;
+    int32_t value = (scaled >= 32767.0) ? 32767 : static_cast<int32_t>(scaled);
+    return static_cast<q15_t>(negative ? -value : value);
+}
+
+/**
+ * \brief convert a float to q15, saturating at the ends of the range. For setting up coefficients.
+ */
+constexpr q15_t to_q15(float value) {
+    float scaled = value * 32768.0f;
+    return (scaled >= 32767.0f) ? q15_max : ((scaled <= -32768.0f) ? q15_min : static_cast<q15_t>(scaled));
+}
+
+/**
+ * \brief integer square root, rounded down
+ */
+inline uint32_t square_root(uint32_t value) {
+    uint32_t result = 0;
+    uint32_t bit = 1u << 30;
+    while ( bit > value ) {
+        bit >>= 2;
+    }
+    while ( bit != 0 ) {
+        if ( value >= result + bit ) {
+            value -= result + bit;
+            result = (result >> 1) + bit;
+        } else {
+            result >>= 1;
+        }
+        bit >>= 2;
+    }
+    return result;
+}
+
+/************************************ Filters ********************************************/
+/**
+ * \brief q15 FIR filter. Blocks are filtered in place and the history carries over from one block to the next.
+ *
+ * \tparam Taps number of coefficients, even so the taps can be taken two at a time
+ */
+template <size_t Taps>
+class fir_q15 {
+    static_assert((Taps > 0) && ((Taps % 2) == 0), "FIR tap count must be even");
+
+  public:
+    /**
+     * \brief Construct a new fir filter
+     *
+     * \param coefficients the impulse response, h[0] first
+     */
+    explicit fir_q15(const std::array<q15_t, Taps>& coefficients)
+        : reversed()
+        , history()
+        , position(0) {
+        for ( size_t tap = 0; tap < Taps; tap++ ) {
+            this->reversed[tap] = coefficients[Taps - 1 - tap];
+        }
+    }
+
+    /**
+     * \brief filter a block in place
+     *
+     * \param data the block
+     * \param count number of samples
+     */
+    void process(q15_t* data, size_t count) {
+        for ( size_t index = 0; index < count; index++ ) {
+            /* the history is stored twice over so the window ending at the newest sample is always contiguous */
+            this->history[this->position] = data[index];
+            this->history[this->position + Taps] = data[index];
+            const q15_t* window = &this->history[this->position + 1];
+            this->position = (this->position + 1 == Taps) ? 0 : this->position + 1;
+
+            int32_t accumulator = 0;
+            for ( size_t tap = 0; tap < Taps; tap += 2 ) {
+                accumulator = simd::dual_multiply_accumulate(simd::load_pair(&window[tap]), simd::load_pair(&this->reversed[tap]), accumulator);
+            }
+            data[index] = static_cast<q15_t>(simd::saturate_16(accumulator >> 15));
+        }
+    }
+
+    /**
+     * \brief clear the history
+     */
+    void reset(void) {
+        this->history.fill(0);
+        this->position = 0;
+    }
+
+  private:
+    std::array<q15_t, Taps> reversed;  //!< oldest sample's coefficient first, to match the window
+    std::array<q15_t, 2 * Taps> history;
+    size_t position;  //!< where the next sample goes
+};
+
+/**
+ * \brief coefficients for one biquad section, in q14 so they can reach +/-2. The feedback terms are for
+ *        y[n] = b0 x[n] + b1 x[n-1] + b2 x[n-2] - a1 y[n-1] - a2 y[n-2].
+ */
+struct biquad_coefficients_q14 {
+    q15_t b0;
+    q15_t b1;
+    q15_t b2;
+    q15_t a1;
+    q15_t a2;
+};
+
+/**
+ * \brief convert a float to the q14 format of the biquad coefficients
+ */
+constexpr q15_t to_q14(float value) {
+    return to_q15(value / 2.0f);
+}
+
+/**
+ * \brief q15 cascade of direct form I biquad sections. Blocks are filtered in place.
+ *
+ * \tparam Stages number of second order sections
+ */
+template <size_t Stages>
+class biquad_cascade_q15 {
+  public:
+    /**
+     * \brief Construct a new biquad cascade
+     *
+     * \param coefficients one set per section, first section first
+     */
+    explicit biquad_cascade_q15(const std::array<biquad_coefficients_q14, Stages>& coefficients)
+        : stages() {
+        for ( size_t stage = 0; stage < Stages; stage++ ) {
+            const auto& section = coefficients[stage];
+            this->stages[stage].b0 = section.b0;
+            this->stages[stage].b1_b2 = simd::pack(section.b1, section.b2);
+            this->stages[stage].a1_a2 = simd::pack(static_cast<q15_t>(-section.a1), static_cast<q15_t>(-section.a2));
+            this->stages[stage].x1_x2 = 0;
+            this->stages[stage].y1_y2 = 0;
+        }
+    }
+
+    /**
+     * \brief filter a block in place
+     *
+     * \param data the block
+     * \param count number of samples
+     */
+    void process(q15_t* data, size_t count) {
+        for ( auto& stage : this->stages ) {
+            for ( size_t index = 0; index < count; index++ ) {
+                q15_t input = data[index];
+                int32_t accumulator = stage.b0 * input;
+                accumulator = simd::dual_multiply_accumulate(stage.b1_b2, stage.x1_x2, accumulator);
+                accumulator = simd::dual_multiply_accumulate(stage.a1_a2, stage.y1_y2, accumulator);
+                q15_t output = static_cast<q15_t>(simd::saturate_16(accumulator >> 14));
+
+                /* shift the delay lines, the newest sample is in the low half */
+                stage.x1_x2 = simd::pack(input, simd::low_half(stage.x1_x2));
+                stage.y1_y2 = simd::pack(output, simd::low_half(stage.y1_y2));
+                data[index] = output;
+            }
+        }
+    }
+
+    /**
+     * \brief clear the delay lines
+     */
+    void reset(void) {
+        for ( auto& stage : this->stages ) {
+            stage.x1_x2 = 0;
+            stage.y1_y2 = 0;
+        }
+    }
+
+  private:
+    /**
+     * \brief a section with its coefficients and state packed in pairs for the dual multiply-accumulate
+     */
+    struct section {
+        q15_t b0;
+        uint32_t b1_b2;
+        uint32_t a1_a2;  //!< negated
+        uint32_t x1_x2;
+        uint32_t y1_y2;
+    };
+
+    std::array<section, Stages> stages;
+};
+
+/************************************** FFT **********************************************/
+/**
+ * \brief q15 FFT of a block of real samples. The block is transformed in place into the first half of the
+ *        spectrum as interleaved real and imaginary parts, with bin 0's imaginary slot holding the real part of
+ *        the Nyquist bin since both are purely real. Each stage halves its output to stay in range, so the
+ *        result is the spectrum scaled by 1/N.
+ *
+ * \tparam N block size, a power of two
+ */
+template <size_t N>
+class rfft_q15 {
+    static_assert((N >= 4) && ((N & (N - 1)) == 0), "FFT size must be a power of two");
+
+  public:
+    static constexpr size_t bins = N / 2;
+
+    /**
+     * \brief transform a block in place
+     *
+     * \param data N real samples in, bins complex values out
+     */
+    void transform(q15_t* data) {
+        /* the even samples are the real parts and the odd samples the imaginary parts of a half size complex block */
+        this->complex_transform(data);
+        this->split(data);
+    }
+
+    /**
+     * \brief get the magnitude of each bin. The Nyquist bin is left out.
+     *
+     * \param spectrum the transformed block
+     * \param magnitudes where to store the bins magnitudes
+     */
+    static void magnitude(const q15_t* spectrum, q15_t* magnitudes) {
+        magnitudes[0] = static_cast<q15_t>((spectrum[0] < 0) ? -spectrum[0] : spectrum[0]);
+        for ( size_t bin = 1; bin < bins; bin++ ) {
+            uint32_t pair = simd::load_pair(&spectrum[2 * bin]);
+            uint32_t power = static_cast<uint32_t>(simd::dual_multiply_add(pair, pair));
+            magnitudes[bin] = static_cast<q15_t>(simd::saturate_16(static_cast<int32_t>(square_root(power))));
+        }
+    }
+
+  private:
+    static constexpr size_t half = N / 2;  //!< points in the complex transform
+
+    /**
+     * \brief twiddle factors exp(-j 2 pi k / N) for k < N / 2, packed as cos in the low half and sin in the high
+     *        half. The complex transform uses every other one.
+     */
+    static constexpr std::array<uint32_t, half> make_twiddles(void) {
+        std::array<uint32_t, half> table{};
+        for ( size_t k = 0; k < half; k++ ) {
+            uint16_t cosine = static_cast<uint16_t>(sine_q15(k + (N / 4), N));
+            uint16_t sine = static_cast<uint16_t>(sine_q15(k, N));
+            table[k] = (static_cast<uint32_t>(sine) << 16) | cosine;
+        }
+        return table;
+    }
+
+    static constexpr std::array<uint32_t, half> twiddles = make_twiddles();
+
+    /**
+     * \brief multiply a packed complex value by a packed twiddle, b * (cos - j sin)
+     */
+    static uint32_t rotate(uint32_t value, uint32_t twiddle) {
+        int32_t real = simd::dual_multiply_add(value, twiddle) >> 15;
+        int32_t imaginary = simd::dual_multiply_subtract_exchanged(twiddle, value) >> 15;
+        return simd::pack(static_cast<q15_t>(simd::saturate_16(real)), static_cast<q15_t>(simd::saturate_16(imaginary)));
+    }
+
+    /**
+     * \brief radix-2 decimation in time FFT of half complex points, halving at each stage
+     */
+    void complex_transform(q15_t* data) {
+        /* bit reverse the order of the points */
+        for ( size_t index = 1, reversed = 0; index < half; index++ ) {
+            size_t bit = half >> 1;
+            for ( ; reversed & bit; bit >>= 1 ) {
+                reversed ^= bit;
+            }
+            reversed ^= bit;
+            if ( index < reversed ) {
+                uint32_t point = simd::load_pair(&data[2 * index]);
+                simd::store_pair(&data[2 * index], simd::load_pair(&data[2 * reversed]));
+                simd::store_pair(&data[2 * reversed], point);
+            }
+        }
+
+        for ( size_t span = 1; span < half; span <<= 1 ) {
+            size_t twiddle_step = half / span;
+            for ( size_t group = 0; group < half; group += 2 * span ) {
+                for ( size_t offset = 0; offset < span; offset++ ) {
+                    q15_t* top = &data[2 * (group + offset)];
+                    q15_t* bottom = &data[2 * (group + offset + span)];
+                    uint32_t a = simd::load_pair(top);
+                    uint32_t t = rotate(simd::load_pair(bottom), twiddles[offset * twiddle_step]);
+                    simd::store_pair(top, simd::halving_add(a, t));
+                    simd::store_pair(bottom, simd::halving_subtract(a, t));
+                }
+            }
+        }
+    }
+
+    /**
+     * \brief separate the half size transform of the interleaved samples into the spectrum of the real block
+     */
+    void split(q15_t* data) {
+        /* bin 0 and the Nyquist bin come from the first point alone */
+        int32_t real = data[0];
+        int32_t imaginary = data[1];
+        data[0] = static_cast<q15_t>((real + imaginary) >> 1);
+        data[1] = static_cast<q15_t>((real - imaginary) >> 1);
+
+        /* the rest pair up bin k with bin half - k, so each pass works out both */
+        for ( size_t k = 1; k <= (half / 2); k++ ) {
+            size_t mirror = half - k;
+            int32_t zr = data[2 * k];
+            int32_t zi = data[2 * k + 1];
+            int32_t mr = data[2 * mirror];
+            int32_t mi = data[2 * mirror + 1];
+
+            /* even part (Z[k] + conj(Z[half - k])) / 2 and odd part (Z[k] - conj(Z[half - k])) / 2j */
+            int32_t even_r = (zr + mr) >> 1;
+            int32_t even_i = (zi - mi) >> 1;
+            int32_t odd_r = (zi + mi) >> 1;
+            int32_t odd_i = (mr - zr) >> 1;
+
+            uint32_t odd_k = rotate(simd::pack(static_cast<q15_t>(odd_r), static_cast<q15_t>(odd_i)), twiddles[k]);
+            data[2 * k] = static_cast<q15_t>((even_r + simd::low_half(odd_k)) >> 1);
+            data[2 * k + 1] = static_cast<q15_t>((even_i + simd::high_half(odd_k)) >> 1);
+
+            if ( mirror != k ) {
+                /* the mirror bin's even and odd parts are the conjugates of bin k's */
+                uint32_t odd_m = rotate(simd::pack(static_cast<q15_t>(odd_r), static_cast<q15_t>(-odd_i)), twiddles[mirror]);
+                data[2 * mirror] = static_cast<q15_t>((even_r + simd::low_half(odd_m)) >> 1);
+                data[2 * mirror + 1] = static_cast<q15_t>((simd::high_half(odd_m) - even_i) >> 1);
+            }
+        }
+    }
+};
+
+};  // namespace dsp
@@ -44,6 +44,16 @@ defined in linker script */
 .word  _sbss
 /* end address for the .bss section. defined in linker script */
 .word  _ebss
+/* start address for the initialization values of the .ccmram section. defined in linker script */
+.word  _siccmram
+/* start address for the .ccmram section. defined in linker script */
+.word  _sccmram
+/* end address for the .ccmram section. defined in linker script */
+.word  _eccmram
+/* start address for the .ccmram_bss section. defined in linker script */
+.word  _sccmram_bss
+/* end address for the .ccmram_bss section. defined in linker script */
+.word  _eccmram_bss
 /* stack used for SystemInit_ExtMemCtl; always internal RAM used */
 
 /**
@@ -89,6 +99,34 @@ LoopFillZerobss:
   cmp  r2, r3
   bcc  FillZerobss
 
+/* Copy the ccmram initializers from flash to CCM RAM */
+  movs  r1, #0
+  b  LoopCopyCcmramInit
+
+CopyCcmramInit:
+  ldr  r3, =_siccmram
+  ldr  r3, [r3, r1]
+  str  r3, [r0, r1]
+  adds  r1, r1, #4
+
+LoopCopyCcmramInit:
+  ldr  r0, =_sccmram
+  ldr  r3, =_eccmram
+  adds  r2, r0, r1
+  cmp  r2, r3
+  bcc  CopyCcmramInit
+  ldr  r2, =_sccmram_bss
+  b  LoopFillZeroCcmram
+/* Zero fill the ccmram bss segment. */
+FillZeroCcmram:
+  movs  r3, #0
+  str  r3, [r2], #4
+
+LoopFillZeroCcmram:
+  ldr  r3, = _eccmram_bss
+  cmp  r2, r3
+  bcc  FillZeroCcmram
+
 /* Call the clock system intitialization function.*/
 /*  bl  SystemInit   */
 /* Call static constructors */
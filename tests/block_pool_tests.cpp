@@ -0,0 +1,136 @@
+/*! \file block_pool_tests.cpp
+*
+*  \brief Unit tests for the fixed-block memory pool.
+*
+*
+*  \author Graham Riches
+*/
+
+/********************************** Includes *******************************************/
+#include "gtest/gtest.h"
+#include "block_pool_impl.h"
+#include <set>
+
+
+/*********************************** Consts ********************************************/
+constexpr size_t block_size = 24;
+constexpr size_t block_count = 4;
+
+/************************************ Types ********************************************/
+struct test_object {
+    test_object(uint32_t value, bool* destroyed)
+        : value(value)
+        , destroyed(destroyed) { }
+
+    ~test_object() {
+        *destroyed = true;
+    }
+
+    uint32_t value;
+    bool* destroyed;
+};
+
+/************************************ Test Fixtures ********************************************/
+class BlockPoolTest : public ::testing::Test {
+  protected:
+    os::block_pool_impl<block_size, block_count> pool;
+};
+
+/************************************ Tests ********************************************/
+TEST_F(BlockPoolTest, test_pool_starts_with_every_block_free) {
+    ASSERT_EQ(block_count, pool.get_free_count());
+    ASSERT_EQ(0u, pool.get_used_count());
+    ASSERT_EQ(0u, pool.get_high_water_mark());
+}
+
+TEST_F(BlockPoolTest, test_allocated_blocks_are_distinct_and_aligned) {
+    std::set<void*> blocks;
+    for ( size_t count = 0; count < block_count; count++ ) {
+        void* block = pool.allocate();
+        ASSERT_NE(nullptr, block);
+        ASSERT_EQ(0u, reinterpret_cast<uintptr_t>(block) % alignof(std::max_align_t));
+        blocks.insert(block);
+    }
+    ASSERT_EQ(block_count, blocks.size());
+}
+
+TEST_F(BlockPoolTest, test_allocate_fails_when_the_pool_is_empty) {
+    for ( size_t count = 0; count < block_count; count++ ) {
+        pool.allocate();
+    }
+    ASSERT_EQ(nullptr, pool.allocate());
+    ASSERT_EQ(1u, pool.get_failed_count());
+}
+
+TEST_F(BlockPoolTest, test_freed_block_is_reused) {
+    void* block = pool.allocate();
+    ASSERT_TRUE(pool.free(block));
+    ASSERT_EQ(block, pool.allocate());
+}
+
+TEST_F(BlockPoolTest, test_high_water_mark_tracks_peak_usage) {
+    void* first = pool.allocate();
+    void* second = pool.allocate();
+    pool.free(first);
+    pool.free(second);
+    pool.allocate();
+    ASSERT_EQ(1u, pool.get_used_count());
+    ASSERT_EQ(2u, pool.get_high_water_mark());
+}
+
+TEST_F(BlockPoolTest, test_free_rejects_pointers_outside_the_pool) {
+    uint8_t foreign[block_size];
+    auto block = static_cast<uint8_t*>(pool.allocate());
+    ASSERT_FALSE(pool.free(foreign));
+    ASSERT_FALSE(pool.free(block + 1));
+    ASSERT_FALSE(pool.free(nullptr));
+    ASSERT_EQ(1u, pool.get_used_count());
+}
+
+TEST_F(BlockPoolTest, test_free_rejects_double_and_never_allocated_frees) {
+    void* first = pool.allocate();
+    void* second = pool.allocate();
+    ASSERT_TRUE(pool.free(first));
+    ASSERT_FALSE(pool.free(first));
+    ASSERT_TRUE(pool.is_allocated(second));
+    ASSERT_FALSE(pool.is_allocated(first));
+    ASSERT_EQ(1u, pool.get_used_count());
+
+    /* the free list is intact, so every remaining block comes out once */
+    std::set<void*> blocks;
+    for ( void* block = pool.allocate(); block != nullptr; block = pool.allocate() ) {
+        ASSERT_TRUE(blocks.insert(block).second);
+    }
+    ASSERT_EQ(block_count - 1, blocks.size());
+    ASSERT_EQ(0u, blocks.count(second));
+}
+
+TEST_F(BlockPoolTest, test_free_rejects_blocks_that_were_never_allocated) {
+    /* blocks come off the free list in order, so the one after the second has not been handed out yet */
+    auto first = static_cast<uint8_t*>(pool.allocate());
+    auto second = static_cast<uint8_t*>(pool.allocate());
+    uint8_t* unused = second + (second - first);
+    ASSERT_TRUE(pool.contains(unused));
+    ASSERT_FALSE(pool.is_allocated(unused));
+    ASSERT_FALSE(pool.free(unused));
+    ASSERT_EQ(2u, pool.get_used_count());
+}
+
+TEST_F(BlockPoolTest, test_destroy_twice_runs_the_destructor_once) {
+    bool destroyed = false;
+    auto object = pool.create<test_object>(42u, &destroyed);
+    ASSERT_TRUE(pool.destroy(object));
+    destroyed = false;
+    ASSERT_FALSE(pool.destroy(object));
+    ASSERT_FALSE(destroyed);
+}
+
+TEST_F(BlockPoolTest, test_create_and_destroy_run_constructor_and_destructor) {
+    bool destroyed = false;
+    auto object = pool.create<test_object>(42u, &destroyed);
+    ASSERT_NE(nullptr, object);
+    ASSERT_EQ(42u, object->value);
+    ASSERT_TRUE(pool.destroy(object));
+    ASSERT_TRUE(destroyed);
+    ASSERT_EQ(0u, pool.get_used_count());
+}
@@ -0,0 +1,221 @@
+/*! \file coroutine_tests.cpp
+*
+*  \brief Unit tests for the coroutine tasks, executor and awaitables.
+*
+*
+*  \author Graham Riches
+*/
+
+/********************************** Includes *******************************************/
+#include "gtest/gtest.h"
+#include "block_pool_impl.h"
+#include "coroutine_impl.h"
+#include <vector>
+
+
+/*********************************** Consts ********************************************/
+/* frames are much bigger on the host with optimizations off */
+constexpr size_t test_frame_size = 1024;
+constexpr size_t test_frame_count = 4;
+
+/******************************** Local Variables **************************************/
+static os::block_pool_impl<test_frame_size, test_frame_count> test_frame_pool;
+
+/****************************** Functions Definition ***********************************/
+namespace os
+{
+void* allocate_coroutine_frame(size_t size) noexcept {
+    return (size <= test_frame_size) ? test_frame_pool.allocate() : nullptr;
+}
+
+void free_coroutine_frame(void* frame) noexcept {
+    test_frame_pool.free(frame);
+}
+};  // namespace os
+
+/************************************ Types ********************************************/
+/**
+ * \brief executor that counts the owner wakeups
+ */
+class TestExecutor : public os::coroutine_executor_impl {
+  public:
+    int notify_count = 0;
+
+  protected:
+    void notify(void) override {
+        notify_count++;
+    }
+};
+
+/************************************ Test Coroutines ********************************************/
+static os::co_task record_steps(std::vector<int>& steps, int id, uint32_t sleep_ticks) {
+    steps.push_back(id);
+    co_await os::co_sleep(sleep_ticks);
+    steps.push_back(id + 1);
+}
+
+static os::co_task wait_for_event(os::co_event& event, std::vector<int>& steps, int id) {
+    co_await event.wait();
+    steps.push_back(id);
+}
+
+static os::co_task take_twice(os::co_semaphore& semaphore, std::vector<int>& steps) {
+    co_await semaphore.take();
+    steps.push_back(1);
+    co_await semaphore.take();
+    steps.push_back(2);
+}
+
+static os::co_task yield_times(int& count, int times) {
+    while ( count < times ) {
+        count++;
+        co_await os::co_sleep(0);
+    }
+}
+
+/************************************ Test Fixtures ********************************************/
+class CoroutineTest : public ::testing::Test {
+  protected:
+    void TearDown(void) override {
+        ASSERT_EQ(0u, test_frame_pool.get_used_count());
+    }
+
+    std::vector<int> steps;
+};
+
+/************************************ Tests ********************************************/
+TEST_F(CoroutineTest, test_task_only_starts_once_spawned_and_run) {
+    TestExecutor executor;
+    os::co_task task = record_steps(steps, 10, 0);
+    ASSERT_TRUE(task.is_valid());
+    ASSERT_TRUE(steps.empty());
+
+    ASSERT_TRUE(executor.spawn(std::move(task)));
+    ASSERT_FALSE(task.is_valid());
+    ASSERT_EQ(1, executor.notify_count);
+    ASSERT_TRUE(steps.empty());
+
+    ASSERT_EQ(1u, executor.run_ready(0));
+    ASSERT_EQ(std::vector<int>({10}), steps);
+    ASSERT_EQ(1u, executor.run_ready(0));
+    ASSERT_EQ(std::vector<int>({10, 11}), steps);
+    ASSERT_EQ(0u, executor.get_task_count());
+}
+
+TEST_F(CoroutineTest, test_unspawned_task_frees_its_frame) {
+    {
+        os::co_task task = record_steps(steps, 10, 0);
+        ASSERT_EQ(1u, test_frame_pool.get_used_count());
+    }
+    ASSERT_TRUE(steps.empty());
+}
+
+TEST_F(CoroutineTest, test_failed_frame_allocation_gives_an_invalid_task) {
+    std::vector<os::co_task> tasks;
+    for ( size_t count = 0; count < test_frame_count; count++ ) {
+        tasks.push_back(record_steps(steps, 0, 0));
+    }
+
+    TestExecutor executor;
+    os::co_task extra = record_steps(steps, 0, 0);
+    ASSERT_FALSE(extra.is_valid());
+    ASSERT_FALSE(executor.spawn(std::move(extra)));
+}
+
+TEST_F(CoroutineTest, test_sleepers_wake_in_order_when_due) {
+    TestExecutor executor;
+    executor.spawn(record_steps(steps, 10, 5));
+    executor.spawn(record_steps(steps, 20, 2));
+    executor.run_ready(100);
+    ASSERT_EQ(std::vector<int>({10, 20}), steps);
+    ASSERT_EQ(2u, executor.get_ticks_until_wake(100));
+
+    ASSERT_EQ(0u, executor.run_ready(101));
+    ASSERT_EQ(1u, executor.run_ready(102));
+    ASSERT_EQ(std::vector<int>({10, 20, 21}), steps);
+    ASSERT_EQ(3u, executor.get_ticks_until_wake(102));
+
+    ASSERT_EQ(1u, executor.run_ready(110));
+    ASSERT_EQ(std::vector<int>({10, 20, 21, 11}), steps);
+    ASSERT_EQ(os::coroutine_executor_impl::wait_forever, executor.get_ticks_until_wake(110));
+}
+
+TEST_F(CoroutineTest, test_sleep_across_the_tick_wrap) {
+    TestExecutor executor;
+    executor.spawn(record_steps(steps, 10, 10));
+    executor.run_ready(UINT32_MAX - 4);
+    ASSERT_EQ(10u, executor.get_ticks_until_wake(UINT32_MAX - 4));
+    ASSERT_EQ(0u, executor.run_ready(2));
+    ASSERT_EQ(1u, executor.run_ready(5));
+    ASSERT_EQ(std::vector<int>({10, 11}), steps);
+}
+
+TEST_F(CoroutineTest, test_yielding_task_runs_once_per_pass) {
+    TestExecutor executor;
+    int count = 0;
+    executor.spawn(yield_times(count, 2));
+    executor.run_ready(0);
+    ASSERT_EQ(1, count);
+    ASSERT_EQ(0u, executor.get_ticks_until_wake(0));
+    executor.run_ready(0);
+    ASSERT_EQ(2, count);
+    executor.run_ready(0);
+    ASSERT_EQ(0u, executor.get_task_count());
+}
+
+TEST_F(CoroutineTest, test_event_releases_one_waiter_per_set) {
+    TestExecutor executor;
+    os::co_event event(executor);
+    executor.spawn(wait_for_event(event, steps, 1));
+    executor.spawn(wait_for_event(event, steps, 2));
+    executor.run_ready(0);
+    ASSERT_TRUE(steps.empty());
+    ASSERT_EQ(os::coroutine_executor_impl::wait_forever, executor.get_ticks_until_wake(0));
+
+    int notified = executor.notify_count;
+    event.set();
+    ASSERT_EQ(notified + 1, executor.notify_count);
+    executor.run_ready(0);
+    ASSERT_EQ(std::vector<int>({1}), steps);
+
+    event.set();
+    executor.run_ready(0);
+    ASSERT_EQ(std::vector<int>({1, 2}), steps);
+    ASSERT_FALSE(event.is_set());
+}
+
+TEST_F(CoroutineTest, test_event_set_before_the_wait_is_not_lost) {
+    TestExecutor executor;
+    os::co_event event(executor);
+    event.set();
+    ASSERT_TRUE(event.is_set());
+
+    executor.spawn(wait_for_event(event, steps, 1));
+    executor.run_ready(0);
+    ASSERT_EQ(std::vector<int>({1}), steps);
+    ASSERT_FALSE(event.is_set());
+}
+
+TEST_F(CoroutineTest, test_semaphore_counts_and_hands_over) {
+    TestExecutor executor;
+    os::co_semaphore semaphore(executor, 1);
+    executor.spawn(take_twice(semaphore, steps));
+    executor.run_ready(0);
+    ASSERT_EQ(std::vector<int>({1}), steps);
+    ASSERT_EQ(0u, semaphore.get_count());
+
+    semaphore.signal();
+    ASSERT_EQ(0u, semaphore.get_count());
+    executor.run_ready(0);
+    ASSERT_EQ(std::vector<int>({1, 2}), steps);
+    ASSERT_EQ(0u, executor.get_task_count());
+}
+
+TEST_F(CoroutineTest, test_semaphore_saturates) {
+    TestExecutor executor;
+    os::co_semaphore semaphore(executor, 0, 2);
+    semaphore.signal();
+    semaphore.signal();
+    semaphore.signal();
+    ASSERT_EQ(2u, semaphore.get_count());
+}
@@ -0,0 +1,163 @@
+/*! \file crash_dump_tests.cpp
+*
+*  \brief Unit tests for the crash dump store.
+*
+*
+*  \author Graham Riches
+*/
+
+/********************************** Includes *******************************************/
+#include "gtest/gtest.h"
+#include "crash_dump_impl.h"
+#include <algorithm>
+#include <string>
+#include <vector>
+
+
+/*********************************** Consts ********************************************/
+constexpr size_t test_slot_count = 3;
+
+/************************************ Types ********************************************/
+/**
+ * \brief flash block in RAM that programs the way flash does, by only clearing bits
+ */
+class MockFlashDevice {
+  public:
+    explicit MockFlashDevice(size_t word_count)
+        : words(word_count, os::crash_dump_erased_word)
+        , erase_count(0) { }
+
+    const uint32_t* get_words(void) const {
+        return words.data();
+    }
+
+    size_t get_word_count(void) const {
+        return words.size();
+    }
+
+    bool erase(void) {
+        std::fill(words.begin(), words.end(), os::crash_dump_erased_word);
+        erase_count++;
+        return true;
+    }
+
+    bool program(size_t index, uint32_t value) {
+        words[index] &= value;
+        return words[index] == value;
+    }
+
+    std::vector<uint32_t> words;
+    int erase_count;
+};
+
+/************************************ Test Fixtures ********************************************/
+class CrashDumpStoreTest : public ::testing::Test {
+  protected:
+    using store_type = os::crash_dump_store_impl<MockFlashDevice>;
+
+    CrashDumpStoreTest()
+        : device((store_type::record_words * test_slot_count) + 1)
+        , store(device) { }
+
+    bool save(uint32_t return_address) {
+        os::crash_dump_record record = {};
+        record.fault = os::fault_type::bus_fault;
+        record.frame.return_address = return_address;
+        return store.save(record);
+    }
+
+    MockFlashDevice device;
+    store_type store;
+};
+
+/************************************ Tests ********************************************/
+TEST_F(CrashDumpStoreTest, test_empty_store_has_no_dumps) {
+    os::crash_dump_record record;
+    ASSERT_EQ(test_slot_count, store.get_slot_count());
+    ASSERT_EQ(0u, store.get_count());
+    ASSERT_FALSE(store.read(0, record));
+}
+
+TEST_F(CrashDumpStoreTest, test_saved_dump_reads_back) {
+    os::crash_dump_record record = {};
+    record.fault = os::fault_type::usage_fault;
+    record.frame.return_address = 0x08001234;
+    record.cfsr = 0x00010000;
+    record.thread_id = 10;
+    record.trace_count = 1;
+    record.trace[0] = {100, 10, os::trace_event::thread_switch_in, 0, 0};
+    ASSERT_TRUE(store.save(record));
+
+    os::crash_dump_record stored;
+    ASSERT_EQ(1u, store.get_count());
+    ASSERT_TRUE(store.read(0, stored));
+    ASSERT_EQ(os::crash_dump_marker, stored.marker);
+    ASSERT_EQ(1u, stored.sequence);
+    ASSERT_EQ(os::fault_type::usage_fault, stored.fault);
+    ASSERT_EQ(0x08001234u, stored.frame.return_address);
+    ASSERT_EQ(0x00010000u, stored.cfsr);
+    ASSERT_EQ(10u, stored.thread_id);
+    ASSERT_EQ(os::trace_event::thread_switch_in, stored.trace[0].event);
+}
+
+TEST_F(CrashDumpStoreTest, test_dumps_read_back_oldest_first) {
+    save(1);
+    save(2);
+
+    os::crash_dump_record stored;
+    ASSERT_EQ(2u, store.get_count());
+    ASSERT_TRUE(store.read(0, stored));
+    ASSERT_EQ(1u, stored.frame.return_address);
+    ASSERT_TRUE(store.read(1, stored));
+    ASSERT_EQ(2u, stored.frame.return_address);
+    ASSERT_EQ(2u, stored.sequence);
+    ASSERT_FALSE(store.read(2, stored));
+}
+
+TEST_F(CrashDumpStoreTest, test_full_store_is_erased_and_keeps_counting) {
+    for ( uint32_t count = 1; count <= test_slot_count; count++ ) {
+        ASSERT_TRUE(save(count));
+    }
+    ASSERT_EQ(0, device.erase_count);
+
+    ASSERT_TRUE(save(4));
+    ASSERT_EQ(1, device.erase_count);
+
+    os::crash_dump_record stored;
+    ASSERT_EQ(1u, store.get_count());
+    ASSERT_TRUE(store.read(0, stored));
+    ASSERT_EQ(4u, stored.frame.return_address);
+    ASSERT_EQ(4u, stored.sequence);
+}
+
+TEST_F(CrashDumpStoreTest, test_cut_off_dump_is_skipped) {
+    save(1);
+    save(2);
+
+    /* corrupt the second dump as if the reset came part way through writing it */
+    device.words[store_type::record_words + (store_type::record_words / 2)] = os::crash_dump_erased_word;
+
+    os::crash_dump_record stored;
+    ASSERT_EQ(1u, store.get_count());
+    ASSERT_TRUE(save(3));
+    ASSERT_EQ(2u, store.get_count());
+    ASSERT_TRUE(store.read(1, stored));
+    ASSERT_EQ(3u, stored.frame.return_address);
+}
+
+TEST_F(CrashDumpStoreTest, test_clear_erases_every_dump) {
+    save(1);
+    ASSERT_TRUE(store.clear());
+    ASSERT_EQ(0u, store.get_count());
+}
+
+TEST(CrashDumpTest, test_fault_names) {
+    ASSERT_EQ(std::string("hard fault"), os::get_fault_name(os::fault_type::hard_fault));
+    ASSERT_EQ(std::string("unknown"), os::get_fault_name(static_cast<os::fault_type>(0)));
+}
+
+TEST(CrashDumpTest, test_crc32_check_value) {
+    const char check[] = "123456789";
+    ASSERT_EQ(0xCBF43926u, os::crc32(check, sizeof(check) - 1));
+    ASSERT_EQ(0xCBF43926u, os::crc32(check + 4, 5, os::crc32(check, 4)));
+}
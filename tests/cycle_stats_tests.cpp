@@ -0,0 +1,128 @@
+/**
+ * \file cycle_stats_tests.cpp
+ * \author Graham Riches (graham.riches@live.com)
+ * \brief unit tests for the profiler cycle stats accumulator
+ * \version 0.1
+ * \date 2021-05-09
+ * 
+ * @copyright Copyright (c) 2021
+ * 
+ */
+
+/********************************** Includes *******************************************/
+#include "gtest/gtest.h"
+#include "cycle_stats.h"
+#include "irq_stats.h"
+
+
+/*********************************** Test Fixtures ********************************************/
+/**
+ * \brief test fixture for cycle stats tests
+ */
+class CycleStatsTests : public ::testing::Test {
+    public:
+    void SetUp() override {}
+
+    void TearDown() override {}
+    
+    os::cycle_stats stats;
+};
+
+
+TEST_F(CycleStatsTests, test_initial_construction_is_empty) {
+    ASSERT_EQ(0u, stats.get_count());
+    ASSERT_EQ(0u, stats.get_min());
+    ASSERT_EQ(0u, stats.get_max());
+    ASSERT_EQ(0u, stats.get_mean());
+}
+
+TEST_F(CycleStatsTests, test_records_min_max_and_mean) {
+    stats.record(100);
+    stats.record(20);
+    stats.record(60);
+    ASSERT_EQ(3u, stats.get_count());
+    ASSERT_EQ(20u, stats.get_min());
+    ASSERT_EQ(100u, stats.get_max());
+    ASSERT_EQ(60u, stats.get_mean());
+}
+
+TEST_F(CycleStatsTests, test_histogram_buckets_are_powers_of_two) {
+    ASSERT_EQ(0, os::cycle_stats::get_bucket(0));
+    ASSERT_EQ(1, os::cycle_stats::get_bucket(1));
+    ASSERT_EQ(2, os::cycle_stats::get_bucket(2));
+    ASSERT_EQ(2, os::cycle_stats::get_bucket(3));
+    ASSERT_EQ(8, os::cycle_stats::get_bucket(255));
+    ASSERT_EQ(9, os::cycle_stats::get_bucket(256));
+}
+
+TEST_F(CycleStatsTests, test_large_samples_collect_in_last_bucket) {
+    stats.record(UINT32_MAX);
+    stats.record(1ul << 20);
+    ASSERT_EQ(2u, stats.get_histogram_count(os::cycle_stats::histogram_buckets - 1));
+}
+
+TEST_F(CycleStatsTests, test_reset_clears_samples) {
+    stats.record(42);
+    stats.reset();
+    ASSERT_EQ(0u, stats.get_count());
+    ASSERT_EQ(0u, stats.get_max());
+    ASSERT_EQ(0u, stats.get_histogram_count(os::cycle_stats::get_bucket(42)));
+}
+
+TEST(IRQStatsTests, test_durations_are_recorded_per_vector) {
+    os::irq_stats stats;
+    stats.enter(16, 100);
+    stats.exit(16, 100, 150);
+    stats.enter(16, 1000);
+    stats.exit(16, 1000, 1010);
+
+    auto record = stats.get_record(16);
+    ASSERT_EQ(2u, record.count);
+    ASSERT_EQ(60u, record.total_cycles);
+    ASSERT_EQ(50u, record.max_cycles);
+    ASSERT_EQ(0u, stats.get_record(17).count);
+}
+
+TEST(IRQStatsTests, test_arrival_intervals_track_jitter) {
+    os::irq_stats stats;
+    for ( uint32_t entry : {0u, 100u, 300u, 350u} ) {
+        stats.enter(20, entry);
+        stats.exit(20, entry, entry + 5);
+    }
+    auto record = stats.get_record(20);
+    ASSERT_EQ(50u, record.min_interval);
+    ASSERT_EQ(200u, record.max_interval);
+}
+
+TEST(IRQStatsTests, test_nesting_depth_is_tracked) {
+    os::irq_stats stats;
+    stats.enter(30, 0);
+    stats.enter(40, 10);
+    ASSERT_EQ(2u, stats.get_nesting());
+    stats.exit(40, 10, 20);
+    stats.exit(30, 0, 30);
+
+    ASSERT_EQ(0u, stats.get_nesting());
+    ASSERT_EQ(2u, stats.get_max_nesting());
+    ASSERT_EQ(1u, stats.get_record(30).max_nesting);
+    ASSERT_EQ(2u, stats.get_record(40).max_nesting);
+    ASSERT_EQ(30u, stats.get_record(30).max_cycles);
+}
+
+TEST(IRQStatsTests, test_out_of_range_vectors_only_count_nesting) {
+    os::irq_stats stats;
+    stats.enter(os::irq_stats::max_vectors, 0);
+    ASSERT_EQ(1u, stats.get_nesting());
+    stats.exit(os::irq_stats::max_vectors, 0, 10);
+    ASSERT_EQ(0u, stats.get_nesting());
+    ASSERT_EQ(0u, stats.get_record(os::irq_stats::max_vectors).count);
+}
+
+TEST(IRQStatsTests, test_reset_clears_every_record) {
+    os::irq_stats stats;
+    stats.enter(16, 0);
+    stats.exit(16, 0, 10);
+    stats.reset();
+    ASSERT_EQ(0u, stats.get_record(16).count);
+    ASSERT_EQ(0u, stats.get_max_nesting());
+}
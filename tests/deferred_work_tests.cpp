@@ -0,0 +1,75 @@
+/*! \file deferred_work_tests.cpp
+*
+*  \brief Unit tests for the deferred interrupt work queue.
+*
+*
+*  \author Graham Riches
+*/
+
+/********************************** Includes *******************************************/
+#include "gtest/gtest.h"
+#include "deferred_work_impl.h"
+#include <vector>
+
+
+/*********************************** Consts ********************************************/
+constexpr size_t test_queue_size = 4;
+
+/************************************ Helpers ********************************************/
+struct test_work {
+    std::vector<int>* ran;
+    int value;
+};
+
+static void record_context(void* context) {
+    auto item = static_cast<test_work*>(context);
+    item->ran->push_back(item->value);
+}
+
+/************************************ Test Fixtures ********************************************/
+class DeferredWorkTest : public ::testing::Test {
+  protected:
+    os::deferred_work_impl<test_queue_size> work;
+    std::vector<int> ran;
+};
+
+/************************************ Tests ********************************************/
+TEST_F(DeferredWorkTest, test_work_runs_in_submission_order) {
+    test_work first{&ran, 1};
+    test_work second{&ran, 2};
+    ASSERT_TRUE(work.submit(record_context, &first));
+    ASSERT_TRUE(work.submit(record_context, &second));
+    ASSERT_EQ(2u, work.run_pending());
+    ASSERT_EQ((std::vector<int>{1, 2}), ran);
+    ASSERT_EQ(0u, work.run_pending());
+}
+
+TEST_F(DeferredWorkTest, test_full_queue_drops_and_counts_work) {
+    test_work item{&ran, 7};
+    for ( size_t count = 0; count < test_queue_size; count++ ) {
+        ASSERT_TRUE(work.submit(record_context, &item));
+    }
+    ASSERT_FALSE(work.submit(record_context, &item));
+    ASSERT_EQ(1u, work.take_dropped_count());
+    ASSERT_EQ(test_queue_size, work.run_pending());
+}
+
+TEST_F(DeferredWorkTest, test_null_callbacks_are_rejected) {
+    ASSERT_FALSE(work.submit(nullptr, nullptr));
+    ASSERT_EQ(0u, work.run_pending());
+}
+
+TEST_F(DeferredWorkTest, test_work_submitted_while_running_is_run_in_the_same_pass) {
+    struct chained {
+        os::deferred_work_impl<test_queue_size>* work;
+        test_work next;
+    };
+    auto submit_next = [](void* context) {
+        auto item = static_cast<chained*>(context);
+        item->work->submit(record_context, &item->next);
+    };
+    chained item{&work, test_work{&ran, 3}};
+    ASSERT_TRUE(work.submit(submit_next, &item));
+    ASSERT_EQ(2u, work.run_pending());
+    ASSERT_EQ((std::vector<int>{3}), ran);
+}
@@ -0,0 +1,144 @@
+/*! \file dsp_tests.cpp
+*
+*  \brief Unit tests for the q15 filters and real FFT.
+*
+*
+*  \author Graham Riches
+*/
+
+/********************************** Includes *******************************************/
+#include "gtest/gtest.h"
+#include "dsp_q15.h"
+#include <cmath>
+#include <cstdlib>
+
+/*********************************** Consts ********************************************/
+constexpr size_t fft_size = 64;
+constexpr double pi = 3.14159265358979323846;
+
+/************************************ Tests ********************************************/
+TEST(DSPTest, test_sine_table_values) {
+    ASSERT_EQ(0, dsp::sine_q15(0, 64));
+    ASSERT_EQ(32767, dsp::sine_q15(16, 64));
+    ASSERT_EQ(-32767, dsp::sine_q15(48, 64));
+    ASSERT_NEAR(23170, dsp::sine_q15(8, 64), 1);
+    ASSERT_NEAR(-23170, dsp::sine_q15(40, 64), 1);
+}
+
+TEST(DSPTest, test_square_root) {
+    ASSERT_EQ(0u, dsp::square_root(0));
+    ASSERT_EQ(3u, dsp::square_root(15));
+    ASSERT_EQ(4u, dsp::square_root(16));
+    ASSERT_EQ(65535u, dsp::square_root(UINT32_MAX));
+}
+
+TEST(DSPTest, test_fir_impulse_response_is_the_coefficients) {
+    std::array<dsp::q15_t, 4> coefficients = {1000, -2000, 3000, -4000};
+    dsp::fir_q15<4> filter(coefficients);
+
+    dsp::q15_t block[6] = {dsp::q15_max, 0, 0, 0, 0, 0};
+    filter.process(block, 6);
+    for ( size_t tap = 0; tap < coefficients.size(); tap++ ) {
+        ASSERT_NEAR(coefficients[tap], block[tap], 1);
+    }
+    ASSERT_EQ(0, block[4]);
+    ASSERT_EQ(0, block[5]);
+}
+
+TEST(DSPTest, test_fir_history_carries_across_blocks) {
+    std::array<dsp::q15_t, 4> coefficients = {8192, 8192, 8192, 8192};
+    dsp::fir_q15<4> split_filter(coefficients);
+    dsp::fir_q15<4> whole_filter(coefficients);
+
+    dsp::q15_t whole[10];
+    dsp::q15_t split[10];
+    for ( size_t index = 0; index < 10; index++ ) {
+        whole[index] = split[index] = static_cast<dsp::q15_t>(index * 1000);
+    }
+    whole_filter.process(whole, 10);
+    split_filter.process(split, 3);
+    split_filter.process(&split[3], 7);
+    for ( size_t index = 0; index < 10; index++ ) {
+        ASSERT_EQ(whole[index], split[index]);
+    }
+}
+
+TEST(DSPTest, test_biquad_pass_through) {
+    dsp::biquad_cascade_q15<1> filter({dsp::biquad_coefficients_q14{dsp::to_q14(1.0f), 0, 0, 0, 0}});
+    dsp::q15_t block[4] = {100, -200, 300, dsp::q15_min};
+    filter.process(block, 4);
+    ASSERT_EQ(100, block[0]);
+    ASSERT_EQ(-200, block[1]);
+    ASSERT_EQ(300, block[2]);
+    ASSERT_EQ(dsp::q15_min, block[3]);
+}
+
+TEST(DSPTest, test_biquad_low_pass_settles_to_a_step) {
+    /* one pole smoothing y = 0.25 x + 0.75 y[n-1] */
+    dsp::biquad_cascade_q15<2> filter({dsp::biquad_coefficients_q14{dsp::to_q14(0.25f), 0, 0, dsp::to_q14(-0.75f), 0},
+                                       dsp::biquad_coefficients_q14{dsp::to_q14(1.0f), 0, 0, 0, 0}});
+    dsp::q15_t block[64];
+    for ( auto& sample : block ) {
+        sample = 10000;
+    }
+    filter.process(block, 64);
+    ASSERT_NEAR(2500, block[0], 1);
+    ASSERT_LT(block[1], block[2]);
+    ASSERT_NEAR(10000, block[63], 20);
+}
+
+TEST(DSPTest, test_fft_of_a_constant_is_all_dc) {
+    dsp::q15_t block[fft_size];
+    for ( auto& sample : block ) {
+        sample = 8000;
+    }
+    dsp::rfft_q15<fft_size> fft;
+    fft.transform(block);
+    ASSERT_NEAR(8000, block[0], 8);
+    ASSERT_NEAR(0, block[1], 2);
+    for ( size_t index = 2; index < fft_size; index++ ) {
+        ASSERT_NEAR(0, block[index], 2);
+    }
+}
+
+TEST(DSPTest, test_fft_matches_a_reference_dft) {
+    dsp::q15_t block[fft_size];
+    double input[fft_size];
+    std::srand(7);
+    for ( size_t index = 0; index < fft_size; index++ ) {
+        block[index] = static_cast<dsp::q15_t>((std::rand() % 20000) - 10000);
+        input[index] = block[index];
+    }
+    dsp::rfft_q15<fft_size> fft;
+    fft.transform(block);
+
+    for ( size_t bin = 1; bin < fft_size / 2; bin++ ) {
+        double real = 0;
+        double imaginary = 0;
+        for ( size_t index = 0; index < fft_size; index++ ) {
+            real += input[index] * std::cos(2 * pi * bin * index / fft_size);
+            imaginary -= input[index] * std::sin(2 * pi * bin * index / fft_size);
+        }
+        ASSERT_NEAR(real / fft_size, block[2 * bin], 8) << "bin " << bin;
+        ASSERT_NEAR(imaginary / fft_size, block[2 * bin + 1], 8) << "bin " << bin;
+    }
+}
+
+TEST(DSPTest, test_fft_magnitude_finds_a_tone) {
+    constexpr size_t tone_bin = 5;
+    dsp::q15_t block[fft_size];
+    for ( size_t index = 0; index < fft_size; index++ ) {
+        block[index] = static_cast<dsp::q15_t>(16000 * std::cos(2 * pi * tone_bin * index / fft_size));
+    }
+    dsp::rfft_q15<fft_size> fft;
+    fft.transform(block);
+
+    dsp::q15_t magnitudes[dsp::rfft_q15<fft_size>::bins];
+    dsp::rfft_q15<fft_size>::magnitude(block, magnitudes);
+    ASSERT_NEAR(8000, magnitudes[tone_bin], 10);
+    for ( size_t bin = 0; bin < dsp::rfft_q15<fft_size>::bins; bin++ ) {
+        if ( bin != tone_bin ) {
+            ASSERT_LT(magnitudes[bin], 10) << "bin " << bin;
+        }
+    }
+}
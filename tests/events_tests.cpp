@@ -7,40 +7,171 @@
 */
 
 /********************************** Includes *******************************************/
-#include "gtest\gtest.h"
-#include "events.h"
+#include "gtest/gtest.h"
+#include "thread_impl.h"
+#include "system_clock_impl.h"
+#include "scheduler_impl.h"
+#include "events_impl.h"
+#include "common.h"
 #include <iostream>
 #include <memory>
 
 
 /*********************************** Consts ********************************************/
-constexpr uint8_t thread_stack_size = 128;
+constexpr uint16_t thread_stack_size = 128;
+constexpr uint8_t thread_count = 2;
 constexpr uint32_t test_event_one = 0x01;
 constexpr uint32_t test_event_two = 0x02;
 constexpr uint32_t test_event_three = 0x03;
 
+/************************************ Local Variables ********************************************/
+static bool pending_irq;
+
+/************************************ Local Functions ********************************************/
+/**
+ * \brief test setting a fake pending IRQ in a c-style callback so that the API to the PendSV handler
+ *        is somewhat tested
+*/
+static void set_pending_irq(){
+    pending_irq = true;
+}
+
+/**
+ * \brief function to check if an interrupt is already pending
+ * \return returns true if a request is already pending
+*/
+static bool is_pending_irq(){
+    return pending_irq;
+}
+
 /************************************ Test Fixtures ********************************************/
 /**
- * \brief test class for the event flags class. This sets up some fake threads and a thread manager
+ * \brief test class for the event flags class. This sets up some fake threads and a scheduler
  *        to test suspending threads on event flags.
 */
 class EventFlagsTest : public ::testing::Test {
   protected:
-    std::unique_ptr<os::EventFlags> event_flags;
-    std::unique_ptr<os::thread> thread_one;
-    std::unique_ptr<os::thread> thread_two;
-    std::unique_ptr<os::threadManager> thread_manager;
-    std::unique_ptr<uint32_t[]> thread_one_stack;
-    std::unique_ptr<uint32_t[]> thread_two_stack;
-
-    static void thread_one_function(void){};
-    static void thread_two_function(void){};
+    static void thread_function(void *arguments){ PARAMETER_NOT_USED(arguments); };
 
-    void SetUp(void) override {}
+    void SetUp(void) override {
+        internal_thread = create_thread(0xFFFF, internal_stack);
+        thread_one = create_thread(1, thread_one_stack);
+        thread_two = create_thread(2, thread_two_stack);
+        scheduler = std::make_unique<os::scheduler_impl>(&clock, thread_count, set_pending_irq, is_pending_irq);
+        scheduler->set_internal_task(internal_thread.get());
+        scheduler->register_thread(thread_one.get());
+        scheduler->register_thread(thread_two.get());
+        scheduler->start();
+        clock.start();
+        pending_irq = false;
+        event_flags = std::make_unique<os::event_flags_impl>(scheduler.get());
+    }
 
     void TearDown(void) override {}
+
+    std::unique_ptr<os::thread> create_thread(uint32_t thread_id, uint32_t *stack_ptr) {
+        return std::make_unique<os::thread>(reinterpret_cast<os::thread::task_pointer>(&thread_function), nullptr, thread_id, stack_ptr, thread_stack_size);
+    }
+
+    //!< block both threads on the event group, leaving the internal thread active
+    void block_both_threads(uint32_t mask_one, uint32_t mask_two, uint8_t options) {
+        tcb_one = scheduler->get_active_tcb_ptr();
+        event_flags->block(mask_one, options);
+        tcb_two = scheduler->get_active_tcb_ptr();
+        event_flags->block(mask_two, options);
+    }
+
+    uint32_t internal_stack[thread_stack_size] = {0};
+    uint32_t thread_one_stack[thread_stack_size] = {0};
+    uint32_t thread_two_stack[thread_stack_size] = {0};
+    std::unique_ptr<os::event_flags_impl> event_flags;
+    std::unique_ptr<os::thread> internal_thread;
+    std::unique_ptr<os::thread> thread_one;
+    std::unique_ptr<os::thread> thread_two;
+    std::unique_ptr<os::scheduler_impl> scheduler;
+    os::system_clock_impl clock;
+    os::scheduler_impl::TaskControlBlock* tcb_one = nullptr;
+    os::scheduler_impl::TaskControlBlock* tcb_two = nullptr;
 };
 
 /************************************ Tests ********************************************/
 TEST_F(EventFlagsTest, test_event_flags_get_suspends_thread) {
+    auto tcb = scheduler->get_active_tcb_ptr();
+    ASSERT_FALSE(event_flags->try_wait(test_event_one, os::wait_any).has_value());
+    event_flags->block(test_event_one, os::wait_any);
+    ASSERT_EQ(os::thread::status::suspended, tcb->thread_ptr->get_status());
+    ASSERT_NE(tcb, scheduler->get_active_tcb_ptr());
+    ASSERT_TRUE(event_flags->has_waiting_threads());
+    ASSERT_TRUE(pending_irq);
+}
+
+TEST_F(EventFlagsTest, test_try_wait_any_returns_flags_when_one_is_set) {
+    event_flags->set(test_event_two);
+    auto flags = event_flags->try_wait(test_event_three, os::wait_any);
+    ASSERT_TRUE(flags.has_value());
+    ASSERT_EQ(test_event_two, flags.value());
+    ASSERT_EQ(test_event_two, event_flags->get());
+}
+
+TEST_F(EventFlagsTest, test_try_wait_all_needs_every_flag) {
+    event_flags->set(test_event_one);
+    ASSERT_FALSE(event_flags->try_wait(test_event_three, os::wait_all).has_value());
+    event_flags->set(test_event_two);
+    ASSERT_TRUE(event_flags->try_wait(test_event_three, os::wait_all).has_value());
+}
+
+TEST_F(EventFlagsTest, test_clear_on_exit_clears_requested_flags) {
+    event_flags->set(test_event_three);
+    event_flags->try_wait(test_event_one, os::wait_any | os::clear_on_exit);
+    ASSERT_EQ(test_event_two, event_flags->get());
+}
+
+TEST_F(EventFlagsTest, test_clear_returns_previous_flags) {
+    event_flags->set(test_event_three);
+    ASSERT_EQ(test_event_three, event_flags->clear(test_event_one));
+    ASSERT_EQ(test_event_two, event_flags->get());
+}
+
+TEST_F(EventFlagsTest, test_set_wakes_a_matching_waiter) {
+    block_both_threads(test_event_one, test_event_two, os::wait_any);
+    event_flags->set(test_event_one);
+    ASSERT_EQ(os::thread::status::active, tcb_one->thread_ptr->get_status());
+    ASSERT_EQ(os::thread::status::suspended, tcb_two->thread_ptr->get_status());
+    ASSERT_EQ(test_event_one, tcb_one->details->wait_flags);
+    ASSERT_FALSE(tcb_one->wait_timed_out);
+}
+
+TEST_F(EventFlagsTest, test_single_set_wakes_every_matching_waiter) {
+    block_both_threads(test_event_one, test_event_three, os::wait_any);
+    event_flags->set(test_event_one);
+    ASSERT_FALSE(event_flags->has_waiting_threads());
+    ASSERT_NE(os::thread::status::suspended, tcb_one->thread_ptr->get_status());
+    ASSERT_NE(os::thread::status::suspended, tcb_two->thread_ptr->get_status());
+}
+
+TEST_F(EventFlagsTest, test_wait_all_waiter_only_wakes_once_every_flag_is_set) {
+    block_both_threads(test_event_three, test_event_three, os::wait_all);
+    event_flags->set(test_event_one);
+    ASSERT_EQ(os::thread::status::suspended, tcb_one->thread_ptr->get_status());
+    event_flags->set(test_event_two);
+    ASSERT_FALSE(event_flags->has_waiting_threads());
+    ASSERT_EQ(test_event_three, tcb_one->details->wait_flags);
+    ASSERT_EQ(test_event_three, tcb_two->details->wait_flags);
+}
+
+TEST_F(EventFlagsTest, test_clear_on_exit_happens_after_every_waiter_is_checked) {
+    block_both_threads(test_event_one, test_event_one, os::wait_any | os::clear_on_exit);
+    event_flags->set(test_event_one);
+    ASSERT_FALSE(event_flags->has_waiting_threads());
+    ASSERT_EQ(0u, event_flags->get());
+}
+
+TEST_F(EventFlagsTest, test_timed_wait_expires) {
+    auto tcb = scheduler->get_active_tcb_ptr();
+    event_flags->block(test_event_one, os::wait_any, 5);
+    pending_irq = false;
+    clock.update(5);
+    scheduler->run();
+    ASSERT_TRUE(tcb->wait_timed_out);
+    ASSERT_FALSE(event_flags->has_waiting_threads());
 }
@@ -0,0 +1,270 @@
+/*! \file kv_store_tests.cpp
+*
+*  \brief Unit tests for the flash key-value store.
+*
+*
+*  \author Graham Riches
+*/
+
+/********************************** Includes *******************************************/
+#include "gtest/gtest.h"
+#include "kv_store_impl.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+
+/*********************************** Consts ********************************************/
+constexpr size_t test_sector_words = 32;
+constexpr size_t test_max_keys = 4;
+
+/************************************ Types ********************************************/
+/**
+ * \brief pair of flash sectors in RAM that program the way flash does, by only clearing bits
+ */
+class MockFlashSectors {
+  public:
+    MockFlashSectors()
+        : words(test_sector_words * 2, os::kv_erased_word)
+        , erase_counts{0, 0}
+        , program_count(0)
+        , program_limit(SIZE_MAX) { }
+
+    size_t get_sector_words(void) const {
+        return test_sector_words;
+    }
+
+    const uint32_t* get_words(size_t sector) const {
+        return &words[sector * test_sector_words];
+    }
+
+    bool erase(size_t sector) {
+        std::fill_n(words.begin() + (sector * test_sector_words), test_sector_words, os::kv_erased_word);
+        erase_counts[sector]++;
+        return true;
+    }
+
+    bool program(size_t sector, size_t index, uint32_t value) {
+        if ( program_count == program_limit ) {
+            return false;
+        }
+        program_count++;
+        uint32_t& word = words[(sector * test_sector_words) + index];
+        word &= value;
+        return word == value;
+    }
+
+    std::vector<uint32_t> words;
+    int erase_counts[2];
+    size_t program_count;
+    size_t program_limit;  //!< programs after this many fail, as if the power went
+};
+
+/************************************ Test Fixtures ********************************************/
+class KVStoreTest : public ::testing::Test {
+  protected:
+    using store_type = os::kv_store_impl<MockFlashSectors, test_max_keys>;
+
+    KVStoreTest()
+        : flash()
+        , store(flash) { }
+
+    void SetUp(void) override {
+        ASSERT_TRUE(store.mount());
+    }
+
+    uint32_t read_word(store_type& target, uint16_t key) {
+        uint32_t value = 0;
+        EXPECT_EQ(sizeof(value), target.read(key, &value, sizeof(value)));
+        return value;
+    }
+
+    bool write_word(uint16_t key, uint32_t value) {
+        return store.write(key, &value, sizeof(value));
+    }
+
+    MockFlashSectors flash;
+    store_type store;
+};
+
+/************************************ Tests ********************************************/
+TEST_F(KVStoreTest, test_mount_formats_blank_flash) {
+    ASSERT_TRUE(store.is_mounted());
+    ASSERT_EQ(1u, store.get_generation());
+    ASSERT_EQ(0u, store.get_key_count());
+    ASSERT_EQ(os::kv_sector_marker, flash.words[0]);
+    ASSERT_EQ((test_sector_words - 2) * sizeof(uint32_t), store.get_free_bytes());
+}
+
+TEST_F(KVStoreTest, test_missing_key_reads_nothing) {
+    uint32_t value = 0;
+    ASSERT_EQ(0u, store.read(1, &value, sizeof(value)));
+}
+
+TEST_F(KVStoreTest, test_write_then_read) {
+    const char text[] = "hello";
+    ASSERT_TRUE(store.write(7, text, sizeof(text)));
+
+    char stored[8] = {};
+    ASSERT_EQ(sizeof(text), store.read(7, stored, sizeof(stored)));
+    ASSERT_STREQ(text, stored);
+}
+
+TEST_F(KVStoreTest, test_read_is_cut_to_the_buffer) {
+    write_word(1, 0x44332211);
+    uint8_t stored[2] = {};
+    ASSERT_EQ(4u, store.read(1, stored, sizeof(stored)));
+    ASSERT_EQ(0x11, stored[0]);
+    ASSERT_EQ(0x22, stored[1]);
+}
+
+TEST_F(KVStoreTest, test_latest_write_wins) {
+    write_word(1, 10);
+    write_word(1, 20);
+    ASSERT_EQ(20u, read_word(store, 1));
+    ASSERT_EQ(1u, store.get_key_count());
+}
+
+TEST_F(KVStoreTest, test_rewriting_the_same_value_programs_nothing) {
+    write_word(1, 10);
+    size_t programs = flash.program_count;
+    ASSERT_TRUE(write_word(1, 10));
+    ASSERT_EQ(programs, flash.program_count);
+}
+
+TEST_F(KVStoreTest, test_invalid_writes_are_refused) {
+    uint8_t large[os::kv_max_value_size + 1] = {};
+    ASSERT_FALSE(store.write(1, large, 0));
+    ASSERT_FALSE(store.write(1, large, sizeof(large)));
+    ASSERT_FALSE(store.write(os::kv_erased_key, large, 1));
+}
+
+TEST_F(KVStoreTest, test_key_limit) {
+    for ( uint16_t key = 0; key < test_max_keys; key++ ) {
+        ASSERT_TRUE(write_word(key, key));
+    }
+    ASSERT_FALSE(write_word(test_max_keys, 0));
+    ASSERT_TRUE(write_word(0, 100));
+}
+
+TEST_F(KVStoreTest, test_remove) {
+    write_word(1, 10);
+    write_word(2, 20);
+    ASSERT_TRUE(store.remove(1));
+    ASSERT_TRUE(store.remove(3));
+
+    uint32_t value = 0;
+    ASSERT_EQ(0u, store.read(1, &value, sizeof(value)));
+    ASSERT_EQ(20u, read_word(store, 2));
+    ASSERT_EQ(1u, store.get_key_count());
+}
+
+TEST_F(KVStoreTest, test_values_survive_a_remount) {
+    write_word(1, 10);
+    write_word(2, 20);
+    write_word(1, 30);
+    store.remove(2);
+
+    store_type remounted(flash);
+    ASSERT_TRUE(remounted.mount());
+    ASSERT_EQ(1u, remounted.get_key_count());
+    ASSERT_EQ(30u, read_word(remounted, 1));
+    ASSERT_EQ(store.get_free_bytes(), remounted.get_free_bytes());
+}
+
+TEST_F(KVStoreTest, test_full_sector_compacts_into_the_other) {
+    /* each word value takes three words of log, so the ten that fit fill the 30 free words */
+    for ( uint32_t value = 0; value < 10; value++ ) {
+        ASSERT_TRUE(write_word(1, value));
+    }
+    write_word(2, 200);
+    ASSERT_EQ(2u, store.get_generation());
+    ASSERT_EQ(1, flash.erase_counts[1]);
+    ASSERT_EQ(9u, read_word(store, 1));
+    ASSERT_EQ(200u, read_word(store, 2));
+
+    /* the compacted sector holds just the latest values */
+    ASSERT_EQ((test_sector_words - 2 - 6) * sizeof(uint32_t), store.get_free_bytes());
+
+    store_type remounted(flash);
+    ASSERT_TRUE(remounted.mount());
+    ASSERT_EQ(2u, remounted.get_generation());
+    ASSERT_EQ(9u, read_word(remounted, 1));
+    ASSERT_EQ(200u, read_word(remounted, 2));
+}
+
+TEST_F(KVStoreTest, test_sectors_take_turns) {
+    for ( uint32_t value = 0; value < 40; value++ ) {
+        ASSERT_TRUE(write_word(1, value));
+    }
+    ASSERT_EQ(39u, read_word(store, 1));
+    ASSERT_GT(flash.erase_counts[0], 1);
+    ASSERT_GT(flash.erase_counts[1], 1);
+    ASSERT_LE(std::abs(flash.erase_counts[0] - flash.erase_counts[1]), 1);
+}
+
+TEST_F(KVStoreTest, test_write_that_can_never_fit_is_refused) {
+    uint8_t large[(test_sector_words - 3) * sizeof(uint32_t)] = {};
+    ASSERT_FALSE(store.write(1, large, sizeof(large)));
+    ASSERT_EQ(0u, store.get_key_count());
+}
+
+TEST_F(KVStoreTest, test_cut_off_write_is_skipped) {
+    write_word(1, 10);
+    flash.program_limit = flash.program_count + 2;
+    ASSERT_FALSE(write_word(1, 20));
+
+    store_type remounted(flash);
+    ASSERT_TRUE(remounted.mount());
+    ASSERT_EQ(10u, read_word(remounted, 1));
+
+    /* the cut off entry's space is skipped rather than written over */
+    flash.program_limit = SIZE_MAX;
+    uint32_t value = 30;
+    ASSERT_TRUE(remounted.write(1, &value, sizeof(value)));
+    store_type again(flash);
+    ASSERT_TRUE(again.mount());
+    ASSERT_EQ(30u, read_word(again, 1));
+}
+
+TEST_F(KVStoreTest, test_cut_off_compaction_keeps_the_old_sector) {
+    for ( uint32_t value = 0; value < 10; value++ ) {
+        write_word(1, value);
+    }
+
+    /* fail while copying, before the new sector's header is written */
+    flash.program_limit = flash.program_count + 2;
+    ASSERT_FALSE(write_word(2, 200));
+
+    store_type remounted(flash);
+    ASSERT_TRUE(remounted.mount());
+    ASSERT_EQ(1u, remounted.get_generation());
+    ASSERT_EQ(9u, read_word(remounted, 1));
+}
+
+TEST_F(KVStoreTest, test_cut_off_compaction_keeps_the_rewritten_key) {
+    /* rewriting key 1 compacts, which programs key 2's copy, the new entry, then the two header words */
+    constexpr size_t compaction_programs = 8;
+    for ( size_t cut_off = 0; cut_off <= compaction_programs; cut_off++ ) {
+        MockFlashSectors sectors;
+        store_type target(sectors);
+        ASSERT_TRUE(target.mount());
+        uint32_t value = 200;
+        target.write(2, &value, sizeof(value));
+        for ( value = 0; value < 9; value++ ) {
+            target.write(1, &value, sizeof(value));
+        }
+
+        sectors.program_limit = sectors.program_count + cut_off;
+        value = 100;
+        ASSERT_EQ(cut_off == compaction_programs, target.write(1, &value, sizeof(value)));
+
+        /* until the header is committed the old sector, with the old value, is the one that counts */
+        store_type remounted(sectors);
+        ASSERT_TRUE(remounted.mount());
+        ASSERT_EQ((cut_off == compaction_programs) ? 100u : 8u, read_word(remounted, 1));
+        ASSERT_EQ(200u, read_word(remounted, 2));
+    }
+}
@@ -0,0 +1,170 @@
+/*! \file log_tests.cpp
+*
+*  \brief Unit tests for the deferred log records and the lock-free log queue.
+*
+*
+*  \author Graham Riches
+*/
+
+/********************************** Includes *******************************************/
+#include "gtest/gtest.h"
+#include "log_impl.h"
+#include <cstring>
+#include <string>
+
+
+/*********************************** Consts ********************************************/
+constexpr size_t test_queue_size = 4;
+
+/************************************ Helpers ********************************************/
+template <typename... Args>
+static std::string format(const char* message, Args... args) {
+    char buffer[128];
+    auto record = os::log_record::make(os::log_level::info, 0, message, args...);
+    size_t length = record.format_message(buffer, sizeof(buffer));
+    return std::string(buffer, length);
+}
+
+/************************************ Test Fixtures ********************************************/
+class LogQueueTest : public ::testing::Test {
+  protected:
+    os::log_queue_impl<test_queue_size> queue;
+};
+
+/************************************ Tests ********************************************/
+TEST(LogRecordTest, test_record_stores_the_call_site_details) {
+    static const char* message = "count %d";
+    auto record = os::log_record::make(os::log_level::warning, 1234, message, 7);
+    ASSERT_EQ(message, record.format);
+    ASSERT_EQ(1234u, record.timestamp);
+    ASSERT_EQ(os::log_level::warning, record.level);
+    ASSERT_EQ(1u, record.argument_count);
+}
+
+TEST(LogRecordTest, test_format_integers) {
+    ASSERT_EQ("a=-5 b=7 c=ff d=00FF", format("a=%d b=%u c=%x d=%04X", -5, 7u, 255, 255u));
+}
+
+TEST(LogRecordTest, test_format_ignores_length_modifiers) {
+    ASSERT_EQ("1 2 3", format("%lu %ld %hhu", static_cast<uint32_t>(1), static_cast<int32_t>(2), static_cast<uint8_t>(3)));
+}
+
+TEST(LogRecordTest, test_format_64_bit_integers) {
+    ASSERT_EQ("-4294967296 18446744073709551615", format("%lld %llu", static_cast<int64_t>(-4294967296), UINT64_MAX));
+}
+
+TEST(LogRecordTest, test_format_floats_and_characters) {
+    ASSERT_EQ("1.50 2.250 x", format("%.2f %.3f %c", 1.5f, 2.25, 'x'));
+}
+
+TEST(LogRecordTest, test_format_strings_with_widths) {
+    ASSERT_EQ("   id|left  |", format("%5s|%-6s|", "id", "left"));
+}
+
+TEST(LogRecordTest, test_format_percent_literal) {
+    ASSERT_EQ("50%", format("%d%%", 50));
+}
+
+TEST(LogRecordTest, test_missing_and_mismatched_arguments_are_marked) {
+    ASSERT_EQ("1 <?>", format("%d %d", 1));
+    ASSERT_EQ("<?>", format("%s", 1));
+}
+
+TEST(LogRecordTest, test_format_truncates_to_the_buffer) {
+    char buffer[8];
+    auto record = os::log_record::make(os::log_level::info, 0, "value %d", 123456);
+    size_t length = record.format_message(buffer, sizeof(buffer));
+    ASSERT_EQ(7u, length);
+    ASSERT_STREQ("value 1", buffer);
+}
+
+TEST_F(LogQueueTest, test_records_pop_in_order) {
+    queue.push(os::log_record::make(os::log_level::info, 1, "one"));
+    queue.push(os::log_record::make(os::log_level::info, 2, "two"));
+
+    os::log_record record;
+    ASSERT_TRUE(queue.pop(record));
+    ASSERT_EQ(1u, record.timestamp);
+    ASSERT_TRUE(queue.pop(record));
+    ASSERT_EQ(2u, record.timestamp);
+    ASSERT_FALSE(queue.pop(record));
+}
+
+TEST_F(LogQueueTest, test_full_queue_drops_and_counts_records) {
+    for ( size_t count = 0; count < test_queue_size; count++ ) {
+        ASSERT_TRUE(queue.push(os::log_record::make(os::log_level::info, count, "fill")));
+    }
+    ASSERT_FALSE(queue.push(os::log_record::make(os::log_level::info, 0, "dropped")));
+    ASSERT_FALSE(queue.push(os::log_record::make(os::log_level::info, 0, "dropped")));
+    ASSERT_EQ(2u, queue.take_dropped_count());
+    ASSERT_EQ(0u, queue.take_dropped_count());
+}
+
+TEST_F(LogQueueTest, test_queue_reuses_slots_after_wrapping) {
+    os::log_record record;
+    for ( uint64_t count = 0; count < (test_queue_size * 3); count++ ) {
+        ASSERT_TRUE(queue.push(os::log_record::make(os::log_level::info, count, "wrap")));
+        ASSERT_TRUE(queue.pop(record));
+        ASSERT_EQ(count, record.timestamp);
+    }
+}
+
+TEST(LogFilterTest, test_every_module_starts_enabled) {
+    os::log_filter filter;
+    ASSERT_TRUE(filter.is_enabled(0));
+    ASSERT_TRUE(filter.is_enabled(os::log_filter::max_modules - 1));
+    ASSERT_FALSE(filter.is_enabled(os::log_filter::max_modules));
+}
+
+TEST(LogFilterTest, test_modules_are_enabled_independently) {
+    os::log_filter filter;
+    filter.set_enabled(3, false);
+    ASSERT_FALSE(filter.is_enabled(3));
+    ASSERT_TRUE(filter.is_enabled(2));
+    filter.set_enabled(3, true);
+    ASSERT_TRUE(filter.is_enabled(3));
+}
+
+TEST(LogFilterTest, test_set_mask_replaces_every_module) {
+    os::log_filter filter;
+    filter.set_mask(0x05);
+    ASSERT_TRUE(filter.is_enabled(0));
+    ASSERT_FALSE(filter.is_enabled(1));
+    ASSERT_TRUE(filter.is_enabled(2));
+    ASSERT_EQ(0x05u, filter.get_mask());
+}
+
+TEST(LogFilterTest, test_levels_below_the_minimum_are_not_compiled_in) {
+    ASSERT_EQ(OS_LOG_LEVEL <= 0, os::is_log_level_compiled_in(os::log_level::debug));
+    ASSERT_TRUE(os::is_log_level_compiled_in(os::log_level::error) || (OS_LOG_LEVEL > 3));
+}
+
+TEST(RamLogTest, test_unmarked_memory_is_reset_on_attach) {
+    os::ram_log_impl<16> ram_log;
+    std::memset(static_cast<void*>(&ram_log), 0xA5, sizeof(ram_log));
+    ASSERT_FALSE(ram_log.attach());
+    ASSERT_EQ(0u, ram_log.get_size());
+}
+
+TEST(RamLogTest, test_contents_are_kept_across_attach) {
+    os::ram_log_impl<16> ram_log;
+    ram_log.clear();
+    ram_log.write("crash", 5);
+    ASSERT_TRUE(ram_log.attach());
+
+    char buffer[16];
+    ASSERT_EQ(5u, ram_log.read(buffer, sizeof(buffer)));
+    ASSERT_EQ("crash", std::string(buffer, 5));
+}
+
+TEST(RamLogTest, test_newest_text_is_kept_when_full) {
+    os::ram_log_impl<8> ram_log;
+    ram_log.clear();
+    ram_log.write("0123456789", 10);
+
+    char buffer[8];
+    ASSERT_EQ(8u, ram_log.read(buffer, sizeof(buffer)));
+    ASSERT_EQ("23456789", std::string(buffer, 8));
+    ASSERT_EQ(4u, ram_log.read(buffer, 4));
+    ASSERT_EQ("6789", std::string(buffer, 4));
+}
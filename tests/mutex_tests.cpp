@@ -0,0 +1,234 @@
+/**
+ * \file mutex_tests.cpp
+ * \author Graham Riches (graham.riches@live.com)
+ * \brief unit tests for the OS priority inheritance mutex
+ * \version 0.1
+ * \date 2021-05-10
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+
+/********************************** Includes *******************************************/
+#include "gtest/gtest.h"
+#include "thread_impl.h"
+#include "system_clock_impl.h"
+#include "scheduler_impl.h"
+#include "mutex_impl.h"
+#include "common.h"
+#include <memory>
+
+
+/*********************************** Consts ********************************************/
+constexpr uint16_t thread_stack_size = 512;
+constexpr uint8_t thread_count = 3;
+constexpr uint8_t low_priority = 1;
+constexpr uint8_t medium_priority = 2;
+constexpr uint8_t high_priority = 3;
+
+/************************************ Local Variables ********************************************/
+static bool pending_irq;
+
+/************************************ Local Functions ********************************************/
+/**
+ * \brief test setting a fake pending IRQ in a c-style callback so that the API to the PendSV handler
+ *        is somewhat tested
+*/
+static void set_pending_irq(){
+    pending_irq = true;
+}
+
+/**
+ * \brief function to check if an interrupt is already pending
+ * \return returns true if a request is already pending
+*/
+static bool is_pending_irq(){
+    return pending_irq;
+}
+
+/************************************ Test Fixtures ********************************************/
+/**
+* \brief test fixture class for the mutex. The high and medium priority threads start out sleeping so the
+*        low priority thread is active and can take the mutex first.
+*/
+class mutex_tests : public ::testing::Test {
+protected:
+    static void thread_task(void *arguments){ PARAMETER_NOT_USED(arguments); };
+
+    void SetUp(void) override {
+        internal_thread = create_thread(0xFFFF, internal_stack, 0);
+        scheduler = std::make_unique<os::scheduler_impl>(&clock, thread_count, set_pending_irq, is_pending_irq);
+        scheduler->set_internal_task(internal_thread.get());
+        clock.start();
+
+        low_thread = create_thread(1, low_stack, low_priority);
+        medium_thread = create_thread(2, medium_stack, medium_priority);
+        high_thread = create_thread(3, high_stack, high_priority);
+        scheduler->register_thread(low_thread.get());
+        scheduler->register_thread(medium_thread.get());
+        scheduler->register_thread(high_thread.get());
+        scheduler->start();
+
+        //!< high wakes up at tick 100 and medium at tick 50
+        scheduler->sleep_thread(100);
+        scheduler->sleep_thread(50);
+        pending_irq = false;
+
+        mutex = std::make_unique<os::mutex_impl>(scheduler.get());
+    }
+
+public:
+    uint32_t internal_stack[thread_stack_size] = {0};
+    uint32_t low_stack[thread_stack_size] = {0};
+    uint32_t medium_stack[thread_stack_size] = {0};
+    uint32_t high_stack[thread_stack_size] = {0};
+    std::unique_ptr<os::thread> internal_thread;
+    std::unique_ptr<os::thread> low_thread;
+    std::unique_ptr<os::thread> medium_thread;
+    std::unique_ptr<os::thread> high_thread;
+    std::unique_ptr<os::scheduler_impl> scheduler;
+    std::unique_ptr<os::mutex_impl> mutex;
+    os::system_clock_impl clock;
+
+    std::unique_ptr<os::thread> create_thread(uint32_t thread_id, uint32_t *stack_ptr, uint8_t priority) {
+        return std::make_unique<os::thread>(reinterpret_cast<os::thread::task_pointer>(&thread_task), nullptr, thread_id, stack_ptr, thread_stack_size, priority);
+    }
+
+    os::thread* active_thread(void) {
+        return scheduler->get_active_tcb_ptr()->thread_ptr;
+    }
+
+    os::scheduler_impl::TaskControlBlock* tcb_of(os::thread* thread) {
+        return scheduler->get_task_by_id(thread->get_id()).value();
+    }
+
+    //!< wake both sleeping threads, which lets the high priority thread preempt
+    void wake_sleeping_threads(void) {
+        pending_irq = false;
+        clock.update(100);
+        scheduler->run();
+    }
+};
+
+/************************************ Unit Tests ********************************************/
+TEST_F(mutex_tests, test_uncontended_lock_takes_ownership_without_switching) {
+    ASSERT_EQ(low_thread.get(), active_thread());
+    mutex->lock();
+    ASSERT_EQ(tcb_of(low_thread.get()), mutex->get_owner());
+    ASSERT_EQ(1, tcb_of(low_thread.get())->details->held_mutex_count);
+    ASSERT_EQ(low_thread.get(), active_thread());
+    ASSERT_FALSE(pending_irq);
+}
+
+TEST_F(mutex_tests, test_uncontended_unlock_takes_the_fast_path) {
+    mutex->lock();
+    ASSERT_TRUE(mutex->try_unlock());
+    ASSERT_EQ(nullptr, mutex->get_owner());
+    ASSERT_EQ(0, tcb_of(low_thread.get())->details->held_mutex_count);
+}
+
+TEST_F(mutex_tests, test_try_lock_fails_when_owned_by_another_thread) {
+    mutex->lock();
+    wake_sleeping_threads();
+    ASSERT_EQ(high_thread.get(), active_thread());
+    ASSERT_FALSE(mutex->try_lock());
+    ASSERT_FALSE(mutex->has_waiting_threads());
+}
+
+TEST_F(mutex_tests, test_unlock_by_a_thread_that_is_not_the_owner_fails) {
+    mutex->lock();
+    wake_sleeping_threads();
+    ASSERT_FALSE(mutex->unlock());
+    ASSERT_EQ(tcb_of(low_thread.get()), mutex->get_owner());
+}
+
+TEST_F(mutex_tests, test_contended_lock_blocks_and_lends_priority_to_the_owner) {
+    mutex->lock();
+    wake_sleeping_threads();
+
+    /* the high priority thread blocks, and the boosted owner runs ahead of the medium priority thread */
+    mutex->lock();
+    ASSERT_EQ(os::thread::status::suspended, high_thread->get_status());
+    ASSERT_TRUE(mutex->has_waiting_threads());
+    ASSERT_EQ(high_priority, tcb_of(low_thread.get())->priority);
+    ASSERT_EQ(low_thread.get(), active_thread());
+}
+
+TEST_F(mutex_tests, test_contended_unlock_hands_over_and_restores_priority) {
+    mutex->lock();
+    wake_sleeping_threads();
+    mutex->lock();
+
+    pending_irq = false;
+    ASSERT_FALSE(mutex->try_unlock());
+    ASSERT_TRUE(mutex->unlock());
+    ASSERT_EQ(low_priority, tcb_of(low_thread.get())->priority);
+    ASSERT_EQ(tcb_of(high_thread.get()), mutex->get_owner());
+    ASSERT_EQ(high_thread.get(), active_thread());
+    ASSERT_FALSE(mutex->has_waiting_threads());
+    ASSERT_TRUE(pending_irq);
+
+    /* the new owner has nobody waiting so it can release on the fast path */
+    ASSERT_TRUE(mutex->try_unlock());
+    ASSERT_EQ(nullptr, mutex->get_owner());
+}
+
+TEST_F(mutex_tests, test_inherited_priority_is_kept_until_the_last_mutex_is_released) {
+    os::mutex_impl other_mutex(scheduler.get());
+    other_mutex.lock();
+    mutex->lock();
+    wake_sleeping_threads();
+    mutex->lock();
+
+    /* releasing the contended mutex while still holding another keeps the boost, so the new owner is
+       only an equal priority peer and doesn't preempt */
+    ASSERT_TRUE(mutex->unlock());
+    ASSERT_EQ(high_priority, tcb_of(low_thread.get())->priority);
+    ASSERT_EQ(low_thread.get(), active_thread());
+
+    /* the last release has to drop the boost through the slow path, which lets the new owner preempt */
+    ASSERT_FALSE(other_mutex.try_unlock());
+    pending_irq = false;
+    ASSERT_TRUE(other_mutex.unlock());
+    ASSERT_EQ(low_priority, tcb_of(low_thread.get())->priority);
+    ASSERT_EQ(high_thread.get(), active_thread());
+    ASSERT_TRUE(pending_irq);
+}
+
+TEST_F(mutex_tests, test_lent_priority_follows_a_chain_of_blocked_owners) {
+    os::mutex_impl other_mutex(scheduler.get());
+    mutex->lock();
+
+    /* the medium priority thread wakes first, takes the other mutex then blocks behind the low priority owner */
+    pending_irq = false;
+    clock.update(50);
+    scheduler->run();
+    ASSERT_EQ(medium_thread.get(), active_thread());
+    other_mutex.lock();
+    mutex->lock();
+    ASSERT_EQ(medium_priority, tcb_of(low_thread.get())->priority);
+    ASSERT_EQ(low_thread.get(), active_thread());
+
+    /* the high priority thread blocks on the other mutex, and its priority reaches the low priority thread too */
+    pending_irq = false;
+    clock.update(50);
+    scheduler->run();
+    ASSERT_EQ(high_thread.get(), active_thread());
+    other_mutex.lock();
+    ASSERT_EQ(high_priority, tcb_of(medium_thread.get())->priority);
+    ASSERT_EQ(high_priority, tcb_of(low_thread.get())->priority);
+    ASSERT_EQ(low_thread.get(), active_thread());
+
+    /* each release hands over down the chain and gives back the lent priority */
+    ASSERT_TRUE(mutex->unlock());
+    ASSERT_EQ(low_priority, tcb_of(low_thread.get())->priority);
+    ASSERT_EQ(medium_thread.get(), active_thread());
+    ASSERT_EQ(nullptr, tcb_of(medium_thread.get())->details->blocked_on);
+    ASSERT_TRUE(mutex->unlock());
+    ASSERT_EQ(high_priority, tcb_of(medium_thread.get())->priority);
+    ASSERT_TRUE(other_mutex.unlock());
+    ASSERT_EQ(medium_priority, tcb_of(medium_thread.get())->priority);
+    ASSERT_EQ(tcb_of(high_thread.get()), other_mutex.get_owner());
+    ASSERT_EQ(high_thread.get(), active_thread());
+}
@@ -0,0 +1,187 @@
+/*! \file os_benchmarks.cpp
+*
+*  \brief Host benchmarks for the scheduler, ring buffer and semaphore primitives.
+*
+*  Run with --benchmark_out=<file> --benchmark_out_format=json to keep the results, or build the
+*  run-benchmarks target which writes them to benchmark_results.json in the build directory.
+*
+*  \author Graham Riches
+*/
+
+/********************************** Includes *******************************************/
+#include "benchmark/benchmark.h"
+#include "thread_impl.h"
+#include "system_clock_impl.h"
+#include "scheduler_impl.h"
+#include "semaphore_impl.h"
+#include "ring_buffer.h"
+#include "common.h"
+#include <memory>
+#include <vector>
+
+
+/*********************************** Consts ********************************************/
+constexpr uint16_t thread_stack_size = 128;
+constexpr uint32_t long_sleep_ticks = 0x10000000;  //!< far enough out that sleepers never wake during a run
+constexpr size_t ring_buffer_size = 1024;
+
+/************************************ Local Functions ********************************************/
+/**
+ * \brief the benchmarks never run the PendSV handler, so a context switch is never left pending
+*/
+static void set_pending_irq(){ }
+
+/**
+ * \brief context switches complete immediately on the host
+ * \return always false
+*/
+static bool is_pending_irq(){
+    return false;
+}
+
+static void thread_task(void *arguments){ PARAMETER_NOT_USED(arguments); }
+
+/************************************ Fixtures ********************************************/
+/**
+ * \brief a scheduler with a set of equal priority threads registered and started
+ */
+class scheduler_fixture {
+  public:
+    explicit scheduler_fixture(uint8_t thread_count)
+        : scheduler(&clock, thread_count, set_pending_irq, is_pending_irq)
+        , stacks(thread_count + 1, std::vector<uint32_t>(thread_stack_size)) {
+        internal_thread = make_thread(0xFFFF, stacks[thread_count].data(), 0);
+        scheduler.set_internal_task(internal_thread.get());
+        clock.start();
+
+        for ( uint8_t index = 0; index < thread_count; index++ ) {
+            threads.push_back(make_thread(index + 1, stacks[index].data(), 1));
+            scheduler.register_thread(threads.back().get());
+        }
+        scheduler.start();
+    }
+
+    /**
+     * \brief put some of the threads to sleep with staggered wake times so the delayed list is populated
+     *
+     * \param count number of threads to sleep, must be less than the thread count
+     */
+    void sleep_threads(uint8_t count) {
+        for ( uint8_t index = 0; index < count; index++ ) {
+            scheduler.sleep_thread(long_sleep_ticks + index);
+        }
+    }
+
+    os::system_clock_impl clock;
+    os::scheduler_impl scheduler;
+
+  private:
+    std::unique_ptr<os::thread> make_thread(uint32_t id, uint32_t* stack, uint8_t priority) {
+        return std::make_unique<os::thread>(reinterpret_cast<os::thread::task_pointer>(&thread_task), nullptr, id, stack,
+                                            thread_stack_size, priority);
+    }
+
+    std::vector<std::vector<uint32_t>> stacks;
+    std::unique_ptr<os::thread> internal_thread;
+    std::vector<std::unique_ptr<os::thread>> threads;
+};
+
+/************************************ Benchmarks ********************************************/
+/**
+ * \brief cost of one tick of the scheduler, including the round-robin switch every time slice
+ *
+ * \param range(0) registered threads
+ * \param range(1) how many of them are asleep
+ */
+static void BM_scheduler_run(benchmark::State& state) {
+    scheduler_fixture fixture(static_cast<uint8_t>(state.range(0)));
+    fixture.sleep_threads(static_cast<uint8_t>(state.range(1)));
+
+    for ( auto _ : state ) {
+        fixture.clock.update(1);
+        fixture.scheduler.run();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_scheduler_run)
+    ->ArgNames({"threads", "sleepers"})
+    ->Args({2, 0})
+    ->Args({8, 0})
+    ->Args({8, 4})
+    ->Args({8, 7})
+    ->Args({32, 0})
+    ->Args({32, 16})
+    ->Args({32, 31});
+
+/**
+ * \brief fill and drain the ring buffer one element at a time
+ */
+static void BM_ring_buffer_byte(benchmark::State& state) {
+    auto buffer = std::make_unique<RingBuffer<uint8_t, ring_buffer_size>>();
+
+    for ( auto _ : state ) {
+        for ( size_t count = 0; count < ring_buffer_size; count++ ) {
+            buffer->push(static_cast<uint8_t>(count));
+        }
+        for ( size_t count = 0; count < ring_buffer_size; count++ ) {
+            benchmark::DoNotOptimize(buffer->pop());
+        }
+    }
+    state.SetBytesProcessed(state.iterations() * ring_buffer_size);
+}
+BENCHMARK(BM_ring_buffer_byte);
+
+/**
+ * \brief move blocks through the ring buffer with the bulk copies. The block size is deliberately not a
+ *        divisor of the capacity so the copies regularly split across the wrap.
+ *
+ * \param range(0) block size in bytes
+ */
+static void BM_ring_buffer_bulk(benchmark::State& state) {
+    auto buffer = std::make_unique<RingBuffer<uint8_t, ring_buffer_size>>();
+    size_t block_size = static_cast<size_t>(state.range(0));
+    std::vector<uint8_t> source(block_size, 0xA5);
+    std::vector<uint8_t> destination(block_size);
+
+    for ( auto _ : state ) {
+        buffer->push_bulk(source.data(), block_size);
+        buffer->pop_bulk(destination.data(), block_size);
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(state.iterations() * block_size);
+}
+BENCHMARK(BM_ring_buffer_bulk)->Arg(1)->Arg(15)->Arg(63)->Arg(255)->Arg(1000);
+
+/**
+ * \brief signal and take a semaphore with nothing waiting on it
+ */
+static void BM_semaphore_uncontended(benchmark::State& state) {
+    scheduler_fixture fixture(1);
+    os::counting_semaphore<uint8_t> semaphore(&fixture.scheduler, 0, 1);
+
+    for ( auto _ : state ) {
+        semaphore.signal();
+        benchmark::DoNotOptimize(semaphore.try_wait());
+    }
+}
+BENCHMARK(BM_semaphore_uncontended);
+
+/**
+ * \brief hand the semaphore back and forth between two threads. Each iteration is one hand-off: the active
+ *        thread wakes the thread blocked on the semaphore and then blocks on it in turn.
+ */
+static void BM_semaphore_round_trip(benchmark::State& state) {
+    scheduler_fixture fixture(2);
+    os::counting_semaphore<uint8_t> semaphore(&fixture.scheduler, 0, 1);
+
+    //!< park the first thread so the loop always has someone to wake
+    semaphore.block();
+    for ( auto _ : state ) {
+        semaphore.signal();
+        if ( !semaphore.try_wait() ) {
+            semaphore.block();
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_semaphore_round_trip);
@@ -0,0 +1,198 @@
+/*! \file queue_tests.cpp
+*
+*  \brief Unit tests for the message and mail queues.
+*
+*
+*  \author Graham Riches
+*/
+
+/********************************** Includes *******************************************/
+#include "gtest/gtest.h"
+#include "thread_impl.h"
+#include "system_clock_impl.h"
+#include "scheduler_impl.h"
+#include "queue_impl.h"
+#include "common.h"
+#include <memory>
+
+
+/*********************************** Consts ********************************************/
+constexpr uint16_t thread_stack_size = 128;
+constexpr uint8_t thread_count = 2;
+constexpr size_t queue_depth = 2;
+
+/************************************ Types ********************************************/
+struct test_record {
+    uint32_t sequence;
+    uint8_t payload[32];
+};
+
+/************************************ Local Variables ********************************************/
+static bool pending_irq;
+
+/************************************ Local Functions ********************************************/
+/**
+ * \brief test setting a fake pending IRQ in a c-style callback so that the API to the PendSV handler
+ *        is somewhat tested
+*/
+static void set_pending_irq(){
+    pending_irq = true;
+}
+
+/**
+ * \brief function to check if an interrupt is already pending
+ * \return returns true if a request is already pending
+*/
+static bool is_pending_irq(){
+    return pending_irq;
+}
+
+/************************************ Test Fixtures ********************************************/
+/**
+ * \brief test class for the queues. This sets up some fake threads and a scheduler to test blocking
+ *        threads on a queue.
+*/
+class QueueTest : public ::testing::Test {
+  protected:
+    static void thread_function(void *arguments){ PARAMETER_NOT_USED(arguments); };
+
+    void SetUp(void) override {
+        internal_thread = create_thread(0xFFFF, internal_stack);
+        thread_one = create_thread(1, thread_one_stack);
+        thread_two = create_thread(2, thread_two_stack);
+        scheduler = std::make_unique<os::scheduler_impl>(&clock, thread_count, set_pending_irq, is_pending_irq);
+        scheduler->set_internal_task(internal_thread.get());
+        scheduler->register_thread(thread_one.get());
+        scheduler->register_thread(thread_two.get());
+        scheduler->start();
+        clock.start();
+        pending_irq = false;
+        queue = std::make_unique<os::queue_impl<uint32_t, queue_depth>>(scheduler.get());
+        mail = std::make_unique<os::mail_queue_impl<test_record, queue_depth>>(scheduler.get());
+    }
+
+    void TearDown(void) override {}
+
+    std::unique_ptr<os::thread> create_thread(uint32_t thread_id, uint32_t *stack_ptr) {
+        return std::make_unique<os::thread>(reinterpret_cast<os::thread::task_pointer>(&thread_function), nullptr, thread_id, stack_ptr, thread_stack_size);
+    }
+
+    uint32_t internal_stack[thread_stack_size] = {0};
+    uint32_t thread_one_stack[thread_stack_size] = {0};
+    uint32_t thread_two_stack[thread_stack_size] = {0};
+    std::unique_ptr<os::queue_impl<uint32_t, queue_depth>> queue;
+    std::unique_ptr<os::mail_queue_impl<test_record, queue_depth>> mail;
+    std::unique_ptr<os::thread> internal_thread;
+    std::unique_ptr<os::thread> thread_one;
+    std::unique_ptr<os::thread> thread_two;
+    std::unique_ptr<os::scheduler_impl> scheduler;
+    os::system_clock_impl clock;
+};
+
+/************************************ Tests ********************************************/
+TEST_F(QueueTest, test_items_are_received_in_order) {
+    ASSERT_TRUE(queue->try_send(1));
+    ASSERT_TRUE(queue->try_send(2));
+    ASSERT_EQ(2u, queue->size());
+    ASSERT_EQ(1u, queue->try_receive().value());
+    ASSERT_EQ(2u, queue->try_receive().value());
+    ASSERT_FALSE(queue->try_receive().has_value());
+}
+
+TEST_F(QueueTest, test_send_to_a_full_queue_fails) {
+    queue->try_send(1);
+    queue->try_send(2);
+    ASSERT_FALSE(queue->try_send(3));
+    ASSERT_EQ(queue_depth, queue->size());
+}
+
+TEST_F(QueueTest, test_receive_from_an_empty_queue_suspends_thread) {
+    auto tcb = scheduler->get_active_tcb_ptr();
+    uint32_t received = 0;
+    queue->block_receive(&received);
+    ASSERT_EQ(os::thread::status::suspended, tcb->thread_ptr->get_status());
+    ASSERT_NE(tcb, scheduler->get_active_tcb_ptr());
+    ASSERT_TRUE(queue->has_waiting_receivers());
+    ASSERT_TRUE(pending_irq);
+}
+
+TEST_F(QueueTest, test_send_hands_the_item_straight_to_a_waiting_receiver) {
+    auto tcb = scheduler->get_active_tcb_ptr();
+    uint32_t received = 0;
+    queue->block_receive(&received);
+
+    ASSERT_TRUE(queue->try_send(42));
+    ASSERT_EQ(42u, received);
+    ASSERT_EQ(0u, queue->size());
+    ASSERT_NE(os::thread::status::suspended, tcb->thread_ptr->get_status());
+    ASSERT_FALSE(queue->has_waiting_receivers());
+    ASSERT_FALSE(tcb->wait_timed_out);
+}
+
+TEST_F(QueueTest, test_receive_moves_a_waiting_senders_item_into_the_queue) {
+    queue->try_send(1);
+    queue->try_send(2);
+    auto tcb = scheduler->get_active_tcb_ptr();
+    uint32_t item = 3;
+    queue->block_send(&item);
+    ASSERT_TRUE(queue->has_waiting_senders());
+
+    ASSERT_EQ(1u, queue->try_receive().value());
+    ASSERT_FALSE(queue->has_waiting_senders());
+    ASSERT_NE(os::thread::status::suspended, tcb->thread_ptr->get_status());
+    ASSERT_EQ(queue_depth, queue->size());
+    ASSERT_EQ(2u, queue->try_receive().value());
+    ASSERT_EQ(3u, queue->try_receive().value());
+}
+
+TEST_F(QueueTest, test_timed_send_expires) {
+    queue->try_send(1);
+    queue->try_send(2);
+    auto tcb = scheduler->get_active_tcb_ptr();
+    uint32_t item = 3;
+    queue->block_send(&item, 5);
+    pending_irq = false;
+    clock.update(5);
+    scheduler->run();
+    ASSERT_TRUE(tcb->wait_timed_out);
+    ASSERT_FALSE(queue->has_waiting_senders());
+    ASSERT_EQ(queue_depth, queue->size());
+}
+
+TEST_F(QueueTest, test_mail_records_are_passed_by_pointer) {
+    auto record = mail->allocate();
+    ASSERT_NE(nullptr, record);
+    record->sequence = 7;
+    mail->send(record);
+    ASSERT_EQ(1u, mail->size());
+
+    auto received = mail->try_receive();
+    ASSERT_EQ(record, received);
+    ASSERT_EQ(7u, received->sequence);
+    ASSERT_EQ(queue_depth - 1, mail->get_free_count());
+    mail->free(received);
+    ASSERT_EQ(queue_depth, mail->get_free_count());
+}
+
+TEST_F(QueueTest, test_mail_allocate_fails_once_every_record_is_in_use) {
+    ASSERT_NE(nullptr, mail->allocate());
+    ASSERT_NE(nullptr, mail->allocate());
+    ASSERT_EQ(nullptr, mail->allocate());
+}
+
+TEST_F(QueueTest, test_mail_ignores_freeing_a_foreign_record) {
+    test_record foreign;
+    mail->free(&foreign);
+    ASSERT_EQ(queue_depth, mail->get_free_count());
+}
+
+TEST_F(QueueTest, test_mail_send_wakes_a_waiting_receiver) {
+    auto tcb = scheduler->get_active_tcb_ptr();
+    test_record* received = nullptr;
+    mail->block_receive(&received);
+
+    auto record = mail->allocate();
+    mail->send(record);
+    ASSERT_EQ(record, received);
+    ASSERT_NE(os::thread::status::suspended, tcb->thread_ptr->get_status());
+}
@@ -27,7 +27,7 @@ class RingBufferTests : public ::testing::Test {
 
     void TearDown() override {}
     
-    RingBuffer<int> buffer{5};
+    RingBuffer<int, 5> buffer;
 };
 
 
@@ -77,4 +77,67 @@ TEST_F(RingBufferTests, test_flush_buffer) {
     buffer.flush();
     ASSERT_TRUE(buffer.is_empty());
     ASSERT_FALSE(buffer.is_full());
-}
\ No newline at end of file
+}
+TEST_F(RingBufferTests, test_push_bulk_then_pop_bulk_preserves_order) {
+    int values[] = {0, 1, 2};
+    int out[3] = {0};
+    ASSERT_EQ(3u, buffer.push_bulk(values, 3));
+    ASSERT_EQ(3u, buffer.size());
+    ASSERT_EQ(3u, buffer.pop_bulk(out, 3));
+    ASSERT_EQ(0, out[0]);
+    ASSERT_EQ(2, out[2]);
+    ASSERT_TRUE(buffer.is_empty());
+}
+
+TEST_F(RingBufferTests, test_push_bulk_stops_when_full) {
+    int values[] = {0, 1, 2, 3, 4, 5, 6};
+    ASSERT_EQ(5u, buffer.push_bulk(values, 7));
+    ASSERT_TRUE(buffer.is_full());
+    ASSERT_EQ(0u, buffer.push_bulk(values, 1));
+}
+
+TEST_F(RingBufferTests, test_bulk_operations_wrap_around) {
+    int values[] = {0, 1, 2, 3};
+    int out[4] = {0};
+    buffer.push_bulk(values, 3);
+    buffer.pop_bulk(out, 3);
+
+    /* head and tail now sit at index 3, so four elements have to wrap */
+    ASSERT_EQ(4u, buffer.push_bulk(values, 4));
+    ASSERT_EQ(4u, buffer.pop_bulk(out, 5));
+    ASSERT_EQ(0, out[0]);
+    ASSERT_EQ(3, out[3]);
+}
+
+TEST_F(RingBufferTests, test_peek_contiguous_returns_linear_region_up_to_the_end) {
+    int values[] = {0, 1, 2, 3, 4};
+    int out[3] = {0};
+    buffer.push_bulk(values, 5);
+    buffer.pop_bulk(out, 3);
+    buffer.push_bulk(values, 2);
+
+    /* stored data is [3, 4] at the end of storage followed by [0, 1] at the start */
+    auto span = buffer.peek_contiguous();
+    ASSERT_EQ(2u, span.size);
+    ASSERT_EQ(3, span.data[0]);
+    buffer.commit(span.size);
+
+    span = buffer.peek_contiguous();
+    ASSERT_EQ(2u, span.size);
+    ASSERT_EQ(0, span.data[0]);
+    buffer.commit(span.size);
+    ASSERT_TRUE(buffer.is_empty());
+    ASSERT_EQ(0u, buffer.peek_contiguous().size);
+}
+
+TEST_F(RingBufferTests, test_reserve_and_publish_fills_buffer) {
+    auto span = buffer.reserve_contiguous();
+    ASSERT_EQ(5u, span.size);
+    for (size_t i = 0; i < span.size; i++) {
+        span.data[i] = static_cast<int>(i);
+    }
+    buffer.publish(span.size);
+    ASSERT_TRUE(buffer.is_full());
+    ASSERT_EQ(0u, buffer.reserve_contiguous().size);
+    ASSERT_EQ(0, buffer.pop().value());
+}
@@ -0,0 +1,523 @@
+/*! \file scheduler_simulator.h
+*
+*  \brief discrete event simulator that drives the scheduler with synthetic thread workloads on the host.
+*
+*  Time advances in slots, a fixed fraction of a tick. Each slot the simulator delivers any interrupts that are due,
+*  then charges the slot to whichever thread the scheduler has made active. Threads never run any code of their own,
+*  their workload decides when they sleep or block, and the simulator makes those calls on the scheduler for them.
+*  Context switches complete instantly, as the PendSV handler would before the next thread ran.
+*
+*  \author Graham Riches
+*/
+
+#pragma once
+
+/********************************** Includes *******************************************/
+#include "thread_impl.h"
+#include "system_clock_impl.h"
+#include "scheduler_impl.h"
+#include "common.h"
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <deque>
+#include <memory>
+#include <queue>
+#include <random>
+#include <vector>
+
+namespace simulation
+{
+/*********************************** Consts ********************************************/
+constexpr uint16_t thread_stack_size = 64;  //!< the simulated threads never run, the stack only has to hold the canary
+constexpr uint32_t internal_thread_id = 0xFFFF;
+
+/************************************ Types ********************************************/
+/**
+ * \brief what a simulated thread does
+ *    periodic : released every period, runs its job, then sleeps until the next release
+ *    interrupt_driven : blocks until an interrupt arrives, runs a job for each one, arrivals are random (Poisson)
+ *    background : always ready, never blocks, so it soaks up whatever time is left at its priority
+ */
+enum class workload_kind { periodic, interrupt_driven, background };
+
+/**
+ * \brief a synthetic thread workload
+ */
+struct workload {
+    workload_kind kind;
+    uint8_t priority;
+    uint32_t period_ticks;             //!< periodic release period
+    uint32_t phase_ticks;              //!< tick of the first periodic release
+    uint32_t mean_interarrival_slots;  //!< mean time between interrupts for an interrupt driven thread
+    uint32_t execution_slots;          //!< work per job
+    uint32_t execution_jitter_slots;   //!< up to this much extra work per job, uniformly distributed
+    uint32_t deadline_slots;           //!< relative deadline of each job, 0 for the period or none for interrupts
+    uint32_t time_slice;               //!< round-robin quantum, or os::thread::priority_time_slice
+};
+
+/**
+ * \brief settings for one run
+ */
+struct configuration {
+    uint64_t ticks;
+    uint32_t slots_per_tick;
+    uint32_t seed;
+    uint32_t max_pending_interrupts;  //!< interrupts an interrupt driven thread can queue before they are dropped
+};
+
+/**
+ * \brief histogram with exact buckets for small values and 16 buckets per power of two above them, so percentiles
+ *        are within about 6% of the true value without storing each sample
+ */
+class latency_histogram {
+  public:
+    static constexpr uint32_t linear_limit = 64;
+    static constexpr uint8_t sub_bucket_bits = 4;
+    static constexpr uint8_t linear_bits = 6;
+    static constexpr size_t bucket_count = linear_limit + ((32 - linear_bits) << sub_bucket_bits);
+
+    void record(uint64_t value) {
+        uint32_t clamped = static_cast<uint32_t>(std::min<uint64_t>(value, UINT32_MAX));
+        buckets[get_bucket(clamped)]++;
+        samples++;
+        total += clamped;
+        minimum = std::min(minimum, clamped);
+        maximum = std::max(maximum, clamped);
+    }
+
+    void merge(const latency_histogram& other) {
+        for ( size_t index = 0; index < bucket_count; index++ ) {
+            buckets[index] += other.buckets[index];
+        }
+        samples += other.samples;
+        total += other.total;
+        minimum = std::min(minimum, other.minimum);
+        maximum = std::max(maximum, other.maximum);
+    }
+
+    uint64_t get_count(void) const {
+        return samples;
+    }
+
+    uint32_t get_min(void) const {
+        return (samples > 0) ? minimum : 0;
+    }
+
+    uint32_t get_max(void) const {
+        return maximum;
+    }
+
+    double get_mean(void) const {
+        return (samples > 0) ? static_cast<double>(total) / static_cast<double>(samples) : 0.0;
+    }
+
+    /**
+     * \brief get a percentile, as the top of the bucket it falls into
+     *
+     * \param percent from 0 to 100
+     * \retval uint32_t the value, never more than the largest recorded
+     */
+    uint32_t get_percentile(double percent) const {
+        if ( samples == 0 ) {
+            return 0;
+        }
+
+        uint64_t rank = static_cast<uint64_t>((percent / 100.0) * static_cast<double>(samples - 1)) + 1;
+        uint64_t seen = 0;
+        for ( size_t index = 0; index < bucket_count; index++ ) {
+            seen += buckets[index];
+            if ( seen >= rank ) {
+                return std::min(get_bucket_top(index), maximum);
+            }
+        }
+        return maximum;
+    }
+
+  private:
+    static size_t get_bucket(uint32_t value) {
+        if ( value < linear_limit ) {
+            return value;
+        }
+        uint8_t top_bit = static_cast<uint8_t>(31 - __builtin_clz(value));
+        uint32_t sub_bucket = (value >> (top_bit - sub_bucket_bits)) & ((1u << sub_bucket_bits) - 1);
+        return linear_limit + ((top_bit - linear_bits) << sub_bucket_bits) + sub_bucket;
+    }
+
+    static uint32_t get_bucket_top(size_t bucket) {
+        if ( bucket < linear_limit ) {
+            return static_cast<uint32_t>(bucket);
+        }
+        size_t offset = bucket - linear_limit;
+        uint8_t top_bit = static_cast<uint8_t>((offset >> sub_bucket_bits) + linear_bits);
+        uint64_t sub_bucket = offset & ((1u << sub_bucket_bits) - 1);
+        uint64_t width = 1ull << (top_bit - sub_bucket_bits);
+        return static_cast<uint32_t>(std::min<uint64_t>((1ull << top_bit) + ((sub_bucket + 1) * width) - 1, UINT32_MAX));
+    }
+
+    std::array<uint64_t, bucket_count> buckets{};
+    uint64_t samples = 0;
+    uint64_t total = 0;
+    uint32_t minimum = UINT32_MAX;
+    uint32_t maximum = 0;
+};
+
+/**
+ * \brief what happened to one thread over a run. Latency is from a job's release to the first slot it runs, and
+ *        response from the release to the end of its last slot.
+ */
+struct thread_result {
+    uint32_t id;
+    workload load;
+    uint64_t jobs_released;
+    uint64_t jobs_completed;
+    uint64_t deadline_misses;
+    uint64_t dropped_interrupts;
+    uint64_t cpu_slots;
+    uint64_t max_response_slots;
+    uint64_t context_switches;
+    latency_histogram latency;
+};
+
+/**
+ * \brief what happened over a run
+ */
+struct simulation_result {
+    uint64_t slots;
+    uint64_t idle_slots;
+    uint64_t context_switches;
+    uint64_t deadline_misses;
+    uint64_t dropped_interrupts;
+    latency_histogram latency;  //!< every job of every thread
+    std::vector<thread_result> threads;
+};
+
+/**
+ * \brief the simulator. Build it with the workloads, then run it once.
+ */
+class scheduler_simulator {
+  public:
+    /**
+     * \brief set up the scheduler and a thread for each workload
+     *
+     * \param loads the thread workloads, up to MAX_THREAD_COUNT of them
+     * \param config the run settings
+     */
+    scheduler_simulator(const std::vector<workload>& loads, const configuration& config)
+        : config(config)
+        , random(config.seed)
+        , scheduler(&clock, static_cast<uint8_t>(loads.size()), set_pending_irq, is_pending_irq)
+        , internal_stack(thread_stack_size) {
+        assert(loads.size() <= MAX_THREAD_COUNT);
+        internal_thread = std::make_unique<os::thread>(reinterpret_cast<os::thread::task_pointer>(&thread_task), nullptr, internal_thread_id,
+                                                       internal_stack.data(), thread_stack_size, 0);
+        scheduler.set_internal_task(internal_thread.get());
+
+        threads.reserve(loads.size());
+        for ( const auto& load : loads ) {
+            auto state = std::make_unique<thread_state>();
+            uint32_t id = static_cast<uint32_t>(threads.size() + 1);
+            state->load = load;
+            state->stack.resize(thread_stack_size);
+            state->thread = std::make_unique<os::thread>(reinterpret_cast<os::thread::task_pointer>(&thread_task), nullptr, id,
+                                                         state->stack.data(), thread_stack_size, load.priority, load.time_slice);
+            state->next_release_tick = load.phase_ticks;
+            state->result.id = id;
+            state->result.load = load;
+            if ( load.kind == workload_kind::interrupt_driven ) {
+                arrivals.push({draw_interarrival(load), static_cast<uint32_t>(threads.size())});
+            }
+            threads.push_back(std::move(state));
+        }
+    }
+
+    /**
+     * \brief register every thread and run the scheduler for the configured number of ticks
+     *
+     * \retval simulation_result the results
+     */
+    simulation_result run(void) {
+        simulation_result result{};
+        for ( auto& state : threads ) {
+            if ( !scheduler.register_thread(state->thread.get()) ) {
+                break;
+            }
+        }
+        clock.start();
+        scheduler.start();
+
+        for ( uint64_t tick = 0; tick < config.ticks; tick++ ) {
+            if ( tick > 0 ) {
+                clock.update(1);
+                scheduler.run();
+            }
+
+            for ( uint32_t slot = 0; slot < config.slots_per_tick; slot++ ) {
+                uint64_t now = (tick * config.slots_per_tick) + slot;
+                deliver_interrupts(now);
+                if ( !execute(now) ) {
+                    result.idle_slots++;
+                }
+            }
+        }
+
+        result.slots = config.ticks * config.slots_per_tick;
+        for ( auto& state : threads ) {
+            auto stats = scheduler.get_thread_stats(state->result.id);
+            state->result.context_switches = stats ? stats->switched_in_count : 0;
+            result.context_switches += state->result.context_switches;
+            result.deadline_misses += state->result.deadline_misses;
+            result.dropped_interrupts += state->result.dropped_interrupts;
+            result.latency.merge(state->result.latency);
+            result.threads.push_back(state->result);
+        }
+        return result;
+    }
+
+  private:
+    /**
+     * \brief a simulated thread and where it is in its workload
+     */
+    struct thread_state {
+        workload load;
+        std::vector<uint32_t> stack;
+        std::unique_ptr<os::thread> thread;
+        os::scheduler_impl::TaskList wait_list{};  //!< an interrupt driven thread blocks here until an arrival
+        bool blocked = false;
+        std::deque<uint64_t> pending_interrupts;   //!< arrival slots of interrupts not yet handled
+        bool in_job = false;
+        bool started = false;
+        uint64_t release_slot = 0;
+        uint64_t remaining_slots = 0;
+        uint64_t next_release_tick = 0;
+        thread_result result{};
+    };
+
+    /**
+     * \brief a scheduled interrupt arrival, ordered soonest first
+     */
+    struct arrival {
+        uint64_t slot;
+        uint32_t thread_index;
+
+        bool operator>(const arrival& other) const {
+            return (slot > other.slot) || ((slot == other.slot) && (thread_index > other.thread_index));
+        }
+    };
+
+    /* context switches complete straight away, so one is never left pending */
+    static void set_pending_irq(void) { }
+
+    static bool is_pending_irq(void) {
+        return false;
+    }
+
+    static void thread_task(void* arguments) {
+        PARAMETER_NOT_USED(arguments);
+    }
+
+    /**
+     * \brief queue each interrupt that is due with its thread, waking the thread if it is blocked waiting for one
+     */
+    void deliver_interrupts(uint64_t now) {
+        while ( !arrivals.empty() && (arrivals.top().slot <= now) ) {
+            auto next = arrivals.top();
+            arrivals.pop();
+            auto& state = *threads[next.thread_index];
+            arrivals.push({now + draw_interarrival(state.load), next.thread_index});
+
+            if ( state.pending_interrupts.size() >= config.max_pending_interrupts ) {
+                state.result.dropped_interrupts++;
+                continue;
+            }
+            state.pending_interrupts.push_back(now);
+            if ( state.blocked ) {
+                state.blocked = false;
+                scheduler.wake_waiting_task(&state.wait_list);
+            }
+        }
+    }
+
+    /**
+     * \brief charge one slot to the active thread. A thread that has finished its job first moves on to the next one,
+     *        or sleeps or blocks until it is released, which takes no time.
+     *
+     * \param now the slot
+     * \retval true if a thread ran, false if the slot was idle
+     */
+    bool execute(uint64_t now) {
+        thread_state* state = nullptr;
+        while ( true ) {
+            state = get_active_state();
+            if ( state == nullptr ) {
+                return false;
+            }
+            if ( state->in_job || start_job(*state, now) ) {
+                break;
+            }
+        }
+
+        if ( !state->started ) {
+            state->started = true;
+            if ( state->load.kind != workload_kind::background ) {
+                state->result.latency.record(now - state->release_slot);
+            }
+        }
+
+        state->result.cpu_slots++;
+        if ( --state->remaining_slots == 0 ) {
+            complete_job(*state, now + 1);
+        }
+        return true;
+    }
+
+    /**
+     * \brief release the active thread's next job if it is due, otherwise sleep or block it until it is
+     *
+     * \param state the active thread
+     * \param now the slot
+     * \retval true if a job was released, false if the thread gave up the CPU
+     */
+    bool start_job(thread_state& state, uint64_t now) {
+        switch ( state.load.kind ) {
+            case workload_kind::periodic: {
+                uint64_t current_tick = now / config.slots_per_tick;
+                if ( state.next_release_tick > current_tick ) {
+                    scheduler.sleep_thread(static_cast<uint32_t>(state.next_release_tick - current_tick));
+                    return false;
+                }
+                release_job(state, state.next_release_tick * config.slots_per_tick);
+                state.next_release_tick += state.load.period_ticks;
+                return true;
+            }
+
+            case workload_kind::interrupt_driven:
+                if ( state.pending_interrupts.empty() ) {
+                    state.blocked = true;
+                    scheduler.block_active_task(&state.wait_list);
+                    return false;
+                }
+                release_job(state, state.pending_interrupts.front());
+                state.pending_interrupts.pop_front();
+                return true;
+
+            default:
+                release_job(state, now);
+                state.remaining_slots = UINT64_MAX;
+                return true;
+        }
+    }
+
+    void release_job(thread_state& state, uint64_t release_slot) {
+        uint32_t jitter = 0;
+        if ( state.load.execution_jitter_slots > 0 ) {
+            jitter = std::uniform_int_distribution<uint32_t>(0, state.load.execution_jitter_slots)(random);
+        }
+        state.in_job = true;
+        state.started = false;
+        state.release_slot = release_slot;
+        state.remaining_slots = std::max<uint64_t>(1, state.load.execution_slots + jitter);
+        state.result.jobs_released++;
+    }
+
+    void complete_job(thread_state& state, uint64_t end_slot) {
+        uint64_t response = end_slot - state.release_slot;
+        state.in_job = false;
+        state.result.jobs_completed++;
+        state.result.max_response_slots = std::max(state.result.max_response_slots, response);
+
+        uint64_t deadline = state.load.deadline_slots;
+        if ( (deadline == 0) && (state.load.kind == workload_kind::periodic) ) {
+            deadline = static_cast<uint64_t>(state.load.period_ticks) * config.slots_per_tick;
+        }
+        if ( (deadline > 0) && (response > deadline) ) {
+            state.result.deadline_misses++;
+        }
+    }
+
+    thread_state* get_active_state(void) {
+        auto tcb = scheduler.get_active_tcb_ptr();
+        uint32_t id = tcb->id;
+        return ((id == internal_thread_id) || (id == 0) || (id > threads.size())) ? nullptr : threads[id - 1].get();
+    }
+
+    uint64_t draw_interarrival(const workload& load) {
+        double mean = static_cast<double>(std::max<uint32_t>(load.mean_interarrival_slots, 1));
+        double gap = std::exponential_distribution<double>(1.0 / mean)(random);
+        return std::max<uint64_t>(1, static_cast<uint64_t>(gap + 0.5));
+    }
+
+    configuration config;
+    std::mt19937 random;
+    os::system_clock_impl clock;
+    os::scheduler_impl scheduler;
+    std::vector<uint32_t> internal_stack;
+    std::unique_ptr<os::thread> internal_thread;
+    std::vector<std::unique_ptr<thread_state>> threads;
+    std::priority_queue<arrival, std::vector<arrival>, std::greater<arrival>> arrivals;
+};
+
+/****************************** Functions Definition ***********************************/
+/**
+ * \brief make a random mix of periodic and interrupt driven threads with a total CPU utilization. Periodic threads
+ *        get rate monotonic priorities, shorter periods higher, and the interrupt driven threads sit above them all.
+ *
+ * \param count number of threads
+ * \param utilization fraction of the CPU the threads use between them, on average
+ * \param interrupt_share fraction of the threads that are interrupt driven
+ * \param slots_per_tick slots in each tick of the run the workloads are for
+ * \param seed random seed
+ * \retval std::vector<workload> the workloads
+ */
+inline std::vector<workload> generate_workloads(size_t count, double utilization, double interrupt_share, uint32_t slots_per_tick, uint32_t seed) {
+    static constexpr std::array<uint32_t, 10> periods = {1, 2, 5, 10, 20, 50, 100, 200, 500, 1000};
+    constexpr uint8_t interrupt_priority_levels = 4;
+    constexpr uint8_t top_priority = os::thread::priority_levels - 1;
+    constexpr uint8_t periodic_top_priority = top_priority - interrupt_priority_levels;
+
+    std::mt19937 random(seed);
+    std::uniform_int_distribution<size_t> pick_period(0, periods.size() - 1);
+    std::uniform_int_distribution<uint32_t> pick_interrupt_priority(0, interrupt_priority_levels - 1);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    double share = utilization / static_cast<double>(std::max<size_t>(count, 1));
+
+    /* a thread whose share of a short period rounds down to nothing gets a longer period, so the small shares of a
+       large thread count still add up to the utilization asked for */
+    auto pick_fitting_period = [&](double thread_share) {
+        size_t index = pick_period(random);
+        while ( ((index + 1) < periods.size()) && ((thread_share * periods[index] * slots_per_tick) < 1.0) ) {
+            index++;
+        }
+        return index;
+    };
+
+    std::vector<workload> loads;
+    for ( size_t index = 0; index < count; index++ ) {
+        workload load{};
+        load.time_slice = os::thread::priority_time_slice;
+
+        /* each thread gets somewhere between none and twice the average share of the CPU */
+        double thread_share = share * 2.0 * unit(random);
+        if ( unit(random) < interrupt_share ) {
+            load.kind = workload_kind::interrupt_driven;
+            load.priority = static_cast<uint8_t>(top_priority - pick_interrupt_priority(random));
+            load.mean_interarrival_slots = periods[pick_fitting_period(thread_share)] * slots_per_tick;
+            load.execution_slots = static_cast<uint32_t>(std::lround(thread_share * load.mean_interarrival_slots));
+            load.deadline_slots = load.mean_interarrival_slots;
+        } else {
+            size_t period_index = pick_fitting_period(thread_share);
+            load.kind = workload_kind::periodic;
+            load.priority = static_cast<uint8_t>(periodic_top_priority - (period_index * periodic_top_priority) / periods.size());
+            load.period_ticks = periods[period_index];
+            load.phase_ticks = std::uniform_int_distribution<uint32_t>(0, load.period_ticks - 1)(random);
+            load.execution_slots = static_cast<uint32_t>(std::lround(thread_share * load.period_ticks * slots_per_tick));
+        }
+        load.execution_slots = std::max<uint32_t>(load.execution_slots, 1);
+        load.execution_jitter_slots = load.execution_slots / 4;
+        loads.push_back(load);
+    }
+    return loads;
+}
+
+};  // namespace simulation
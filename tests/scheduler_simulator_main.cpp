@@ -0,0 +1,163 @@
+/*! \file scheduler_simulator_main.cpp
+*
+*  \brief command line front end for the scheduler simulator. Generates a random workload, runs it and prints the
+*         scheduling latency distribution and deadline misses by priority.
+*
+*  Options, all optional:
+*    --threads N          threads to simulate, up to MAX_THREAD_COUNT (default 200)
+*    --ticks N            ticks to run for (default 1000000)
+*    --utilization F      total CPU utilization of the workload (default 0.7)
+*    --interrupts F       fraction of the threads that are interrupt driven (default 0.25)
+*    --slots-per-tick N   time resolution within a tick (default 10)
+*    --seed N             random seed, the same seed gives the same run (default 1)
+*    --background         add a background thread that never blocks at the lowest priority
+*    --threads-report     print a line for every thread as well
+*
+*  \author Graham Riches
+*/
+
+/********************************** Includes *******************************************/
+#include "scheduler_simulator.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+
+/*********************************** Consts ********************************************/
+constexpr uint32_t max_pending_interrupts = 16;
+
+/************************************ Types ********************************************/
+/**
+ * \brief command line options
+ */
+struct options {
+    size_t threads = 200;
+    uint64_t ticks = 1000000;
+    double utilization = 0.7;
+    double interrupt_share = 0.25;
+    uint32_t slots_per_tick = 10;
+    uint32_t seed = 1;
+    bool background = false;
+    bool threads_report = false;
+};
+
+/************************************ Local Functions ********************************************/
+/**
+ * \brief parse the command line
+ *
+ * \retval bool false if an option wasn't recognized or was missing its value
+ */
+static bool parse_options(int argc, char** argv, options& parsed) {
+    for ( int index = 1; index < argc; index++ ) {
+        std::string option = argv[index];
+        bool has_value = (index + 1) < argc;
+        if ( option == "--background" ) {
+            parsed.background = true;
+        } else if ( option == "--threads-report" ) {
+            parsed.threads_report = true;
+        } else if ( !has_value ) {
+            return false;
+        } else if ( option == "--threads" ) {
+            parsed.threads = std::strtoul(argv[++index], nullptr, 10);
+        } else if ( option == "--ticks" ) {
+            parsed.ticks = std::strtoull(argv[++index], nullptr, 10);
+        } else if ( option == "--utilization" ) {
+            parsed.utilization = std::strtod(argv[++index], nullptr);
+        } else if ( option == "--interrupts" ) {
+            parsed.interrupt_share = std::strtod(argv[++index], nullptr);
+        } else if ( option == "--slots-per-tick" ) {
+            parsed.slots_per_tick = static_cast<uint32_t>(std::strtoul(argv[++index], nullptr, 10));
+        } else if ( option == "--seed" ) {
+            parsed.seed = static_cast<uint32_t>(std::strtoul(argv[++index], nullptr, 10));
+        } else {
+            return false;
+        }
+    }
+    return (parsed.slots_per_tick > 0) && (parsed.threads > 0);
+}
+
+static void print_distribution(const char* label, const simulation::latency_histogram& latency, uint64_t misses) {
+    std::printf("%-12s %10llu %8.1f %7u %7u %7u %8u %8u %10llu\n", label, static_cast<unsigned long long>(latency.get_count()),
+                latency.get_mean(), latency.get_percentile(50), latency.get_percentile(90), latency.get_percentile(99),
+                latency.get_percentile(99.9), latency.get_max(), static_cast<unsigned long long>(misses));
+}
+
+static const char* get_kind_name(simulation::workload_kind kind) {
+    switch ( kind ) {
+        case simulation::workload_kind::periodic:
+            return "periodic";
+
+        case simulation::workload_kind::interrupt_driven:
+            return "interrupt";
+
+        default:
+            return "background";
+    }
+}
+
+/************************************ Main ********************************************/
+int main(int argc, char** argv) {
+    options parsed;
+    if ( !parse_options(argc, argv, parsed) ) {
+        std::fprintf(stderr, "usage: %s [--threads N] [--ticks N] [--utilization F] [--interrupts F] [--slots-per-tick N] [--seed N] "
+                             "[--background] [--threads-report]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    size_t workload_threads = parsed.background ? parsed.threads - 1 : parsed.threads;
+    auto loads = simulation::generate_workloads(workload_threads, parsed.utilization, parsed.interrupt_share, parsed.slots_per_tick, parsed.seed);
+    if ( parsed.background ) {
+        simulation::workload background{};
+        background.kind = simulation::workload_kind::background;
+        background.time_slice = os::thread::priority_time_slice;
+        loads.push_back(background);
+    }
+    if ( loads.size() > MAX_THREAD_COUNT ) {
+        std::fprintf(stderr, "at most %d threads can be simulated\n", MAX_THREAD_COUNT);
+        return EXIT_FAILURE;
+    }
+
+    simulation::configuration config{parsed.ticks, parsed.slots_per_tick, parsed.seed, max_pending_interrupts};
+    simulation::scheduler_simulator simulator(loads, config);
+    auto start = std::chrono::steady_clock::now();
+    auto result = simulator.run();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::printf("%zu threads, %llu ticks of %u slots, seed %u\n", loads.size(), static_cast<unsigned long long>(parsed.ticks),
+                parsed.slots_per_tick, parsed.seed);
+    std::printf("simulated in %.2f s, %.1f M ticks/s\n", seconds, (static_cast<double>(parsed.ticks) / seconds) / 1e6);
+    std::printf("cpu busy %.1f%%, %llu context switches, %llu dropped interrupts\n\n",
+                100.0 * static_cast<double>(result.slots - result.idle_slots) / static_cast<double>(result.slots),
+                static_cast<unsigned long long>(result.context_switches), static_cast<unsigned long long>(result.dropped_interrupts));
+
+    /* latency is in slots, from release to the first slot the job runs */
+    std::printf("%-12s %10s %8s %7s %7s %7s %8s %8s %10s\n", "priority", "jobs", "mean", "p50", "p90", "p99", "p99.9", "max", "misses");
+    for ( int priority = os::thread::priority_levels - 1; priority >= 0; priority-- ) {
+        simulation::latency_histogram latency;
+        uint64_t misses = 0;
+        for ( const auto& thread : result.threads ) {
+            if ( (thread.load.priority == priority) && (thread.load.kind != simulation::workload_kind::background) ) {
+                latency.merge(thread.latency);
+                misses += thread.deadline_misses;
+            }
+        }
+        if ( latency.get_count() > 0 ) {
+            print_distribution(std::to_string(priority).c_str(), latency, misses);
+        }
+    }
+    print_distribution("all", result.latency, result.deadline_misses);
+
+    if ( parsed.threads_report ) {
+        std::printf("\n%6s %-10s %8s %10s %10s %8s %12s %10s\n", "id", "kind", "priority", "jobs", "cpu", "misses", "max response", "switches");
+        for ( const auto& thread : result.threads ) {
+            std::printf("%6u %-10s %8u %10llu %9.2f%% %8llu %12llu %10llu\n", thread.id, get_kind_name(thread.load.kind), thread.load.priority,
+                        static_cast<unsigned long long>(thread.jobs_completed),
+                        100.0 * static_cast<double>(thread.cpu_slots) / static_cast<double>(result.slots),
+                        static_cast<unsigned long long>(thread.deadline_misses), static_cast<unsigned long long>(thread.max_response_slots),
+                        static_cast<unsigned long long>(thread.context_switches));
+        }
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,162 @@
+/*! \file scheduler_simulator_tests.cpp
+*
+*  \brief Unit tests for the scheduler simulator, with small workloads whose outcome can be worked out by hand.
+*
+*
+*  \author Graham Riches
+*/
+
+/********************************** Includes *******************************************/
+#include "gtest/gtest.h"
+#include "scheduler_simulator.h"
+
+
+/*********************************** Consts ********************************************/
+constexpr uint32_t slots_per_tick = 10;
+
+/************************************ Local Functions ********************************************/
+static simulation::workload make_periodic(uint8_t priority, uint32_t period_ticks, uint32_t execution_slots) {
+    simulation::workload load{};
+    load.kind = simulation::workload_kind::periodic;
+    load.priority = priority;
+    load.period_ticks = period_ticks;
+    load.execution_slots = execution_slots;
+    load.time_slice = os::thread::priority_time_slice;
+    return load;
+}
+
+static simulation::workload make_interrupt_driven(uint8_t priority, uint32_t mean_interarrival_slots, uint32_t execution_slots) {
+    simulation::workload load{};
+    load.kind = simulation::workload_kind::interrupt_driven;
+    load.priority = priority;
+    load.mean_interarrival_slots = mean_interarrival_slots;
+    load.execution_slots = execution_slots;
+    load.time_slice = os::thread::priority_time_slice;
+    return load;
+}
+
+static simulation::configuration make_configuration(uint64_t ticks, uint32_t seed = 1) {
+    return simulation::configuration{ticks, slots_per_tick, seed, 4};
+}
+
+/************************************ Tests ********************************************/
+TEST(LatencyHistogramTests, small_values_are_exact) {
+    simulation::latency_histogram histogram;
+    for ( uint32_t value = 1; value <= 10; value++ ) {
+        histogram.record(value);
+    }
+    ASSERT_EQ(10u, histogram.get_count());
+    ASSERT_EQ(1u, histogram.get_min());
+    ASSERT_EQ(10u, histogram.get_max());
+    ASSERT_DOUBLE_EQ(5.5, histogram.get_mean());
+    ASSERT_EQ(5u, histogram.get_percentile(50));
+    ASSERT_EQ(10u, histogram.get_percentile(100));
+}
+
+TEST(LatencyHistogramTests, large_values_are_within_a_bucket) {
+    simulation::latency_histogram histogram;
+    histogram.record(1000);
+    histogram.record(100000);
+    uint32_t median = histogram.get_percentile(50);
+    ASSERT_GE(median, 1000u);
+    ASSERT_LE(median, 1000u + (1000u / 16));
+    ASSERT_EQ(100000u, histogram.get_percentile(100));
+}
+
+TEST(LatencyHistogramTests, merge_combines_the_counts) {
+    simulation::latency_histogram first;
+    simulation::latency_histogram second;
+    first.record(2);
+    second.record(4);
+    second.record(6);
+    first.merge(second);
+    ASSERT_EQ(3u, first.get_count());
+    ASSERT_EQ(2u, first.get_min());
+    ASSERT_EQ(6u, first.get_max());
+}
+
+TEST(SchedulerSimulatorTests, lone_periodic_thread_runs_on_release) {
+    simulation::scheduler_simulator simulator({make_periodic(1, 5, 3)}, make_configuration(100));
+    auto result = simulator.run();
+    ASSERT_EQ(1u, result.threads.size());
+    ASSERT_EQ(20u, result.threads[0].jobs_completed);
+    ASSERT_EQ(0u, result.latency.get_max());
+    ASSERT_EQ(0u, result.deadline_misses);
+    ASSERT_EQ(60u, result.threads[0].cpu_slots);
+    ASSERT_EQ(result.slots - 60u, result.idle_slots);
+}
+
+TEST(SchedulerSimulatorTests, lower_priority_waits_for_the_higher_one) {
+    /* both are released together every tick, so the low priority job always waits out the high priority one */
+    simulation::scheduler_simulator simulator({make_periodic(1, 1, 3), make_periodic(2, 1, 4)}, make_configuration(50));
+    auto result = simulator.run();
+    ASSERT_EQ(0u, result.threads[1].latency.get_max());
+    ASSERT_EQ(4u, result.threads[0].latency.get_min());
+    ASSERT_EQ(4u, result.threads[0].latency.get_max());
+    ASSERT_EQ(0u, result.deadline_misses);
+}
+
+TEST(SchedulerSimulatorTests, overload_misses_deadlines) {
+    simulation::scheduler_simulator simulator({make_periodic(1, 1, 6), make_periodic(2, 1, 6)}, make_configuration(50));
+    auto result = simulator.run();
+    ASSERT_EQ(0u, result.threads[1].deadline_misses);
+    ASSERT_GT(result.threads[0].deadline_misses, 0u);
+    ASSERT_EQ(0u, result.idle_slots);
+}
+
+TEST(SchedulerSimulatorTests, interrupts_preempt_within_the_tick) {
+    /* single slot jobs never queue behind each other, so any latency would be waiting on the busy low priority thread */
+    simulation::scheduler_simulator simulator({make_periodic(1, 1, 10), make_interrupt_driven(5, 25, 1)}, make_configuration(1000));
+    auto result = simulator.run();
+    const auto& interrupt_thread = result.threads[1];
+    ASSERT_GT(interrupt_thread.jobs_completed, 0u);
+    ASSERT_EQ(0u, interrupt_thread.latency.get_max());
+    ASSERT_EQ(0u, interrupt_thread.dropped_interrupts);
+}
+
+TEST(SchedulerSimulatorTests, interrupts_dropped_when_the_thread_falls_behind) {
+    /* the arrivals come every few slots but each job takes far longer, so the queue of four overflows */
+    simulation::scheduler_simulator simulator({make_interrupt_driven(5, 2, 20)}, make_configuration(200));
+    auto result = simulator.run();
+    ASSERT_GT(result.dropped_interrupts, 0u);
+    ASSERT_EQ(result.dropped_interrupts, result.threads[0].dropped_interrupts);
+    ASSERT_GT(result.threads[0].latency.get_max(), 20u);
+}
+
+TEST(SchedulerSimulatorTests, background_thread_soaks_up_idle_time) {
+    simulation::workload background{};
+    background.kind = simulation::workload_kind::background;
+    background.time_slice = os::thread::priority_time_slice;
+    simulation::scheduler_simulator simulator({make_periodic(1, 2, 5), background}, make_configuration(100));
+    auto result = simulator.run();
+    ASSERT_EQ(0u, result.idle_slots);
+    ASSERT_EQ(0u, result.threads[0].latency.get_max());
+    ASSERT_EQ(result.slots - result.threads[0].cpu_slots, result.threads[1].cpu_slots);
+}
+
+TEST(SchedulerSimulatorTests, same_seed_gives_the_same_run) {
+    auto loads = simulation::generate_workloads(MAX_THREAD_COUNT, 0.8, 0.5, slots_per_tick, 7);
+    simulation::scheduler_simulator first(loads, make_configuration(2000, 3));
+    simulation::scheduler_simulator second(loads, make_configuration(2000, 3));
+    auto first_result = first.run();
+    auto second_result = second.run();
+    ASSERT_EQ(first_result.idle_slots, second_result.idle_slots);
+    ASSERT_EQ(first_result.context_switches, second_result.context_switches);
+    ASSERT_EQ(first_result.latency.get_count(), second_result.latency.get_count());
+    ASSERT_EQ(first_result.latency.get_percentile(99), second_result.latency.get_percentile(99));
+}
+
+TEST(SchedulerSimulatorTests, generated_workloads_fit_the_priorities) {
+    auto loads = simulation::generate_workloads(100, 0.7, 0.3, slots_per_tick, 11);
+    ASSERT_EQ(100u, loads.size());
+    for ( const auto& load : loads ) {
+        ASSERT_LT(load.priority, os::thread::priority_levels);
+        ASSERT_GT(load.execution_slots, 0u);
+        if ( load.kind == simulation::workload_kind::periodic ) {
+            ASSERT_GT(load.period_ticks, 0u);
+            ASSERT_LT(load.phase_ticks, load.period_ticks);
+        } else {
+            ASSERT_GT(load.mean_interarrival_slots, 0u);
+        }
+    }
+}
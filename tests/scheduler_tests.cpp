@@ -22,6 +22,8 @@ constexpr uint8_t thread_count = 3;
 
 /************************************ Local Variables ********************************************/
 static bool pending_irq;
+static uint32_t fake_cycles;
+static os::thread* overflowed_thread;
 
 /************************************ Local Functions ********************************************/
 /**
@@ -40,6 +42,21 @@ static bool is_pending_irq(){
     return pending_irq;
 }
 
+/**
+ * \brief fake cycle counter for the thread run-time statistics
+ * \return the current fake cycle count
+*/
+static uint32_t get_fake_cycles(){
+    return fake_cycles;
+}
+
+/**
+ * \brief record the thread passed to the stack overflow handler
+*/
+static void record_stack_overflow(os::thread* thread){
+    overflowed_thread = thread;
+}
+
 /************************************ Test Fixtures ********************************************/
 /**
 * \brief test fixture class for testing the scheduler and thread registry components of the OS
@@ -62,8 +79,9 @@ public:
     std::unique_ptr<os::scheduler_impl> scheduler;
     os::system_clock_impl clock;
         
-    std::unique_ptr<os::thread> create_thread(os::thread::task_pointer task_ptr, void *args, uint32_t thread_id, uint32_t *stack_ptr, uint32_t stack_size) {
-        return std::make_unique<os::thread>(task_ptr, args, thread_id, stack_ptr, stack_size);
+    std::unique_ptr<os::thread> create_thread(os::thread::task_pointer task_ptr, void *args, uint32_t thread_id, uint32_t *stack_ptr, uint32_t stack_size, uint8_t priority = os::thread::default_priority,
+                                              uint32_t time_slice = os::thread::priority_time_slice) {
+        return std::make_unique<os::thread>(task_ptr, args, thread_id, stack_ptr, stack_size, priority, time_slice);
     }
 };
 
@@ -76,6 +94,7 @@ class SchedulerTestsWithPreRegisteredThreads : public SchedulerTests {
 protected:
     void SetUp(void) override {
         scheduler = std::make_unique<os::scheduler_impl>(&clock, thread_count, set_pending_irq, is_pending_irq);
+        scheduler->set_priority_time_slice(os::thread::default_priority, 1);  //!< round-robin on every tick
         internal_thread = create_thread(reinterpret_cast<os::thread::task_pointer>(&thread_task), nullptr, 0xFFFF, internal_stack, thread_stack_size);
         thread_one = create_thread(reinterpret_cast<os::thread::task_pointer>(&thread_task), nullptr, 1, stack_one, thread_stack_size);
         thread_two = create_thread(reinterpret_cast<os::thread::task_pointer>(&thread_task), nullptr, 2, stack_two, thread_stack_size);   
@@ -149,6 +168,11 @@ TEST_F(SchedulerTests, test_overfilling_tcb_buffer_fails) {
     ASSERT_FALSE(scheduler->register_thread(thread.get()));
 }
 
+TEST_F(SchedulerTests, test_max_thread_count_is_capped_by_tcb_table) {
+    scheduler = std::make_unique<os::scheduler_impl>(&clock, MAX_THREAD_COUNT + 1, set_pending_irq, is_pending_irq);
+    ASSERT_EQ(MAX_THREAD_COUNT, scheduler->get_max_thread_count());
+}
+
 TEST_F(SchedulerTests, test_thread_sleep_adds_to_tcb_ticks) {
     uint32_t stack[thread_stack_size] = {0};    
     std::unique_ptr<os::thread> thread = create_thread(reinterpret_cast<os::thread::task_pointer>(&thread_task), nullptr, 1, stack, thread_stack_size);
@@ -160,6 +184,31 @@ TEST_F(SchedulerTests, test_thread_sleep_adds_to_tcb_ticks) {
     ASSERT_EQ(100, tcb->suspended_ticks_remaining);
 }
 
+TEST_F(SchedulerTestsWithPreRegisteredThreads, test_task_control_block_mirrors_thread_status_and_id) {
+    auto tcb_one = scheduler->get_task_by_id(1).value();
+    auto tcb_two = scheduler->get_task_by_id(2).value();
+    ASSERT_EQ(1u, tcb_one->id);
+    ASSERT_EQ(2u, tcb_two->id);
+    ASSERT_EQ(os::thread::status::active, tcb_one->status);
+    ASSERT_EQ(os::thread::status::pending, tcb_two->status);
+
+    scheduler->sleep_thread(1);
+    ASSERT_EQ(os::thread::status::sleeping, tcb_one->status);
+    ASSERT_EQ(thread_one->get_status(), tcb_one->status);
+    ASSERT_EQ(os::thread::status::active, tcb_two->status);
+    ASSERT_EQ(thread_two->get_status(), tcb_two->status);
+}
+
+TEST_F(SchedulerTestsWithPreRegisteredThreads, test_task_details_are_separate_per_task) {
+    auto tcb_one = scheduler->get_task_by_id(1).value();
+    auto tcb_two = scheduler->get_task_by_id(2).value();
+    ASSERT_NE(nullptr, tcb_one->details);
+    ASSERT_NE(nullptr, tcb_two->details);
+    ASSERT_NE(tcb_one->details, tcb_two->details);
+    ASSERT_NE(tcb_one->details, scheduler->get_task_by_thread(thread_two.get())->details);
+    ASSERT_EQ(os::thread::default_priority, tcb_two->details->base_priority);
+}
+
 TEST_F(SchedulerTests, test_sleeping_all_threads_sets_internal_thread_active) {
     uint32_t stack[thread_stack_size] = {0};    
     std::unique_ptr<os::thread> thread = create_thread(reinterpret_cast<os::thread::task_pointer>(&thread_task), nullptr, 1, stack, thread_stack_size);
@@ -174,7 +223,8 @@ TEST_F(SchedulerTestsWithPreRegisteredThreads, test_update_from_clock_triggers_c
     clock.update(1);
     scheduler->run();
     ASSERT_TRUE(pending_irq);
-    ASSERT_EQ(os::thread::status::pending, thread_two->get_status());
+    ASSERT_EQ(os::thread::status::active, thread_two->get_status());
+    ASSERT_EQ(os::thread::status::pending, thread_one->get_status());
 }
 
 TEST_F(SchedulerTestsWithPreRegisteredThreads, test_thread_sleep_wakes_up) {
@@ -234,9 +284,522 @@ TEST_F(SchedulerTestsWithPreRegisteredThreads, test_scheduler_doesnt_clobber_pen
 TEST_F(SchedulerTestsWithPreRegisteredThreads, test_handle_clock_rollover_with_suspended_thread) {
     clock.update(0xFFFFFFFF); //!< set the clock to rollover
     scheduler->run();
+    auto sleeping_thread = scheduler->get_active_tcb_ptr()->thread_ptr;
+    scheduler->sleep_thread(1);
+    clock.update(1);
+    scheduler->run();
+    ASSERT_TRUE(pending_irq);
+    ASSERT_EQ(os::thread::status::pending, sleeping_thread->get_status());
+}
+
+TEST_F(SchedulerTests, test_start_selects_highest_priority_thread) {
+    uint32_t stack_low[thread_stack_size] = {0};
+    uint32_t stack_high[thread_stack_size] = {0};
+    auto low = create_thread(reinterpret_cast<os::thread::task_pointer>(&thread_task), nullptr, 1, stack_low, thread_stack_size, 1);
+    auto high = create_thread(reinterpret_cast<os::thread::task_pointer>(&thread_task), nullptr, 2, stack_high, thread_stack_size, 5);
+    scheduler->register_thread(low.get());
+    scheduler->register_thread(high.get());
+    scheduler->start();
+    ASSERT_FALSE(pending_irq);
+    ASSERT_EQ(high.get(), scheduler->get_active_tcb_ptr()->thread_ptr);
+    ASSERT_EQ(os::thread::status::active, high->get_status());
+    ASSERT_EQ(os::thread::status::pending, low->get_status());
+}
+
+TEST_F(SchedulerTests, test_start_with_no_threads_runs_internal_thread) {
+    scheduler->start();
+    ASSERT_EQ(internal_thread.get(), scheduler->get_active_tcb_ptr()->thread_ptr);
+}
+
+TEST_F(SchedulerTests, test_sleep_switches_to_highest_priority_ready_thread) {
+    uint32_t stack_one[thread_stack_size] = {0};
+    uint32_t stack_two[thread_stack_size] = {0};
+    uint32_t stack_three[thread_stack_size] = {0};
+    auto active = create_thread(reinterpret_cast<os::thread::task_pointer>(&thread_task), nullptr, 1, stack_one, thread_stack_size, 3);
+    auto low = create_thread(reinterpret_cast<os::thread::task_pointer>(&thread_task), nullptr, 2, stack_two, thread_stack_size, 1);
+    auto high = create_thread(reinterpret_cast<os::thread::task_pointer>(&thread_task), nullptr, 3, stack_three, thread_stack_size, 2);
+    scheduler->register_thread(active.get());
+    scheduler->register_thread(low.get());
+    scheduler->register_thread(high.get());
+    scheduler->start();
+    scheduler->sleep_thread(10);
+    ASSERT_TRUE(pending_irq);
+    ASSERT_EQ(high.get(), scheduler->get_pending_tcb_ptr()->thread_ptr);
+    ASSERT_EQ(os::thread::status::pending, low->get_status());
+}
+
+TEST_F(SchedulerTests, test_higher_priority_thread_waking_preempts_active_thread) {
+    uint32_t stack_low[thread_stack_size] = {0};
+    uint32_t stack_high[thread_stack_size] = {0};
+    auto low = create_thread(reinterpret_cast<os::thread::task_pointer>(&thread_task), nullptr, 1, stack_low, thread_stack_size, 1);
+    auto high = create_thread(reinterpret_cast<os::thread::task_pointer>(&thread_task), nullptr, 2, stack_high, thread_stack_size, 4);
+    scheduler->register_thread(low.get());
+    scheduler->register_thread(high.get());
+    scheduler->start();
+    scheduler->sleep_thread(2);
+    ASSERT_EQ(low.get(), scheduler->get_active_tcb_ptr()->thread_ptr);
+    pending_irq = false;
+
+    clock.update(1);
+    scheduler->run();
+    ASSERT_FALSE(pending_irq);
+
+    clock.update(1);
+    scheduler->run();
+    ASSERT_TRUE(pending_irq);
+    ASSERT_EQ(high.get(), scheduler->get_active_tcb_ptr()->thread_ptr);
+    ASSERT_EQ(os::thread::status::pending, low->get_status());
+}
+
+TEST_F(SchedulerTests, test_lower_priority_ready_thread_does_not_preempt) {
+    uint32_t stack_low[thread_stack_size] = {0};
+    uint32_t stack_high[thread_stack_size] = {0};
+    auto high = create_thread(reinterpret_cast<os::thread::task_pointer>(&thread_task), nullptr, 1, stack_high, thread_stack_size, 4);
+    auto low = create_thread(reinterpret_cast<os::thread::task_pointer>(&thread_task), nullptr, 2, stack_low, thread_stack_size, 1);
+    scheduler->register_thread(high.get());
+    scheduler->register_thread(low.get());
+    scheduler->start();
+    clock.update(1);
+    scheduler->run();
+    ASSERT_FALSE(pending_irq);
+    ASSERT_EQ(high.get(), scheduler->get_active_tcb_ptr()->thread_ptr);
+}
+
+TEST_F(SchedulerTests, test_sleeping_threads_are_stored_as_deltas) {
+    uint32_t stack_one[thread_stack_size] = {0};
+    uint32_t stack_two[thread_stack_size] = {0};
+    uint32_t stack_three[thread_stack_size] = {0};
+    auto one = create_thread(reinterpret_cast<os::thread::task_pointer>(&thread_task), nullptr, 1, stack_one, thread_stack_size);
+    auto two = create_thread(reinterpret_cast<os::thread::task_pointer>(&thread_task), nullptr, 2, stack_two, thread_stack_size);
+    auto three = create_thread(reinterpret_cast<os::thread::task_pointer>(&thread_task), nullptr, 3, stack_three, thread_stack_size);
+    scheduler->register_thread(one.get());
+    scheduler->register_thread(two.get());
+    scheduler->register_thread(three.get());
+    scheduler->start();
+
+    scheduler->sleep_thread(5);  //!< thread one
+    scheduler->sleep_thread(3);  //!< thread two
+    scheduler->sleep_thread(8);  //!< thread three
+    ASSERT_EQ(internal_thread.get(), scheduler->get_active_tcb_ptr()->thread_ptr);
+
+    ASSERT_EQ(3, scheduler->get_task_by_id(2).value()->suspended_ticks_remaining);
+    ASSERT_EQ(2, scheduler->get_task_by_id(1).value()->suspended_ticks_remaining);
+    ASSERT_EQ(3, scheduler->get_task_by_id(3).value()->suspended_ticks_remaining);
+    ASSERT_EQ(3u, scheduler->get_ticks_until_next_wakeup().value());
+}
+
+TEST_F(SchedulerTests, test_sleeping_threads_wake_in_deadline_order) {
+    uint32_t stack_one[thread_stack_size] = {0};
+    uint32_t stack_two[thread_stack_size] = {0};
+    auto one = create_thread(reinterpret_cast<os::thread::task_pointer>(&thread_task), nullptr, 1, stack_one, thread_stack_size);
+    auto two = create_thread(reinterpret_cast<os::thread::task_pointer>(&thread_task), nullptr, 2, stack_two, thread_stack_size);
+    scheduler->register_thread(one.get());
+    scheduler->register_thread(two.get());
+    scheduler->start();
+    scheduler->sleep_thread(4);  //!< thread one
+    scheduler->sleep_thread(2);  //!< thread two
+    pending_irq = false;
+
+    clock.update(1);
+    scheduler->run();
+    ASSERT_EQ(1u, scheduler->get_ticks_until_next_wakeup().value());
+    ASSERT_EQ(os::thread::status::sleeping, two->get_status());
+
+    clock.update(1);
+    scheduler->run();
+    ASSERT_EQ(os::thread::status::active, two->get_status());
+    ASSERT_EQ(os::thread::status::sleeping, one->get_status());
+    ASSERT_EQ(2u, scheduler->get_ticks_until_next_wakeup().value());
+
+    clock.update(2);
+    scheduler->run();
+    ASSERT_EQ(os::thread::status::pending, one->get_status());
+    ASSERT_FALSE(scheduler->get_ticks_until_next_wakeup().has_value());
+}
+
+TEST_F(SchedulerTests, test_multiple_elapsed_ticks_wake_all_expired_threads) {
+    uint32_t stack_one[thread_stack_size] = {0};
+    uint32_t stack_two[thread_stack_size] = {0};
+    auto one = create_thread(reinterpret_cast<os::thread::task_pointer>(&thread_task), nullptr, 1, stack_one, thread_stack_size);
+    auto two = create_thread(reinterpret_cast<os::thread::task_pointer>(&thread_task), nullptr, 2, stack_two, thread_stack_size);
+    scheduler->register_thread(one.get());
+    scheduler->register_thread(two.get());
+    scheduler->start();
+    scheduler->sleep_thread(3);
+    scheduler->sleep_thread(5);
+
+    clock.update(4);
+    ASSERT_EQ(0u, scheduler->get_ticks_until_next_wakeup().value());
+    scheduler->run();
+    ASSERT_NE(os::thread::status::sleeping, one->get_status());
+    ASSERT_EQ(os::thread::status::sleeping, two->get_status());
+    ASSERT_EQ(1u, scheduler->get_ticks_until_next_wakeup().value());
+}
+
+TEST_F(SchedulerTests, test_equal_priority_threads_round_robin_on_quantum) {
+    uint32_t stack_one[thread_stack_size] = {0};
+    uint32_t stack_two[thread_stack_size] = {0};
+    auto one = create_thread(reinterpret_cast<os::thread::task_pointer>(&thread_task), nullptr, 1, stack_one, thread_stack_size);
+    auto two = create_thread(reinterpret_cast<os::thread::task_pointer>(&thread_task), nullptr, 2, stack_two, thread_stack_size);
+    scheduler->set_priority_time_slice(os::thread::default_priority, 3);
+    scheduler->register_thread(one.get());
+    scheduler->register_thread(two.get());
+    scheduler->start();
+
+    for ( int tick = 0; tick < 2; tick++ ) {
+        clock.update(1);
+        scheduler->run();
+        ASSERT_FALSE(pending_irq);
+        ASSERT_EQ(one.get(), scheduler->get_active_tcb_ptr()->thread_ptr);
+    }
+
+    clock.update(1);
+    scheduler->run();
+    ASSERT_TRUE(pending_irq);
+    ASSERT_EQ(two.get(), scheduler->get_active_tcb_ptr()->thread_ptr);
+    ASSERT_EQ(3u, scheduler->get_active_tcb_ptr()->slice_ticks_remaining);
+    ASSERT_EQ(os::thread::status::pending, one->get_status());
+}
+
+TEST_F(SchedulerTests, test_thread_time_slice_overrides_priority_quantum) {
+    uint32_t stack_one[thread_stack_size] = {0};
+    uint32_t stack_two[thread_stack_size] = {0};
+    auto one = create_thread(reinterpret_cast<os::thread::task_pointer>(&thread_task), nullptr, 1, stack_one, thread_stack_size, os::thread::default_priority, 1);
+    auto two = create_thread(reinterpret_cast<os::thread::task_pointer>(&thread_task), nullptr, 2, stack_two, thread_stack_size);
+    scheduler->register_thread(one.get());
+    scheduler->register_thread(two.get());
+    scheduler->start();
+    ASSERT_EQ(1u, scheduler->get_task_by_id(1).value()->slice_ticks_remaining);
+
+    clock.update(1);
+    scheduler->run();
+    ASSERT_TRUE(pending_irq);
+    ASSERT_EQ(two.get(), scheduler->get_active_tcb_ptr()->thread_ptr);
+    ASSERT_EQ(os::scheduler_impl::default_time_slice, scheduler->get_active_tcb_ptr()->slice_ticks_remaining);
+}
+
+TEST_F(SchedulerTests, test_expired_slice_with_no_peers_reloads) {
+    uint32_t stack_one[thread_stack_size] = {0};
+    auto one = create_thread(reinterpret_cast<os::thread::task_pointer>(&thread_task), nullptr, 1, stack_one, thread_stack_size, os::thread::default_priority, 2);
+    scheduler->register_thread(one.get());
+    scheduler->start();
+
+    clock.update(2);
+    scheduler->run();
+    ASSERT_FALSE(pending_irq);
+    ASSERT_EQ(one.get(), scheduler->get_active_tcb_ptr()->thread_ptr);
+    ASSERT_EQ(2u, scheduler->get_active_tcb_ptr()->slice_ticks_remaining);
+}
+
+TEST_F(SchedulerTests, test_preempted_thread_resumes_before_peers_with_remaining_slice) {
+    uint32_t stack_one[thread_stack_size] = {0};
+    uint32_t stack_two[thread_stack_size] = {0};
+    uint32_t stack_three[thread_stack_size] = {0};
+    auto one = create_thread(reinterpret_cast<os::thread::task_pointer>(&thread_task), nullptr, 1, stack_one, thread_stack_size, 1);
+    auto two = create_thread(reinterpret_cast<os::thread::task_pointer>(&thread_task), nullptr, 2, stack_two, thread_stack_size, 1);
+    auto high = create_thread(reinterpret_cast<os::thread::task_pointer>(&thread_task), nullptr, 3, stack_three, thread_stack_size, 2);
+    scheduler->register_thread(high.get());
+    scheduler->register_thread(one.get());
+    scheduler->register_thread(two.get());
+    scheduler->start();
+
+    /* high priority thread sleeps, then thread one runs for a few ticks before high wakes up again */
+    scheduler->sleep_thread(4);
+    ASSERT_EQ(one.get(), scheduler->get_active_tcb_ptr()->thread_ptr);
+    pending_irq = false;
+    clock.update(4);
+    scheduler->run();
+    ASSERT_TRUE(pending_irq);
+    ASSERT_EQ(high.get(), scheduler->get_active_tcb_ptr()->thread_ptr);
+    ASSERT_EQ(os::scheduler_impl::default_time_slice - 4, scheduler->get_task_by_id(1).value()->slice_ticks_remaining);
+
+    /* thread one should be resumed ahead of thread two when the high priority thread sleeps again */
+    scheduler->sleep_thread(100);
+    ASSERT_EQ(one.get(), scheduler->get_active_tcb_ptr()->thread_ptr);
+    ASSERT_EQ(os::scheduler_impl::default_time_slice - 4, scheduler->get_active_tcb_ptr()->slice_ticks_remaining);
+}
+
+TEST_F(SchedulerTests, test_thread_stats_count_cycles_and_switches) {
+    uint32_t stack_one[thread_stack_size] = {0};
+    uint32_t stack_two[thread_stack_size] = {0};
+    auto one = create_thread(reinterpret_cast<os::thread::task_pointer>(&thread_task), nullptr, 1, stack_one, thread_stack_size);
+    auto two = create_thread(reinterpret_cast<os::thread::task_pointer>(&thread_task), nullptr, 2, stack_two, thread_stack_size);
+    scheduler = std::make_unique<os::scheduler_impl>(&clock, thread_count, set_pending_irq, is_pending_irq, get_fake_cycles);
+    scheduler->set_internal_task(internal_thread.get());
+    scheduler->set_priority_time_slice(os::thread::default_priority, 1);
+    scheduler->register_thread(one.get());
+    scheduler->register_thread(two.get());
+    fake_cycles = 1000;
+    scheduler->start();
+
+    /* thread one is preempted by its round-robin peer after running for 500 cycles */
+    fake_cycles = 1500;
+    clock.update(1);
+    scheduler->run();
+    pending_irq = false;
+
+    /* thread two sleeps after 200 cycles, which yields back to thread one */
+    fake_cycles = 1700;
+    scheduler->sleep_thread(10);
+
+    auto one_stats = scheduler->get_thread_stats(1).value();
+    auto two_stats = scheduler->get_thread_stats(2).value();
+    ASSERT_EQ(500u, one_stats.cycles_run);
+    ASSERT_EQ(2u, one_stats.switched_in_count);
+    ASSERT_EQ(1u, one_stats.preempted_count);
+    ASSERT_EQ(0u, one_stats.yielded_count);
+    ASSERT_EQ(1u, one_stats.last_run_tick);
+    ASSERT_EQ(200u, two_stats.cycles_run);
+    ASSERT_EQ(1u, two_stats.switched_in_count);
+    ASSERT_EQ(0u, two_stats.preempted_count);
+    ASSERT_EQ(1u, two_stats.yielded_count);
+}
+
+TEST_F(SchedulerTests, test_thread_stats_include_running_thread_and_internal_thread) {
+    uint32_t stack_one[thread_stack_size] = {0};
+    auto one = create_thread(reinterpret_cast<os::thread::task_pointer>(&thread_task), nullptr, 1, stack_one, thread_stack_size);
+    scheduler = std::make_unique<os::scheduler_impl>(&clock, thread_count, set_pending_irq, is_pending_irq, get_fake_cycles);
+    scheduler->set_internal_task(internal_thread.get());
+    scheduler->register_thread(one.get());
+    fake_cycles = 0;
+    scheduler->start();
+
+    fake_cycles = 300;
+    ASSERT_EQ(300u, scheduler->get_thread_stats(1).value().cycles_run);
+    scheduler->sleep_thread(5);
+
+    fake_cycles = 1000;
+    auto idle_stats = scheduler->get_thread_stats(0xFFFF).value();
+    ASSERT_EQ(1u, idle_stats.switched_in_count);
+    ASSERT_EQ(700u, idle_stats.cycles_run);
+    ASSERT_EQ(300u, scheduler->get_thread_stats(1).value().cycles_run);
+    ASSERT_FALSE(scheduler->get_thread_stats(42).has_value());
+}
+
+TEST_F(SchedulerTests, test_get_thread_id_by_index) {
+    uint32_t stack_one[thread_stack_size] = {0};
+    auto one = create_thread(reinterpret_cast<os::thread::task_pointer>(&thread_task), nullptr, 7, stack_one, thread_stack_size);
+    scheduler->register_thread(one.get());
+    ASSERT_EQ(7u, scheduler->get_thread_id(0).value());
+    ASSERT_FALSE(scheduler->get_thread_id(1).has_value());
+    ASSERT_EQ(one.get(), scheduler->get_thread(0));
+    ASSERT_EQ(nullptr, scheduler->get_thread(1));
+}
+
+TEST_F(SchedulerTestsWithPreRegisteredThreads, test_context_switch_detects_corrupt_canary) {
+    overflowed_thread = nullptr;
+    scheduler->set_stack_overflow_handler(record_stack_overflow);
+    stack_one[0] = 0;
+    scheduler->sleep_thread(1);
+    ASSERT_EQ(thread_one.get(), overflowed_thread);
+}
+
+TEST_F(SchedulerTestsWithPreRegisteredThreads, test_context_switch_detects_saved_stack_pointer_out_of_bounds) {
+    overflowed_thread = nullptr;
+    scheduler->set_stack_overflow_handler(record_stack_overflow);
+    scheduler->get_task_by_id(2).value()->active_stack_pointer = stack_two;
+    scheduler->sleep_thread(1);
+    ASSERT_EQ(thread_two.get(), overflowed_thread);
+}
+
+TEST_F(SchedulerTestsWithPreRegisteredThreads, test_healthy_stacks_do_not_call_overflow_handler) {
+    overflowed_thread = nullptr;
+    scheduler->set_stack_overflow_handler(record_stack_overflow);
     scheduler->sleep_thread(1);
     clock.update(1);
     scheduler->run();
+    ASSERT_EQ(nullptr, overflowed_thread);
+}
+
+TEST_F(SchedulerTestsWithPreRegisteredThreads, test_exit_switches_away_and_frees_the_task_control_block) {
+    scheduler->exit_thread();
     ASSERT_TRUE(pending_irq);
+    ASSERT_EQ(os::thread::status::exited, thread_one->get_status());
+    ASSERT_EQ(thread_two.get(), scheduler->get_active_tcb_ptr()->thread_ptr);
+    ASSERT_EQ(1, scheduler->get_registered_thread_count());
+    ASSERT_FALSE(scheduler->get_task_by_id(1).has_value());
+    ASSERT_EQ(thread_two.get(), scheduler->get_thread(0));
+    ASSERT_EQ(nullptr, scheduler->get_thread(1));
+    ASSERT_EQ(nullptr, scheduler->get_active_tcb_ptr()->next);
+}
+
+TEST_F(SchedulerTestsWithPreRegisteredThreads, test_exited_task_control_block_is_reused) {
+    uint32_t stack_three[thread_stack_size] = {0};
+    auto thread_three = create_thread(reinterpret_cast<os::thread::task_pointer>(&thread_task), nullptr, 3, stack_three, thread_stack_size);
+    auto freed = scheduler->get_active_tcb_ptr();
+    freed->details->stats.switched_in_count = 10;
+    scheduler->exit_thread();
+
+    ASSERT_TRUE(scheduler->register_thread(thread_three.get()));
+    ASSERT_EQ(freed, scheduler->get_task_by_id(3).value());
+    ASSERT_EQ(0u, freed->details->stats.switched_in_count);
+    ASSERT_EQ(os::thread::status::pending, thread_three->get_status());
+    ASSERT_EQ(3u, scheduler->get_thread_id(0).value());
+    ASSERT_EQ(2u, scheduler->get_thread_id(1).value());
+    ASSERT_EQ(freed, freed->next->next);
+}
+
+TEST_F(SchedulerTestsWithPreRegisteredThreads, test_exiting_every_thread_runs_the_internal_thread) {
+    scheduler->exit_thread();
+    scheduler->exit_thread();
+    ASSERT_EQ(0, scheduler->get_registered_thread_count());
+    ASSERT_EQ(internal_thread.get(), scheduler->get_active_tcb_ptr()->thread_ptr);
+
+    /* the internal thread can't exit */
+    scheduler->exit_thread();
+    ASSERT_EQ(internal_thread.get(), scheduler->get_active_tcb_ptr()->thread_ptr);
+
+    /* a thread registered at run time is made ready rather than taking over as the active task */
+    ASSERT_TRUE(scheduler->register_thread(thread_one.get()));
+    ASSERT_EQ(internal_thread.get(), scheduler->get_active_tcb_ptr()->thread_ptr);
+    pending_irq = false;
+    scheduler->reschedule();
+    ASSERT_TRUE(pending_irq);
+    ASSERT_EQ(thread_one.get(), scheduler->get_active_tcb_ptr()->thread_ptr);
+}
+
+TEST_F(SchedulerTestsWithPreRegisteredThreads, test_join_blocks_until_the_thread_exits) {
+    ASSERT_TRUE(scheduler->join_thread(thread_two.get()));
+    ASSERT_EQ(os::thread::status::suspended, thread_one->get_status());
+    ASSERT_EQ(thread_two.get(), scheduler->get_active_tcb_ptr()->thread_ptr);
+
+    clock.update(100);
+    scheduler->run();
+    ASSERT_EQ(os::thread::status::suspended, thread_one->get_status());
+
+    auto joiner = scheduler->get_task_by_id(1).value();
+    scheduler->exit_thread();
+    ASSERT_EQ(thread_one.get(), scheduler->get_active_tcb_ptr()->thread_ptr);
+    ASSERT_FALSE(joiner->wait_timed_out);
+}
+
+TEST_F(SchedulerTestsWithPreRegisteredThreads, test_join_times_out) {
+    ASSERT_TRUE(scheduler->join_thread(thread_two.get(), 5));
+    auto joiner = scheduler->get_task_by_id(1).value();
+    clock.update(5);
+    scheduler->run();
+    ASSERT_TRUE(joiner->wait_timed_out);
     ASSERT_EQ(os::thread::status::pending, thread_one->get_status());
 }
+
+TEST_F(SchedulerTestsWithPreRegisteredThreads, test_join_refuses_itself_and_unregistered_threads) {
+    uint32_t stack_three[thread_stack_size] = {0};
+    auto thread_three = create_thread(reinterpret_cast<os::thread::task_pointer>(&thread_task), nullptr, 3, stack_three, thread_stack_size);
+    ASSERT_FALSE(scheduler->join_thread(thread_one.get()));
+    ASSERT_FALSE(scheduler->join_thread(thread_three.get()));
+    ASSERT_FALSE(scheduler->join_thread(nullptr));
+    ASSERT_EQ(thread_one.get(), scheduler->get_active_tcb_ptr()->thread_ptr);
+}
+
+TEST_F(SchedulerTests, test_preemption_lock_holds_off_threads_at_or_below_the_threshold) {
+    uint32_t stack_low[thread_stack_size] = {0};
+    uint32_t stack_mid[thread_stack_size] = {0};
+    uint32_t stack_high[thread_stack_size] = {0};
+    auto low = create_thread(reinterpret_cast<os::thread::task_pointer>(&thread_task), nullptr, 1, stack_low, thread_stack_size, 1);
+    auto mid = create_thread(reinterpret_cast<os::thread::task_pointer>(&thread_task), nullptr, 2, stack_mid, thread_stack_size, 3);
+    auto high = create_thread(reinterpret_cast<os::thread::task_pointer>(&thread_task), nullptr, 3, stack_high, thread_stack_size, 5);
+    scheduler->register_thread(mid.get());
+    scheduler->register_thread(high.get());
+    scheduler->register_thread(low.get());
+    scheduler->start();
+    scheduler->sleep_thread(2);
+    scheduler->sleep_thread(1);
+    ASSERT_EQ(low.get(), scheduler->get_active_tcb_ptr()->thread_ptr);
+    pending_irq = false;
+
+    /* the mid priority thread still wakes on time, but has to wait */
+    ASSERT_EQ(0u, scheduler->lock_preemption(3));
+    clock.update(1);
+    scheduler->run();
+    ASSERT_FALSE(pending_irq);
+    ASSERT_EQ(os::thread::status::pending, mid->get_status());
+    ASSERT_EQ(low.get(), scheduler->get_active_tcb_ptr()->thread_ptr);
+
+    /* a thread above the threshold preempts as usual */
+    clock.update(1);
+    scheduler->run();
+    ASSERT_TRUE(pending_irq);
+    ASSERT_EQ(high.get(), scheduler->get_active_tcb_ptr()->thread_ptr);
+    ASSERT_EQ(4u, scheduler->get_task_by_thread(low.get())->preemption_threshold);
+}
+
+TEST_F(SchedulerTests, test_preemption_unlock_runs_the_threads_held_off) {
+    uint32_t stack_low[thread_stack_size] = {0};
+    uint32_t stack_mid[thread_stack_size] = {0};
+    auto low = create_thread(reinterpret_cast<os::thread::task_pointer>(&thread_task), nullptr, 1, stack_low, thread_stack_size, 1);
+    auto mid = create_thread(reinterpret_cast<os::thread::task_pointer>(&thread_task), nullptr, 2, stack_mid, thread_stack_size, 3);
+    scheduler->register_thread(mid.get());
+    scheduler->register_thread(low.get());
+    scheduler->start();
+    scheduler->sleep_thread(1);
+    pending_irq = false;
+
+    uint8_t previous = scheduler->lock_preemption();
+    clock.update(1);
+    scheduler->run();
+    ASSERT_FALSE(pending_irq);
+
+    scheduler->unlock_preemption(previous);
+    ASSERT_TRUE(pending_irq);
+    ASSERT_EQ(mid.get(), scheduler->get_active_tcb_ptr()->thread_ptr);
+    ASSERT_EQ(0u, scheduler->get_task_by_thread(low.get())->preemption_threshold);
+}
+
+TEST_F(SchedulerTests, test_nested_preemption_locks_never_lower_the_threshold) {
+    uint32_t stack_one[thread_stack_size] = {0};
+    auto one = create_thread(reinterpret_cast<os::thread::task_pointer>(&thread_task), nullptr, 1, stack_one, thread_stack_size, 1);
+    scheduler->register_thread(one.get());
+    scheduler->start();
+    auto tcb = scheduler->get_active_tcb_ptr();
+
+    uint8_t outer = scheduler->lock_preemption(6);
+    uint8_t inner = scheduler->lock_preemption(2);
+    ASSERT_EQ(7u, tcb->preemption_threshold);
+    ASSERT_EQ(7u, inner);
+
+    scheduler->unlock_preemption(inner);
+    ASSERT_EQ(7u, tcb->preemption_threshold);
+    scheduler->unlock_preemption(outer);
+    ASSERT_EQ(0u, tcb->preemption_threshold);
+}
+
+TEST_F(SchedulerTests, test_preemption_lock_stops_round_robin) {
+    uint32_t stack_one[thread_stack_size] = {0};
+    uint32_t stack_two[thread_stack_size] = {0};
+    auto one = create_thread(reinterpret_cast<os::thread::task_pointer>(&thread_task), nullptr, 1, stack_one, thread_stack_size);
+    auto two = create_thread(reinterpret_cast<os::thread::task_pointer>(&thread_task), nullptr, 2, stack_two, thread_stack_size);
+    scheduler->set_priority_time_slice(os::thread::default_priority, 1);
+    scheduler->register_thread(one.get());
+    scheduler->register_thread(two.get());
+    scheduler->start();
+
+    scheduler->lock_preemption(os::thread::default_priority);
+    for ( int tick = 0; tick < 3; tick++ ) {
+        clock.update(1);
+        scheduler->run();
+        ASSERT_FALSE(pending_irq);
+        ASSERT_EQ(one.get(), scheduler->get_active_tcb_ptr()->thread_ptr);
+    }
+}
+
+TEST_F(SchedulerTests, test_preemption_lock_follows_the_thread_when_it_blocks) {
+    uint32_t stack_low[thread_stack_size] = {0};
+    uint32_t stack_high[thread_stack_size] = {0};
+    auto high = create_thread(reinterpret_cast<os::thread::task_pointer>(&thread_task), nullptr, 1, stack_high, thread_stack_size, 4);
+    auto low = create_thread(reinterpret_cast<os::thread::task_pointer>(&thread_task), nullptr, 2, stack_low, thread_stack_size, 1);
+    scheduler->register_thread(high.get());
+    scheduler->register_thread(low.get());
+    scheduler->start();
+
+    /* the locked thread sleeps, so the lower priority thread gets to run without being locked itself */
+    scheduler->lock_preemption();
+    scheduler->sleep_thread(1);
+    ASSERT_EQ(low.get(), scheduler->get_active_tcb_ptr()->thread_ptr);
+    ASSERT_EQ(0u, scheduler->get_active_tcb_ptr()->preemption_threshold);
+    pending_irq = false;
+
+    clock.update(1);
+    scheduler->run();
+    ASSERT_EQ(high.get(), scheduler->get_active_tcb_ptr()->thread_ptr);
+    ASSERT_EQ(os::thread::priority_levels, scheduler->get_active_tcb_ptr()->preemption_threshold);
+}
@@ -4,9 +4,9 @@
  * \brief unit tests for the OS semaphore mechanism
  * \version 0.1
  * \date 2021-05-10
- * 
+ *
  * @copyright Copyright (c) 2021
- * 
+ *
  */
 
 
@@ -24,6 +24,8 @@
 /*********************************** Consts ********************************************/
 constexpr uint16_t thread_stack_size = 512;
 constexpr uint8_t thread_count = 3;
+constexpr uint8_t low_priority = 1;
+constexpr uint8_t high_priority = 2;
 
 /************************************ Local Variables ********************************************/
 static bool pending_irq;
@@ -47,35 +49,36 @@ static bool is_pending_irq(){
 
 /************************************ Test Fixtures ********************************************/
 /**
-* \brief test fixture class for testing semaphore mechanism
+* \brief test fixture class for testing semaphore mechanism. Threads one and two share a low priority and thread
+*        three has a higher priority but starts out sleeping, so one of the low priority threads is active.
 */
 class semaphore_tests : public ::testing::Test {
 
 using counting_semaphore = os::counting_semaphore<uint8_t>;
 
 protected:
-    static void thread_task(void *arguments){ PARAMETER_NOT_USED(arguments); };    
+    static void thread_task(void *arguments){ PARAMETER_NOT_USED(arguments); };
 
     void SetUp(void) override {
         //!< setup the scheduler and system clock
-        internal_thread = create_thread(reinterpret_cast<os::thread::task_pointer>(&thread_task), nullptr, 0xFFFF, internal_stack, thread_stack_size);
+        internal_thread = create_thread(reinterpret_cast<os::thread::task_pointer>(&thread_task), nullptr, 0xFFFF, internal_stack, thread_stack_size, 0);
         scheduler = std::make_unique<os::scheduler_impl>(&clock, thread_count, set_pending_irq, is_pending_irq);
         scheduler->set_internal_task(internal_thread.get());
         pending_irq = false;
         clock.start();
 
-        //!< register two threads with the scheduler
-
-        //!< TODO: you are here
-        /*
-            - create simple threading object that takes a semaphore pointer, and has an internal thread + stack etc
-            - add functions to acquire and release the semaphore
-            - create those objects here and use in tests.
-        */
-
-
-        internal_thread = create_thread(reinterpret_cast<os::thread::task_pointer>(&thread_task), nullptr, 1, thread_one_stack, thread_stack_size);
-        internal_thread = create_thread(reinterpret_cast<os::thread::task_pointer>(&thread_task), nullptr, 2, thread_two_stack, thread_stack_size);
+        //!< register the threads with the scheduler
+        thread_one = create_thread(reinterpret_cast<os::thread::task_pointer>(&thread_task), nullptr, 1, thread_one_stack, thread_stack_size, low_priority);
+        thread_two = create_thread(reinterpret_cast<os::thread::task_pointer>(&thread_task), nullptr, 2, thread_two_stack, thread_stack_size, low_priority);
+        thread_three = create_thread(reinterpret_cast<os::thread::task_pointer>(&thread_task), nullptr, 3, thread_three_stack, thread_stack_size, high_priority);
+        scheduler->register_thread(thread_one.get());
+        scheduler->register_thread(thread_two.get());
+        scheduler->register_thread(thread_three.get());
+        scheduler->start();
+
+        //!< park the high priority thread so the low priority threads get to run
+        scheduler->sleep_thread(100);
+        pending_irq = false;
 
         //!< setup the semaphore
         semaphore = std::make_unique<counting_semaphore>(scheduler.get(), 1, 3);
@@ -84,21 +87,133 @@ protected:
 public:
     uint32_t internal_stack[thread_stack_size] = {0};
     uint32_t thread_one_stack[thread_stack_size] = {0};
-    uint32_t thead_two_stack[thread_stack_size] = {0};
+    uint32_t thread_two_stack[thread_stack_size] = {0};
+    uint32_t thread_three_stack[thread_stack_size] = {0};
     std::unique_ptr<os::thread> internal_thread;
-    std::unique_ptr<os::thread> task_thread_one;
-    std::unique_ptr<os::thread> task_thread_two;
+    std::unique_ptr<os::thread> thread_one;
+    std::unique_ptr<os::thread> thread_two;
+    std::unique_ptr<os::thread> thread_three;
     std::unique_ptr<os::scheduler_impl> scheduler;
     std::unique_ptr<counting_semaphore> semaphore;
     os::system_clock_impl clock;
-        
-    std::unique_ptr<os::thread> create_thread(os::thread::task_pointer task_ptr, void *args, uint32_t thread_id, uint32_t *stack_ptr, uint32_t stack_size) {
-        return std::make_unique<os::thread>(task_ptr, args, thread_id, stack_ptr, stack_size);
+
+    std::unique_ptr<os::thread> create_thread(os::thread::task_pointer task_ptr, void *args, uint32_t thread_id, uint32_t *stack_ptr, uint32_t stack_size, uint8_t priority) {
+        return std::make_unique<os::thread>(task_ptr, args, thread_id, stack_ptr, stack_size, priority);
+    }
+
+    os::thread* active_thread(void) {
+        return scheduler->get_active_tcb_ptr()->thread_ptr;
     }
 };
 
 /************************************ Unit Tests ********************************************/
 
 TEST_F(semaphore_tests, test_wait_on_semaphore_with_resource_available_does_not_suspend) {
-    
-}
\ No newline at end of file
+    auto active = active_thread();
+    ASSERT_TRUE(semaphore->try_wait());
+    ASSERT_EQ(0, semaphore->get_count());
+    ASSERT_EQ(active, active_thread());
+    ASSERT_FALSE(pending_irq);
+}
+
+TEST_F(semaphore_tests, test_try_wait_with_no_resource_fails_without_blocking) {
+    semaphore->try_wait();
+    auto active = active_thread();
+    ASSERT_FALSE(semaphore->try_wait());
+    ASSERT_EQ(active, active_thread());
+    ASSERT_FALSE(semaphore->has_waiting_threads());
+}
+
+TEST_F(semaphore_tests, test_blocking_suspends_the_active_thread) {
+    semaphore->try_wait();
+    auto blocked = active_thread();
+    semaphore->block();
+    ASSERT_EQ(os::thread::status::suspended, blocked->get_status());
+    ASSERT_NE(blocked, active_thread());
+    ASSERT_TRUE(semaphore->has_waiting_threads());
+    ASSERT_TRUE(pending_irq);
+}
+
+TEST_F(semaphore_tests, test_signal_hands_the_count_to_a_waiting_thread) {
+    semaphore->try_wait();
+    auto blocked = active_thread();
+    semaphore->block();
+    semaphore->signal();
+    ASSERT_EQ(0, semaphore->get_count());
+    ASSERT_FALSE(semaphore->has_waiting_threads());
+    ASSERT_EQ(os::thread::status::pending, blocked->get_status());
+    ASSERT_FALSE(scheduler->get_active_tcb_ptr()->wait_timed_out);
+}
+
+TEST_F(semaphore_tests, test_signal_with_no_waiters_saturates_at_max_count) {
+    semaphore->signal();
+    semaphore->signal();
+    semaphore->signal();
+    ASSERT_EQ(3, semaphore->get_count());
+}
+
+TEST_F(semaphore_tests, test_signal_wakes_waiters_in_priority_order) {
+    semaphore->try_wait();
+
+    /* both low priority threads block and the scheduler drops to the idle thread */
+    auto first_waiter = active_thread();
+    semaphore->block();
+    auto second_waiter = active_thread();
+    semaphore->block();
+    ASSERT_EQ(internal_thread.get(), active_thread());
+
+    /* wake the high priority thread so it can block behind the low priority waiters */
+    pending_irq = false;
+    clock.update(100);
+    scheduler->run();
+    ASSERT_EQ(thread_three.get(), active_thread());
+    semaphore->block();
+
+    semaphore->signal();
+    ASSERT_EQ(thread_three.get(), active_thread());
+    semaphore->signal();
+    ASSERT_EQ(os::thread::status::pending, first_waiter->get_status());
+    ASSERT_EQ(os::thread::status::suspended, second_waiter->get_status());
+}
+
+TEST_F(semaphore_tests, test_signal_preempts_for_a_higher_priority_waiter) {
+    semaphore->try_wait();
+    clock.update(100);
+    scheduler->run();
+    ASSERT_EQ(thread_three.get(), active_thread());
+    semaphore->block();
+    ASSERT_NE(thread_three.get(), active_thread());
+
+    pending_irq = false;
+    semaphore->signal();
+    ASSERT_EQ(thread_three.get(), active_thread());
+    ASSERT_TRUE(pending_irq);
+}
+
+TEST_F(semaphore_tests, test_timed_wait_expires) {
+    semaphore->try_wait();
+    auto blocked = scheduler->get_active_tcb_ptr();
+    semaphore->block(5);
+
+    clock.update(5);
+    scheduler->run();
+    ASSERT_TRUE(blocked->wait_timed_out);
+    ASSERT_NE(os::thread::status::suspended, blocked->thread_ptr->get_status());
+    ASSERT_FALSE(semaphore->has_waiting_threads());
+
+    /* nobody is waiting anymore so the signal is banked */
+    semaphore->signal();
+    ASSERT_EQ(1, semaphore->get_count());
+}
+
+TEST_F(semaphore_tests, test_signal_before_timeout_cancels_the_timeout) {
+    semaphore->try_wait();
+    auto blocked = scheduler->get_active_tcb_ptr();
+    semaphore->block(5);
+    semaphore->signal();
+    ASSERT_FALSE(blocked->delayed);
+
+    clock.update(10);
+    scheduler->run();
+    ASSERT_FALSE(blocked->wait_timed_out);
+}
@@ -0,0 +1,163 @@
+/**
+ * \file spsc_ring_buffer_tests.cpp
+ * \author Graham Riches (graham.riches@live.com)
+ * \brief unit tests for the single producer single consumer ring buffer
+ * \version 0.1
+ * \date 2021-05-09
+ * 
+ * @copyright Copyright (c) 2021
+ * 
+ */
+
+/********************************** Includes *******************************************/
+#include "gtest/gtest.h"
+#include "spsc_ring_buffer.h"
+#include <thread>
+#include <vector>
+
+
+/*********************************** Consts ********************************************/
+
+/*********************************** Test Fixtures ********************************************/
+/**
+ * \brief test fixture for spsc ring buffer tests
+ */
+class SPSCRingBufferTests : public ::testing::Test {
+    public:
+    void SetUp() override {}
+
+    void TearDown() override {}
+    
+    SPSCRingBuffer<int, 4> buffer;
+};
+
+
+TEST_F(SPSCRingBufferTests, test_initial_construction) {
+    ASSERT_FALSE(buffer.is_full());
+    ASSERT_TRUE(buffer.is_empty());
+    ASSERT_EQ(0u, buffer.size());
+    ASSERT_EQ(4u, buffer.capacity());
+}
+
+TEST_F(SPSCRingBufferTests, test_filling_buffer_returns_full) {
+    std::vector<int> values = {0, 1, 2, 3};
+    for (const auto& val : values) {
+        ASSERT_TRUE(buffer.push(val));
+    }
+
+    ASSERT_TRUE(buffer.is_full());
+    ASSERT_FALSE(buffer.is_empty());
+    ASSERT_FALSE(buffer.push(4));
+
+    for (const auto& val : values) {
+        ASSERT_EQ(val, buffer.pop().value());
+    }
+    ASSERT_TRUE(buffer.is_empty());
+    ASSERT_FALSE(buffer.pop().has_value());
+}
+
+TEST_F(SPSCRingBufferTests, test_wrap_around_keeps_fifo_order) {
+    for (int val = 0; val < 3; val++) {
+        buffer.push(val);
+    }
+    buffer.pop();
+    buffer.pop();
+
+    for (int val = 3; val < 6; val++) {
+        ASSERT_TRUE(buffer.push(val));
+    }
+    ASSERT_TRUE(buffer.is_full());
+
+    for (int val = 2; val < 6; val++) {
+        ASSERT_EQ(val, buffer.pop().value());
+    }
+}
+
+TEST_F(SPSCRingBufferTests, test_flush_buffer) {
+    buffer.push(1);
+    buffer.push(2);
+    buffer.flush();
+    ASSERT_TRUE(buffer.is_empty());
+    ASSERT_TRUE(buffer.push(3));
+    ASSERT_EQ(3, buffer.pop().value());
+}
+
+TEST_F(SPSCRingBufferTests, test_concurrent_producer_and_consumer_preserve_order) {
+    constexpr int sample_count = 100000;
+    SPSCRingBuffer<int, 64> shared;
+
+    std::thread producer([&shared]() {
+        for (int val = 0; val < sample_count;) {
+            if (shared.push(val)) {
+                val++;
+            }
+        }
+    });
+
+    int expected = 0;
+    int out_of_order = 0;
+    while (expected < sample_count) {
+        auto maybe_val = shared.pop();
+        if (maybe_val.has_value()) {
+            out_of_order += (maybe_val.value() != expected) ? 1 : 0;
+            expected++;
+        }
+    }
+    producer.join();
+    ASSERT_EQ(0, out_of_order);
+    ASSERT_TRUE(shared.is_empty());
+}
+
+TEST_F(SPSCRingBufferTests, test_push_bulk_stops_when_full) {
+    int values[] = {0, 1, 2, 3, 4, 5};
+    ASSERT_EQ(4u, buffer.push_bulk(values, 6));
+    ASSERT_TRUE(buffer.is_full());
+    ASSERT_EQ(0u, buffer.push_bulk(values, 1));
+}
+
+TEST_F(SPSCRingBufferTests, test_bulk_operations_wrap_around) {
+    int values[] = {0, 1, 2, 3};
+    int out[4] = {0};
+    buffer.push_bulk(values, 3);
+    ASSERT_EQ(3u, buffer.pop_bulk(out, 3));
+
+    /* indices now start at 3, so four elements have to wrap */
+    ASSERT_EQ(4u, buffer.push_bulk(values, 4));
+    ASSERT_EQ(4u, buffer.pop_bulk(out, 5));
+    ASSERT_EQ(0, out[0]);
+    ASSERT_EQ(3, out[3]);
+    ASSERT_TRUE(buffer.is_empty());
+}
+
+TEST_F(SPSCRingBufferTests, test_peek_contiguous_splits_at_the_wrap) {
+    int values[] = {0, 1, 2, 3};
+    int out[3] = {0};
+    buffer.push_bulk(values, 3);
+    buffer.pop_bulk(out, 3);
+    buffer.push_bulk(values, 3);
+
+    auto span = buffer.peek_contiguous();
+    ASSERT_EQ(1u, span.size);
+    ASSERT_EQ(0, span.data[0]);
+    buffer.commit(span.size);
+
+    span = buffer.peek_contiguous();
+    ASSERT_EQ(2u, span.size);
+    ASSERT_EQ(1, span.data[0]);
+    buffer.commit(span.size);
+    ASSERT_TRUE(buffer.is_empty());
+}
+
+TEST_F(SPSCRingBufferTests, test_reserve_and_publish_exposes_free_space) {
+    buffer.push(7);
+    ASSERT_EQ(7, buffer.pop().value());
+
+    auto span = buffer.reserve_contiguous();
+    ASSERT_EQ(3u, span.size);
+    span.data[0] = 1;
+    span.data[1] = 2;
+    buffer.publish(2);
+    ASSERT_EQ(2u, buffer.size());
+    ASSERT_EQ(1, buffer.pop().value());
+    ASSERT_EQ(2, buffer.pop().value());
+}
@@ -15,6 +15,18 @@
 
 
 /*********************************** Consts ********************************************/
+constexpr uint32_t counts_per_tick = 168000;
+
+/************************************ Local Variables ********************************************/
+static uint32_t sub_tick_counts;
+
+/************************************ Local Functions ********************************************/
+/**
+ * \brief fake sub-tick counter standing in for the SysTick counter
+ */
+static uint32_t get_sub_tick_counts(void) {
+    return sub_tick_counts;
+}
 
 
 /************************************ Test Fixtures ********************************************/
@@ -26,7 +38,7 @@ class SystemClockTests : public ::testing::Test {
     static void thread_task(void *arguments){ PARAMETER_NOT_USED(arguments); };    
 
     void SetUp(void) override {        
-        
+        sub_tick_counts = 0;
     }
 
   public:
@@ -50,3 +62,48 @@ TEST_F(SystemClockTests, test_update_clock_running_passes) {
     clock.update(1);
     ASSERT_EQ(1, clock.get_ticks());
 }
+
+TEST_F(SystemClockTests, test_64_bit_ticks_keep_counting_past_rollover) {
+    clock.start();
+    clock.update(0xFFFFFFFF);
+    clock.update(2);
+    ASSERT_EQ(1u, clock.get_ticks());
+    ASSERT_EQ(0x100000001ull, clock.get_ticks_64());
+}
+
+TEST_F(SystemClockTests, test_microseconds_without_a_sub_tick_counter_have_tick_resolution) {
+    clock.start();
+    clock.update(3);
+    ASSERT_EQ(3u * os::system_clock_impl::microseconds_per_tick, clock.get_microseconds());
+}
+
+TEST_F(SystemClockTests, test_microseconds_interpolate_between_ticks) {
+    clock.set_sub_tick_counter(get_sub_tick_counts, counts_per_tick);
+    clock.start();
+    clock.update(2);
+    sub_tick_counts = counts_per_tick / 4;
+    ASSERT_EQ(2250u, clock.get_microseconds());
+}
+
+TEST_F(SystemClockTests, test_microseconds_include_a_pending_tick) {
+    clock.set_sub_tick_counter(get_sub_tick_counts, counts_per_tick);
+    clock.start();
+    clock.update(1);
+    sub_tick_counts = counts_per_tick - 1;
+    uint64_t before = clock.get_microseconds();
+
+    /* the counter has reloaded but the tick hasn't been counted yet */
+    sub_tick_counts = counts_per_tick + 1;
+    uint64_t pending = clock.get_microseconds();
+    clock.update(1);
+    sub_tick_counts = 1;
+    ASSERT_LE(before, pending);
+    ASSERT_LE(pending, clock.get_microseconds());
+}
+
+TEST_F(SystemClockTests, test_microseconds_continue_past_tick_rollover) {
+    clock.start();
+    clock.update(0xFFFFFFFF);
+    clock.update(1);
+    ASSERT_EQ(0x100000000ull * os::system_clock_impl::microseconds_per_tick, clock.get_microseconds());
+}
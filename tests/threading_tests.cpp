@@ -9,7 +9,9 @@
 /********************************** Includes *******************************************/
 #include "gtest/gtest.h"
 #include "thread_impl.h"
+#include "thread_pool_impl.h"
 #include "common.h"
+#include <cstddef>
 #include <cstdint>
 #include <iostream>
 #include <memory>
@@ -43,6 +45,14 @@ class ThreadingTests : public ::testing::Test {
 
 using ThreadingDeathsTests = ThreadingTests;
 
+/************************************ Local Functions ********************************************/
+/**
+ * \brief exit handler that unwinds back to the test instead of switching away
+*/
+static void throwing_exit_handler(void){
+    throw os::thread::status::exited;
+}
+
 /************************************ Tests ********************************************/
 TEST_F(ThreadingTests, test_thread_is_default_pending) {
     ASSERT_EQ(os::thread::status::pending, thread->get_status());
@@ -64,9 +74,131 @@ TEST_F(ThreadingTests, test_initial_stack_context_is_valid){
     ASSERT_EQ(4, context->r4);
     ASSERT_EQ(5, context->r5);
     ASSERT_EQ(0x01000000, context->psr);
+    ASSERT_EQ(0xFFFFFFFD, context->exc_return);
+    ASSERT_EQ(0u, context->control);
     ASSERT_EQ( static_cast<uint32_t>(reinterpret_cast<std::uintptr_t>(&thread_task)), context->pc);
 }
 
+TEST_F(ThreadingTests, test_initial_context_passes_the_arguments_in_r0){
+    uint32_t work_item = 0;
+    auto worker_stack = std::make_unique<uint32_t[]>(thread_stack_size);
+    auto worker = create_thread(reinterpret_cast<os::thread::task_pointer>(&thread_task), &work_item, 2, worker_stack.get(), thread_stack_size);
+    os::thread::register_context* context = reinterpret_cast<os::thread::register_context*>(worker->get_stack_ptr());
+    ASSERT_EQ(static_cast<uint32_t>(reinterpret_cast<std::uintptr_t>(&work_item)), context->r0);
+}
+
+TEST_F(ThreadingTests, test_unprivileged_thread_starts_with_nPRIV_set){
+    thread->set_privileged(false);
+    os::thread::register_context* context = reinterpret_cast<os::thread::register_context*>(thread->get_stack_ptr());
+    ASSERT_FALSE(thread->is_privileged());
+    ASSERT_EQ(os::thread::control_unprivileged, context->control);
+}
+
+TEST_F(ThreadingTests, test_stack_canary_written_at_bottom_of_stack){
+    ASSERT_EQ(os::thread::stack_canary, thread_stack[0]);
+    ASSERT_FALSE(thread->is_stack_overflowed());
+}
+
+TEST_F(ThreadingTests, test_overwriting_canary_flags_overflow){
+    thread_stack[0] = 0;
+    ASSERT_TRUE(thread->is_stack_overflowed());
+}
+
+TEST_F(ThreadingTests, test_stack_is_painted_below_initial_context){
+    ASSERT_EQ(os::thread::stack_paint_pattern, thread_stack[1]);
+    ASSERT_EQ(os::thread::stack_paint_pattern, thread_stack[thread_stack_size / 2]);
+}
+
+TEST_F(ThreadingTests, test_initial_high_water_mark_is_initial_context){
+    uint32_t context_words = static_cast<uint32_t>((thread_stack.get() + thread_stack_size) - thread->get_stack_ptr());
+    ASSERT_EQ(context_words, thread->get_stack_high_water_mark());
+}
+
+TEST_F(ThreadingTests, test_high_water_mark_tracks_deepest_stack_use){
+    thread_stack[thread_stack_size - 100] = 0;
+    ASSERT_EQ(100u, thread->get_stack_high_water_mark());
+}
+
+TEST_F(ThreadingTests, test_stack_pointer_bounds){
+    ASSERT_TRUE(thread->is_stack_pointer_valid(thread->get_stack_ptr()));
+    ASSERT_TRUE(thread->is_stack_pointer_valid(thread_stack.get() + thread_stack_size));
+    ASSERT_FALSE(thread->is_stack_pointer_valid(thread_stack.get()));
+    ASSERT_FALSE(thread->is_stack_pointer_valid(thread_stack.get() + thread_stack_size + 1));
+}
+
+TEST_F(ThreadingTests, test_stack_guard_is_aligned_above_canary){
+    auto guard = reinterpret_cast<std::uintptr_t>(thread->get_stack_guard());
+    ASSERT_EQ(0u, guard % os::thread::stack_guard_size);
+    ASSERT_GT(guard, reinterpret_cast<std::uintptr_t>(thread_stack.get()));
+    ASSERT_LE(guard, reinterpret_cast<std::uintptr_t>(thread_stack.get() + 1) + os::thread::stack_guard_size - 1);
+}
+
+TEST_F(ThreadingTests, test_task_returns_into_the_exit_trampoline){
+    os::thread::register_context* context = reinterpret_cast<os::thread::register_context*>(thread->get_stack_ptr());
+    ASSERT_EQ(static_cast<uint32_t>(reinterpret_cast<std::uintptr_t>(&os::thread::exit_trampoline)), context->lr);
+}
+
+TEST_F(ThreadingTests, test_initial_context_layout_matches_kernel_enter){
+    /* kernel::enter starts the first thread by loading these words straight out of its initial context, so a
+       first task that returns only reaches the exit trampoline if lr is where enter expects it */
+    ASSERT_EQ(40u, offsetof(os::thread::register_context, r0));
+    ASSERT_EQ(60u, offsetof(os::thread::register_context, lr));
+    ASSERT_EQ(64u, offsetof(os::thread::register_context, pc));
+    ASSERT_EQ(72u, sizeof(os::thread::register_context));
+}
+
+TEST_F(ThreadingTests, test_exit_trampoline_calls_the_exit_handler){
+    os::thread::set_exit_handler(throwing_exit_handler);
+    ASSERT_THROW(os::thread::exit_trampoline(), os::thread::status);
+    os::thread::set_exit_handler(nullptr);
+}
+
+TEST_F(ThreadingTests, test_thread_pool_hands_out_every_slot){
+    os::thread_pool_impl<thread_stack_size, thread_count> pool;
+    os::thread* one = pool.create(reinterpret_cast<os::thread::task_pointer>(&thread_task), nullptr, 1);
+    os::thread* two = pool.create(reinterpret_cast<os::thread::task_pointer>(&thread_task), nullptr, 2, 3);
+    ASSERT_NE(nullptr, one);
+    ASSERT_NE(nullptr, two);
+    ASSERT_NE(one->get_stack_ptr(), two->get_stack_ptr());
+    ASSERT_EQ(2u, two->get_id());
+    ASSERT_EQ(3u, two->get_priority());
+    ASSERT_EQ(thread_stack_size, two->get_stack_size());
+    ASSERT_EQ(0u, pool.get_free_count());
+    ASSERT_EQ(nullptr, pool.create(reinterpret_cast<os::thread::task_pointer>(&thread_task), nullptr, 3));
+}
+
+TEST_F(ThreadingTests, test_thread_pool_reuses_slots_of_exited_threads){
+    os::thread_pool_impl<thread_stack_size, thread_count> pool;
+    os::thread* one = pool.create(reinterpret_cast<os::thread::task_pointer>(&thread_task), nullptr, 1);
+    pool.create(reinterpret_cast<os::thread::task_pointer>(&thread_task), nullptr, 2);
+    uint32_t* stack = one->get_stack_ptr();
+
+    one->set_status(os::thread::status::exited);
+    ASSERT_EQ(1u, pool.get_free_count());
+    os::thread* three = pool.create(reinterpret_cast<os::thread::task_pointer>(&thread_task), nullptr, 3);
+    ASSERT_EQ(3u, three->get_id());
+    ASSERT_EQ(os::thread::status::pending, three->get_status());
+    ASSERT_EQ(stack, three->get_stack_ptr());
+    ASSERT_EQ(0u, pool.get_free_count());
+}
+
+TEST_F(ThreadingTests, test_thread_pool_passes_the_arguments_to_the_worker){
+    os::thread_pool_impl<thread_stack_size, thread_count> pool;
+    uint32_t work_item = 0;
+    os::thread* worker = pool.create(reinterpret_cast<os::thread::task_pointer>(&thread_task), &work_item, 1);
+    ASSERT_NE(nullptr, worker);
+    os::thread::register_context* context = reinterpret_cast<os::thread::register_context*>(worker->get_stack_ptr());
+    ASSERT_EQ(static_cast<uint32_t>(reinterpret_cast<std::uintptr_t>(&work_item)), context->r0);
+}
+
+TEST_F(ThreadingTests, test_thread_pool_release){
+    os::thread_pool_impl<thread_stack_size, thread_count> pool;
+    os::thread* one = pool.create(reinterpret_cast<os::thread::task_pointer>(&thread_task), nullptr, 1);
+    ASSERT_FALSE(pool.release(thread.get()));
+    ASSERT_TRUE(pool.release(one));
+    ASSERT_EQ(2u, pool.get_free_count());
+}
+
 TEST_F(ThreadingDeathsTests, creating_thread_with_null_task_ptr_fails){    
     ASSERT_DEATH({create_thread(nullptr, nullptr, 1, thread_stack.get(), thread_stack_size);}, "");
 }
@@ -0,0 +1,134 @@
+/*! \file timer_tests.cpp
+*
+*  \brief Unit tests for the software timer service.
+*
+*
+*  \author Graham Riches
+*/
+
+/********************************** Includes *******************************************/
+#include "gtest/gtest.h"
+#include "system_clock_impl.h"
+#include "timer_impl.h"
+#include "common.h"
+#include <memory>
+
+
+/*********************************** Consts ********************************************/
+constexpr uint32_t short_period = 5;
+constexpr uint32_t long_period = 10;
+
+/************************************ Local Functions ********************************************/
+/**
+ * \brief timer callback that counts how many times it has fired
+*/
+static void count_callback(void *arguments){
+    (*static_cast<uint32_t*>(arguments))++;
+}
+
+/************************************ Test Fixtures ********************************************/
+/**
+ * \brief test fixture for the timer service. Timers are fired the same way the timer thread does it.
+*/
+class TimerTest : public ::testing::Test {
+  protected:
+    void SetUp(void) override {
+        clock.start();
+        service = std::make_unique<os::timer_service_impl>(&clock);
+    }
+
+    //!< advance the clock and fire every expired timer
+    void advance(uint32_t ticks) {
+        clock.update(ticks);
+        for ( auto timer = service->take_expired(); timer != nullptr; timer = service->take_expired() ) {
+            timer->fire();
+        }
+    }
+
+    os::system_clock_impl clock;
+    std::unique_ptr<os::timer_service_impl> service;
+    uint32_t short_count = 0;
+    uint32_t long_count = 0;
+    os::timer_impl short_timer{count_callback, &short_count, short_period};
+    os::timer_impl long_timer{count_callback, &long_count, long_period, os::timer_impl::mode::periodic};
+};
+
+/************************************ Tests ********************************************/
+TEST_F(TimerTest, test_service_starts_with_no_timers) {
+    ASSERT_FALSE(service->has_active_timers());
+    ASSERT_FALSE(service->get_ticks_until_next_expiry().has_value());
+    ASSERT_EQ(nullptr, service->take_expired());
+}
+
+TEST_F(TimerTest, test_one_shot_timer_fires_once) {
+    service->start(&short_timer);
+    ASSERT_TRUE(short_timer.is_active());
+    advance(short_period - 1);
+    ASSERT_EQ(0u, short_count);
+    advance(1);
+    ASSERT_EQ(1u, short_count);
+    ASSERT_FALSE(short_timer.is_active());
+    advance(short_period);
+    ASSERT_EQ(1u, short_count);
+}
+
+TEST_F(TimerTest, test_periodic_timer_reloads) {
+    service->start(&long_timer);
+    advance(long_period);
+    advance(long_period);
+    ASSERT_EQ(2u, long_count);
+    ASSERT_TRUE(long_timer.is_active());
+    ASSERT_EQ(long_period, service->get_ticks_until_next_expiry().value());
+}
+
+TEST_F(TimerTest, test_periodic_timer_does_not_drift_when_fired_late) {
+    service->start(&long_timer);
+    advance(long_period + 3);
+    ASSERT_EQ(1u, long_count);
+    ASSERT_EQ(long_period - 3, service->get_ticks_until_next_expiry().value());
+}
+
+TEST_F(TimerTest, test_periodic_timer_drops_missed_periods) {
+    service->start(&long_timer);
+    advance(long_period * 3);
+    ASSERT_EQ(1u, long_count);
+    ASSERT_EQ(long_period, service->get_ticks_until_next_expiry().value());
+}
+
+TEST_F(TimerTest, test_next_expiry_is_the_soonest_timer) {
+    service->start(&long_timer);
+    service->start(&short_timer);
+    ASSERT_EQ(short_period, service->get_ticks_until_next_expiry().value());
+}
+
+TEST_F(TimerTest, test_stopped_timer_does_not_fire) {
+    service->start(&short_timer);
+    service->start(&long_timer);
+    service->stop(&short_timer);
+    ASSERT_FALSE(short_timer.is_active());
+    advance(long_period);
+    ASSERT_EQ(0u, short_count);
+    ASSERT_EQ(1u, long_count);
+}
+
+TEST_F(TimerTest, test_restart_pushes_the_expiry_back) {
+    service->start(&short_timer);
+    advance(short_period - 1);
+    service->start(&short_timer);
+    advance(short_period - 1);
+    ASSERT_EQ(0u, short_count);
+    advance(1);
+    ASSERT_EQ(1u, short_count);
+}
+
+TEST_F(TimerTest, test_timers_expire_across_tick_rollover) {
+    clock.update(0xFFFFFFFF - 2);
+    service->start(&long_timer);
+    service->start(&short_timer);
+    ASSERT_EQ(short_period, service->get_ticks_until_next_expiry().value());
+    advance(short_period);
+    ASSERT_EQ(1u, short_count);
+    ASSERT_EQ(0u, long_count);
+    advance(long_period - short_period);
+    ASSERT_EQ(1u, long_count);
+}
@@ -0,0 +1,126 @@
+/*! \file trace_tests.cpp
+*
+*  \brief Unit tests for the kernel trace buffer.
+*
+*
+*  \author Graham Riches
+*/
+
+/********************************** Includes *******************************************/
+#include "gtest/gtest.h"
+#include "trace_impl.h"
+#include <string>
+
+
+/*********************************** Consts ********************************************/
+constexpr size_t test_buffer_size = 4;
+constexpr uint32_t test_clock_hz = 168000000;
+
+/************************************ Test Fixtures ********************************************/
+class TraceBufferTest : public ::testing::Test {
+  protected:
+    void record(uint32_t argument) {
+        buffer.record(os::trace_event::marker, 1, argument, argument * 10);
+    }
+
+    os::trace_buffer_impl<test_buffer_size> buffer;
+};
+
+/************************************ Tests ********************************************/
+TEST_F(TraceBufferTest, test_nothing_is_recorded_until_started) {
+    record(1);
+    os::trace_record record;
+    ASSERT_FALSE(buffer.is_enabled());
+    ASSERT_FALSE(buffer.pop(record));
+}
+
+TEST_F(TraceBufferTest, test_start_writes_the_tagged_start_record) {
+    buffer.start(test_clock_hz, 1234);
+    os::trace_record record;
+    ASSERT_TRUE(buffer.pop(record));
+    ASSERT_EQ(os::trace_event::trace_start, record.event);
+    ASSERT_EQ(test_clock_hz, record.argument);
+    ASSERT_EQ(1234u, record.timestamp);
+    ASSERT_EQ(os::trace_start_tag, record.tag);
+}
+
+TEST_F(TraceBufferTest, test_records_pop_in_order) {
+    buffer.start(test_clock_hz, 0);
+    record(1);
+    record(2);
+
+    os::trace_record record;
+    buffer.pop(record);
+    ASSERT_TRUE(buffer.pop(record));
+    ASSERT_EQ(1u, record.argument);
+    ASSERT_EQ(10u, record.timestamp);
+    ASSERT_EQ(1u, record.detail);
+    ASSERT_EQ(0u, record.tag);
+    ASSERT_TRUE(buffer.pop(record));
+    ASSERT_EQ(2u, record.argument);
+    ASSERT_FALSE(buffer.pop(record));
+}
+
+TEST_F(TraceBufferTest, test_full_buffer_overwrites_the_oldest_and_counts_them) {
+    buffer.start(test_clock_hz, 0);
+    for ( uint32_t count = 1; count <= 5; count++ ) {
+        record(count);
+    }
+
+    ASSERT_EQ(test_buffer_size, buffer.get_count());
+    ASSERT_EQ(2u, buffer.take_overwritten_count());
+    ASSERT_EQ(0u, buffer.take_overwritten_count());
+
+    os::trace_record record;
+    ASSERT_TRUE(buffer.pop(record));
+    ASSERT_EQ(2u, record.argument);
+}
+
+TEST_F(TraceBufferTest, test_popped_records_are_not_counted_as_overwritten) {
+    buffer.start(test_clock_hz, 0);
+    os::trace_record popped;
+    for ( uint32_t count = 1; count <= (test_buffer_size * 3); count++ ) {
+        record(count);
+        ASSERT_TRUE(buffer.pop(popped));
+    }
+    ASSERT_EQ(0u, buffer.take_overwritten_count());
+}
+
+TEST_F(TraceBufferTest, test_copy_latest_returns_the_newest_oldest_first) {
+    buffer.start(test_clock_hz, 0);
+    for ( uint32_t count = 1; count <= 5; count++ ) {
+        record(count);
+    }
+
+    os::trace_record records[3];
+    ASSERT_EQ(3u, buffer.copy_latest(records, 3));
+    ASSERT_EQ(3u, records[0].argument);
+    ASSERT_EQ(5u, records[2].argument);
+
+    /* copying doesn't consume anything */
+    ASSERT_EQ(test_buffer_size, buffer.get_count());
+}
+
+TEST_F(TraceBufferTest, test_copy_latest_is_limited_to_what_was_recorded) {
+    buffer.start(test_clock_hz, 0);
+    record(1);
+
+    os::trace_record records[test_buffer_size];
+    ASSERT_EQ(2u, buffer.copy_latest(records, test_buffer_size));
+    ASSERT_EQ(os::trace_event::trace_start, records[0].event);
+}
+
+TEST_F(TraceBufferTest, test_stop_keeps_the_records) {
+    buffer.start(test_clock_hz, 0);
+    record(1);
+    buffer.stop();
+    record(2);
+    ASSERT_FALSE(buffer.is_enabled());
+    ASSERT_EQ(2u, buffer.get_count());
+}
+
+TEST(TraceEventTest, test_event_names) {
+    ASSERT_EQ(std::string("thread_switch_in"), os::get_trace_event_name(os::trace_event::thread_switch_in));
+    ASSERT_EQ(std::string("marker"), os::get_trace_event_name(os::trace_event::marker));
+    ASSERT_EQ(std::string("unknown"), os::get_trace_event_name(static_cast<os::trace_event>(200)));
+}
@@ -0,0 +1,220 @@
+/*! \file wait_any_tests.cpp
+*
+*  \brief Unit tests for waiting on several synchronization objects at once.
+*
+*
+*  \author Graham Riches
+*/
+
+/********************************** Includes *******************************************/
+#include "gtest/gtest.h"
+#include "thread_impl.h"
+#include "system_clock_impl.h"
+#include "scheduler_impl.h"
+#include "semaphore_impl.h"
+#include "queue_impl.h"
+#include "events_impl.h"
+#include "wait_any_impl.h"
+#include "common.h"
+#include <memory>
+#include <vector>
+
+
+/*********************************** Consts ********************************************/
+constexpr uint16_t thread_stack_size = 128;
+constexpr uint8_t thread_count = 2;
+constexpr uint32_t test_event_one = 0x01;
+constexpr uint32_t test_event_two = 0x02;
+
+/************************************ Local Variables ********************************************/
+static bool pending_irq;
+
+/************************************ Local Functions ********************************************/
+/**
+ * \brief fake PendSV request for the scheduler
+*/
+static void set_pending_irq(){
+    pending_irq = true;
+}
+
+/**
+ * \brief function to check if an interrupt is already pending
+ * \return returns true if a request is already pending
+*/
+static bool is_pending_irq(){
+    return pending_irq;
+}
+
+/************************************ Test Fixtures ********************************************/
+/**
+ * \brief sets up two fake threads, a semaphore, a queue and an event group. Thread one waits on all three
+ *        while thread two plays the part of whatever signals them.
+*/
+class WaitAnyTest : public ::testing::Test {
+  protected:
+    static void thread_function(void *arguments){ PARAMETER_NOT_USED(arguments); };
+
+    void SetUp(void) override {
+        internal_thread = create_thread(0xFFFF, internal_stack);
+        thread_one = create_thread(1, thread_one_stack);
+        thread_two = create_thread(2, thread_two_stack);
+        scheduler = std::make_unique<os::scheduler_impl>(&clock, thread_count, set_pending_irq, is_pending_irq);
+        scheduler->set_internal_task(internal_thread.get());
+        scheduler->register_thread(thread_one.get());
+        scheduler->register_thread(thread_two.get());
+        scheduler->start();
+        clock.start();
+        pending_irq = false;
+        semaphore = std::make_unique<os::counting_semaphore<int32_t>>(scheduler.get(), 0);
+        queue = std::make_unique<os::queue_impl<int, 4>>(scheduler.get());
+        event_flags = std::make_unique<os::event_flags_impl>(scheduler.get());
+        targets.reserve(3);
+        targets.emplace_back(*semaphore);
+        targets.emplace_back(*queue);
+        targets.emplace_back(*event_flags, test_event_one | test_event_two, os::wait_all);
+        wait = std::make_unique<os::wait_any_impl>(scheduler.get(), targets.data(), targets.size());
+    }
+
+    std::unique_ptr<os::thread> create_thread(uint32_t thread_id, uint32_t *stack_ptr) {
+        return std::make_unique<os::thread>(reinterpret_cast<os::thread::task_pointer>(&thread_function), nullptr, thread_id, stack_ptr, thread_stack_size);
+    }
+
+    //!< block thread one on every target, leaving thread two active
+    void block_thread_one(uint32_t ticks = os::scheduler_impl::wait_forever) {
+        tcb_one = scheduler->get_active_tcb_ptr();
+        wait->block(ticks);
+        ASSERT_EQ(thread_two.get(), scheduler->get_active_tcb_ptr()->thread_ptr);
+        pending_irq = false;
+    }
+
+    uint32_t internal_stack[thread_stack_size] = {0};
+    uint32_t thread_one_stack[thread_stack_size] = {0};
+    uint32_t thread_two_stack[thread_stack_size] = {0};
+    std::unique_ptr<os::thread> internal_thread;
+    std::unique_ptr<os::thread> thread_one;
+    std::unique_ptr<os::thread> thread_two;
+    std::unique_ptr<os::scheduler_impl> scheduler;
+    os::system_clock_impl clock;
+    std::unique_ptr<os::counting_semaphore<int32_t>> semaphore;
+    std::unique_ptr<os::queue_impl<int, 4>> queue;
+    std::unique_ptr<os::event_flags_impl> event_flags;
+    std::vector<os::wait_any_target> targets;
+    std::unique_ptr<os::wait_any_impl> wait;
+    os::scheduler_impl::TaskControlBlock* tcb_one = nullptr;
+};
+
+/************************************ Tests ********************************************/
+TEST_F(WaitAnyTest, test_poll_finds_nothing_ready) {
+    ASSERT_FALSE(wait->poll().has_value());
+}
+
+TEST_F(WaitAnyTest, test_poll_returns_the_first_ready_target) {
+    queue->try_send(5);
+    semaphore->signal();
+    ASSERT_EQ(0u, wait->poll().value());
+    ASSERT_TRUE(semaphore->try_wait());
+    ASSERT_EQ(1u, wait->poll().value());
+}
+
+TEST_F(WaitAnyTest, test_event_target_uses_its_mask_and_options) {
+    event_flags->set(test_event_one);
+    ASSERT_FALSE(wait->poll().has_value());
+    event_flags->set(test_event_two);
+    ASSERT_EQ(2u, wait->poll().value());
+
+    /* checking the flags doesn't consume them */
+    ASSERT_EQ(2u, wait->poll().value());
+}
+
+TEST_F(WaitAnyTest, test_semaphore_signal_wakes_the_waiter) {
+    block_thread_one();
+    ASSERT_TRUE(semaphore->get_watchers().has_waiters());
+    semaphore->signal();
+    ASSERT_EQ(os::thread::status::pending, thread_one->get_status());
+    ASSERT_EQ(0u, wait->finish().value());
+    ASSERT_FALSE(semaphore->get_watchers().has_waiters());
+    ASSERT_FALSE(queue->get_watchers().has_waiters());
+
+    /* the count is left for the woken thread to take */
+    ASSERT_TRUE(semaphore->try_wait());
+}
+
+TEST_F(WaitAnyTest, test_queue_send_wakes_the_waiter) {
+    block_thread_one();
+    ASSERT_TRUE(queue->try_send(42));
+    ASSERT_EQ(1u, wait->finish().value());
+    ASSERT_EQ(42, queue->try_receive().value());
+}
+
+TEST_F(WaitAnyTest, test_event_set_only_wakes_the_waiter_when_satisfied) {
+    block_thread_one();
+    event_flags->set(test_event_one);
+    ASSERT_EQ(os::thread::status::suspended, thread_one->get_status());
+    event_flags->set(test_event_two);
+    ASSERT_EQ(os::thread::status::pending, thread_one->get_status());
+    ASSERT_EQ(2u, wait->finish().value());
+}
+
+TEST_F(WaitAnyTest, test_first_ready_target_wins) {
+    block_thread_one();
+    queue->try_send(1);
+    semaphore->signal();
+    ASSERT_EQ(1u, wait->finish().value());
+}
+
+TEST_F(WaitAnyTest, test_direct_waiter_is_served_first) {
+    block_thread_one();
+
+    /* thread two blocks on the semaphore itself, so the signal goes straight to it */
+    auto tcb_two = scheduler->get_active_tcb_ptr();
+    semaphore->block();
+    semaphore->signal();
+    ASSERT_NE(os::thread::status::suspended, thread_two->get_status());
+    ASSERT_FALSE(tcb_two->wait_timed_out);
+    ASSERT_EQ(os::thread::status::suspended, thread_one->get_status());
+    ASSERT_EQ(0, semaphore->get_count());
+}
+
+TEST_F(WaitAnyTest, test_higher_priority_waiter_preempts) {
+    uint32_t stack[thread_stack_size] = {0};
+    auto high = std::make_unique<os::thread>(reinterpret_cast<os::thread::task_pointer>(&thread_function), nullptr, 3, stack, thread_stack_size, 5);
+    auto test_scheduler = std::make_unique<os::scheduler_impl>(&clock, thread_count, set_pending_irq, is_pending_irq);
+    test_scheduler->set_internal_task(internal_thread.get());
+    test_scheduler->register_thread(high.get());
+    test_scheduler->register_thread(thread_two.get());
+    test_scheduler->start();
+
+    os::counting_semaphore<int32_t> signal(test_scheduler.get(), 0);
+    os::wait_any_target target(signal);
+    os::wait_any_impl high_wait(test_scheduler.get(), &target, 1);
+    high_wait.block();
+    ASSERT_EQ(thread_two.get(), test_scheduler->get_active_tcb_ptr()->thread_ptr);
+
+    pending_irq = false;
+    signal.signal();
+    ASSERT_TRUE(pending_irq);
+    ASSERT_EQ(high.get(), test_scheduler->get_active_tcb_ptr()->thread_ptr);
+    ASSERT_EQ(0u, high_wait.finish().value());
+}
+
+TEST_F(WaitAnyTest, test_wait_times_out) {
+    block_thread_one(5);
+    clock.update(5);
+    scheduler->run();
+    ASSERT_TRUE(tcb_one->wait_timed_out);
+    ASSERT_EQ(os::thread::status::pending, thread_one->get_status());
+
+    /* a late signal doesn't wake the thread again, it just leaves the count */
+    semaphore->signal();
+    ASSERT_FALSE(wait->finish().has_value());
+    ASSERT_EQ(1, semaphore->get_count());
+}
+
+TEST_F(WaitAnyTest, test_only_one_wake_per_wait) {
+    block_thread_one();
+    semaphore->signal();
+    semaphore->signal();
+    queue->try_send(3);
+    ASSERT_EQ(0u, wait->finish().value());
+    ASSERT_EQ(2, semaphore->get_count());
+}